@@ -26,6 +26,7 @@
 #include "gtksourcebuffer.h"
 #include "gtksourcestyle-private.h"
 #include <mooglib/moo-glib.h>
+#include "mooutils/mootrace.h"
 #include <string.h>
 
 #undef DEBUG
@@ -5428,6 +5429,7 @@ update_syntax (GtkSourceContextEngine *ce,
 	Segment *state = ce->priv->root_segment;
 	GTimer *timer;
 
+	MOO_TRACE_BEGIN ("syntax update");
 	context_freeze (ce->priv->root_context);
 	update_tree (ce);
 
@@ -5532,9 +5534,14 @@ update_syntax (GtkSourceContextEngine *ce,
 
 		state = analyze_line (ce, state, &line);
 
-		/* At this point analyze_line() could have disabled highlighting */
+		/* At this point analyze_line() could have disabled highlighting,
+		 * the context tree is gone then so there is nothing to thaw */
 		if (ce->priv->disabled)
+		{
+			g_timer_destroy (timer);
+			MOO_TRACE_END ("syntax update");
 			return;
+		}
 
 #ifdef ENABLE_CHECK_TREE
 		{
@@ -5639,12 +5646,14 @@ update_syntax (GtkSourceContextEngine *ce,
 	PROFILE (g_print ("analyzed %d chars from %d to %d in %fms\n",
 			  analyzed_end - start_offset, start_offset, analyzed_end,
 			  g_timer_elapsed (timer, NULL) * 1000));
+	MOO_TRACE_COUNTER ("syntax chars analyzed", analyzed_end - start_offset);
 
 	g_timer_destroy (timer);
 
 out:
 	/* must call context_thaw, so this is the only return point */
 	context_thaw (ce->priv->root_context);
+	MOO_TRACE_END ("syntax update");
 }
 
 
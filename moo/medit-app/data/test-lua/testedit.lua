@@ -117,6 +117,67 @@ function test_file()
   tassert(doc.close())
 end
 
+function test_lines()
+  doc = editor.new_doc()
+  doc.set_text('one\ntwo\nthree\n')
+  tassert_eq(doc.get_lines(1), {'one', 'two', 'three', ''})
+  tassert_eq(doc.get_lines(2, 3), {'two', 'three'})
+  tassert_eq(doc.get_lines(4), {''})
+  doc.set_text('a\r\nb')
+  tassert_eq(doc.get_lines(1, 2), {'a', 'b'})
+  doc.set_modified(false)
+  doc.close()
+end
+
+function test_batch()
+  doc = editor.new_doc()
+  doc.set_text('one\ntwo\nthree\n')
+
+  -- positions refer to the text before the batch
+  batch = moo.EditBatch.new()
+  batch.replace_line(2, 'TWO')
+  batch.insert(0, 'a')
+  batch.insert(0, 'b')
+  batch.replace(8, 13, '3')
+  batch.delete(1, 2)
+  tassert_eq(batch.get_size(), 5)
+  tassert(doc.apply_batch(batch))
+  tassert_eq(doc.get_text(), 'aboe\nTWO\n3\n')
+
+  -- one undo step
+  doc.undo()
+  tassert_eq(doc.get_text(), 'one\ntwo\nthree\n')
+  doc.redo()
+  tassert_eq(doc.get_text(), 'aboe\nTWO\n3\n')
+
+  tassert(doc.apply_batch(moo.EditBatch.new()))
+  tassert_eq(doc.get_text(), 'aboe\nTWO\n3\n')
+
+  doc.set_modified(false)
+  doc.close()
+end
+
+function test_snapshot()
+  doc = editor.new_doc()
+  doc.set_text('x\ny\n')
+  snapshot = doc.get_snapshot()
+  tassert_eq(snapshot.get_line_count(), 3)
+  tassert_eq(snapshot.get_line(1), 'x')
+  tassert_eq(snapshot.get_line(2), 'y')
+  tassert_eq(snapshot.get_line(3), '')
+
+  -- the snapshot does not change with the document
+  doc.set_text('changed')
+  tassert_eq(snapshot.get_line_count(), 3)
+  tassert_eq(snapshot.get_line(1), 'x')
+
+  doc.set_modified(false)
+  doc.close()
+end
+
 test_undo()
 test_edit()
 test_file()
+test_lines()
+test_batch()
+test_snapshot()
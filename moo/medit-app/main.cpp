@@ -20,6 +20,7 @@
 #include "mooutils/mooutils-fs.h"
 #include "mooutils/mooutils-misc.h"
 #include "mooutils/mootype-macros.h"
+#include "mooutils/mootrace.h"
 #include "moocpp/regex.h"
 #include "plugins/mooplugin-builtin.h"
 #include <gtk/gtk.h>
@@ -63,6 +64,10 @@ struct MeditOpts
 	char *ut_dir = nullptr;
 	char *ut_coverage_file = nullptr;
     gstrvec ut_tests;
+	gboolean bench = false;
+	char *bench_filter = nullptr;
+	char *bench_output = nullptr;
+	char *trace_file = nullptr;
 	char **run_script = nullptr;
 	char **send_script = nullptr;
     gboolean portable = false;
@@ -251,6 +256,14 @@ parse_args (int argc, char *argv[])
 				"File to write coverage data to", NULL },
 		{ "ut-list", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &medit_opts.ut_list,
 				"List unit tests", NULL },
+		{ "bench", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &medit_opts.bench,
+				"Run benchmarks", NULL },
+		{ "bench-filter", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &medit_opts.bench_filter,
+				"Run only benchmarks matching PATTERN", "PATTERN" },
+		{ "bench-output", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME, &medit_opts.bench_output,
+				"Write benchmark results to FILE", "FILE" },
+		{ "trace", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME, &medit_opts.trace_file,
+				"Write trace of startup and slow operations to FILE", "FILE" },
 	#ifdef __WIN32__
 		{ "portable", 0, G_OPTION_ARG_NONE, G_OPTION_ARG_NONE, &medit_opts.portable,
 				"Run medit in portable mode", NULL },
@@ -580,6 +593,20 @@ unit_test_func (void)
     moo_app_quit (moo_app_instance ());
 }
 
+static void
+bench_func (void)
+{
+    MooTestOptions opts = MooTestOptions (0);
+    int status;
+
+    if (!medit_opts.ut_uninstalled)
+        opts = MooTestOptions (opts | MOO_TEST_INSTALLED);
+
+    status = bench_main (opts, medit_opts.bench_filter, medit_opts.bench_output, medit_opts.ut_dir);
+    moo_app_set_exit_status (moo_app_instance (), status);
+    moo_app_quit (moo_app_instance ());
+}
+
 static void
 run_script_func (void)
 {
@@ -695,12 +722,18 @@ medit_main (int argc, char *argv[])
     CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
 #endif // __WIN32__
 
+    if (bench_requested (argc, argv))
+        moo_test_count_allocations ();
+
     init_mem_stuff ();
     moo_thread_init ();
     g_set_prgname ("medit");
 
     ctx = parse_args (argc, argv);
 
+    if (medit_opts.trace_file)
+        _moo_trace_start (medit_opts.trace_file);
+
     stamp = get_time_stamp ();
 
 #ifdef WANT_SYNAPTICS_FIX
@@ -725,7 +758,7 @@ medit_main (int argc, char *argv[])
     run_input = !medit_opts.new_app || medit_opts.instance_name ||
                  medit_opts.use_session == 1 || medit_opts.project_mode;
 
-    if (medit_opts.ut)
+    if (medit_opts.ut || medit_opts.bench)
     {
         new_instance = TRUE;
         run_input = FALSE;
@@ -825,11 +858,15 @@ medit_main (int argc, char *argv[])
 
     if (medit_opts.ut)
         g_signal_connect (app, "started", G_CALLBACK (unit_test_func), NULL);
+    if (medit_opts.bench)
+        g_signal_connect (app, "started", G_CALLBACK (bench_func), NULL);
     if (medit_opts.run_script)
         g_signal_connect (app, "started", G_CALLBACK (run_script_func), NULL);
 
     retval = moo_app_run (app);
 
+    _moo_trace_stop ();
+
     g_object_unref (app);
 
 #ifdef __WIN32__
@@ -1,7 +1,14 @@
+#include <mooapp/mooapp-tests.h>
 #include <mooedit/mooeditor-tests.h>
+#include <moofileview/moofileview-tests.h>
 #include <moolua/moolua-tests.h>
 #include <moopython/moopython-tests.h>
 #include <mooutils/mooutils-tests.h>
+#include <plugins/mooplugin-tests.h>
+#include <plugins/usertools/moousertools-tests.h>
+#ifdef MOO_BUILD_CTAGS
+#include <plugins/ctags/ctags-tests.h>
+#endif
 #include <gtk/gtk.h>
 #include <stdio.h>
 #include "mem-debug.h"
@@ -14,12 +21,16 @@ add_tests (MooTestOptions opts)
     moo_test_mooutils_fs ();
     moo_test_moo_file_writer ();
     moo_test_mooutils_misc ();
+    moo_test_mooglade ();
+    moo_test_mooprefs ();
     moo_test_i18n (opts);
 
 #ifdef __WIN32__
     moo_test_mooutils_win32 ();
 #endif
 
+    moo_test_moofileview ();
+
     moo_test_lua (opts);
 
 #ifdef MOO_ENABLE_PYTHON
@@ -27,13 +38,19 @@ add_tests (MooTestOptions opts)
 #endif
 
     moo_test_editor ();
+    moo_test_plugins ();
+    moo_test_usertools ();
+    moo_test_mooapp ();
+
+#ifdef MOO_BUILD_CTAGS
+    moo_test_ctags ();
+#endif
 }
 
-static int
-unit_tests_main(MooTestOptions opts, const gstrvec& tests, const char *data_dir_arg, const char *coverage_file)
+static void
+set_data_dir (const char *data_dir_arg)
 {
     const char *data_dir = NULL;
-    gboolean passed;
 
 #ifdef MOO_UNIT_TEST_DATA_DIR
     data_dir = MOO_UNIT_TEST_DATA_DIR;
@@ -43,6 +60,14 @@ unit_tests_main(MooTestOptions opts, const gstrvec& tests, const char *data_dir_
         data_dir = data_dir_arg;
 
     moo_test_set_data_dir (data_dir);
+}
+
+static int
+unit_tests_main(MooTestOptions opts, const gstrvec& tests, const char *data_dir_arg, const char *coverage_file)
+{
+    gboolean passed;
+
+    set_data_dir (data_dir_arg);
 
     add_tests (opts);
 
@@ -58,3 +83,35 @@ list_unit_tests (const char *data_dir)
 {
     unit_tests_main(MOO_TEST_LIST_ONLY, gstrvec(), data_dir, NULL);
 }
+
+static int
+bench_main (MooTestOptions opts, const char *filter, const char *output_file, const char *data_dir_arg)
+{
+    gboolean passed;
+
+    opts = MooTestOptions (opts | MOO_TEST_BENCHMARKS);
+
+    set_data_dir (data_dir_arg);
+
+    add_tests (opts);
+
+    passed = moo_test_run_benchmarks (filter, output_file, opts);
+
+    moo_test_cleanup ();
+
+    return passed ? 0 : 1;
+}
+
+/* allocations can only be counted if it's known before
+ * the command line is parsed */
+static gboolean
+bench_requested (int argc, char *argv[])
+{
+    int i;
+
+    for (i = 1; i < argc; ++i)
+        if (strcmp (argv[i], "--bench") == 0)
+            return TRUE;
+
+    return FALSE;
+}
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "mooapp-private.h"
+#include "mooapp-tests.h"
 #include "eggsmclient/eggsmclient.h"
 #include "mooapp-accels.h"
 #include "mooapp-info.h"
@@ -33,6 +34,7 @@
 #include "mooutils/mooprefsdialog.h"
 #include "marshals.h"
 #include "mooutils/mooappinput.h"
+#include "mooutils/mooappinput-priv.h"
 #include "mooutils/moodialogs.h"
 #include "mooutils/moostock.h"
 #include "mooutils/mooutils-fs.h"
@@ -43,6 +45,8 @@
 #include "mooutils/moohelp.h"
 #include "mooutils/moocompat.h"
 #include "mooutils/mooutils-script.h"
+#include "mooutils/mootrace.h"
+#include "moocpp/fileutils.h"
 #include <mooglib/moo-glib.h>
 #include <string.h>
 #include <stdio.h>
@@ -56,6 +60,13 @@
 #include <signal.h>
 #endif
 
+#ifndef __WIN32__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 #define MOO_UI_XML_FILE     "ui.xml"
 #ifdef __WIN32__
 #define MOO_ACTIONS_FILE    "actions.ini"
@@ -65,6 +76,14 @@
 
 #define SESSION_VERSION "1.0"
 
+/* while the app runs, the session is saved this often so that it
+ * survives a crash */
+#define SESSION_CHECKPOINT_INTERVAL 60
+
+/* requests which arrive within this many milliseconds from each
+ * other are handled together, e.g. files from `xargs medit` */
+#define PENDING_CMDS_DELAY 20
+
 #define ASK_OPEN_BUG_URL_KEY "Application/ask_open_bug_url"
 
 static struct {
@@ -74,6 +93,12 @@ static struct {
 
 static volatile int signal_received;
 
+/* a request which came from another instance, see moo_app_queue_cmd() */
+typedef struct {
+    MooOpenInfoArray *files;
+    char *script;
+} PendingCmd;
+
 struct _MooAppPrivate {
     MooEditor  *editor;
     char       *rc_files[2];
@@ -94,11 +119,18 @@ struct _MooAppPrivate {
     int         use_session;
     char       *session_file;
     MooMarkupDoc *session;
+    char       *session_text;       /* written at quit */
+    char       *checkpoint_text;    /* last written by a checkpoint */
+    guint       checkpoint_id;
 
     MooUiXml   *ui_xml;
     const char *default_ui;
     guint       quit_handler_id;
 
+    GQueue     *pending_cmds;
+    guint32     pending_stamp;
+    guint       pending_cmds_id;
+
 #ifdef MOO_USE_QUARTZ
     IgeMacDock *dock;
 #endif
@@ -149,6 +181,11 @@ static void     start_input             (MooApp             *app);
 
 static void     moo_app_cmd_open_files  (MooApp             *app,
                                          const char         *data);
+static void     moo_app_queue_cmd       (MooApp             *app,
+                                         MooOpenInfoArray   *files,
+                                         guint32             stamp,
+                                         const char         *script);
+static void     pending_cmd_free        (PendingCmd         *cmd);
 
 
 static GObjectClass *moo_app_parent_class;
@@ -385,6 +422,8 @@ moo_app_finalize (GObject *object)
     g_free (app->priv->rc_files[1]);
 
     g_free (app->priv->session_file);
+    g_free (app->priv->session_text);
+    g_free (app->priv->checkpoint_text);
     if (app->priv->session)
         moo_markup_doc_unref (app->priv->session);
 
@@ -583,6 +622,8 @@ editor_after_close_window (MooApp *app)
 static void
 init_plugins (MooApp *app)
 {
+    MOO_TRACE_SCOPE ("plugins init");
+
     if (MOO_APP_GET_CLASS (app)->init_plugins)
         MOO_APP_GET_CLASS (app)->init_plugins (app);
 }
@@ -590,6 +631,8 @@ init_plugins (MooApp *app)
 static void
 moo_app_init_editor (MooApp *app)
 {
+    MOO_TRACE_SCOPE ("editor init");
+
     app->priv->editor = moo_editor_create_instance (FALSE);
 
     g_signal_connect_swapped (app->priv->editor, "will-close-window",
@@ -612,6 +655,8 @@ moo_app_init_ui (MooApp *app)
     MooUiXml *xml = NULL;
     char **files, **p;
 
+    MOO_TRACE_SCOPE ("ui init");
+
     files = moo_get_data_files (MOO_UI_XML_FILE);
 
     for (p = files; p && *p; ++p)
@@ -749,6 +794,7 @@ check_signal (void)
 static gboolean
 emit_started (MooApp *app)
 {
+    MOO_TRACE_SCOPE ("app started");
     g_signal_emit_by_name (app, "started");
     return FALSE;
 }
@@ -823,6 +869,19 @@ moo_app_do_quit (MooApp *app)
     app->priv->sm_client = NULL;
 #endif
 
+    if (app->priv->pending_cmds_id)
+        g_source_remove (app->priv->pending_cmds_id);
+    app->priv->pending_cmds_id = 0;
+    if (app->priv->checkpoint_id)
+        g_source_remove (app->priv->checkpoint_id);
+    app->priv->checkpoint_id = 0;
+    if (app->priv->pending_cmds)
+    {
+        g_queue_foreach (app->priv->pending_cmds, (GFunc) pending_cmd_free, NULL);
+        g_queue_free (app->priv->pending_cmds);
+        app->priv->pending_cmds = NULL;
+    }
+
     _moo_editor_close_all (app->priv->editor);
 
     moo_plugin_shutdown ();
@@ -852,6 +911,8 @@ moo_app_init (MooApp *app)
 {
     g_return_val_if_fail (MOO_IS_APP (app), FALSE);
 
+    MOO_TRACE_SCOPE ("app init");
+
     gdk_set_program_class (MOO_APP_FULL_NAME);
     gtk_window_set_default_icon_name (MOO_APP_SHORT_NAME);
 
@@ -1067,62 +1128,176 @@ moo_app_do_load_session (MooApp        *app,
     MooEditor *editor;
     editor = moo_app_get_editor (app);
     g_return_if_fail (editor != NULL);
+    MOO_TRACE_SCOPE ("session restore");
     _moo_editor_load_session (editor, xml);
     g_signal_emit (app, signals[LOAD_SESSION], 0);
 }
 
-static void
-moo_app_save_session (MooApp *app)
-{
-    MooMarkupNode *root;
-
-    if (!app->priv->session_file)
-        return;
-
-    if (app->priv->session)
-        moo_markup_doc_unref (app->priv->session);
+/* Session files are written in a thread, one at a time and in the order
+ * they were queued. A write is skipped when a newer one is already
+ * waiting, and moo_config_writer replaces the file atomically. */
+typedef struct {
+    char *filename;
+    char *text;         /* NULL to remove the file */
+    int serial;
+} SessionWrite;
 
-    app->priv->session = moo_markup_doc_new ("session");
-    root = moo_markup_create_root_element (app->priv->session, "session");
-    moo_markup_set_prop (root, "version", SESSION_VERSION);
+static GThreadPool *session_writer;
+static int session_write_serial;
 
-    g_signal_emit (app, signals[SAVE_SESSION], 0);
-    _moo_editor_save_session (moo_app_get_editor (app), root);
+static void
+session_write_free (SessionWrite *job)
+{
+    g_free (job->filename);
+    g_free (job->text);
+    g_slice_free (SessionWrite, job);
 }
 
+/* runs in a thread */
 static void
-moo_app_write_session (MooApp *app)
+session_write_run (SessionWrite *job)
 {
-    char *filename;
     GError *error = NULL;
     MooFileWriter *writer;
 
-    if (!app->priv->session_file)
+    if (job->serial != g_atomic_int_get (&session_write_serial))
+    {
+        session_write_free (job);
         return;
+    }
 
-    filename = moo_get_user_cache_file (app->priv->session_file);
-
-    if (!app->priv->session)
+    if (!job->text)
     {
         mgw_errno_t err;
-        mgw_unlink (filename, &err);
-        g_free (filename);
+        mgw_unlink (job->filename, &err);
+        session_write_free (job);
         return;
     }
 
-    if ((writer = moo_config_writer_new (filename, FALSE, &error)))
+    if ((writer = moo_config_writer_new (job->filename, FALSE, &error)))
     {
-        moo_markup_write_pretty (app->priv->session, writer, 1);
+        moo_file_writer_write (writer, job->text, -1);
         moo_file_writer_close (writer, &error);
     }
 
     if (error)
     {
-        g_critical ("could not save session file %s: %s", filename, error->message);
+        g_critical ("could not save session file %s: %s", job->filename, error->message);
         g_error_free (error);
     }
 
-    g_free (filename);
+    session_write_free (job);
+}
+
+static void
+queue_session_write (MooApp     *app,
+                     const char *text)
+{
+    SessionWrite *job;
+
+    if (!session_writer)
+        session_writer = g_thread_pool_new ((GFunc) session_write_run, NULL,
+                                            1, FALSE, NULL);
+
+    job = g_slice_new (SessionWrite);
+    job->filename = moo_get_user_cache_file (app->priv->session_file);
+    job->text = g_strdup (text);
+    job->serial = g_atomic_int_add (&session_write_serial, 1) + 1;
+
+    g_thread_pool_push (session_writer, job, NULL);
+}
+
+/* waits until queued files are written */
+static void
+flush_session_writes (void)
+{
+    if (session_writer)
+        g_thread_pool_free (session_writer, FALSE, TRUE);
+    session_writer = NULL;
+}
+
+static char *
+get_session_text (MooApp *app)
+{
+    GString *text;
+
+    text = g_string_sized_new (4096);
+    g_string_append (text, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                           "<session version=\"" SESSION_VERSION "\">\n");
+    _moo_editor_save_session (moo_app_get_editor (app), text);
+    g_string_append (text, "</session>\n");
+
+    return g_string_free (text, FALSE);
+}
+
+static void
+moo_app_save_session (MooApp *app)
+{
+    if (!app->priv->session_file)
+        return;
+
+    MOO_TRACE_SCOPE ("session save");
+
+    g_signal_emit (app, signals[SAVE_SESSION], 0);
+
+    g_free (app->priv->session_text);
+    app->priv->session_text = get_session_text (app);
+}
+
+static void
+moo_app_write_session (MooApp *app)
+{
+    if (!app->priv->session_file)
+        return;
+
+    queue_session_write (app, app->priv->session_text);
+    flush_session_writes ();
+}
+
+/* Saves the session in background if it changed since the last time.
+ * It's not a "save-session", and it's skipped while there are no
+ * windows so that it doesn't overwrite the session saved when the last
+ * window was closed. */
+static gboolean
+session_checkpoint (MooApp *app)
+{
+    MooEditWindowArray *windows;
+    char *text;
+
+    if (!app->priv->running || app->priv->in_try_quit)
+        return TRUE;
+
+    windows = moo_editor_get_windows (app->priv->editor);
+
+    if (moo_edit_window_array_get_size (windows) != 0)
+    {
+        MOO_TRACE_BEGIN ("session checkpoint");
+        text = get_session_text (app);
+        MOO_TRACE_END ("session checkpoint");
+
+        if (!moo_str_equal (text, app->priv->checkpoint_text))
+        {
+            queue_session_write (app, text);
+            g_free (app->priv->checkpoint_text);
+            app->priv->checkpoint_text = text;
+        }
+        else
+        {
+            g_free (text);
+        }
+    }
+
+    moo_edit_window_array_free (windows);
+    return TRUE;
+}
+
+static void
+start_session_checkpoints (MooApp *app)
+{
+    if (!app->priv->checkpoint_id)
+        app->priv->checkpoint_id =
+            g_timeout_add_seconds (SESSION_CHECKPOINT_INTERVAL,
+                                   (GSourceFunc) session_checkpoint, app);
 }
 
 void
@@ -1148,8 +1323,11 @@ moo_app_load_session (MooApp *app)
             app->priv->session_file = g_strdup (MOO_SESSION_XML_FILE_NAME);
     }
 
+    start_session_checkpoints (app);
+
     session_file = moo_get_user_cache_file (app->priv->session_file);
 
+    MOO_TRACE_BEGIN ("session read");
     if (!g_file_test (session_file, G_FILE_TEST_EXISTS) ||
         !(doc = moo_markup_parse_file (session_file, &error)))
     {
@@ -1160,9 +1338,11 @@ moo_app_load_session (MooApp *app)
             g_error_free (error);
         }
 
+        MOO_TRACE_END ("session read");
         g_free (session_file);
         return;
     }
+    MOO_TRACE_END ("session read");
 
     if (!(root = moo_markup_get_root_element (doc, "session")) ||
         !(version = moo_markup_get_prop (root, "version")))
@@ -1314,7 +1494,7 @@ moo_app_exec_cmd (MooApp             *app,
     switch (code)
     {
         case CMD_SCRIPT:
-            moo_app_run_script (app, data);
+            moo_app_queue_cmd (app, NULL, 0, data);
             break;
 
         case CMD_OPEN_FILES:
@@ -1421,6 +1601,8 @@ moo_app_load_prefs (MooApp *app)
     GError *error = NULL;
     char **sys_files;
 
+    MOO_TRACE_SCOPE ("prefs load");
+
     app->priv->rc_files[MOO_PREFS_RC] = moo_get_user_data_file (MOO_PREFS_XML_FILE_NAME);
     app->priv->rc_files[MOO_PREFS_STATE] = moo_get_user_cache_file (MOO_STATE_XML_FILE_NAME);
 
@@ -1525,15 +1707,87 @@ moo_app_parse_files (const char      *data,
     return files;
 }
 
+static void
+pending_cmd_free (PendingCmd *cmd)
+{
+    moo_open_info_array_free (cmd->files);
+    g_free (cmd->script);
+    g_slice_free (PendingCmd, cmd);
+}
+
+static gboolean
+run_pending_cmds (MooApp *app)
+{
+    GQueue *cmds = app->priv->pending_cmds;
+    guint32 stamp = app->priv->pending_stamp;
+    PendingCmd *cmd;
+
+    app->priv->pending_cmds_id = 0;
+    app->priv->pending_cmds = NULL;
+    app->priv->pending_stamp = 0;
+
+    while ((cmd = (PendingCmd*) g_queue_pop_head (cmds)))
+    {
+        if (cmd->files)
+            moo_app_open_files (app, cmd->files, stamp);
+        else
+            moo_app_run_script (app, cmd->script);
+        pending_cmd_free (cmd);
+    }
+
+    g_queue_free (cmds);
+    return FALSE;
+}
+
+/* Commands are not run right away: requests coming from several
+ * clients in a row are merged and files are opened in one go, so that
+ * windows are updated once for the whole lot. Scripts wait too, so that
+ * they run after the files sent before them are open.
+ * Takes ownership of files. */
+static void
+moo_app_queue_cmd (MooApp           *app,
+                   MooOpenInfoArray *files,
+                   guint32           stamp,
+                   const char       *script)
+{
+    PendingCmd *cmd;
+
+    if (!app->priv->pending_cmds)
+        app->priv->pending_cmds = g_queue_new ();
+
+    cmd = (PendingCmd*) g_queue_peek_tail (app->priv->pending_cmds);
+
+    if (files && cmd && cmd->files)
+    {
+        moo_open_info_array_append_array (cmd->files, files);
+        moo_open_info_array_free (files);
+    }
+    else
+    {
+        cmd = g_slice_new0 (PendingCmd);
+        cmd->files = files;
+        cmd->script = g_strdup (script);
+        g_queue_push_tail (app->priv->pending_cmds, cmd);
+    }
+
+    app->priv->pending_stamp = MAX (app->priv->pending_stamp, stamp);
+
+    if (!app->priv->pending_cmds_id)
+        app->priv->pending_cmds_id =
+            g_timeout_add (PENDING_CMDS_DELAY, (GSourceFunc) run_pending_cmds, app);
+}
+
 static void
 moo_app_cmd_open_files (MooApp     *app,
                         const char *data)
 {
     MooOpenInfoArray *files;
     guint32 stamp;
-    files = moo_app_parse_files (data, &stamp);
-    moo_app_open_files (app, files, stamp);
-    moo_open_info_array_free (files);
+
+    if (!(files = moo_app_parse_files (data, &stamp)))
+        return;
+
+    moo_app_queue_cmd (app, files, stamp, NULL);
 }
 
 G_GNUC_PRINTF(2, 3) static void
@@ -1551,20 +1805,13 @@ append_escaped (GString *str, const char *format, ...)
     va_end (args);
 }
 
-gboolean
-moo_app_send_files (MooOpenInfoArray *files,
-                    guint32           stamp,
-                    const char       *pid)
+static GString *
+make_open_files_msg (MooOpenInfoArray *files,
+                     guint32           stamp)
 {
-    gboolean result;
     GString *msg;
     int i, c;
 
-#if 0
-    _moo_message ("moo_app_send_files: got %d files to pid %s",
-                  n_files, pid ? pid : "NONE");
-#endif
-
     msg = g_string_new (NULL);
     g_string_append_printf (msg, "%s<moo-app-open-files version=\"%s\" stamp=\"%u\">",
                             CMD_OPEN_FILES_S, MOO_APP_CMD_VERSION, stamp);
@@ -1596,9 +1843,558 @@ moo_app_send_files (MooOpenInfoArray *files,
     }
 
     g_string_append (msg, "</moo-app-open-files>");
+    return msg;
+}
+
+gboolean
+moo_app_send_files (MooOpenInfoArray *files,
+                    guint32           stamp,
+                    const char       *pid)
+{
+    gboolean result;
+    GString *msg;
 
+#if 0
+    _moo_message ("moo_app_send_files: got %d files to pid %s",
+                  n_files, pid ? pid : "NONE");
+#endif
+
+    msg = make_open_files_msg (files, stamp);
     result = moo_app_send_msg (pid, msg->str, msg->len);
 
     g_string_free (msg, TRUE);
     return result;
 }
+
+
+/***************************************************************************/
+/* tests
+ */
+
+#define TEST_TIMEOUT 10
+
+/* runs the main loop until done() is true */
+static gboolean
+test_wait (gboolean (*done) (gpointer),
+           gpointer   data)
+{
+    GTimer *timer = g_timer_new ();
+    gboolean result;
+
+    while (!(result = done (data)) && g_timer_elapsed (timer, NULL) < TEST_TIMEOUT)
+        g_main_context_iteration (NULL, FALSE);
+
+    g_timer_destroy (timer);
+    return result;
+}
+
+static gboolean
+no_pending_cmds (MooApp *app)
+{
+    return app->priv->pending_cmds_id == 0;
+}
+
+static gstr
+test_create_file (const char *dir,
+                  const char *name)
+{
+    gstr filename = g::build_filename (dir, name);
+    TEST_ASSERT (g_file_set_contents (filename.get(), "text\n", -1, NULL));
+    return filename;
+}
+
+static void
+test_exec_msg (MooApp     *app,
+               const char *msg)
+{
+    moo_app_exec_cmd (app, msg[0], msg + 1, strlen (msg + 1));
+}
+
+static char *
+test_doc_text (MooEdit *doc)
+{
+    GtkTextBuffer *buffer = moo_edit_get_buffer (doc);
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+}
+
+/* requests from several clients in a row are handled together,
+ * and a script runs after the files sent before it */
+static void
+test_pending_cmds (void)
+{
+    MooApp *app = moo_app_instance ();
+    MooEditor *editor = moo_app_get_editor (app);
+    gstr dir = g::build_filename (moo_test_get_working_dir (), "app-work");
+    MooOpenInfoArray *files;
+    MooEdit *docs[3];
+    GString *msg;
+    char *script, *text;
+    mgw_errno_t err;
+    guint i;
+
+    TEST_ASSERT (_moo_mkdir_with_parents (dir.get(), &err) == 0);
+    gstr file1 = test_create_file (dir.get(), "one.txt");
+    gstr file2 = test_create_file (dir.get(), "two.txt");
+    gstr file3 = test_create_file (dir.get(), "three.txt");
+
+    files = moo_open_info_array_new ();
+    moo_open_info_array_take (files, moo_open_info_new (file1.get(), NULL, -1, MOO_OPEN_FLAGS_NONE));
+    moo_open_info_array_take (files, moo_open_info_new (file2.get(), NULL, -1, MOO_OPEN_FLAGS_NONE));
+    msg = make_open_files_msg (files, 0);
+    test_exec_msg (app, msg->str);
+    g_string_free (msg, TRUE);
+    moo_open_info_array_free (files);
+
+    files = moo_open_info_array_new ();
+    moo_open_info_array_take (files, moo_open_info_new (file3.get(), NULL, -1, MOO_OPEN_FLAGS_NONE));
+    msg = make_open_files_msg (files, 0);
+    test_exec_msg (app, msg->str);
+    g_string_free (msg, TRUE);
+    moo_open_info_array_free (files);
+
+    script = g_strdup_printf (CMD_SCRIPT_S "lua:editor.get_doc([[%s]]).set_text('script')", file3.get());
+    test_exec_msg (app, script);
+    g_free (script);
+
+    /* nothing happens right away; files are merged, the script waits */
+    TEST_ASSERT (moo_editor_get_doc (editor, file1.get()) == NULL);
+    TEST_ASSERT (app->priv->pending_cmds != NULL &&
+                 g_queue_get_length (app->priv->pending_cmds) == 2);
+
+    TEST_ASSERT (test_wait ((gboolean (*) (gpointer)) no_pending_cmds, app));
+
+    docs[0] = moo_editor_get_doc (editor, file1.get());
+    docs[1] = moo_editor_get_doc (editor, file2.get());
+    docs[2] = moo_editor_get_doc (editor, file3.get());
+
+    for (i = 0; i < G_N_ELEMENTS (docs); ++i)
+        TEST_ASSERT (docs[i] != NULL);
+
+    if (docs[0] && docs[1] && docs[2])
+    {
+        TEST_ASSERT (moo_edit_get_window (docs[1]) == moo_edit_get_window (docs[0]));
+        TEST_ASSERT (moo_edit_get_window (docs[2]) == moo_edit_get_window (docs[0]));
+
+        text = test_doc_text (docs[2]);
+        TEST_ASSERT_STR_EQ (text, "script");
+        g_free (text);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (docs); ++i)
+    {
+        if (docs[i])
+        {
+            moo_edit_set_modified (docs[i], FALSE);
+            TEST_ASSERT (moo_edit_close (docs[i]));
+        }
+    }
+
+    _moo_remove_dir (dir.get(), TRUE, NULL);
+}
+
+/* queued session writes end up in the file in order, and nothing
+ * besides the session file is left in its directory */
+static void
+test_session_writes (void)
+{
+    MooApp *app = moo_app_instance ();
+    char *saved_session_file = app->priv->session_file;
+    gstr dir = gstr::take (moo_get_user_cache_file ("session-test"));
+    gstr filename = g::build_filename (dir.get(), "session.xml");
+    char *text = NULL;
+    const char *name;
+    mgw_errno_t err;
+    GDir *gdir;
+    guint i;
+
+    _moo_remove_dir (dir.get(), TRUE, NULL);
+    TEST_ASSERT (_moo_mkdir_with_parents (dir.get(), &err) == 0);
+
+    app->priv->session_file = g_strdup ("session-test" G_DIR_SEPARATOR_S "session.xml");
+
+    for (i = 1; i <= 20; ++i)
+    {
+        char *session = g_strdup_printf ("<session>%u</session>\n", i);
+        queue_session_write (app, session);
+        g_free (session);
+    }
+
+    flush_session_writes ();
+
+    TEST_ASSERT (g_file_get_contents (filename.get(), &text, NULL, NULL));
+    TEST_ASSERT_STR_EQ (text, "<session>20</session>\n");
+    g_free (text);
+
+    if ((gdir = g_dir_open (dir.get(), 0, NULL)))
+    {
+        while ((name = g_dir_read_name (gdir)))
+            TEST_ASSERT_STR_EQ_MSG (name, "session.xml", "leftover file in %s", dir.get());
+        g_dir_close (gdir);
+    }
+    else
+    {
+        TEST_FAILED_MSG ("could not open %s", dir.get());
+    }
+
+    /* the last write wins, even if it removes the file */
+    queue_session_write (app, "<session>21</session>\n");
+    queue_session_write (app, NULL);
+    flush_session_writes ();
+    TEST_ASSERT (!g_file_test (filename.get(), G_FILE_TEST_EXISTS));
+
+    g_free (app->priv->session_file);
+    app->priv->session_file = saved_session_file;
+    _moo_remove_dir (dir.get(), TRUE, NULL);
+}
+
+#ifndef __WIN32__
+
+static struct {
+    GPtrArray *cmds;
+} ipc_test;
+
+static void
+ipc_test_callback (char        cmd,
+                   const char *data,
+                   gsize       len,
+                   G_GNUC_UNUSED gpointer cb_data)
+{
+    g_ptr_array_add (ipc_test.cmds, g_strdup_printf ("%c%.*s", cmd, (int) len, data));
+}
+
+static gboolean
+ipc_got_cmds (gpointer n)
+{
+    return ipc_test.cmds->len >= GPOINTER_TO_UINT (n);
+}
+
+static gboolean
+fd_readable (gpointer fdp)
+{
+    struct pollfd pfd;
+    pfd.fd = GPOINTER_TO_INT (fdp);
+    pfd.events = POLLIN;
+    return poll (&pfd, 1, 0) > 0;
+}
+
+static int
+ipc_connect (const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    addr.sun_family = AF_UNIX;
+    g_strlcpy (addr.sun_path, path, sizeof addr.sun_path);
+
+    fd = socket (PF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT (fd != -1);
+
+    if (fd != -1 && connect (fd, (struct sockaddr*) &addr, sizeof addr) == -1)
+    {
+        TEST_FAILED_MSG ("could not connect to %s", path);
+        close (fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+static int
+ipc_listen (const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    addr.sun_family = AF_UNIX;
+    g_strlcpy (addr.sun_path, path, sizeof addr.sun_path);
+    unlink (path);
+
+    fd = socket (PF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1 ||
+        bind (fd, (struct sockaddr*) &addr, sizeof addr) == -1 ||
+        listen (fd, 5) == -1)
+    {
+        TEST_FAILED_MSG ("could not listen on %s", path);
+        if (fd != -1)
+            close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void
+ipc_write (int         fd,
+           const char *data,
+           gsize       len)
+{
+    TEST_ASSERT (write (fd, data, len) == (gssize) len);
+}
+
+/* reads len bytes, or whatever comes before the other side closes */
+static GString *
+ipc_read (int   fd,
+          gsize len)
+{
+    GString *data = g_string_new (NULL);
+    char buf[256];
+    gssize n;
+
+    while (data->len < len &&
+           (n = read (fd, buf, MIN (sizeof buf, len - data->len))) > 0)
+        g_string_append_len (data, buf, n);
+
+    return data;
+}
+
+static GString *
+ipc_frame (const char *msg)
+{
+    GString *frame = g_string_new (NULL);
+    guint32 len = strlen (msg);
+
+    g_string_append_c (frame, (char) ((len >> 24) & 0xff));
+    g_string_append_c (frame, (char) ((len >> 16) & 0xff));
+    g_string_append_c (frame, (char) ((len >> 8) & 0xff));
+    g_string_append_c (frame, (char) (len & 0xff));
+    g_string_append (frame, msg);
+
+    return frame;
+}
+
+static void
+ipc_test_start (void)
+{
+    ipc_test.cmds = g_ptr_array_new ();
+    _moo_app_input_start (NULL, FALSE, ipc_test_callback, NULL);
+}
+
+static void
+ipc_test_stop (void)
+{
+    _moo_app_input_shutdown ();
+    g_ptr_array_foreach (ipc_test.cmds, (GFunc) g_free, NULL);
+    g_ptr_array_free (ipc_test.cmds, TRUE);
+    ipc_test.cmds = NULL;
+}
+
+#define IPC_CMD(i) ((const char*) ipc_test.cmds->pdata[i])
+
+/* what the running instance gets from clients: framed and
+ * acknowledged messages, or zero-terminated ones from old clients */
+static void
+test_ipc_receive (void)
+{
+    GString *frame, *data;
+    char c;
+    int fd;
+
+    ipc_test_start ();
+
+    if ((fd = ipc_connect (_moo_app_input_get_path ())) != -1)
+    {
+        TEST_ASSERT (test_wait (fd_readable, GINT_TO_POINTER (fd)));
+        data = ipc_read (fd, 1);
+        TEST_ASSERT (data->len == 1 && data->str[0] == MOO_APP_INPUT_HELLO);
+        g_string_free (data, TRUE);
+
+        /* two messages in one go, and one in two pieces */
+        frame = g_string_new (NULL);
+        g_string_append_c (frame, MOO_APP_INPUT_FRAMED);
+        data = ipc_frame ("eone");
+        g_string_append_len (frame, data->str, data->len);
+        g_string_free (data, TRUE);
+        data = ipc_frame ("Ftwo");
+        g_string_append_len (frame, data->str, data->len);
+        g_string_free (data, TRUE);
+        data = ipc_frame ("ethree");
+        g_string_append_len (frame, data->str, 6);
+        ipc_write (fd, frame->str, frame->len);
+        g_string_free (frame, TRUE);
+
+        TEST_ASSERT (test_wait (ipc_got_cmds, GUINT_TO_POINTER (2)));
+        TEST_ASSERT_INT_EQ (ipc_test.cmds->len, 2);
+        if (ipc_test.cmds->len >= 2)
+        {
+            TEST_ASSERT_STR_EQ (IPC_CMD (0), "eone");
+            TEST_ASSERT_STR_EQ (IPC_CMD (1), "Ftwo");
+        }
+
+        ipc_write (fd, data->str + 6, data->len - 6);
+        g_string_free (data, TRUE);
+        TEST_ASSERT (test_wait (ipc_got_cmds, GUINT_TO_POINTER (3)));
+        if (ipc_test.cmds->len >= 3)
+            TEST_ASSERT_STR_EQ (IPC_CMD (2), "ethree");
+
+        data = ipc_read (fd, 3);
+        TEST_ASSERT_INT_EQ (data->len, 3);
+        TEST_ASSERT (data->len == 3 &&
+                     data->str[0] == MOO_APP_INPUT_ACK &&
+                     data->str[1] == MOO_APP_INPUT_ACK &&
+                     data->str[2] == MOO_APP_INPUT_ACK);
+        g_string_free (data, TRUE);
+
+        /* garbage closes the connection */
+        TEST_EXPECT_WARNING (1, "%s", "message too long");
+        c = (char) 0xff;
+        ipc_write (fd, &c, 1);
+        ipc_write (fd, &c, 1);
+        ipc_write (fd, &c, 1);
+        ipc_write (fd, &c, 1);
+        TEST_ASSERT (test_wait (fd_readable, GINT_TO_POINTER (fd)));
+        TEST_ASSERT (read (fd, &c, 1) <= 0);
+        TEST_CHECK_WARNING ();
+
+        close (fd);
+    }
+
+    /* an old client does not wait for the greeting */
+    if ((fd = ipc_connect (_moo_app_input_get_path ())) != -1)
+    {
+        ipc_write (fd, "elegacy\0Fsecond\0", 16);
+        TEST_ASSERT (test_wait (ipc_got_cmds, GUINT_TO_POINTER (5)));
+        TEST_ASSERT_INT_EQ (ipc_test.cmds->len, 5);
+        if (ipc_test.cmds->len >= 5)
+        {
+            TEST_ASSERT_STR_EQ (IPC_CMD (3), "elegacy");
+            TEST_ASSERT_STR_EQ (IPC_CMD (4), "Fsecond");
+        }
+
+        /* it gets the greeting, which it ignores, and no acks */
+        data = ipc_read (fd, 1);
+        TEST_ASSERT (data->len == 1 && data->str[0] == MOO_APP_INPUT_HELLO);
+        g_string_free (data, TRUE);
+        close (fd);
+    }
+
+    ipc_test_stop ();
+}
+
+typedef struct {
+    const char *name;
+    const char *msg;
+    gboolean result;
+    volatile gint done;
+} IpcSendJob;
+
+static void
+ipc_send_job_run (IpcSendJob *job)
+{
+    job->result = _moo_app_input_send_msg (job->name, job->msg, -1);
+    g_atomic_int_set (&job->done, 1);
+}
+
+static gboolean
+ipc_send_job_done (IpcSendJob *job)
+{
+    return g_atomic_int_get (&job->done);
+}
+
+static void
+ipc_send_start (GThreadPool **pool,
+                IpcSendJob   *job,
+                const char   *name,
+                const char   *msg)
+{
+    job->name = name;
+    job->msg = msg;
+    job->result = FALSE;
+    job->done = 0;
+    *pool = g_thread_pool_new ((GFunc) ipc_send_job_run, NULL, 1, FALSE, NULL);
+    g_thread_pool_push (*pool, job, NULL);
+}
+
+/* what clients do: wait for the ack from a new instance, give up if
+ * it does not come, and use the old format with an old instance */
+static void
+test_ipc_send (void)
+{
+    GThreadPool *pool;
+    IpcSendJob job;
+    char *dir, *fake_path, *fake_name;
+    GString *data;
+    char hello = MOO_APP_INPUT_HELLO;
+    int fd, conn;
+
+    ipc_test_start ();
+
+    ipc_send_start (&pool, &job, _moo_get_pid_string (), "Fsent");
+    TEST_ASSERT (test_wait ((gboolean (*) (gpointer)) ipc_send_job_done, &job));
+    g_thread_pool_free (pool, FALSE, TRUE);
+    TEST_ASSERT (job.result);
+    TEST_ASSERT (test_wait (ipc_got_cmds, GUINT_TO_POINTER (1)));
+    if (ipc_test.cmds->len >= 1)
+        TEST_ASSERT_STR_EQ (IPC_CMD (0), "Fsent");
+
+    fake_name = g_strdup_printf ("%s-fake", _moo_get_pid_string ());
+    dir = g_path_get_dirname (_moo_app_input_get_path ());
+    fake_path = g_strdup_printf ("%s/in-%s", dir, fake_name);
+
+    /* an instance which takes the message and goes away */
+    if ((fd = ipc_listen (fake_path)) != -1)
+    {
+        ipc_send_start (&pool, &job, fake_name, "Fdropped");
+
+        if ((conn = accept (fd, NULL, NULL)) != -1)
+        {
+            ipc_write (conn, &hello, 1);
+            data = ipc_read (conn, 1 + 4 + strlen ("Fdropped"));
+            TEST_ASSERT (data->len > 5 && data->str[0] == MOO_APP_INPUT_FRAMED);
+            TEST_ASSERT (g_str_has_suffix (data->str, "Fdropped"));
+            g_string_free (data, TRUE);
+            close (conn);
+        }
+
+        g_thread_pool_free (pool, FALSE, TRUE);
+        TEST_ASSERT (!job.result);
+        close (fd);
+    }
+
+    /* an old instance, which does not greet clients */
+    if ((fd = ipc_listen (fake_path)) != -1)
+    {
+        ipc_send_start (&pool, &job, fake_name, "Fold");
+
+        if ((conn = accept (fd, NULL, NULL)) != -1)
+        {
+            data = ipc_read (conn, strlen ("Fold") + 1);
+            TEST_ASSERT_INT_EQ (data->len, strlen ("Fold") + 1);
+            TEST_ASSERT (data->len == 5 && memcmp (data->str, "Fold", 5) == 0);
+            g_string_free (data, TRUE);
+            close (conn);
+        }
+
+        g_thread_pool_free (pool, FALSE, TRUE);
+        TEST_ASSERT (job.result);
+        close (fd);
+    }
+
+    unlink (fake_path);
+    g_free (fake_path);
+    g_free (fake_name);
+    g_free (dir);
+
+    ipc_test_stop ();
+}
+
+#endif /* !__WIN32__ */
+
+void
+moo_test_mooapp (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("MooApp", "mooapp/mooapp.cpp", NULL, NULL, NULL);
+
+    moo_test_suite_add_test (suite, "pending-cmds", "requests from other instances",
+                             (MooTestFunc) test_pending_cmds, NULL);
+    moo_test_suite_add_test (suite, "session-writes", "writing session files in background",
+                             (MooTestFunc) test_session_writes, NULL);
+#ifndef __WIN32__
+    moo_test_suite_add_test (suite, "ipc-receive", "messages from other instances",
+                             (MooTestFunc) test_ipc_receive, NULL);
+    moo_test_suite_add_test (suite, "ipc-send", "sending messages to other instances",
+                             (MooTestFunc) test_ipc_send, NULL);
+#endif
+}
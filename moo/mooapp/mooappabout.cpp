@@ -19,6 +19,7 @@
 #include "mooapp-info.h"
 #include "moohtml.h"
 #include "moolinklabel.h"
+#include "mooedit/mooplugin.h"
 #include "mooutils/moostock.h"
 #include "mooutils/mooutils-misc.h"
 #include "mooutils/mooglade.h"
@@ -270,5 +271,9 @@ moo_app_get_system_info (MooApp *app)
     g_string_append (text, "Broken gtk theme: yes\n");
 #endif
 
+    string = _moo_plugin_get_stats ();
+    g_string_append_printf (text, "Plugins:\n%s", string);
+    g_free (string);
+
     return g_string_free (text, FALSE);
 }
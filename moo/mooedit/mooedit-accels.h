@@ -82,4 +82,8 @@
 
 #define MOO_EDIT_ACCEL_COMPLETE "<Ctrl>Space"
 
+#define MOO_EDIT_ACCEL_GOTO_DEFINITION "F12"
+#define MOO_EDIT_ACCEL_GOTO_SYMBOL MOO_ACCEL_CTRL "<Shift>T"
+#define MOO_EDIT_ACCEL_QUICK_OPEN MOO_ACCEL_CTRL "<Alt>O"
+
 #endif /* MOO_EDIT_ACCELS_H */
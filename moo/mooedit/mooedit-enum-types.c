@@ -57,6 +57,7 @@ moo_edit_state_get_type (void)
             { MOO_EDIT_STATE_LOADING, (char*) "MOO_EDIT_STATE_LOADING", (char*) "loading" },
             { MOO_EDIT_STATE_SAVING, (char*) "MOO_EDIT_STATE_SAVING", (char*) "saving" },
             { MOO_EDIT_STATE_PRINTING, (char*) "MOO_EDIT_STATE_PRINTING", (char*) "printing" },
+            { MOO_EDIT_STATE_RUNNING, (char*) "MOO_EDIT_STATE_RUNNING", (char*) "running" },
             { 0, NULL, NULL }
         };
 
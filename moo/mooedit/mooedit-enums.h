@@ -31,7 +31,8 @@ typedef enum {
     MOO_EDIT_STATE_NORMAL,
     MOO_EDIT_STATE_LOADING,
     MOO_EDIT_STATE_SAVING,
-    MOO_EDIT_STATE_PRINTING
+    MOO_EDIT_STATE_PRINTING,
+    MOO_EDIT_STATE_RUNNING
 } MooEditState;
 
 typedef enum {
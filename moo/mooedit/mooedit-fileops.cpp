@@ -24,6 +24,7 @@
 #include "mooedit/mooeditdialogs.h"
 #include "mooedit/mootextbuffer.h"
 #include "mooedit/mooeditprefs.h"
+#include "mooedit/mooplugin.h"
 #include "mooutils/moofileicon.h"
 #include "mooutils/moofilewatch.h"
 #include "mooutils/mooencodings.h"
@@ -32,6 +33,9 @@
 #include "mooutils/mooutils.h"
 #include "mooutils/mooutils-fs.h"
 #include "mooutils/moocompat.h"
+#include "mooutils/mooutils-thread.h"
+#include "mooutils/mooutils-debug.h"
+#include "mooutils/mootrace.h"
 #include <string.h>
 #include <sys/types.h>
 #include <fcntl.h>
@@ -44,6 +48,14 @@
 
 #define ENCODING_LOCALE "LOCALE"
 
+/* how long to collect documents changed on disk before reloading them */
+#define RELOAD_DELAY            100
+#define RELOAD_MAX_WORKERS      8
+/* texts differing in more lines are replaced as a whole */
+#define DIFF_MAX_EDITS          1000
+
+MOO_DEBUG_INIT(reload, FALSE)
+
 MOO_DEFINE_QUARK (MooEditFileErrorQuark, _moo_edit_file_error_quark)
 
 static GSList *UNTITLED = NULL;
@@ -57,10 +69,16 @@ static void     file_deleted                (MooEdit        *edit);
 static void     add_status                  (MooEdit        *edit,
                                              MooEditStatus   s);
 
-static void     moo_edit_load_text          (MooEdit        *edit,
+static void     queue_reload                (MooEdit        *edit);
+static void     moo_edit_reload_text        (MooEdit        *edit,
                                              GFile          *file,
                                              const char     *encoding,
                                              const char     *text);
+static void     moo_edit_load_text          (MooEdit        *edit,
+                                             GFile          *file,
+                                             const char     *encoding,
+                                             const char     *text,
+                                             gsize           size);
 static gboolean moo_edit_reload_local       (MooEdit        *edit,
                                              const char     *encoding,
                                              GError        **error);
@@ -201,12 +219,13 @@ convert_file_data_to_utf8_with_prompt (const char *data,
     return text_utf8;
 }
 
-gboolean
-_moo_edit_load_file (MooEdit      *edit,
-                     GFile        *file,
-                     const char   *encoding,
-                     const char   *cached_encoding,
-                     GError      **error)
+static gboolean
+load_file (MooEdit      *edit,
+           GFile        *file,
+           const char   *encoding,
+           const char   *cached_encoding,
+           gboolean      in_place,
+           GError      **error)
 {
     char *freeme1 = NULL;
     char *freeme2 = NULL;
@@ -221,6 +240,10 @@ _moo_edit_load_file (MooEdit      *edit,
     moo_return_error_if_fail (G_IS_FILE (file));
     moo_return_error_if_fail (!MOO_EDIT_IS_BUSY (edit));
 
+    char *trace_detail = MOO_TRACE_ENABLED () ? g_file_get_parse_name (file) : NULL;
+    MooTraceScope trace_scope (in_place ? "file reload" : "file load", trace_detail);
+    g_free (trace_detail);
+
     encoding = freeme1 = g_strdup (normalize_encoding (encoding, FALSE));
     cached_encoding = freeme2 = cached_encoding ? g_strdup (normalize_encoding (cached_encoding, FALSE)) : NULL;
 
@@ -237,7 +260,15 @@ _moo_edit_load_file (MooEdit      *edit,
         goto done;
     }
 
-    moo_edit_load_text (edit, file, used_encoding, data_utf8);
+    /* a large file would be in memory three times otherwise */
+    g_free (data);
+    data = NULL;
+
+    /* diffing large files takes longer than loading them anew */
+    if (in_place && !_moo_edit_size_is_large (data_len, 0))
+        moo_edit_reload_text (edit, file, used_encoding, data_utf8);
+    else
+        moo_edit_load_text (edit, file, used_encoding, data_utf8, data_len);
     result = TRUE;
 
 done:
@@ -255,6 +286,16 @@ done:
     return result;
 }
 
+gboolean
+_moo_edit_load_file (MooEdit      *edit,
+                     GFile        *file,
+                     const char   *encoding,
+                     const char   *cached_encoding,
+                     GError      **error)
+{
+    return load_file (edit, file, encoding, cached_encoding, FALSE, error);
+}
+
 
 gboolean
 _moo_edit_reload_file (MooEdit    *edit,
@@ -383,24 +424,26 @@ moo_edit_set_line_end_type (MooEdit        *edit,
 static void do_load_text    (MooEdit    *edit,
                              const char *text);
 
-static GSList *
-get_encodings (void)
+/* The encodings pref with the locale resolved and duplicates removed */
+static char **
+parse_encodings (void)
 {
     const char *encodings;
     char **raw, **p;
-    GSList *result;
+    GPtrArray *result;
 
     encodings = moo_prefs_get_string (moo_edit_setting (MOO_EDIT_PREFS_ENCODINGS));
 
     if (!encodings || !encodings[0])
         encodings = _moo_get_default_encodings ();
 
-    result = NULL;
+    result = g_ptr_array_new ();
     raw = g_strsplit (encodings, ",", 0);
 
     for (p = raw; p && *p; ++p)
     {
         const char *enc;
+        guint i;
 
         if (!g_ascii_strcasecmp (*p, ENCODING_LOCALE))
         {
@@ -412,18 +455,49 @@ get_encodings (void)
             enc = *p;
         }
 
-        if (!g_slist_find_custom (result, enc, (GCompareFunc) g_ascii_strcasecmp))
-            result = g_slist_prepend (result, g_strdup (enc));
+        for (i = 0; i < result->len; ++i)
+            if (!g_ascii_strcasecmp ((const char*) result->pdata[i], enc))
+                break;
+
+        if (i == result->len)
+            g_ptr_array_add (result, g_strdup (enc));
     }
 
-    if (!result)
+    if (result->len == 0)
     {
         g_critical ("oops");
-        result = g_slist_prepend (NULL, g_strdup ("UTF-8"));
+        g_ptr_array_add (result, g_strdup ("UTF-8"));
     }
 
+    g_ptr_array_add (result, NULL);
     g_strfreev (raw);
-    return g_slist_reverse (result);
+    return (char**) g_ptr_array_free (result, FALSE);
+}
+
+/* Parsed encodings pref, rebuilt when the pref changes. Used on the
+ * main thread only, worker threads decode files whose encoding is
+ * already known. */
+static char **encodings_cache;
+
+static void
+encodings_pref_changed (G_GNUC_UNUSED const char *key,
+                        G_GNUC_UNUSED gpointer    data)
+{
+    g_strfreev (encodings_cache);
+    encodings_cache = parse_encodings ();
+}
+
+static const char * const *
+get_encodings (void)
+{
+    if (G_UNLIKELY (!encodings_cache))
+    {
+        moo_prefs_notify_connect (moo_edit_setting (MOO_EDIT_PREFS_ENCODINGS),
+                                  encodings_pref_changed, NULL, NULL);
+        encodings_cache = parse_encodings ();
+    }
+
+    return (const char * const *) encodings_cache;
 }
 
 
@@ -454,25 +528,42 @@ check_regular (GFile   *file,
     return retval;
 }
 
+/* Whether the document goes into large file mode when it gets large
+ * text from file, see _moo_edit_leave_large_file() */
+static gboolean
+large_file_mode_wanted (MooEdit  *edit,
+                        GFile    *file,
+                        gboolean  large)
+{
+    return large && !(edit->priv->large_file_declined &&
+                      edit->priv->file != NULL && file != NULL &&
+                      g_file_equal (edit->priv->file, file));
+}
+
 static void
 moo_edit_load_text (MooEdit    *edit,
                     GFile      *file,
                     const char *encoding,
-                    const char *text)
+                    const char *text,
+                    gsize       size)
 {
     GtkTextIter start;
     GtkTextBuffer *buffer;
     gboolean undo;
+    gboolean large;
     char *freeme = NULL;
     MooLineEndType saved_le;
 
-    if (moo_edit_is_empty (edit))
+    buffer = moo_edit_get_buffer (edit);
+    large = _moo_edit_size_is_large (size, 0);
+
+    /* a document restored lazily from session has a file but no text yet;
+     * undo of loading a large file would need another copy of it */
+    if (moo_edit_is_empty (edit) || edit->priv->load_pending || large)
         undo = FALSE;
     else
         undo = TRUE;
 
-    buffer = moo_edit_get_buffer (edit);
-
     block_buffer_signals (edit);
 
     if (undo)
@@ -491,7 +582,17 @@ moo_edit_load_text (MooEdit    *edit,
         g_object_get (buffer, "highlight-syntax", &enable_highlight, (char*) 0);
         g_object_set (buffer, "highlight-syntax", FALSE, (char*) 0);
         do_load_text (edit, text);
-        g_object_set (buffer, "highlight-syntax", enable_highlight, (char*) 0);
+
+        if (!large)
+            large = _moo_edit_size_is_large (0, gtk_text_buffer_get_line_count (buffer));
+
+        large = large_file_mode_wanted (edit, file, large);
+
+        /* switching the mode turns highlighting on or off as needed */
+        if (!large != !_moo_edit_is_large_file (edit))
+            _moo_edit_set_large_file (edit, large);
+        else
+            g_object_set (buffer, "highlight-syntax", enable_highlight, (char*) 0);
     }
 
     unblock_buffer_signals (edit);
@@ -505,6 +606,8 @@ moo_edit_load_text (MooEdit    *edit,
 
     gtk_text_buffer_get_start_iter (buffer, &start);
     gtk_text_buffer_place_cursor (buffer, &start);
+    edit->priv->load_pending = false;
+    edit->priv->load_failed = false;
     edit->priv->status = (MooEditStatus) 0;
     moo_edit_set_modified (edit, FALSE);
     _moo_edit_set_file (edit, file, encoding);
@@ -516,11 +619,12 @@ moo_edit_load_text (MooEdit    *edit,
 }
 
 
-static void
-do_load_text (MooEdit    *edit,
-              const char *text)
+/* Converts line ends to \n, returns the line end type used in the text.
+ * May be called from any thread. */
+static char *
+normalize_line_ends (const char     *text,
+                     MooLineEndType *le_p)
 {
-    GtkTextBuffer *buffer;
     MooLineEndType le = MOO_LE_NONE;
     gboolean mixed_le = FALSE;
     const char *line = NULL;
@@ -530,7 +634,6 @@ do_load_text (MooEdit    *edit,
     GString *strbuf;
 
     strbuf = g_string_new (NULL);
-    buffer = moo_edit_get_buffer (edit);
 
     moo_line_reader_init (&lr, text, -1);
 
@@ -584,15 +687,28 @@ do_load_text (MooEdit    *edit,
             g_string_append_c (strbuf, '\n');
     }
 
-    gtk_text_buffer_insert_at_cursor (buffer, strbuf->str, (int) strbuf->len);
-
     if (mixed_le)
         le = MOO_LE_NATIVE;
 
+    *le_p = le;
+    return g_string_free (strbuf, FALSE);
+}
+
+static void
+do_load_text (MooEdit    *edit,
+              const char *text)
+{
+    MooLineEndType le;
+    char *norm_text;
+
+    norm_text = normalize_line_ends (text, &le);
+
+    gtk_text_buffer_insert_at_cursor (moo_edit_get_buffer (edit), norm_text, -1);
+
     if (le != MOO_LE_NONE)
         moo_edit_set_line_end_type_full (edit, le, TRUE);
 
-    g_string_free (strbuf, TRUE);
+    g_free (norm_text);
 }
 
 
@@ -608,10 +724,15 @@ moo_edit_reload_local (MooEdit    *edit,
     file = moo_edit_get_file (edit);
     moo_return_error_if_fail (G_IS_FILE (file));
 
-    result = _moo_edit_load_file (edit, file,
-                                  encoding ? encoding : edit->priv->encoding,
-                                  NULL,
-                                  error);
+    /* replace only the changed lines if there is any text, so that marks
+     * and highlighting in the rest of the document are kept; large files
+     * are not worth diffing */
+    result = load_file (edit, file,
+                        encoding ? encoding : edit->priv->encoding,
+                        NULL,
+                        !edit->priv->load_pending && !edit->priv->large_file &&
+                            !moo_edit_is_empty (edit),
+                        error);
 
     if (result)
     {
@@ -626,6 +747,750 @@ moo_edit_reload_local (MooEdit    *edit,
 }
 
 
+/***************************************************************************/
+/* Reloading in place
+ */
+
+typedef struct {
+    const char *start;
+    gsize len; /* including the line terminator */
+    guint hash;
+} DiffLine;
+
+typedef struct {
+    int a_start;
+    int a_end;
+    int b_start;
+    int b_end;
+} DiffRange;
+
+/* a range of the old text replaced with a piece of the new one */
+typedef struct {
+    int old_start;   /* character offsets in the old text */
+    int old_end;
+    gsize new_start; /* byte offsets in the new text */
+    gsize new_len;
+} DiffHunk;
+
+typedef struct {
+    char *text; /* new text, line ends converted */
+    MooLineEndType le;
+    GArray *hunks; /* DiffHunk, sorted */
+} ReloadDiff;
+
+static GArray *
+split_lines (const char *text)
+{
+    GArray *lines = g_array_new (FALSE, FALSE, sizeof (DiffLine));
+
+    while (*text)
+    {
+        const char *nl = strchr (text, '\n');
+        DiffLine line;
+        gsize i;
+
+        line.start = text;
+        line.len = nl ? (gsize) (nl - text) + 1 : strlen (text);
+        line.hash = 5381;
+        for (i = 0; i < line.len; ++i)
+            line.hash = line.hash * 33 + (guchar) text[i];
+
+        g_array_append_val (lines, line);
+        text += line.len;
+    }
+
+    return lines;
+}
+
+static gboolean
+lines_equal (const DiffLine *l1,
+             const DiffLine *l2)
+{
+    return l1->hash == l2->hash && l1->len == l2->len &&
+           memcmp (l1->start, l2->start, l1->len) == 0;
+}
+
+/* ranges are found from the end of the text, adjacent ones are merged */
+static void
+add_range (GArray *ranges,
+           int     a_start,
+           int     a_end,
+           int     b_start,
+           int     b_end)
+{
+    DiffRange *last = ranges->len ? &g_array_index (ranges, DiffRange, ranges->len - 1) : NULL;
+
+    if (last && last->a_start == a_end && last->b_start == b_end)
+    {
+        last->a_start = a_start;
+        last->b_start = b_start;
+    }
+    else
+    {
+        DiffRange r = { a_start, a_end, b_start, b_end };
+        g_array_append_val (ranges, r);
+    }
+}
+
+/* Myers' O(ND) diff of a[0..n) and b[0..m), appends changed ranges
+ * in reverse order. Returns FALSE if the texts differ in more than
+ * DIFF_MAX_EDITS lines. */
+static gboolean
+diff_lines (const DiffLine *a,
+            int             n,
+            const DiffLine *b,
+            int             m,
+            GArray         *ranges)
+{
+    int max = MIN (n + m, DIFF_MAX_EDITS);
+    int offset = max + 1;
+    GPtrArray *trace;
+    int *v;
+    int d, k, x, y;
+    gboolean found = FALSE;
+    guint i;
+
+    v = g_new0 (int, 2 * max + 3);
+    trace = g_ptr_array_new ();
+
+    for (d = 0; d <= max && !found; ++d)
+    {
+        /* backtracking through step d looks at v[-d-1 .. d+1] as it was
+         * before the step */
+        int *saved = g_new (int, 2 * d + 3);
+        memcpy (saved, v + offset - d - 1, (2 * d + 3) * sizeof (int));
+        g_ptr_array_add (trace, saved);
+
+        for (k = -d; k <= d; k += 2)
+        {
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                x = v[offset + k + 1];
+            else
+                x = v[offset + k - 1] + 1;
+
+            y = x - k;
+
+            while (x < n && y < m && lines_equal (&a[x], &b[y]))
+                x++, y++;
+
+            v[offset + k] = x;
+
+            if (x >= n && y >= m)
+            {
+                found = TRUE;
+                break;
+            }
+        }
+    }
+
+    if (found)
+    {
+        x = n;
+        y = m;
+
+        for (d = (int) trace->len - 1; d >= 0; --d)
+        {
+            int *tv = (int*) trace->pdata[d] + d + 1;
+            int prev_k, prev_x, prev_y;
+
+            k = x - y;
+
+            if (k == -d || (k != d && tv[k - 1] < tv[k + 1]))
+                prev_k = k + 1;
+            else
+                prev_k = k - 1;
+
+            prev_x = tv[prev_k];
+            prev_y = prev_x - prev_k;
+
+            while (x > prev_x && y > prev_y)
+                x--, y--;
+
+            if (d > 0)
+            {
+                if (x == prev_x)
+                    add_range (ranges, x, x, prev_y, y);
+                else
+                    add_range (ranges, prev_x, x, y, y);
+            }
+
+            x = prev_x;
+            y = prev_y;
+        }
+    }
+
+    for (i = 0; i < trace->len; ++i)
+        g_free (trace->pdata[i]);
+    g_ptr_array_free (trace, TRUE);
+    g_free (v);
+
+    return found;
+}
+
+/* May be called from any thread */
+static void
+reload_diff_compute (ReloadDiff *diff,
+                     const char *old_text,
+                     const char *new_text)
+{
+    GArray *old_lines, *new_lines, *ranges;
+    const DiffLine *a, *b;
+    int n, m, prefix, suffix;
+    int line, chars;
+    guint i;
+
+    diff->text = normalize_line_ends (new_text, &diff->le);
+    diff->hunks = g_array_new (FALSE, FALSE, sizeof (DiffHunk));
+
+    old_lines = split_lines (old_text);
+    new_lines = split_lines (diff->text);
+    a = (const DiffLine*) old_lines->data;
+    b = (const DiffLine*) new_lines->data;
+    n = old_lines->len;
+    m = new_lines->len;
+
+    for (prefix = 0; prefix < n && prefix < m && lines_equal (&a[prefix], &b[prefix]); ++prefix) ;
+    for (suffix = 0; suffix < n - prefix && suffix < m - prefix &&
+                     lines_equal (&a[n - suffix - 1], &b[m - suffix - 1]); ++suffix) ;
+
+    ranges = g_array_new (FALSE, FALSE, sizeof (DiffRange));
+
+    if (!diff_lines (a + prefix, n - prefix - suffix,
+                     b + prefix, m - prefix - suffix,
+                     ranges))
+    {
+        g_array_set_size (ranges, 0);
+        if (n - prefix - suffix > 0 || m - prefix - suffix > 0)
+            add_range (ranges, 0, n - prefix - suffix, 0, m - prefix - suffix);
+    }
+
+    /* ranges are in reverse order, convert lines to offsets walking
+     * the old text once */
+    line = 0;
+    chars = 0;
+
+    for (i = ranges->len; i-- > 0; )
+    {
+        DiffRange *r = &g_array_index (ranges, DiffRange, i);
+        const char *b_start, *b_end;
+        DiffHunk hunk;
+
+        for ( ; line < prefix + r->a_start; ++line)
+            chars += (int) g_utf8_strlen (a[line].start, a[line].len);
+        hunk.old_start = chars;
+        for ( ; line < prefix + r->a_end; ++line)
+            chars += (int) g_utf8_strlen (a[line].start, a[line].len);
+        hunk.old_end = chars;
+
+        b_start = prefix + r->b_start < m ? b[prefix + r->b_start].start : diff->text + strlen (diff->text);
+        b_end = prefix + r->b_end < m ? b[prefix + r->b_end].start : diff->text + strlen (diff->text);
+        hunk.new_start = (gsize) (b_start - diff->text);
+        hunk.new_len = (gsize) (b_end - b_start);
+
+        g_array_append_val (diff->hunks, hunk);
+    }
+
+    g_array_free (ranges, TRUE);
+    g_array_free (new_lines, TRUE);
+    g_array_free (old_lines, TRUE);
+}
+
+static void
+reload_diff_clear (ReloadDiff *diff)
+{
+    g_free (diff->text);
+    if (diff->hunks)
+        g_array_free (diff->hunks, TRUE);
+    diff->text = NULL;
+    diff->hunks = NULL;
+}
+
+static char *
+get_buffer_text (MooEdit *edit)
+{
+    GtkTextBuffer *buffer = moo_edit_get_buffer (edit);
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    return gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+}
+
+/* Replaces the changed hunks as one user action, the rest of the buffer
+ * is not touched. Large texts are handled like in moo_edit_load_text():
+ * they are not kept for undo and switch the document into large file
+ * mode. */
+static void
+moo_edit_apply_diff (MooEdit    *edit,
+                     GFile      *file,
+                     const char *encoding,
+                     ReloadDiff *diff)
+{
+    GtkTextBuffer *buffer;
+    MooLineEndType saved_le;
+    gboolean undo, large, enable_highlight;
+    guint i;
+
+    buffer = moo_edit_get_buffer (edit);
+    saved_le = edit->priv->line_end_type;
+    large = _moo_edit_size_is_large (strlen (diff->text), 0);
+    undo = !large;
+
+    block_buffer_signals (edit);
+
+    if (undo)
+        gtk_text_buffer_begin_user_action (buffer);
+    else
+        moo_text_buffer_begin_non_undoable_action (MOO_TEXT_BUFFER (buffer));
+
+    moo_text_buffer_begin_non_interactive_action (MOO_TEXT_BUFFER (buffer));
+
+    g_object_get (buffer, "highlight-syntax", &enable_highlight, (char*) 0);
+    if (large)
+        g_object_set (buffer, "highlight-syntax", FALSE, (char*) 0);
+
+    /* from the end, so that offsets of the remaining hunks stay valid */
+    for (i = diff->hunks->len; i-- > 0; )
+    {
+        DiffHunk *hunk = &g_array_index (diff->hunks, DiffHunk, i);
+        GtkTextIter start, end;
+
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, hunk->old_start);
+
+        if (hunk->old_end > hunk->old_start)
+        {
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, hunk->old_end);
+            gtk_text_buffer_delete (buffer, &start, &end);
+        }
+
+        if (hunk->new_len > 0)
+            gtk_text_buffer_insert (buffer, &start, diff->text + hunk->new_start, (int) hunk->new_len);
+    }
+
+    if (!large)
+        large = _moo_edit_size_is_large (0, gtk_text_buffer_get_line_count (buffer));
+
+    large = large_file_mode_wanted (edit, file, large);
+
+    /* switching the mode turns highlighting on or off as needed */
+    if (!large != !_moo_edit_is_large_file (edit))
+        _moo_edit_set_large_file (edit, large);
+    else
+        g_object_set (buffer, "highlight-syntax", enable_highlight, (char*) 0);
+
+    if (diff->le != MOO_LE_NONE)
+        moo_edit_set_line_end_type_full (edit, diff->le, TRUE);
+
+    moo_text_buffer_end_non_interactive_action (MOO_TEXT_BUFFER (buffer));
+
+    if (undo)
+        gtk_text_buffer_end_user_action (buffer);
+    else
+        moo_text_buffer_end_non_undoable_action (MOO_TEXT_BUFFER (buffer));
+
+    unblock_buffer_signals (edit);
+
+    edit->priv->load_failed = false;
+    edit->priv->status = (MooEditStatus) 0;
+    moo_edit_set_modified (edit, FALSE);
+    _moo_edit_set_file (edit, file, encoding);
+    if (edit->priv->line_end_type != saved_le)
+        g_object_notify (G_OBJECT (edit), "line-end-type");
+    _moo_edit_start_file_watch (edit);
+}
+
+static void
+moo_edit_reload_text (MooEdit    *edit,
+                      GFile      *file,
+                      const char *encoding,
+                      const char *text)
+{
+    ReloadDiff diff;
+    char *old_text;
+
+    old_text = get_buffer_text (edit);
+    reload_diff_compute (&diff, old_text, text);
+
+    moo_edit_apply_diff (edit, file, encoding, &diff);
+
+    reload_diff_clear (&diff);
+    g_free (old_text);
+}
+
+
+/***************************************************************************/
+/* Reloading documents changed on disk
+ */
+
+typedef struct {
+    MooEdit *doc;
+    GFile *file;
+    char *path;
+    char *encoding;
+    guint change_stamp;
+    char *old_text;
+    ReloadDiff diff;
+    char *used_encoding;
+    gboolean failed;
+} ReloadItem;
+
+typedef struct {
+    GPtrArray *items;
+} ReloadJob;
+
+static struct {
+    MooEditArray *queue;
+    guint queue_id;
+    gboolean job_running;
+} reload_data;
+
+static void
+reload_item_free (ReloadItem *item)
+{
+    g_object_unref (item->doc);
+    g_object_unref (item->file);
+    g_free (item->path);
+    g_free (item->encoding);
+    g_free (item->old_text);
+    g_free (item->used_encoding);
+    reload_diff_clear (&item->diff);
+    g_free (item);
+}
+
+static void
+reload_job_free (ReloadJob *job)
+{
+    guint i;
+    for (i = 0; i < job->items->len; ++i)
+        reload_item_free ((ReloadItem*) job->items->pdata[i]);
+    g_ptr_array_free (job->items, TRUE);
+    g_free (job);
+}
+
+/* runs in a worker thread */
+static void
+reload_item_run (ReloadItem *item,
+                 G_GNUC_UNUSED gpointer data)
+{
+    char *contents = NULL;
+    char *text_utf8;
+    gsize len;
+
+    if (!g_file_get_contents (item->path, &contents, &len, NULL))
+    {
+        item->failed = TRUE;
+        return;
+    }
+
+    text_utf8 = moo_convert_file_data_to_utf8 (contents, len, item->encoding, NULL, &item->used_encoding);
+
+    if (!text_utf8)
+        item->failed = TRUE;
+    else
+        reload_diff_compute (&item->diff, item->old_text, text_utf8);
+
+    g_free (text_utf8);
+    g_free (contents);
+}
+
+static guint get_reload_event_id (void);
+
+/* runs in a thread */
+static gboolean
+reload_job_run (ReloadJob *job)
+{
+    guint n_workers = RELOAD_MAX_WORKERS;
+    GThreadPool *pool;
+    guint i;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+    n_workers = CLAMP (g_get_num_processors (), 1, RELOAD_MAX_WORKERS);
+#endif
+
+    pool = g_thread_pool_new ((GFunc) reload_item_run, NULL,
+                              MIN (n_workers, job->items->len), TRUE, NULL);
+
+    for (i = 0; i < job->items->len; ++i)
+        g_thread_pool_push (pool, job->items->pdata[i], NULL);
+
+    /* waits for all files to be processed */
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+    _moo_event_queue_push (get_reload_event_id (), job,
+                           (GDestroyNotify) reload_job_free);
+    return FALSE;
+}
+
+/* The document may be reloaded on a worker thread if it's a local
+ * unmodified file with known encoding, otherwise it goes through
+ * moo_edit_reload() */
+static gboolean
+can_reload_in_place (MooEdit *doc)
+{
+    return !MOO_EDIT_IS_BUSY (doc) &&
+           !doc->priv->load_pending &&
+           !moo_edit_is_modified (doc) &&
+           !doc->priv->large_file &&
+           doc->priv->file != NULL &&
+           normalize_encoding (doc->priv->encoding, FALSE) != NULL;
+}
+
+static void
+reload_item_apply (ReloadItem *item)
+{
+    MooEdit *doc = item->doc;
+
+    if (!moo_edit_list_find (_moo_edit_instances, doc))
+        return;
+
+    if (item->failed ||
+        item->change_stamp != doc->priv->change_stamp ||
+        !can_reload_in_place (doc) ||
+        !g_file_equal (item->file, doc->priv->file))
+    {
+        moo_dmsg ("reloading %s", doc->priv->filename);
+        moo_edit_reload (doc, NULL, NULL);
+        return;
+    }
+
+    if (item->diff.hunks->len == 0)
+    {
+        /* nothing changed, e.g. the file was touched */
+        _moo_edit_start_file_watch (doc);
+        return;
+    }
+
+    moo_edit_apply_diff (doc, item->file, item->used_encoding, &item->diff);
+}
+
+static gboolean start_reload_job (void);
+
+static void
+reload_jobs_done (GList *events,
+                  G_GNUC_UNUSED gpointer data)
+{
+    for ( ; events != NULL; events = events->next)
+    {
+        ReloadJob *job = (ReloadJob*) events->data;
+        guint i;
+
+        for (i = 0; i < job->items->len; ++i)
+            reload_item_apply ((ReloadItem*) job->items->pdata[i]);
+
+        moo_dmsg ("reloaded %u documents", job->items->len);
+    }
+
+    reload_data.job_running = FALSE;
+
+    if (!moo_edit_array_is_empty (reload_data.queue) && !reload_data.queue_id)
+        reload_data.queue_id = g_timeout_add (RELOAD_DELAY, (GSourceFunc) start_reload_job, NULL);
+}
+
+static guint
+get_reload_event_id (void)
+{
+    static guint event_id;
+
+    if (!event_id)
+        event_id = _moo_event_queue_connect ((MooEventQueueCallback) reload_jobs_done,
+                                             NULL, NULL);
+
+    return event_id;
+}
+
+static gboolean
+start_reload_job (void)
+{
+    MooEditArray *docs;
+    MooAsyncJob *async_job;
+    ReloadJob *job;
+    guint i;
+
+    reload_data.queue_id = 0;
+
+    /* reload_jobs_done() starts the next one */
+    if (reload_data.job_running)
+        return FALSE;
+
+    docs = reload_data.queue;
+    reload_data.queue = NULL;
+
+    job = g_new0 (ReloadJob, 1);
+    job->items = g_ptr_array_new ();
+
+    for (i = 0; i < docs->n_elms; ++i)
+    {
+        MooEdit *doc = docs->elms[i];
+        ReloadItem *item;
+
+        if (!moo_edit_list_find (_moo_edit_instances, doc))
+            continue;
+
+        if (!can_reload_in_place (doc) || !g_file_is_native (doc->priv->file))
+        {
+            moo_edit_reload (doc, NULL, NULL);
+            continue;
+        }
+
+        item = g_new0 (ReloadItem, 1);
+        item->doc = MOO_EDIT (g_object_ref (doc));
+        item->file = g_file_dup (doc->priv->file);
+        item->path = g_file_get_path (item->file);
+        item->encoding = g_strdup (doc->priv->encoding);
+        item->change_stamp = doc->priv->change_stamp;
+        item->old_text = get_buffer_text (doc);
+        g_ptr_array_add (job->items, item);
+    }
+
+    moo_edit_array_free (docs);
+
+    if (job->items->len == 0)
+    {
+        reload_job_free (job);
+        return FALSE;
+    }
+
+    reload_data.job_running = TRUE;
+
+    get_reload_event_id ();
+    async_job = moo_async_job_new ((MooAsyncJobCallback) reload_job_run, job, NULL);
+    moo_async_job_start (async_job);
+    g_object_unref (async_job);
+
+    return FALSE;
+}
+
+/* Documents changed on disk are collected for a little while and then
+ * read, decoded and compared to the buffer text on worker threads, so
+ * that e.g. switching branches in a repository with many open files
+ * does not block. */
+static void
+queue_reload (MooEdit *edit)
+{
+    edit->priv->modified_on_disk = FALSE;
+
+    if (!reload_data.queue)
+        reload_data.queue = moo_edit_array_new ();
+
+    if (moo_edit_array_find (reload_data.queue, edit) < 0)
+        moo_edit_array_append (reload_data.queue, edit);
+
+    if (!reload_data.queue_id && !reload_data.job_running)
+        reload_data.queue_id = g_timeout_add (RELOAD_DELAY, (GSourceFunc) start_reload_job, NULL);
+}
+
+
+/***************************************************************************/
+/* Lazy loading
+ */
+
+void
+_moo_edit_set_load_pending (MooEdit    *edit,
+                            GFile      *file,
+                            const char *encoding,
+                            const char *cached_encoding,
+                            int         line)
+{
+    g_return_if_fail (MOO_IS_EDIT (edit));
+    g_return_if_fail (G_IS_FILE (file));
+    g_return_if_fail (moo_edit_is_empty (edit));
+
+    edit->priv->load_pending = true;
+    edit->priv->load_failed = false;
+    edit->priv->pending_line = line;
+    MOO_ASSIGN_STRING (edit->priv->pending_encoding, normalize_encoding (encoding, FALSE));
+    MOO_ASSIGN_STRING (edit->priv->pending_cached_encoding, cached_encoding);
+
+    /* so that history and session keep the encoding until it's loaded */
+    _moo_edit_set_file (edit, file, encoding ? encoding : cached_encoding);
+}
+
+gboolean
+_moo_edit_is_load_pending (MooEdit *edit)
+{
+    g_return_val_if_fail (MOO_IS_EDIT (edit), FALSE);
+    return edit->priv->load_pending;
+}
+
+/* TRUE if the text is not the file contents because the pending load
+ * failed; such documents are never saved */
+gboolean
+_moo_edit_is_load_failed (MooEdit *edit)
+{
+    g_return_val_if_fail (MOO_IS_EDIT (edit), FALSE);
+    return edit->priv->load_failed;
+}
+
+int
+_moo_edit_get_pending_line (MooEdit *edit)
+{
+    g_return_val_if_fail (MOO_IS_EDIT (edit), -1);
+    return edit->priv->load_pending ? edit->priv->pending_line : -1;
+}
+
+/* Loads the file of a document created with _moo_edit_set_load_pending(),
+ * the same way moo_editor_open_file() does. Returns FALSE if the text is
+ * not there: loading failed, now or before, or it is still running. */
+gboolean
+_moo_edit_ensure_loaded (MooEdit *edit)
+{
+    GError *error = NULL;
+    GFile *file;
+    char *encoding;
+    char *cached_encoding;
+    int line;
+    gboolean result;
+
+    g_return_val_if_fail (MOO_IS_EDIT (edit), FALSE);
+
+    if (!edit->priv->load_pending)
+        return !edit->priv->load_failed;
+
+    if (edit->priv->load_running || MOO_EDIT_IS_BUSY (edit))
+        return FALSE;
+
+    file = g_file_dup (edit->priv->file);
+    encoding = edit->priv->pending_encoding;
+    cached_encoding = edit->priv->pending_cached_encoding;
+    line = edit->priv->pending_line;
+    edit->priv->pending_encoding = NULL;
+    edit->priv->pending_cached_encoding = NULL;
+
+    edit->priv->load_running = true;
+    result = _moo_edit_load_file (edit, file, encoding, cached_encoding, &error);
+    edit->priv->load_running = false;
+
+    if (result)
+    {
+        if (line > 0)
+            moo_text_view_move_cursor (MOO_TEXT_VIEW (moo_edit_get_view (edit)),
+                                       line, 0, FALSE, TRUE);
+    }
+    else
+    {
+        /* do not try again, and make sure the empty document is
+         * not mistaken for the file contents until it's reloaded */
+        edit->priv->load_pending = false;
+        edit->priv->load_failed = true;
+
+        if (!_moo_is_file_error_cancelled (error))
+            _moo_edit_open_error_dialog (GTK_WIDGET (moo_edit_get_view (edit)), file, error);
+
+        if (_moo_edit_file_is_new (file))
+            add_status (edit, MOO_EDIT_STATUS_DELETED);
+        else
+            add_status (edit, MOO_EDIT_STATUS_MODIFIED_ON_DISK);
+
+        g_error_free (error);
+    }
+
+    _moo_doc_ensure_plugins (edit);
+
+    g_free (encoding);
+    g_free (cached_encoding);
+    g_object_unref (file);
+    return result;
+}
+
+
 /***************************************************************************/
 /* File saving
  */
@@ -742,6 +1607,19 @@ do_save_local (MooEdit        *edit,
     const char *bom = NULL;
     gsize bom_len = 0;
 
+    if (!_moo_edit_ensure_loaded (edit))
+    {
+        if (edit->priv->load_failed)
+            g_set_error (error, MOO_EDIT_FILE_ERROR,
+                         MOO_EDIT_FILE_ERROR_FAILED,
+                         "%s", _("The file could not be loaded, so it was not saved"));
+        else
+            g_set_error (error, MOO_EDIT_FILE_ERROR,
+                         MOO_EDIT_FILE_ERROR_FAILED,
+                         "document is busy");
+        return FALSE;
+    }
+
     utf8_contents = get_contents (edit);
 
     moo_release_assert (utf8_contents != NULL);
@@ -804,6 +1682,10 @@ moo_edit_save_local (MooEdit        *edit,
     moo_return_error_if_fail (MOO_IS_EDIT (edit));
     moo_return_error_if_fail (G_IS_FILE (file));
 
+    char *trace_detail = MOO_TRACE_ENABLED () ? g_file_get_parse_name (file) : NULL;
+    MooTraceScope trace_scope ("file save", trace_detail);
+    g_free (trace_detail);
+
     if (!do_save_local (edit, file, encoding, flags, error))
         return FALSE;
 
@@ -947,7 +1829,7 @@ file_modified_on_disk (MooEdit *edit)
 
     if (moo_prefs_get_bool (moo_edit_setting (MOO_EDIT_PREFS_AUTO_SYNC)))
     {
-        moo_edit_reload (edit, NULL, NULL);
+        queue_reload (edit);
     }
     else
     {
@@ -1111,6 +1993,16 @@ _moo_edit_set_file (MooEdit    *edit,
 
     tmp = edit->priv->file;
 
+    if (!file || !tmp || !g_file_equal (file, tmp))
+        edit->priv->large_file_declined = false;
+
+    /* the file was saved, reloaded or renamed, its contents or name
+     * might give a different language now */
+    if (tmp)
+        _moo_edit_forget_file_lang (tmp);
+    if (file)
+        _moo_edit_forget_file_lang (file);
+
     free_list = g_slist_prepend (free_list, edit->priv->filename);
     free_list = g_slist_prepend (free_list, edit->priv->norm_name);
     free_list = g_slist_prepend (free_list, edit->priv->display_filename);
@@ -1416,7 +2308,6 @@ moo_convert_file_data_to_utf8 (const char  *data,
                                const char  *cached_encoding,
                                char       **used_enc)
 {
-    char *freeme = NULL;
     char *result = NULL;
     const char *bom_enc = NULL;
 
@@ -1434,32 +2325,19 @@ moo_convert_file_data_to_utf8 (const char  *data,
     }
     else if (!encoding)
     {
-        GSList *encodings;
+        const char * const *encodings = get_encodings ();
 
-        encodings = get_encodings ();
         if (cached_encoding)
-            encodings = g_slist_prepend (encodings, g_strdup (cached_encoding));
-
-        while (encodings)
         {
-            char *enc;
-
-            enc = (char*) encodings->data;
-            encodings = g_slist_delete_link (encodings, encodings);
-
-            result = try_convert_to_utf8_from_encoding (data, len, enc);
-
-            if (result != NULL)
-            {
-                encoding = freeme = enc;
-                break;
-            }
-
-            g_free (enc);
+            result = try_convert_to_utf8_from_encoding (data, len, cached_encoding);
+            encoding = cached_encoding;
         }
 
-        g_slist_foreach (encodings, (GFunc) g_free, NULL);
-        g_slist_free (encodings);
+        for ( ; !result && *encodings; ++encodings)
+        {
+            result = try_convert_to_utf8_from_encoding (data, len, *encodings);
+            encoding = *encodings;
+        }
     }
     else
     {
@@ -1468,7 +2346,6 @@ moo_convert_file_data_to_utf8 (const char  *data,
 
     if (result)
         *used_enc = g_strdup (encoding);
-    g_free (freeme);
     return result;
 }
 
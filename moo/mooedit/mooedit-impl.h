@@ -36,6 +36,18 @@ void             _moo_edit_set_active_view          (MooEdit        *doc,
                                                      MooEditView    *view);
 
 gboolean         _moo_edit_is_busy                  (MooEdit        *doc);
+
+/* Large file mode: highlighting, bracket matching, whitespace drawing
+ * and wrapping are off and undo history is limited. Files are put into
+ * it on load when _moo_edit_size_is_large(), the user may switch it off. */
+gboolean         _moo_edit_size_is_large            (gsize           size,
+                                                     int             n_lines);
+gboolean         _moo_edit_is_large_file            (MooEdit        *doc);
+void             _moo_edit_set_large_file           (MooEdit        *doc,
+                                                     gboolean        large);
+/* Switches large file mode off at the user's request, it's not turned
+ * back on when the same file is reloaded */
+void             _moo_edit_leave_large_file         (MooEdit        *doc);
 MooEditState     _moo_edit_get_state                (MooEdit        *doc);
 void             _moo_edit_set_progress_text        (MooEdit        *doc,
                                                      const char     *text);
@@ -92,8 +104,19 @@ extern guint *_moo_edit_settings;
 void        _moo_edit_update_global_config      (void);
 void        _moo_edit_init_config               (void);
 
-void        _moo_edit_queue_recheck_config_all  (void);
+/* what changed since the configuration of documents was checked */
+typedef enum {
+    MOO_EDIT_CONFIG_CHANGED_DOC     = 1 << 0, /* the document itself */
+    MOO_EDIT_CONFIG_CHANGED_PREFS   = 1 << 1, /* editor preferences */
+    MOO_EDIT_CONFIG_CHANGED_LANGS   = 1 << 2, /* languages and their settings */
+    MOO_EDIT_CONFIG_CHANGED_FILTERS = 1 << 3  /* per-file settings */
+} MooEditConfigChange;
+
+void        _moo_edit_queue_recheck_config_all  (MooEditConfigChange what);
 void        _moo_edit_queue_recheck_config      (MooEdit        *edit);
+/* drops the language detected for the file, it is detected again
+ * on next recheck since the file might have changed */
+void        _moo_edit_forget_file_lang          (GFile          *file);
 
 void        _moo_edit_closed                    (MooEdit        *edit);
 
@@ -109,6 +132,16 @@ void         _moo_edit_ensure_newline           (MooEdit        *edit);
 
 void         _moo_edit_stop_file_watch          (MooEdit        *edit);
 
+void         _moo_edit_set_load_pending         (MooEdit        *edit,
+                                                 GFile          *file,
+                                                 const char     *encoding,
+                                                 const char     *cached_encoding,
+                                                 int             line);
+gboolean     _moo_edit_is_load_pending          (MooEdit        *edit);
+gboolean     _moo_edit_is_load_failed           (MooEdit        *edit);
+int          _moo_edit_get_pending_line         (MooEdit        *edit);
+gboolean     _moo_edit_ensure_loaded            (MooEdit        *edit);
+
 void         _moo_edit_set_status               (MooEdit        *edit,
                                                  MooEditStatus   status);
 
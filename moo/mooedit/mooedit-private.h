@@ -32,8 +32,13 @@ struct MooEditPrivate
 
     gulong changed_handler_id;
     gulong modified_changed_handler_id;
-    guint apply_config_idle;
+    // what to recheck, MooEditConfigChange flags; set while the document
+    // waits in the queue, see _moo_edit_queue_recheck_config_all()
+    guint recheck_config;
+    bool recheck_queued;
     bool in_recheck_config;
+    // per-file settings applied by the last recheck
+    char *filter_config;
 
     /***********************************************************************/
     /* Document
@@ -51,6 +56,9 @@ struct MooEditPrivate
     guint file_monitor_id;
     bool modified_on_disk;
     bool deleted_from_disk;
+    // incremented on every buffer change, tells whether a reload
+    // computed in background still applies
+    guint change_stamp;
 
     // file sync event source ID
     guint sync_timeout_id;
@@ -58,6 +66,22 @@ struct MooEditPrivate
     MooEditState state;
     MooEditProgress *progress;
 
+    // file is too big for highlighting and friends, see _moo_edit_set_large_file()
+    bool large_file;
+    // the user turned the features back on for this file, see _moo_edit_leave_large_file()
+    bool large_file_declined;
+
+    // lazy session restore: file is set but its contents are not loaded yet
+    bool load_pending;
+    // the pending load is running, e.g. the encoding dialog is shown
+    bool load_running;
+    // the pending load failed and the text is not the file contents;
+    // cleared when the file is loaded or reloaded
+    bool load_failed;
+    char *pending_encoding;
+    char *pending_cached_encoding;
+    int pending_line;
+
     /***********************************************************************/
     /* Bookmarks
      */
@@ -1,8 +1,25 @@
 #include "mooedit/mooedit-script.h"
 #include "mooedit/mootextview.h"
 #include "mooedit/mootextbuffer.h"
+#include "mooedit/mooedit-impl.h"
 #include "mooutils/mooutils.h"
 
+/* Scripts may access documents restored lazily from session
+ * which have not been shown yet, so load them on first use */
+static GtkTextBuffer *
+get_buffer (MooEdit *doc)
+{
+    _moo_edit_ensure_loaded (doc);
+    return moo_edit_get_buffer (doc);
+}
+
+static MooEditView *
+get_view (MooEdit *doc)
+{
+    _moo_edit_ensure_loaded (doc);
+    return moo_edit_get_view (doc);
+}
+
 /**
  * moo_edit_can_undo:
  **/
@@ -10,7 +27,7 @@ gboolean
 moo_edit_can_undo (MooEdit *doc)
 {
     g_return_val_if_fail (MOO_IS_EDIT (doc), FALSE);
-    return moo_text_buffer_can_undo (MOO_TEXT_BUFFER (moo_edit_get_buffer (doc)));
+    return moo_text_buffer_can_undo (MOO_TEXT_BUFFER (get_buffer (doc)));
 }
 
 /**
@@ -20,7 +37,7 @@ gboolean
 moo_edit_can_redo (MooEdit *doc)
 {
     g_return_val_if_fail (MOO_IS_EDIT (doc), FALSE);
-    return moo_text_buffer_can_redo (MOO_TEXT_BUFFER (moo_edit_get_buffer (doc)));
+    return moo_text_buffer_can_redo (MOO_TEXT_BUFFER (get_buffer (doc)));
 }
 
 /**
@@ -30,7 +47,7 @@ gboolean
 moo_edit_undo (MooEdit *doc)
 {
     g_return_val_if_fail (MOO_IS_EDIT (doc), FALSE);
-    return moo_text_view_undo (MOO_TEXT_VIEW (moo_edit_get_view (doc)));
+    return moo_text_view_undo (MOO_TEXT_VIEW (get_view (doc)));
 }
 
 /**
@@ -40,7 +57,7 @@ gboolean
 moo_edit_redo (MooEdit *doc)
 {
     g_return_val_if_fail (MOO_IS_EDIT (doc), FALSE);
-    return moo_text_view_redo (MOO_TEXT_VIEW (moo_edit_get_view (doc)));
+    return moo_text_view_redo (MOO_TEXT_VIEW (get_view (doc)));
 }
 
 /**
@@ -50,7 +67,7 @@ void
 moo_edit_begin_non_undoable_action (MooEdit *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    moo_text_buffer_begin_non_undoable_action (MOO_TEXT_BUFFER (moo_edit_get_buffer (doc)));
+    moo_text_buffer_begin_non_undoable_action (MOO_TEXT_BUFFER (get_buffer (doc)));
 }
 
 /**
@@ -60,7 +77,7 @@ void
 moo_edit_begin_user_action (MooEdit *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    gtk_text_buffer_begin_user_action (moo_edit_get_buffer (doc));
+    gtk_text_buffer_begin_user_action (get_buffer (doc));
 }
 
 /**
@@ -70,7 +87,7 @@ void
 moo_edit_end_user_action (MooEdit *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    gtk_text_buffer_end_user_action (moo_edit_get_buffer (doc));
+    gtk_text_buffer_end_user_action (get_buffer (doc));
 }
 
 /**
@@ -80,7 +97,7 @@ void
 moo_edit_end_non_undoable_action (MooEdit *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    moo_text_buffer_end_non_undoable_action (MOO_TEXT_BUFFER (moo_edit_get_buffer (doc)));
+    moo_text_buffer_end_non_undoable_action (MOO_TEXT_BUFFER (get_buffer (doc)));
 }
 
 /**
@@ -93,7 +110,7 @@ moo_edit_get_start_pos (MooEdit *doc)
 {
     GtkTextIter iter;
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
-    gtk_text_buffer_get_start_iter (moo_edit_get_buffer (doc), &iter);
+    gtk_text_buffer_get_start_iter (get_buffer (doc), &iter);
     return gtk_text_iter_copy (&iter);
 }
 
@@ -108,7 +125,7 @@ moo_edit_get_end_pos (MooEdit *doc)
 {
     GtkTextIter iter;
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
-    gtk_text_buffer_get_end_iter (moo_edit_get_buffer (doc), &iter);
+    gtk_text_buffer_get_end_iter (get_buffer (doc), &iter);
     return gtk_text_iter_copy (&iter);
 }
 
@@ -116,7 +133,7 @@ static void
 get_iter_at_cursor (MooEdit     *doc,
                     GtkTextIter *iter)
 {
-    GtkTextBuffer *buffer = moo_edit_get_buffer (doc);
+    GtkTextBuffer *buffer = get_buffer (doc);
     gtk_text_buffer_get_iter_at_mark (buffer, iter, gtk_text_buffer_get_insert (buffer));
 }
 
@@ -147,7 +164,7 @@ moo_edit_get_selection_start_pos (MooEdit *doc)
     GtkTextIter iter;
     GtkTextBuffer *buffer;
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_get_selection_bounds (buffer, &iter, NULL);
     return gtk_text_iter_copy (&iter);
 }
@@ -164,7 +181,7 @@ moo_edit_get_selection_end_pos (MooEdit *doc)
     GtkTextIter iter;
     GtkTextBuffer *buffer;
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_get_selection_bounds (buffer, NULL, &iter);
     return gtk_text_iter_copy (&iter);
 }
@@ -180,7 +197,7 @@ moo_edit_set_cursor_pos (MooEdit           *doc,
                          const GtkTextIter *pos)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    gtk_text_buffer_place_cursor (moo_edit_get_buffer (doc), pos);
+    gtk_text_buffer_place_cursor (get_buffer (doc), pos);
 }
 
 /**
@@ -190,7 +207,7 @@ int
 moo_edit_get_char_count (MooEdit *doc)
 {
     g_return_val_if_fail (MOO_IS_EDIT (doc), 0);
-    return gtk_text_buffer_get_char_count (moo_edit_get_buffer (doc));
+    return gtk_text_buffer_get_char_count (get_buffer (doc));
 }
 
 /**
@@ -200,7 +217,7 @@ int
 moo_edit_get_line_count (MooEdit *doc)
 {
     g_return_val_if_fail (MOO_IS_EDIT (doc), 0);
-    return gtk_text_buffer_get_line_count (moo_edit_get_buffer (doc));
+    return gtk_text_buffer_get_line_count (get_buffer (doc));
 }
 
 /**
@@ -247,7 +264,7 @@ moo_edit_get_pos_at_line (MooEdit *doc,
 
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     g_return_val_if_fail (line >= 0 && line <= gtk_text_buffer_get_line_count (buffer), NULL);
 
     gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
@@ -272,7 +289,7 @@ moo_edit_get_pos_at_line_end (MooEdit *doc,
 
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     g_return_val_if_fail (line >= 0 && line <= gtk_text_buffer_get_line_count (buffer), NULL);
 
     gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
@@ -316,7 +333,7 @@ moo_edit_get_text (MooEdit           *doc,
 
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
 
     if (start)
         start_iter = *start;
@@ -349,7 +366,7 @@ moo_edit_get_line_text (MooEdit *doc,
 
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
 
     if (line >= 0)
     {
@@ -383,6 +400,89 @@ moo_edit_get_line_text_at_pos (MooEdit           *doc,
     return moo_edit_get_line_text (doc, gtk_text_iter_get_line (pos));
 }
 
+/* Splits text into exactly n_lines lines, stripping line terminators.
+ * Lines are written into lines[] as pointers into text, which is modified
+ * in place. */
+static void
+split_lines_in_place (char        *text,
+                      int          n_lines,
+                      const char **lines)
+{
+    MooLineReader lr;
+    int i;
+
+    moo_line_reader_init (&lr, text, -1);
+
+    for (i = 0; i < n_lines; ++i)
+    {
+        gsize line_len, lt_len;
+        char *line = (char*) moo_line_reader_get_line (&lr, &line_len, &lt_len);
+
+        if (!line)
+        {
+            lines[i] = "";
+            continue;
+        }
+
+        line[line_len] = 0;
+        lines[i] = line;
+    }
+}
+
+/**
+ * moo_edit_get_lines:
+ *
+ * @doc:
+ * @first: (type index): %INDEXBASE-based number of the first line.
+ * @last: (type index) (default -1): %INDEXBASE-based number of the last line,
+ * the last line in the document if missing.
+ *
+ * Returns: (type strv): text of lines from @first to @last inclusive, one
+ * string for each line, line end characters not included. This is much
+ * faster than calling moo_edit_get_line_text() for each line.
+ **/
+char **
+moo_edit_get_lines (MooEdit *doc,
+                    int      first,
+                    int      last)
+{
+    GtkTextBuffer *buffer;
+    GtkTextIter start, end;
+    const char **lines;
+    char **ret;
+    char *text;
+    int n_lines, i;
+
+    g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
+
+    buffer = get_buffer (doc);
+
+    if (last < 0)
+        last = gtk_text_buffer_get_line_count (buffer) - 1;
+
+    g_return_val_if_fail (first >= 0 && first <= last, NULL);
+    g_return_val_if_fail (last < gtk_text_buffer_get_line_count (buffer), NULL);
+
+    gtk_text_buffer_get_iter_at_line (buffer, &start, first);
+    gtk_text_buffer_get_iter_at_line (buffer, &end, last);
+    if (!gtk_text_iter_ends_line (&end))
+        gtk_text_iter_forward_to_line_end (&end);
+
+    n_lines = last - first + 1;
+    text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+    lines = g_new (const char*, n_lines);
+    split_lines_in_place (text, n_lines, lines);
+
+    ret = g_new (char*, n_lines + 1);
+    for (i = 0; i < n_lines; ++i)
+        ret[i] = g_strdup (lines[i]);
+    ret[n_lines] = NULL;
+
+    g_free (lines);
+    g_free (text);
+    return ret;
+}
+
 /**
  * moo_edit_set_text:
  *
@@ -399,7 +499,7 @@ moo_edit_set_text (MooEdit    *doc,
     g_return_if_fail (MOO_IS_EDIT (doc));
     g_return_if_fail (text != NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_get_bounds (buffer, &start, &end);
     gtk_text_buffer_delete (buffer, &start, &end);
     gtk_text_buffer_insert (buffer, &start, text, -1);
@@ -425,7 +525,7 @@ moo_edit_insert_text (MooEdit     *doc,
     g_return_if_fail (MOO_IS_EDIT (doc));
     g_return_if_fail (text != NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
 
     if (where)
         iter = *where;
@@ -459,7 +559,7 @@ moo_edit_replace_text (MooEdit     *doc,
     g_return_if_fail (end != NULL);
     g_return_if_fail (text != NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_delete (buffer, start, end);
     gtk_text_buffer_insert (buffer, start, text, -1);
     *end = *start;
@@ -479,7 +579,7 @@ moo_edit_delete_text (MooEdit     *doc,
     g_return_if_fail (start != NULL);
     g_return_if_fail (end != NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_delete (buffer, start, end);
 }
 
@@ -501,7 +601,7 @@ moo_edit_append_text (MooEdit    *doc,
     g_return_if_fail (MOO_IS_EDIT (doc));
     g_return_if_fail (text != NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_get_end_iter (buffer, &iter);
     gtk_text_buffer_insert (buffer, &iter, text, -1);
 }
@@ -519,7 +619,7 @@ moo_edit_clear (MooEdit *doc)
 
     g_return_if_fail (MOO_IS_EDIT (doc));
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_get_bounds (buffer, &start, &end);
     gtk_text_buffer_delete (buffer, &start, &end);
 }
@@ -533,7 +633,7 @@ void
 moo_edit_cut (MooEdit *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    g_signal_emit_by_name (moo_edit_get_view (doc), "cut-clipboard");
+    g_signal_emit_by_name (get_view (doc), "cut-clipboard");
 }
 
 /**
@@ -545,7 +645,7 @@ void
 moo_edit_copy (MooEdit        *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    g_signal_emit_by_name (moo_edit_get_view (doc), "copy-clipboard");
+    g_signal_emit_by_name (get_view (doc), "copy-clipboard");
 }
 
 /**
@@ -557,7 +657,7 @@ void
 moo_edit_paste (MooEdit *doc)
 {
     g_return_if_fail (MOO_IS_EDIT (doc));
-    g_signal_emit_by_name (moo_edit_get_view (doc), "paste-clipboard");
+    g_signal_emit_by_name (get_view (doc), "paste-clipboard");
 }
 
 /**
@@ -573,7 +673,7 @@ moo_edit_select_range (MooEdit           *doc,
     g_return_if_fail (MOO_IS_EDIT (doc));
     g_return_if_fail (start != NULL);
     g_return_if_fail (end != NULL);
-    gtk_text_buffer_select_range (moo_edit_get_buffer (doc), start, end);
+    gtk_text_buffer_select_range (get_buffer (doc), start, end);
 }
 
 /**
@@ -593,7 +693,7 @@ moo_edit_select_lines (MooEdit *doc,
 
     g_return_if_fail (MOO_IS_EDIT (doc));
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
 
     if (end < 0)
         end = start;
@@ -635,7 +735,7 @@ moo_edit_select_lines_at_pos (MooEdit           *doc,
     g_return_if_fail (MOO_IS_EDIT (doc));
     g_return_if_fail (start != NULL);
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     start_iter = *start;
     end_iter = end ? *end : *start;
     gtk_text_iter_order (&start_iter, &end_iter);
@@ -654,7 +754,7 @@ moo_edit_select_all (MooEdit *doc)
 
     g_return_if_fail (MOO_IS_EDIT (doc));
 
-    buffer = moo_edit_get_buffer (doc);
+    buffer = get_buffer (doc);
     gtk_text_buffer_get_bounds (buffer, &start, &end);
     gtk_text_buffer_select_range (buffer, &start, &end);
 }
@@ -703,7 +803,7 @@ moo_edit_get_selected_lines (MooEdit *doc)
 
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
-    buf = moo_edit_get_buffer (doc);
+    buf = get_buffer (doc);
     get_selected_lines_bounds (buf, &start, &end, NULL);
     text = gtk_text_buffer_get_slice (buf, &start, &end, TRUE);
     lines = moo_splitlines (text);
@@ -754,7 +854,7 @@ moo_edit_replace_selected_lines (MooEdit  *doc,
 
     g_return_if_fail (MOO_IS_EDIT (doc));
 
-    buf = moo_edit_get_buffer (doc);
+    buf = get_buffer (doc);
     get_selected_lines_bounds (buf, &start, &end, &cursor_at_next_line);
     gtk_text_buffer_delete (buf, &start, &end);
 
@@ -785,7 +885,7 @@ moo_edit_get_selected_text (MooEdit *doc)
 
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
-    buf = moo_edit_get_buffer (doc);
+    buf = get_buffer (doc);
     gtk_text_buffer_get_selection_bounds(buf, &start, &end);
     return gtk_text_buffer_get_slice(buf, &start, &end, TRUE);
 }
@@ -831,7 +931,7 @@ moo_edit_replace_selected_text (MooEdit    *doc,
     g_return_if_fail (MOO_IS_EDIT (doc));
     g_return_if_fail (replacement != NULL);
 
-    buf = moo_edit_get_buffer (doc);
+    buf = get_buffer (doc);
     gtk_text_buffer_get_selection_bounds (buf, &start, &end);
     gtk_text_buffer_delete (buf, &start, &end);
     if (*replacement)
@@ -845,5 +945,378 @@ moo_edit_replace_selected_text (MooEdit    *doc,
 gboolean
 moo_edit_has_selection (MooEdit *doc)
 {
-    return moo_text_buffer_has_selection (MOO_TEXT_BUFFER (moo_edit_get_buffer (doc)));
+    return moo_text_buffer_has_selection (MOO_TEXT_BUFFER (get_buffer (doc)));
+}
+
+
+/**
+ * class:MooEditBatch: (parent GObject): a list of changes to document text
+ *
+ * Object which collects text changes to be applied to a document
+ * with moo_edit_apply_batch(). All positions refer to the document
+ * text as it is before any of the changes are made.
+ **/
+
+typedef struct {
+    int start;      /* char offsets, or line number if line is TRUE */
+    int end;
+    char *text;
+    gboolean line;
+    guint seq;
+} BatchEdit;
+
+struct MooEditBatch {
+    GObject parent;
+    GArray *edits;
+};
+
+typedef struct {
+    GObjectClass parent_class;
+} MooEditBatchClass;
+
+G_DEFINE_TYPE (MooEditBatch, moo_edit_batch, G_TYPE_OBJECT)
+
+static void
+moo_edit_batch_finalize (GObject *object)
+{
+    MooEditBatch *batch = MOO_EDIT_BATCH (object);
+    guint i;
+
+    for (i = 0; i < batch->edits->len; ++i)
+        g_free (g_array_index (batch->edits, BatchEdit, i).text);
+    g_array_free (batch->edits, TRUE);
+
+    G_OBJECT_CLASS (moo_edit_batch_parent_class)->finalize (object);
+}
+
+static void
+moo_edit_batch_class_init (MooEditBatchClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = moo_edit_batch_finalize;
+}
+
+static void
+moo_edit_batch_init (MooEditBatch *batch)
+{
+    batch->edits = g_array_new (FALSE, FALSE, sizeof (BatchEdit));
+}
+
+/**
+ * moo_edit_batch_new: (constructor-of MooEditBatch)
+ **/
+MooEditBatch *
+moo_edit_batch_new (void)
+{
+    return MOO_EDIT_BATCH (g_object_new (MOO_TYPE_EDIT_BATCH, (const char*) NULL));
+}
+
+static void
+batch_add (MooEditBatch *batch,
+           int           start,
+           int           end,
+           const char   *text,
+           gboolean      line)
+{
+    BatchEdit edit;
+
+    edit.start = start;
+    edit.end = end;
+    edit.text = text && *text ? g_strdup (text) : NULL;
+    edit.line = line;
+    edit.seq = batch->edits->len;
+
+    g_array_append_val (batch->edits, edit);
+}
+
+/**
+ * moo_edit_batch_insert:
+ *
+ * @batch:
+ * @pos: character offset
+ * @text: (type const-utf8)
+ **/
+void
+moo_edit_batch_insert (MooEditBatch *batch,
+                       int           pos,
+                       const char   *text)
+{
+    g_return_if_fail (MOO_IS_EDIT_BATCH (batch));
+    g_return_if_fail (pos >= 0 && text != NULL);
+    g_return_if_fail (g_utf8_validate (text, -1, NULL));
+    batch_add (batch, pos, pos, text, FALSE);
+}
+
+/**
+ * moo_edit_batch_delete:
+ *
+ * @batch:
+ * @start: character offset
+ * @end: character offset
+ **/
+void
+moo_edit_batch_delete (MooEditBatch *batch,
+                       int           start,
+                       int           end)
+{
+    g_return_if_fail (MOO_IS_EDIT_BATCH (batch));
+    g_return_if_fail (start >= 0 && start <= end);
+    batch_add (batch, start, end, NULL, FALSE);
+}
+
+/**
+ * moo_edit_batch_replace:
+ *
+ * @batch:
+ * @start: character offset
+ * @end: character offset
+ * @text: (type const-utf8)
+ **/
+void
+moo_edit_batch_replace (MooEditBatch *batch,
+                        int           start,
+                        int           end,
+                        const char   *text)
+{
+    g_return_if_fail (MOO_IS_EDIT_BATCH (batch));
+    g_return_if_fail (start >= 0 && start <= end && text != NULL);
+    g_return_if_fail (g_utf8_validate (text, -1, NULL));
+    batch_add (batch, start, end, text, FALSE);
+}
+
+/**
+ * moo_edit_batch_replace_line:
+ *
+ * @batch:
+ * @line: (type index): %INDEXBASE-based line number.
+ * @text: (type const-utf8): new line text, without line end characters.
+ *
+ * Replace text of line @line, not including line end characters.
+ **/
+void
+moo_edit_batch_replace_line (MooEditBatch *batch,
+                             int           line,
+                             const char   *text)
+{
+    g_return_if_fail (MOO_IS_EDIT_BATCH (batch));
+    g_return_if_fail (line >= 0 && text != NULL);
+    g_return_if_fail (g_utf8_validate (text, -1, NULL));
+    batch_add (batch, line, line, text, TRUE);
+}
+
+/**
+ * moo_edit_batch_get_size:
+ *
+ * Returns: number of changes in the batch.
+ **/
+int
+moo_edit_batch_get_size (MooEditBatch *batch)
+{
+    g_return_val_if_fail (MOO_IS_EDIT_BATCH (batch), 0);
+    return batch->edits->len;
+}
+
+static int
+compare_batch_edits (const BatchEdit *e1,
+                     const BatchEdit *e2)
+{
+    if (e1->start != e2->start)
+        return e1->start < e2->start ? -1 : 1;
+    if (e1->end != e2->end)
+        return e1->end < e2->end ? -1 : 1;
+    return e1->seq < e2->seq ? -1 : (e1->seq > e2->seq);
+}
+
+/**
+ * moo_edit_apply_batch:
+ *
+ * Apply all changes in @batch as a single undoable action. Changes
+ * must not overlap; if any of them does, or if any position is out of
+ * range, the document is not modified and %FALSE is returned.
+ **/
+gboolean
+moo_edit_apply_batch (MooEdit      *doc,
+                      MooEditBatch *batch)
+{
+    GtkTextBuffer *buffer;
+    GArray *edits;
+    int char_count, line_count;
+    guint i;
+
+    g_return_val_if_fail (MOO_IS_EDIT (doc), FALSE);
+    g_return_val_if_fail (MOO_IS_EDIT_BATCH (batch), FALSE);
+
+    if (!batch->edits->len)
+        return TRUE;
+
+    buffer = get_buffer (doc);
+    char_count = gtk_text_buffer_get_char_count (buffer);
+    line_count = gtk_text_buffer_get_line_count (buffer);
+
+    /* resolve line changes into offsets, then check everything
+     * before touching the buffer */
+    edits = g_array_sized_new (FALSE, FALSE, sizeof (BatchEdit), batch->edits->len);
+    g_array_append_vals (edits, batch->edits->data, batch->edits->len);
+
+    for (i = 0; i < edits->len; ++i)
+    {
+        BatchEdit *e = &g_array_index (edits, BatchEdit, i);
+
+        if (e->line)
+        {
+            GtkTextIter iter;
+
+            if (e->start >= line_count)
+            {
+                g_critical ("line %d is out of range", e->start);
+                g_array_free (edits, TRUE);
+                return FALSE;
+            }
+
+            gtk_text_buffer_get_iter_at_line (buffer, &iter, e->start);
+            e->start = gtk_text_iter_get_offset (&iter);
+            if (!gtk_text_iter_ends_line (&iter))
+                gtk_text_iter_forward_to_line_end (&iter);
+            e->end = gtk_text_iter_get_offset (&iter);
+        }
+    }
+
+    g_array_sort (edits, (GCompareFunc) compare_batch_edits);
+
+    for (i = 0; i < edits->len; ++i)
+    {
+        BatchEdit *e = &g_array_index (edits, BatchEdit, i);
+
+        if (e->end > char_count ||
+            (i > 0 && g_array_index (edits, BatchEdit, i - 1).end > e->start))
+        {
+            g_critical ("invalid or overlapping change at offset %d", e->start);
+            g_array_free (edits, TRUE);
+            return FALSE;
+        }
+    }
+
+    /* go from the end, so that offsets of remaining changes stay valid */
+    gtk_text_buffer_begin_user_action (buffer);
+
+    for (i = edits->len; i-- > 0; )
+    {
+        BatchEdit *e = &g_array_index (edits, BatchEdit, i);
+        GtkTextIter start, end;
+
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, e->start);
+
+        if (e->end > e->start)
+        {
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, e->end);
+            gtk_text_buffer_delete (buffer, &start, &end);
+        }
+
+        if (e->text)
+            gtk_text_buffer_insert (buffer, &start, e->text, -1);
+    }
+
+    gtk_text_buffer_end_user_action (buffer);
+
+    g_array_free (edits, TRUE);
+    return TRUE;
+}
+
+
+/**
+ * class:MooEditSnapshot: (parent GObject): read-only copy of document text
+ *
+ * Object which holds document text as it was when moo_edit_get_snapshot()
+ * was called. Lines are stored in a single block of memory, so reading
+ * them does not involve the text buffer or allocate memory.
+ **/
+
+struct MooEditSnapshot {
+    GObject parent;
+    char *text;
+    const char **lines;
+    int n_lines;
+};
+
+typedef struct {
+    GObjectClass parent_class;
+} MooEditSnapshotClass;
+
+G_DEFINE_TYPE (MooEditSnapshot, moo_edit_snapshot, G_TYPE_OBJECT)
+
+static void
+moo_edit_snapshot_finalize (GObject *object)
+{
+    MooEditSnapshot *snapshot = MOO_EDIT_SNAPSHOT (object);
+
+    g_free (snapshot->lines);
+    g_free (snapshot->text);
+
+    G_OBJECT_CLASS (moo_edit_snapshot_parent_class)->finalize (object);
+}
+
+static void
+moo_edit_snapshot_class_init (MooEditSnapshotClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = moo_edit_snapshot_finalize;
+}
+
+static void
+moo_edit_snapshot_init (G_GNUC_UNUSED MooEditSnapshot *snapshot)
+{
+}
+
+/**
+ * moo_edit_get_snapshot:
+ *
+ * Returns: (transfer full): read-only copy of the document text, to be
+ * used instead of many calls to moo_edit_get_line_text() when going
+ * through the whole document.
+ **/
+MooEditSnapshot *
+moo_edit_get_snapshot (MooEdit *doc)
+{
+    MooEditSnapshot *snapshot;
+    GtkTextBuffer *buffer;
+    GtkTextIter start, end;
+
+    g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
+
+    buffer = get_buffer (doc);
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+    snapshot = MOO_EDIT_SNAPSHOT (g_object_new (MOO_TYPE_EDIT_SNAPSHOT, (const char*) NULL));
+    snapshot->text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+    snapshot->n_lines = gtk_text_buffer_get_line_count (buffer);
+    snapshot->lines = g_new (const char*, snapshot->n_lines);
+    split_lines_in_place (snapshot->text, snapshot->n_lines, snapshot->lines);
+
+    return snapshot;
+}
+
+/**
+ * moo_edit_snapshot_get_line_count:
+ **/
+int
+moo_edit_snapshot_get_line_count (MooEditSnapshot *snapshot)
+{
+    g_return_val_if_fail (MOO_IS_EDIT_SNAPSHOT (snapshot), 0);
+    return snapshot->n_lines;
+}
+
+/**
+ * moo_edit_snapshot_get_line:
+ *
+ * @snapshot:
+ * @line: (type index): %INDEXBASE-based line number.
+ *
+ * Returns: (type const-utf8): text of line @line, not including line
+ * end characters.
+ **/
+const char *
+moo_edit_snapshot_get_line (MooEditSnapshot *snapshot,
+                            int              line)
+{
+    g_return_val_if_fail (MOO_IS_EDIT_SNAPSHOT (snapshot), NULL);
+    g_return_val_if_fail (line >= 0 && line < snapshot->n_lines, NULL);
+    return snapshot->lines[line];
 }
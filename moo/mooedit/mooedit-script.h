@@ -5,6 +5,17 @@
 
 G_BEGIN_DECLS
 
+#define MOO_TYPE_EDIT_BATCH                 (moo_edit_batch_get_type ())
+#define MOO_EDIT_BATCH(object)              (G_TYPE_CHECK_INSTANCE_CAST ((object), MOO_TYPE_EDIT_BATCH, MooEditBatch))
+#define MOO_IS_EDIT_BATCH(object)           (G_TYPE_CHECK_INSTANCE_TYPE ((object), MOO_TYPE_EDIT_BATCH))
+
+#define MOO_TYPE_EDIT_SNAPSHOT              (moo_edit_snapshot_get_type ())
+#define MOO_EDIT_SNAPSHOT(object)           (G_TYPE_CHECK_INSTANCE_CAST ((object), MOO_TYPE_EDIT_SNAPSHOT, MooEditSnapshot))
+#define MOO_IS_EDIT_SNAPSHOT(object)        (G_TYPE_CHECK_INSTANCE_TYPE ((object), MOO_TYPE_EDIT_SNAPSHOT))
+
+GType        moo_edit_batch_get_type            (void) G_GNUC_CONST;
+GType        moo_edit_snapshot_get_type         (void) G_GNUC_CONST;
+
 gboolean     moo_edit_can_undo                  (MooEdit            *doc);
 gboolean     moo_edit_can_redo                  (MooEdit            *doc);
 gboolean     moo_edit_undo                      (MooEdit            *doc);
@@ -42,6 +53,9 @@ char        *moo_edit_get_line_text             (MooEdit            *doc,
                                                  int                 line);
 char        *moo_edit_get_line_text_at_pos      (MooEdit            *doc,
                                                  const GtkTextIter  *pos);
+char       **moo_edit_get_lines                 (MooEdit            *doc,
+                                                 int                 first,
+                                                 int                 last);
 
 void         moo_edit_set_text                  (MooEdit            *doc,
                                                  const char         *text);
@@ -85,6 +99,29 @@ void         moo_edit_replace_selected_lines    (MooEdit            *doc,
 
 gboolean     moo_edit_has_selection             (MooEdit        *doc);
 
+MooEditBatch *moo_edit_batch_new                (void);
+void         moo_edit_batch_insert              (MooEditBatch       *batch,
+                                                 int                 pos,
+                                                 const char         *text);
+void         moo_edit_batch_delete              (MooEditBatch       *batch,
+                                                 int                 start,
+                                                 int                 end);
+void         moo_edit_batch_replace             (MooEditBatch       *batch,
+                                                 int                 start,
+                                                 int                 end,
+                                                 const char         *text);
+void         moo_edit_batch_replace_line        (MooEditBatch       *batch,
+                                                 int                 line,
+                                                 const char         *text);
+int          moo_edit_batch_get_size            (MooEditBatch       *batch);
+gboolean     moo_edit_apply_batch               (MooEdit            *doc,
+                                                 MooEditBatch       *batch);
+
+MooEditSnapshot *moo_edit_get_snapshot          (MooEdit            *doc);
+int          moo_edit_snapshot_get_line_count   (MooEditSnapshot    *snapshot);
+const char  *moo_edit_snapshot_get_line         (MooEditSnapshot    *snapshot,
+                                                 int                 line);
+
 G_END_DECLS
 
 #endif /* MOO_EDIT_SCRIPT_H */
@@ -42,6 +42,7 @@
 #include "mooedit/mooeditdialogs.h"
 #include "mooedit/mooeditprefs.h"
 #include "mooedit/mootextbuffer.h"
+#include "mooedit/mootext-private.h"
 #include "mooedit/mooeditfiltersettings.h"
 #include "mooedit/mooeditor-impl.h"
 #include "mooedit/mooedittab-impl.h"
@@ -53,6 +54,7 @@
 #include "mooutils/mooutils-misc.h"
 #include "mooutils/mootype-macros.h"
 #include "mooutils/mooatom.h"
+#include "mooutils/mooundo.h"
 #include "mooutils/moocompat.h"
 #include "mooedit/mooeditprogress-gxml.h"
 #include <string.h>
@@ -64,7 +66,20 @@
 MOO_DEFINE_OBJECT_ARRAY (MooEdit, moo_edit)
 
 MooEditList *_moo_edit_instances = NULL;
-static guint moo_edit_apply_config_all_idle;
+
+/* Documents waiting for their config to be rechecked. They are processed
+ * a few at a time so that a change affecting hundreds of documents does
+ * not block the UI. */
+static struct {
+    GQueue docs;
+    guint idle;
+    /* MooEditConfigChange flags for all documents */
+    guint changed_all;
+    /* whether an editor preference changed since the last recheck */
+    bool prefs_changed;
+    /* language detected from the file name, file uri -> lang id */
+    GHashTable *file_langs;
+} recheck_queue;
 
 static GObject *moo_edit_constructor            (GType           type,
                                                  guint           n_construct_properties,
@@ -87,6 +102,7 @@ static MooSaveResponse moo_edit_before_save     (MooEdit        *doc,
 static void     config_changed                  (MooEdit        *edit);
 static void     update_config_from_mode_lines   (MooEdit        *doc);
 static void     moo_edit_recheck_config         (MooEdit        *doc);
+static void     editor_prefs_changed            (void);
 
 static void     changed_cb                      (GtkTextBuffer  *buffer,
                                                  MooEdit        *edit);
@@ -268,6 +284,11 @@ moo_edit_class_init (MooEditClass *klass)
 
     _moo_edit_init_config ();
     _moo_edit_class_init_actions (klass);
+
+    recheck_queue.prefs_changed = true;
+    moo_prefs_notify_connect (MOO_EDIT_PREFS_PREFIX "/",
+                              (MooPrefsNotify) editor_prefs_changed,
+                              NULL, NULL);
 }
 
 
@@ -278,8 +299,10 @@ MooEditPrivate::MooEditPrivate()
     , dead_active_view(false)
     , changed_handler_id(0)
     , modified_changed_handler_id(0)
-    , apply_config_idle(0)
+    , recheck_config(0)
+    , recheck_queued(false)
     , in_recheck_config(0)
+    , filter_config(nullptr)
     , filename(nullptr)
     , norm_name(nullptr)
     , display_filename(nullptr)
@@ -290,9 +313,18 @@ MooEditPrivate::MooEditPrivate()
     , file_monitor_id(0)
     , modified_on_disk(false)
     , deleted_from_disk(false)
+    , change_stamp(0)
     , sync_timeout_id(0)
     , state(MOO_EDIT_STATE_NORMAL)
     , progress(nullptr)
+    , large_file(false)
+    , large_file_declined(false)
+    , load_pending(false)
+    , load_running(false)
+    , load_failed(false)
+    , pending_encoding(nullptr)
+    , pending_cached_encoding(nullptr)
+    , pending_line(-1)
     , enable_bookmarks(false)
     , bookmarks(nullptr)
     , update_bookmarks_idle(0)
@@ -313,6 +345,7 @@ moo_edit_init (MooEdit *edit)
 
     edit->priv->views = moo_edit_view_array_new ();
     edit->priv->buffer = GTK_TEXT_BUFFER (g_object_new (MOO_TYPE_TEXT_BUFFER, NULL));
+    _moo_text_buffer_set_word_index (MOO_TEXT_BUFFER (edit->priv->buffer), TRUE);
 
     edit->config = moo_edit_config_new ();
     g_signal_connect_swapped (edit->config, "notify",
@@ -382,6 +415,9 @@ moo_edit_finalize (GObject *object)
     g_free (edit->priv->display_filename);
     g_free (edit->priv->display_basename);
     g_free (edit->priv->encoding);
+    g_free (edit->priv->pending_encoding);
+    g_free (edit->priv->pending_cached_encoding);
+    g_free (edit->priv->filter_config);
 
     edit->priv->~MooEditPrivate();
 
@@ -410,12 +446,15 @@ _moo_edit_closed (MooEdit *doc)
         doc->config = NULL;
     }
 
-    if (doc->priv->apply_config_idle)
+    if (doc->priv->recheck_queued)
     {
-        g_source_remove (doc->priv->apply_config_idle);
-        doc->priv->apply_config_idle = 0;
+        g_queue_remove (&recheck_queue.docs, doc);
+        doc->priv->recheck_queued = false;
     }
 
+    if (doc->priv->file)
+        _moo_edit_forget_file_lang (doc->priv->file);
+
     if (doc->priv->file_monitor_id)
     {
         _moo_edit_stop_file_watch (doc);
@@ -569,6 +608,8 @@ static void
 changed_cb (G_GNUC_UNUSED GtkTextBuffer *buffer,
             MooEdit                     *edit)
 {
+    edit->priv->change_stamp++;
+
     // nothing to do when not auto-syncing
     if (!moo_prefs_get_bool (moo_edit_setting (MOO_EDIT_PREFS_AUTO_SYNC)))
         return;
@@ -1273,28 +1314,6 @@ moo_edit_get_lang_id (MooEdit *doc)
     return g_strdup (_moo_lang_id (lang));
 }
 
-static gboolean
-moo_edit_apply_config_all_in_idle (void)
-{
-    MooEditList *l;
-
-    moo_edit_apply_config_all_idle = 0;
-
-    for (l = _moo_edit_instances; l != NULL; l = l->next)
-        moo_edit_recheck_config (l->data);
-
-    return FALSE;
-}
-
-void
-_moo_edit_queue_recheck_config_all (void)
-{
-    if (!moo_edit_apply_config_all_idle)
-        moo_edit_apply_config_all_idle =
-            g_idle_add ((GSourceFunc) moo_edit_apply_config_all_in_idle, NULL);
-}
-
-
 static void
 update_lang_config_from_lang_globs (MooEdit *doc)
 {
@@ -1302,9 +1321,29 @@ update_lang_config_from_lang_globs (MooEdit *doc)
 
     if (doc->priv->file)
     {
-        MooLangMgr *mgr = moo_lang_mgr_default ();
-        MooLang *lang = moo_lang_mgr_get_lang_for_file (mgr, doc->priv->file);
-        lang_id = lang ? _moo_lang_id (lang) : NULL;
+        char *uri = g_file_get_uri (doc->priv->file);
+        gpointer cached;
+
+        if (!recheck_queue.file_langs)
+            recheck_queue.file_langs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                              g_free, NULL);
+
+        // lang ids are interned, "" stands for no lang
+        if (g_hash_table_lookup_extended (recheck_queue.file_langs, uri, NULL, &cached))
+        {
+            lang_id = (const char*) cached;
+            g_free (uri);
+        }
+        else
+        {
+            MooLangMgr *mgr = moo_lang_mgr_default ();
+            MooLang *lang = moo_lang_mgr_get_lang_for_file (mgr, doc->priv->file);
+            lang_id = g_intern_string (lang ? _moo_lang_id (lang) : "");
+            g_hash_table_insert (recheck_queue.file_langs, uri, (gpointer) lang_id);
+        }
+
+        if (!lang_id[0])
+            lang_id = NULL;
     }
 
     moo_edit_config_set (doc->config, MOO_EDIT_CONFIG_SOURCE_FILENAME,
@@ -1322,7 +1361,8 @@ update_config_from_filter_settings (MooEdit *doc)
         moo_edit_config_parse (doc->config, filter_config,
                                MOO_EDIT_CONFIG_SOURCE_FILENAME);
 
-    g_free (filter_config);
+    g_free (doc->priv->filter_config);
+    doc->priv->filter_config = filter_config;
 }
 
 static void
@@ -1355,11 +1395,7 @@ moo_edit_recheck_config (MooEdit *doc)
 {
     g_return_if_fail (!doc->priv->in_recheck_config);
 
-    if (doc->priv->apply_config_idle)
-    {
-        g_source_remove (doc->priv->apply_config_idle);
-        doc->priv->apply_config_idle = 0;
-    }
+    doc->priv->recheck_config = 0;
 
     moo_edit_freeze_notify (doc);
     doc->priv->in_recheck_config = TRUE;
@@ -1390,22 +1426,146 @@ moo_edit_recheck_config (MooEdit *doc)
 }
 
 static gboolean
-moo_edit_recheck_config_in_idle (MooEdit *edit)
+filter_config_changed (MooEdit *doc)
 {
-    edit->priv->apply_config_idle = 0;
-    moo_edit_recheck_config (edit);
+    char *filter_config = _moo_edit_filter_settings_get_for_doc (doc);
+    gboolean changed = g_strcmp0 (filter_config, doc->priv->filter_config) != 0;
+    g_free (filter_config);
+    return changed;
+}
+
+// does only what the changes require
+static void
+moo_edit_recheck_changed_config (MooEdit *doc)
+{
+    guint what = doc->priv->recheck_config;
+
+    doc->priv->recheck_config = 0;
+
+    if ((what & (MOO_EDIT_CONFIG_CHANGED_DOC | MOO_EDIT_CONFIG_CHANGED_LANGS)) ||
+        ((what & MOO_EDIT_CONFIG_CHANGED_FILTERS) && filter_config_changed (doc)))
+            moo_edit_recheck_config (doc);
+    else if (what & MOO_EDIT_CONFIG_CHANGED_PREFS)
+        moo_edit_apply_prefs (doc);
+}
+
+static void
+queue_recheck (MooEdit *doc,
+               guint    what)
+{
+    doc->priv->recheck_config |= what;
+
+    if (!doc->priv->recheck_queued)
+    {
+        doc->priv->recheck_queued = true;
+        g_queue_push_tail (&recheck_queue.docs, doc);
+    }
+}
+
+static void
+queue_recheck_all (void)
+{
+    guint what = recheck_queue.changed_all;
+    MooEditList *l;
+
+    recheck_queue.changed_all = 0;
+
+    // the prefs dialog notifies about changed keys after its pages
+    // have been applied, so it's checked here and not when queued
+    if (!recheck_queue.prefs_changed)
+        what &= ~MOO_EDIT_CONFIG_CHANGED_PREFS;
+    recheck_queue.prefs_changed = false;
+
+    if (what)
+        for (l = _moo_edit_instances; l != NULL; l = l->next)
+            queue_recheck (l->data, what);
+}
+
+#define RECHECK_SLICE 0.01
+
+static gboolean
+recheck_config_in_idle (void)
+{
+    GTimer *timer;
+
+    if (recheck_queue.changed_all)
+        queue_recheck_all ();
+
+    timer = g_timer_new ();
+
+    while (!g_queue_is_empty (&recheck_queue.docs) &&
+           g_timer_elapsed (timer, NULL) < RECHECK_SLICE)
+    {
+        MooEdit *doc = (MooEdit*) g_queue_pop_head (&recheck_queue.docs);
+        doc->priv->recheck_queued = false;
+        moo_edit_recheck_changed_config (doc);
+    }
+
+    g_timer_destroy (timer);
+
+    if (!g_queue_is_empty (&recheck_queue.docs))
+        return TRUE;
+
+    recheck_queue.idle = 0;
     return FALSE;
 }
 
+static void
+start_recheck_idle (void)
+{
+    // above redrawing, so that visible documents are updated before
+    // the window is drawn again, but below events
+    if (!recheck_queue.idle)
+        recheck_queue.idle = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                                              (GSourceFunc) recheck_config_in_idle,
+                                              NULL, NULL);
+}
+
+static void
+editor_prefs_changed (void)
+{
+    recheck_queue.prefs_changed = true;
+}
+
+/**
+ * _moo_edit_queue_recheck_config_all:
+ *
+ * Schedules updating documents after global settings change. Documents
+ * which the change does not affect are skipped: preferences are applied
+ * only if some editor preference actually changed, and per-file settings
+ * only to documents for which they give a different result.
+ */
+void
+_moo_edit_queue_recheck_config_all (MooEditConfigChange what)
+{
+    if ((what & MOO_EDIT_CONFIG_CHANGED_LANGS) && recheck_queue.file_langs)
+        g_hash_table_remove_all (recheck_queue.file_langs);
+
+    recheck_queue.changed_all |= what;
+    start_recheck_idle ();
+}
+
+void
+_moo_edit_forget_file_lang (GFile *file)
+{
+    char *uri;
+
+    g_return_if_fail (G_IS_FILE (file));
+
+    if (!recheck_queue.file_langs)
+        return;
+
+    uri = g_file_get_uri (file);
+    g_hash_table_remove (recheck_queue.file_langs, uri);
+    g_free (uri);
+}
+
 void
 _moo_edit_queue_recheck_config (MooEdit *doc)
 {
     g_return_if_fail (!doc->priv->in_recheck_config);
-    if (!doc->priv->apply_config_idle)
-        doc->priv->apply_config_idle =
-                g_idle_add_full (G_PRIORITY_HIGH,
-                                 (GSourceFunc) moo_edit_recheck_config_in_idle,
-                                 doc, NULL);
+    queue_recheck (doc, MOO_EDIT_CONFIG_CHANGED_DOC);
+    start_recheck_idle ();
 }
 
 static void
@@ -1609,6 +1769,67 @@ _moo_edit_set_state (MooEdit        *doc,
 }
 
 
+/*****************************************************************************/
+/* Large files
+ */
+
+/* memory kept for undo in a large file, older actions are dropped */
+#define LARGE_FILE_UNDO_LIMIT (16 * 1024 * 1024)
+
+gboolean
+_moo_edit_size_is_large (gsize size,
+                         int   n_lines)
+{
+    int max_size = moo_prefs_get_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_SIZE));
+    int max_lines = moo_prefs_get_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES));
+
+    return (max_size > 0 && size >= (gsize) max_size * 1024 * 1024) ||
+           (max_lines > 0 && n_lines >= max_lines);
+}
+
+gboolean
+_moo_edit_is_large_file (MooEdit *doc)
+{
+    g_return_val_if_fail (MOO_IS_EDIT (doc), FALSE);
+    return doc->priv->large_file;
+}
+
+void
+_moo_edit_set_large_file (MooEdit  *doc,
+                          gboolean  large)
+{
+    MooUndoStack *undo_stack;
+    MooEditTab *tab;
+    guint i;
+
+    g_return_if_fail (MOO_IS_EDIT (doc));
+
+    if (doc->priv->large_file == !!large)
+        return;
+
+    doc->priv->large_file = large;
+
+    undo_stack = MOO_UNDO_STACK (_moo_text_buffer_get_undo_stack (MOO_TEXT_BUFFER (doc->priv->buffer)));
+    moo_undo_stack_set_max_size (undo_stack, large ? LARGE_FILE_UNDO_LIMIT : 0);
+    _moo_text_buffer_set_word_index (MOO_TEXT_BUFFER (doc->priv->buffer), !large);
+
+    moo_edit_apply_prefs (doc);
+    for (i = 0; i < doc->priv->views->n_elms; ++i)
+        _moo_edit_view_apply_config (doc->priv->views->elms[i]);
+
+    if ((tab = moo_edit_get_tab (doc)))
+        _moo_edit_tab_set_large_file (tab, large);
+}
+
+void
+_moo_edit_leave_large_file (MooEdit *doc)
+{
+    g_return_if_fail (MOO_IS_EDIT (doc));
+    doc->priv->large_file_declined = true;
+    _moo_edit_set_large_file (doc, FALSE);
+}
+
+
 /*****************************************************************************/
 /* Comment/uncomment
  */
@@ -19,6 +19,7 @@
 #include "mooedit/moolang.h"
 #include "mooedit/mooeditconfig.h"
 #include "mooedit/mooedit.h"
+#include "mooedit/mooedit-impl.h"
 #include "mooutils/mooprefs.h"
 #include "mooutils/mooutils-misc.h"
 #include "mooutils/mooutils-debug.h"
@@ -32,6 +33,10 @@ MOO_DEBUG_INIT(filters, FALSE)
 #define PROP_FILTER             "filter"
 #define PROP_CONFIG             "config"
 
+/* FilterSettingsStore::cache is emptied when it grows past this, documents
+ * which are still open just get their entries back on the next recheck */
+#define MAX_CACHED_SETTINGS     1024
+
 typedef enum {
     MOO_EDIT_FILTER_LANGS,
     MOO_EDIT_FILTER_GLOBS,
@@ -56,6 +61,9 @@ typedef struct {
 
 typedef struct {
     GSList *settings;
+    /* results of filter_settings_store_get_setting(), the key is made of
+     * everything the filters look at, "" stands for no settings */
+    GHashTable *cache;
 } FilterSettingsStore;
 
 static FilterSettingsStore *settings_store;
@@ -439,6 +447,7 @@ filter_settings_store_new (void)
     FilterSettingsStore *store;
 
     store = g_new0 (FilterSettingsStore, 1);
+    store->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
     return store;
 }
@@ -449,6 +458,7 @@ filter_settings_store_free (FilterSettingsStore *store)
 {
     g_slist_foreach (store->settings, (GFunc) filter_setting_free, NULL);
     g_slist_free (store->settings);
+    g_hash_table_destroy (store->cache);
     g_free (store);
 }
 
@@ -523,6 +533,7 @@ _moo_edit_filter_settings_reload (void)
         filter_settings_store_free (settings_store);
     settings_store = NULL;
     _moo_edit_filter_settings_load ();
+    _moo_edit_queue_recheck_config_all (MOO_EDIT_CONFIG_CHANGED_FILTERS);
 }
 
 
@@ -541,6 +552,25 @@ filter_settings_store_get_setting (FilterSettingsStore *store,
 {
     GSList *l;
     GString *result = NULL;
+    GFile *file;
+    char *uri, *lang_id, *key;
+    const char *cached;
+
+    file = moo_edit_get_file (doc);
+    uri = file ? g_file_get_uri (file) : NULL;
+    lang_id = moo_edit_get_lang_id (doc);
+    key = g_strdup_printf ("%s\n%s\n%s", uri ? uri : "",
+                           lang_id ? lang_id : "",
+                           moo_edit_get_display_name (doc));
+    moo_file_free (file);
+    g_free (lang_id);
+    g_free (uri);
+
+    if ((cached = (const char*) g_hash_table_lookup (store->cache, key)))
+    {
+        g_free (key);
+        return cached[0] ? g_strdup (cached) : NULL;
+    }
 
     for (l = store->settings; l != NULL; l = l->next)
     {
@@ -554,6 +584,10 @@ filter_settings_store_get_setting (FilterSettingsStore *store,
         }
     }
 
+    if (g_hash_table_size (store->cache) >= MAX_CACHED_SETTINGS)
+        g_hash_table_remove_all (store->cache);
+    g_hash_table_insert (store->cache, key, g_strdup (result ? result->str : ""));
+
     return result ? g_string_free (result, FALSE) : NULL;
 }
 
@@ -19,6 +19,8 @@ MooFileWatch    *_moo_editor_get_file_watch     (MooEditor      *editor);
 
 void             _moo_editor_apply_prefs        (MooEditor      *editor);
 
+gboolean         _moo_editor_is_loading_session (MooEditor      *editor);
+
 G_END_DECLS
 
 #endif /* MOO_EDITOR_IMPL_H */
@@ -43,6 +43,8 @@ struct MooEditorPrivate {
     GType                doc_type;
 
     MooLangMgr          *lang_mgr;
+
+    gboolean             loading_session;
 };
 
 G_END_DECLS
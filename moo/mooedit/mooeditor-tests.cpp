@@ -1,8 +1,24 @@
 #include "mooedit/mooeditor-tests.h"
 #include "mooedit/mooeditor-impl.h"
+#include "mooedit/mooedit-impl.h"
+#include "mooedit/mooeditwindow-impl.h"
+#include "mooedit/mooeditprefs.h"
+#include "mooedit/mooedit-script.h"
+#include "mooedit/mooindenter.h"
+#include "mooedit/moowordindex.h"
+#include "mooedit/mooeditfiltersettings.h"
+#include "mooedit/mooedit-fileops.h"
+#include "mooedit/mootextsearch.h"
+#include "mooedit/mootextprint.h"
+#include "mooedit/moolangmgr.h"
+#include "mooedit/mootext-private.h"
 #include "mooutils/mooutils-fs.h"
 #include "mooutils/moohistorymgr.h"
+#include "mooutils/moofilewriter.h"
+#include "mooutils/mooundo.h"
 #include "moocpp/fileutils.h"
+#include <mooglib/moo-glib.h>
+#include <time.h>
 
 static struct {
     gstr working_dir;
@@ -195,6 +211,1164 @@ test_encodings (void)
     g_dir_close (dir);
 }
 
+/* saving gives back what was loaded, and saving again without changes
+ * gives the same text */
+static void
+check_saved_session (MooEditor  *editor,
+                     const char *uri1,
+                     const char *uri2)
+{
+    GString *saved = g_string_new (NULL);
+    GString *saved_again = g_string_new (NULL);
+    MooMarkupDoc *xml;
+    MooMarkupNode *editor_node = NULL;
+    MooMarkupNode *window_node;
+    MooMarkupNode *node;
+    gboolean found1 = FALSE, found2 = FALSE;
+
+    _moo_editor_save_session (editor, saved);
+    _moo_editor_save_session (editor, saved_again);
+    TEST_ASSERT_STR_EQ (saved_again->str, saved->str);
+
+    xml = moo_markup_parse_memory (saved->str, -1, NULL);
+    TEST_ASSERT (xml != NULL);
+
+    if (xml)
+        editor_node = moo_markup_get_root_element (xml, "editor");
+    TEST_ASSERT (editor_node != NULL);
+
+    for (window_node = editor_node ? editor_node->children : NULL; window_node; window_node = window_node->next)
+    {
+        if (!MOO_MARKUP_IS_ELEMENT (window_node))
+            continue;
+
+        for (node = window_node->children; node != NULL; node = node->next)
+        {
+            if (!MOO_MARKUP_IS_ELEMENT (node))
+                continue;
+
+            if (moo_str_equal (moo_markup_get_content (node), uri1))
+            {
+                TEST_ASSERT_INT_EQ (moo_markup_int_prop (node, "line", -1), 1);
+                TEST_ASSERT (!moo_markup_bool_prop (node, "active", FALSE));
+                found1 = TRUE;
+            }
+            else if (moo_str_equal (moo_markup_get_content (node), uri2))
+            {
+                TEST_ASSERT (moo_markup_bool_prop (node, "active", FALSE));
+                found2 = TRUE;
+            }
+        }
+    }
+
+    TEST_ASSERT (found1 && found2);
+
+    if (xml)
+        moo_markup_doc_unref (xml);
+    g_string_free (saved, TRUE);
+    g_string_free (saved_again, TRUE);
+}
+
+/* restores a window with two documents, the second one is active
+ * and the first one waits for its text */
+static gboolean
+load_lazy_session (const char *uri1,
+                   const char *uri2)
+{
+    MooMarkupDoc *xml;
+    GError *error = NULL;
+    gboolean lazy;
+
+    gstr session = gstr::take (g_markup_printf_escaped (
+        "<session><editor version=\"2.0\"><window>"
+        "<document line=\"1\">%s</document>"
+        "<document active=\"true\">%s</document>"
+        "</window></editor></session>", uri1, uri2));
+
+    xml = moo_markup_parse_memory (session.get(), -1, &error);
+    if (!xml)
+    {
+        TEST_FAILED_MSG ("could not parse session: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    lazy = moo_prefs_get_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION));
+    moo_prefs_set_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION), TRUE);
+
+    _moo_editor_load_session (moo_editor_instance (), moo_markup_get_root_element (xml, "session"));
+    moo_markup_doc_unref (xml);
+
+    moo_prefs_set_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION), lazy);
+    return TRUE;
+}
+
+static void
+test_lazy_session (void)
+{
+    MooEditor *editor;
+    MooEdit *doc1, *doc2;
+    MooEditWindow *window;
+    char *text;
+
+    gstr filename1 = g::build_filename (test_data.working_dir, "session1.txt");
+    gstr filename2 = g::build_filename (test_data.working_dir, "session2.txt");
+    g_file_set_contents (filename1.get(), TT2, -1, NULL);
+    g_file_set_contents (filename2.get(), TT4, -1, NULL);
+
+    gstr uri1 = gstr::take (g_filename_to_uri (filename1.get(), NULL, NULL));
+    gstr uri2 = gstr::take (g_filename_to_uri (filename2.get(), NULL, NULL));
+
+    if (!load_lazy_session (uri1.get(), uri2.get()))
+        return;
+
+    editor = moo_editor_instance ();
+    doc1 = moo_editor_get_doc (editor, filename1.get());
+    doc2 = moo_editor_get_doc (editor, filename2.get());
+    TEST_ASSERT (doc1 != NULL && doc2 != NULL);
+
+    if (doc1 && doc2)
+    {
+        window = moo_edit_get_window (doc2);
+        TEST_ASSERT (moo_edit_window_get_active_doc (window) == doc2);
+        TEST_ASSERT (!_moo_edit_is_load_pending (doc2));
+        TEST_ASSERT (_moo_edit_is_load_pending (doc1));
+        TEST_ASSERT (_moo_edit_get_pending_line (doc1) == 1);
+
+        check_saved_session (editor, uri1.get(), uri2.get());
+
+        text = moo_edit_get_text (doc1, NULL, NULL);
+        TEST_ASSERT_STR_EQ (text, TT2);
+        TEST_ASSERT (!_moo_edit_is_load_pending (doc1));
+        TEST_ASSERT (moo_edit_get_line_at_cursor (doc1) == 1);
+        TEST_ASSERT (!moo_edit_is_modified (doc1));
+        g_free (text);
+
+        TEST_ASSERT (moo_editor_close_window (editor, window));
+    }
+}
+
+#define MANY_TABS 50
+
+/* opens n new documents in one batch */
+static MooEditArray *
+open_tabs (MooEditWindow *window,
+           guint          n)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooEditArray *docs = moo_edit_array_new ();
+    guint i;
+
+    _moo_edit_window_begin_update (window);
+    for (i = 0; i < n; ++i)
+        moo_edit_array_append (docs, moo_editor_new_doc (editor, window));
+    _moo_edit_window_end_update (window);
+
+    return docs;
+}
+
+static void
+test_many_tabs (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooEditArray *docs;
+
+    editor = moo_editor_instance ();
+    window = moo_editor_new_window (editor);
+    docs = open_tabs (window, MANY_TABS);
+
+    /* in order, and the last one is active */
+    TEST_ASSERT (moo_edit_window_get_n_tabs (window) == MANY_TABS + 1);
+    TEST_ASSERT (moo_edit_window_get_active_doc (window) == docs->elms[MANY_TABS - 1]);
+    TEST_ASSERT (moo_edit_tab_get_doc (moo_edit_window_get_nth_tab (window, 1)) == docs->elms[0]);
+    TEST_ASSERT (moo_edit_tab_get_doc (moo_edit_window_get_nth_tab (window, MANY_TABS)) == docs->elms[MANY_TABS - 1]);
+
+    TEST_ASSERT (moo_editor_close_docs (editor, docs));
+
+    TEST_ASSERT (moo_edit_window_get_n_tabs (window) == 1);
+    TEST_ASSERT (moo_edit_window_get_active_doc (window) != NULL);
+
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+
+    moo_edit_array_free (docs);
+}
+
+#define OPEN_FILES 20
+
+static MooOpenInfoArray *
+create_files (const char *prefix,
+              guint       n_files,
+              gboolean    new_window)
+{
+    MooOpenInfoArray *files = moo_open_info_array_new ();
+    guint i;
+
+    for (i = 0; i < n_files; ++i)
+    {
+        gstr name = gstr::take (g_strdup_printf ("%s%u.txt", prefix, i));
+        gstr filename = g::build_filename (test_data.working_dir, name);
+        g_file_set_contents (filename.get(), TT2, -1, NULL);
+        MooOpenInfo *info = moo_open_info_new (filename.get(), NULL, -1, MOO_OPEN_FLAGS_NONE);
+        if (new_window && i == 0)
+            moo_open_info_add_flags (info, MOO_OPEN_FLAG_NEW_WINDOW);
+        moo_open_info_array_take (files, info);
+    }
+
+    return files;
+}
+
+static gboolean
+files_in_window (MooOpenInfoArray *files,
+                 MooEditWindow    *window)
+{
+    MooEditor *editor = moo_editor_instance ();
+    guint i;
+
+    for (i = 0; i < files->n_elms; ++i)
+    {
+        char *filename = moo_open_info_get_filename (files->elms[i]);
+        MooEdit *doc = moo_editor_get_doc (editor, filename);
+        g_free (filename);
+
+        if (!doc || moo_edit_get_window (doc) != window)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* what the app does when a running instance gets files to open:
+ * first into a new window, then more into the same window */
+static void
+test_open_files (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooEditWindowArray *windows;
+    MooOpenInfoArray *files, *more_files;
+    guint n_windows;
+
+    editor = moo_editor_instance ();
+    windows = moo_editor_get_windows (editor);
+    n_windows = windows->n_elms;
+    moo_edit_window_array_free (windows);
+
+    files = create_files ("first", OPEN_FILES, TRUE);
+    TEST_ASSERT (moo_editor_open_files (editor, files, NULL, NULL));
+
+    window = moo_editor_get_active_window (editor);
+    TEST_ASSERT (window != NULL);
+    TEST_ASSERT (window && moo_edit_window_get_n_tabs (window) == OPEN_FILES);
+    TEST_ASSERT (files_in_window (files, window));
+
+    more_files = create_files ("more", OPEN_FILES, FALSE);
+    TEST_ASSERT (moo_editor_open_files (editor, more_files, NULL, NULL));
+
+    TEST_ASSERT (moo_editor_get_active_window (editor) == window);
+    TEST_ASSERT (window && moo_edit_window_get_n_tabs (window) == 2 * OPEN_FILES);
+    TEST_ASSERT (files_in_window (more_files, window));
+
+    /* only the first file asked for a new window */
+    windows = moo_editor_get_windows (editor);
+    TEST_ASSERT_INT_EQ (windows->n_elms, n_windows + 1);
+    moo_edit_window_array_free (windows);
+
+    if (window)
+        TEST_ASSERT (moo_editor_close_window (editor, window));
+
+    moo_open_info_array_free (more_files);
+    moo_open_info_array_free (files);
+}
+
+#define NEW_WINDOWS 3
+
+static GtkWidget *
+find_statusbar (MooEditWindow *window)
+{
+    GList *children, *l;
+    GtkWidget *statusbar = NULL;
+
+    children = gtk_container_get_children (GTK_CONTAINER (MOO_WINDOW (window)->status_area));
+
+    for (l = children; l != NULL && !statusbar; l = l->next)
+        if (GTK_IS_FRAME (l->data))
+            statusbar = GTK_WIDGET (l->data);
+
+    g_list_free (children);
+    return statusbar;
+}
+
+/* windows share the parsed statusbar definition, and each gets
+ * its own widgets built from it */
+static void
+test_new_window (void)
+{
+    MooEditor *editor;
+    MooEditWindowArray *windows, *all_windows;
+    GtkWidget *statusbars[NEW_WINDOWS];
+    guint n_windows, i, j;
+
+    editor = moo_editor_instance ();
+    windows = moo_edit_window_array_new ();
+
+    all_windows = moo_editor_get_windows (editor);
+    n_windows = all_windows->n_elms;
+    moo_edit_window_array_free (all_windows);
+
+    for (i = 0; i < NEW_WINDOWS; ++i)
+        moo_edit_window_array_append (windows, moo_editor_new_window (editor));
+
+    all_windows = moo_editor_get_windows (editor);
+    TEST_ASSERT_INT_EQ (all_windows->n_elms, n_windows + NEW_WINDOWS);
+    moo_edit_window_array_free (all_windows);
+
+    for (i = 0; i < windows->n_elms; ++i)
+    {
+        TEST_ASSERT (windows->elms[i] != NULL && moo_edit_window_get_n_tabs (windows->elms[i]) == 1);
+        statusbars[i] = windows->elms[i] ? find_statusbar (windows->elms[i]) : NULL;
+        TEST_ASSERT (statusbars[i] != NULL);
+
+        for (j = 0; j < i; ++j)
+            TEST_ASSERT (statusbars[i] != statusbars[j]);
+    }
+
+    for (i = 0; i < windows->n_elms; ++i)
+        TEST_ASSERT (moo_editor_close_window (editor, windows->elms[i]));
+
+    all_windows = moo_editor_get_windows (editor);
+    TEST_ASSERT_INT_EQ (all_windows->n_elms, n_windows);
+    moo_edit_window_array_free (all_windows);
+
+    moo_edit_window_array_free (windows);
+}
+
+#define RELOAD_LINES 1000
+
+static char *
+reload_text (GtkTextBuffer *buffer)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    return gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+}
+
+/* writes the file so that the file watch notices it even if it
+ * was changed within the same second */
+static void
+reload_write_file (const gstr& filename,
+                   const char *text)
+{
+    GFile *file;
+
+    TEST_ASSERT (g_file_set_contents (filename.get(), text, -1, NULL));
+
+    file = g_file_new_for_path (filename.get());
+    TEST_ASSERT (g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                              (guint64) time (NULL) + 10,
+                                              G_FILE_QUERY_INFO_NONE, NULL, NULL));
+    g_object_unref (file);
+}
+
+static void
+test_reload (void)
+{
+    MooEditor *editor;
+    MooEdit *doc;
+    GtkTextBuffer *buffer;
+    GtkTextMark *mark;
+    GtkTextIter iter;
+    GString *text;
+    char *contents;
+    GTimer *timer;
+    gboolean auto_sync, highlight;
+    int large_lines;
+    guint i;
+
+    editor = moo_editor_instance ();
+    gstr filename = g::build_filename (test_data.working_dir, "reload.txt");
+
+    text = g_string_new (NULL);
+    for (i = 0; i < RELOAD_LINES; ++i)
+        g_string_append_printf (text, "line %u\n", i);
+    g_file_set_contents (filename.get(), text->str, -1, NULL);
+
+    doc = moo_editor_open_path (editor, filename.get(), NULL, -1, NULL);
+    TEST_ASSERT (doc != NULL);
+    if (!doc)
+    {
+        g_string_free (text, TRUE);
+        return;
+    }
+
+    buffer = moo_edit_get_buffer (doc);
+
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, RELOAD_LINES - 10);
+    mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+
+    /* change a line near the start and append one */
+    g_string_erase (text, 0, strlen ("line 0"));
+    g_string_prepend (text, "changed");
+    g_string_append (text, "appended\n");
+    g_file_set_contents (filename.get(), text->str, -1, NULL);
+
+    TEST_ASSERT (moo_edit_reload (doc, NULL, NULL));
+
+    contents = reload_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, text->str);
+    g_free (contents);
+    TEST_ASSERT (!moo_edit_is_modified (doc));
+    TEST_ASSERT (moo_text_buffer_can_undo (MOO_TEXT_BUFFER (buffer)));
+
+    /* the mark was on an unchanged line, it must not have moved */
+    gtk_text_buffer_get_iter_at_mark (buffer, &iter, mark);
+    TEST_ASSERT_INT_EQ (gtk_text_iter_get_line (&iter), RELOAD_LINES - 10);
+    TEST_ASSERT (gtk_text_iter_starts_line (&iter));
+
+    /* with auto-sync the change is noticed by the file watch, and the
+     * file is read and compared on a worker thread */
+    auto_sync = moo_prefs_get_bool (moo_edit_setting (MOO_EDIT_PREFS_AUTO_SYNC));
+    moo_prefs_set_bool (moo_edit_setting (MOO_EDIT_PREFS_AUTO_SYNC), TRUE);
+
+    g_string_prepend (text, "inserted\n");
+    reload_write_file (filename, text->str);
+
+    timer = g_timer_new ();
+    contents = reload_text (buffer);
+    while (strcmp (contents, text->str) != 0 && g_timer_elapsed (timer, NULL) < 30)
+    {
+        g_main_context_iteration (NULL, TRUE);
+        g_free (contents);
+        contents = reload_text (buffer);
+    }
+    g_timer_destroy (timer);
+
+    TEST_ASSERT_STR_EQ (contents, text->str);
+    g_free (contents);
+    TEST_ASSERT (!moo_edit_is_modified (doc));
+
+    gtk_text_buffer_get_iter_at_mark (buffer, &iter, mark);
+    TEST_ASSERT_INT_EQ (gtk_text_iter_get_line (&iter), RELOAD_LINES - 9);
+    TEST_ASSERT (gtk_text_iter_starts_line (&iter));
+
+    moo_prefs_set_bool (moo_edit_setting (MOO_EDIT_PREFS_AUTO_SYNC), auto_sync);
+
+    /* growing past the large file limit switches highlighting off,
+     * and shrinking back turns it on again */
+    large_lines = moo_prefs_get_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES));
+    moo_prefs_set_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES), 2 * RELOAD_LINES);
+    highlight = moo_text_buffer_get_highlight (MOO_TEXT_BUFFER (buffer));
+    TEST_ASSERT (!_moo_edit_is_large_file (doc));
+
+    for (i = 0; i < RELOAD_LINES; ++i)
+        g_string_append_printf (text, "more %u\n", i);
+    g_file_set_contents (filename.get(), text->str, -1, NULL);
+    TEST_ASSERT (moo_edit_reload (doc, NULL, NULL));
+    TEST_ASSERT (_moo_edit_is_large_file (doc));
+    TEST_ASSERT (!moo_text_buffer_get_highlight (MOO_TEXT_BUFFER (buffer)));
+
+    g_string_truncate (text, 0);
+    g_string_append (text, "short\n");
+    g_file_set_contents (filename.get(), text->str, -1, NULL);
+    TEST_ASSERT (moo_edit_reload (doc, NULL, NULL));
+    TEST_ASSERT (!_moo_edit_is_large_file (doc));
+    TEST_ASSERT (!moo_text_buffer_get_highlight (MOO_TEXT_BUFFER (buffer)) == !highlight);
+
+    contents = reload_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, "short\n");
+    g_free (contents);
+
+    moo_prefs_set_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES), large_lines);
+
+    TEST_ASSERT (moo_edit_close (doc));
+    g_string_free (text, TRUE);
+}
+
+static char *
+get_buffer_text (GtkTextBuffer *buffer)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+}
+
+#define LARGE_FILE_LINES    2000
+#define LARGE_FILE_INSERTS  10
+#define LARGE_FILE_CHUNK    1000
+
+static int
+count_undo_steps (MooUndoStack *undo_stack)
+{
+    int n = 0;
+
+    while (moo_undo_stack_can_undo (undo_stack))
+    {
+        moo_undo_stack_undo (undo_stack);
+        n += 1;
+    }
+
+    return n;
+}
+
+static void
+test_large_file (void)
+{
+    MooEditor *editor;
+    MooEdit *doc;
+    MooEditView *view;
+    GtkTextBuffer *buffer;
+    MooUndoStack *undo_stack;
+    GtkTextIter iter;
+    GString *text;
+    char *chunk;
+    char *contents;
+    int large_lines;
+    int n_undo;
+    int i;
+
+    large_lines = moo_prefs_get_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES));
+    moo_prefs_set_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES), LARGE_FILE_LINES / 2);
+
+    text = g_string_new (NULL);
+    for (i = 0; i < LARGE_FILE_LINES; ++i)
+        g_string_append_printf (text, "line %d: the quick brown fox jumps over the lazy dog\n", i);
+
+    editor = moo_editor_instance ();
+    gstr filename = g::build_filename (test_data.working_dir, "large.txt");
+    TEST_ASSERT (g_file_set_contents (filename.get(), text->str, -1, NULL));
+
+    doc = moo_editor_open_path (editor, filename.get(), NULL, -1, NULL);
+    TEST_ASSERT (doc != NULL);
+    if (!doc)
+    {
+        moo_prefs_set_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES), large_lines);
+        g_string_free (text, TRUE);
+        return;
+    }
+
+    buffer = moo_edit_get_buffer (doc);
+    view = moo_edit_get_view (doc);
+
+    TEST_ASSERT (_moo_edit_is_large_file (doc));
+    TEST_ASSERT (!moo_text_buffer_get_highlight (MOO_TEXT_BUFFER (buffer)));
+    TEST_ASSERT (!moo_text_buffer_can_undo (MOO_TEXT_BUFFER (buffer)));
+    TEST_ASSERT (gtk_text_view_get_wrap_mode (GTK_TEXT_VIEW (view)) == GTK_WRAP_NONE);
+
+    /* undo is limited in large files, the oldest steps are dropped
+     * but the text they made stays */
+    undo_stack = MOO_UNDO_STACK (_moo_text_buffer_get_undo_stack (MOO_TEXT_BUFFER (buffer)));
+    moo_undo_stack_set_max_size (undo_stack, LARGE_FILE_INSERTS / 2 * LARGE_FILE_CHUNK);
+
+    for (i = 0; i < LARGE_FILE_INSERTS; ++i)
+    {
+        chunk = g_strnfill (LARGE_FILE_CHUNK, 'a' + i);
+        gtk_text_buffer_get_start_iter (buffer, &iter);
+        gtk_text_buffer_begin_user_action (buffer);
+        gtk_text_buffer_insert (buffer, &iter, chunk, -1);
+        gtk_text_buffer_end_user_action (buffer);
+        g_free (chunk);
+    }
+
+    n_undo = count_undo_steps (undo_stack);
+    TEST_ASSERT (n_undo >= 1);
+    TEST_ASSERT (n_undo < LARGE_FILE_INSERTS);
+
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_INT_EQ (strlen (contents), text->len + (LARGE_FILE_INSERTS - n_undo) * LARGE_FILE_CHUNK);
+    TEST_ASSERT (contents[0] == 'a' + LARGE_FILE_INSERTS - n_undo - 1);
+    TEST_ASSERT (g_str_has_suffix (contents, text->str));
+    g_free (contents);
+
+    /* a single step larger than the limit is kept */
+    moo_undo_stack_set_max_size (undo_stack, LARGE_FILE_CHUNK / 10);
+    chunk = g_strnfill (LARGE_FILE_CHUNK, 'z');
+    gtk_text_buffer_get_start_iter (buffer, &iter);
+    gtk_text_buffer_begin_user_action (buffer);
+    gtk_text_buffer_insert (buffer, &iter, chunk, -1);
+    gtk_text_buffer_end_user_action (buffer);
+    g_free (chunk);
+    TEST_ASSERT_INT_EQ (count_undo_steps (undo_stack), 1);
+
+    /* after the user turned the features on, reloading the same
+     * file doesn't go back into large file mode */
+    moo_edit_set_modified (doc, FALSE);
+    _moo_edit_leave_large_file (doc);
+    TEST_ASSERT (!_moo_edit_is_large_file (doc));
+    TEST_ASSERT (moo_edit_reload (doc, NULL, NULL));
+    TEST_ASSERT (!_moo_edit_is_large_file (doc));
+
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, text->str);
+    g_free (contents);
+
+    moo_prefs_set_int (moo_edit_setting (MOO_EDIT_PREFS_LARGE_FILE_LINES), large_lines);
+
+    TEST_ASSERT (moo_edit_close (doc));
+    g_string_free (text, TRUE);
+}
+
+static char *
+get_line_text (GtkTextBuffer *buffer,
+               int            line)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line (buffer, &start, line);
+    end = start;
+    if (!gtk_text_iter_ends_line (&end))
+        gtk_text_iter_forward_to_line_end (&end);
+    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+}
+
+#define SHIFT_LINES 9
+
+/* three kinds of lines: tab indented, space indented and empty */
+static char *
+shift_lines_text (guint        n_lines,
+                  const char  *tab_line,
+                  const char  *space_line)
+{
+    GString *text = g_string_new (NULL);
+    guint i;
+
+    for (i = 0; i < n_lines; ++i)
+        g_string_append (text, i % 3 == 0 ? tab_line : i % 3 == 1 ? space_line : "\n");
+
+    return g_string_free (text, FALSE);
+}
+
+static void
+test_shift_lines (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooEdit *doc;
+    MooEditView *view;
+    MooIndenter *indenter;
+    GtkTextBuffer *buffer;
+    char *text, *shifted, *unshifted, *contents;
+
+    editor = moo_editor_instance ();
+    window = moo_editor_new_window (editor);
+    doc = moo_edit_window_get_active_doc (window);
+    view = moo_edit_get_view (doc);
+    buffer = moo_edit_get_buffer (doc);
+    indenter = moo_indenter_new (doc);
+
+    moo_edit_config_set (doc->config, MOO_EDIT_CONFIG_SOURCE_USER,
+                         "indent-use-tabs", TRUE, "indent-width", 8u, "tab-width", 8u,
+                         (char*) NULL);
+
+    text = shift_lines_text (SHIFT_LINES, "\tfoo ();\n", "    bar ();\n");
+    shifted = shift_lines_text (SHIFT_LINES, "\t\tfoo ();\n", "\t    bar ();\n");
+    unshifted = shift_lines_text (SHIFT_LINES, "foo ();\n", "bar ();\n");
+    gtk_text_buffer_set_text (buffer, text, -1);
+
+    gtk_text_buffer_begin_user_action (buffer);
+    moo_indenter_shift_lines (indenter, buffer, 0, SHIFT_LINES - 1, 1);
+    gtk_text_buffer_end_user_action (buffer);
+
+    /* empty lines stay empty */
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, shifted);
+    g_free (contents);
+
+    /* the whole block is one undo step */
+    TEST_ASSERT (moo_text_view_undo (MOO_TEXT_VIEW (view)));
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, text);
+    g_free (contents);
+
+    TEST_ASSERT (moo_text_view_redo (MOO_TEXT_VIEW (view)));
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, shifted);
+    g_free (contents);
+
+    gtk_text_buffer_begin_user_action (buffer);
+    moo_indenter_shift_lines (indenter, buffer, 0, SHIFT_LINES - 1, -1);
+    gtk_text_buffer_end_user_action (buffer);
+
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, text);
+    g_free (contents);
+
+    /* indentation narrower than one level is removed completely */
+    gtk_text_buffer_begin_user_action (buffer);
+    moo_indenter_shift_lines (indenter, buffer, 0, SHIFT_LINES - 1, -1);
+    gtk_text_buffer_end_user_action (buffer);
+
+    contents = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (contents, unshifted);
+    g_free (contents);
+
+    /* lines outside the range are not touched */
+    gtk_text_buffer_set_text (buffer, text, -1);
+    gtk_text_buffer_begin_user_action (buffer);
+    moo_indenter_shift_lines (indenter, buffer, 1, 1, 1);
+    gtk_text_buffer_end_user_action (buffer);
+
+    contents = get_line_text (buffer, 0);
+    TEST_ASSERT_STR_EQ (contents, "\tfoo ();");
+    g_free (contents);
+    contents = get_line_text (buffer, 1);
+    TEST_ASSERT_STR_EQ (contents, "\t    bar ();");
+    g_free (contents);
+    contents = get_line_text (buffer, 4);
+    TEST_ASSERT_STR_EQ (contents, "    bar ();");
+    g_free (contents);
+
+    moo_edit_set_modified (doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+
+    g_object_unref (indenter);
+    g_free (unshifted);
+    g_free (shifted);
+    g_free (text);
+}
+
+#define WORD_INDEX_FILES 3
+#define WORD_INDEX_LINES 300
+
+static gboolean
+word_index_wait (void)
+{
+    GTimer *timer = g_timer_new ();
+    gboolean done;
+
+    while (_moo_word_index_n_building () && g_timer_elapsed (timer, NULL) < 300)
+        g_main_context_iteration (NULL, TRUE);
+
+    done = _moo_word_index_n_building () == 0;
+    g_timer_destroy (timer);
+    return done;
+}
+
+static gboolean
+word_index_has (const char *prefix,
+                const char *word)
+{
+    char **words = _moo_word_index_complete (prefix, G_MAXUINT);
+    gboolean found = FALSE;
+    guint i;
+
+    for (i = 0; words && words[i] && !found; ++i)
+        found = strcmp (words[i], word) == 0;
+
+    g_strfreev (words);
+    return found;
+}
+
+static void
+write_word_files (guint n_files,
+                  guint n_lines)
+{
+    GString *text = g_string_new (NULL);
+    guint i, f;
+
+    for (f = 0; f < n_files; ++f)
+    {
+        gstr name = gstr::take (g_strdup_printf ("words%u.c", f));
+        gstr filename = g::build_filename (test_data.working_dir, name);
+
+        g_string_truncate (text, 0);
+        for (i = 0; i < n_lines; ++i)
+            g_string_append_printf (text, "    result_%u = compute_value_%u (input_%u, %u);\n",
+                                    i % 5000, i % 100, f, i);
+        TEST_ASSERT (g_file_set_contents (filename.get(), text->str, text->len, NULL));
+    }
+
+    g_string_free (text, TRUE);
+}
+
+static MooEditArray *
+open_word_files (guint n_files)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooEditArray *docs = moo_edit_array_new ();
+    MooEdit *doc;
+    guint f;
+
+    for (f = 0; f < n_files; ++f)
+    {
+        gstr name = gstr::take (g_strdup_printf ("words%u.c", f));
+        gstr filename = g::build_filename (test_data.working_dir, name);
+        if ((doc = moo_editor_open_path (editor, filename.get(), NULL, -1, NULL)))
+            moo_edit_array_append (docs, doc);
+    }
+
+    return docs;
+}
+
+/* several open documents, completion queries go to all of them */
+static void
+test_word_index (void)
+{
+    MooEditor *editor;
+    MooEditArray *docs;
+    MooEdit *doc;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter, end;
+    char **words;
+    guint f;
+
+    editor = moo_editor_instance ();
+    write_word_files (WORD_INDEX_FILES, WORD_INDEX_LINES);
+    docs = open_word_files (WORD_INDEX_FILES);
+    TEST_ASSERT_INT_EQ (docs->n_elms, WORD_INDEX_FILES);
+    TEST_ASSERT (word_index_wait ());
+
+    words = _moo_word_index_complete ("compute_v", 10);
+    TEST_ASSERT (words != NULL && g_strv_length (words) == 10);
+    if (words && words[0])
+        TEST_ASSERT_STR_EQ (words[0], "compute_value_0");
+    g_strfreev (words);
+
+    words = _moo_word_index_match ("cmpvl", 10);
+    TEST_ASSERT (words != NULL && words[0] != NULL);
+    if (words && words[0])
+        TEST_ASSERT (g_str_has_prefix (words[0], "compute_value_"));
+    g_strfreev (words);
+
+    for (f = 0; f < WORD_INDEX_FILES; ++f)
+    {
+        gstr word = gstr::take (g_strdup_printf ("input_%u", f));
+        TEST_ASSERT (word_index_has ("input_", word.get()));
+    }
+
+    /* large files are not indexed, their words come back when
+     * the features are turned on again */
+    doc = docs->elms[WORD_INDEX_FILES - 1];
+    gstr last_word = gstr::take (g_strdup_printf ("input_%u", WORD_INDEX_FILES - 1));
+    _moo_edit_set_large_file (doc, TRUE);
+    TEST_ASSERT (!word_index_has ("input_", last_word.get()));
+    TEST_ASSERT (word_index_has ("input_", "input_0"));
+    _moo_edit_set_large_file (doc, FALSE);
+    TEST_ASSERT (word_index_wait ());
+    TEST_ASSERT (word_index_has ("input_", last_word.get()));
+
+    /* edits update the index word by word */
+    doc = docs->elms[0];
+    buffer = moo_edit_get_buffer (doc);
+
+    gtk_text_buffer_get_start_iter (buffer, &iter);
+    gtk_text_buffer_insert (buffer, &iter, "uniqueword_abc ", -1);
+    TEST_ASSERT (word_index_has ("uniquew", "uniqueword_abc"));
+
+    gtk_text_buffer_get_iter_at_offset (buffer, &iter, 10);
+    gtk_text_buffer_get_iter_at_offset (buffer, &end, 14);
+    gtk_text_buffer_delete (buffer, &iter, &end);
+    TEST_ASSERT (word_index_has ("uniquew", "uniqueword"));
+    TEST_ASSERT (!word_index_has ("uniquew", "uniqueword_abc"));
+
+    gtk_text_buffer_get_iter_at_offset (buffer, &iter, 6);
+    gtk_text_buffer_insert (buffer, &iter, " ", -1);
+    TEST_ASSERT (!word_index_has ("uniquew", "uniqueword"));
+    TEST_ASSERT (word_index_has ("uniq", "unique"));
+
+    moo_edit_set_modified (doc, FALSE);
+    TEST_ASSERT (moo_editor_close_docs (editor, docs));
+
+    moo_edit_array_free (docs);
+}
+
+#define CONFIG_FILES 12
+
+static void
+config_wait (void)
+{
+    GTimer *timer = g_timer_new ();
+
+    while (g_main_context_pending (NULL) && g_timer_elapsed (timer, NULL) < 60)
+        g_main_context_iteration (NULL, FALSE);
+
+    g_timer_destroy (timer);
+}
+
+static guint
+config_tab_width (MooEditor  *editor,
+                  const char *name)
+{
+    gstr filename = g::build_filename (test_data.working_dir, name);
+    MooEdit *doc = moo_editor_get_doc (editor, filename.get());
+    g_return_val_if_fail (doc != NULL, 0);
+    return moo_edit_config_get_uint (doc->config, "tab-width");
+}
+
+static GSList *
+config_set_filters (const char *globs,
+                    const char *config)
+{
+    GSList *saved, *strings = NULL;
+
+    saved = _moo_edit_filter_settings_get_strings ();
+    strings = g_slist_append (strings, (gpointer) globs);
+    strings = g_slist_append (strings, (gpointer) config);
+    _moo_edit_filter_settings_set_strings (strings);
+    g_slist_free (strings);
+
+    return saved;
+}
+
+static void
+config_restore_filters (GSList *saved)
+{
+    _moo_edit_filter_settings_set_strings (saved);
+    g_slist_foreach (saved, (GFunc) g_free, NULL);
+    g_slist_free (saved);
+}
+
+/* per-file settings are applied only to the documents they change,
+ * and applying unchanged preferences does not touch documents */
+static void
+test_config (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooOpenInfoArray *files;
+    MooEdit *doc;
+    GSList *saved;
+    char *lang_id;
+    guint tab_width;
+
+    editor = moo_editor_instance ();
+
+    files = create_files ("config", CONFIG_FILES, TRUE);
+    TEST_ASSERT (moo_editor_open_files (editor, files, NULL, NULL));
+    moo_open_info_array_free (files);
+    window = moo_editor_get_active_window (editor);
+    config_wait ();
+
+    tab_width = config_tab_width (editor, "config0.txt");
+    TEST_ASSERT (tab_width != 3);
+
+    saved = config_set_filters ("globs:config1*.txt", "tab-width: 3");
+    config_wait ();
+
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config0.txt"), tab_width);
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config2.txt"), tab_width);
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config1.txt"), 3);
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config11.txt"), 3);
+
+    _moo_editor_apply_prefs (editor);
+    config_wait ();
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config11.txt"), 3);
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config0.txt"), tab_width);
+
+    config_restore_filters (saved);
+    config_wait ();
+    TEST_ASSERT_INT_EQ (config_tab_width (editor, "config11.txt"), tab_width);
+
+    if (window)
+        TEST_ASSERT (moo_editor_close_window (editor, window));
+
+    /* language detected from contents of a file without extension
+     * is not kept after the file is reloaded */
+    gstr filename = g::build_filename (test_data.working_dir, "config-script");
+    TEST_ASSERT (g_file_set_contents (filename.get(), "just words\n", -1, NULL));
+    doc = moo_editor_open_path (editor, filename.get(), NULL, -1, NULL);
+    TEST_ASSERT (doc != NULL);
+    if (!doc)
+        return;
+    config_wait ();
+
+    lang_id = moo_edit_get_lang_id (doc);
+    TEST_ASSERT (lang_id == NULL || strcmp (lang_id, "sh") != 0);
+    g_free (lang_id);
+
+    TEST_ASSERT (g_file_set_contents (filename.get(), "#!/bin/sh\necho words\n", -1, NULL));
+    TEST_ASSERT (moo_edit_reload (doc, NULL, NULL));
+    config_wait ();
+
+    lang_id = moo_edit_get_lang_id (doc);
+    TEST_ASSERT_STR_EQ (lang_id, "sh");
+    g_free (lang_id);
+
+    TEST_ASSERT (moo_edit_close (doc));
+}
+
+static void
+check_line_ws (MooTextBuffer *buffer,
+               int            line,
+               guint          n_trailing,
+               guint          n_chars,
+               ...)
+{
+    const BTLineWs *ws;
+    va_list args;
+    guint i;
+
+    ws = _moo_text_buffer_get_line_whitespace (buffer, line);
+    TEST_ASSERT (ws != NULL);
+    if (!ws)
+        return;
+
+    TEST_ASSERT_INT_EQ (ws->n_chars, n_chars);
+    TEST_ASSERT_INT_EQ (ws->n_trailing, n_trailing);
+
+    va_start (args, n_chars);
+    for (i = 0; i < n_chars && i < ws->n_chars; ++i)
+        TEST_ASSERT_INT_EQ (ws->chars[i], va_arg (args, int));
+    va_end (args);
+}
+
+#define WS_SPACE(i) ((i) << 1)
+#define WS_TAB(i) (((i) << 1) | 1)
+
+/* whitespace positions cached for drawing, and dropped when
+ * lines change */
+static void
+test_draw_whitespace (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooEdit *doc;
+    MooTextBuffer *buffer;
+    GtkTextIter iter, end;
+
+    editor = moo_editor_instance ();
+    window = moo_editor_new_window (editor);
+    doc = moo_edit_window_get_active_doc (window);
+    buffer = MOO_TEXT_BUFFER (moo_edit_get_buffer (doc));
+
+    gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), "\tif x  \n  y\n\303\251 b\nnone", -1);
+
+    check_line_ws (buffer, 0, 2, 4, WS_TAB (0), WS_SPACE (3), WS_SPACE (5), WS_SPACE (6));
+    check_line_ws (buffer, 1, 0, 2, WS_SPACE (0), WS_SPACE (1));
+    /* byte indices, not characters */
+    check_line_ws (buffer, 2, 0, 1, WS_SPACE (2));
+    check_line_ws (buffer, 3, 0, 0);
+
+    /* typing at the end of a line */
+    gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (buffer), &iter, 1);
+    gtk_text_iter_forward_to_line_end (&iter);
+    gtk_text_buffer_insert (GTK_TEXT_BUFFER (buffer), &iter, " ", -1);
+    check_line_ws (buffer, 1, 1, 3, WS_SPACE (0), WS_SPACE (1), WS_SPACE (3));
+    check_line_ws (buffer, 0, 2, 4, WS_TAB (0), WS_SPACE (3), WS_SPACE (5), WS_SPACE (6));
+
+    /* splitting a line */
+    gtk_text_buffer_get_iter_at_line_index (GTK_TEXT_BUFFER (buffer), &iter, 0, 4);
+    gtk_text_buffer_insert (GTK_TEXT_BUFFER (buffer), &iter, "\n", -1);
+    check_line_ws (buffer, 0, 1, 2, WS_TAB (0), WS_SPACE (3));
+    check_line_ws (buffer, 1, 2, 2, WS_SPACE (1), WS_SPACE (2));
+    check_line_ws (buffer, 2, 1, 3, WS_SPACE (0), WS_SPACE (1), WS_SPACE (3));
+
+    /* joining lines */
+    gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (buffer), &iter, 1);
+    gtk_text_iter_forward_to_line_end (&iter);
+    gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (buffer), &end, 2);
+    gtk_text_buffer_delete (GTK_TEXT_BUFFER (buffer), &iter, &end);
+    check_line_ws (buffer, 1, 1, 5, WS_SPACE (1), WS_SPACE (2), WS_SPACE (3), WS_SPACE (4), WS_SPACE (6));
+    check_line_ws (buffer, 2, 0, 1, WS_SPACE (2));
+
+    moo_edit_set_modified (doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+}
+
+/* opens a file in an unknown encoding, returns the encoding it was
+ * detected in */
+static gstr
+detect_encoding (const char *name)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooEdit *doc;
+    gstr encoding;
+
+    gstr filename = g::build_filename (test_data.working_dir, name);
+    TEST_ASSERT (g_file_set_contents (filename.get(), "caf\351" LE, -1, NULL));
+
+    doc = moo_editor_open_path (editor, filename.get(), NULL, -1, NULL);
+    TEST_ASSERT (doc != NULL);
+
+    if (doc)
+    {
+        encoding.copy (moo_edit_get_encoding (doc));
+        TEST_ASSERT (moo_edit_close (doc));
+    }
+
+    return encoding;
+}
+
+/* the list of encodings to try follows the pref */
+static void
+test_encodings_pref (void)
+{
+    const char *name = moo_edit_setting (MOO_EDIT_PREFS_ENCODINGS);
+    gstr saved (moo_prefs_get_string (name));
+
+    moo_prefs_set_string (name, "UTF-8,ISO-8859-1");
+    gstr encoding = detect_encoding ("encodings-pref-1");
+    TEST_ASSERT (!encoding.empty() && !g_ascii_strcasecmp (encoding.get(), "ISO-8859-1"));
+
+    moo_prefs_set_string (name, "UTF-8,KOI8-R");
+    encoding = detect_encoding ("encodings-pref-2");
+    TEST_ASSERT (!encoding.empty() && !g_ascii_strcasecmp (encoding.get(), "KOI8-R"));
+
+    moo_prefs_set_string (name, saved.get());
+}
+
+static void
+export_pdf (MooEdit    *doc,
+            const gstr& filename)
+{
+    char *contents = NULL;
+    mgw_errno_t err;
+
+    mgw_unlink (filename.get(), &err);
+    _moo_edit_export_pdf (GTK_TEXT_VIEW (moo_edit_get_view (doc)), filename.get());
+
+    if (!g_file_get_contents (filename.get(), &contents, NULL, NULL))
+        TEST_FAILED_MSG ("could not load file '%s'", filename.get());
+    else
+        TEST_ASSERT (g_str_has_prefix (contents, "%PDF"));
+
+    g_free (contents);
+}
+
+/* the second and later exports use line heights cached on the buffer */
+static void
+test_print (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooEditWindow *window = moo_editor_new_window (editor);
+    MooEdit *doc = moo_editor_new_doc (editor, window);
+    GtkTextBuffer *buffer = moo_edit_get_buffer (doc);
+    gstr filename = g::build_filename (test_data.working_dir, "print.pdf");
+    GtkTextIter iter, end;
+    GString *text;
+    GSList *schemes, *l;
+    guint i;
+
+    text = g_string_new (NULL);
+    for (i = 0; i < 500; ++i)
+        g_string_append_printf (text, "line %u%s" LE, i, i % 10 == 0 ?
+                                " with a long tail which is wrapped when it is printed, maybe" : "");
+    gtk_text_buffer_set_text (buffer, text->str, -1);
+    g_string_free (text, TRUE);
+
+    export_pdf (doc, filename);
+    export_pdf (doc, filename);
+
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, 100);
+    gtk_text_buffer_insert (buffer, &iter, "inserted" LE "lines" LE, -1);
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, 300);
+    end = iter;
+    gtk_text_iter_forward_lines (&end, 5);
+    gtk_text_buffer_delete (buffer, &iter, &end);
+    export_pdf (doc, filename);
+
+    schemes = moo_lang_mgr_list_schemes (moo_lang_mgr_default ());
+    for (l = schemes; l != NULL; l = l->next)
+    {
+        moo_text_view_set_style_scheme (MOO_TEXT_VIEW (moo_edit_get_view (doc)),
+                                        MOO_TEXT_STYLE_SCHEME (l->data));
+        export_pdf (doc, filename);
+    }
+    g_slist_foreach (schemes, (GFunc) g_object_unref, NULL);
+    g_slist_free (schemes);
+
+    moo_edit_set_modified (doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+}
+
 static void
 test_types (void)
 {
@@ -212,6 +1386,531 @@ test_types (void)
     TEST_ASSERT (g_type_is_a (MOO_TYPE_TEXT_CURSOR, G_TYPE_ENUM));
 }
 
+// benchmarks, medit --bench [--bench-filter "Editor/*"]
+
+#define BENCH_LOAD_LINES 100000
+#define BENCH_SEARCH_LINES 100000
+#define BENCH_TABS 1000
+#define BENCH_PRINT_LINES 20000
+#define BENCH_OPEN_FILES 500
+#define BENCH_NEW_WINDOWS 20
+#define BENCH_RELOAD_LINES 100000
+#define BENCH_WS_REDRAWS 20
+#define BENCH_SHIFT_LINES 100000
+#define BENCH_WORD_INDEX_FILES 20
+#define BENCH_WORD_INDEX_LINES 50000
+#define BENCH_WORD_INDEX_QUERIES 1000
+#define BENCH_CONFIG_FILES 500
+/* size of the file in megabytes, override with MOO_TEST_LARGE_FILE_SIZE
+ * to check multi-gigabyte files */
+#define BENCH_LARGE_FILE_SIZE 40
+#define BENCH_LARGE_FILE_SCROLLS 50
+
+static struct {
+    MooEditWindow *window;
+    MooEdit *doc;
+    GFile *file;
+    GtkWidget *view;
+    MooIndenter *indenter;
+    MooOpenInfoArray *files;
+    MooEditArray *docs;
+    char *texts[2];
+    guint n_runs;
+} bench_data;
+
+/* every hundredth line has a needle */
+static char *
+bench_text (guint n_lines)
+{
+    GString *text = g_string_new (NULL);
+    guint i;
+
+    for (i = 0; i < n_lines; ++i)
+        g_string_append_printf (text, "    line %u: the quick brown fox jumps over the lazy dog;%s" LE,
+                                i, i % 100 == 0 ? " needle" : "");
+
+    return g_string_free (text, FALSE);
+}
+
+static void
+bench_doc_setup (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    bench_data.window = moo_editor_new_window (editor);
+    bench_data.doc = moo_editor_new_doc (editor, bench_data.window);
+}
+
+static void
+bench_doc_cleanup (void)
+{
+    moo_edit_set_modified (bench_data.doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (moo_editor_instance (), bench_data.window));
+    bench_data.window = NULL;
+    bench_data.doc = NULL;
+}
+
+static void
+bench_window_setup (void)
+{
+    bench_data.window = moo_editor_new_window (moo_editor_instance ());
+}
+
+static void
+bench_window_cleanup (void)
+{
+    TEST_ASSERT (moo_editor_close_window (moo_editor_instance (), bench_data.window));
+    bench_data.window = NULL;
+}
+
+static void
+bench_open_files_setup (void)
+{
+    bench_data.files = create_files ("bench", BENCH_OPEN_FILES, TRUE);
+}
+
+static void
+bench_open_files_cleanup (void)
+{
+    moo_open_info_array_free (bench_data.files);
+    bench_data.files = NULL;
+}
+
+/* files from a running instance, into a new window */
+static void
+bench_open_files (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooEditWindow *window;
+
+    TEST_ASSERT (moo_editor_open_files (editor, bench_data.files, NULL, NULL));
+    window = moo_editor_get_active_window (editor);
+    TEST_ASSERT (window && moo_edit_window_get_n_tabs (window) == BENCH_OPEN_FILES);
+    if (window)
+        TEST_ASSERT (moo_editor_close_window (editor, window));
+}
+
+/* the first window pays for loading stuff which is shared
+ * between windows, it's done in the warmup runs */
+static void
+bench_new_window (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooEditWindow *windows[BENCH_NEW_WINDOWS];
+    int i;
+
+    for (i = 0; i < BENCH_NEW_WINDOWS; ++i)
+        windows[i] = moo_editor_new_window (editor);
+    for (i = 0; i < BENCH_NEW_WINDOWS; ++i)
+        TEST_ASSERT (moo_editor_close_window (editor, windows[i]));
+}
+
+static void
+bench_shift_lines_setup (void)
+{
+    char *text;
+
+    bench_window_setup ();
+    bench_data.doc = moo_edit_window_get_active_doc (bench_data.window);
+    bench_data.indenter = moo_indenter_new (bench_data.doc);
+
+    moo_edit_config_set (bench_data.doc->config, MOO_EDIT_CONFIG_SOURCE_USER,
+                         "indent-use-tabs", TRUE, "indent-width", 8u, "tab-width", 8u,
+                         (char*) NULL);
+
+    text = shift_lines_text (BENCH_SHIFT_LINES, "\tfoo ();\n", "    bar ();\n");
+    gtk_text_buffer_set_text (moo_edit_get_buffer (bench_data.doc), text, -1);
+    g_free (text);
+}
+
+static void
+bench_shift_lines_cleanup (void)
+{
+    g_object_unref (bench_data.indenter);
+    bench_data.indenter = NULL;
+    moo_edit_set_modified (bench_data.doc, FALSE);
+    bench_data.doc = NULL;
+    bench_window_cleanup ();
+}
+
+/* indents and unindents the whole document, each as one user action */
+static void
+bench_shift_lines (void)
+{
+    GtkTextBuffer *buffer = moo_edit_get_buffer (bench_data.doc);
+
+    gtk_text_buffer_begin_user_action (buffer);
+    moo_indenter_shift_lines (bench_data.indenter, buffer, 0, BENCH_SHIFT_LINES - 1, 1);
+    gtk_text_buffer_end_user_action (buffer);
+
+    gtk_text_buffer_begin_user_action (buffer);
+    moo_indenter_shift_lines (bench_data.indenter, buffer, 0, BENCH_SHIFT_LINES - 1, -1);
+    gtk_text_buffer_end_user_action (buffer);
+}
+
+/* the number of files can be changed with MOO_TEST_WORD_INDEX_FILES */
+static void
+bench_word_index_setup (void)
+{
+    guint n_files = BENCH_WORD_INDEX_FILES;
+    const char *env;
+
+    if ((env = g_getenv ("MOO_TEST_WORD_INDEX_FILES")))
+    {
+        mgw_errno_t err;
+        guint64 value = mgw_ascii_strtoull (env, NULL, 10, &err);
+        if (!mgw_errno_is_set (err) && value > 0)
+            n_files = (guint) value;
+    }
+
+    write_word_files (n_files, BENCH_WORD_INDEX_LINES);
+    bench_data.n_runs = n_files;
+}
+
+/* opens all files and waits until they are indexed */
+static void
+bench_word_index (void)
+{
+    bench_data.docs = open_word_files (bench_data.n_runs);
+    TEST_ASSERT (word_index_wait ());
+    TEST_ASSERT (moo_editor_close_docs (moo_editor_instance (), bench_data.docs));
+    moo_edit_array_free (bench_data.docs);
+    bench_data.docs = NULL;
+}
+
+static void
+bench_word_query_setup (void)
+{
+    bench_word_index_setup ();
+    bench_data.docs = open_word_files (bench_data.n_runs);
+    TEST_ASSERT (word_index_wait ());
+}
+
+static void
+bench_word_query_cleanup (void)
+{
+    TEST_ASSERT (moo_editor_close_docs (moo_editor_instance (), bench_data.docs));
+    moo_edit_array_free (bench_data.docs);
+    bench_data.docs = NULL;
+}
+
+static void
+bench_word_query (void)
+{
+    int i;
+
+    for (i = 0; i < BENCH_WORD_INDEX_QUERIES; ++i)
+        g_strfreev (_moo_word_index_complete ("result_1", 20));
+    for (i = 0; i < BENCH_WORD_INDEX_QUERIES; ++i)
+        g_strfreev (_moo_word_index_match ("rslt12", 20));
+}
+
+static void
+bench_config_setup (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooOpenInfoArray *files = create_files ("bench-config", BENCH_CONFIG_FILES, TRUE);
+    TEST_ASSERT (moo_editor_open_files (editor, files, NULL, NULL));
+    moo_open_info_array_free (files);
+    bench_data.window = moo_editor_get_active_window (editor);
+    config_wait ();
+}
+
+/* per-file settings which change a tenth of the documents, unchanged
+ * preferences, and restoring the settings */
+static void
+bench_config (void)
+{
+    GSList *saved = config_set_filters ("globs:bench-config1*.txt", "tab-width: 3");
+    config_wait ();
+    _moo_editor_apply_prefs (moo_editor_instance ());
+    config_wait ();
+    config_restore_filters (saved);
+    config_wait ();
+}
+
+/* indented code and a long minified line, with all whitespace drawn */
+static void
+bench_draw_whitespace_setup (void)
+{
+    GString *text;
+    guint i;
+
+    bench_window_setup ();
+    bench_data.doc = moo_edit_window_get_active_doc (bench_data.window);
+
+    text = g_string_new (NULL);
+    for (i = 0; i < 1000; ++i)
+        g_string_append (text, "\t\tif (x) {\t  \n\t\t    y = z;   \n");
+    for (i = 0; i < 10000; ++i)
+        g_string_append (text, "{\"key\": [1, 2, 3], ");
+    gtk_text_buffer_set_text (moo_edit_get_buffer (bench_data.doc), text->str, -1);
+    moo_edit_set_modified (bench_data.doc, FALSE);
+    g_string_free (text, TRUE);
+
+    bench_data.view = GTK_WIDGET (moo_edit_get_view (bench_data.doc));
+    g_object_set (bench_data.view, "draw-whitespace",
+                  MOO_DRAW_WS_SPACES | MOO_DRAW_WS_TABS | MOO_DRAW_WS_TRAILING,
+                  (char*) NULL);
+
+    if (GTK_WIDGET_DRAWABLE (bench_data.view))
+    {
+        moo_text_view_move_cursor (MOO_TEXT_VIEW (bench_data.view), 1990, 0, FALSE, FALSE);
+        gdk_window_process_all_updates ();
+    }
+}
+
+static void
+bench_draw_whitespace_cleanup (void)
+{
+    bench_data.view = NULL;
+    bench_data.doc = NULL;
+    bench_window_cleanup ();
+}
+
+/* needs a display, does nothing without one */
+static void
+bench_draw_whitespace (void)
+{
+    GdkWindow *text_window;
+    int i;
+
+    if (!GTK_WIDGET_DRAWABLE (bench_data.view))
+        return;
+
+    text_window = gtk_text_view_get_window (GTK_TEXT_VIEW (bench_data.view), GTK_TEXT_WINDOW_TEXT);
+
+    for (i = 0; i < BENCH_WS_REDRAWS; ++i)
+    {
+        gdk_window_invalidate_rect (text_window, NULL, FALSE);
+        gdk_window_process_updates (text_window, FALSE);
+    }
+}
+
+static void
+bench_many_tabs (void)
+{
+    MooEditArray *docs = open_tabs (bench_data.window, BENCH_TABS);
+    TEST_ASSERT (moo_editor_close_docs (moo_editor_instance (), docs));
+    moo_edit_array_free (docs);
+}
+
+static void
+bench_print_setup (void)
+{
+    char *text = bench_text (BENCH_PRINT_LINES);
+    bench_doc_setup ();
+    gtk_text_buffer_set_text (moo_edit_get_buffer (bench_data.doc), text, -1);
+    g_free (text);
+}
+
+/* warmup runs fill the line height cache, this measures pagination
+ * with cached heights and rendering */
+static void
+bench_print (void)
+{
+    gstr filename = g::build_filename (test_data.working_dir, "bench-print.pdf");
+    _moo_edit_export_pdf (GTK_TEXT_VIEW (moo_edit_get_view (bench_data.doc)), filename.get());
+}
+
+static void
+bench_load_setup (void)
+{
+    gstr filename = g::build_filename (test_data.working_dir, "bench-load.txt");
+    char *text = bench_text (BENCH_LOAD_LINES);
+    TEST_ASSERT (g_file_set_contents (filename.get(), text, -1, NULL));
+    g_free (text);
+
+    bench_data.file = g_file_new_for_path (filename.get());
+    bench_doc_setup ();
+}
+
+static void
+bench_load_cleanup (void)
+{
+    bench_doc_cleanup ();
+    g_object_unref (bench_data.file);
+    bench_data.file = NULL;
+}
+
+static void
+bench_load_file (void)
+{
+    GError *error = NULL;
+    TEST_ASSERT (_moo_edit_load_file (bench_data.doc, bench_data.file, NULL, NULL, &error));
+    if (error)
+        g_error_free (error);
+}
+
+static void
+write_large_file (const char *filename,
+                  guint64     size)
+{
+    MooFileWriter *writer;
+    GString *chunk;
+    guint64 written = 0;
+    guint line = 0;
+
+    writer = moo_file_writer_new (filename, (MooFileWriterFlags) 0, NULL);
+    TEST_ASSERT (writer != NULL);
+    if (!writer)
+        return;
+
+    chunk = g_string_new (NULL);
+
+    while (written < size)
+    {
+        g_string_truncate (chunk, 0);
+        while (chunk->len < 1024 * 1024)
+            g_string_append_printf (chunk, "%09u: the quick brown fox jumps over the lazy dog\n", line++);
+        moo_file_writer_write (writer, chunk->str, chunk->len);
+        written += chunk->len;
+    }
+
+    TEST_ASSERT (moo_file_writer_close (writer, NULL));
+    g_string_free (chunk, TRUE);
+}
+
+static void
+bench_large_file_setup (void)
+{
+    guint64 size = BENCH_LARGE_FILE_SIZE;
+    const char *env;
+
+    if ((env = g_getenv ("MOO_TEST_LARGE_FILE_SIZE")))
+    {
+        mgw_errno_t err;
+        guint64 value = mgw_ascii_strtoull (env, NULL, 10, &err);
+        if (!mgw_errno_is_set (err) && value > 0)
+            size = value;
+    }
+
+    gstr filename = g::build_filename (test_data.working_dir, "bench-large.txt");
+    write_large_file (filename.get(), size * 1024 * 1024);
+    bench_data.file = g_file_new_for_path (filename.get());
+}
+
+static void
+bench_large_file_cleanup (void)
+{
+    g_file_delete (bench_data.file, NULL, NULL);
+    g_object_unref (bench_data.file);
+    bench_data.file = NULL;
+}
+
+/* opens the file, scrolls through it when there is a display, and closes it */
+static void
+bench_large_file (void)
+{
+    MooEdit *doc;
+    MooEditView *view;
+    char *path;
+    int n_lines;
+    int i;
+
+    path = g_file_get_path (bench_data.file);
+    doc = moo_editor_open_path (moo_editor_instance (), path, NULL, -1, NULL);
+    g_free (path);
+    TEST_ASSERT (doc != NULL);
+    if (!doc)
+        return;
+
+    view = moo_edit_get_view (doc);
+    n_lines = gtk_text_buffer_get_line_count (moo_edit_get_buffer (doc));
+
+    if (GTK_WIDGET_DRAWABLE (view))
+    {
+        gdk_window_process_all_updates ();
+
+        for (i = 0; i < BENCH_LARGE_FILE_SCROLLS; ++i)
+        {
+            moo_text_view_move_cursor (MOO_TEXT_VIEW (view),
+                                       (int) ((gint64) n_lines * i / BENCH_LARGE_FILE_SCROLLS),
+                                       0, FALSE, FALSE);
+            gdk_window_process_all_updates ();
+        }
+    }
+
+    TEST_ASSERT (moo_edit_close (doc));
+}
+
+/* the file alternates between two versions which differ in a few
+ * lines, each run reloads the document in place */
+static void
+bench_reload_setup (void)
+{
+    GString *text;
+    GError *error = NULL;
+
+    bench_data.texts[0] = bench_text (BENCH_RELOAD_LINES);
+    text = g_string_new (bench_data.texts[0]);
+    g_string_prepend (text, "inserted" LE);
+    g_string_insert (text, text->len / 2, "changed");
+    g_string_append (text, "appended" LE);
+    bench_data.texts[1] = g_string_free (text, FALSE);
+    bench_data.n_runs = 0;
+
+    gstr filename = g::build_filename (test_data.working_dir, "bench-reload.txt");
+    TEST_ASSERT (g_file_set_contents (filename.get(), bench_data.texts[0], -1, NULL));
+    bench_data.file = g_file_new_for_path (filename.get());
+
+    bench_doc_setup ();
+    TEST_ASSERT (_moo_edit_load_file (bench_data.doc, bench_data.file, NULL, NULL, &error));
+    if (error)
+        g_error_free (error);
+}
+
+static void
+bench_reload_cleanup (void)
+{
+    bench_load_cleanup ();
+    g_free (bench_data.texts[0]);
+    g_free (bench_data.texts[1]);
+    bench_data.texts[0] = bench_data.texts[1] = NULL;
+}
+
+static void
+bench_reload (void)
+{
+    GError *error = NULL;
+    char *path = g_file_get_path (bench_data.file);
+
+    bench_data.n_runs += 1;
+    TEST_ASSERT (g_file_set_contents (path, bench_data.texts[bench_data.n_runs % 2], -1, NULL));
+    TEST_ASSERT (_moo_edit_reload_file (bench_data.doc, NULL, &error));
+    if (error)
+        g_error_free (error);
+
+    g_free (path);
+}
+
+static void
+bench_search_setup (void)
+{
+    char *text = bench_text (BENCH_SEARCH_LINES);
+    bench_doc_setup ();
+    gtk_text_buffer_set_text (moo_edit_get_buffer (bench_data.doc), text, -1);
+    g_free (text);
+}
+
+static void
+bench_search (void)
+{
+    GtkTextBuffer *buffer = moo_edit_get_buffer (bench_data.doc);
+    GtkTextIter iter, match_start, match_end;
+    guint count = 0;
+
+    gtk_text_buffer_get_start_iter (buffer, &iter);
+
+    while (moo_text_search_forward (&iter, "needle", MooTextSearchFlags (0),
+                                    &match_start, &match_end, NULL))
+    {
+        count += 1;
+        iter = match_end;
+    }
+
+    TEST_ASSERT_INT_EQ (count, BENCH_SEARCH_LINES / 100);
+}
+
 static gboolean
 test_suite_init (G_GNUC_UNUSED gpointer data)
 {
@@ -279,5 +1978,56 @@ moo_test_editor (void)
                                               NULL);
     moo_test_suite_add_test (suite, "basic", "basic editor functionality", (MooTestFunc) test_basic, NULL);
     moo_test_suite_add_test (suite, "encodings", "character encoding handling", (MooTestFunc) test_encodings, NULL);
+    moo_test_suite_add_test (suite, "lazy-session", "lazy loading of session documents", (MooTestFunc) test_lazy_session, NULL);
+    moo_test_suite_add_test (suite, "open-files", "opening files in batches", (MooTestFunc) test_open_files, NULL);
+    moo_test_suite_add_test (suite, "many-tabs", "opening and closing tabs in a batch", (MooTestFunc) test_many_tabs, NULL);
+    moo_test_suite_add_test (suite, "new-window", "creating editor windows", (MooTestFunc) test_new_window, NULL);
+    moo_test_suite_add_test (suite, "reload", "reloading changed files in place", (MooTestFunc) test_reload, NULL);
+    moo_test_suite_add_test (suite, "large-file", "large file mode and its undo limit", (MooTestFunc) test_large_file, NULL);
+    moo_test_suite_add_test (suite, "shift-lines", "indenting and unindenting a block", (MooTestFunc) test_shift_lines, NULL);
+    moo_test_suite_add_test (suite, "word-index", "word completion index of open documents", (MooTestFunc) test_word_index, NULL);
+    moo_test_suite_add_test (suite, "config", "applying settings to documents", (MooTestFunc) test_config, NULL);
+    moo_test_suite_add_test (suite, "draw-whitespace", "whitespace positions for drawing", (MooTestFunc) test_draw_whitespace, NULL);
+    moo_test_suite_add_test (suite, "encodings-pref", "encodings tried when opening files", (MooTestFunc) test_encodings_pref, NULL);
+    moo_test_suite_add_test (suite, "print", "exporting documents to PDF", (MooTestFunc) test_print, NULL);
     moo_test_suite_add_test (suite, "types", "sanity checks for GObject types", (MooTestFunc) test_types, NULL);
+
+    moo_test_suite_add_bench (suite, "load-file", "loading a large file",
+                              (MooTestFunc) bench_load_file, (MooTestFunc) bench_load_setup,
+                              (MooTestFunc) bench_load_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "reload", "reloading a large document changed in a few places",
+                              (MooTestFunc) bench_reload, (MooTestFunc) bench_reload_setup,
+                              (MooTestFunc) bench_reload_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "large-file", "opening and scrolling a large file",
+                              (MooTestFunc) bench_large_file, (MooTestFunc) bench_large_file_setup,
+                              (MooTestFunc) bench_large_file_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "search", "searching a large document",
+                              (MooTestFunc) bench_search, (MooTestFunc) bench_search_setup,
+                              (MooTestFunc) bench_doc_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "print", "exporting a long document to PDF",
+                              (MooTestFunc) bench_print, (MooTestFunc) bench_print_setup,
+                              (MooTestFunc) bench_doc_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "open-files", "opening and closing five hundred files in a new window",
+                              (MooTestFunc) bench_open_files, (MooTestFunc) bench_open_files_setup,
+                              (MooTestFunc) bench_open_files_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "new-window", "creating and closing twenty editor windows",
+                              (MooTestFunc) bench_new_window, NULL, NULL, NULL);
+    moo_test_suite_add_bench (suite, "shift-lines", "indenting and unindenting a hundred thousand lines",
+                              (MooTestFunc) bench_shift_lines, (MooTestFunc) bench_shift_lines_setup,
+                              (MooTestFunc) bench_shift_lines_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "word-index", "indexing words of twenty large documents",
+                              (MooTestFunc) bench_word_index, (MooTestFunc) bench_word_index_setup,
+                              NULL, NULL);
+    moo_test_suite_add_bench (suite, "word-query", "completion queries over twenty large documents",
+                              (MooTestFunc) bench_word_query, (MooTestFunc) bench_word_query_setup,
+                              (MooTestFunc) bench_word_query_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "config", "applying settings to five hundred documents",
+                              (MooTestFunc) bench_config, (MooTestFunc) bench_config_setup,
+                              (MooTestFunc) bench_window_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "draw-whitespace", "drawing whitespace in long lines",
+                              (MooTestFunc) bench_draw_whitespace, (MooTestFunc) bench_draw_whitespace_setup,
+                              (MooTestFunc) bench_draw_whitespace_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "many-tabs", "opening and closing a thousand tabs",
+                              (MooTestFunc) bench_many_tabs, (MooTestFunc) bench_window_setup,
+                              (MooTestFunc) bench_window_cleanup, NULL);
 }
@@ -88,6 +88,7 @@ static MooEditArray *find_modified              (MooEditArray   *docs);
 
 static void          add_new_window_action      (void);
 static void          remove_new_window_action   (void);
+static void          langs_loaded               (MooEditor      *editor);
 
 static GObject      *moo_editor_constructor     (GType           type,
                                                  guint           n_props,
@@ -368,7 +369,7 @@ moo_editor_constructor (GType                  type,
 
     editor->priv->lang_mgr = g::object_ref (moo_lang_mgr_default ());
     g_signal_connect_swapped (editor->priv->lang_mgr, "loaded",
-                              G_CALLBACK (_moo_editor_apply_prefs),
+                              G_CALLBACK (langs_loaded),
                               editor);
 
     editor->priv->history = NULL;
@@ -1010,8 +1011,11 @@ update_history_item_for_doc (MooEditor *editor,
     item = moo_history_item_new (uri.get(), NULL);
 
     view = moo_edit_get_view (doc);
-    line = moo_text_view_get_cursor_line (GTK_TEXT_VIEW (view));
-    if (line != 0)
+    if (_moo_edit_is_load_pending (doc))
+        line = _moo_edit_get_pending_line (doc);
+    else
+        line = moo_text_view_get_cursor_line (GTK_TEXT_VIEW (view));
+    if (line > 0)
         _moo_edit_history_item_set_line (item, line);
 
     enc = moo_edit_get_encoding (doc);
@@ -1085,6 +1089,9 @@ moo_editor_load_file (MooEditor       *editor,
         doc = MOO_EDIT (g_object_new (get_doc_type (editor), "editor", editor, (const char*) NULL));
     }
 
+    if (success && !new_doc && !(info->flags & MOO_OPEN_FLAG_RELOAD))
+        _moo_edit_ensure_loaded (doc);
+
     if (success)
     {
         view = moo_edit_get_view (doc);
@@ -1296,6 +1303,8 @@ _moo_editor_open_files (MooEditor         *editor,
     MooEdit *bring_to_front = NULL;
     gboolean result = TRUE;
     MooEditWindow *window = NULL;
+    MooEditWindow *batch_window = NULL;
+    gboolean batch_frozen = FALSE;
     MooEditArray *docs;
 
     moo_return_error_if_fail_p (MOO_IS_EDITOR (editor));
@@ -1311,37 +1320,82 @@ _moo_editor_open_files (MooEditor         *editor,
 
     docs = moo_edit_array_new ();
 
+    if (!window)
+        window = moo_editor_get_active_window (editor);
+    if (window)
+        batch_window = (MooEditWindow*) g_object_ref (window);
+    if (batch_window && files->n_elms > 1)
+    {
+        _moo_edit_window_begin_update (batch_window);
+        batch_frozen = TRUE;
+    }
+
     for (i = 0; i < files->n_elms; ++i)
     {
         MooOpenInfo *info = files->elms[i];
         MooEdit *doc = NULL;
+        GError *error_here = NULL;
 
         if (!window)
             window = moo_editor_get_active_window (editor);
 
         doc = moo_editor_load_file (editor, info, window, parent,
-                                    is_embedded (editor), TRUE, error);
+                                    is_embedded (editor), TRUE, &error_here);
 
         if (doc)
         {
+            MooEditWindow *doc_window = moo_edit_get_window (doc);
+
             parent = GTK_WIDGET (moo_edit_get_view (doc));
             bring_to_front = doc;
             moo_edit_array_append (docs, doc);
+
+            /* files following one opened in a new window go into that
+             * window, keep it frozen until the batch is done */
+            if (doc_window && doc_window != batch_window &&
+                (!batch_window || (info->flags & MOO_OPEN_FLAG_NEW_WINDOW)))
+            {
+                if (batch_window)
+                {
+                    if (batch_frozen)
+                        _moo_edit_window_end_update (batch_window);
+                    g_object_unref (batch_window);
+                }
+
+                window = doc_window;
+                batch_window = (MooEditWindow*) g_object_ref (window);
+                batch_frozen = i + 1 < files->n_elms;
+
+                if (batch_frozen)
+                    _moo_edit_window_begin_update (batch_window);
+            }
         }
         else
         {
+            /* the rest of the files are still opened, error is about
+             * the first one which failed */
+            if (result && error_here)
+                g_propagate_error (error, error_here);
+            else if (error_here)
+                g_error_free (error_here);
             result = FALSE;
-            break;
         }
     }
 
+    if (batch_window)
+    {
+        if (batch_frozen)
+            _moo_edit_window_end_update (batch_window);
+        g_object_unref (batch_window);
+    }
+
     if (bring_to_front)
     {
         moo_editor_set_active_doc (editor, bring_to_front);
         gtk_widget_grab_focus (GTK_WIDGET (moo_edit_get_view (bring_to_front)));
     }
 
-    if (!result)
+    if (moo_edit_array_is_empty (docs))
     {
         moo_edit_array_free (docs);
         docs = NULL;
@@ -1775,8 +1829,26 @@ close_docs_real (MooEditor    *editor,
     if (do_close)
     {
         guint i;
+        MooEditWindowArray *windows = moo_edit_window_array_new ();
+
+        for (i = 0; i < docs->n_elms; ++i)
+        {
+            MooEditWindow *window = moo_edit_get_window (docs->elms[i]);
+
+            if (window && moo_edit_window_array_find (windows, window) < 0)
+            {
+                moo_edit_window_array_append (windows, window);
+                _moo_edit_window_begin_update (window);
+            }
+        }
+
         for (i = 0; i < docs->n_elms; ++i)
             do_close_doc (editor, docs->elms[i]);
+
+        for (i = 0; i < windows->n_elms; ++i)
+            _moo_edit_window_end_update (windows->elms[i]);
+
+        moo_edit_window_array_free (windows);
     }
 
     moo_edit_array_free (modified);
@@ -1845,17 +1917,55 @@ filename_from_utf8 (const char *encoded)
     }
 }
 
+/* Creates a tab for a session document without reading the file; the
+ * text is loaded when the tab is shown, see _moo_edit_ensure_loaded() */
+static MooEdit *
+create_pending_doc (MooEditor     *editor,
+                    MooEditWindow *window,
+                    MooOpenInfo   *info)
+{
+    MooEdit *doc;
+    int line = info->line;
+    const char *recent_encoding = NULL;
+
+    if ((doc = moo_editor_get_doc_for_file (editor, info->file)))
+        return doc;
+
+    if (!g_file_is_native (info->file) || _moo_edit_file_is_new (info->file))
+        return NULL;
+
+    gstr uri = gstr::take (g_file_get_uri (info->file));
+    MooHistoryItem *hist_item = moo_history_mgr_find_uri (editor->priv->history, uri.get());
+
+    if (hist_item && line < 0)
+        line = _moo_edit_history_item_get_line (hist_item);
+    /* like in moo_editor_load_file(), the encoding used last time is
+     * only a hint, so that a file which changed since is not misread */
+    if (hist_item && !info->encoding)
+        recent_encoding = _moo_edit_history_item_get_encoding (hist_item);
+
+    doc = MOO_EDIT (g_object_new (get_doc_type (editor), "editor", editor, (const char*) NULL));
+    _moo_edit_set_load_pending (doc, info->file, info->encoding, recent_encoding, line);
+    _moo_edit_window_insert_doc (window, doc, NULL);
+    moo_editor_add_doc (editor, window, doc);
+    g_object_unref (doc);
+
+    return doc;
+}
+
 static MooEdit *
 load_doc_session (MooEditor     *editor,
                   MooEditWindow *window,
                   MooMarkupNode *elm,
-                  gboolean       file_is_uri)
+                  gboolean       file_is_uri,
+                  gboolean       lazy)
 {
     const char *uri = NULL;
     const char *encoding;
     char *freeme = NULL;
     MooEdit *doc = NULL;
     MooOpenInfo *info;
+    int line;
 
     if (file_is_uri)
     {
@@ -1880,50 +1990,148 @@ load_doc_session (MooEditor     *editor,
     }
 
     encoding = moo_markup_get_prop (elm, "encoding");
-    info = moo_open_info_new_uri (uri, encoding, -1, MOO_OPEN_FLAGS_NONE);
+    line = moo_markup_int_prop (elm, "line", -1);
+    info = moo_open_info_new_uri (uri, encoding, line, MOO_OPEN_FLAGS_NONE);
 
-    doc = moo_editor_load_file (editor, info, window, GTK_WIDGET (window), TRUE, FALSE, NULL);
+    if (lazy && !moo_markup_bool_prop (elm, "active", FALSE))
+        doc = create_pending_doc (editor, window, info);
+    else
+        doc = moo_editor_load_file (editor, info, window, GTK_WIDGET (window), TRUE, FALSE, NULL);
 
     g_object_unref (info);
     g_free (freeme);
     return doc;
 }
 
-static MooMarkupNode *
-save_doc_session (MooEdit       *doc,
-                  MooMarkupNode *elm)
+/* Session element of a document as of the last snapshot. It is built
+ * again only when the document changes, so saving a big session costs
+ * little more than copying these strings. */
+struct DocSessionCache
+{
+    char *xml;
+    char *encoding;
+    int line;
+    bool active;
+};
+
+#define DOC_SESSION_CACHE_KEY "moo-session-cache"
+
+static void
+doc_session_cache_free (DocSessionCache *cache)
+{
+    g_free (cache->xml);
+    g_free (cache->encoding);
+    g_slice_free (DocSessionCache, cache);
+}
+
+static void
+doc_session_cache_clear (DocSessionCache *cache)
 {
+    g_free (cache->xml);
+    cache->xml = NULL;
+}
+
+static DocSessionCache *
+get_doc_session_cache (MooEdit *doc)
+{
+    DocSessionCache *cache;
+
+    cache = (DocSessionCache*) g_object_get_data (G_OBJECT (doc), DOC_SESSION_CACHE_KEY);
+
+    if (!cache)
+    {
+        cache = g_slice_new0 (DocSessionCache);
+        g_object_set_data_full (G_OBJECT (doc), DOC_SESSION_CACHE_KEY, cache,
+                                (GDestroyNotify) doc_session_cache_free);
+        g_signal_connect_swapped (doc, "filename-changed",
+                                  G_CALLBACK (doc_session_cache_clear), cache);
+    }
+
+    return cache;
+}
+
+static void
+append_escaped (GString    *out,
+                const char *text)
+{
+    gstr escaped = gstr::take (g_markup_escape_text (text, -1));
+    g_string_append (out, escaped.get());
+}
+
+static void
+save_doc_session (MooEdit  *doc,
+                  gboolean  active,
+                  GString  *out)
+{
+    DocSessionCache *cache;
     const char *encoding;
-    MooMarkupNode *node;
+    GString *xml;
+    int line;
 
-    gstr uri = gstr::take (moo_edit_get_uri (doc));
+    cache = get_doc_session_cache (doc);
     encoding = moo_edit_get_encoding (doc);
 
-    if (!uri.empty())
+    if (_moo_edit_is_load_pending (doc))
+        line = _moo_edit_get_pending_line (doc);
+    else
+        line = moo_text_view_get_cursor_line (GTK_TEXT_VIEW (moo_edit_get_view (doc)));
+
+    if (cache->xml && cache->line == line && cache->active == (active != FALSE) &&
+        moo_str_equal (cache->encoding, encoding))
+    {
+        g_string_append (out, cache->xml);
+        return;
+    }
+
+    gstr uri = gstr::take (moo_edit_get_uri (doc));
+    xml = g_string_new ("<document");
+
+    if (!uri.empty() && encoding && encoding[0])
     {
-        node = moo_markup_create_text_element (elm, "document", uri.get());
+        g_string_append (xml, " encoding=\"");
+        append_escaped (xml, encoding);
+        g_string_append_c (xml, '"');
+    }
+
+    if (!uri.empty() && line > 0)
+        g_string_append_printf (xml, " line=\"%d\"", line);
 
-        if (encoding && encoding[0])
-            moo_markup_set_prop (node, "encoding", encoding);
+    if (active)
+        g_string_append (xml, " active=\"true\"");
+
+    if (!uri.empty())
+    {
+        g_string_append_c (xml, '>');
+        append_escaped (xml, uri.get());
+        g_string_append (xml, "</document>\n");
     }
     else
     {
-        node = moo_markup_create_element (elm, "document");
+        g_string_append (xml, "/>\n");
     }
 
-    return node;
+    g_string_append_len (out, xml->str, xml->len);
+
+    g_free (cache->xml);
+    g_free (cache->encoding);
+    cache->xml = g_string_free (xml, FALSE);
+    cache->encoding = g_strdup (encoding);
+    cache->line = line;
+    cache->active = active != FALSE;
 }
 
 static MooEditWindow *
 load_window_session (MooEditor     *editor,
                      MooMarkupNode *elm,
-                     gboolean       file_is_uri)
+                     gboolean       file_is_uri,
+                     gboolean       lazy)
 {
     MooEditWindow *window;
     MooEdit *active_doc = NULL;
     MooMarkupNode *node;
 
     window = create_window (editor);
+    _moo_edit_window_begin_update (window);
 
     for (node = elm->children; node != NULL; node = node->next)
     {
@@ -1931,7 +2139,7 @@ load_window_session (MooEditor     *editor,
         {
             MooEdit *doc;
 
-            doc = load_doc_session (editor, window, node, file_is_uri);
+            doc = load_doc_session (editor, window, node, file_is_uri, lazy);
 
             if (doc && moo_markup_bool_prop (node, "active", FALSE))
                 active_doc = doc;
@@ -1941,14 +2149,16 @@ load_window_session (MooEditor     *editor,
     if (active_doc)
         moo_edit_window_set_active_doc (window, active_doc);
 
+    _moo_edit_window_end_update (window);
+
     return window;
 }
 
-static MooMarkupNode *
+static void
 save_window_session (MooEditWindow *window,
-                     MooMarkupNode *elm)
+                     gboolean       active,
+                     GString       *out)
 {
-    MooMarkupNode *node;
     MooEdit *active_doc;
     MooEditArray *docs;
     guint i;
@@ -1956,21 +2166,14 @@ save_window_session (MooEditWindow *window,
     active_doc = moo_edit_window_get_active_doc (window);
     docs = moo_edit_window_get_docs (window);
 
-    node = moo_markup_create_element (elm, "window");
+    g_string_append (out, active ? "<window active=\"true\">\n" : "<window>\n");
 
     for (i = 0; i < docs->n_elms; ++i)
-    {
-        MooMarkupNode *doc_node;
-        MooEdit *doc = docs->elms[i];
-
-        doc_node = save_doc_session (doc, node);
+        save_doc_session (docs->elms[i], docs->elms[i] == active_doc, out);
 
-        if (doc_node && doc == active_doc)
-            moo_markup_set_bool_prop (doc_node, "active", TRUE);
-    }
+    g_string_append (out, "</window>\n");
 
     moo_edit_array_free (docs);
-    return node;
 }
 
 void
@@ -1998,6 +2201,11 @@ _moo_editor_load_session (MooEditor     *editor,
     {
         MooEditWindow *active_window = NULL;
         MooMarkupNode *node;
+        gboolean lazy;
+        guint i;
+
+        lazy = moo_prefs_get_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION));
+        editor->priv->loading_session = TRUE;
 
         for (node = editor_node->children; node != NULL; node = node->next)
         {
@@ -2006,45 +2214,51 @@ _moo_editor_load_session (MooEditor     *editor,
             if (!MOO_MARKUP_IS_ELEMENT (node))
                 continue;
 
-            window = load_window_session (editor, node, !old_format);
+            window = load_window_session (editor, node, !old_format, lazy);
 
             if (window && moo_markup_bool_prop (node, "active", FALSE))
                 active_window = window;
         }
 
+        editor->priv->loading_session = FALSE;
+
+        for (i = 0; i < editor->priv->windows->n_elms; ++i)
+            _moo_edit_window_load_active_doc (editor->priv->windows->elms[i]);
+
         if (active_window)
             moo_editor_set_active_window (editor, active_window);
     }
 }
 
+gboolean
+_moo_editor_is_loading_session (MooEditor *editor)
+{
+    g_return_val_if_fail (MOO_IS_EDITOR (editor), FALSE);
+    return editor->priv->loading_session;
+}
+
+/* Written as text rather than built as a markup tree, with the elements
+ * of unchanged documents taken from the previous snapshot */
 void
-_moo_editor_save_session (MooEditor     *editor,
-                          MooMarkupNode *xml)
+_moo_editor_save_session (MooEditor *editor,
+                          GString   *out)
 {
-    MooMarkupNode *node;
     MooEditWindow *active_window;
     MooEditWindowArray *windows;
     guint i;
 
     g_return_if_fail (MOO_IS_EDITOR (editor));
-    g_return_if_fail (MOO_MARKUP_IS_ELEMENT (xml));
+    g_return_if_fail (out != NULL);
 
     active_window = moo_editor_get_active_window (editor);
     windows = moo_editor_get_windows (editor);
 
-    node = moo_markup_create_element (xml, "editor");
-    moo_markup_set_prop (node, "version", CURRENT_SESSION_VERSION);
+    g_string_append (out, "<editor version=\"" CURRENT_SESSION_VERSION "\">\n");
 
     for (i = 0; i < windows->n_elms; ++i)
-    {
-        MooEditWindow *window = windows->elms[i];
-        MooMarkupNode *window_node;
-
-        window_node = save_window_session (window, node);
+        save_window_session (windows->elms[i], windows->elms[i] == active_window, out);
 
-        if (window_node && window == active_window)
-            moo_markup_set_bool_prop (window_node, "active", TRUE);
-    }
+    g_string_append (out, "</editor>\n");
 
     moo_edit_window_array_free (windows);
 }
@@ -2110,12 +2324,10 @@ moo_editor_open_files (MooEditor        *editor,
     moo_return_error_if_fail (MOO_IS_EDITOR (editor));
     moo_return_error_if_fail (!moo_open_info_array_is_empty (files));
 
+    /* FALSE if any file failed, the others are opened anyway */
     docs = _moo_editor_open_files (editor, files, parent, error);
-    ret = !moo_edit_array_is_empty (docs);
-
-    moo_assert (moo_edit_array_is_empty (docs) ||
-                moo_edit_array_get_size (docs) ==
-                    moo_open_info_array_get_size (files));
+    ret = docs != NULL && moo_edit_array_get_size (docs) ==
+                              moo_open_info_array_get_size (files);
 
     moo_edit_array_free (docs);
     return ret;
@@ -2648,6 +2860,29 @@ do_save (MooEditor    *editor,
     GError *error_here = NULL;
     gboolean result;
 
+    /* will-save handlers may modify the text, so it must be there; if
+     * the file could not be read, saving would replace it with nothing */
+    if (!_moo_edit_ensure_loaded (doc) && !_moo_edit_is_load_failed (doc))
+    {
+        /* still loading, e.g. the encoding dialog is shown */
+        g_set_error (error,
+                     MOO_EDIT_SAVE_ERROR,
+                     MOO_EDIT_SAVE_ERROR_BUSY,
+                     "document is busy");
+        return FALSE;
+    }
+
+    if (_moo_edit_is_load_failed (doc))
+    {
+        g_set_error (&error_here, MOO_EDIT_FILE_ERROR,
+                     MOO_EDIT_FILE_ERROR_FAILED,
+                     "%s", _("The file could not be loaded, so it was not saved"));
+        if (!is_embedded (editor))
+            _moo_edit_save_error_dialog (doc, file, error_here);
+        g_propagate_error (error, error_here);
+        return FALSE;
+    }
+
     g_signal_emit (editor, signals[BEFORE_SAVE], 0, doc, file, &response);
 
     if (response != MOO_SAVE_RESPONSE_CANCEL)
@@ -2976,6 +3211,13 @@ moo_editor_set_doc_type (MooEditor      *editor,
 }
 
 
+static void
+langs_loaded (MooEditor *editor)
+{
+    _moo_editor_apply_prefs (editor);
+    _moo_edit_queue_recheck_config_all (MOO_EDIT_CONFIG_CHANGED_LANGS);
+}
+
 void
 _moo_editor_apply_prefs (MooEditor *editor)
 {
@@ -2986,7 +3228,7 @@ _moo_editor_apply_prefs (MooEditor *editor)
     _moo_edit_window_set_use_tabs ();
 
     _moo_edit_update_global_config ();
-    _moo_edit_queue_recheck_config_all ();
+    _moo_edit_queue_recheck_config_all (MOO_EDIT_CONFIG_CHANGED_PREFS);
 
     color_scheme = moo_prefs_get_string (moo_edit_setting (MOO_EDIT_PREFS_COLOR_SCHEME));
 
@@ -177,8 +177,9 @@ void                 moo_editor_set_doc_type        (MooEditor              *edi
 
 void                _moo_editor_load_session        (MooEditor              *editor,
                                                      MooMarkupNode          *xml);
+/* appends the <editor> element of the session to out */
 void                _moo_editor_save_session        (MooEditor              *editor,
-                                                     MooMarkupNode          *xml);
+                                                     GString                *out);
 
 
 G_END_DECLS
@@ -133,6 +133,9 @@ _moo_edit_init_prefs (void)
     NEW_KEY_BOOL (MOO_EDIT_PREFS_BACKSPACE_INDENTS, TRUE);
 
     NEW_KEY_BOOL (MOO_EDIT_PREFS_SAVE_SESSION, TRUE);
+    NEW_KEY_BOOL (MOO_EDIT_PREFS_LAZY_SESSION, FALSE);
+    NEW_KEY_INT (MOO_EDIT_PREFS_LARGE_FILE_SIZE, 32);
+    NEW_KEY_INT (MOO_EDIT_PREFS_LARGE_FILE_LINES, 500000);
     NEW_KEY_BOOL (MOO_EDIT_PREFS_AUTO_SAVE, FALSE);
     NEW_KEY_INT (MOO_EDIT_PREFS_AUTO_SAVE_INTERVAL, 5);
     NEW_KEY_BOOL (MOO_EDIT_PREFS_MAKE_BACKUPS, FALSE);
@@ -221,26 +224,34 @@ _moo_edit_view_apply_prefs (MooEditView *view)
     MooLangMgr *mgr;
     MooTextStyleScheme *scheme;
     MooDrawWsFlags ws_flags = MOO_DRAW_WS_NONE;
+    gboolean large;
 
     g_return_if_fail (MOO_IS_EDIT_VIEW (view));
 
+    // features which need to look at the whole text or at every
+    // character drawn stay off in large file mode
+    large = _moo_edit_is_large_file (moo_edit_view_get_doc (view));
+
     g_object_freeze_notify (G_OBJECT (view));
 
     mgr = moo_lang_mgr_default ();
     scheme = moo_lang_mgr_get_active_scheme (mgr);
 
-    if (get_bool (MOO_EDIT_PREFS_SHOW_TABS))
-        ws_flags |= MOO_DRAW_WS_TABS;
-    if (get_bool (MOO_EDIT_PREFS_SHOW_SPACES))
-        ws_flags |= MOO_DRAW_WS_SPACES;
-    if (get_bool (MOO_EDIT_PREFS_SHOW_TRAILING_SPACES))
-        ws_flags |= MOO_DRAW_WS_TRAILING;
+    if (!large)
+    {
+        if (get_bool (MOO_EDIT_PREFS_SHOW_TABS))
+            ws_flags |= MOO_DRAW_WS_TABS;
+        if (get_bool (MOO_EDIT_PREFS_SHOW_SPACES))
+            ws_flags |= MOO_DRAW_WS_SPACES;
+        if (get_bool (MOO_EDIT_PREFS_SHOW_TRAILING_SPACES))
+            ws_flags |= MOO_DRAW_WS_TRAILING;
+    }
 
     g_object_set (view,
                   "smart-home-end", get_bool (MOO_EDIT_PREFS_SMART_HOME_END),
-                  "enable-highlight", get_bool (MOO_EDIT_PREFS_ENABLE_HIGHLIGHTING),
-                  "highlight-matching-brackets", get_bool (MOO_EDIT_PREFS_HIGHLIGHT_MATCHING),
-                  "highlight-mismatching-brackets", get_bool (MOO_EDIT_PREFS_HIGHLIGHT_MISMATCHING),
+                  "enable-highlight", !large && get_bool (MOO_EDIT_PREFS_ENABLE_HIGHLIGHTING),
+                  "highlight-matching-brackets", !large && get_bool (MOO_EDIT_PREFS_HIGHLIGHT_MATCHING),
+                  "highlight-mismatching-brackets", !large && get_bool (MOO_EDIT_PREFS_HIGHLIGHT_MISMATCHING),
                   "highlight-current-line", get_bool (MOO_EDIT_PREFS_HIGHLIGHT_CURRENT_LINE),
                   "draw-right-margin", get_bool (MOO_EDIT_PREFS_DRAW_RIGHT_MARGIN),
                   "right-margin-offset", get_int (MOO_EDIT_PREFS_RIGHT_MARGIN_OFFSET),
@@ -38,6 +38,12 @@ const char *moo_edit_setting            (const char *setting_name);
 #define MOO_EDIT_PREFS_OPEN_NEW_WINDOW          "open_new_window"
 
 #define MOO_EDIT_PREFS_SAVE_SESSION             "save_session"
+#define MOO_EDIT_PREFS_LAZY_SESSION             "lazy_session"
+
+/* files larger than this many megabytes or lines are opened in large
+ * file mode, 0 disables the check */
+#define MOO_EDIT_PREFS_LARGE_FILE_SIZE          "large_file_size"
+#define MOO_EDIT_PREFS_LARGE_FILE_LINES         "large_file_lines"
 
 #define MOO_EDIT_PREFS_SPACES_NO_TABS           "spaces_instead_of_tabs"
 #define MOO_EDIT_PREFS_INDENT_WIDTH             "indent_width"
@@ -283,6 +283,8 @@ page_file_init_ui (MooPrefsPage *page)
     BIND_SETTING (check_add_newline, MOO_EDIT_PREFS_ADD_NEWLINE);
     BIND_SETTING (check_make_backups, MOO_EDIT_PREFS_MAKE_BACKUPS);
     BIND_SETTING (check_save_session, MOO_EDIT_PREFS_SAVE_SESSION);
+    BIND_SETTING (check_lazy_session, MOO_EDIT_PREFS_LAZY_SESSION);
+    BIND_SENSITIVE (check_save_session, check_lazy_session);
     BIND_SETTING (check_open_dialog_follows_doc, MOO_EDIT_PREFS_DIALOGS_OPEN_FOLLOWS_DOC);
     BIND_SETTING (check_auto_sync, MOO_EDIT_PREFS_AUTO_SYNC);
 
@@ -806,7 +808,7 @@ prefs_page_apply_lang_prefs (MooPrefsPage *page)
     mgr = moo_lang_mgr_default ();
     gtk_tree_model_foreach (model, (GtkTreeModelForeachFunc) apply_one_lang, mgr);
     _moo_lang_mgr_save_config (mgr);
-    _moo_edit_queue_recheck_config_all ();
+    _moo_edit_queue_recheck_config_all (MOO_EDIT_CONFIG_CHANGED_LANGS);
 }
 
 
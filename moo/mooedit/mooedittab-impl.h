@@ -11,6 +11,9 @@ MooEditTab      *_moo_edit_tab_new                  (MooEdit        *doc);
 MooEditProgress *_moo_edit_tab_create_progress      (MooEditTab     *tab);
 void             _moo_edit_tab_destroy_progress     (MooEditTab     *tab);
 
+void             _moo_edit_tab_set_large_file       (MooEditTab     *tab,
+                                                     gboolean        large);
+
 void             _moo_edit_tab_focus_next_view      (MooEditTab     *tab);
 void             _moo_edit_tab_set_focused_view     (MooEditTab     *tab,
                                                      MooEditView    *view);
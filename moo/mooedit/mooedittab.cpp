@@ -7,12 +7,14 @@
 #include "mooeditwindow-impl.h"
 #include "mooedit-impl.h"
 #include <mooutils/moocompat.h>
+#include <mooutils/mooi18n.h>
 
 struct MooEditTab
 {
     GtkVBox base;
 
     MooEditProgress *progress;
+    GtkWidget *large_file_bar;
 
     GtkWidget *hpaned;
     GtkWidget *vpaned1;
@@ -117,6 +119,9 @@ _moo_edit_tab_new (MooEdit *doc)
     gtk_widget_show (tab->vpaned1);
     gtk_widget_show (GTK_WIDGET (tab));
 
+    if (_moo_edit_is_large_file (doc))
+        _moo_edit_tab_set_large_file (tab, TRUE);
+
     return tab;
 }
 
@@ -456,3 +461,61 @@ _moo_edit_tab_destroy_progress (MooEditTab *tab)
     gtk_widget_destroy (GTK_WIDGET (tab->progress));
     tab->progress = NULL;
 }
+
+
+static void
+enable_features_clicked (MooEditTab *tab)
+{
+    _moo_edit_leave_large_file (tab->doc);
+}
+
+static GtkWidget *
+create_large_file_bar (MooEditTab *tab)
+{
+    GtkWidget *frame, *hbox, *image, *label, *button;
+
+    frame = gtk_frame_new (NULL);
+    gtk_frame_set_shadow_type (GTK_FRAME (frame), GTK_SHADOW_OUT);
+
+    hbox = gtk_hbox_new (FALSE, 6);
+    gtk_container_set_border_width (GTK_CONTAINER (hbox), 3);
+    gtk_container_add (GTK_CONTAINER (frame), hbox);
+
+    image = gtk_image_new_from_stock (GTK_STOCK_DIALOG_INFO, GTK_ICON_SIZE_SMALL_TOOLBAR);
+    gtk_box_pack_start (GTK_BOX (hbox), image, FALSE, FALSE, 0);
+
+    label = gtk_label_new (_("This file is large, syntax highlighting and "
+                             "some other features are turned off."));
+    gtk_misc_set_alignment (GTK_MISC (label), 0, 0.5);
+    gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start (GTK_BOX (hbox), label, TRUE, TRUE, 0);
+
+    button = gtk_button_new_with_mnemonic (_("_Enable Features"));
+    g_signal_connect_swapped (button, "clicked", G_CALLBACK (enable_features_clicked), tab);
+    gtk_box_pack_end (GTK_BOX (hbox), button, FALSE, FALSE, 0);
+
+    gtk_widget_show_all (frame);
+    return frame;
+}
+
+void
+_moo_edit_tab_set_large_file (MooEditTab *tab,
+                              gboolean    large)
+{
+    g_return_if_fail (MOO_IS_EDIT_TAB (tab));
+
+    if (!large == !tab->large_file_bar)
+        return;
+
+    if (large)
+    {
+        tab->large_file_bar = create_large_file_bar (tab);
+        gtk_box_pack_start (GTK_BOX (tab), tab->large_file_bar, FALSE, FALSE, 0);
+        gtk_box_reorder_child (GTK_BOX (tab), tab->large_file_bar, 0);
+    }
+    else
+    {
+        gtk_widget_destroy (tab->large_file_bar);
+        tab->large_file_bar = NULL;
+    }
+}
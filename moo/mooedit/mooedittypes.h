@@ -13,6 +13,9 @@ typedef struct MooOpenInfo MooOpenInfo;
 typedef struct MooSaveInfo MooSaveInfo;
 typedef struct MooReloadInfo MooReloadInfo;
 
+typedef struct MooEditBatch MooEditBatch;
+typedef struct MooEditSnapshot MooEditSnapshot;
+
 typedef struct MooEdit MooEdit;
 typedef struct MooEditView MooEditView;
 typedef struct MooEditWindow MooEditWindow;
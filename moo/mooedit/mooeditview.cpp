@@ -247,6 +247,10 @@ _moo_edit_view_apply_config (MooEditView *view)
                          "word-chars", &word_chars,
                          (char*) 0);
 
+    // wrapping makes the view lay out every line of the text
+    if (_moo_edit_is_large_file (view->priv->doc))
+        wrap_mode = GTK_WRAP_NONE;
+
     gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (view), wrap_mode);
     moo_text_view_set_show_line_numbers (MOO_TEXT_VIEW (view), line_numbers);
     moo_text_view_set_tab_width (MOO_TEXT_VIEW (view), tab_width);
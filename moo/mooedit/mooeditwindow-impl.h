@@ -16,6 +16,9 @@ void             _moo_edit_window_remove_doc        (MooEditWindow  *window,
                                                      MooEdit        *doc);
 void             _moo_edit_window_set_active_tab    (MooEditWindow  *window,
                                                      MooEditTab     *tab);
+void             _moo_edit_window_load_active_doc   (MooEditWindow  *window);
+void             _moo_edit_window_begin_update      (MooEditWindow  *window);
+void             _moo_edit_window_end_update        (MooEditWindow  *window);
 void             _moo_edit_window_update_title      (void);
 void             _moo_edit_window_set_use_tabs      (void);
 
@@ -118,6 +118,12 @@ struct MooEditWindowPrivate {
     GList *history;
     gboolean enable_history : 1;
     guint history_blocked : 1;
+
+    // _moo_edit_window_begin_update() nesting and what is deferred until the end
+    guint update_depth;
+    MooEditView *update_active_view;
+    MooEditTab *update_last_tab;
+    guint update_had_focus : 1;
 };
 
 MOO_DEFINE_OBJECT_ARRAY (MooEditWindow, moo_edit_window)
@@ -780,6 +786,16 @@ moo_edit_window_class_init (MooEditWindowClass *klass)
                                  "condition::sensitive", "has-open-document",
                                  nullptr);
 
+    moo_window_class_new_action (window_class, "CompleteWord", nullptr,
+                                 "display-name", _("Complete Word"),
+                                 "label", _("Complete _Word"),
+                                 "tooltip", _("Complete word"),
+                                 "default-accel", MOO_EDIT_ACCEL_COMPLETE,
+                                 "closure-callback", moo_text_view_complete_word,
+                                 "closure-proxy-func", moo_edit_window_get_active_view,
+                                 "condition::sensitive", "has-open-document",
+                                 nullptr);
+
     moo_window_class_new_action (window_class, "NoDocuments", nullptr,
                                  /* Insensitive menu item which appears in Window menu with no documents open */
                                  "label", _("No Documents"),
@@ -2244,6 +2260,23 @@ _moo_edit_window_set_active_tab (MooEditWindow *window,
     window->priv->active_tab = tab;
 }
 
+static void
+load_shown_doc (MooEditWindow *window,
+                MooEdit       *doc)
+{
+    if (!doc || _moo_editor_is_loading_session (window->priv->editor))
+        return;
+
+    _moo_edit_ensure_loaded (doc);
+}
+
+void
+_moo_edit_window_load_active_doc (MooEditWindow *window)
+{
+    g_return_if_fail (MOO_IS_EDIT_WINDOW (window));
+    load_shown_doc (window, moo_edit_window_get_active_doc (window));
+}
+
 static void
 notebook_switch_page (MooNotebook   *notebook,
                       guint          page_num,
@@ -2251,7 +2284,9 @@ notebook_switch_page (MooNotebook   *notebook,
 {
     if (notebook == get_active_notebook (window))
     {
-        edit_changed (window, get_nth_doc (notebook, page_num));
+        MooEdit *doc = get_nth_doc (notebook, page_num);
+        load_shown_doc (window, doc);
+        edit_changed (window, doc);
         moo_edit_window_check_actions (window);
         moo_edit_window_update_doc_list (window);
         g_object_notify (G_OBJECT (window), "active-doc");
@@ -2510,6 +2545,10 @@ setup_notebook (MooEditWindow *window,
 {
     GtkWidget *button, *icon, *frame;
 
+    // a notebook added in the middle of a batch joins it
+    if (window->priv->update_depth)
+        moo_notebook_begin_update (notebook);
+
     set_use_tabs (window, notebook);
 
     g_signal_connect_after (notebook, "moo-switch-page",
@@ -2810,6 +2849,12 @@ moo_edit_window_set_active_view (MooEditWindow *window,
     page = get_view_page_num (window, view, &notebook);
     g_return_if_fail (page >= 0);
 
+    if (window->priv->update_depth)
+    {
+        window->priv->update_active_view = view;
+        return;
+    }
+
     window->priv->active_tab = moo_edit_view_get_tab (view);
     moo_notebook_set_current_page (notebook, page);
     gtk_widget_grab_focus (GTK_WIDGET (view));
@@ -3105,6 +3150,16 @@ _moo_edit_window_insert_tab (MooEditWindow *window,
             g_critical ("oops");
     }
 
+    if (page < 0 && window->priv->update_last_tab)
+    {
+        // keep documents opened in one batch in order, the current page
+        // does not change until the batch is finished
+        notebook = get_active_notebook (window);
+        page = moo_notebook_page_num (notebook, GTK_WIDGET (window->priv->update_last_tab));
+        if (page >= 0)
+            page += 1;
+    }
+
     if (page < 0)
     {
         notebook = get_active_notebook (window);
@@ -3114,6 +3169,9 @@ _moo_edit_window_insert_tab (MooEditWindow *window,
     show_notebook (window, notebook);
     moo_notebook_insert_page (notebook, GTK_WIDGET (tab), label, page);
 
+    if (window->priv->update_depth)
+        window->priv->update_last_tab = tab;
+
     g_signal_connect_swapped (doc, "doc_status_changed",
                               G_CALLBACK (edit_changed), window);
     g_signal_connect_swapped (doc, "notify::encoding",
@@ -3132,16 +3190,20 @@ _moo_edit_window_insert_tab (MooEditWindow *window,
 
     g_object_ref (doc);
 
-    moo_edit_window_update_doc_list (window);
+    if (!window->priv->update_depth)
+        moo_edit_window_update_doc_list (window);
     g_signal_emit (window, signals[NEW_DOC], 0, doc);
 
     _moo_doc_attach_plugins (window, doc);
 
     moo_edit_window_set_active_doc (window, doc);
     edit_changed (window, doc);
-    gtk_widget_grab_focus (GTK_WIDGET (moo_edit_get_view (doc)));
 
-    g_object_notify (G_OBJECT (window), "can-move-to-split-notebook");
+    if (!window->priv->update_depth)
+    {
+        gtk_widget_grab_focus (GTK_WIDGET (moo_edit_get_view (doc)));
+        g_object_notify (G_OBJECT (window), "can-move-to-split-notebook");
+    }
 
     moo_edit_view_array_free (views);
 }
@@ -3174,11 +3236,15 @@ _moo_edit_window_remove_doc (MooEditWindow *window,
 
     if (tab == window->priv->active_tab)
         window->priv->active_tab = nullptr;
+    if (tab == window->priv->update_last_tab)
+        window->priv->update_last_tab = nullptr;
 
     for (i = 0; i < views->n_elms; ++i)
     {
         MooEditView *view = views->elms[i];
         had_focus = had_focus || GTK_WIDGET_HAS_FOCUS (view);
+        if (view == window->priv->update_active_view)
+            window->priv->update_active_view = nullptr;
     }
 
     g_signal_emit (window, signals[CLOSE_DOC], 0, doc);
@@ -3207,7 +3273,8 @@ _moo_edit_window_remove_doc (MooEditWindow *window,
         window->priv->history_blocked = TRUE;
     }
 
-    moo_edit_window_update_doc_list (window);
+    if (!window->priv->update_depth)
+        moo_edit_window_update_doc_list (window);
 
     moo_notebook_remove_page (notebook, page);
 
@@ -3221,6 +3288,16 @@ _moo_edit_window_remove_doc (MooEditWindow *window,
             moo_edit_window_set_active_doc (window, (MooEdit*) window->priv->history->data);
     }
 
+    if (window->priv->update_depth)
+    {
+        if (had_focus)
+            window->priv->update_had_focus = TRUE;
+        g_signal_emit (window, signals[CLOSE_DOC_AFTER], 0);
+        moo_edit_view_array_free (views);
+        g_object_unref (doc);
+        return;
+    }
+
     edit_changed (window, nullptr);
 
     g_signal_emit (window, signals[CLOSE_DOC_AFTER], 0);
@@ -3242,6 +3319,60 @@ _moo_edit_window_remove_doc (MooEditWindow *window,
 }
 
 
+/* Starts a batch of _moo_edit_window_insert_doc() and _moo_edit_window_remove_doc()
+ * calls: tabs are not relaid out and the active document does not change until
+ * _moo_edit_window_end_update(), so opening or closing hundreds of documents
+ * does not switch pages and update the window for every one of them. */
+void
+_moo_edit_window_begin_update (MooEditWindow *window)
+{
+    g_return_if_fail (MOO_IS_EDIT_WINDOW (window));
+
+    if (window->priv->update_depth++ == 0)
+        for (const auto& nb: window->priv->notebooks)
+            moo_notebook_begin_update (nb.get());
+}
+
+void
+_moo_edit_window_end_update (MooEditWindow *window)
+{
+    MooEditView *view;
+    gboolean had_focus;
+
+    g_return_if_fail (MOO_IS_EDIT_WINDOW (window));
+    g_return_if_fail (window->priv->update_depth > 0);
+
+    if (--window->priv->update_depth)
+        return;
+
+    view = window->priv->update_active_view;
+    had_focus = window->priv->update_had_focus;
+    window->priv->update_active_view = nullptr;
+    window->priv->update_last_tab = nullptr;
+    window->priv->update_had_focus = FALSE;
+
+    if (view)
+        moo_edit_window_set_active_view (window, view);
+
+    for (const auto& nb: window->priv->notebooks)
+        moo_notebook_end_update (nb.get());
+
+    // a closed document had focus and nothing was made active in its place:
+    // give it to whatever the notebook shows now, as a single close would
+    if (!view && had_focus && (view = ACTIVE_VIEW (window)))
+        gtk_widget_grab_focus (GTK_WIDGET (view));
+
+    moo_edit_window_update_doc_list (window);
+    edit_changed (window, nullptr);
+    moo_edit_window_check_actions (window);
+
+    g_object_freeze_notify (G_OBJECT (window));
+    g_object_notify (G_OBJECT (window), "active-doc");
+    g_object_notify (G_OBJECT (window), "can-move-to-split-notebook");
+    g_object_thaw_notify (G_OBJECT (window));
+}
+
+
 typedef struct {
     int x;
     int y;
@@ -4113,6 +4244,8 @@ edit_lang_changed (MooEditWindow      *window,
         update_lang_menu (window);
         moo_edit_window_check_actions (window);
     }
+
+    _moo_doc_plugins_lang_changed (doc);
 }
 
 
@@ -15,6 +15,8 @@
 
 #include "mooedit/mooindenter.h"
 #include "mooedit/mooedit.h"
+#include "mooedit/mootextbuffer.h"
+#include "mooedit/mootext-private.h"
 #include "marshals.h"
 #include <string.h>
 
@@ -377,62 +379,65 @@ moo_indenter_tab (MooIndenter    *indenter,
 }
 
 
+/* shift_line_forward() and shift_line_backward() append the leading white
+   space of the line at iter which is to be replaced to old_text, and its
+   replacement to new_text, each followed by '\n' */
+
 static void
 shift_line_forward (MooIndenter   *indenter,
-                    GtkTextBuffer *buffer,
-                    GtkTextIter   *iter)
+                    GtkTextIter   *iter,
+                    GString       *old_text,
+                    GString       *new_text)
 {
-    char *text;
+    GtkTextIter start = *iter;
     guint offset;
-    GtkTextIter start;
-
-    if (!compute_line_offset (iter, indenter->tab_width, &offset))
-        return;
 
-    if (offset)
+    if (compute_line_offset (iter, indenter->tab_width, &offset))
     {
-        start = *iter;
-        gtk_text_iter_set_line_offset (&start, 0);
-        gtk_text_buffer_delete (buffer, &start, iter);
-    }
+        char *old_space = gtk_text_iter_get_slice (&start, iter);
+        char *new_space = moo_indenter_make_space (indenter, offset + indenter->indent, 0);
 
-    text = moo_indenter_make_space (indenter, offset + indenter->indent, 0);
+        g_string_append (old_text, old_space);
+        if (new_space)
+            g_string_append (new_text, new_space);
 
-    if (text)
-        gtk_text_buffer_insert (buffer, iter, text, -1);
+        g_free (new_space);
+        g_free (old_space);
+    }
 
-    g_free (text);
+    g_string_append_c (old_text, '\n');
+    g_string_append_c (new_text, '\n');
 }
 
 
 static void
 shift_line_backward (MooIndenter   *indenter,
-                     GtkTextBuffer *buffer,
-                     GtkTextIter   *iter)
+                     GtkTextIter   *iter,
+                     GString       *old_text,
+                     GString       *new_text)
 {
-    GtkTextIter end;
     int deleted;
     gunichar c;
 
-    gtk_text_iter_set_line_offset (iter, 0);
-    end = *iter;
     deleted = 0;
 
     while (TRUE)
     {
-        if (gtk_text_iter_ends_line (&end))
+        if (gtk_text_iter_ends_line (iter))
             break;
 
-        c = gtk_text_iter_get_char (&end);
+        c = gtk_text_iter_get_char (iter);
 
         if (c == ' ')
         {
-            gtk_text_iter_forward_char (&end);
+            gtk_text_iter_forward_char (iter);
+            g_string_append_c (old_text, ' ');
             deleted += 1;
         }
         else if (c == '\t')
         {
-            gtk_text_iter_forward_char (&end);
+            gtk_text_iter_forward_char (iter);
+            g_string_append_c (old_text, '\t');
             deleted += indenter->tab_width;
         }
         else
@@ -444,19 +449,22 @@ shift_line_backward (MooIndenter   *indenter,
             break;
     }
 
-    gtk_text_buffer_delete (buffer, iter, &end);
-
     deleted -= indenter->indent;
 
     if (deleted > 0)
     {
         char *text = moo_indenter_make_space (indenter, deleted, 0);
-        gtk_text_buffer_insert (buffer, iter, text, -1);
+        g_string_append (new_text, text);
         g_free (text);
     }
+
+    g_string_append_c (old_text, '\n');
+    g_string_append_c (new_text, '\n');
 }
 
 
+/* new indentation of all lines is computed first and then applied
+   to the buffer at once, as a single undo action */
 void
 moo_indenter_shift_lines (MooIndenter    *indenter,
                           GtkTextBuffer  *buffer,
@@ -466,17 +474,35 @@ moo_indenter_shift_lines (MooIndenter    *indenter,
 {
     guint i;
     GtkTextIter iter;
+    GString *old_text, *new_text;
+
+    g_return_if_fail (MOO_IS_TEXT_BUFFER (buffer));
+    g_return_if_fail (first_line <= last_line);
 
     sync_settings (indenter);
 
+    old_text = g_string_new (NULL);
+    new_text = g_string_new (NULL);
+
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, first_line);
+
     for (i = first_line; i <= last_line; ++i)
     {
-        gtk_text_buffer_get_iter_at_line (buffer, &iter, i);
         if (direction > 0)
-            shift_line_forward (indenter, buffer, &iter);
+            shift_line_forward (indenter, &iter, old_text, new_text);
         else
-            shift_line_backward (indenter, buffer, &iter);
+            shift_line_backward (indenter, &iter, old_text, new_text);
+
+        gtk_text_iter_forward_line (&iter);
     }
+
+    if (strcmp (old_text->str, new_text->str) != 0)
+        _moo_text_buffer_replace_line_prefixes (MOO_TEXT_BUFFER (buffer),
+                                                first_line, last_line - first_line + 1,
+                                                old_text->str, new_text->str);
+
+    g_string_free (new_text, TRUE);
+    g_string_free (old_text, TRUE);
 }
 
 
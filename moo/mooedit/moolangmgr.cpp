@@ -24,6 +24,7 @@
 #include "mooutils/mooprefs.h"
 #include "marshals.h"
 #include "mooutils/moo-mime.h"
+#include "mooutils/mootrace.h"
 #include <string.h>
 
 #define LANGUAGE_DIR            "language-specs"
@@ -508,6 +509,8 @@ read_langs (MooLangMgr *mgr)
     if (mgr->got_langs)
         return;
 
+    MOO_TRACE_BEGIN ("languages load");
+
     read_schemes (mgr);
 
     mgr->got_langs = TRUE;
@@ -536,6 +539,8 @@ read_langs (MooLangMgr *mgr)
         ids++;
     }
 
+    MOO_TRACE_END ("languages load");
+
     g_signal_emit_by_name (mgr, "loaded");
 }
 
@@ -18,9 +18,13 @@
 #endif
 #include "mooedit/mooplugin-loader.h"
 #include "mooedit/mooplugin.h"
+#include "mooedit/mooeditwindow.h"
 #include "mooutils/mooutils-misc.h"
+#include "mooutils/mooprefs.h"
 #include "mooutils/mooutils-debug.h"
 #include "mooutils/mooi18n.h"
+#include "mooutils/mootrace.h"
+#include "marshals.h"
 #include <string.h>
 #include <stdlib.h>
 #include <gmodule.h>
@@ -40,8 +44,59 @@
 #define KEY_VERSION     "version"
 #define KEY_ENABLED     "enabled"
 #define KEY_VISIBLE     "visible"
+#define KEY_LOAD_ON     "load-on"
+#define KEY_LABEL       "label"
+#define KEY_STOCK       "stock"
+#define KEY_ACCEL       "accel"
+#define KEY_MENU        "menu"
+#define KEY_POSITION    "position"
+#define KEY_FILTER      "filter"
+#define KEY_REQUIRES    "requires"
+
+/* Values of load-on in the module group. A module with load-on is not
+ * loaded at startup unless it lists "startup"; it's loaded when one
+ * of the listed actions is invoked, one of the panes is shown or a
+ * document in one of the languages is opened. Until then actions and
+ * panes are represented by placeholders described in the groups named
+ * after the trigger, e.g.
+ *
+ *   [module]
+ *   load-on=action:RunFile;lang:python
+ *
+ *   [action:RunFile]
+ *   _label=Run File
+ *   accel=<shift>F9
+ *   menu=ToolsMenu
+ *   filter=langs:python
+ *
+ * filter makes the action sensitive only in matching documents, as
+ * moo_edit_window_set_action_filter() does. requires names a file in
+ * the data or lib directories, e.g. python/pyconsole.py; without it
+ * the placeholder is not added. Modules of plugins which are disabled
+ * in preferences get no placeholders and are not loaded by triggers,
+ * only when the plugins preferences page needs them.
+ */
+#define TRIGGER_STARTUP "startup"
+#define TRIGGER_ACTION  "action:"
+#define TRIGGER_PANE    "pane:"
+#define TRIGGER_LANG    "lang:"
+/* not a load-on value, it's what loads disabled plugins */
+#define TRIGGER_PREFS   "prefs"
+
+#define PLACEHOLDER_PANE_KEY "moo-plugin-placeholder-pane"
 
 
+typedef struct {
+    char *id;
+    char *label;
+    char *stock;
+    char *accel;
+    char *menu;
+    char *filter;
+    MooPanePosition position;
+    gboolean added;
+} Placeholder;
+
 typedef struct {
     char            *ini_file;
     char            *loader;
@@ -49,24 +104,53 @@ typedef struct {
     char            *plugin_id;
     MooPluginInfo   *plugin_info;
     MooPluginParams *plugin_params;
+    char           **load_on;
+    GSList          *actions;   /* Placeholder* */
+    GSList          *panes;     /* Placeholder* */
+    guint            merge_id;
+    gboolean         disabled;
 } ModuleInfo;
 
+typedef struct {
+    MooEditWindow *window;
+    char *trigger;
+} Activation;
+
 
 static GHashTable *registered_loaders;
 static GSList *waiting_list;
+static GSList *deferred_list;
 
 static void init_loaders                    (void);
 GType       _moo_c_plugin_loader_get_type   (void);
 static void module_info_free                (ModuleInfo *info);
 
 
+static char *
+module_info_get_id (ModuleInfo *module_info)
+{
+    if (module_info->plugin_id)
+        return g_strdup (module_info->plugin_id);
+    else
+        return g_path_get_basename (module_info->ini_file);
+}
+
 static void
 moo_plugin_loader_load (const MooPluginLoader *loader,
-                        ModuleInfo            *module_info)
+                        ModuleInfo            *module_info,
+                        const char            *trigger)
 {
+    gint64 start;
+    char *id;
+
+    g_return_if_fail (module_info->plugin_id ? loader->load_plugin != NULL :
+                                               loader->load_module != NULL);
+
+    start = g_get_monotonic_time ();
+    MOO_TRACE_BEGIN_DETAIL ("module load", module_info->file);
+
     if (module_info->plugin_id)
     {
-        g_return_if_fail (loader->load_plugin != NULL);
         loader->load_plugin (module_info->file,
                              module_info->plugin_id,
                              module_info->plugin_info,
@@ -76,11 +160,16 @@ moo_plugin_loader_load (const MooPluginLoader *loader,
     }
     else
     {
-        g_return_if_fail (loader->load_module != NULL);
         loader->load_module (module_info->file,
                              module_info->ini_file,
                              loader->data);
     }
+
+    MOO_TRACE_END ("module load");
+
+    id = module_info_get_id (module_info);
+    _moo_plugin_stats_loaded (id, trigger, g_get_monotonic_time () - start);
+    g_free (id);
 }
 
 
@@ -149,7 +238,7 @@ moo_plugin_loader_register (const MooPluginLoader *loader,
 
     while (open_now)
     {
-        moo_plugin_loader_load (loader, open_now->data);
+        moo_plugin_loader_load (loader, open_now->data, TRIGGER_STARTUP);
         module_info_free (open_now->data);
         open_now = g_slist_delete_link (open_now, open_now);
     }
@@ -240,6 +329,183 @@ invalid:
 }
 
 
+/* requires is "subdir/file", the file is looked for in the subdir
+ * of data and lib directories */
+static gboolean
+check_requires (GKeyFile   *key_file,
+                const char *trigger)
+{
+    char *requires;
+    char *slash;
+    char **dirs, **d;
+    gboolean found = FALSE;
+
+    if (!(requires = g_key_file_get_string (key_file, trigger, KEY_REQUIRES, NULL)))
+        return TRUE;
+
+    if (!(slash = strchr (requires, '/')))
+    {
+        g_warning ("invalid value '%s' of " KEY_REQUIRES " in group '%s'", requires, trigger);
+        g_free (requires);
+        return FALSE;
+    }
+
+    *slash = 0;
+    dirs = moo_get_data_and_lib_subdirs (requires);
+
+    for (d = dirs; d && *d && !found; ++d)
+    {
+        char *path = g_build_filename (*d, slash + 1, NULL);
+        found = g_file_test (path, G_FILE_TEST_EXISTS);
+        g_free (path);
+    }
+
+    g_strfreev (dirs);
+    g_free (requires);
+    return found;
+}
+
+/* label is looked up as in .desktop files; _label is what intltool
+ * merges it from, then it's translated with gettext */
+static char *
+get_placeholder_label (GKeyFile   *key_file,
+                       const char *trigger)
+{
+    char *label;
+    char *msgid;
+
+    if ((label = g_key_file_get_locale_string (key_file, trigger, KEY_LABEL, NULL, NULL)))
+        return label;
+
+    if (!(msgid = g_key_file_get_string (key_file, trigger, "_" KEY_LABEL, NULL)))
+        return NULL;
+
+    label = g_strdup (_(msgid));
+    g_free (msgid);
+    return label;
+}
+
+static Placeholder *
+parse_placeholder (GKeyFile   *key_file,
+                   const char *trigger,
+                   const char *id)
+{
+    Placeholder *ph;
+    char *position;
+
+    if (!check_requires (key_file, trigger))
+        return NULL;
+
+    ph = g_new0 (Placeholder, 1);
+    ph->id = g_strdup (id);
+    ph->label = get_placeholder_label (key_file, trigger);
+    ph->stock = g_key_file_get_string (key_file, trigger, KEY_STOCK, NULL);
+    ph->accel = g_key_file_get_string (key_file, trigger, KEY_ACCEL, NULL);
+    ph->menu = g_key_file_get_string (key_file, trigger, KEY_MENU, NULL);
+    ph->filter = g_key_file_get_string (key_file, trigger, KEY_FILTER, NULL);
+    ph->position = MOO_PANE_POS_BOTTOM;
+
+    if (!ph->label)
+        ph->label = g_strdup (id);
+
+    position = g_key_file_get_string (key_file, trigger, KEY_POSITION, NULL);
+
+    if (!position || !strcmp (position, "bottom"))
+        ph->position = MOO_PANE_POS_BOTTOM;
+    else if (!strcmp (position, "left"))
+        ph->position = MOO_PANE_POS_LEFT;
+    else if (!strcmp (position, "right"))
+        ph->position = MOO_PANE_POS_RIGHT;
+    else if (!strcmp (position, "top"))
+        ph->position = MOO_PANE_POS_TOP;
+    else
+        g_warning ("invalid pane position '%s'", position);
+
+    g_free (position);
+    return ph;
+}
+
+static void
+placeholder_free (Placeholder *ph)
+{
+    g_free (ph->id);
+    g_free (ph->label);
+    g_free (ph->stock);
+    g_free (ph->accel);
+    g_free (ph->menu);
+    g_free (ph->filter);
+    g_free (ph);
+}
+
+static void
+parse_load_on (GKeyFile   *key_file,
+               ModuleInfo *module_info)
+{
+    Placeholder *ph;
+    char **p;
+
+    module_info->load_on = g_key_file_get_string_list (key_file, GROUP_MODULE, KEY_LOAD_ON, NULL, NULL);
+
+    for (p = module_info->load_on; p && *p; ++p)
+    {
+        g_strstrip (*p);
+
+        if (g_str_has_prefix (*p, TRIGGER_ACTION))
+        {
+            if ((ph = parse_placeholder (key_file, *p, *p + strlen (TRIGGER_ACTION))))
+                module_info->actions = g_slist_append (module_info->actions, ph);
+        }
+        else if (g_str_has_prefix (*p, TRIGGER_PANE))
+        {
+            if ((ph = parse_placeholder (key_file, *p, *p + strlen (TRIGGER_PANE))))
+                module_info->panes = g_slist_append (module_info->panes, ph);
+        }
+        else if (strcmp (*p, TRIGGER_STARTUP) != 0 && !g_str_has_prefix (*p, TRIGGER_LANG))
+            g_warning ("unknown load-on value '%s' in file '%s'", *p, module_info->ini_file);
+    }
+}
+
+static gboolean
+module_is_deferred (ModuleInfo *module_info)
+{
+    char **p;
+    gboolean have_triggers = FALSE;
+
+    for (p = module_info->load_on; p && *p; ++p)
+    {
+        if (!strcmp (*p, TRIGGER_STARTUP))
+            return FALSE;
+        else if (g_str_has_prefix (*p, TRIGGER_ACTION) ||
+                 g_str_has_prefix (*p, TRIGGER_PANE) ||
+                 g_str_has_prefix (*p, TRIGGER_LANG))
+            have_triggers = TRUE;
+    }
+
+    return have_triggers;
+}
+
+/* same preferences key as moo_plugin_register() uses */
+static gboolean
+module_is_disabled (ModuleInfo *module_info)
+{
+    char *prefs_key;
+    gboolean enabled;
+
+    if (!module_info->plugin_id)
+        return FALSE;
+
+    prefs_key = moo_prefs_make_key (MOO_PLUGIN_PREFS_ROOT,
+                                    module_info->plugin_id,
+                                    "enabled",
+                                    NULL);
+    moo_prefs_new_key_bool (prefs_key, module_info->plugin_params->enabled);
+    enabled = moo_prefs_get_bool (prefs_key);
+    g_free (prefs_key);
+
+    return !enabled;
+}
+
+
 static ModuleInfo *
 parse_ini_file (const char *dir,
                 const char *ini_file)
@@ -316,6 +582,8 @@ parse_ini_file (const char *dir,
     module_info->ini_file = ini_file_path;
     ini_file_path = NULL;
 
+    parse_load_on (key_file, module_info);
+
 out:
     if (error)
         g_error_free (error);
@@ -345,10 +613,388 @@ module_info_free (ModuleInfo *module_info)
     g_free (module_info->plugin_id);
     moo_plugin_info_free (module_info->plugin_info);
     moo_plugin_params_free (module_info->plugin_params);
+    g_strfreev (module_info->load_on);
+    g_slist_foreach (module_info->actions, (GFunc) placeholder_free, NULL);
+    g_slist_free (module_info->actions);
+    g_slist_foreach (module_info->panes, (GFunc) placeholder_free, NULL);
+    g_slist_free (module_info->panes);
     g_free (module_info);
 }
 
 
+/* Deferred loading
+ */
+
+static gboolean     placeholder_activated   (Activation *act);
+
+static MooUiXml *
+get_ui_xml (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    return editor ? moo_editor_get_ui_xml (editor) : NULL;
+}
+
+static MooEditWindowArray *
+get_windows (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    return editor ? moo_editor_get_windows (editor) : moo_edit_window_array_new ();
+}
+
+static void
+activation_free (Activation *act)
+{
+    g_object_unref (act->window);
+    g_free (act->trigger);
+    g_free (act);
+}
+
+/* the placeholder is removed when the module is loaded, so it's
+ * done in an idle and not in its own signal handler */
+static void
+queue_activation (MooEditWindow *window,
+                  const char    *trigger)
+{
+    Activation *act = g_new0 (Activation, 1);
+    act->window = MOO_EDIT_WINDOW (g_object_ref (window));
+    act->trigger = g_strdup (trigger);
+    g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                     (GSourceFunc) placeholder_activated,
+                     act, (GDestroyNotify) activation_free);
+}
+
+static void
+placeholder_action_activated (MooEditWindow *window,
+                              const char    *trigger)
+{
+    queue_activation (window, trigger);
+}
+
+static void
+placeholder_pane_mapped (GtkWidget *widget)
+{
+    MooEditWindow *window = g_object_get_data (G_OBJECT (widget), "moo-edit-window");
+    queue_activation (window, g_object_get_data (G_OBJECT (widget), PLACEHOLDER_PANE_KEY));
+}
+
+static void
+add_placeholder_actions (ModuleInfo *module_info)
+{
+    MooWindowClass *klass;
+    MooUiXml *xml;
+    GSList *l;
+
+    if (!module_info->actions)
+        return;
+
+    klass = g_type_class_ref (MOO_TYPE_EDIT_WINDOW);
+    xml = get_ui_xml ();
+
+    for (l = module_info->actions; l != NULL; l = l->next)
+    {
+        Placeholder *ph = l->data;
+        char *trigger;
+
+        if (moo_window_class_find_action (klass, ph->id))
+        {
+            g_warning ("action '%s' from file '%s' already exists",
+                       ph->id, module_info->ini_file);
+            continue;
+        }
+
+        trigger = g_strconcat (TRIGGER_ACTION, ph->id, NULL);
+        _moo_window_class_new_action_callback (klass, ph->id, NULL,
+                                               G_CALLBACK (placeholder_action_activated),
+                                               _moo_marshal_VOID__STRING,
+                                               G_TYPE_NONE, 1,
+                                               G_TYPE_STRING, trigger,
+                                               "display-name", ph->label,
+                                               "label", ph->label,
+                                               "stock-id", ph->stock,
+                                               "default-accel", ph->accel,
+                                               NULL);
+        ph->added = TRUE;
+        g_free (trigger);
+
+        if (xml && ph->menu)
+        {
+            if (!module_info->merge_id)
+                module_info->merge_id = moo_ui_xml_new_merge_id (xml);
+            moo_ui_xml_add_item (xml, module_info->merge_id, ph->menu, ph->id, ph->id, -1);
+        }
+
+        if (ph->filter)
+            moo_edit_window_set_action_filter (ph->id, MOO_ACTION_CHECK_SENSITIVE, ph->filter);
+    }
+
+    g_type_class_unref (klass);
+}
+
+static void
+remove_placeholder_actions (ModuleInfo *module_info)
+{
+    MooWindowClass *klass;
+    MooUiXml *xml;
+    GSList *l;
+
+    if (!module_info->actions)
+        return;
+
+    klass = g_type_class_ref (MOO_TYPE_EDIT_WINDOW);
+    xml = get_ui_xml ();
+
+    if (xml && module_info->merge_id)
+        moo_ui_xml_remove_ui (xml, module_info->merge_id);
+    module_info->merge_id = 0;
+
+    for (l = module_info->actions; l != NULL; l = l->next)
+    {
+        Placeholder *ph = l->data;
+
+        if (ph->added)
+            moo_window_class_remove_action (klass, ph->id);
+        if (ph->added && ph->filter)
+            moo_edit_window_set_action_filter (ph->id, MOO_ACTION_CHECK_SENSITIVE, NULL);
+
+        ph->added = FALSE;
+    }
+
+    g_type_class_unref (klass);
+}
+
+static void
+add_placeholder_panes (ModuleInfo    *module_info,
+                       MooEditWindow *window)
+{
+    GSList *l;
+
+    for (l = module_info->panes; l != NULL; l = l->next)
+    {
+        Placeholder *ph = l->data;
+        MooPaneLabel *label;
+        GtkWidget *widget;
+
+        if (moo_edit_window_get_pane (window, ph->id))
+            continue;
+
+        widget = gtk_event_box_new ();
+        g_object_set_data_full (G_OBJECT (widget), PLACEHOLDER_PANE_KEY,
+                                g_strconcat (TRIGGER_PANE, ph->id, NULL),
+                                g_free);
+        g_object_set_data (G_OBJECT (widget), "moo-edit-window", window);
+        g_signal_connect (widget, "map", G_CALLBACK (placeholder_pane_mapped), NULL);
+        gtk_widget_show (widget);
+
+        label = moo_pane_label_new (ph->stock, NULL, ph->label, ph->label);
+        moo_edit_window_add_pane (window, ph->id, widget, label, ph->position);
+        moo_pane_label_free (label);
+    }
+}
+
+static void
+remove_placeholder_panes (ModuleInfo    *module_info,
+                          MooEditWindow *window)
+{
+    GSList *l;
+
+    for (l = module_info->panes; l != NULL; l = l->next)
+    {
+        Placeholder *ph = l->data;
+        GtkWidget *widget = moo_edit_window_get_pane (window, ph->id);
+
+        if (widget && g_object_get_data (G_OBJECT (widget), PLACEHOLDER_PANE_KEY))
+            moo_edit_window_remove_pane (window, ph->id);
+    }
+}
+
+static void
+defer_module (ModuleInfo *module_info)
+{
+    MooEditWindowArray *windows;
+    guint i;
+
+    deferred_list = g_slist_append (deferred_list, module_info);
+
+    if ((module_info->disabled = module_is_disabled (module_info)))
+        return;
+
+    add_placeholder_actions (module_info);
+
+    windows = get_windows ();
+    for (i = 0; i < windows->n_elms; ++i)
+        add_placeholder_panes (module_info, windows->elms[i]);
+    moo_edit_window_array_free (windows);
+}
+
+static ModuleInfo *
+find_deferred (const char *trigger)
+{
+    GSList *l;
+
+    for (l = deferred_list; l != NULL; l = l->next)
+    {
+        ModuleInfo *module_info = l->data;
+        char **p;
+
+        if (module_info->disabled)
+            continue;
+
+        for (p = module_info->load_on; p && *p; ++p)
+            if (!strcmp (*p, trigger))
+                return module_info;
+    }
+
+    return NULL;
+}
+
+static void
+undefer_module (ModuleInfo *module_info)
+{
+    MooEditWindowArray *windows;
+    guint i;
+
+    deferred_list = g_slist_remove (deferred_list, module_info);
+
+    remove_placeholder_actions (module_info);
+
+    windows = get_windows ();
+    for (i = 0; i < windows->n_elms; ++i)
+        remove_placeholder_panes (module_info, windows->elms[i]);
+    moo_edit_window_array_free (windows);
+}
+
+static void
+load_deferred (ModuleInfo *module_info,
+               const char *trigger)
+{
+    MooPluginLoader *loader;
+
+    undefer_module (module_info);
+
+    loader = moo_plugin_loader_lookup (module_info->loader);
+
+    if (loader)
+        moo_plugin_loader_load (loader, module_info, trigger);
+    else
+        _moo_message ("unknown module type '%s' in file %s",
+                      module_info->loader, module_info->ini_file);
+
+    module_info_free (module_info);
+}
+
+static gboolean
+window_is_alive (MooEditWindow *window)
+{
+    MooEditWindowArray *windows;
+    gboolean alive;
+
+    windows = get_windows ();
+    alive = moo_edit_window_array_find (windows, window) >= 0;
+    moo_edit_window_array_free (windows);
+
+    return alive;
+}
+
+static gboolean
+placeholder_activated (Activation *act)
+{
+    ModuleInfo *module_info;
+    GtkAction *action;
+
+    if ((module_info = find_deferred (act->trigger)))
+        load_deferred (module_info, act->trigger);
+
+    if (!window_is_alive (act->window))
+        return FALSE;
+
+    if (g_str_has_prefix (act->trigger, TRIGGER_ACTION))
+    {
+        action = moo_window_get_action (MOO_WINDOW (act->window),
+                                        act->trigger + strlen (TRIGGER_ACTION));
+        if (action)
+            gtk_action_activate (action);
+    }
+    else if (g_str_has_prefix (act->trigger, TRIGGER_PANE))
+    {
+        const char *id = act->trigger + strlen (TRIGGER_PANE);
+        if (moo_edit_window_get_pane (act->window, id))
+            moo_edit_window_show_pane (act->window, id);
+    }
+
+    return FALSE;
+}
+
+void
+_moo_plugin_loader_attach_win (MooEditWindow *window)
+{
+    GSList *l;
+
+    g_return_if_fail (MOO_IS_EDIT_WINDOW (window));
+
+    for (l = deferred_list; l != NULL; l = l->next)
+        if (!((ModuleInfo*) l->data)->disabled)
+            add_placeholder_panes (l->data, window);
+}
+
+void
+_moo_plugin_loader_detach_win (MooEditWindow *window)
+{
+    GSList *l;
+
+    g_return_if_fail (MOO_IS_EDIT_WINDOW (window));
+
+    for (l = deferred_list; l != NULL; l = l->next)
+        remove_placeholder_panes (l->data, window);
+}
+
+void
+_moo_plugin_loader_lang_used (const char *lang_id)
+{
+    ModuleInfo *module_info;
+    char *trigger;
+
+    if (!deferred_list || !lang_id)
+        return;
+
+    trigger = g_strconcat (TRIGGER_LANG, lang_id, NULL);
+
+    while ((module_info = find_deferred (trigger)))
+        load_deferred (module_info, trigger);
+
+    g_free (trigger);
+}
+
+void
+_moo_plugin_loader_load_disabled (void)
+{
+    GSList *disabled = NULL;
+    GSList *l;
+
+    for (l = deferred_list; l != NULL; l = l->next)
+        if (((ModuleInfo*) l->data)->disabled)
+            disabled = g_slist_prepend (disabled, l->data);
+
+    disabled = g_slist_reverse (disabled);
+
+    while (disabled)
+    {
+        load_deferred (disabled->data, TRIGGER_PREFS);
+        disabled = g_slist_delete_link (disabled, disabled);
+    }
+}
+
+void
+_moo_plugin_loader_shutdown (void)
+{
+    while (deferred_list)
+    {
+        ModuleInfo *module_info = deferred_list->data;
+        undefer_module (module_info);
+        module_info_free (module_info);
+    }
+}
+
+
 void
 _moo_plugin_load (const char *dir,
                   const char *ini_file)
@@ -362,7 +1008,11 @@ _moo_plugin_load (const char *dir,
 
     module_info = parse_ini_file (dir, ini_file);
 
-    if (module_info)
+    if (module_info && module_is_deferred (module_info))
+    {
+        defer_module (module_info);
+    }
+    else if (module_info)
     {
         loader = moo_plugin_loader_lookup (module_info->loader);
 
@@ -372,7 +1022,7 @@ _moo_plugin_load (const char *dir,
         }
         else
         {
-            moo_plugin_loader_load (loader, module_info);
+            moo_plugin_loader_load (loader, module_info, TRIGGER_STARTUP);
             module_info_free (module_info);
         }
     }
@@ -382,6 +1032,8 @@ _moo_plugin_load (const char *dir,
 void
 _moo_plugin_finish_load (void)
 {
+    GSList *l, *next;
+
     while (waiting_list)
     {
         ModuleInfo *info = waiting_list->data;
@@ -390,6 +1042,30 @@ _moo_plugin_finish_load (void)
         module_info_free (info);
         waiting_list = g_slist_delete_link (waiting_list, waiting_list);
     }
+
+    /* modules waiting for a trigger must have a loader by now too */
+    for (l = deferred_list; l != NULL; l = next)
+    {
+        ModuleInfo *info = l->data;
+
+        next = l->next;
+
+        if (!moo_plugin_loader_lookup (info->loader))
+        {
+            _moo_message ("unknown module type '%s' in file %s",
+                          info->loader, info->ini_file);
+            undefer_module (info);
+            module_info_free (info);
+        }
+        else
+        {
+            char *id = module_info_get_id (info);
+            char *load_on = g_strjoinv (";", info->load_on);
+            _moo_plugin_stats_deferred (id, load_on);
+            g_free (load_on);
+            g_free (id);
+        }
+    }
 }
 
 
@@ -48,6 +48,24 @@ MooPluginLoader *moo_plugin_loader_lookup   (const char             *type);
 void             _moo_plugin_load           (const char             *dir,
                                              const char             *ini_file);
 void             _moo_plugin_finish_load    (void);
+void             _moo_plugin_loader_shutdown (void);
+
+/* Modules whose ini file has a load-on key are loaded on first use,
+ * see mooplugin-loader.c. These add and remove placeholders and check
+ * the language triggers. */
+void             _moo_plugin_loader_attach_win (MooEditWindow       *window);
+void             _moo_plugin_loader_detach_win (MooEditWindow       *window);
+void             _moo_plugin_loader_lang_used (const char           *lang_id);
+/* loads modules of plugins disabled in preferences, so that they
+ * can be enabled again */
+void             _moo_plugin_loader_load_disabled (void);
+
+/* startup cost of plugins, reported by _moo_plugin_get_stats() */
+void             _moo_plugin_stats_deferred (const char             *id,
+                                             const char             *load_on);
+void             _moo_plugin_stats_loaded   (const char             *id,
+                                             const char             *trigger,
+                                             gint64                  usec);
 
 
 G_END_DECLS
@@ -39,6 +39,7 @@
 
 #include "mooedit/mooplugin.h"
 #include "mooedit/mooplugin-loader.h"
+#include "mooedit/mooedit-impl.h"
 #include "mooedit/moopluginprefs-gxml.h"
 #include "mooutils/mooprefsdialog.h"
 #include "mooutils/moostock.h"
@@ -46,6 +47,7 @@
 #include "mooutils/mooutils-debug.h"
 #include "mooutils/moohelp.h"
 #include "mooutils/mootype-macros.h"
+#include "mooutils/mootrace.h"
 #ifdef MOO_ENABLE_HELP
 #include "moo-help-sections.h"
 #endif
@@ -60,14 +62,24 @@
 #define PLUGIN_PREFS_ENABLED "enabled"
 
 
+typedef struct {
+    char *trigger;          /* what loaded the module, NULL for built-in plugins */
+    char *load_on;          /* set while the module waits to be loaded */
+    gint64 load_time;       /* microseconds, including init and attach */
+    gint64 init_time;
+    gint64 attach_time;
+} PluginStats;
+
 typedef struct {
     MooEditor *editor;
     GSList *list; /* MooPlugin* */
     GHashTable *names;
+    GHashTable *stats; /* id -> PluginStats* */
     char **dirs;
     gboolean dirs_read;
     GQuark plugin_quark;
     GQuark meths_quark;
+    GQuark pending_quark;
 } PluginStore;
 
 static PluginStore *plugin_store = NULL;
@@ -115,6 +127,8 @@ static void     doc_set_plugin          (MooEdit        *doc,
                                          MooDocPlugin   *doc_plugin);
 
 static gboolean moo_plugin_registered   (GType           type);
+static PluginStats *plugin_stats_get    (const char     *id);
+static void     doc_ensure_plugins      (MooEdit        *doc);
 
 
 static gpointer parent_class = NULL;
@@ -313,6 +327,8 @@ static gboolean
 plugin_init (MooPlugin *plugin)
 {
     MooPluginClass *klass;
+    gboolean success;
+    gint64 start;
 
     g_return_val_if_fail (MOO_IS_PLUGIN (plugin), FALSE);
 
@@ -320,16 +336,18 @@ plugin_init (MooPlugin *plugin)
         return TRUE;
 
     klass = MOO_PLUGIN_GET_CLASS (plugin);
+    start = g_get_monotonic_time ();
 
-    if (!klass->init || klass->init (plugin))
-    {
+    MOO_TRACE_BEGIN_DETAIL ("plugin init", moo_plugin_id (plugin));
+    success = !klass->init || klass->init (plugin);
+    MOO_TRACE_END ("plugin init");
+
+    plugin_stats_get (moo_plugin_id (plugin))->init_time += g_get_monotonic_time () - start;
+
+    if (success)
         plugin->initialized = TRUE;
-        return TRUE;
-    }
-    else
-    {
-        return FALSE;
-    }
+
+    return success;
 }
 
 
@@ -362,6 +380,7 @@ plugin_attach_win (MooPlugin      *plugin,
     GType wtype;
     MooEditArray *docs;
     guint i;
+    gint64 start;
 
     g_return_if_fail (MOO_IS_EDIT_WINDOW (window));
     g_return_if_fail (MOO_IS_PLUGIN (plugin));
@@ -370,6 +389,7 @@ plugin_attach_win (MooPlugin      *plugin,
         return;
 
     klass = MOO_PLUGIN_GET_CLASS (plugin);
+    start = g_get_monotonic_time ();
 
     if (klass->attach_win)
         klass->attach_win (plugin, window);
@@ -391,6 +411,8 @@ plugin_attach_win (MooPlugin      *plugin,
             g_object_unref (win_plugin);
     }
 
+    plugin_stats_get (moo_plugin_id (plugin))->attach_time += g_get_monotonic_time () - start;
+
     docs = moo_edit_window_get_docs (window);
     for (i = 0; i < docs->n_elms; ++i)
         plugin_attach_doc (plugin, window, docs->elms[i]);
@@ -448,6 +470,7 @@ plugin_attach_doc (MooPlugin      *plugin,
     MooDocPluginClass *dklass;
     MooDocPlugin *doc_plugin;
     GType dtype;
+    gint64 start;
 
     g_return_if_fail (!window || MOO_IS_EDIT_WINDOW (window));
     g_return_if_fail (MOO_IS_EDIT (doc));
@@ -456,6 +479,12 @@ plugin_attach_doc (MooPlugin      *plugin,
     if (!moo_plugin_enabled (plugin))
         return;
 
+    /* a document waiting for its text gets all plugins at once,
+     * see _moo_doc_attach_plugins() */
+    if (g_object_get_qdata (G_OBJECT (doc), plugin_store->pending_quark))
+        return;
+
+    start = g_get_monotonic_time ();
     plugin->docs = g_slist_prepend (plugin->docs, doc);
 
     klass = MOO_PLUGIN_GET_CLASS (plugin);
@@ -480,6 +509,8 @@ plugin_attach_doc (MooPlugin      *plugin,
         else
             g_object_unref (doc_plugin);
     }
+
+    plugin_stats_get (moo_plugin_id (plugin))->attach_time += g_get_monotonic_time () - start;
 }
 
 
@@ -568,6 +599,15 @@ doc_set_plugin (MooEdit        *doc,
 }
 
 
+static void
+plugin_stats_free (PluginStats *stats)
+{
+    g_free (stats->trigger);
+    g_free (stats->load_on);
+    g_free (stats);
+}
+
+
 static void
 plugin_store_init (void)
 {
@@ -578,8 +618,11 @@ plugin_store_init (void)
         store.editor = moo_editor_instance ();
         store.list = NULL;
         store.names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        store.stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) plugin_stats_free);
         store.plugin_quark = g_quark_from_static_string ("moo-plugin");
         store.meths_quark = g_quark_from_static_string ("moo-plugin-methods");
+        store.pending_quark = g_quark_from_static_string ("moo-plugins-pending");
 
         plugin_store = &store;
     }
@@ -655,6 +698,8 @@ moo_doc_plugin_lookup (const char     *plugin_id,
     g_return_val_if_fail (plugin_id != NULL, NULL);
     g_return_val_if_fail (MOO_IS_EDIT (doc), NULL);
 
+    doc_ensure_plugins (doc);
+
     plugin = moo_plugin_lookup (plugin_id);
     return plugin ? doc_get_plugin (doc, plugin) : NULL;
 }
@@ -954,6 +999,8 @@ moo_plugin_read_dirs (void)
 
     plugin_store->dirs_read = TRUE;
 
+    MOO_TRACE_BEGIN ("plugins load");
+
     dirs = moo_get_data_and_lib_subdirs (MOO_PLUGIN_DIR_BASENAME);
     g_strfreev (plugin_store->dirs);
     plugin_store->dirs = _moo_strv_reverse (dirs);
@@ -962,6 +1009,8 @@ moo_plugin_read_dirs (void)
         moo_plugin_read_dir (*d);
 
     _moo_plugin_finish_load ();
+
+    MOO_TRACE_END ("plugins load");
 }
 
 
@@ -973,6 +1022,8 @@ moo_plugin_shutdown (void)
     if (!plugin_store || !plugin_store->dirs_read)
         return;
 
+    _moo_plugin_loader_shutdown ();
+
     list = g_slist_copy (plugin_store->list);
     g_slist_foreach (list, (GFunc) g_object_ref, NULL);
 
@@ -995,6 +1046,8 @@ moo_plugin_shutdown (void)
 
     g_hash_table_destroy (plugin_store->names);
     plugin_store->names = NULL;
+    g_hash_table_destroy (plugin_store->stats);
+    plugin_store->stats = NULL;
 
     g_strfreev (plugin_store->dirs);
     plugin_store->dirs = NULL;
@@ -1014,6 +1067,8 @@ _moo_window_attach_plugins (MooEditWindow *window)
 
     for (l = plugin_store->list; l != NULL; l = l->next)
         plugin_attach_win (l->data, window);
+
+    _moo_plugin_loader_attach_win (window);
 }
 
 
@@ -1026,24 +1081,63 @@ _moo_window_detach_plugins (MooEditWindow *window)
 
     plugin_store_init ();
 
+    _moo_plugin_loader_detach_win (window);
+
     for (l = plugin_store->list; l != NULL; l = l->next)
         plugin_detach_win (l->data, window);
 }
 
 
+static void
+doc_attach_plugins (MooEditWindow *window,
+                    MooEdit       *doc)
+{
+    GSList *l;
+    char *lang_id;
+
+    for (l = plugin_store->list; l != NULL; l = l->next)
+        plugin_attach_doc (l->data, window, doc);
+
+    lang_id = moo_edit_get_lang_id (doc);
+    _moo_plugin_loader_lang_used (lang_id);
+    g_free (lang_id);
+}
+
+/* Documents restored from a session are not loaded until they are
+ * shown (see _moo_edit_ensure_loaded()), plugins are attached to them
+ * at that point too, or when somebody asks for a document plugin. */
 void
 _moo_doc_attach_plugins (MooEditWindow *window,
                          MooEdit       *doc)
 {
-    GSList *l;
-
     g_return_if_fail (!window || MOO_IS_EDIT_WINDOW (window));
     g_return_if_fail (MOO_IS_EDIT (doc));
 
     plugin_store_init ();
 
-    for (l = plugin_store->list; l != NULL; l = l->next)
-        plugin_attach_doc (l->data, window, doc);
+    if (window && _moo_edit_is_load_pending (doc))
+        g_object_set_qdata (G_OBJECT (doc), plugin_store->pending_quark, window);
+    else
+        doc_attach_plugins (window, doc);
+}
+
+
+static void
+doc_ensure_plugins (MooEdit *doc)
+{
+    MooEditWindow *window;
+
+    plugin_store_init ();
+
+    if ((window = g_object_steal_qdata (G_OBJECT (doc), plugin_store->pending_quark)))
+        doc_attach_plugins (window, doc);
+}
+
+void
+_moo_doc_ensure_plugins (MooEdit *doc)
+{
+    g_return_if_fail (MOO_IS_EDIT (doc));
+    doc_ensure_plugins (doc);
 }
 
 
@@ -1058,11 +1152,121 @@ _moo_doc_detach_plugins (MooEditWindow *window,
 
     plugin_store_init ();
 
+    if (g_object_steal_qdata (G_OBJECT (doc), plugin_store->pending_quark))
+        return;
+
     for (l = plugin_store->list; l != NULL; l = l->next)
         plugin_detach_doc (l->data, window, doc);
 }
 
 
+void
+_moo_doc_plugins_lang_changed (MooEdit *doc)
+{
+    char *lang_id;
+
+    g_return_if_fail (MOO_IS_EDIT (doc));
+
+    plugin_store_init ();
+
+    if (g_object_get_qdata (G_OBJECT (doc), plugin_store->pending_quark))
+        return;
+
+    lang_id = moo_edit_get_lang_id (doc);
+    _moo_plugin_loader_lang_used (lang_id);
+    g_free (lang_id);
+}
+
+
+static PluginStats *
+plugin_stats_get (const char *id)
+{
+    PluginStats *stats;
+
+    plugin_store_init ();
+
+    if (!(stats = g_hash_table_lookup (plugin_store->stats, id)))
+    {
+        stats = g_new0 (PluginStats, 1);
+        g_hash_table_insert (plugin_store->stats, g_strdup (id), stats);
+    }
+
+    return stats;
+}
+
+void
+_moo_plugin_stats_deferred (const char *id,
+                            const char *load_on)
+{
+    PluginStats *stats;
+
+    g_return_if_fail (id != NULL);
+
+    stats = plugin_stats_get (id);
+    MOO_ASSIGN_STRING (stats->load_on, load_on);
+}
+
+void
+_moo_plugin_stats_loaded (const char *id,
+                          const char *trigger,
+                          gint64      usec)
+{
+    PluginStats *stats;
+
+    g_return_if_fail (id != NULL && trigger != NULL);
+
+    stats = plugin_stats_get (id);
+    MOO_ASSIGN_STRING (stats->trigger, trigger);
+    MOO_ASSIGN_STRING (stats->load_on, NULL);
+    stats->load_time += usec;
+}
+
+/**
+ * _moo_plugin_get_stats:
+ *
+ * Returns: what each plugin cost so far and when it was loaded, one
+ * plugin per line.
+ */
+char *
+_moo_plugin_get_stats (void)
+{
+    GString *text;
+    GList *ids, *l;
+
+    plugin_store_init ();
+
+    text = g_string_new (NULL);
+    ids = g_list_sort (g_hash_table_get_keys (plugin_store->stats), (GCompareFunc) strcmp);
+
+    for (l = ids; l != NULL; l = l->next)
+    {
+        const char *id = l->data;
+        PluginStats *stats = g_hash_table_lookup (plugin_store->stats, id);
+
+        if (stats->load_on)
+        {
+            g_string_append_printf (text, "%s: not loaded, load-on %s\n", id, stats->load_on);
+            continue;
+        }
+
+        g_string_append_printf (text, "%s: ", id);
+
+        if (stats->trigger)
+            g_string_append_printf (text, "loaded on %s, load %.2f ms, ",
+                                    stats->trigger, stats->load_time / 1000.);
+        else
+            g_string_append (text, "built-in, ");
+
+        g_string_append_printf (text, "init %.2f ms, attach %.2f ms\n",
+                                stats->init_time / 1000.,
+                                stats->attach_time / 1000.);
+    }
+
+    g_list_free (ids);
+    return g_string_free (text, FALSE);
+}
+
+
 static gboolean
 moo_plugin_visible (MooPlugin *plugin)
 {
@@ -1330,6 +1534,9 @@ prefs_page_init (MooPrefsPage *page,
     store = GTK_LIST_STORE (model);
 
     gtk_list_store_clear (store);
+
+    /* modules of disabled plugins are not loaded until now */
+    _moo_plugin_loader_load_disabled ();
     plugins = moo_list_plugins ();
 
     for (l = plugins; l != NULL; l = l->next)
@@ -254,6 +254,10 @@ void        _moo_doc_attach_plugins     (MooEditWindow  *window,
                                          MooEdit        *doc);
 void        _moo_doc_detach_plugins     (MooEditWindow  *window,
                                          MooEdit        *doc);
+void        _moo_doc_ensure_plugins     (MooEdit        *doc);
+void        _moo_doc_plugins_lang_changed (MooEdit      *doc);
+
+char       *_moo_plugin_get_stats       (void);
 
 void         moo_plugin_attach_prefs    (GtkWidget      *prefs_dialog);
 
@@ -56,6 +56,22 @@ gboolean    _moo_text_buffer_is_bracket_tag         (MooTextBuffer      *buffer,
                                                      GtkTextTag         *tag);
 void        _moo_text_buffer_set_style_scheme       (MooTextBuffer      *buffer,
                                                      MooTextStyleScheme *scheme);
+const BTLineWs *_moo_text_buffer_get_line_whitespace (MooTextBuffer     *buffer,
+                                                     int                 line);
+/* Replaces beginnings of lines in one go, e.g. to change indentation of a
+ * block. old_text and new_text hold a prefix for each of n_lines lines,
+ * followed by '\n'; old_text must match the text. Undo records it as a
+ * single action. */
+void        _moo_text_buffer_replace_line_prefixes  (MooTextBuffer      *buffer,
+                                                     int                 first_line,
+                                                     int                 n_lines,
+                                                     const char         *old_text,
+                                                     const char         *new_text);
+/* Words of the buffer are added to the word completion index
+ * (see moowordindex.h) while it's enabled. */
+void        _moo_text_buffer_set_word_index         (MooTextBuffer      *buffer,
+                                                     gboolean            enable);
+gboolean    _moo_text_buffer_get_word_index         (MooTextBuffer      *buffer);
 
 
 G_END_DECLS
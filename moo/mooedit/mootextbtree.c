@@ -174,6 +174,7 @@ bt_data_free (BTData  *data,
         }
 
         g_free (data->marks);
+        g_free (data->ws);
         g_slice_free (BTData, data);
     }
 }
@@ -49,11 +49,19 @@ struct BTNode {
     guint count : (30 - BTREE_NODE_EXP);
 };
 
+/* whitespace characters in a line, cached for drawing them */
+typedef struct {
+    guint n_chars;
+    guint n_trailing;   /* the last n_trailing chars are trailing whitespace */
+    guint32 chars[1];   /* byte index in the line << 1, | 1 for a tab */
+} BTLineWs;
+
 struct BTData {
     BTNode *parent;
     guint n_marks;
 
     struct MooLineMark **marks;
+    BTLineWs *ws;       /* NULL until computed, reset when the line changes */
 };
 
 struct BTree {
@@ -21,6 +21,7 @@
 #include "mooedit/mootext-private.h"
 #include "mooedit/moolang-private.h"
 #include "mooedit/mootextstylescheme.h"
+#include "mooedit/moowordindex.h"
 #include "marshals.h"
 #include "mooutils/mooundo.h"
 #include "mooutils/mooutils-gobject.h"
@@ -55,6 +56,10 @@ struct MooTextBufferPrivate {
     MooUndoStack *undo_stack;
     gpointer modifying_action;
     int move_cursor_to;
+    /* inside replace_line_prefixes(), which records undo and notifies
+     * the highlighting engine once for all the edits */
+    guint bulk_edit;
+    MooWordIndex *word_index;
 #if 0
     int cursor_was_at;
 #endif
@@ -104,6 +109,7 @@ static void     thaw_cursor_moved                   (MooTextBuffer      *buffer)
 
 static guint    INSERT_ACTION_TYPE;
 static guint    DELETE_ACTION_TYPE;
+static guint    INDENT_ACTION_TYPE;
 static void     init_undo_actions                   (void);
 static MooUndoAction *insert_action_new             (GtkTextBuffer      *buffer,
                                                      GtkTextIter        *pos,
@@ -430,6 +436,9 @@ moo_text_buffer_dispose (GObject *object)
         buffer->priv->line_buf = NULL;
     }
 
+    _moo_word_index_free (buffer->priv->word_index);
+    buffer->priv->word_index = NULL;
+
     g_free (buffer->priv->left_brackets);
     g_free (buffer->priv->right_brackets);
     buffer->priv->left_brackets = NULL;
@@ -564,6 +573,190 @@ get_placeholder_tag (GtkTextBuffer *text_buffer)
 }
 
 
+static void
+invalidate_line_whitespace (MooTextBuffer *buffer,
+                            int            line_no)
+{
+    Line *line = _moo_line_buffer_get_line (buffer->priv->line_buf, line_no);
+
+    if (line && line->ws)
+    {
+        g_free (line->ws);
+        line->ws = NULL;
+    }
+}
+
+
+/* Edits bigger than this are not indexed word by word, the index
+ * is rebuilt in the background instead */
+#define WORD_INDEX_SYNC_MAX 65536
+
+static char *
+get_all_text (MooTextBuffer *buffer)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &start, &end);
+    return gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &start, &end, TRUE);
+}
+
+static gboolean
+word_char_before (const GtkTextIter *iter)
+{
+    GtkTextIter prev = *iter;
+    return gtk_text_iter_backward_char (&prev) &&
+           _moo_word_index_is_word_char (gtk_text_iter_get_char (&prev));
+}
+
+/* moves start and end outwards to word boundaries */
+static void
+extend_to_words (GtkTextIter *start,
+                 GtkTextIter *end)
+{
+    while (word_char_before (start))
+        gtk_text_iter_backward_char (start);
+    while (_moo_word_index_is_word_char (gtk_text_iter_get_char (end)))
+        gtk_text_iter_forward_char (end);
+}
+
+static void
+update_word_index (MooTextBuffer     *buffer,
+                   const GtkTextIter *start,
+                   const GtkTextIter *end,
+                   gboolean           add)
+{
+    char *text;
+
+    if (gtk_text_iter_equal (start, end))
+        return;
+
+    text = gtk_text_iter_get_text (start, end);
+
+    if (add)
+        _moo_word_index_add_text (buffer->priv->word_index, text, -1);
+    else
+        _moo_word_index_remove_text (buffer->priv->word_index, text, -1);
+
+    g_free (text);
+}
+
+void
+_moo_text_buffer_set_word_index (MooTextBuffer *buffer,
+                                 gboolean       enable)
+{
+    g_return_if_fail (MOO_IS_TEXT_BUFFER (buffer));
+
+    if (!enable == !buffer->priv->word_index)
+        return;
+
+    if (enable)
+    {
+        buffer->priv->word_index =
+            _moo_word_index_new ((MooWordIndexTextFunc) get_all_text, buffer);
+        if (moo_text_buffer_has_text (buffer))
+            _moo_word_index_rebuild (buffer->priv->word_index);
+    }
+    else
+    {
+        _moo_word_index_free (buffer->priv->word_index);
+        buffer->priv->word_index = NULL;
+    }
+}
+
+gboolean
+_moo_text_buffer_get_word_index (MooTextBuffer *buffer)
+{
+    g_return_val_if_fail (MOO_IS_TEXT_BUFFER (buffer), FALSE);
+    return buffer->priv->word_index != NULL;
+}
+
+
+/* Finds whitespace characters in one pass over the bytes, only
+ * non-ASCII characters need to be decoded. Returns the number of
+ * them, fills chars if it's not NULL. */
+static guint
+scan_line_whitespace (const char *text,
+                      gsize       len,
+                      guint32    *chars,
+                      guint      *n_trailing)
+{
+    guint n = 0;
+    guint n_before_trailing = 0;
+    gsize i = 0;
+
+    while (i < len)
+    {
+        guchar c = text[i];
+        gboolean space;
+        gsize next;
+
+        if (c < 0x80)
+        {
+            space = c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+            next = i + 1;
+        }
+        else
+        {
+            space = g_unichar_isspace (g_utf8_get_char (text + i));
+            next = g_utf8_next_char (text + i) - text;
+        }
+
+        if (space)
+        {
+            if (chars)
+                chars[n] = (guint32) (i << 1) | (c == '\t' ? 1 : 0);
+            n++;
+        }
+        else
+        {
+            n_before_trailing = n;
+        }
+
+        i = next;
+    }
+
+    if (n_trailing)
+        *n_trailing = n - n_before_trailing;
+
+    return n;
+}
+
+const BTLineWs *
+_moo_text_buffer_get_line_whitespace (MooTextBuffer *buffer,
+                                      int            line_no)
+{
+    Line *line;
+
+    g_return_val_if_fail (MOO_IS_TEXT_BUFFER (buffer), NULL);
+
+    line = _moo_line_buffer_get_line (buffer->priv->line_buf, line_no);
+    g_return_val_if_fail (line != NULL, NULL);
+
+    if (!line->ws)
+    {
+        GtkTextIter start, end;
+        char *text;
+        gsize len;
+        guint n;
+
+        gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (buffer), &start, line_no);
+        end = start;
+        if (!gtk_text_iter_ends_line (&end))
+            gtk_text_iter_forward_to_line_end (&end);
+
+        text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (buffer), &start, &end, TRUE);
+        len = strlen (text);
+
+        n = scan_line_whitespace (text, len, NULL, NULL);
+        line->ws = g_malloc (G_STRUCT_OFFSET (BTLineWs, chars) + MAX (n, 1) * sizeof (guint32));
+        line->ws->n_chars = scan_line_whitespace (text, len, line->ws->chars, &line->ws->n_trailing);
+
+        g_free (text);
+    }
+
+    return line->ws;
+}
+
+
 static void
 moo_text_buffer_insert_text (GtkTextBuffer      *text_buffer,
                              GtkTextIter        *pos,
@@ -575,6 +768,8 @@ moo_text_buffer_insert_text (GtkTextBuffer      *text_buffer,
     int first_line, last_line;
     int start_offset, end_offset;
     gboolean starts_line, ins_line;
+    gboolean index_words;
+    int word_start = 0;
 
     if (!text[0])
         return;
@@ -598,7 +793,7 @@ moo_text_buffer_insert_text (GtkTextBuffer      *text_buffer,
         gtk_text_buffer_remove_tag (text_buffer, tag, &tag_start, &tag_end);
     }
 
-    if (!moo_undo_stack_frozen (buffer->priv->undo_stack))
+    if (!buffer->priv->bulk_edit && !moo_undo_stack_frozen (buffer->priv->undo_stack))
     {
         MooUndoAction *action;
         action = insert_action_new (text_buffer, pos, text, length);
@@ -607,6 +802,18 @@ moo_text_buffer_insert_text (GtkTextBuffer      *text_buffer,
 
     moo_text_buffer_unhighlight_brackets (buffer);
 
+    /* changes made by replace_line_prefixes() do not touch words */
+    index_words = buffer->priv->word_index && !buffer->priv->bulk_edit;
+
+    if (index_words && length <= WORD_INDEX_SYNC_MAX)
+    {
+        /* the word at pos may be split or extended */
+        GtkTextIter word_end = *pos, iter = *pos;
+        extend_to_words (&iter, &word_end);
+        update_word_index (buffer, &iter, &word_end, FALSE);
+        word_start = gtk_text_iter_get_offset (&iter);
+    }
+
     GTK_TEXT_BUFFER_CLASS(moo_text_buffer_parent_class)->insert_text (text_buffer, pos, text, length);
 
     last_line = gtk_text_iter_get_line (pos);
@@ -615,6 +822,9 @@ moo_text_buffer_insert_text (GtkTextBuffer      *text_buffer,
         _moo_line_buffer_split_line (buffer->priv->line_buf,
                                      first_line, last_line - first_line);
 
+    /* lines after the first one are new */
+    invalidate_line_whitespace (buffer, first_line);
+
     /* XXX btree can do it better ? i guess it can't */
     if (starts_line && ins_line)
     {
@@ -629,9 +839,21 @@ moo_text_buffer_insert_text (GtkTextBuffer      *text_buffer,
 
     end_offset = gtk_text_iter_get_offset (pos);
 
-    if (buffer->priv->engine)
+    if (buffer->priv->engine && !buffer->priv->bulk_edit)
         _gtk_source_engine_text_inserted (buffer->priv->engine, start_offset, end_offset);
 
+    if (index_words && length > WORD_INDEX_SYNC_MAX)
+    {
+        _moo_word_index_rebuild (buffer->priv->word_index);
+    }
+    else if (index_words)
+    {
+        GtkTextIter iter, word_end = *pos;
+        gtk_text_buffer_get_iter_at_offset (text_buffer, &iter, word_start);
+        extend_to_words (&iter, &word_end);
+        update_word_index (buffer, &iter, &word_end, TRUE);
+    }
+
     if (!buffer->priv->has_text)
     {
         buffer->priv->has_text = TRUE;
@@ -680,6 +902,7 @@ moo_text_buffer_delete_range (GtkTextBuffer      *text_buffer,
     gboolean starts_line;
     GSList *deleted_marks = NULL, *moved_marks = NULL;
     GtkTextTag *tag;
+    gboolean index_words;
 
     gtk_text_iter_order (start, end);
 
@@ -718,13 +941,22 @@ moo_text_buffer_delete_range (GtkTextBuffer      *text_buffer,
     }
 #undef MANY_LINES
 
-    if (!moo_undo_stack_frozen (buffer->priv->undo_stack))
+    if (!buffer->priv->bulk_edit && !moo_undo_stack_frozen (buffer->priv->undo_stack))
     {
         MooUndoAction *action;
         action = delete_action_new (text_buffer, start, end);
         moo_undo_stack_add_action (buffer->priv->undo_stack, DELETE_ACTION_TYPE, action);
     }
 
+    index_words = buffer->priv->word_index && !buffer->priv->bulk_edit;
+
+    if (index_words && length <= WORD_INDEX_SYNC_MAX)
+    {
+        GtkTextIter word_start = *start, word_end = *end;
+        extend_to_words (&word_start, &word_end);
+        update_word_index (buffer, &word_start, &word_end, FALSE);
+    }
+
     GTK_TEXT_BUFFER_CLASS(moo_text_buffer_parent_class)->delete_range (text_buffer, start, end);
 
     if (first_line < last_line)
@@ -742,6 +974,20 @@ moo_text_buffer_delete_range (GtkTextBuffer      *text_buffer,
                                      &moved_marks, &deleted_marks);
     }
 
+    invalidate_line_whitespace (buffer, first_line);
+
+    if (index_words && length > WORD_INDEX_SYNC_MAX)
+    {
+        _moo_word_index_rebuild (buffer->priv->word_index);
+    }
+    else if (index_words)
+    {
+        /* words around start may be joined now */
+        GtkTextIter word_start = *start, word_end = *start;
+        extend_to_words (&word_start, &word_end);
+        update_word_index (buffer, &word_start, &word_end, TRUE);
+    }
+
     /* It would be better if marks were moved/deleted before deleting text, but it
        could cause problems with invalidated iters. if they were deleted after
        deleting text, it would be even worse since our btree and gtk btree would not
@@ -761,11 +1007,92 @@ moo_text_buffer_delete_range (GtkTextBuffer      *text_buffer,
             g_object_notify (G_OBJECT (buffer), "has-text");
     }
 
-    if (buffer->priv->engine != NULL)
+    if (buffer->priv->engine != NULL && !buffer->priv->bulk_edit)
         _gtk_source_engine_text_deleted (buffer->priv->engine, offset, length);
 }
 
 
+/* Replaces beginnings of n_lines lines starting at first_line. old_text
+ * and new_text hold a prefix for every line, each followed by '\n'. */
+static void
+replace_line_prefixes (MooTextBuffer *buffer,
+                       int            first_line,
+                       int            n_lines,
+                       const char    *old_text,
+                       const char    *new_text)
+{
+    GtkTextBuffer *text_buffer = GTK_TEXT_BUFFER (buffer);
+    GtkTextIter iter, end;
+    int start_offset, old_end_offset, new_end_offset;
+    gboolean changed = FALSE;
+    int i;
+
+    gtk_text_buffer_get_iter_at_line (text_buffer, &end, first_line + n_lines - 1);
+    if (!gtk_text_iter_ends_line (&end))
+        gtk_text_iter_forward_to_line_end (&end);
+    old_end_offset = gtk_text_iter_get_offset (&end);
+
+    gtk_text_buffer_get_iter_at_line (text_buffer, &iter, first_line);
+    start_offset = gtk_text_iter_get_offset (&iter);
+
+    buffer->priv->bulk_edit++;
+    freeze_cursor_moved (buffer);
+
+    for (i = 0; i < n_lines; ++i)
+    {
+        const char *old_end = strchr (old_text, '\n');
+        const char *new_end = strchr (new_text, '\n');
+        gsize old_len, new_len;
+
+        if (!old_end || !new_end)
+        {
+            g_critical ("oops");
+            break;
+        }
+
+        old_len = old_end - old_text;
+        new_len = new_end - new_text;
+
+        if (old_len != new_len || strncmp (old_text, new_text, old_len) != 0)
+        {
+            if (old_len)
+            {
+                end = iter;
+                gtk_text_iter_forward_chars (&end, g_utf8_strlen (old_text, old_len));
+                gtk_text_buffer_delete (text_buffer, &iter, &end);
+            }
+
+            if (new_len)
+                gtk_text_buffer_insert (text_buffer, &iter, new_text, new_len);
+
+            changed = TRUE;
+        }
+
+        old_text = old_end + 1;
+        new_text = new_end + 1;
+        gtk_text_iter_forward_line (&iter);
+    }
+
+    buffer->priv->bulk_edit--;
+
+    if (changed && buffer->priv->engine)
+    {
+        gtk_text_buffer_get_iter_at_line (text_buffer, &end, first_line + n_lines - 1);
+        if (!gtk_text_iter_ends_line (&end))
+            gtk_text_iter_forward_to_line_end (&end);
+        new_end_offset = gtk_text_iter_get_offset (&end);
+
+        if (old_end_offset > start_offset)
+            _gtk_source_engine_text_deleted (buffer->priv->engine, start_offset,
+                                             old_end_offset - start_offset);
+        if (new_end_offset > start_offset)
+            _gtk_source_engine_text_inserted (buffer->priv->engine, start_offset, new_end_offset);
+    }
+
+    thaw_cursor_moved (buffer);
+}
+
+
 #if 0
 static void
 before_undo_redo (MooTextBuffer *buffer)
@@ -1557,7 +1884,8 @@ moo_text_iter_find_matching_bracket (GtkTextIter *iter,
 
 typedef enum {
     ACTION_INSERT,
-    ACTION_DELETE
+    ACTION_DELETE,
+    ACTION_INDENT
 } ActionType;
 
 typedef struct {
@@ -1580,6 +1908,14 @@ typedef struct {
     guint forward : 1;
 } DeleteAction;
 
+/* edit.text holds the old line prefixes, see replace_line_prefixes() */
+typedef struct {
+    EditAction edit;
+    char *new_text;
+    int first_line;
+    int n_lines;
+} IndentAction;
+
 #define EDIT_ACTION(action__)           ((EditAction*)action__)
 #define ACTION_INTERACTIVE(action__)    (((EditAction*)action__)->interactive)
 
@@ -1602,18 +1938,42 @@ static gboolean delete_action_merge     (DeleteAction   *action,
                                          DeleteAction   *what,
                                          MooTextBuffer  *buffer);
 
+static gsize    insert_action_size      (InsertAction   *action);
+static gsize    delete_action_size      (DeleteAction   *action);
+
+static void     indent_action_undo      (IndentAction   *action,
+                                         GtkTextBuffer  *buffer);
+static void     indent_action_redo      (IndentAction   *action,
+                                         GtkTextBuffer  *buffer);
+static gboolean indent_action_merge     (IndentAction   *action,
+                                         IndentAction   *what,
+                                         MooTextBuffer  *buffer);
+static void     indent_action_destroy   (IndentAction   *action,
+                                         MooTextBuffer  *buffer);
+static gsize    indent_action_size      (IndentAction   *action);
+
 static MooUndoActionClass InsertActionClass = {
     (MooUndoActionUndo) insert_action_undo,
     (MooUndoActionRedo) insert_action_redo,
     (MooUndoActionMerge) insert_action_merge,
-    (MooUndoActionDestroy) edit_action_destroy
+    (MooUndoActionDestroy) edit_action_destroy,
+    (MooUndoActionSize) insert_action_size
 };
 
 static MooUndoActionClass DeleteActionClass = {
     (MooUndoActionUndo) delete_action_undo,
     (MooUndoActionRedo) delete_action_redo,
     (MooUndoActionMerge) delete_action_merge,
-    (MooUndoActionDestroy) edit_action_destroy
+    (MooUndoActionDestroy) edit_action_destroy,
+    (MooUndoActionSize) delete_action_size
+};
+
+static MooUndoActionClass IndentActionClass = {
+    (MooUndoActionUndo) indent_action_undo,
+    (MooUndoActionRedo) indent_action_redo,
+    (MooUndoActionMerge) indent_action_merge,
+    (MooUndoActionDestroy) indent_action_destroy,
+    (MooUndoActionSize) indent_action_size
 };
 
 
@@ -1622,6 +1982,7 @@ init_undo_actions (void)
 {
     INSERT_ACTION_TYPE = moo_undo_action_register (&InsertActionClass);
     DELETE_ACTION_TYPE = moo_undo_action_register (&DeleteActionClass);
+    INDENT_ACTION_TYPE = moo_undo_action_register (&IndentActionClass);
 }
 
 
@@ -1641,6 +2002,9 @@ action_new (ActionType     type,
         case ACTION_DELETE:
             size = sizeof (DeleteAction);
             break;
+        case ACTION_INDENT:
+            size = sizeof (IndentAction);
+            break;
     }
 
     g_assert (size != 0);
@@ -1846,6 +2210,118 @@ edit_action_destroy (EditAction    *action,
 }
 
 
+static gsize
+insert_action_size (InsertAction *action)
+{
+    return sizeof *action + action->length;
+}
+
+
+static gsize
+delete_action_size (DeleteAction *action)
+{
+    return sizeof *action + strlen (action->edit.text);
+}
+
+
+static void
+indent_action_undo_or_redo (IndentAction  *action,
+                            GtkTextBuffer *buffer,
+                            const char    *old_text,
+                            const char    *new_text)
+{
+    gboolean was_modified;
+
+    was_modified = gtk_text_buffer_get_modified (buffer);
+
+    replace_line_prefixes (MOO_TEXT_BUFFER (buffer), action->first_line,
+                           action->n_lines, old_text, new_text);
+
+    if (ACTION_INTERACTIVE (action))
+    {
+        GtkTextIter iter;
+        gtk_text_buffer_get_iter_at_line (buffer, &iter, action->first_line);
+        MOO_TEXT_BUFFER(buffer)->priv->move_cursor_to = gtk_text_iter_get_offset (&iter);
+    }
+
+    action_undo_or_redo (EDIT_ACTION (action), buffer, was_modified);
+}
+
+
+static void
+indent_action_undo (IndentAction  *action,
+                    GtkTextBuffer *buffer)
+{
+    indent_action_undo_or_redo (action, buffer, action->new_text, action->edit.text);
+}
+
+
+static void
+indent_action_redo (IndentAction  *action,
+                    GtkTextBuffer *buffer)
+{
+    indent_action_undo_or_redo (action, buffer, action->edit.text, action->new_text);
+}
+
+
+static gboolean
+indent_action_merge (G_GNUC_UNUSED IndentAction  *action,
+                     G_GNUC_UNUSED IndentAction  *what,
+                     G_GNUC_UNUSED MooTextBuffer *buffer)
+{
+    return FALSE;
+}
+
+
+static void
+indent_action_destroy (IndentAction  *action,
+                       MooTextBuffer *buffer)
+{
+    if (action)
+    {
+        g_free (action->new_text);
+        edit_action_destroy (EDIT_ACTION (action), buffer);
+    }
+}
+
+
+static gsize
+indent_action_size (IndentAction *action)
+{
+    return sizeof *action + strlen (action->edit.text) + strlen (action->new_text);
+}
+
+
+void
+_moo_text_buffer_replace_line_prefixes (MooTextBuffer *buffer,
+                                        int            first_line,
+                                        int            n_lines,
+                                        const char    *old_text,
+                                        const char    *new_text)
+{
+    g_return_if_fail (MOO_IS_TEXT_BUFFER (buffer));
+    g_return_if_fail (old_text != NULL && new_text != NULL);
+    g_return_if_fail (first_line >= 0 && n_lines > 0);
+    g_return_if_fail (first_line + n_lines <= gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (buffer)));
+
+    if (!moo_undo_stack_frozen (buffer->priv->undo_stack))
+    {
+        IndentAction *action;
+
+        action = (IndentAction*) action_new (ACTION_INDENT, buffer);
+        action->edit.text = g_strdup (old_text);
+        action->new_text = g_strdup (new_text);
+        action->first_line = first_line;
+        action->n_lines = n_lines;
+
+        moo_undo_stack_add_action (buffer->priv->undo_stack, INDENT_ACTION_TYPE,
+                                   (MooUndoAction*) action);
+    }
+
+    replace_line_prefixes (buffer, first_line, n_lines, old_text, new_text);
+}
+
+
 static gboolean
 action_merge (EditAction     *last_action,
               EditAction     *action,
@@ -59,6 +59,13 @@ MOO_DEBUG_INIT (printing, FALSE)
 
 #define PRINT_SETTINGS_FILE             "printsettings.ini"
 
+/* pagination is done in slices of this many seconds, so that the
+ * main loop keeps running while a long document is paginated */
+#define PAGINATE_TIME_SLICE             0.02
+#define PAGINATE_CHUNK_LINES            256
+
+#define LINE_HEIGHTS_KEY                "moo-print-line-heights"
+
 
 typedef struct {
     double x;
@@ -91,6 +98,12 @@ struct MooPrintOperationPrivate {
     PangoLayout *ln_layout;
 
     Page page;              /* text area */
+
+    /* pagination state */
+    struct LineHeights *heights;
+    int pg_offset;          /* where pagination continues */
+    int pg_end_offset;
+    double pg_height;       /* height of text on the current page */
 };
 
 
@@ -131,6 +144,8 @@ static void moo_print_operation_get_property(GObject            *object,
                                              GValue             *value,
                                              GParamSpec         *pspec);
 
+static gboolean moo_print_operation_paginate (GtkPrintOperation  *operation,
+                                              GtkPrintContext    *context);
 static void moo_print_operation_begin_print (GtkPrintOperation  *operation,
                                              GtkPrintContext    *context);
 static void moo_print_operation_draw_page   (GtkPrintOperation  *operation,
@@ -407,6 +422,7 @@ _moo_print_operation_class_init (MooPrintOperationClass *klass)
     object_class->get_property = moo_print_operation_get_property;
 
     print_class->begin_print = moo_print_operation_begin_print;
+    print_class->paginate = moo_print_operation_paginate;
     print_class->draw_page = moo_print_operation_draw_page;
     print_class->end_print = moo_print_operation_end_print;
     print_class->create_custom_widget = moo_print_operation_create_custom_widget;
@@ -732,16 +748,208 @@ line_number_displayed (MooPrintOperation *op,
 }
 
 
+/*****************************************************************************/
+/* Line heights
+ *
+ * Heights of printed lines are kept on the text buffer between print
+ * operations, together with the layout parameters they were measured
+ * with. Edits and tag changes invalidate heights of affected lines only.
+ */
+
+typedef struct LineHeights {
+    char *key;
+    GArray *heights;        /* gfloat for each buffer line, negative if unknown */
+    int insert_line;
+    int insert_line_count;
+} LineHeights;
+
+static void
+line_heights_free (LineHeights *lh)
+{
+    if (lh)
+    {
+        g_free (lh->key);
+        g_array_free (lh->heights, TRUE);
+        g_slice_free (LineHeights, lh);
+    }
+}
+
+static void
+line_heights_invalidate (LineHeights *lh,
+                         int          first,
+                         int          last)
+{
+    int i;
+
+    last = MIN (last, (int) lh->heights->len - 1);
+
+    for (i = MAX (first, 0); i <= last; ++i)
+        g_array_index (lh->heights, gfloat, i) = -1;
+}
+
+static void
+line_heights_insert_text (GtkTextBuffer *buffer,
+                          GtkTextIter   *where,
+                          G_GNUC_UNUSED const char *text,
+                          G_GNUC_UNUSED int len,
+                          LineHeights   *lh)
+{
+    lh->insert_line = gtk_text_iter_get_line (where);
+    lh->insert_line_count = gtk_text_buffer_get_line_count (buffer);
+}
+
 static void
-moo_print_operation_paginate (MooPrintOperation *op)
+line_heights_insert_text_after (GtkTextBuffer *buffer,
+                                G_GNUC_UNUSED GtkTextIter *where,
+                                G_GNUC_UNUSED const char *text,
+                                G_GNUC_UNUSED int len,
+                                LineHeights   *lh)
+{
+    guint added = gtk_text_buffer_get_line_count (buffer) - lh->insert_line_count;
+    guint pos = lh->insert_line + 1;
+
+    if (added > 0 && pos <= lh->heights->len)
+    {
+        guint old_len = lh->heights->len;
+        g_array_set_size (lh->heights, old_len + added);
+        memmove (&g_array_index (lh->heights, gfloat, pos + added),
+                 &g_array_index (lh->heights, gfloat, pos),
+                 (old_len - pos) * sizeof (gfloat));
+        line_heights_invalidate (lh, pos, pos + added - 1);
+    }
+
+    line_heights_invalidate (lh, lh->insert_line, lh->insert_line);
+}
+
+static void
+line_heights_delete_range (G_GNUC_UNUSED GtkTextBuffer *buffer,
+                           GtkTextIter   *start,
+                           GtkTextIter   *end,
+                           LineHeights   *lh)
+{
+    int first = gtk_text_iter_get_line (start);
+    int last = gtk_text_iter_get_line (end);
+
+    if (last > first && last < (int) lh->heights->len)
+        g_array_remove_range (lh->heights, first + 1, last - first);
+
+    line_heights_invalidate (lh, first, first);
+}
+
+static void
+line_heights_tag_changed (GtkTextBuffer *buffer,
+                          GtkTextTag    *tag,
+                          GtkTextIter   *start,
+                          GtkTextIter   *end,
+                          LineHeights   *lh)
+{
+    if (MOO_IS_TEXT_BUFFER (buffer) &&
+        _moo_text_buffer_is_bracket_tag (MOO_TEXT_BUFFER (buffer), tag))
+            return;
+
+    line_heights_invalidate (lh, gtk_text_iter_get_line (start),
+                             gtk_text_iter_get_line (end));
+}
+
+/* style scheme changes and the like, lines using the tag are not known */
+static void
+line_heights_tag_style_changed (G_GNUC_UNUSED GtkTextTagTable *table,
+                                G_GNUC_UNUSED GtkTextTag *tag,
+                                gboolean       size_changed,
+                                GtkTextBuffer *buffer)
+{
+    LineHeights *lh;
+
+    lh = (LineHeights*) g_object_get_data (G_OBJECT (buffer), LINE_HEIGHTS_KEY);
+
+    if (lh && size_changed)
+        line_heights_invalidate (lh, 0, lh->heights->len - 1);
+}
+
+static LineHeights *
+line_heights_get (GtkTextBuffer *buffer,
+                  const char    *key)
+{
+    LineHeights *lh;
+    guint n_lines;
+
+    lh = (LineHeights*) g_object_get_data (G_OBJECT (buffer), LINE_HEIGHTS_KEY);
+
+    if (!lh)
+    {
+        lh = g_slice_new0 (LineHeights);
+        lh->heights = g_array_new (FALSE, FALSE, sizeof (gfloat));
+        g_object_set_data_full (G_OBJECT (buffer), LINE_HEIGHTS_KEY, lh,
+                                (GDestroyNotify) line_heights_free);
+        g_signal_connect (buffer, "insert-text",
+                          G_CALLBACK (line_heights_insert_text), lh);
+        g_signal_connect_after (buffer, "insert-text",
+                                G_CALLBACK (line_heights_insert_text_after), lh);
+        g_signal_connect (buffer, "delete-range",
+                          G_CALLBACK (line_heights_delete_range), lh);
+        g_signal_connect (buffer, "apply-tag",
+                          G_CALLBACK (line_heights_tag_changed), lh);
+        g_signal_connect (buffer, "remove-tag",
+                          G_CALLBACK (line_heights_tag_changed), lh);
+        g_signal_connect_object (gtk_text_buffer_get_tag_table (buffer), "tag-changed",
+                                 G_CALLBACK (line_heights_tag_style_changed), buffer, 0);
+    }
+
+    n_lines = gtk_text_buffer_get_line_count (buffer);
+
+    if (!lh->key || strcmp (lh->key, key) != 0 || lh->heights->len != n_lines)
+    {
+        MOO_ASSIGN_STRING (lh->key, key);
+        g_array_set_size (lh->heights, n_lines);
+        line_heights_invalidate (lh, 0, n_lines - 1);
+    }
+
+    return lh;
+}
+
+/* everything line heights depend on */
+static char *
+get_layout_key (PangoLayout     *layout,
+                GtkPrintContext *context,
+                gboolean         use_styles)
+{
+    const PangoFontDescription *font;
+    PangoTabArray *tabs;
+    char *font_string;
+    int tab_width = 0;
+    char *key;
+
+    font = pango_layout_get_font_description (layout);
+    font_string = font ? pango_font_description_to_string (font) : NULL;
+
+    if ((tabs = pango_layout_get_tabs (layout)))
+    {
+        if (pango_tab_array_get_size (tabs) > 1)
+            pango_tab_array_get_tab (tabs, 1, NULL, &tab_width);
+        pango_tab_array_free (tabs);
+    }
+
+    key = g_strdup_printf ("%s;%g;%d;%d;%d;%d;%d",
+                           MOO_NZS (font_string),
+                           gtk_print_context_get_dpi_y (context),
+                           pango_layout_get_width (layout),
+                           (int) pango_layout_get_wrap (layout),
+                           (int) pango_layout_get_ellipsize (layout),
+                           tab_width, use_styles);
+
+    g_free (font_string);
+    return key;
+}
+
+
+static void
+paginate_start (MooPrintOperation *op,
+                GtkPrintContext   *context)
 {
     GtkTextIter iter, print_end;
-    double page_height;
-    gboolean use_styles;
-    int line_no;
+    char *key;
     int offset;
 
-    moo_dmsg ("moo_print_operation_paginate");
     moo_dmsg ("page height: %f", op->priv->page.height);
 
     if (op->priv->pages)
@@ -755,95 +963,179 @@ moo_print_operation_paginate (MooPrintOperation *op)
     gtk_text_iter_forward_line (&print_end);
     offset = gtk_text_iter_get_offset (&iter);
     g_array_append_val (op->priv->pages, offset);
-    page_height = 0;
-    line_no = op->priv->first_line;
 
-    use_styles = GET_OPTION (op, MOO_PRINT_USE_STYLES);
+    op->priv->pg_offset = offset;
+    op->priv->pg_end_offset = gtk_text_iter_get_offset (&print_end);
+    op->priv->pg_height = 0;
 
-    if (use_styles && MOO_IS_TEXT_BUFFER (op->priv->buffer))
-        _moo_text_buffer_update_highlight (MOO_TEXT_BUFFER (op->priv->buffer),
-                                           &iter, &print_end, TRUE);
+    key = get_layout_key (op->priv->layout, context, GET_OPTION (op, MOO_PRINT_USE_STYLES));
+    op->priv->heights = line_heights_get (op->priv->buffer, key);
+    g_free (key);
+}
 
-    while (gtk_text_iter_compare (&iter, &print_end) < 0)
-    {
-        GtkTextIter end;
-        double line_height;
+/* measures the line, or the rest of it, starting at iter and moves
+ * iter forward, starting a new page if needed */
+static void
+paginate_line (MooPrintOperation *op,
+               GtkTextIter       *iter)
+{
+    GtkTextIter end;
+    double line_height = -1;
+    gboolean whole_line, filled = FALSE, with_ln;
+    int line_no;
 
-        end = iter;
+    end = *iter;
+    if (!gtk_text_iter_ends_line (&end))
+        gtk_text_iter_forward_to_line_end (&end);
 
-        if (!gtk_text_iter_ends_line (&end))
-            gtk_text_iter_forward_to_line_end (&end);
+    line_no = gtk_text_iter_get_line (iter);
+    whole_line = gtk_text_iter_starts_line (iter);
+    with_ln = whole_line && line_number_displayed (op, line_no);
 
-        fill_layout (op, op->priv->layout, &iter, &end,
-                     GET_OPTION (op, MOO_PRINT_USE_STYLES));
+    if (whole_line && line_no < (int) op->priv->heights->heights->len)
+        line_height = g_array_index (op->priv->heights->heights, gfloat, line_no);
 
+    if (line_height < 0)
+    {
+        fill_layout (op, op->priv->layout, iter, &end,
+                     GET_OPTION (op, MOO_PRINT_USE_STYLES));
         get_layout_size (op->priv->layout, NULL, &line_height);
+        filled = TRUE;
+
+        if (whole_line && line_no < (int) op->priv->heights->heights->len)
+            g_array_index (op->priv->heights->heights, gfloat, line_no) = line_height;
+    }
 
-        if (line_number_displayed (op, line_no))
-            line_height = MAX (line_height, op->priv->ln_height);
+    if (with_ln)
+        line_height = MAX (line_height, op->priv->ln_height);
 
 #define EPS (.1)
-        if (page_height > EPS && page_height + line_height > op->priv->page.height + EPS)
+    if (op->priv->pg_height > EPS &&
+        op->priv->pg_height + line_height > op->priv->page.height + EPS)
+    {
+        gboolean part = FALSE;
+        int offset;
+
+        if (GET_OPTION (op, MOO_PRINT_WRAP) && !filled)
+            fill_layout (op, op->priv->layout, iter, &end,
+                         GET_OPTION (op, MOO_PRINT_USE_STYLES));
+
+        if (GET_OPTION (op, MOO_PRINT_WRAP) && pango_layout_get_line_count (op->priv->layout) > 1)
         {
-            gboolean part = FALSE;
+            double part_height = 0;
+            PangoLayoutIter *layout_iter;
+            gboolean is_first_line = TRUE;
+
+            layout_iter = pango_layout_get_iter (op->priv->layout);
 
-            if (GET_OPTION (op, MOO_PRINT_WRAP) && pango_layout_get_line_count (op->priv->layout) > 1)
+            do
             {
-                double part_height = 0;
-                PangoLayoutIter *layout_iter;
-                gboolean is_first_line = TRUE;
+                PangoLayoutLine *layout_line;
+                double layout_line_height;
 
-                layout_iter = pango_layout_get_iter (op->priv->layout);
+                layout_line = pango_layout_iter_get_line (layout_iter);
+                get_layout_line_size (layout_line, NULL, &layout_line_height);
 
-                do
-                {
-                    PangoLayoutLine *layout_line;
-                    double layout_line_height;
+                if (is_first_line && with_ln)
+                    layout_line_height = MAX (layout_line_height, op->priv->ln_height);
 
-                    layout_line = pango_layout_iter_get_line (layout_iter);
-                    get_layout_line_size (layout_line, NULL, &layout_line_height);
+                if (op->priv->pg_height + part_height + layout_line_height > op->priv->page.height + EPS)
+                    break;
 
-                    if (is_first_line && line_number_displayed (op, line_no))
-                        layout_line_height = MAX (layout_line_height, op->priv->ln_height);
+                is_first_line = FALSE;
+                part_height += layout_line_height;
+                part = TRUE;
+            }
+            while (pango_layout_iter_next_line (layout_iter));
 
-                    if (page_height + part_height + layout_line_height > op->priv->page.height + EPS)
-                        break;
+            if (part)
+            {
+                int index = pango_layout_iter_get_index (layout_iter);
+                index += gtk_text_iter_get_line_index (iter);
+                *iter = end;
+                gtk_text_iter_set_line_index (iter, index);
+                line_height = 0;
+            }
 
-                    is_first_line = FALSE;
-                    part_height += layout_line_height;
-                    part = TRUE;
-                }
-                while (pango_layout_iter_next_line (layout_iter));
+            pango_layout_iter_free (layout_iter);
+        }
 
-                if (part)
-                {
-                    int index = pango_layout_iter_get_index (layout_iter);
-                    iter = end;
-                    gtk_text_iter_set_line_index (&iter, index);
-                    line_height = 0;
-                }
+        offset = gtk_text_iter_get_offset (iter);
+        g_array_append_val (op->priv->pages, offset);
+        op->priv->pg_height = line_height;
 
-                pango_layout_iter_free (layout_iter);
-            }
+        if (!part)
+            gtk_text_iter_forward_line (iter);
+    }
+    else
+    {
+        op->priv->pg_height += line_height;
+        gtk_text_iter_forward_line (iter);
+    }
+#undef EPS
+}
 
-            offset = gtk_text_iter_get_offset (&iter);
-            g_array_append_val (op->priv->pages, offset);
-            page_height = line_height;
+static gboolean
+moo_print_operation_paginate (GtkPrintOperation *operation,
+                              G_GNUC_UNUSED GtkPrintContext *context)
+{
+    MooPrintOperation *op = MOO_PRINT_OPERATION (operation);
+    GtkTextIter iter, print_end;
+    gboolean use_styles;
+    GTimer *timer;
 
-            if (!part)
-                gtk_text_iter_forward_line (&iter);
-        }
-        else
+    g_return_val_if_fail (op->priv->pages != NULL, TRUE);
+
+    use_styles = GET_OPTION (op, MOO_PRINT_USE_STYLES) &&
+                 MOO_IS_TEXT_BUFFER (op->priv->buffer);
+
+    gtk_text_buffer_get_iter_at_offset (op->priv->buffer, &iter, op->priv->pg_offset);
+    gtk_text_buffer_get_iter_at_offset (op->priv->buffer, &print_end, op->priv->pg_end_offset);
+
+    timer = g_timer_new ();
+
+    while (gtk_text_iter_compare (&iter, &print_end) < 0 &&
+           g_timer_elapsed (timer, NULL) < PAGINATE_TIME_SLICE)
+    {
+        GtkTextIter chunk_end = iter;
+
+        gtk_text_iter_forward_lines (&chunk_end, PAGINATE_CHUNK_LINES);
+        if (gtk_text_iter_compare (&chunk_end, &print_end) > 0)
+            chunk_end = print_end;
+
+        if (use_styles)
+            _moo_text_buffer_update_highlight (MOO_TEXT_BUFFER (op->priv->buffer),
+                                               &iter, &chunk_end, TRUE);
+
+        while (gtk_text_iter_compare (&iter, &chunk_end) < 0)
+            paginate_line (op, &iter);
+    }
+
+    g_timer_destroy (timer);
+
+    op->priv->pg_offset = gtk_text_iter_get_offset (&iter);
+
+    if (gtk_text_iter_compare (&iter, &print_end) < 0)
+    {
+        if (MOO_IS_EDIT_VIEW (op->priv->doc))
         {
-            page_height += line_height;
-            gtk_text_iter_forward_line (&iter);
+            char *text = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                                     "Paginating: %u page",
+                                                     "Paginating: %u pages",
+                                                     op->priv->pages->len),
+                                          op->priv->pages->len);
+            _moo_edit_set_progress_text (moo_edit_view_get_doc (MOO_EDIT_VIEW (op->priv->doc)), text);
+            g_free (text);
         }
+
+        return FALSE;
     }
-#undef EPS
 
-    gtk_print_operation_set_n_pages (GTK_PRINT_OPERATION (op), op->priv->pages->len);
+    gtk_print_operation_set_n_pages (operation, op->priv->pages->len);
+    op->priv->heights = NULL;
 
-    moo_dmsg ("moo_print_operation_paginate done");
+    moo_dmsg ("paginate done: %u pages", op->priv->pages->len);
+    return TRUE;
 }
 
 
@@ -961,10 +1253,9 @@ moo_print_operation_begin_print (GtkPrintOperation *operation,
 
     set_tabs (op, op->priv->layout);
 
-    moo_print_operation_paginate (op);
+    paginate_start (op, context);
 
-    moo_dmsg ("begin_print: %u pages in %f s", op->priv->pages->len,
-              g_timer_elapsed (timer, NULL));
+    moo_dmsg ("begin_print: %f s", g_timer_elapsed (timer, NULL));
     g_timer_destroy (timer);
 
     if (!op->priv->tm)
@@ -1477,6 +1768,7 @@ moo_print_operation_end_print (GtkPrintOperation  *operation,
     op->priv->layout = NULL;
     g_array_free (op->priv->pages, TRUE);
     op->priv->pages = NULL;
+    op->priv->heights = NULL;
 }
 
 
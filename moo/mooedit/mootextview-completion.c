@@ -0,0 +1,383 @@
+/*
+ *   mootextview-completion.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Word completion popup. Words come from the word index of all open
+ * documents; the popup stays open while the word at the cursor is
+ * being typed and is refilled after every key press. Keys are handled
+ * by the text view, the popup never takes the focus.
+ */
+
+#include "mooedit/mootextview-private.h"
+#include "mooedit/moowordindex.h"
+#include <gdk/gdkkeysyms.h>
+
+#define COMPLETION_MAX_WORDS    100
+#define COMPLETION_POPUP_LEN    10
+
+enum {
+    COLUMN_WORD
+};
+
+
+static gboolean
+completion_visible (MooTextView *view)
+{
+    return view->priv->cmpl.popup && GTK_WIDGET_VISIBLE (view->priv->cmpl.popup);
+}
+
+/* start of the word before the cursor */
+static gboolean
+get_word_start (MooTextView *view,
+                GtkTextIter *start,
+                GtkTextIter *cursor)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+    GtkTextIter iter;
+
+    gtk_text_buffer_get_iter_at_mark (buffer, cursor, gtk_text_buffer_get_insert (buffer));
+    *start = *cursor;
+
+    while (TRUE)
+    {
+        iter = *start;
+        if (!gtk_text_iter_backward_char (&iter) ||
+            !_moo_word_index_is_word_char (gtk_text_iter_get_char (&iter)))
+                break;
+        *start = iter;
+    }
+
+    return !gtk_text_iter_equal (start, cursor);
+}
+
+static char **
+find_words (const char *prefix)
+{
+    char **words = _moo_word_index_complete (prefix, COMPLETION_MAX_WORDS);
+
+    if (!words || !words[0])
+    {
+        g_strfreev (words);
+        words = _moo_word_index_match (prefix, COMPLETION_MAX_WORDS);
+    }
+
+    return words;
+}
+
+static void
+insert_word (MooTextView *view,
+             const char  *word)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_iter_at_offset (buffer, &start, view->priv->cmpl.start);
+    gtk_text_buffer_get_iter_at_mark (buffer, &end, gtk_text_buffer_get_insert (buffer));
+
+    gtk_text_buffer_begin_user_action (buffer);
+    gtk_text_buffer_delete (buffer, &start, &end);
+    gtk_text_buffer_insert (buffer, &start, word, -1);
+    gtk_text_buffer_end_user_action (buffer);
+
+    gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (view),
+                                        gtk_text_buffer_get_insert (buffer));
+}
+
+static void
+completion_accept (MooTextView *view)
+{
+    GtkTreeSelection *selection;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    char *word = NULL;
+
+    selection = gtk_tree_view_get_selection (view->priv->cmpl.treeview);
+
+    if (gtk_tree_selection_get_selected (selection, &model, &iter))
+        gtk_tree_model_get (model, &iter, COLUMN_WORD, &word, -1);
+
+    _moo_text_view_completion_hide (view);
+
+    if (word)
+        insert_word (view, word);
+
+    g_free (word);
+}
+
+static void
+row_activated (MooTextView *view)
+{
+    completion_accept (view);
+}
+
+static void
+completion_create_popup (MooTextView *view)
+{
+    GtkWidget *scrolled_window, *frame, *treeview;
+    GtkCellRenderer *cell;
+
+    view->priv->cmpl.store = gtk_list_store_new (1, G_TYPE_STRING);
+
+    view->priv->cmpl.popup = gtk_window_new (GTK_WINDOW_POPUP);
+    gtk_window_set_resizable (GTK_WINDOW (view->priv->cmpl.popup), FALSE);
+    gtk_window_set_screen (GTK_WINDOW (view->priv->cmpl.popup),
+                           gtk_widget_get_screen (GTK_WIDGET (view)));
+
+    treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (view->priv->cmpl.store));
+    view->priv->cmpl.treeview = GTK_TREE_VIEW (treeview);
+    gtk_tree_view_set_headers_visible (view->priv->cmpl.treeview, FALSE);
+    gtk_tree_selection_set_mode (gtk_tree_view_get_selection (view->priv->cmpl.treeview),
+                                 GTK_SELECTION_BROWSE);
+
+    cell = gtk_cell_renderer_text_new ();
+    view->priv->cmpl.column = gtk_tree_view_column_new_with_attributes (NULL, cell,
+                                                                        "text", COLUMN_WORD,
+                                                                        NULL);
+    gtk_tree_view_append_column (view->priv->cmpl.treeview, view->priv->cmpl.column);
+
+    g_signal_connect_swapped (treeview, "row-activated",
+                              G_CALLBACK (row_activated), view);
+
+    scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+                                    GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_container_add (GTK_CONTAINER (scrolled_window), treeview);
+
+    frame = gtk_frame_new (NULL);
+    gtk_frame_set_shadow_type (GTK_FRAME (frame), GTK_SHADOW_ETCHED_IN);
+    gtk_container_add (GTK_CONTAINER (frame), scrolled_window);
+
+    gtk_widget_show_all (frame);
+    gtk_container_add (GTK_CONTAINER (view->priv->cmpl.popup), frame);
+}
+
+/* puts the popup under the start of the word, or above it if
+ * there is no room below */
+static void
+completion_position_popup (MooTextView *view)
+{
+    GtkTextView *text_view = GTK_TEXT_VIEW (view);
+    GtkWidget *widget = GTK_WIDGET (view);
+    GtkTextIter start;
+    GdkRectangle rect, monitor;
+    GdkScreen *screen;
+    GtkRequisition req;
+    int x, y, origin_x, origin_y;
+    int height, items, vert_separator = 0;
+
+    gtk_tree_view_column_cell_get_size (view->priv->cmpl.column, NULL,
+                                        NULL, NULL, NULL, &height);
+    gtk_widget_style_get (GTK_WIDGET (view->priv->cmpl.treeview),
+                          "vertical-separator", &vert_separator, NULL);
+    items = MIN (gtk_tree_model_iter_n_children (GTK_TREE_MODEL (view->priv->cmpl.store), NULL),
+                 COMPLETION_POPUP_LEN);
+    gtk_widget_set_size_request (GTK_WIDGET (view->priv->cmpl.treeview), -1,
+                                 items * (height + vert_separator));
+
+    gtk_widget_set_size_request (view->priv->cmpl.popup, -1, -1);
+    gtk_widget_size_request (view->priv->cmpl.popup, &req);
+
+    gtk_text_buffer_get_iter_at_offset (gtk_text_view_get_buffer (text_view),
+                                        &start, view->priv->cmpl.start);
+    gtk_text_view_get_iter_location (text_view, &start, &rect);
+    gtk_text_view_buffer_to_window_coords (text_view, GTK_TEXT_WINDOW_TEXT,
+                                           rect.x, rect.y, &x, &y);
+    gdk_window_get_origin (gtk_text_view_get_window (text_view, GTK_TEXT_WINDOW_TEXT),
+                           &origin_x, &origin_y);
+    x += origin_x;
+    y += origin_y;
+
+    screen = gtk_widget_get_screen (widget);
+    gdk_screen_get_monitor_geometry (screen,
+                                     gdk_screen_get_monitor_at_window (screen, widget->window),
+                                     &monitor);
+
+    if (x + req.width > monitor.x + monitor.width)
+        x = monitor.x + monitor.width - req.width;
+    if (x < monitor.x)
+        x = monitor.x;
+
+    if (y + rect.height + req.height <= monitor.y + monitor.height)
+        y += rect.height;
+    else
+        y -= req.height;
+
+    gtk_window_move (GTK_WINDOW (view->priv->cmpl.popup), x, y);
+}
+
+/* Fills the popup with completions of the word before the cursor,
+ * hides it if there are none. */
+static void
+completion_refill (MooTextView *view,
+                   gboolean     insert_single)
+{
+    GtkTextIter start, cursor;
+    GtkTreeIter iter;
+    char *prefix;
+    char **words;
+    guint i;
+
+    if (!get_word_start (view, &start, &cursor))
+    {
+        _moo_text_view_completion_hide (view);
+        return;
+    }
+
+    prefix = gtk_text_iter_get_text (&start, &cursor);
+    words = find_words (prefix);
+    g_free (prefix);
+
+    view->priv->cmpl.start = gtk_text_iter_get_offset (&start);
+
+    if (!words || !words[0])
+    {
+        _moo_text_view_completion_hide (view);
+    }
+    else if (insert_single && !words[1])
+    {
+        _moo_text_view_completion_hide (view);
+        insert_word (view, words[0]);
+    }
+    else if (GTK_WIDGET_REALIZED (view))
+    {
+        if (!view->priv->cmpl.popup)
+            completion_create_popup (view);
+
+        gtk_list_store_clear (view->priv->cmpl.store);
+        for (i = 0; words[i]; ++i)
+            gtk_list_store_insert_with_values (view->priv->cmpl.store, &iter, G_MAXINT,
+                                               COLUMN_WORD, words[i], -1);
+
+        gtk_tree_view_scroll_to_point (view->priv->cmpl.treeview, 0, 0);
+        gtk_tree_model_get_iter_first (GTK_TREE_MODEL (view->priv->cmpl.store), &iter);
+        gtk_tree_selection_select_iter (gtk_tree_view_get_selection (view->priv->cmpl.treeview), &iter);
+
+        completion_position_popup (view);
+        gtk_widget_show (view->priv->cmpl.popup);
+    }
+
+    g_strfreev (words);
+}
+
+/**
+ * moo_text_view_complete_word:
+ *
+ * Completes the word before the cursor: if there is a single
+ * completion it's inserted, otherwise the popup is shown.
+ */
+void
+moo_text_view_complete_word (MooTextView *view)
+{
+    g_return_if_fail (MOO_IS_TEXT_VIEW (view));
+    completion_refill (view, !completion_visible (view));
+}
+
+void
+_moo_text_view_completion_update (MooTextView *view)
+{
+    if (completion_visible (view))
+        completion_refill (view, FALSE);
+}
+
+void
+_moo_text_view_completion_hide (MooTextView *view)
+{
+    if (view->priv->cmpl.popup)
+        gtk_widget_hide (view->priv->cmpl.popup);
+}
+
+void
+_moo_text_view_completion_destroy (MooTextView *view)
+{
+    if (view->priv->cmpl.popup)
+    {
+        gtk_widget_destroy (view->priv->cmpl.popup);
+        g_object_unref (view->priv->cmpl.store);
+        view->priv->cmpl.popup = NULL;
+        view->priv->cmpl.treeview = NULL;
+        view->priv->cmpl.column = NULL;
+        view->priv->cmpl.store = NULL;
+    }
+}
+
+static void
+completion_move_selection (MooTextView *view,
+                           int          delta)
+{
+    GtkTreeSelection *selection;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    GtkTreePath *path;
+    int n_items, index = 0;
+
+    selection = gtk_tree_view_get_selection (view->priv->cmpl.treeview);
+    n_items = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (view->priv->cmpl.store), NULL);
+
+    if (gtk_tree_selection_get_selected (selection, &model, &iter))
+    {
+        path = gtk_tree_model_get_path (model, &iter);
+        index = gtk_tree_path_get_indices (path)[0];
+        gtk_tree_path_free (path);
+    }
+
+    index = CLAMP (index + delta, 0, n_items - 1);
+
+    path = gtk_tree_path_new_from_indices (index, -1);
+    gtk_tree_selection_select_path (selection, path);
+    gtk_tree_view_scroll_to_cell (view->priv->cmpl.treeview, path, NULL, FALSE, 0, 0);
+    gtk_tree_path_free (path);
+}
+
+/* Handles keys which navigate the popup; everything else
+ * goes to the text view. */
+gboolean
+_moo_text_view_completion_key_press (MooTextView    *view,
+                                     guint           keyval,
+                                     GdkModifierType mods)
+{
+    if (!completion_visible (view) || mods)
+        return FALSE;
+
+    switch (keyval)
+    {
+        case GDK_Up:
+        case GDK_KP_Up:
+            completion_move_selection (view, -1);
+            return TRUE;
+        case GDK_Down:
+        case GDK_KP_Down:
+            completion_move_selection (view, 1);
+            return TRUE;
+        case GDK_Page_Up:
+        case GDK_KP_Page_Up:
+            completion_move_selection (view, -COMPLETION_POPUP_LEN);
+            return TRUE;
+        case GDK_Page_Down:
+        case GDK_KP_Page_Down:
+            completion_move_selection (view, COMPLETION_POPUP_LEN);
+            return TRUE;
+        case GDK_Return:
+        case GDK_KP_Enter:
+        case GDK_Tab:
+        case GDK_KP_Tab:
+            completion_accept (view);
+            return TRUE;
+        case GDK_Escape:
+            _moo_text_view_completion_hide (view);
+            return TRUE;
+    }
+
+    return FALSE;
+}
@@ -705,6 +705,8 @@ _moo_text_view_button_press_event (GtkWidget          *widget,
     text_view = GTK_TEXT_VIEW (widget);
     view = MOO_TEXT_VIEW (widget);
 
+    _moo_text_view_completion_hide (view);
+
     event_button_to_buffer (text_view, event, &x, &y);
     _moo_text_view_update_text_cursor (view, x, y);
 
@@ -1243,6 +1245,9 @@ _moo_text_view_key_press_event (GtkWidget          *widget,
 
     moo_accel_translate_event (widget, event, &keyval, &mods);
 
+    if (_moo_text_view_completion_key_press (view, keyval, mods))
+        return TRUE;
+
     if (keyval == GDK_KP_Enter || keyval == GDK_Return)
     {
         gtk_text_buffer_begin_user_action (buffer);
@@ -1311,7 +1316,10 @@ _moo_text_view_key_press_event (GtkWidget          *widget,
         text_view_obscure_mouse_cursor (text_view);
 
     if (handled)
+    {
+        _moo_text_view_completion_update (view);
         return TRUE;
+    }
 
     view->priv->in_key_press = TRUE;
     _moo_text_view_ensure_primary (text_view);
@@ -1322,6 +1330,7 @@ _moo_text_view_key_press_event (GtkWidget          *widget,
     view->priv->in_key_press = FALSE;
 
     _moo_text_view_check_char_inserted (view);
+    _moo_text_view_completion_update (view);
 
     return handled;
 }
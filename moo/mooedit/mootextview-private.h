@@ -59,6 +59,13 @@ void        _moo_text_view_update_text_cursor   (MooTextView        *view,
                                                  int                 x,
                                                  int                 y);
 
+gboolean    _moo_text_view_completion_key_press (MooTextView        *view,
+                                                 guint               keyval,
+                                                 GdkModifierType     mods);
+void        _moo_text_view_completion_update    (MooTextView        *view);
+void        _moo_text_view_completion_hide      (MooTextView        *view);
+void        _moo_text_view_completion_destroy   (MooTextView        *view);
+
 extern gpointer _moo_text_view_parent_class;
 
 typedef enum {
@@ -196,6 +203,18 @@ struct MooTextViewPrivate {
         GtkToggleButton *regex;
         MooTextSearchFlags flags;
     } qs;
+
+    /***********************************************************************/
+    /* Word completion
+     */
+    struct {
+        GtkWidget *popup;
+        GtkTreeView *treeview;
+        GtkTreeViewColumn *column;
+        GtkListStore *store;
+        /* offset of the word being completed */
+        int start;
+    } cmpl;
 };
 
 enum {
@@ -37,6 +37,7 @@
 #include "mooutils/mootype-macros.h"
 #include "mooutils/moocompat.h"
 #include "mooutils/mooutils-gobject.h"
+#include "mooutils/mootrace.h"
 #include "mooedit/mooquicksearch-gxml.h"
 #include <gtk/gtk.h>
 #include <mooglib/moo-glib.h>
@@ -88,6 +89,8 @@ static void     moo_text_view_size_request  (GtkWidget          *widget,
                                              GtkRequisition     *requisition);
 static void     moo_text_view_size_allocate (GtkWidget          *widget,
                                              GtkAllocation      *allocation);
+static gboolean moo_text_view_focus_out     (GtkWidget          *widget,
+                                             GdkEventFocus      *event);
 
 static void     moo_text_view_remove        (GtkContainer       *container,
                                              GtkWidget          *child);
@@ -272,6 +275,7 @@ static void moo_text_view_class_init (MooTextViewClass *klass)
     widget_class->motion_notify_event = _moo_text_view_motion_event;
 
     widget_class->key_press_event = _moo_text_view_key_press_event;
+    widget_class->focus_out_event = moo_text_view_focus_out;
     widget_class->realize = moo_text_view_realize;
     widget_class->unrealize = moo_text_view_unrealize;
     widget_class->expose_event = moo_text_view_expose;
@@ -853,6 +857,8 @@ moo_text_view_dispose (GObject *object)
         view->priv->move_cursor_idle = 0;
     }
 
+    _moo_text_view_completion_destroy (view);
+
     G_OBJECT_CLASS (moo_text_view_parent_class)->dispose (object);
 }
 
@@ -957,13 +963,19 @@ moo_text_view_set_font_from_string (MooTextView *view,
                                     const char  *font)
 {
     PangoFontDescription *font_desc = NULL;
+    PangoFontDescription *old_desc;
 
     g_return_if_fail (MOO_IS_TEXT_VIEW (view));
 
     if (font)
         font_desc = pango_font_description_from_string (font);
 
-    gtk_widget_modify_font (GTK_WIDGET (view), font_desc);
+    /* modifying the font makes the whole text laid out again,
+     * don't do it when preferences are applied and it's the same */
+    old_desc = gtk_widget_get_modifier_style (GTK_WIDGET (view))->font_desc;
+
+    if (font_desc ? !old_desc || !pango_font_description_equal (font_desc, old_desc) : old_desc != NULL)
+        gtk_widget_modify_font (GTK_WIDGET (view), font_desc);
 
     if (font_desc)
         pango_font_description_free (font_desc);
@@ -2108,11 +2120,21 @@ moo_text_view_realize (GtkWidget *widget)
 }
 
 
+static gboolean
+moo_text_view_focus_out (GtkWidget     *widget,
+                         GdkEventFocus *event)
+{
+    _moo_text_view_completion_hide (MOO_TEXT_VIEW (widget));
+    return GTK_WIDGET_CLASS (moo_text_view_parent_class)->focus_out_event (widget, event);
+}
+
 static void
 moo_text_view_unrealize (GtkWidget *widget)
 {
     MooTextView *view = MOO_TEXT_VIEW (widget);
 
+    _moo_text_view_completion_hide (view);
+
     g_slist_foreach (view->priv->line_marks, (GFunc) _moo_line_mark_unrealize, NULL);
     g_object_set_data (G_OBJECT (widget), "moo-line-mark-icons", NULL);
     g_object_set_data (G_OBJECT (widget), "moo-line-mark-colors", NULL);
@@ -2333,6 +2355,8 @@ draw_tab_at_iter (GtkTextView    *text_view,
                       FALSE, points, 3);
 }
 
+/* Whitespace positions are cached per line in the buffer, so this
+ * only needs to map them to pixels */
 static void
 moo_text_view_draw_whitespace (GtkTextView       *text_view,
                                GdkEventExpose    *event,
@@ -2340,55 +2364,44 @@ moo_text_view_draw_whitespace (GtkTextView       *text_view,
                                const GtkTextIter *end)
 {
     MooTextView *view = MOO_TEXT_VIEW (text_view);
-    GtkTextIter iter = *start;
-    GtkTextIter cursor;
-    int cursor_line;
-    int line;
+    MooTextBuffer *buffer = get_moo_buffer (view);
+    MooDrawWsFlags flags = view->priv->draw_whitespace;
+    int line, last_line;
 
-    if (view->priv->draw_whitespace == 0)
+    if (flags == 0)
         return;
 
-    line = gtk_text_iter_get_line (&iter);
-    moo_text_view_get_cursor (GTK_TEXT_VIEW (text_view), &cursor);
-    cursor_line = gtk_text_iter_get_line (&cursor);
-    cursor_line = -1; /* FIXME */
+    line = gtk_text_iter_get_line (start);
+    last_line = gtk_text_iter_get_line (end);
+    if (!gtk_text_iter_starts_line (end) || last_line == line)
+        last_line += 1;
 
-    do
+    for ( ; line < last_line; ++line)
     {
-        gboolean trailing = TRUE;
-
-        if (!gtk_text_iter_ends_line (&iter))
-            gtk_text_iter_forward_to_line_end (&iter);
+        const BTLineWs *ws = _moo_text_buffer_get_line_whitespace (buffer, line);
+        guint first_trailing, i;
+        GtkTextIter iter;
 
-        while (!gtk_text_iter_starts_line (&iter))
-        {
-            gunichar c;
+        if (!ws || ws->n_chars == 0)
+            continue;
 
-            if (line == cursor_line && gtk_text_iter_compare (&iter, &cursor) <= 0)
-                break;
+        first_trailing = ws->n_chars - ws->n_trailing;
+        i = (flags & ~MOO_DRAW_WS_TRAILING) == 0 ? first_trailing : 0;
+        gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (buffer), &iter, line);
 
-            gtk_text_iter_backward_char (&iter);
-            c = gtk_text_iter_get_char (&iter);
+        for ( ; i < ws->n_chars; ++i)
+        {
+            gboolean tab = (ws->chars[i] & 1) != 0;
 
-            if (g_unichar_isspace (c))
-            {
-                if ((trailing && (view->priv->draw_whitespace & MOO_DRAW_WS_TRAILING) != 0) ||
-                    (c == '\t' && (view->priv->draw_whitespace & MOO_DRAW_WS_TABS) != 0) ||
-                    (c != '\t' && (view->priv->draw_whitespace & MOO_DRAW_WS_SPACES) != 0))
-                        draw_tab_at_iter (text_view, event, &iter);
-            }
-            else if (trailing)
+            if ((i >= first_trailing && (flags & MOO_DRAW_WS_TRAILING) != 0) ||
+                (tab && (flags & MOO_DRAW_WS_TABS) != 0) ||
+                (!tab && (flags & MOO_DRAW_WS_SPACES) != 0))
             {
-                trailing = FALSE;
-                if ((view->priv->draw_whitespace & ~MOO_DRAW_WS_TRAILING) == 0)
-                    break;
+                gtk_text_iter_set_line_index (&iter, ws->chars[i] >> 1);
+                draw_tab_at_iter (text_view, event, &iter);
             }
         }
-
-        gtk_text_iter_forward_line (&iter);
-        line += 1;
     }
-    while (gtk_text_iter_compare (&iter, end) < 0);
 }
 
 
@@ -2403,6 +2416,8 @@ moo_text_view_expose (GtkWidget      *widget,
     GdkWindow *left_window = gtk_text_view_get_window (text_view, GTK_TEXT_WINDOW_LEFT);
     GtkTextIter start, end;
 
+    MOO_TRACE_BEGIN ("text view expose");
+
     update_gcs (view);
 
     view->priv->in_expose = TRUE;
@@ -2461,6 +2476,8 @@ moo_text_view_expose (GtkWidget      *widget,
 
     view->priv->in_expose = FALSE;
 
+    MOO_TRACE_END ("text view expose");
+
     return handled;
 }
 
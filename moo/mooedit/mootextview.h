@@ -157,6 +157,8 @@ void         moo_text_view_add_child_in_border      (MooTextView        *view,
 void         moo_text_view_indent                   (MooTextView        *view);
 void         moo_text_view_unindent                 (MooTextView        *view);
 
+void         moo_text_view_complete_word            (MooTextView        *view);
+
 
 G_END_DECLS
 
@@ -0,0 +1,820 @@
+/*
+ *   moowordindex.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Words of open documents, for word completion.
+ *
+ * Every document has a table of its words with the number of times each
+ * word occurs. The buffer keeps it up to date by removing the words around
+ * an edit before the change and adding them back after it. Counts of all
+ * documents are summed in the global index, which also keeps the words in
+ * a sorted sequence so that words with given prefix are found with binary
+ * search.
+ *
+ * When a document is loaded, or after a big change, the table is built
+ * from scratch: a copy of the text is scanned by a pool of worker threads,
+ * and the result is merged into the global index on the main thread. If
+ * the text changed meanwhile the result is thrown away and the build is
+ * started again.
+ */
+
+#include "mooedit/moowordindex.h"
+#include "mooutils/mooutils-thread.h"
+#include <string.h>
+
+#define MIN_WORD_CHARS      3
+#define MAX_WORD_BYTES      64
+#define MAX_BUILD_JOBS      4
+#define PREFIX_SCAN_MAX     10000
+#define FUZZY_SCAN_MAX      50000
+
+typedef struct {
+    guint count;
+    /* position in the sorted sequence, global index only */
+    GSequenceIter *iter;
+    char word[1];
+} WordEntry;
+
+typedef struct BuildJob BuildJob;
+
+struct MooWordIndex {
+    /* char* -> WordEntry*, keys are entry->word */
+    GHashTable *words;
+    MooWordIndexTextFunc text_func;
+    gpointer text_data;
+    BuildJob *job;
+    guint stamp;
+    guint ready : 1;
+    guint queued : 1;
+};
+
+struct BuildJob {
+    MooWordIndex *index;
+    guint stamp;
+    char *text;
+    GHashTable *words;
+};
+
+static struct {
+    GHashTable *words;
+    GSequence *sorted;
+    GQueue waiting;
+    GThreadPool *pool;
+    guint n_jobs;
+    guint n_building;
+    guint start_idle;
+} global;
+
+typedef void (*WordFunc) (const char *word,
+                          gsize       len,
+                          gpointer    data);
+
+
+static WordEntry *
+word_entry_new (const char *word,
+                gsize       len)
+{
+    WordEntry *entry = (WordEntry*) g_malloc (G_STRUCT_OFFSET (WordEntry, word) + len + 1);
+    entry->count = 0;
+    entry->iter = NULL;
+    memcpy (entry->word, word, len);
+    entry->word[len] = 0;
+    return entry;
+}
+
+static GHashTable *
+word_table_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+}
+
+static WordEntry *
+word_table_add (GHashTable *table,
+                const char *word,
+                guint       count)
+{
+    WordEntry *entry = (WordEntry*) g_hash_table_lookup (table, word);
+
+    if (!entry)
+    {
+        entry = word_entry_new (word, strlen (word));
+        g_hash_table_insert (table, entry->word, entry);
+    }
+
+    entry->count += count;
+    return entry;
+}
+
+
+gboolean
+_moo_word_index_is_word_char (gunichar c)
+{
+    if (c < 0x80)
+        return g_ascii_isalnum (c) || c == '_';
+    else
+        return g_unichar_isalnum (c);
+}
+
+static inline gboolean
+word_char_at (const char *p)
+{
+    if ((guchar) *p < 0x80)
+        return g_ascii_isalnum (*p) || *p == '_';
+    else
+        return g_unichar_isalnum (g_utf8_get_char (p));
+}
+
+static inline const char *
+next_char (const char *p)
+{
+    return (guchar) *p < 0x80 ? p + 1 : g_utf8_next_char (p);
+}
+
+/* Words are runs of letters, digits and underscores which do not start
+ * with a digit; words too short to be worth completing and very long
+ * ones are skipped. Called in worker threads too. */
+static void
+scan_words (const char *text,
+            gsize       len,
+            WordFunc    func,
+            gpointer    data)
+{
+    const char *p = text;
+    const char *end = text + len;
+
+    while (p < end)
+    {
+        const char *start;
+        guint n_chars = 0;
+
+        while (p < end && !word_char_at (p))
+            p = next_char (p);
+
+        start = p;
+
+        while (p < end && word_char_at (p))
+        {
+            p = next_char (p);
+            n_chars++;
+        }
+
+        if (n_chars >= MIN_WORD_CHARS &&
+            p - start <= MAX_WORD_BYTES &&
+            !g_ascii_isdigit (*start))
+                func (start, p - start, data);
+    }
+}
+
+
+/*************************************************************************/
+/* Global index
+ */
+
+static int
+compare_entries (const WordEntry *a,
+                 const WordEntry *b,
+                 G_GNUC_UNUSED gpointer data)
+{
+    return strcmp (a->word, b->word);
+}
+
+/* never reports equality, so that g_sequence_search() finds
+ * the first entry which is not less than the key */
+static int
+compare_lower_bound (const WordEntry *a,
+                     const WordEntry *b,
+                     const WordEntry *key)
+{
+    if (a == key)
+        return strcmp (a->word, b->word) <= 0 ? -1 : 1;
+    else
+        return strcmp (a->word, b->word) < 0 ? -1 : 1;
+}
+
+static void
+global_init (void)
+{
+    if (!global.words)
+    {
+        global.words = g_hash_table_new (g_str_hash, g_str_equal);
+        global.sorted = g_sequence_new (g_free);
+    }
+}
+
+static void
+global_add (const char *word,
+            guint       count)
+{
+    WordEntry *entry;
+
+    global_init ();
+
+    if (!(entry = (WordEntry*) g_hash_table_lookup (global.words, word)))
+    {
+        entry = word_entry_new (word, strlen (word));
+        g_hash_table_insert (global.words, entry->word, entry);
+        entry->iter = g_sequence_insert_sorted (global.sorted, entry,
+                                                (GCompareDataFunc) compare_entries,
+                                                NULL);
+    }
+
+    entry->count += count;
+}
+
+static void
+global_remove (const char *word,
+               guint       count)
+{
+    WordEntry *entry;
+
+    g_return_if_fail (global.words != NULL);
+
+    entry = (WordEntry*) g_hash_table_lookup (global.words, word);
+    g_return_if_fail (entry != NULL && entry->count >= count);
+
+    entry->count -= count;
+
+    if (!entry->count)
+    {
+        g_hash_table_remove (global.words, entry->word);
+        g_sequence_remove (entry->iter);
+    }
+}
+
+static GSequenceIter *
+global_lookup_prefix (const char *prefix,
+                      gsize       len)
+{
+    WordEntry *key;
+    GSequenceIter *iter;
+
+    key = word_entry_new (prefix, len);
+    iter = g_sequence_search (global.sorted, key,
+                              (GCompareDataFunc) compare_lower_bound,
+                              key);
+    g_free (key);
+
+    return iter;
+}
+
+static void
+collect_prefix (GPtrArray  *entries,
+                const char *prefix,
+                gsize       len,
+                guint       max_entries)
+{
+    GSequenceIter *iter;
+
+    for (iter = global_lookup_prefix (prefix, len);
+         !g_sequence_iter_is_end (iter) && entries->len < max_entries;
+         iter = g_sequence_iter_next (iter))
+    {
+        WordEntry *entry = (WordEntry*) g_sequence_get (iter);
+
+        if (strncmp (entry->word, prefix, len) != 0)
+            break;
+
+        g_ptr_array_add (entries, entry);
+    }
+}
+
+static int
+compare_by_count (WordEntry **a,
+                  WordEntry **b)
+{
+    if ((*a)->count != (*b)->count)
+        return (*a)->count > (*b)->count ? -1 : 1;
+    else
+        return strcmp ((*a)->word, (*b)->word);
+}
+
+static char **
+entries_to_strv (GPtrArray *entries,
+                 guint      max_results)
+{
+    char **words;
+    guint i, n;
+
+    n = MIN (entries->len, max_results);
+    words = g_new (char*, n + 1);
+
+    for (i = 0; i < n; ++i)
+        words[i] = g_strdup (((WordEntry*) entries->pdata[i])->word);
+
+    words[n] = NULL;
+    return words;
+}
+
+/**
+ * _moo_word_index_complete:
+ *
+ * Returns words which start with @prefix, except @prefix itself,
+ * the most frequent first.
+ */
+char **
+_moo_word_index_complete (const char *prefix,
+                          guint       max_results)
+{
+    GPtrArray *entries;
+    char **words;
+    gsize len;
+    guint i;
+
+    g_return_val_if_fail (prefix != NULL, NULL);
+
+    global_init ();
+
+    entries = g_ptr_array_new ();
+    len = strlen (prefix);
+
+    if (len > 0 && len <= MAX_WORD_BYTES)
+        collect_prefix (entries, prefix, len, PREFIX_SCAN_MAX);
+
+    for (i = 0; i < entries->len; ++i)
+    {
+        if (strcmp (((WordEntry*) entries->pdata[i])->word, prefix) == 0)
+        {
+            g_ptr_array_remove_index (entries, i);
+            break;
+        }
+    }
+
+    g_ptr_array_sort (entries, (GCompareFunc) compare_by_count);
+    words = entries_to_strv (entries, max_results);
+
+    g_ptr_array_free (entries, TRUE);
+    return words;
+}
+
+
+typedef struct {
+    WordEntry *entry;
+    int score;
+} FuzzyMatch;
+
+/* Returns -1 if characters of pattern do not occur in word in the same
+ * order, otherwise the number of pieces the pattern is split into. Case
+ * is ignored. */
+static int
+fuzzy_score (const char *word,
+             const char *pattern)
+{
+    int runs = 0;
+    gboolean in_run = FALSE;
+    gunichar pc;
+
+    pc = g_unichar_tolower (g_utf8_get_char (pattern));
+
+    for ( ; *word && *pattern; word = g_utf8_next_char (word))
+    {
+        if (g_unichar_tolower (g_utf8_get_char (word)) == pc)
+        {
+            if (!in_run)
+                runs++;
+            in_run = TRUE;
+            pattern = g_utf8_next_char (pattern);
+            pc = g_unichar_tolower (g_utf8_get_char (pattern));
+        }
+        else
+        {
+            in_run = FALSE;
+        }
+    }
+
+    return *pattern ? -1 : runs;
+}
+
+static int
+compare_fuzzy_matches (const FuzzyMatch *a,
+                       const FuzzyMatch *b)
+{
+    gsize len_a, len_b;
+
+    if (a->score != b->score)
+        return a->score < b->score ? -1 : 1;
+    if (a->entry->count != b->entry->count)
+        return a->entry->count > b->entry->count ? -1 : 1;
+
+    len_a = strlen (a->entry->word);
+    len_b = strlen (b->entry->word);
+    if (len_a != len_b)
+        return len_a < len_b ? -1 : 1;
+
+    return strcmp (a->entry->word, b->entry->word);
+}
+
+/**
+ * _moo_word_index_match:
+ *
+ * Returns words which start with the first character of @pattern and
+ * contain the rest of its characters in the same order, ignoring case.
+ * Words where the pattern is split into fewer pieces come first.
+ */
+char **
+_moo_word_index_match (const char *pattern,
+                       guint       max_results)
+{
+    GPtrArray *entries;
+    GArray *matches;
+    char **words;
+    char first[2][8];
+    gunichar c;
+    guint i;
+
+    g_return_val_if_fail (pattern != NULL, NULL);
+
+    global_init ();
+
+    entries = g_ptr_array_new ();
+    matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
+
+    if (pattern[0] && strlen (pattern) <= MAX_WORD_BYTES)
+    {
+        c = g_utf8_get_char (pattern);
+        first[0][g_unichar_to_utf8 (g_unichar_tolower (c), first[0])] = 0;
+        first[1][g_unichar_to_utf8 (g_unichar_toupper (c), first[1])] = 0;
+
+        collect_prefix (entries, first[0], strlen (first[0]), FUZZY_SCAN_MAX);
+        if (strcmp (first[0], first[1]) != 0)
+            collect_prefix (entries, first[1], strlen (first[1]), FUZZY_SCAN_MAX);
+    }
+
+    for (i = 0; i < entries->len; ++i)
+    {
+        FuzzyMatch match;
+
+        match.entry = (WordEntry*) entries->pdata[i];
+
+        if (strcmp (match.entry->word, pattern) == 0)
+            continue;
+
+        if ((match.score = fuzzy_score (match.entry->word, pattern)) >= 0)
+            g_array_append_val (matches, match);
+    }
+
+    g_array_sort (matches, (GCompareFunc) compare_fuzzy_matches);
+
+    g_ptr_array_set_size (entries, 0);
+    for (i = 0; i < matches->len && i < max_results; ++i)
+        g_ptr_array_add (entries, g_array_index (matches, FuzzyMatch, i).entry);
+
+    words = entries_to_strv (entries, max_results);
+
+    g_array_free (matches, TRUE);
+    g_ptr_array_free (entries, TRUE);
+    return words;
+}
+
+
+/*************************************************************************/
+/* Building in threads
+ */
+
+static void
+index_set_ready (MooWordIndex *index,
+                 gboolean      ready)
+{
+    if (!index->ready == !ready)
+        return;
+
+    index->ready = ready != 0;
+
+    if (ready)
+        global.n_building--;
+    else
+        global.n_building++;
+}
+
+static void
+build_job_free (BuildJob *job)
+{
+    if (job->words)
+        g_hash_table_destroy (job->words);
+    g_free (job->text);
+    g_free (job);
+}
+
+static void
+count_word (const char *word,
+            gsize       len,
+            GHashTable *table)
+{
+    char buf[MAX_WORD_BYTES + 1];
+    memcpy (buf, word, len);
+    buf[len] = 0;
+    word_table_add (table, buf, 1);
+}
+
+static guint get_build_event_id (void);
+
+/* runs in a worker thread */
+static void
+build_job_run (BuildJob *job)
+{
+    job->words = word_table_new ();
+    scan_words (job->text, strlen (job->text), (WordFunc) count_word, job->words);
+
+    g_free (job->text);
+    job->text = NULL;
+
+    _moo_event_queue_push (get_build_event_id (), job,
+                           (GDestroyNotify) build_job_free);
+}
+
+static void
+start_build_jobs (void)
+{
+    guint n_workers = MAX_BUILD_JOBS;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+    n_workers = CLAMP (g_get_num_processors (), 1, MAX_BUILD_JOBS);
+#endif
+
+    if (!global.pool)
+    {
+        get_build_event_id ();
+        global.pool = g_thread_pool_new ((GFunc) build_job_run, NULL,
+                                         n_workers, FALSE, NULL);
+    }
+
+    /* every job holds a copy of the text, so copies are made
+     * only when a worker is free to take it */
+    while (global.n_jobs < n_workers && !g_queue_is_empty (&global.waiting))
+    {
+        MooWordIndex *index = (MooWordIndex*) g_queue_pop_head (&global.waiting);
+        BuildJob *job;
+
+        index->queued = FALSE;
+
+        job = g_new0 (BuildJob, 1);
+        job->index = index;
+        job->stamp = index->stamp;
+        job->text = index->text_func (index->text_data);
+
+        index->job = job;
+        global.n_jobs++;
+
+        g_thread_pool_push (global.pool, job, NULL);
+    }
+}
+
+static gboolean
+start_build_jobs_idle (void)
+{
+    global.start_idle = 0;
+    start_build_jobs ();
+    return FALSE;
+}
+
+static void
+index_queue_build (MooWordIndex *index)
+{
+    if (index->queued || index->job)
+        return;
+
+    index->queued = TRUE;
+    g_queue_push_tail (&global.waiting, index);
+
+    /* let the edit which triggered it finish first */
+    if (!global.start_idle)
+        global.start_idle = g_idle_add_full (G_PRIORITY_LOW,
+                                             (GSourceFunc) start_build_jobs_idle,
+                                             NULL, NULL);
+}
+
+/* main thread */
+static void
+build_jobs_done (GList *jobs)
+{
+    for ( ; jobs != NULL; jobs = jobs->next)
+    {
+        BuildJob *job = (BuildJob*) jobs->data;
+        MooWordIndex *index = job->index;
+        GHashTableIter iter;
+        gpointer value;
+
+        global.n_jobs--;
+
+        if (!index)
+            continue;
+
+        g_assert (index->job == job);
+        index->job = NULL;
+
+        /* the text changed while it was being scanned */
+        if (job->stamp != index->stamp)
+        {
+            index_queue_build (index);
+            continue;
+        }
+
+        g_hash_table_destroy (index->words);
+        index->words = job->words;
+        job->words = NULL;
+
+        g_hash_table_iter_init (&iter, index->words);
+        while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+            WordEntry *entry = (WordEntry*) value;
+            global_add (entry->word, entry->count);
+        }
+
+        index_set_ready (index, TRUE);
+    }
+
+    start_build_jobs ();
+}
+
+static guint
+get_build_event_id (void)
+{
+    static guint event_id;
+
+    if (!event_id)
+        event_id = _moo_event_queue_connect ((MooEventQueueCallback) build_jobs_done,
+                                             NULL, NULL);
+
+    return event_id;
+}
+
+
+/*************************************************************************/
+/* Document index
+ */
+
+MooWordIndex *
+_moo_word_index_new (MooWordIndexTextFunc text_func,
+                     gpointer             data)
+{
+    MooWordIndex *index;
+
+    g_return_val_if_fail (text_func != NULL, NULL);
+
+    index = g_new0 (MooWordIndex, 1);
+    index->words = word_table_new ();
+    index->text_func = text_func;
+    index->text_data = data;
+    index->ready = TRUE;
+
+    return index;
+}
+
+static void
+index_clear (MooWordIndex *index)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, index->words);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        WordEntry *entry = (WordEntry*) value;
+        global_remove (entry->word, entry->count);
+    }
+
+    g_hash_table_remove_all (index->words);
+}
+
+void
+_moo_word_index_free (MooWordIndex *index)
+{
+    if (!index)
+        return;
+
+    index_clear (index);
+    index_set_ready (index, TRUE);
+
+    if (index->queued)
+        g_queue_remove (&global.waiting, index);
+    if (index->job)
+        index->job->index = NULL;
+
+    g_hash_table_destroy (index->words);
+    g_free (index);
+}
+
+/**
+ * _moo_word_index_rebuild:
+ *
+ * Forgets the words of the document and schedules building the index
+ * from its current text.
+ */
+void
+_moo_word_index_rebuild (MooWordIndex *index)
+{
+    g_return_if_fail (index != NULL);
+
+    index_clear (index);
+    index_set_ready (index, FALSE);
+    index->stamp++;
+    index_queue_build (index);
+}
+
+gboolean
+_moo_word_index_is_ready (MooWordIndex *index)
+{
+    g_return_val_if_fail (index != NULL, FALSE);
+    return index->ready;
+}
+
+guint
+_moo_word_index_n_building (void)
+{
+    return global.n_building;
+}
+
+static void
+index_add_word (const char   *word,
+                gsize         len,
+                MooWordIndex *index)
+{
+    char buf[MAX_WORD_BYTES + 1];
+
+    memcpy (buf, word, len);
+    buf[len] = 0;
+
+    word_table_add (index->words, buf, 1);
+    global_add (buf, 1);
+}
+
+static void
+index_remove_word (const char   *word,
+                   gsize         len,
+                   MooWordIndex *index)
+{
+    char buf[MAX_WORD_BYTES + 1];
+    WordEntry *entry;
+
+    memcpy (buf, word, len);
+    buf[len] = 0;
+
+    entry = (WordEntry*) g_hash_table_lookup (index->words, buf);
+    g_return_if_fail (entry != NULL);
+
+    if (!--entry->count)
+        g_hash_table_remove (index->words, buf);
+
+    global_remove (buf, 1);
+}
+
+/**
+ * _moo_word_index_add_text:
+ *
+ * Adds words in @text. @text must not start or end in the middle
+ * of a word.
+ */
+void
+_moo_word_index_add_text (MooWordIndex *index,
+                          const char   *text,
+                          gssize        len)
+{
+    g_return_if_fail (index != NULL && text != NULL);
+
+    /* the build in progress will be restarted */
+    if (!index->ready)
+    {
+        index->stamp++;
+        return;
+    }
+
+    if (len < 0)
+        len = strlen (text);
+
+    scan_words (text, len, (WordFunc) index_add_word, index);
+}
+
+/**
+ * _moo_word_index_remove_text:
+ *
+ * Removes words in @text, which must have been added before.
+ */
+void
+_moo_word_index_remove_text (MooWordIndex *index,
+                             const char   *text,
+                             gssize        len)
+{
+    g_return_if_fail (index != NULL && text != NULL);
+
+    if (!index->ready)
+    {
+        index->stamp++;
+        return;
+    }
+
+    if (len < 0)
+        len = strlen (text);
+
+    scan_words (text, len, (WordFunc) index_remove_word, index);
+}
@@ -0,0 +1,56 @@
+/*
+ *   moowordindex.h
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOO_WORD_INDEX_H
+#define MOO_WORD_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct MooWordIndex MooWordIndex;
+
+/* returns a newly allocated copy of the whole text of the document */
+typedef char   *(*MooWordIndexTextFunc)     (gpointer            data);
+
+MooWordIndex   *_moo_word_index_new         (MooWordIndexTextFunc text_func,
+                                             gpointer            data);
+void            _moo_word_index_free        (MooWordIndex       *index);
+
+gboolean        _moo_word_index_is_word_char(gunichar            c);
+
+void            _moo_word_index_add_text    (MooWordIndex       *index,
+                                             const char         *text,
+                                             gssize              len);
+void            _moo_word_index_remove_text (MooWordIndex       *index,
+                                             const char         *text,
+                                             gssize              len);
+void            _moo_word_index_rebuild     (MooWordIndex       *index);
+gboolean        _moo_word_index_is_ready    (MooWordIndex       *index);
+
+/* number of indexes which are being built */
+guint           _moo_word_index_n_building  (void);
+
+/* Queries go to the words of all open documents. Results are sorted
+ * by how often a word occurs, the returned arrays must be freed with
+ * g_strfreev(). */
+char          **_moo_word_index_complete    (const char         *prefix,
+                                             guint               max_results);
+char          **_moo_word_index_match       (const char         *pattern,
+                                             guint               max_results);
+
+G_END_DECLS
+
+#endif /* MOO_WORD_INDEX_H */
@@ -42,6 +42,9 @@ struct _MooBookmarkMgrPrivate {
     gboolean loading;
     guint last_user_id;
     guint update_idle;
+    gboolean save_pending;
+    guint freeze_count;
+    gboolean changed_pending;
 };
 
 typedef struct _UserInfo UserInfo;
@@ -50,6 +53,7 @@ typedef struct _UserInfo UserInfo;
 static void moo_bookmark_mgr_finalize       (GObject        *object);
 static void moo_bookmark_mgr_changed        (MooBookmarkMgr *mgr);
 static void emit_changed                    (MooBookmarkMgr *mgr);
+static void store_changed                   (MooBookmarkMgr *mgr);
 static void moo_bookmark_mgr_add_separator  (MooBookmarkMgr *mgr);
 
 static void moo_bookmark_mgr_load           (MooBookmarkMgr *mgr);
@@ -57,7 +61,8 @@ static void moo_bookmark_mgr_save           (MooBookmarkMgr *mgr);
 
 static void mgr_remove_user                 (MooBookmarkMgr *mgr,
                                              UserInfo       *info);
-static gboolean mgr_update_menus            (MooBookmarkMgr *mgr);
+static void mgr_update_menus                (MooBookmarkMgr *mgr);
+static gboolean mgr_update_idle             (MooBookmarkMgr *mgr);
 
 static MooBookmark *_moo_bookmark_copy      (MooBookmark    *bookmark);
 
@@ -111,13 +116,13 @@ _moo_bookmark_mgr_init (MooBookmarkMgr *mgr)
     mgr->priv->store = gtk_list_store_new (1, MOO_TYPE_BOOKMARK);
 
     g_signal_connect_swapped (mgr->priv->store, "row-changed",
-                              G_CALLBACK (emit_changed), mgr);
+                              G_CALLBACK (store_changed), mgr);
     g_signal_connect_swapped (mgr->priv->store, "rows-reordered",
-                              G_CALLBACK (emit_changed), mgr);
+                              G_CALLBACK (store_changed), mgr);
     g_signal_connect_swapped (mgr->priv->store, "row-inserted",
-                              G_CALLBACK (emit_changed), mgr);
+                              G_CALLBACK (store_changed), mgr);
     g_signal_connect_swapped (mgr->priv->store, "row-deleted",
-                              G_CALLBACK (emit_changed), mgr);
+                              G_CALLBACK (store_changed), mgr);
 }
 
 
@@ -127,11 +132,14 @@ moo_bookmark_mgr_finalize (GObject *object)
     GSList *l, *users;
     MooBookmarkMgr *mgr = MOO_BOOKMARK_MGR (object);
 
-    g_object_unref (mgr->priv->store);
-
     if (mgr->priv->update_idle)
         g_source_remove (mgr->priv->update_idle);
 
+    if (mgr->priv->save_pending)
+        moo_bookmark_mgr_save (mgr);
+
+    g_object_unref (mgr->priv->store);
+
     if (mgr->priv->editor)
     {
         gtk_widget_destroy (mgr->priv->editor);
@@ -158,39 +166,136 @@ emit_changed (MooBookmarkMgr *mgr)
 }
 
 
+/* Changes to many rows at once, e.g. when bookmarks are loaded or
+ * replaced after editing, result in one "changed" emission. */
+static void
+moo_bookmark_mgr_freeze (MooBookmarkMgr *mgr)
+{
+    mgr->priv->freeze_count += 1;
+}
+
+static void
+moo_bookmark_mgr_thaw (MooBookmarkMgr *mgr)
+{
+    g_return_if_fail (mgr->priv->freeze_count > 0);
+
+    if (!--mgr->priv->freeze_count && mgr->priv->changed_pending)
+    {
+        mgr->priv->changed_pending = FALSE;
+        emit_changed (mgr);
+    }
+}
+
+static void
+store_changed (MooBookmarkMgr *mgr)
+{
+    if (mgr->priv->freeze_count)
+        mgr->priv->changed_pending = TRUE;
+    else
+        emit_changed (mgr);
+}
+
+
+/* saving and rebuilding menus is done once for all changes
+ * made before the main loop gets to the idle */
 static void
 moo_bookmark_mgr_changed (MooBookmarkMgr *mgr)
 {
     if (!mgr->priv->loading)
-        moo_bookmark_mgr_save (mgr);
+        mgr->priv->save_pending = TRUE;
     if (!mgr->priv->update_idle)
-        mgr->priv->update_idle = g_idle_add((GSourceFunc) mgr_update_menus, mgr);
+        mgr->priv->update_idle = g_idle_add((GSourceFunc) mgr_update_idle, mgr);
 }
 
 
+static gboolean
+mgr_update_idle (MooBookmarkMgr *mgr)
+{
+    mgr->priv->update_idle = 0;
+
+    if (mgr->priv->save_pending)
+    {
+        mgr->priv->save_pending = FALSE;
+        moo_bookmark_mgr_save (mgr);
+    }
+
+    mgr_update_menus (mgr);
+
+    return FALSE;
+}
+
+
+static void
+mgr_append (MooBookmarkMgr *mgr,
+            MooBookmark    *bookmark)
+{
+    GtkTreeIter iter;
+
+    /* XXX validate bookmark */
+
+    gtk_list_store_insert_with_values (mgr->priv->store, &iter, -1,
+                                       COLUMN_BOOKMARK, bookmark, -1);
+}
+
 void
 _moo_bookmark_mgr_add (MooBookmarkMgr *mgr,
                        MooBookmark    *bookmark)
 {
-    GtkTreeIter iter;
-
     g_return_if_fail (MOO_IS_BOOKMARK_MGR (mgr));
     g_return_if_fail (bookmark != NULL);
 
-    /* XXX validate bookmark */
+    mgr_append (mgr, bookmark);
+}
+
+/* bookmarks is a list of MooBookmark*, NULL elements are separators */
+void
+_moo_bookmark_mgr_add_list (MooBookmarkMgr *mgr,
+                            GSList         *bookmarks)
+{
+    g_return_if_fail (MOO_IS_BOOKMARK_MGR (mgr));
+
+    moo_bookmark_mgr_freeze (mgr);
+
+    for ( ; bookmarks != NULL; bookmarks = bookmarks->next)
+        mgr_append (mgr, bookmarks->data);
+
+    moo_bookmark_mgr_thaw (mgr);
+}
+
+/* replaces all bookmarks, see _moo_bookmark_mgr_add_list() */
+void
+_moo_bookmark_mgr_set_list (MooBookmarkMgr *mgr,
+                            GSList         *bookmarks)
+{
+    g_return_if_fail (MOO_IS_BOOKMARK_MGR (mgr));
+
+    moo_bookmark_mgr_freeze (mgr);
+    gtk_list_store_clear (mgr->priv->store);
+    _moo_bookmark_mgr_add_list (mgr, bookmarks);
+    moo_bookmark_mgr_thaw (mgr);
+}
+
+
+/* saves changes and updates menus right away rather than in the idle,
+ * so that nothing is lost if the application quits first */
+void
+_moo_bookmark_mgr_flush (MooBookmarkMgr *mgr)
+{
+    g_return_if_fail (MOO_IS_BOOKMARK_MGR (mgr));
 
-    gtk_list_store_append (mgr->priv->store, &iter);
-    gtk_list_store_set (mgr->priv->store, &iter,
-                        COLUMN_BOOKMARK, bookmark, -1);
+    if (mgr->priv->update_idle)
+    {
+        g_source_remove (mgr->priv->update_idle);
+        mgr_update_idle (mgr);
+    }
 }
 
 
 static void
 moo_bookmark_mgr_add_separator (MooBookmarkMgr *mgr)
 {
-    GtkTreeIter iter;
     g_return_if_fail (MOO_IS_BOOKMARK_MGR (mgr));
-    gtk_list_store_append (mgr->priv->store, &iter);
+    mgr_append (mgr, NULL);
 }
 
 
@@ -327,6 +432,7 @@ moo_bookmark_mgr_load (MooBookmarkMgr *mgr)
         return;
 
     mgr->priv->loading = TRUE;
+    moo_bookmark_mgr_freeze (mgr);
 
     for (node = root->children; node != NULL; node = node->next)
     {
@@ -371,6 +477,7 @@ moo_bookmark_mgr_load (MooBookmarkMgr *mgr)
         }
     }
 
+    moo_bookmark_mgr_thaw (mgr);
     mgr->priv->loading = FALSE;
 }
 
@@ -577,7 +684,7 @@ destroy_menu (UserInfo *info)
 }
 
 
-static gboolean
+static void
 mgr_update_menus (MooBookmarkMgr *mgr)
 {
     GSList *l;
@@ -585,8 +692,6 @@ mgr_update_menus (MooBookmarkMgr *mgr)
     GtkTreeModel *model = GTK_TREE_MODEL (mgr->priv->store);
     gboolean empty;
 
-    mgr->priv->update_idle = 0;
-
     empty = !gtk_tree_model_get_iter_first (model, &first);
 
     for (l = mgr->priv->users; l != NULL; l = l->next)
@@ -598,8 +703,6 @@ mgr_update_menus (MooBookmarkMgr *mgr)
         if (!empty)
             make_menu (mgr, info);
     }
-
-    return FALSE;
 }
 
 
@@ -777,7 +880,7 @@ static void moo_bookmark_mgr_update_menu(GtkMenuShell   *menu,
  */
 
 static GtkTreeModel *copy_bookmarks         (GtkListStore   *store);
-static void          copy_bookmarks_back    (GtkListStore   *store,
+static void          copy_bookmarks_back    (MooBookmarkMgr *mgr,
                                              GtkTreeModel   *model);
 static void          init_editor_dialog     (BkEditorXml    *xml);
 static void          dialog_response        (GtkWidget      *dialog,
@@ -850,7 +953,7 @@ dialog_response (GtkWidget      *dialog,
     }
 
     model = gtk_tree_view_get_model (xml->treeview);
-    copy_bookmarks_back (mgr->priv->store, model);
+    copy_bookmarks_back (mgr, model);
     gtk_widget_hide (dialog);
 }
 
@@ -865,8 +968,7 @@ copy_value (GtkTreeModel    *src,
     MooBookmark *bookmark;
 
     gtk_tree_model_get (src, iter, COLUMN_BOOKMARK, &bookmark, -1);
-    gtk_list_store_append (dest, &dest_iter);
-    gtk_list_store_set (dest, &dest_iter, COLUMN_BOOKMARK, bookmark, -1);
+    gtk_list_store_insert_with_values (dest, &dest_iter, -1, COLUMN_BOOKMARK, bookmark, -1);
     _moo_bookmark_free (bookmark);
 
     return FALSE;
@@ -885,13 +987,28 @@ copy_bookmarks (GtkListStore *store)
 
 
 static void
-copy_bookmarks_back (GtkListStore   *store,
+copy_bookmarks_back (MooBookmarkMgr *mgr,
                      GtkTreeModel   *model)
 {
-    gtk_list_store_clear (store);
-    gtk_tree_model_foreach (model,
-                            (GtkTreeModelForeachFunc) copy_value,
-                            store);
+    GSList *bookmarks = NULL;
+    GtkTreeIter iter;
+
+    if (gtk_tree_model_get_iter_first (model, &iter))
+    {
+        do
+        {
+            MooBookmark *bookmark = NULL;
+            gtk_tree_model_get (model, &iter, COLUMN_BOOKMARK, &bookmark, -1);
+            bookmarks = g_slist_prepend (bookmarks, bookmark);
+        }
+        while (gtk_tree_model_iter_next (model, &iter));
+    }
+
+    bookmarks = g_slist_reverse (bookmarks);
+    _moo_bookmark_mgr_set_list (mgr, bookmarks);
+
+    g_slist_foreach (bookmarks, (GFunc) _moo_bookmark_free, NULL);
+    g_slist_free (bookmarks);
 }
 
 
@@ -1171,10 +1288,9 @@ static void
 delete_clicked (BkEditorXml *xml)
 {
     GtkTreeIter iter;
-    GtkTreePath *path;
     GtkTreeSelection *selection;
     GtkListStore *store;
-    GList *paths, *rows = NULL, *l;
+    GList *paths, *l;
 
     store = GTK_LIST_STORE (gtk_tree_view_get_model (xml->treeview));
 
@@ -1184,30 +1300,18 @@ delete_clicked (BkEditorXml *xml)
     if (!paths)
         return;
 
-    for (l = paths; l != NULL; l = l->next)
-        rows = g_list_prepend (rows,
-                               gtk_tree_row_reference_new (GTK_TREE_MODEL (store),
-                                                           l->data));
-
-    for (l = rows; l != NULL; l = l->next)
-    {
-        if (gtk_tree_row_reference_valid (l->data))
-        {
-            path = gtk_tree_row_reference_get_path (l->data);
-            gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, path);
+    /* selected rows come in order, and removing them from the last one
+     * keeps paths of the rest valid */
+    for (l = g_list_last (paths); l != NULL; l = l->prev)
+        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, l->data))
             gtk_list_store_remove (store, &iter);
-            gtk_tree_path_free (path);
-        }
-    }
 
     g_object_set_data (G_OBJECT (store),
                        "moo-bookmarks-modified",
                        GINT_TO_POINTER (TRUE));
 
     g_list_foreach (paths, (GFunc) gtk_tree_path_free, NULL);
-    g_list_foreach (rows, (GFunc) gtk_tree_row_reference_free, NULL);
     g_list_free (paths);
-    g_list_free (rows);
 }
 
 
@@ -80,6 +80,11 @@ GtkTreeModel   *_moo_bookmark_mgr_get_model (MooBookmarkMgr *mgr);
 
 void            _moo_bookmark_mgr_add       (MooBookmarkMgr *mgr,
                                              MooBookmark    *bookmark);
+void            _moo_bookmark_mgr_add_list  (MooBookmarkMgr *mgr,
+                                             GSList         *bookmarks);
+void            _moo_bookmark_mgr_set_list  (MooBookmarkMgr *mgr,
+                                             GSList         *bookmarks);
+void            _moo_bookmark_mgr_flush     (MooBookmarkMgr *mgr);
 
 GtkWidget      *_moo_bookmark_mgr_get_editor(MooBookmarkMgr *mgr);
 
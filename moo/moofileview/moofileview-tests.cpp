@@ -0,0 +1,164 @@
+/*
+ *   moofileview-tests.cpp
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "moofileview/moofileview-tests.h"
+#include "moofileview/moobookmarkmgr.h"
+#include "moofileview/moofolder-private.h"
+#include "mooutils/mooutils-fs.h"
+#include "moocpp/fileutils.h"
+
+#define BENCH_FOLDER_FILES 2000
+#define BENCH_BOOKMARKS 10000
+
+static struct {
+    gstr folder;
+    MooBookmarkMgr *bookmark_mgr;
+    GSList *bookmarks;
+    GSList *saved_bookmarks;
+} bench_data;
+
+static void
+bench_folder_setup (void)
+{
+    mgw_errno_t err;
+    guint i;
+
+    bench_data.folder = g::build_filename (moo_test_get_working_dir (), "bench-folder");
+    TEST_ASSERT (_moo_mkdir_with_parents (bench_data.folder.get(), &err) == 0);
+
+    for (i = 0; i < BENCH_FOLDER_FILES; ++i)
+    {
+        gstr name = gstr::take (g_strdup_printf ("file%u.txt", i));
+        gstr filename = g::build_filename (bench_data.folder, name);
+        g_file_set_contents (filename.get(), "text\n", -1, NULL);
+    }
+}
+
+static void
+bench_folder_cleanup (void)
+{
+    _moo_remove_dir (bench_data.folder.get(), TRUE, NULL);
+    bench_data.folder.clear();
+}
+
+/* names and stat info, what the file selector shows first */
+static void
+bench_folder (void)
+{
+    MooFileSystem *fs;
+    MooFolder *folder;
+    GSList *files;
+
+    // new file system object, so that the folder is not cached
+    fs = MOO_FILE_SYSTEM (g_object_new (MOO_TYPE_FILE_SYSTEM, (const char*) NULL));
+    folder = _moo_file_system_get_folder (fs, bench_data.folder.get(), MOO_FILE_HAS_STAT, NULL);
+    TEST_ASSERT (folder != NULL);
+
+    if (folder)
+    {
+        while (folder->impl->done < STAGE_STAT)
+            g_main_context_iteration (NULL, TRUE);
+
+        files = _moo_folder_list_files (folder);
+        // and ".."
+        TEST_ASSERT_INT_EQ (g_slist_length (files), BENCH_FOLDER_FILES + 1);
+        g_slist_foreach (files, (GFunc) _moo_file_unref, NULL);
+        g_slist_free (files);
+
+        g_object_unref (folder);
+    }
+
+    g_object_unref (fs);
+}
+
+static void
+bench_bookmarks_setup (void)
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    guint i;
+
+    bench_data.bookmark_mgr = _moo_bookmark_mgr_new ();
+    model = _moo_bookmark_mgr_get_model (bench_data.bookmark_mgr);
+
+    // put back after every run
+    if (gtk_tree_model_get_iter_first (model, &iter))
+    {
+        do
+        {
+            MooBookmark *bookmark = NULL;
+            gtk_tree_model_get (model, &iter, MOO_BOOKMARK_MGR_COLUMN_BOOKMARK, &bookmark, -1);
+            bench_data.saved_bookmarks = g_slist_prepend (bench_data.saved_bookmarks, bookmark);
+        }
+        while (gtk_tree_model_iter_next (model, &iter));
+    }
+
+    bench_data.saved_bookmarks = g_slist_reverse (bench_data.saved_bookmarks);
+
+    for (i = 0; i < BENCH_BOOKMARKS; ++i)
+    {
+        gstr name = gstr::take (g_strdup_printf ("dir%u", i));
+        gstr path = g::build_filename (moo_test_get_working_dir (), name);
+        bench_data.bookmarks = g_slist_prepend (bench_data.bookmarks,
+                                                _moo_bookmark_new (name.get(), path.get(), GTK_STOCK_DIRECTORY));
+    }
+
+    bench_data.bookmarks = g_slist_reverse (bench_data.bookmarks);
+}
+
+static void
+bench_bookmarks_cleanup (void)
+{
+    g_slist_foreach (bench_data.bookmarks, (GFunc) _moo_bookmark_free, NULL);
+    g_slist_free (bench_data.bookmarks);
+    g_slist_foreach (bench_data.saved_bookmarks, (GFunc) _moo_bookmark_free, NULL);
+    g_slist_free (bench_data.saved_bookmarks);
+    g_object_unref (bench_data.bookmark_mgr);
+    bench_data.bookmarks = NULL;
+    bench_data.saved_bookmarks = NULL;
+    bench_data.bookmark_mgr = NULL;
+}
+
+/* including saving, which happens in an idle */
+static void
+bench_bookmarks (void)
+{
+    GtkTreeModel *model = _moo_bookmark_mgr_get_model (bench_data.bookmark_mgr);
+    guint n_saved = g_slist_length (bench_data.saved_bookmarks);
+
+    _moo_bookmark_mgr_add_list (bench_data.bookmark_mgr, bench_data.bookmarks);
+    TEST_ASSERT_INT_EQ (gtk_tree_model_iter_n_children (model, NULL), n_saved + BENCH_BOOKMARKS);
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+
+    _moo_bookmark_mgr_set_list (bench_data.bookmark_mgr, bench_data.saved_bookmarks);
+    TEST_ASSERT_INT_EQ (gtk_tree_model_iter_n_children (model, NULL), n_saved);
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+}
+
+void
+moo_test_moofileview (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("moofileview", "moofileview", NULL, NULL, NULL);
+
+    moo_test_suite_add_bench (suite, "folder", "listing a folder with many files",
+                              (MooTestFunc) bench_folder, (MooTestFunc) bench_folder_setup,
+                              (MooTestFunc) bench_folder_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "bookmarks", "adding and removing many bookmarks",
+                              (MooTestFunc) bench_bookmarks, (MooTestFunc) bench_bookmarks_setup,
+                              (MooTestFunc) bench_bookmarks_cleanup, NULL);
+}
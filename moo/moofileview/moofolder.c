@@ -21,6 +21,7 @@
 #include "moofileview/moofolder-private.h"
 #include "mooutils/mooutils-fs.h"
 #include "mooutils/mooutils-misc.h"
+#include "mooutils/mootrace.h"
 #include "marshals.h"
 #include <mooglib/moo-glib.h>
 #include <mooglib/moo-stat.h>
@@ -473,6 +474,7 @@ get_names (MooFolderImpl *impl)
     g_assert (impl->dir != NULL);
     g_assert (g_hash_table_size (impl->files) == 0);
 
+    MOO_TRACE_BEGIN_DETAIL ("folder names", impl->path);
     timer = g_timer_new ();
 
     file = _moo_file_new (impl->path, "..");
@@ -513,6 +515,9 @@ get_names (MooFolderImpl *impl)
 
     impl->done = STAGE_NAMES;
 
+    MOO_TRACE_COUNTER ("folder files", g_hash_table_size (impl->files));
+    MOO_TRACE_END ("folder names");
+
     PRINT_TIMES ("names folder %s: %f sec\n",
                  impl->path,
                  impl->debug.names_timer);
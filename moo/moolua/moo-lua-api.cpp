@@ -112,6 +112,19 @@ cfunc_MooEdit_append_text (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UN
     return 0;
 }
 
+static int
+cfunc_MooEdit_apply_batch (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_apply_batch");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEdit.apply_batch");
+    MooEdit *self = (MooEdit*) pself;
+    MooEditBatch *arg0 = (MooEditBatch*) moo_lua_get_arg_instance (L, first_arg + 0, "batch", MOO_TYPE_EDIT_BATCH, FALSE);
+    gboolean ret = moo_edit_apply_batch (self, arg0);
+    return moo_lua_push_bool (L, ret);
+}
+
 static int
 cfunc_MooEdit_begin_non_undoable_action (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
 {
@@ -524,6 +537,20 @@ cfunc_MooEdit_get_line_text_at_pos (gpointer pself, G_GNUC_UNUSED lua_State *L,
     return moo_lua_push_utf8 (L, ret);
 }
 
+static int
+cfunc_MooEdit_get_lines (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_get_lines");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEdit.get_lines");
+    MooEdit *self = (MooEdit*) pself;
+    int arg0 = moo_lua_get_arg_index (L, first_arg + 0, "first");
+    int arg1 = moo_lua_get_arg_index_opt (L, first_arg + 1, "last", -1);
+    char **ret = moo_edit_get_lines (self, arg0, arg1);
+    return moo_lua_push_strv (L, ret);
+}
+
 static int
 cfunc_MooEdit_get_n_views (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
 {
@@ -610,6 +637,18 @@ cfunc_MooEdit_get_selection_start_pos (gpointer pself, G_GNUC_UNUSED lua_State *
     return moo_lua_push_boxed (L, ret, GTK_TYPE_TEXT_ITER, FALSE);
 }
 
+static int
+cfunc_MooEdit_get_snapshot (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_get_snapshot");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEdit.get_snapshot");
+    MooEdit *self = (MooEdit*) pself;
+    gpointer ret = moo_edit_get_snapshot (self);
+    return moo_lua_push_object (L, (GObject*) ret, FALSE);
+}
+
 static int
 cfunc_MooEdit_get_start_pos (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
 {
@@ -1073,8 +1112,117 @@ cfunc_MooEdit_undo (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED in
 
 // methods of MooEditAction
 
+// methods of MooEditBatch
+
+static int
+cfunc_MooEditBatch_delete (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_batch_delete");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditBatch.delete");
+    MooEditBatch *self = (MooEditBatch*) pself;
+    int arg0 = moo_lua_get_arg_int (L, first_arg + 0, "start");
+    int arg1 = moo_lua_get_arg_int (L, first_arg + 1, "end");
+    moo_edit_batch_delete (self, arg0, arg1);
+    return 0;
+}
+
+static int
+cfunc_MooEditBatch_get_size (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_batch_get_size");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditBatch.get_size");
+    MooEditBatch *self = (MooEditBatch*) pself;
+    int ret = moo_edit_batch_get_size (self);
+    return moo_lua_push_int64 (L, ret);
+}
+
+static int
+cfunc_MooEditBatch_insert (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_batch_insert");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditBatch.insert");
+    MooEditBatch *self = (MooEditBatch*) pself;
+    int arg0 = moo_lua_get_arg_int (L, first_arg + 0, "pos");
+    const char* arg1 = moo_lua_get_arg_utf8 (L, first_arg + 1, "text", FALSE);
+    moo_edit_batch_insert (self, arg0, arg1);
+    return 0;
+}
+
+static int
+cfunc_MooEditBatch_replace (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_batch_replace");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditBatch.replace");
+    MooEditBatch *self = (MooEditBatch*) pself;
+    int arg0 = moo_lua_get_arg_int (L, first_arg + 0, "start");
+    int arg1 = moo_lua_get_arg_int (L, first_arg + 1, "end");
+    const char* arg2 = moo_lua_get_arg_utf8 (L, first_arg + 2, "text", FALSE);
+    moo_edit_batch_replace (self, arg0, arg1, arg2);
+    return 0;
+}
+
+static int
+cfunc_MooEditBatch_replace_line (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_batch_replace_line");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditBatch.replace_line");
+    MooEditBatch *self = (MooEditBatch*) pself;
+    int arg0 = moo_lua_get_arg_index (L, first_arg + 0, "line");
+    const char* arg1 = moo_lua_get_arg_utf8 (L, first_arg + 1, "text", FALSE);
+    moo_edit_batch_replace_line (self, arg0, arg1);
+    return 0;
+}
+
+static int
+cfunc_MooEditBatch_new (G_GNUC_UNUSED lua_State *L)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_batch_new");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditBatch.new");
+    gpointer ret = moo_edit_batch_new ();
+    return moo_lua_push_object (L, (GObject*) ret, FALSE);
+}
+
 // methods of MooEditBookmark
 
+// methods of MooEditSnapshot
+
+static int
+cfunc_MooEditSnapshot_get_line (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_snapshot_get_line");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditSnapshot.get_line");
+    MooEditSnapshot *self = (MooEditSnapshot*) pself;
+    int arg0 = moo_lua_get_arg_index (L, first_arg + 0, "line");
+    const char *ret = moo_edit_snapshot_get_line (self, arg0);
+    return moo_lua_push_utf8_copy (L, ret);
+}
+
+static int
+cfunc_MooEditSnapshot_get_line_count (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_edit_snapshot_get_line_count");
+#endif
+    MooLuaCurrentFunc cur_func ("MooEditSnapshot.get_line_count");
+    MooEditSnapshot *self = (MooEditSnapshot*) pself;
+    int ret = moo_edit_snapshot_get_line_count (self);
+    return moo_lua_push_int64 (L, ret);
+}
+
 // methods of MooEditTab
 
 static int
@@ -1822,6 +1970,43 @@ cfunc_MooLineView_clear (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUS
     return 0;
 }
 
+static int
+cfunc_MooLineView_flush (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_line_view_flush");
+#endif
+    MooLuaCurrentFunc cur_func ("MooLineView.flush");
+    MooLineView *self = (MooLineView*) pself;
+    moo_line_view_flush (self);
+    return 0;
+}
+
+static int
+cfunc_MooLineView_get_max_lines (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_line_view_get_max_lines");
+#endif
+    MooLuaCurrentFunc cur_func ("MooLineView.get_max_lines");
+    MooLineView *self = (MooLineView*) pself;
+    int ret = moo_line_view_get_max_lines (self);
+    return moo_lua_push_int64 (L, ret);
+}
+
+static int
+cfunc_MooLineView_set_max_lines (gpointer pself, G_GNUC_UNUSED lua_State *L, G_GNUC_UNUSED int first_arg)
+{
+#ifdef MOO_ENABLE_COVERAGE
+    moo_test_coverage_record ("lua", "moo_line_view_set_max_lines");
+#endif
+    MooLuaCurrentFunc cur_func ("MooLineView.set_max_lines");
+    MooLineView *self = (MooLineView*) pself;
+    int arg0 = moo_lua_get_arg_int (L, first_arg + 0, "max_lines");
+    moo_line_view_set_max_lines (self, arg0);
+    return 0;
+}
+
 // methods of MooMenuAction
 
 // methods of MooMenuMgr
@@ -2914,11 +3099,6 @@ static const luaL_Reg moo_lua_functions[] = {
     { NULL, NULL }
 };
 
-static const luaL_Reg Editor_lua_functions[] = {
-    { "instance", cfunc_MooEditor_instance },
-    { NULL, NULL }
-};
-
 static const luaL_Reg SaveInfo_lua_functions[] = {
     { "new_file", cfunc_MooSaveInfo_new_file },
     { "new_uri", cfunc_MooSaveInfo_new_uri },
@@ -2926,6 +3106,11 @@ static const luaL_Reg SaveInfo_lua_functions[] = {
     { NULL, NULL }
 };
 
+static const luaL_Reg Editor_lua_functions[] = {
+    { "instance", cfunc_MooEditor_instance },
+    { NULL, NULL }
+};
+
 static const luaL_Reg ReloadInfo_lua_functions[] = {
     { "new", cfunc_MooReloadInfo_new },
     { NULL, NULL }
@@ -2943,6 +3128,11 @@ static const luaL_Reg App_lua_functions[] = {
     { NULL, NULL }
 };
 
+static const luaL_Reg EditBatch_lua_functions[] = {
+    { "new", cfunc_MooEditBatch_new },
+    { NULL, NULL }
+};
+
 static void
 moo_lua_api_register (void)
 {
@@ -2970,6 +3160,7 @@ moo_lua_api_register (void)
 
     MooLuaMethodEntry methods_MooEdit[] = {
         { "append_text", cfunc_MooEdit_append_text },
+        { "apply_batch", cfunc_MooEdit_apply_batch },
         { "begin_non_undoable_action", cfunc_MooEdit_begin_non_undoable_action },
         { "begin_user_action", cfunc_MooEdit_begin_user_action },
         { "can_redo", cfunc_MooEdit_can_redo },
@@ -3003,6 +3194,7 @@ moo_lua_api_register (void)
         { "get_line_end_type", cfunc_MooEdit_get_line_end_type },
         { "get_line_text", cfunc_MooEdit_get_line_text },
         { "get_line_text_at_pos", cfunc_MooEdit_get_line_text_at_pos },
+        { "get_lines", cfunc_MooEdit_get_lines },
         { "get_n_views", cfunc_MooEdit_get_n_views },
         { "get_pos_at_line", cfunc_MooEdit_get_pos_at_line },
         { "get_pos_at_line_end", cfunc_MooEdit_get_pos_at_line_end },
@@ -3010,6 +3202,7 @@ moo_lua_api_register (void)
         { "get_selected_text", cfunc_MooEdit_get_selected_text },
         { "get_selection_end_pos", cfunc_MooEdit_get_selection_end_pos },
         { "get_selection_start_pos", cfunc_MooEdit_get_selection_start_pos },
+        { "get_snapshot", cfunc_MooEdit_get_snapshot },
         { "get_start_pos", cfunc_MooEdit_get_start_pos },
         { "get_status", cfunc_MooEdit_get_status },
         { "get_tab", cfunc_MooEdit_get_tab },
@@ -3048,6 +3241,23 @@ moo_lua_api_register (void)
     };
     moo_lua_register_methods (MOO_TYPE_EDIT, methods_MooEdit);
 
+    MooLuaMethodEntry methods_MooEditBatch[] = {
+        { "delete", cfunc_MooEditBatch_delete },
+        { "get_size", cfunc_MooEditBatch_get_size },
+        { "insert", cfunc_MooEditBatch_insert },
+        { "replace", cfunc_MooEditBatch_replace },
+        { "replace_line", cfunc_MooEditBatch_replace_line },
+        { NULL, NULL }
+    };
+    moo_lua_register_methods (MOO_TYPE_EDIT_BATCH, methods_MooEditBatch);
+
+    MooLuaMethodEntry methods_MooEditSnapshot[] = {
+        { "get_line", cfunc_MooEditSnapshot_get_line },
+        { "get_line_count", cfunc_MooEditSnapshot_get_line_count },
+        { NULL, NULL }
+    };
+    moo_lua_register_methods (MOO_TYPE_EDIT_SNAPSHOT, methods_MooEditSnapshot);
+
     MooLuaMethodEntry methods_MooEditTab[] = {
         { "get_active_view", cfunc_MooEditTab_get_active_view },
         { "get_doc", cfunc_MooEditTab_get_doc },
@@ -3121,6 +3331,9 @@ moo_lua_api_register (void)
 
     MooLuaMethodEntry methods_MooLineView[] = {
         { "clear", cfunc_MooLineView_clear },
+        { "flush", cfunc_MooLineView_flush },
+        { "get_max_lines", cfunc_MooLineView_get_max_lines },
+        { "set_max_lines", cfunc_MooLineView_set_max_lines },
         { NULL, NULL }
     };
     moo_lua_register_methods (MOO_TYPE_LINE_VIEW, methods_MooLineView);
@@ -3197,11 +3410,12 @@ void moo_lua_api_add_to_lua (lua_State *L)
 
     luaL_register (L, "moo", moo_lua_functions);
 
-    moo_lua_register_static_methods (L, "moo", "Editor", Editor_lua_functions);
     moo_lua_register_static_methods (L, "moo", "SaveInfo", SaveInfo_lua_functions);
+    moo_lua_register_static_methods (L, "moo", "Editor", Editor_lua_functions);
     moo_lua_register_static_methods (L, "moo", "ReloadInfo", ReloadInfo_lua_functions);
     moo_lua_register_static_methods (L, "moo", "OpenInfo", OpenInfo_lua_functions);
     moo_lua_register_static_methods (L, "moo", "App", App_lua_functions);
+    moo_lua_register_static_methods (L, "moo", "EditBatch", EditBatch_lua_functions);
 
     moo_lua_register_enum (L, "moo", MOO_TYPE_ACTION_CHECK_TYPE, "MOO_");
     moo_lua_register_enum (L, "moo", MOO_TYPE_CLOSE_RESPONSE, "MOO_");
@@ -5,6 +5,7 @@
 #include "medit-python.h"
 #include "mooutils/mooutils.h"
 #include "moopython/medit-python-init.h"
+#include "moopython/moopython-builtin.h"
 
 #ifdef MOO_ENABLE_PYTHON
 
@@ -113,7 +114,8 @@ moo_python_state_new (gboolean default_init)
 {
     MooPythonState *state;
 
-    g_return_val_if_fail (moo_python_enabled (), NULL);
+    if (!_moo_python_ensure_init ())
+        g_return_val_if_reached (NULL);
 
     state = g_slice_new0 (MooPythonState);
     state->locals = create_script_dict ("__script__");
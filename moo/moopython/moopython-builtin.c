@@ -30,6 +30,7 @@ G_END_DECLS
 #include "moopython/pygtk/moo-pygtk.h"
 #include "moopython/moopython-pygtkmod.h"
 #include "mooutils/mooutils-misc.h"
+#include "mooutils/mootrace.h"
 #include "moopython/pygtk/moo-mod.h"
 
 static gboolean create_moo_module (void)
@@ -52,25 +53,34 @@ static gboolean create_moo_module (void)
     return !PyErr_Occurred ();
 }
 
-gboolean
-_moo_python_builtin_init (void)
+/* Python is enabled, i.e. one of the init functions was called */
+static gboolean python_wanted;
+
+static gboolean
+init_python (void)
 {
-    if (!Py_IsInitialized ())
-    {
-        if (!moo_python_api_init ())
-        {
-            g_warning ("oops");
-            return FALSE;
-        }
+    static gboolean failed;
+    gboolean success = FALSE;
 
-        if (!_moo_module_init ())
-        {
-            g_warning ("could not initialize _moo module");
-            PyErr_Print ();
-            moo_python_api_deinit ();
-            return FALSE;
-        }
+    if (Py_IsInitialized ())
+        return TRUE;
+    if (failed)
+        return FALSE;
+
+    MOO_TRACE_BEGIN ("python init");
 
+    if (!moo_python_api_init ())
+    {
+        g_warning ("oops");
+    }
+    else if (!_moo_module_init ())
+    {
+        g_warning ("could not initialize _moo module");
+        PyErr_Print ();
+        moo_python_api_deinit ();
+    }
+    else
+    {
         reset_log_func ();
 
         if (!create_moo_module ())
@@ -78,10 +88,27 @@ _moo_python_builtin_init (void)
             g_warning ("could not initialize moo module");
             PyErr_Print ();
             moo_python_api_deinit ();
-            return FALSE;
+        }
+        else
+        {
+            success = TRUE;
         }
     }
 
+    MOO_TRACE_END ("python init");
+
+    failed = !success;
+    return success;
+}
+
+gboolean
+_moo_python_builtin_init (void)
+{
+    python_wanted = TRUE;
+
+    if (!init_python ())
+        return FALSE;
+
     if (!moo_plugin_loader_lookup (MOO_PYTHON_PLUGIN_LOADER_ID))
     {
         MooPluginLoader *loader = _moo_python_get_plugin_loader ();
@@ -91,3 +118,65 @@ _moo_python_builtin_init (void)
 
     return TRUE;
 }
+
+
+/* Loader which starts the interpreter when the first Python module
+ * is actually loaded, so that it's not done at startup if all Python
+ * plugins are loaded on demand. */
+
+static void
+lazy_load_module (const char *module_file,
+                  const char *ini_file,
+                  G_GNUC_UNUSED gpointer data)
+{
+    MooPluginLoader *loader;
+
+    if (!init_python ())
+        return;
+
+    loader = _moo_python_get_plugin_loader ();
+    loader->load_module (module_file, ini_file, loader->data);
+    _moo_python_plugin_loader_free (loader);
+}
+
+static void
+lazy_load_plugin (const char      *plugin_file,
+                  const char      *plugin_id,
+                  MooPluginInfo   *info,
+                  MooPluginParams *params,
+                  const char      *ini_file,
+                  G_GNUC_UNUSED gpointer data)
+{
+    MooPluginLoader *loader;
+
+    if (!init_python ())
+        return;
+
+    loader = _moo_python_get_plugin_loader ();
+    loader->load_plugin (plugin_file, plugin_id, info, params, ini_file, loader->data);
+    _moo_python_plugin_loader_free (loader);
+}
+
+void
+_moo_python_builtin_init_lazy (void)
+{
+    MooPluginLoader loader = { lazy_load_module, lazy_load_plugin, NULL };
+
+    python_wanted = TRUE;
+
+    if (!moo_plugin_loader_lookup (MOO_PYTHON_PLUGIN_LOADER_ID))
+        moo_plugin_loader_register (&loader, MOO_PYTHON_PLUGIN_LOADER_ID);
+}
+
+/* Starts the interpreter if Python is enabled and it's not running
+ * yet, for code which runs Python without loading a plugin module,
+ * like Python user tools. */
+gboolean
+_moo_python_ensure_init (void)
+{
+    if (Py_IsInitialized ())
+        return TRUE;
+    if (!python_wanted)
+        return FALSE;
+    return init_python ();
+}
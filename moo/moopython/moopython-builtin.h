@@ -21,7 +21,9 @@
 G_BEGIN_DECLS
 
 
-gboolean _moo_python_builtin_init (void);
+gboolean _moo_python_builtin_init      (void);
+void     _moo_python_builtin_init_lazy (void);
+gboolean _moo_python_ensure_init       (void);
 
 
 G_END_DECLS
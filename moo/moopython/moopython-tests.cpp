@@ -1,6 +1,8 @@
 #include "moopython-utils.h"
 #include "moopython-tests.h"
 #include "medit-python.h"
+#include "moopython-builtin.h"
+#include "mooutils/mooutils-misc.h"
 
 static void
 moo_test_run_python_file (const char *basename)
@@ -39,6 +41,10 @@ add_test (MooTestSuite &suite, const char *name, const char *description, const
 void
 moo_test_python (void)
 {
+    // the interpreter is started on demand, see _moo_python_builtin_init_lazy()
+    if (!moo_getenv_bool ("MOO_DISABLE_PYTHON"))
+        _moo_python_builtin_init ();
+
     if (moo_python_enabled ())
     {
         MooTestSuite& suite = moo_test_suite_new ("MooPython", "Python scripting tests", NULL, NULL, NULL);
@@ -16,10 +16,14 @@
 #include "moo-test-macros.h"
 #include "mooutils/mooutils-fs.h"
 #include "mooutils/mooutils-messages.h"
+#include "mooutils/mooutils-misc.h"
 #include "moocpp/gstr.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
 #include <vector>
 
 struct TestAssertInfo
@@ -43,6 +47,8 @@ struct MooTest
     gstr name;
     gstr description;
     MooTestFunc func;
+    MooTestFunc setup_func;
+    MooTestFunc cleanup_func;
     gpointer data;
     std::vector<TestAssertInfo> failed_asserts;
 };
@@ -52,6 +58,7 @@ struct MooTestSuite
     gstr name;
     gstr description;
     std::vector<MooTest> tests;
+    std::vector<MooTest> benches;
     MooTestSuiteInit init_func;
     MooTestSuiteCleanup cleanup_func;
     gpointer data;
@@ -70,6 +77,8 @@ struct MooTestRegistry
         guint suites_passed;
         guint tests_passed;
         guint asserts_passed;
+        guint benches;
+        guint benches_passed;
     } tr;
 };
 
@@ -107,11 +116,50 @@ moo_test_suite_add_test(MooTestSuite &ts,
     test.name.copy(name);
     test.description.copy(description);
     test.func = test_func;
+    test.setup_func = nullptr;
+    test.cleanup_func = nullptr;
     test.data = data;
 
     ts.tests.push_back(std::move(test));
 }
 
+void
+moo_test_suite_add_bench(MooTestSuite &ts,
+                         const char   *name,
+                         const char   *description,
+                         MooTestFunc   bench_func,
+                         MooTestFunc   setup_func,
+                         MooTestFunc   cleanup_func,
+                         gpointer      data)
+{
+    g_return_if_fail(name != NULL);
+    g_return_if_fail(bench_func != NULL);
+
+    MooTest bench;
+    bench.name.copy(name);
+    bench.description.copy(description);
+    bench.func = bench_func;
+    bench.setup_func = setup_func;
+    bench.cleanup_func = cleanup_func;
+    bench.data = data;
+
+    ts.benches.push_back(std::move(bench));
+}
+
+static void
+print_failed_asserts (const MooTest &test)
+{
+    int count = 1;
+    for (const auto& ai: test.failed_asserts)
+    {
+        fprintf (stdout, "    %d. %s", count, !ai.file.empty() ? ai.file.get() : "<unknown>");
+        if (ai.line > -1)
+            fprintf (stdout, ":%d", ai.line);
+        fprintf (stdout, " - %s\n", !ai.text.empty() ? ai.text.get() : "FAILED");
+        ++count;
+    }
+}
+
 static gboolean
 run_test(MooTest        &test,
          MooTestSuite   &ts,
@@ -143,18 +191,7 @@ run_test(MooTest        &test,
     else
         fprintf (stdout, "passed\n");
 
-    if (!test.failed_asserts.empty())
-    {
-        int count = 1;
-        for (const auto& ai: test.failed_asserts)
-        {
-            fprintf (stdout, "    %d. %s", count, !ai.file.empty() ? ai.file.get() : "<unknown>");
-            if (ai.line > -1)
-                fprintf (stdout, ":%d", ai.line);
-            fprintf (stdout, " - %s\n", !ai.text.empty() ? ai.text.get() : "FAILED");
-            ++count;
-        }
-    }
+    print_failed_asserts (test);
 
     registry.tr.tests += 1;
     if (!failed)
@@ -186,6 +223,10 @@ run_suite (MooTestSuite   &ts,
     {
         for (auto& t: ts.tests)
             passed = run_test(t, ts, opts) && passed;
+
+        if (opts & MOO_TEST_LIST_ONLY)
+            for (const auto& b: ts.benches)
+                fprintf (stdout, "  Bench: %s - %s\n", b.name.get(), b.description.get());
     }
 
     if (run && ts.cleanup_func)
@@ -470,6 +511,267 @@ moo_test_load_data_file (const char *basename)
 }
 
 
+/************************************************************************************
+ * benchmarks
+ */
+
+#define BENCH_WARMUP_RUNS   2
+#define BENCH_MIN_RUNS      5
+#define BENCH_MAX_RUNS      1000
+#define BENCH_MIN_TIME      1.  /* seconds */
+
+static volatile gint n_allocations;
+static gboolean allocations_counted;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+    g_atomic_int_inc (&n_allocations);
+    return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,
+                  gsize    n_bytes)
+{
+    if (!mem)
+        g_atomic_int_inc (&n_allocations);
+    return realloc (mem, n_bytes);
+}
+
+void
+moo_test_count_allocations (void)
+{
+    static GMemVTable vtable = {
+        counting_malloc,
+        counting_realloc,
+        free,
+        NULL, NULL, NULL
+    };
+
+    g_mem_set_vtable (&vtable);
+
+    // newer GLib ignores the vtable
+    allocations_counted = !g_mem_is_system_malloc ();
+
+    if (allocations_counted)
+        g_slice_set_config (G_SLICE_CONFIG_ALWAYS_MALLOC, TRUE);
+}
+
+struct BenchStats
+{
+    double min;
+    double max;
+    double mean;
+    double median;
+    double stddev;
+};
+
+static BenchStats
+bench_stats (std::vector<double> samples)
+{
+    BenchStats st = {0, 0, 0, 0, 0};
+    size_t n = samples.size();
+
+    if (n == 0)
+        return st;
+
+    std::sort (samples.begin(), samples.end());
+
+    st.min = samples.front();
+    st.max = samples.back();
+    st.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+
+    for (double s: samples)
+        st.mean += s;
+    st.mean /= n;
+
+    for (double s: samples)
+        st.stddev += (s - st.mean) * (s - st.mean);
+    st.stddev = n > 1 ? sqrt (st.stddev / (n - 1)) : 0;
+
+    return st;
+}
+
+static void
+json_append_stats (GString          *json,
+                   const char       *name,
+                   const BenchStats &st)
+{
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    // numbers must not depend on the locale
+#define APPEND_NUMBER(key, value, sep)                                      \
+    g_string_append_printf (json, "\"%s\": %s%s", key,                     \
+                            g_ascii_formatd (buf, sizeof buf, "%.9g", value), \
+                            sep)
+
+    g_string_append_printf (json, "      \"%s\": {", name);
+    APPEND_NUMBER ("min", st.min, ", ");
+    APPEND_NUMBER ("max", st.max, ", ");
+    APPEND_NUMBER ("mean", st.mean, ", ");
+    APPEND_NUMBER ("median", st.median, ", ");
+    APPEND_NUMBER ("stddev", st.stddev, "}");
+
+#undef APPEND_NUMBER
+}
+
+static void
+run_bench (MooTest      &bench,
+           MooTestSuite &ts,
+           GString      *json)
+{
+    MooTestEnv env;
+    std::vector<double> wall, cpu;
+    guint allocations = 0;
+    double total = 0;
+    GTimer *timer;
+    int i;
+
+    env.suite_data = ts.data;
+    env.test_data = bench.data;
+
+    fprintf (stdout, "  Bench: %s ... ", bench.name.get());
+    fflush (stdout);
+
+    registry.current_test = &bench;
+    timer = g_timer_new ();
+
+    if (bench.setup_func)
+        bench.setup_func (&env);
+
+    for (i = 0; i < BENCH_WARMUP_RUNS && bench.failed_asserts.empty(); ++i)
+        bench.func (&env);
+
+    while (bench.failed_asserts.empty() &&
+           (wall.size() < BENCH_MIN_RUNS ||
+            (total < BENCH_MIN_TIME && wall.size() < BENCH_MAX_RUNS)))
+    {
+        guint allocations_before = (guint) g_atomic_int_get (&n_allocations);
+        clock_t cpu_before = clock ();
+
+        g_timer_start (timer);
+        bench.func (&env);
+        wall.push_back (g_timer_elapsed (timer, NULL));
+        cpu.push_back (double (clock () - cpu_before) / CLOCKS_PER_SEC);
+        allocations += (guint) g_atomic_int_get (&n_allocations) - allocations_before;
+        total += wall.back();
+    }
+
+    if (bench.cleanup_func)
+        bench.cleanup_func (&env);
+
+    registry.current_test = NULL;
+    g_timer_destroy (timer);
+
+    registry.tr.benches += 1;
+
+    if (!bench.failed_asserts.empty())
+    {
+        fprintf (stdout, "FAILED\n");
+        print_failed_asserts (bench);
+        return;
+    }
+
+    registry.tr.benches_passed += 1;
+
+    BenchStats wall_st = bench_stats (wall);
+    BenchStats cpu_st = bench_stats (cpu);
+
+    fprintf (stdout, "%u runs, median %.3f ms (min %.3f, max %.3f, stddev %.3f), cpu %.3f ms",
+             (guint) wall.size(), wall_st.median * 1000, wall_st.min * 1000,
+             wall_st.max * 1000, wall_st.stddev * 1000, cpu_st.median * 1000);
+    if (allocations_counted)
+        fprintf (stdout, ", %u allocations", allocations / (guint) wall.size());
+    fprintf (stdout, "\n");
+
+    if (json->len)
+        g_string_append (json, ",\n");
+
+    gstr name = gstr::take (g_strdup_printf ("%s/%s", ts.name.get(), bench.name.get()));
+    g_string_append (json, "    {\n      \"name\": ");
+    _moo_string_append_json (json, name.get());
+    g_string_append_printf (json, ",\n      \"runs\": %u,\n", (guint) wall.size());
+    json_append_stats (json, "wall", wall_st);
+    g_string_append (json, ",\n");
+    json_append_stats (json, "cpu", cpu_st);
+    if (allocations_counted)
+        g_string_append_printf (json, ",\n      \"allocations\": %u\n    }", allocations / (guint) wall.size());
+    else
+        g_string_append (json, ",\n      \"allocations\": null\n    }");
+}
+
+static void
+run_bench_suite (MooTestSuite &ts,
+                 const char   *filter,
+                 GString      *json)
+{
+    std::vector<MooTest*> benches;
+
+    for (auto& b: ts.benches)
+    {
+        gstr name = gstr::take (g_strdup_printf ("%s/%s", ts.name.get(), b.name.get()));
+        if (!filter || g_pattern_match_simple (filter, name.get()))
+            benches.push_back (&b);
+    }
+
+    if (benches.empty())
+        return;
+
+    if (ts.init_func && !ts.init_func(ts.data))
+        return;
+
+    registry.current_suite = &ts;
+
+    g_print ("Suite: %s\n", ts.name.get());
+
+    for (auto b: benches)
+        run_bench (*b, ts, json);
+
+    if (ts.cleanup_func)
+        ts.cleanup_func(ts.data);
+
+    registry.current_suite = NULL;
+}
+
+gboolean
+moo_test_run_benchmarks (const char     *filter,
+                         const char     *output_file,
+                         G_GNUC_UNUSED MooTestOptions opts)
+{
+    GString *json = g_string_new (NULL);
+
+    fprintf (stdout, "\n");
+
+    for (auto& ts: registry.test_suites)
+        run_bench_suite (ts, filter, json);
+
+    fprintf (stdout, "\n");
+    fprintf (stdout, "Run Summary: %u benchmarks, %u failed\n",
+             registry.tr.benches, registry.tr.benches - registry.tr.benches_passed);
+    fprintf (stdout, "\n");
+
+    if (output_file)
+    {
+        GError *error = NULL;
+
+        g_string_prepend (json, allocations_counted ?
+                                    "{\n  \"allocations_counted\": true,\n  \"benchmarks\": [\n" :
+                                    "{\n  \"allocations_counted\": false,\n  \"benchmarks\": [\n");
+        g_string_append (json, "\n  ]\n}\n");
+
+        if (!g_file_set_contents (output_file, json->str, json->len, &error))
+        {
+            g_critical ("could not save file %s: %s", output_file, moo_error_message (error));
+            g_error_free (error);
+        }
+    }
+
+    g_string_free (json, TRUE);
+    return moo_test_get_result ();
+}
+
+
 /************************************************************************************
  * coverage
  */
@@ -31,7 +31,8 @@ struct MooTestEnv
 typedef enum {
     MOO_TEST_LIST_ONLY   = 1 << 0,
     MOO_TEST_FATAL_ERROR = 1 << 1,
-    MOO_TEST_INSTALLED   = 1 << 2
+    MOO_TEST_INSTALLED   = 1 << 2,
+    MOO_TEST_BENCHMARKS  = 1 << 3
 } MooTestOptions;
 
 typedef struct MooTestSuite MooTestSuite;
@@ -50,9 +51,28 @@ void             moo_test_suite_add_test    (MooTestSuite       &ts,
                                              MooTestFunc         test_func,
                                              gpointer            data);
 
+/* A benchmark runs bench_func repeatedly and measures it, only in
+ * benchmark mode. setup_func and cleanup_func may be NULL, they are
+ * called once before the first run and after the last one. */
+void             moo_test_suite_add_bench   (MooTestSuite       &ts,
+                                             const char         *name,
+                                             const char         *description,
+                                             MooTestFunc         bench_func,
+                                             MooTestFunc         setup_func,
+                                             MooTestFunc         cleanup_func,
+                                             gpointer            data);
+
 gboolean         moo_test_run_tests         (const gstrvec&      tests,
                                              const char         *coverage_file,
                                              MooTestOptions      opts);
+/* Runs benchmarks whose "suite/name" matches filter, a glob pattern
+ * (all if NULL), and writes results to output_file in JSON format */
+gboolean         moo_test_run_benchmarks    (const char         *filter,
+                                             const char         *output_file,
+                                             MooTestOptions      opts);
+/* Makes benchmarks report memory allocations. Must be called before
+ * anything is allocated; does nothing if GLib does not let it count. */
+void             moo_test_count_allocations (void);
 void             moo_test_cleanup           (void);
 gboolean         moo_test_get_result        (void);
 
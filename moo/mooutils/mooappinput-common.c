@@ -162,3 +162,17 @@ _moo_app_input_channel_commit (GString **buffer)
     if (freeme)
         g_string_free (freeme, TRUE);
 }
+
+/* data must be nul-terminated */
+void
+_moo_app_input_channel_dispatch (const char *data,
+                                 gsize       len)
+{
+    if (!len)
+    {
+        moo_dmsg ("got empty command");
+        return;
+    }
+
+    exec_callback (data[0], data + 1, len - 1);
+}
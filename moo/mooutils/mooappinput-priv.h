@@ -35,6 +35,21 @@ struct MooAppInput
 #define MOO_APP_INPUT_IPC_MAGIC_CHAR 'I'
 #define MOO_APP_INPUT_MAX_BUFFER_SIZE 4096
 
+/* Unix sockets: the receiver greets every new connection with one
+ * MOO_APP_INPUT_HELLO byte. A client which gets it sends one
+ * MOO_APP_INPUT_FRAMED byte, then messages as a 4-byte big-endian
+ * length followed by the message itself, and the receiver answers
+ * every complete message with one MOO_APP_INPUT_ACK byte. A connection
+ * may carry any number of messages.
+ * Older versions neither greet nor read the greeting; they send
+ * zero-terminated messages and expect no acks. The receiver tells the
+ * two apart by the first byte, and a client which is not greeted in
+ * time falls back to the old format. */
+#define MOO_APP_INPUT_HELLO '\005'
+#define MOO_APP_INPUT_FRAMED '\002'
+#define MOO_APP_INPUT_ACK '\006'
+#define MOO_APP_INPUT_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+
 extern MooAppInput *_moo_app_input_instance;
 
 InputChannel *_moo_app_input_channel_new        (const char     *appname,
@@ -45,5 +60,7 @@ char         *_moo_app_input_channel_get_path   (InputChannel   *ch);
 const char   *_moo_app_input_channel_get_name   (InputChannel   *ch);
 
 void          _moo_app_input_channel_commit     (GString **buffer);
+void          _moo_app_input_channel_dispatch   (const char     *data,
+                                                 gsize           len);
 
 G_END_DECLS
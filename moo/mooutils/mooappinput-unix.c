@@ -30,6 +30,7 @@ MGW_ERROR_IF_NOT_SHARED_LIBC
 
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include "mooapp-ipc.h"
@@ -38,6 +39,19 @@ MGW_ERROR_IF_NOT_SHARED_LIBC
 #include "mooutils-debug.h"
 
 #define INPUT_PREFIX "in-"
+#define READ_CHUNK_SIZE 65536
+/* how long a client waits for the greeting, in milliseconds; an
+ * instance which does not greet in time gets the old format */
+#define HELLO_TIMEOUT 1000
+/* how long a client waits for the running instance to confirm
+ * that it got the message, in milliseconds */
+#define ACK_TIMEOUT 5000
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
 
 
 static const char *
@@ -186,15 +200,10 @@ try_send (const char *pipe_dir_name,
     filename = get_pipe_path (pipe_dir_name, name);
     moo_dmsg ("try_send: sending data to `%s'", filename);
 
-    if (!g_file_test (filename, G_FILE_TEST_EXISTS))
-    {
-        moo_dmsg ("try_send: file %s doesn't exist", filename);
-        goto out;
-    }
-
+    /* connect() fails right away if there is no socket, no need
+     * to stat it first */
     result = do_send (filename, iheader, data, data_len);
 
-out:
     g_free (filename);
     return result;
 }
@@ -309,7 +318,8 @@ do_write (int         fd,
         ssize_t n;
 
         errno = 0;
-        n = write (fd, data, data_len);
+        /* the other side may go away, that's not a reason to die */
+        n = send (fd, data, data_len, SEND_FLAGS);
 
         if (n < 0)
         {
@@ -333,11 +343,18 @@ do_write (int         fd,
 #define UNIX_PATH_MAX 108
 #endif
 
+typedef enum {
+    CONN_UNKNOWN,
+    CONN_LEGACY,    /* zero-terminated messages */
+    CONN_FRAMED     /* length-prefixed messages, acknowledged */
+} ConnectionMode;
+
 typedef struct {
     int fd;
     GIOChannel *io;
     guint io_watch;
-    GString *buffer; /* messages are zero-terminated */
+    GString *buffer; /* see mooappinput-priv.h */
+    ConnectionMode mode;
     InputChannel *ch;
 } Connection;
 
@@ -421,50 +438,168 @@ input_channel_shutdown (InputChannel *ch)
     }
 }
 
+static guint32
+get_message_len (const char *data)
+{
+    const guchar *p = (const guchar*) data;
+    return ((guint32) p[0] << 24) | ((guint32) p[1] << 16) |
+           ((guint32) p[2] << 8) | (guint32) p[3];
+}
+
+static void
+free_messages (GSList *messages)
+{
+    GSList *l;
+    for (l = messages; l != NULL; l = l->next)
+        g_string_free ((GString*) l->data, TRUE);
+    g_slist_free (messages);
+}
+
+/* Same as take_messages(), for zero-terminated messages */
 static gboolean
-read_input (G_GNUC_UNUSED GIOChannel *source,
-            G_GNUC_UNUSED GIOCondition condition,
-            Connection *conn)
+take_legacy_messages (Connection  *conn,
+                      GSList     **messages)
 {
-    char c;
-    int n;
-    gboolean do_commit = FALSE;
+    gsize pos = 0;
+    const char *end;
 
-    errno = 0;
+    *messages = NULL;
+
+    while ((end = (const char*) memchr (conn->buffer->str + pos, 0, conn->buffer->len - pos)))
+    {
+        gsize len = end - (conn->buffer->str + pos);
+        *messages = g_slist_prepend (*messages,
+                                     g_string_new_len (conn->buffer->str + pos, len));
+        pos += len + 1;
+    }
+
+    g_string_erase (conn->buffer, 0, pos);
+    *messages = g_slist_reverse (*messages);
 
-    while ((n = read (conn->fd, &c, 1)) > 0)
+    if (conn->buffer->len > MOO_APP_INPUT_MAX_MESSAGE_SIZE)
     {
-        if (c == 0)
+        g_warning ("%s: message too long", G_STRFUNC);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Moves complete messages from the connection buffer into the returned
+ * list. Returns FALSE if the peer sent garbage. */
+static gboolean
+take_messages (Connection  *conn,
+               GSList     **messages)
+{
+    gsize pos = 0;
+    gboolean result = TRUE;
+
+    *messages = NULL;
+
+    while (conn->buffer->len - pos >= 4)
+    {
+        guint32 len = get_message_len (conn->buffer->str + pos);
+
+        if (len > MOO_APP_INPUT_MAX_MESSAGE_SIZE)
         {
-            do_commit = TRUE;
+            g_warning ("%s: message too long", G_STRFUNC);
+            result = FALSE;
             break;
         }
 
-        g_string_append_c (conn->buffer, c);
+        if (conn->buffer->len - pos - 4 < len)
+            break;
+
+        *messages = g_slist_prepend (*messages,
+                                     g_string_new_len (conn->buffer->str + pos + 4, len));
+        pos += 4 + len;
     }
 
+    g_string_erase (conn->buffer, 0, pos);
+    *messages = g_slist_reverse (*messages);
+    return result;
+}
+
+static gboolean
+read_input (G_GNUC_UNUSED GIOChannel *source,
+            GIOCondition  condition,
+            Connection   *conn)
+{
+    char buf[READ_CHUNK_SIZE];
+    GSList *messages = NULL;
+    int n;
+
+    errno = 0;
+
+    /* the watch says there is something to read, so this won't block;
+     * read once and let the main loop call us again if there is more */
+    n = read (conn->fd, buf, sizeof buf);
+
     if (n <= 0)
     {
+        if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            return TRUE;
+
         if (n < 0)
             moo_dmsg ("%s", g_strerror (errno));
+        else if (condition & G_IO_ERR)
+            moo_dmsg ("G_IO_ERR");
         else
             moo_dmsg ("EOF");
+
         goto remove;
     }
-    else
+
+    moo_dmsg ("got %d bytes", n);
+    g_string_append_len (conn->buffer, buf, n);
+
+    if (conn->mode == CONN_UNKNOWN)
     {
-        moo_dmsg ("got bytes: '%s'", conn->buffer->str);
+        if (conn->buffer->str[0] == MOO_APP_INPUT_FRAMED)
+        {
+            conn->mode = CONN_FRAMED;
+            g_string_erase (conn->buffer, 0, 1);
+        }
+        else
+        {
+            moo_dmsg ("old client");
+            conn->mode = CONN_LEGACY;
+        }
     }
 
-    if (do_commit)
-        _moo_app_input_channel_commit (&conn->buffer);
-
-    if (!do_commit && (condition & (G_IO_ERR | G_IO_HUP)))
+    if (!(conn->mode == CONN_FRAMED ?
+            take_messages (conn, &messages) :
+            take_legacy_messages (conn, &messages)))
     {
-        moo_dmsg ("%s", (condition & G_IO_ERR) ? "G_IO_ERR" : "G_IO_HUP");
+        free_messages (messages);
         goto remove;
     }
 
+    if (messages && conn->mode == CONN_FRAMED)
+    {
+        guint n_messages = g_slist_length (messages);
+        char *acks = (char*) g_malloc (n_messages);
+
+        /* acknowledge before dispatching: the message is in our hands,
+         * and the connection may be gone once a command has run */
+        memset (acks, MOO_APP_INPUT_ACK, n_messages);
+        do_write (conn->fd, acks, n_messages);
+        g_free (acks);
+    }
+
+    if (messages)
+    {
+        GSList *l;
+
+        for (l = messages; l != NULL; l = l->next)
+        {
+            GString *msg = (GString*) l->data;
+            _moo_app_input_channel_dispatch (msg->str, msg->len);
+        }
+
+        free_messages (messages);
+    }
+
     return TRUE;
 
 remove:
@@ -481,6 +616,7 @@ accept_connection (G_GNUC_UNUSED GIOChannel *source,
 {
     Connection *conn;
     socklen_t dummy;
+    char hello;
 
     if (condition & G_IO_ERR)
     {
@@ -509,6 +645,11 @@ accept_connection (G_GNUC_UNUSED GIOChannel *source,
         return TRUE;
     }
 
+    /* old clients never read it, and may be gone already */
+    hello = MOO_APP_INPUT_HELLO;
+    if (send (conn->fd, &hello, 1, SEND_FLAGS) != 1)
+        moo_dmsg ("could not send greeting");
+
     ch->connections = g_slist_prepend (ch->connections, conn);
     return TRUE;
 }
@@ -657,6 +798,67 @@ _moo_app_input_channel_free (InputChannel *ch)
 }
 
 
+/* returns 1 if got a byte, 0 on timeout, -1 if the connection is closed */
+static int
+read_byte (int   fd,
+           int   timeout,
+           char *c)
+{
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    do
+    {
+        errno = 0;
+        n = poll (&pfd, 1, timeout);
+    }
+    while (n < 0 && errno == EINTR);
+
+    if (n == 0)
+        return 0;
+
+    if (n < 0)
+    {
+        g_warning ("in poll: %s", g_strerror (errno));
+        return -1;
+    }
+
+    do
+    {
+        errno = 0;
+        n = read (fd, c, 1);
+    }
+    while (n < 0 && errno == EINTR);
+
+    return n == 1 ? 1 : -1;
+}
+
+static gboolean
+wait_for_ack (int fd)
+{
+    char c;
+
+    switch (read_byte (fd, ACK_TIMEOUT, &c))
+    {
+        case 0:
+            /* it may be hung, let the caller start a new instance */
+            moo_dmsg ("wait_for_ack: timeout");
+            return FALSE;
+
+        case 1:
+            if (c == MOO_APP_INPUT_ACK)
+                return TRUE;
+            /* fall through */
+
+        default:
+            moo_dmsg ("wait_for_ack: connection closed");
+            return FALSE;
+    }
+}
+
 static gboolean
 do_send (const char *filename,
          const char *iheader,
@@ -664,33 +866,77 @@ do_send (const char *filename,
          gssize      data_len)
 {
     int fd;
-    gboolean result = TRUE;
+    gboolean result;
+    GString *msg;
+    guint32 len;
+    char c;
 
     g_return_val_if_fail (filename != NULL, FALSE);
     g_return_val_if_fail (data != NULL || data_len == 0, FALSE);
 
-    if (!try_connect (filename, &fd))
-        return FALSE;
-
     if (data_len < 0)
         data_len = strlen (data);
 
+    /* room for the frame header, see below */
+    msg = g_string_sized_new (data_len + 64);
+    g_string_set_size (msg, 5);
+
     if (iheader)
     {
-        char c = MOO_APP_INPUT_IPC_MAGIC_CHAR;
-        result = do_write (fd, &c, 1) &&
-                 do_write (fd, iheader, strlen (iheader));
+        g_string_append_c (msg, MOO_APP_INPUT_IPC_MAGIC_CHAR);
+        g_string_append (msg, iheader);
+    }
+
+    g_string_append_len (msg, data, data_len);
+
+    len = msg->len - 5;
+
+    if (len > MOO_APP_INPUT_MAX_MESSAGE_SIZE)
+    {
+        g_critical ("%s: message too long", G_STRFUNC);
+        g_string_free (msg, TRUE);
+        return FALSE;
     }
 
-    if (result && data_len)
-        result = do_write (fd, data, data_len);
+    if (!try_connect (filename, &fd))
+    {
+        g_string_free (msg, TRUE);
+        return FALSE;
+    }
 
-    if (result)
+    switch (read_byte (fd, HELLO_TIMEOUT, &c))
     {
-        char c = 0;
-        result = do_write (fd, &c, 1);
+        case 1:
+            if (c != MOO_APP_INPUT_HELLO)
+            {
+                g_warning ("%s: unexpected greeting", G_STRFUNC);
+                result = FALSE;
+                break;
+            }
+
+            msg->str[0] = MOO_APP_INPUT_FRAMED;
+            msg->str[1] = (char) ((len >> 24) & 0xff);
+            msg->str[2] = (char) ((len >> 16) & 0xff);
+            msg->str[3] = (char) ((len >> 8) & 0xff);
+            msg->str[4] = (char) (len & 0xff);
+
+            result = do_write (fd, msg->str, msg->len) && wait_for_ack (fd);
+            break;
+
+        case 0:
+            /* an older version, or too busy to greet us; the old format
+             * works with both, without any confirmation */
+            moo_dmsg ("do_send: no greeting, sending a zero-terminated message");
+            result = do_write (fd, msg->str + 5, len + 1);
+            break;
+
+        default:
+            moo_dmsg ("do_send: connection closed");
+            result = FALSE;
+            break;
     }
 
     close (fd);
+    g_string_free (msg, TRUE);
     return result;
 }
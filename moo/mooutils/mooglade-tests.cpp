@@ -0,0 +1,128 @@
+/*
+ *   mooglade-tests.cpp
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "mooutils/mooutils-tests.h"
+#include "mooutils/mooglade.h"
+#include <gtk/gtk.h>
+
+static const char glade_static_xml[] =
+    "<glade-interface><widget class=\"GtkWindow\" id=\"window\"><child>"
+    "<widget class=\"GtkFrame\" id=\"frame\"><child>"
+    "<widget class=\"GtkLabel\" id=\"label\">"
+    "<property name=\"label\">text</property>"
+    "</widget></child></widget></child></widget></glade-interface>";
+
+static const char glade_static_broken_xml[] =
+    "<glade-interface><widget class=\"GtkFrame\" id=\"frame\">";
+
+static GtkWidget *
+glade_static_build (const char *label)
+{
+    MooGladeXML *xml;
+    GtkWidget *frame = NULL;
+    GError *error = NULL;
+
+    xml = moo_glade_xml_new_empty (NULL);
+
+    if (label)
+        moo_glade_xml_set_property (xml, "label", "label", label);
+
+    if (moo_glade_xml_parse_static (xml, glade_static_xml, "frame", &error))
+    {
+        frame = GTK_WIDGET (moo_glade_xml_get_widget (xml, "frame"));
+        TEST_ASSERT (frame == moo_glade_xml_get_root (xml));
+        TEST_ASSERT (GTK_IS_LABEL (moo_glade_xml_get_widget (xml, "label")));
+        TEST_ASSERT (moo_glade_xml_get_widget (xml, "window") == NULL);
+        g_object_ref_sink (frame);
+    }
+    else
+    {
+        TEST_FAILED_MSG ("could not parse glade xml: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_object_unref (xml);
+    return frame;
+}
+
+static const char *
+glade_static_label (GtkWidget *frame)
+{
+    GtkWidget *label = gtk_bin_get_child (GTK_BIN (frame));
+    TEST_ASSERT (GTK_IS_LABEL (label));
+    return GTK_IS_LABEL (label) ? gtk_label_get_text (GTK_LABEL (label)) : NULL;
+}
+
+/* a buffer is parsed once, and widgets built from it do not
+ * share anything */
+static void
+test_glade_static (void)
+{
+    GtkWidget *frame1, *frame2, *frame3;
+    MooGladeXML *xml;
+    GError *error = NULL;
+    int i;
+
+    frame1 = glade_static_build (NULL);
+    frame2 = glade_static_build ("changed");
+    frame3 = glade_static_build (NULL);
+
+    if (frame1 && frame2 && frame3)
+    {
+        TEST_ASSERT (frame1 != frame2 && frame1 != frame3 && frame2 != frame3);
+        TEST_ASSERT (gtk_bin_get_child (GTK_BIN (frame1)) != gtk_bin_get_child (GTK_BIN (frame3)));
+        TEST_ASSERT_STR_EQ (glade_static_label (frame1), "text");
+        TEST_ASSERT_STR_EQ (glade_static_label (frame2), "changed");
+        TEST_ASSERT_STR_EQ (glade_static_label (frame3), "text");
+    }
+
+    if (frame1)
+    {
+        gtk_widget_destroy (frame1);
+        g_object_unref (frame1);
+    }
+    if (frame2)
+    {
+        gtk_widget_destroy (frame2);
+        g_object_unref (frame2);
+    }
+    if (frame3)
+    {
+        gtk_widget_destroy (frame3);
+        g_object_unref (frame3);
+    }
+
+    /* errors are not cached */
+    for (i = 0; i < 2; ++i)
+    {
+        xml = moo_glade_xml_new_empty (NULL);
+        TEST_ASSERT (!moo_glade_xml_parse_static (xml, glade_static_broken_xml, "frame", &error));
+        TEST_ASSERT (error != NULL);
+        if (error)
+            g_error_free (error);
+        error = NULL;
+        g_object_unref (xml);
+    }
+}
+
+void
+moo_test_mooglade (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("mooglade", "mooutils/mooglade.c", NULL, NULL, NULL);
+
+    moo_test_suite_add_test (suite, "glade-static", "building widgets from parsed glade definitions",
+                             (MooTestFunc) test_glade_static, NULL);
+}
@@ -2383,6 +2383,63 @@ moo_glade_xml_fill_widget (MooGladeXML    *xml,
 }
 
 
+static MooMarkupDoc *
+get_static_doc (const char *buffer,
+                GError    **error)
+{
+    static GHashTable *docs;
+    MooMarkupDoc *doc;
+
+    if (!docs)
+        docs = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    if (!(doc = (MooMarkupDoc*) g_hash_table_lookup (docs, buffer)))
+    {
+        if (!(doc = moo_markup_parse_memory (buffer, -1, error)))
+            return NULL;
+        g_hash_table_insert (docs, (gpointer) buffer, doc);
+    }
+
+    return doc;
+}
+
+gboolean
+moo_glade_xml_parse_static (MooGladeXML    *xml,
+                            const char     *buffer,
+                            const char     *root,
+                            GError        **error)
+{
+    MooMarkupDoc *doc;
+
+    g_return_val_if_fail (xml != NULL, FALSE);
+    g_return_val_if_fail (buffer != NULL, FALSE);
+
+    if (!(doc = get_static_doc (buffer, error)))
+        return FALSE;
+
+    return moo_glade_xml_parse_markup (xml, doc, root, NULL, error);
+}
+
+gboolean
+moo_glade_xml_fill_widget_static (MooGladeXML    *xml,
+                                  GtkWidget      *target,
+                                  const char     *buffer,
+                                  const char     *target_name,
+                                  GError        **error)
+{
+    MooMarkupDoc *doc;
+
+    g_return_val_if_fail (xml != NULL, FALSE);
+    g_return_val_if_fail (buffer != NULL, FALSE);
+    g_return_val_if_fail (GTK_IS_WIDGET (target), FALSE);
+
+    if (!(doc = get_static_doc (buffer, error)))
+        return FALSE;
+
+    return moo_glade_xml_parse_markup (xml, doc, target_name, target, error);
+}
+
+
 GtkWidget*
 moo_glade_xml_get_root (MooGladeXML *xml)
 {
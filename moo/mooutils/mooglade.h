@@ -106,6 +106,19 @@ gboolean     moo_glade_xml_fill_widget      (MooGladeXML    *xml,
                                              const char     *target_name,
                                              GError        **error);
 
+/* Same as above for buffers which live as long as the program, e.g.
+ * generated by glade2c.py. Buffer is parsed once, and the result is
+ * reused by all subsequent calls with the same buffer. */
+gboolean     moo_glade_xml_parse_static     (MooGladeXML    *xml,
+                                             const char     *buffer,
+                                             const char     *root,
+                                             GError        **error);
+gboolean     moo_glade_xml_fill_widget_static (MooGladeXML  *xml,
+                                             GtkWidget      *target,
+                                             const char     *buffer,
+                                             const char     *target_name,
+                                             GError        **error);
+
 MooGladeXML *moo_glade_xml_new              (const char     *file,
                                              const char     *root,
                                              const char     *domain,
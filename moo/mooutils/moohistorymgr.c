@@ -30,6 +30,7 @@
 #include "mooutils/mooutils-thread.h"
 #include "mooutils/moolist.h"
 #include "mooutils/mootype-macros.h"
+#include "mooutils/mootrace.h"
 #include "marshals.h"
 #include <stdarg.h>
 #include <string.h>
@@ -772,7 +773,11 @@ static void
 ensure_files (MooHistoryMgr *mgr)
 {
     if (!mgr->priv->loaded)
+    {
+        MOO_TRACE_BEGIN ("history load");
         load_file (mgr);
+        MOO_TRACE_END ("history load");
+    }
 }
 
 
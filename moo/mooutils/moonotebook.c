@@ -26,6 +26,7 @@
 #include "mooutils/mooutils-misc.h"
 #include "mooutils/moopane.h"
 #include "mooutils/moocompat.h"
+#include "mooutils/mootype-macros.h"
 #include <gdk/gdkkeysyms.h>
 #include <gtk/gtk.h>
 #include <string.h>
@@ -56,8 +57,11 @@ typedef struct {
     Label       *label;
     GtkWidget   *child;
     GtkWidget   *focus_child;
+    guint        index;         /* position in nb->priv->pages */
 } Page;
 
+MOO_DEFINE_QUARK_STATIC (moo-notebook-page, page_quark)
+
 typedef enum {
     FOCUS_NONE = 0,
     FOCUS_LEFT,
@@ -78,7 +82,11 @@ struct _MooNotebookPrivate {
     GdkWindow   *tab_window;
 
     Page        *current_page;
-    GSList      *pages;
+    GPtrArray   *pages;         /* Page*, page->index is its position here */
+
+    guint        update_depth;  /* moo_notebook_begin_update() nesting */
+    gboolean     update_check_tabs;
+    int          update_removed_current; /* index of removed current page, or -1 */
 
     gboolean     enable_popup;
 
@@ -141,10 +149,10 @@ static void NOTEBOOK_CHECK_INVARIANTS (MooNotebook *nb);
  */
 #define VISIBLE_FOREACH_START(nb,page)                          \
 G_STMT_START {                                                  \
-    GSList *l__;                                                \
-    for (l__ = nb->priv->pages; l__ != NULL; l__ = l__->next)   \
+    guint i__;                                                  \
+    for (i__ = 0; i__ < nb->priv->pages->len; ++i__)            \
     {                                                           \
-        Page *page = l__->data;                                 \
+        Page *page = nb->priv->pages->pdata[i__];               \
         if (GTK_WIDGET_VISIBLE (page->child))                   \
 
 #define VISIBLE_FOREACH_END                                     \
@@ -261,7 +269,9 @@ static Page    *find_label                  (MooNotebook    *nb,
                                              GtkWidget      *label);
 static void     delete_page                 (MooNotebook    *nb,
                                              Page           *page);
-static GSList  *get_visible_pages           (MooNotebook    *nb);
+static GPtrArray *get_visible_pages         (MooNotebook    *nb);
+static void     renumber_pages              (MooNotebook    *nb,
+                                             guint           from);
 static void     moo_notebook_check_arrows   (MooNotebook    *nb);
 
 static void     moo_notebook_set_homogeneous(MooNotebook    *nb,
@@ -487,6 +497,9 @@ moo_notebook_init (MooNotebook *notebook)
 
     notebook->priv->child_height = -1;
 
+    notebook->priv->pages = g_ptr_array_new ();
+    notebook->priv->update_removed_current = -1;
+
     notebook_create_arrows (notebook);
 }
 
@@ -533,12 +546,12 @@ notebook_create_arrows (MooNotebook *nb)
 static void
 moo_notebook_destroy (GtkObject *object)
 {
-    GSList *l;
+    guint i;
     MooNotebook *nb = MOO_NOTEBOOK (object);
 
-    for (l = nb->priv->pages; l != NULL; l = l->next)
+    for (i = 0; i < nb->priv->pages->len; ++i)
     {
-        Page *page = l->data;
+        Page *page = nb->priv->pages->pdata[i];
 
         g_signal_handlers_disconnect_by_func (page->child,
                                               (gpointer) child_visible_notify,
@@ -555,8 +568,7 @@ moo_notebook_destroy (GtkObject *object)
         g_free (page);
     }
 
-    g_slist_free (nb->priv->pages);
-    nb->priv->pages = NULL;
+    g_ptr_array_set_size (nb->priv->pages, 0);
     nb->priv->current_page = NULL;
 
     GTK_OBJECT_CLASS(moo_notebook_parent_class)->destroy (object);
@@ -668,6 +680,7 @@ moo_notebook_finalize (GObject *object)
     MooNotebook *notebook = MOO_NOTEBOOK (object);
 
     g_object_unref (notebook->priv->arrows);
+    g_ptr_array_free (notebook->priv->pages, TRUE);
 
     /* XXX */
 
@@ -1017,7 +1030,7 @@ moo_notebook_realize (GtkWidget *widget)
     MooNotebook *nb = MOO_NOTEBOOK (widget);
     static GdkWindowAttr attributes;
     gint attributes_mask;
-    GSList *l;
+    guint i;
     int border_width = get_border_width (nb);
 
     GTK_WIDGET_SET_REALIZED (widget);
@@ -1060,9 +1073,9 @@ moo_notebook_realize (GtkWidget *widget)
 #endif
     gtk_style_set_background (widget->style, nb->priv->tab_window, GTK_STATE_NORMAL);
 
-    for (l = nb->priv->pages; l != NULL; l = l->next)
+    for (i = 0; i < nb->priv->pages->len; ++i)
     {
-        Page *page = l->data;
+        Page *page = nb->priv->pages->pdata[i];
         gtk_widget_set_parent_window (page->label->widget, nb->priv->tab_window);
     }
 }
@@ -1127,7 +1140,8 @@ moo_notebook_map (GtkWidget *widget)
 
         VISIBLE_FOREACH_START (nb, page)
         {
-            gtk_widget_map (page->label->widget);
+            if (gtk_widget_get_child_visible (page->label->widget))
+                gtk_widget_map (page->label->widget);
         }
         VISIBLE_FOREACH_END;
     }
@@ -1152,7 +1166,7 @@ moo_notebook_unmap (GtkWidget *widget)
 
     VISIBLE_FOREACH_START (nb, page)
     {
-        gtk_widget_map (page->label->widget);
+        gtk_widget_unmap (page->label->widget);
     }
     VISIBLE_FOREACH_END;
 
@@ -1178,11 +1192,11 @@ moo_notebook_forall (GtkContainer *container,
                      gpointer      callback_data)
 {
     MooNotebook *nb = MOO_NOTEBOOK (container);
-    GSList *l;
+    guint i;
 
-    for (l = nb->priv->pages; l != NULL; l = l->next)
+    for (i = 0; i < nb->priv->pages->len; ++i)
     {
-        Page *page = l->data;
+        Page *page = nb->priv->pages->pdata[i];
         callback (page->child, callback_data);
         if (include_internals && page != nb->priv->drag_page)
             callback (page->label->widget, callback_data);
@@ -1391,7 +1405,8 @@ moo_notebook_remove (GtkContainer *container,
         g_return_if_reached ();
     }
 
-    gtk_widget_queue_resize (GTK_WIDGET (nb));
+    if (!nb->priv->update_depth)
+        gtk_widget_queue_resize (GTK_WIDGET (nb));
 }
 
 
@@ -1462,7 +1477,31 @@ page_index (MooNotebook *nb,
             Page        *page)
 {
     g_return_val_if_fail (page != NULL, -1);
-    return g_slist_index (nb->priv->pages, page);
+    g_return_val_if_fail (page->index < nb->priv->pages->len, -1);
+    g_return_val_if_fail (nb->priv->pages->pdata[page->index] == page, -1);
+    return page->index;
+}
+
+
+static void
+renumber_pages (MooNotebook *nb,
+                guint        from)
+{
+    guint i;
+    for (i = from; i < nb->priv->pages->len; ++i)
+        ((Page*) nb->priv->pages->pdata[i])->index = i;
+}
+
+
+static void
+pages_insert (GPtrArray *array,
+              gpointer   data,
+              guint      position)
+{
+    g_ptr_array_add (array, NULL);
+    memmove (array->pdata + position + 1, array->pdata + position,
+             (array->len - position - 1) * sizeof (gpointer));
+    array->pdata[position] = data;
 }
 
 
@@ -1537,7 +1576,9 @@ moo_notebook_insert_page (MooNotebook *nb,
     page = g_new0 (Page, 1);
     page->child = child;
     page->label = g_new0 (Label, 1);
-    nb->priv->pages = g_slist_insert (nb->priv->pages, page, position);
+    pages_insert (nb->priv->pages, page, position);
+    renumber_pages (nb, position);
+    g_object_set_qdata (G_OBJECT (child), page_quark (), page);
 
     if (!label)
     {
@@ -1567,6 +1608,12 @@ moo_notebook_insert_page (MooNotebook *nb,
     g_signal_connect (child, "notify::visible",
                       G_CALLBACK (child_visible_notify), nb);
 
+    if (nb->priv->update_depth)
+    {
+        nb->priv->update_check_tabs = TRUE;
+        return position;
+    }
+
     if (!nb->priv->current_page && GTK_WIDGET_VISIBLE (child))
         moo_notebook_set_current_page (nb, position);
 
@@ -1584,6 +1631,7 @@ moo_notebook_reorder_child (MooNotebook *notebook,
 {
     Page *page;
     int n_pages;
+    int old_position;
 
     g_return_if_fail (MOO_IS_NOTEBOOK (notebook));
 
@@ -1595,13 +1643,17 @@ moo_notebook_reorder_child (MooNotebook *notebook,
     if (position < 0 || position > n_pages - 1)
         position = n_pages - 1;
 
-    if (page_index (notebook, page) == position)
+    old_position = page_index (notebook, page);
+
+    if (old_position == position)
         return;
 
-    notebook->priv->pages = g_slist_remove (notebook->priv->pages, page);
-    notebook->priv->pages = g_slist_insert (notebook->priv->pages, page, position);
+    g_ptr_array_remove_index (notebook->priv->pages, old_position);
+    pages_insert (notebook->priv->pages, page, position);
+    renumber_pages (notebook, MIN (old_position, position));
 
-    gtk_widget_queue_resize (GTK_WIDGET (notebook));
+    if (!notebook->priv->update_depth)
+        gtk_widget_queue_resize (GTK_WIDGET (notebook));
 }
 
 
@@ -1609,14 +1661,11 @@ static Page *
 find_child (MooNotebook *nb,
             GtkWidget   *child)
 {
-    GSList *l;
+    Page *page = g_object_get_qdata (G_OBJECT (child), page_quark ());
 
-    for (l = nb->priv->pages; l != NULL; l = l->next)
-    {
-        Page *page = l->data;
-        if (page->child == child)
+    if (page && page->index < nb->priv->pages->len &&
+        nb->priv->pages->pdata[page->index] == page)
             return page;
-    }
 
     return NULL;
 }
@@ -1626,15 +1675,12 @@ static Page *
 find_grand_child (MooNotebook *nb,
                   GtkWidget   *child)
 {
-    GSList *l;
-
     g_return_val_if_fail (GTK_IS_WIDGET (child), NULL);
 
-    for (l = nb->priv->pages; l != NULL; l = l->next)
+    for ( ; child != NULL; child = child->parent)
     {
-        Page *page = l->data;
-        if (page->child == child || gtk_widget_is_ancestor (child, page->child))
-            return page;
+        if (child->parent == GTK_WIDGET (nb))
+            return find_child (nb, child);
     }
 
     return NULL;
@@ -1645,11 +1691,11 @@ static Page *
 find_label (MooNotebook *nb,
             GtkWidget   *label)
 {
-    GSList *l;
+    guint i;
 
-    for (l = nb->priv->pages; l != NULL; l = l->next)
+    for (i = 0; i < nb->priv->pages->len; ++i)
     {
-        Page *page = l->data;
+        Page *page = nb->priv->pages->pdata[i];
         if (page->label->widget == label)
             return page;
     }
@@ -1662,10 +1708,10 @@ static Page *
 get_nth_page (MooNotebook *nb,
               int          n)
 {
-    if (n < 0)
+    if (n < 0 || n >= (int) nb->priv->pages->len)
         return NULL;
     else
-        return g_slist_nth_data (nb->priv->pages, n);
+        return nb->priv->pages->pdata[n];
 }
 
 
@@ -1712,17 +1758,33 @@ delete_page (MooNotebook *nb,
     g_return_if_fail (n >= 0);
 
     if (page == nb->priv->current_page)
+    {
         nb->priv->current_page = NULL;
+        if (nb->priv->update_depth)
+            nb->priv->update_removed_current = n;
+    }
+
+    if (page == nb->priv->focus_page)
+        nb->priv->focus_page = NULL;
 
     if (page->focus_child)
         g_object_weak_unref (G_OBJECT (page->focus_child),
                              (GWeakNotify) g_nullify_pointer,
                              &page->focus_child);
 
+    g_object_set_qdata (G_OBJECT (page->child), page_quark (), NULL);
+
     g_free (page->label);
     g_free (page);
 
-    nb->priv->pages = g_slist_remove (nb->priv->pages, page);
+    g_ptr_array_remove_index (nb->priv->pages, n);
+    renumber_pages (nb, n);
+
+    if (nb->priv->update_depth)
+    {
+        nb->priv->update_check_tabs = TRUE;
+        return;
+    }
 
     if (!nb->priv->current_page)
     {
@@ -1749,11 +1811,61 @@ moo_notebook_remove_page (MooNotebook *notebook,
 }
 
 
+/*
+ * moo_notebook_begin_update:
+ *
+ * Starts a batch of page insertions and removals. Until the matching
+ * moo_notebook_end_update() the notebook does not relayout its tabs and
+ * does not pick a new current page when the current one is removed, so
+ * opening or closing many pages costs a single relayout and at most one
+ * "switch-page" emission. Calls may be nested.
+ */
+void
+moo_notebook_begin_update (MooNotebook *notebook)
+{
+    g_return_if_fail (MOO_IS_NOTEBOOK (notebook));
+    notebook->priv->update_depth++;
+}
+
+
+void
+moo_notebook_end_update (MooNotebook *notebook)
+{
+    MooNotebookPrivate *priv;
+
+    g_return_if_fail (MOO_IS_NOTEBOOK (notebook));
+    g_return_if_fail (notebook->priv->update_depth > 0);
+
+    priv = notebook->priv;
+
+    if (--priv->update_depth)
+        return;
+
+    if (!priv->current_page)
+    {
+        int n = find_next_visible_page (notebook, MAX (priv->update_removed_current, 0));
+
+        if (n >= 0)
+            moo_notebook_set_current_page (notebook, n);
+    }
+
+    priv->update_removed_current = -1;
+
+    if (priv->update_check_tabs)
+    {
+        priv->update_check_tabs = FALSE;
+        moo_notebook_check_tabs (notebook);
+        labels_invalidate (notebook);
+        gtk_widget_queue_resize (GTK_WIDGET (notebook));
+    }
+}
+
+
 gint
 moo_notebook_get_n_pages (MooNotebook *notebook)
 {
     g_return_val_if_fail (MOO_IS_NOTEBOOK (notebook), 0);
-    return g_slist_length (notebook->priv->pages);
+    return notebook->priv->pages->len;
 }
 
 
@@ -1862,14 +1974,54 @@ moo_notebook_set_current_page (MooNotebook *notebook,
 }
 
 
-static GSList *
+/* returns NULL if there are no visible pages */
+static GPtrArray *
 get_visible_pages (MooNotebook *nb)
 {
-    GSList *list = NULL, *l;
-    for (l = nb->priv->pages; l != NULL; l = l->next)
-        if (GTK_WIDGET_VISIBLE (((Page*)l->data)->child))
-            list = g_slist_prepend (list, l->data);
-    return g_slist_reverse (list);
+    GPtrArray *list = NULL;
+
+    VISIBLE_FOREACH_START (nb, page) {
+        if (!list)
+            list = g_ptr_array_sized_new (nb->priv->pages->len);
+        g_ptr_array_add (list, page);
+    } VISIBLE_FOREACH_END;
+
+    return list;
+}
+
+
+static int
+visible_pages_find (GPtrArray *list,
+                    Page      *page)
+{
+    guint i;
+    for (i = 0; i < list->len; ++i)
+        if (list->pdata[i] == page)
+            return i;
+    return -1;
+}
+
+
+/* moves page to given position, used while dragging a label */
+static gboolean
+visible_pages_move (GPtrArray *list,
+                    Page      *page,
+                    int        position)
+{
+    int i = visible_pages_find (list, page);
+
+    if (i < 0)
+        return FALSE;
+
+    position = CLAMP (position, 0, (int) list->len - 1);
+
+    if (i != position)
+    {
+        g_ptr_array_remove_index (list, i);
+        pages_insert (list, page, position);
+    }
+
+    return TRUE;
 }
 
 
@@ -2016,7 +2168,8 @@ labels_size_allocate (MooNotebook   *nb,
 {
     GtkAllocation child_alloc;
     GtkRequisition child_req;
-    GSList *list, *l;
+    GPtrArray *list;
+    guint i;
     int width, max_offset, height;
     gboolean move_onscreen_again = FALSE;
     gboolean invalidate = FALSE;
@@ -2037,15 +2190,10 @@ labels_size_allocate (MooNotebook   *nb,
 
     if (nb->priv->in_drag)
     {
-        Page *page = nb->priv->drag_page;
-        int i = g_slist_index (list, page);
-
-        g_return_if_fail (i >= 0);
-
-        if (i != nb->priv->drag_page_index)
+        if (!visible_pages_move (list, nb->priv->drag_page, nb->priv->drag_page_index))
         {
-            list = g_slist_remove (list, page);
-            list = g_slist_insert (list, page, nb->priv->drag_page_index);
+            g_ptr_array_free (list, TRUE);
+            g_return_if_reached ();
         }
     }
 
@@ -2053,19 +2201,18 @@ labels_size_allocate (MooNotebook   *nb,
     {
         int max_width = 2*LABEL_OVERLAP;
 
-        for (l = list; l != NULL; l = l->next)
+        for (i = 0; i < list->len; ++i)
         {
-            Page *page = l->data;
-            GtkWidget *label = page->label->widget;
+            Page *page = list->pdata[i];
 
-            gtk_widget_get_child_requisition (label, &child_req);
+            gtk_widget_get_child_requisition (page->label->widget, &child_req);
 
             max_width = MAX (max_width, child_req.width + 2 * (int) nb->priv->label_hborder);
         }
 
-        for (l = list, width = 0; l != NULL; l = l->next)
+        for (i = 0, width = 0; i < list->len; ++i)
         {
-            Page *page = l->data;
+            Page *page = list->pdata[i];
 
             if (max_width != page->label->width)
                 invalidate = TRUE;
@@ -2087,13 +2234,12 @@ labels_size_allocate (MooNotebook   *nb,
     }
     else
     {
-        for (l = list, width = 0; l != NULL; l = l->next)
+        for (i = 0, width = 0; i < list->len; ++i)
         {
-            Page *page = l->data;
-            GtkWidget *label = page->label->widget;
+            Page *page = list->pdata[i];
             int new_width;
 
-            gtk_widget_get_child_requisition (label, &child_req);
+            gtk_widget_get_child_requisition (page->label->widget, &child_req);
 
             new_width = MAX (0, child_req.width) + 2 * nb->priv->label_hborder;
             new_width = MAX (new_width, 2*LABEL_OVERLAP);
@@ -2154,31 +2300,45 @@ labels_size_allocate (MooNotebook   *nb,
         /* TODO is something needed here? */
     }
 
-    for (l = list; l != NULL; l = l->next)
+    /* Only labels which intersect the visible part of the tab strip are
+     * allocated and mapped, the rest are made child-invisible, so that
+     * with hundreds of tabs a resize or a scroll only touches a screenful
+     * of label widgets. */
+    for (i = 0; i < list->len; ++i)
     {
-        Page *page = l->data;
+        Page *page = list->pdata[i];
         GtkWidget *label = page->label->widget;
-
-        gtk_widget_get_child_requisition (label, &child_req);
+        int x;
 
         if (page != nb->priv->drag_page)
-            child_alloc.x = page->label->offset;
+            x = page->label->offset;
         else
-            child_alloc.x = nb->priv->drag_tab_x;
+            x = nb->priv->drag_tab_x;
+
+        x -= nb->priv->labels_offset;
+
+        if (x + page->label->width <= 0 || x >= allocation->width)
+        {
+            gtk_widget_set_child_visible (label, FALSE);
+            continue;
+        }
 
-        child_alloc.x += (nb->priv->label_hborder - nb->priv->labels_offset);
+        gtk_widget_get_child_requisition (label, &child_req);
+
+        child_alloc.x = x + nb->priv->label_hborder;
         child_alloc.width = child_req.width;
         child_alloc.y = (height - LABEL_FOCUS_HEIGHT)/2 -
                 child_req.height/2 + LABEL_FOCUS_HEIGHT;
         child_alloc.height = child_req.height;
 
         gtk_widget_size_allocate (label, &child_alloc);
+        gtk_widget_set_child_visible (label, TRUE);
     }
 
     if (invalidate)
         labels_invalidate (nb);
 
-    g_slist_free (list);
+    g_ptr_array_free (list, TRUE);
 }
 
 
@@ -2242,13 +2402,24 @@ static void
 moo_notebook_draw_labels (MooNotebook    *nb,
                           GdkEventExpose *event)
 {
+    int area_start, area_end;
+
     if (!nb->priv->current_page)
         return;
 
+    area_start = event->area.x + nb->priv->labels_offset - LABEL_OVERLAP;
+    area_end = event->area.x + event->area.width + nb->priv->labels_offset + LABEL_OVERLAP;
+
     VISIBLE_FOREACH_START (nb, page)
     {
-        if (page != nb->priv->current_page)
-            moo_notebook_draw_label (nb, page, event);
+        /* offsets grow along the list unless labels are being reordered */
+        if (!nb->priv->in_drag && page->label->offset >= area_end)
+            break;
+
+        if (page != nb->priv->current_page &&
+            page->label->offset < area_end &&
+            page->label->offset + page->label->width > area_start)
+                moo_notebook_draw_label (nb, page, event);
     }
     VISIBLE_FOREACH_END;
 
@@ -2363,7 +2534,7 @@ static void
 moo_notebook_check_arrows (MooNotebook *nb)
 {
     gboolean sensitive[2];
-    GSList *visible;
+    GPtrArray *visible;
     Page *page;
 
     if (!nb->priv->arrows_visible)
@@ -2377,11 +2548,14 @@ moo_notebook_check_arrows (MooNotebook *nb)
     {
         page = nb->priv->current_page;
 
-        g_return_if_fail (page != NULL);
-        g_return_if_fail (g_slist_find (visible, page) != NULL);
+        if (!page || visible_pages_find (visible, page) < 0)
+        {
+            g_ptr_array_free (visible, TRUE);
+            g_return_if_reached ();
+        }
 
-        sensitive[LEFT] = (page != visible->data);
-        sensitive[RIGHT] = (page != g_slist_last(visible)->data);
+        sensitive[LEFT] = (page != visible->pdata[0]);
+        sensitive[RIGHT] = (page != visible->pdata[visible->len - 1]);
     }
     else
     {
@@ -2394,7 +2568,8 @@ moo_notebook_check_arrows (MooNotebook *nb)
     gtk_widget_set_sensitive (nb->priv->left_arrow, sensitive[LEFT]);
     gtk_widget_set_sensitive (nb->priv->right_arrow, sensitive[RIGHT]);
 
-    g_slist_free (visible);
+    if (visible)
+        g_ptr_array_free (visible, TRUE);
 }
 
 
@@ -2442,9 +2617,8 @@ static void
 labels_scroll (MooNotebook      *nb,
                GtkDirectionType  where)
 {
-    GSList *visible;
     Page *page;
-    int offset, index_;
+    int offset;
 
     g_return_if_fail (!nb->priv->arrows_gtk);
     g_return_if_fail (nb->priv->tabs_visible);
@@ -2452,16 +2626,13 @@ labels_scroll (MooNotebook      *nb,
     if (nb->priv->labels_visible_width >= nb->priv->labels_width)
         return;
 
-    visible = get_visible_pages (nb);
-    g_return_if_fail (visible != NULL);
-
+    /* the first visible label has offset 0, and the last one ends at labels_width */
     if (where == GTK_DIR_LEFT)
     {
         page = find_label_at_x (nb, 0, FALSE);
-        index_ = g_slist_index (visible, page);
-        g_return_if_fail (index_ >= 0);
+        g_return_if_fail (page != NULL);
 
-        if (index_ == 0)
+        if (page->label->offset == 0)
             offset = 0;
         else
             offset = page->label->offset - SCROLL_PAD;
@@ -2469,10 +2640,9 @@ labels_scroll (MooNotebook      *nb,
     else
     {
         page = find_label_at_x (nb, nb->priv->labels_visible_width - 1, FALSE);
-        index_ = g_slist_index (visible, page);
-        g_return_if_fail (index_ >= 0);
+        g_return_if_fail (page != NULL);
 
-        if (index_ == (int) g_slist_length (visible) - 1)
+        if (page->label->offset + page->label->width >= nb->priv->labels_width)
             offset = nb->priv->labels_width - nb->priv->labels_visible_width;
         else
             offset = page->label->offset + page->label->width -
@@ -2818,7 +2988,7 @@ tab_drag_motion (MooNotebook    *nb,
                  GdkEventMotion *event)
 {
     int x, new_index, width, offset, num, i;
-    GSList *visible, *l;
+    GPtrArray *visible;
     Page *drag_page;
     int event_x, event_y;
 
@@ -2861,17 +3031,17 @@ tab_drag_motion (MooNotebook    *nb,
 
     drag_page = nb->priv->drag_page;
     visible = get_visible_pages (nb);
-    visible = g_slist_remove (visible, drag_page);
-    visible = g_slist_insert (visible, drag_page, nb->priv->drag_page_index);
+    g_return_if_fail (visible != NULL);
+    visible_pages_move (visible, drag_page, nb->priv->drag_page_index);
 
     new_index = nb->priv->drag_page_index;
 
-    for (l = visible, i = 0, offset = 0; l != NULL; l = l->next, ++i)
+    for (i = 0, offset = 0; i < (int) visible->len; ++i)
     {
         Page *page;
         int min_width;
 
-        page = l->data;
+        page = visible->pdata[i];
         min_width = MIN (page->label->width, width);
 
         if (i == new_index)
@@ -2921,7 +3091,7 @@ tab_drag_motion (MooNotebook    *nb,
     }
 
     gtk_widget_queue_resize (GTK_WIDGET (nb));
-    g_slist_free (visible);
+    g_ptr_array_free (visible, TRUE);
 }
 
 
@@ -3326,8 +3496,8 @@ focus_to_next_label (MooNotebook      *nb,
                      GtkDirectionType  direction,
                      gboolean          forward)
 {
-    Page *page, *next;
-    GSList *visible;
+    Page *page, *next = NULL;
+    int i;
 
     g_return_val_if_fail (nb->priv->focus == FOCUS_LABEL || !nb->priv->focus, FALSE);
     g_return_val_if_fail (nb->priv->tabs_visible, FALSE);
@@ -3336,25 +3506,21 @@ focus_to_next_label (MooNotebook      *nb,
     g_return_val_if_fail (page != NULL, FALSE);
     g_return_val_if_fail (GTK_WIDGET_VISIBLE (page->child), FALSE);
 
-    visible = get_visible_pages (nb);
-    g_return_val_if_fail (g_slist_find (visible, page) != NULL, FALSE);
-
-    if (forward)
-    {
-        if (page == g_slist_last(visible)->data)
-            return FALSE;
-        else
-            next = g_slist_nth_data (visible, g_slist_index (visible, page) + 1);
-    }
-    else
+    for (i = page_index (nb, page) + (forward ? 1 : -1);
+         i >= 0 && i < (int) nb->priv->pages->len;
+         i += (forward ? 1 : -1))
     {
-        if (page == visible->data)
-            return FALSE;
-        else
-            next = g_slist_nth_data (visible, g_slist_index (visible, page) - 1);
+        Page *p = nb->priv->pages->pdata[i];
+
+        if (GTK_WIDGET_VISIBLE (p->child))
+        {
+            next = p;
+            break;
+        }
     }
 
-    g_return_val_if_fail (next != NULL, FALSE);
+    if (!next)
+        return FALSE;
 
     if (nb->priv->arrows_gtk)
     {
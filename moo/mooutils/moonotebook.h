@@ -106,6 +106,9 @@ void        moo_notebook_reorder_child      (MooNotebook    *notebook,
                                              GtkWidget      *child,
                                              gint            position);
 
+void        moo_notebook_begin_update       (MooNotebook    *notebook);
+void        moo_notebook_end_update         (MooNotebook    *notebook);
+
 
 void        moo_notebook_enable_popup               (MooNotebook    *notebook,
                                                      gboolean        enable);
@@ -0,0 +1,119 @@
+/*
+ *   mooprefs-tests.cpp
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "mooutils/mooutils-tests.h"
+#include "mooutils/mooprefs.h"
+
+#define TEST_PREFS_PREFIX "Tests/Prefs"
+#define TEST_PREFS_STRING TEST_PREFS_PREFIX "/string"
+#define TEST_PREFS_INT TEST_PREFS_PREFIX "/int"
+
+#define BENCH_PREFS_LOOKUPS 100000
+
+static void
+count_notify (G_GNUC_UNUSED const char *key,
+              int                      *count)
+{
+    *count += 1;
+}
+
+static void
+test_prefs (void)
+{
+    MooPrefsKey key;
+    guint watch;
+    int count = 0;
+
+    moo_prefs_new_key_string (TEST_PREFS_STRING, "text");
+    key = moo_prefs_intern_key (TEST_PREFS_STRING);
+    TEST_ASSERT (key != 0);
+    TEST_ASSERT (key == moo_prefs_intern_key (TEST_PREFS_STRING));
+    TEST_ASSERT_STR_EQ (moo_prefs_key_name (key), TEST_PREFS_STRING);
+    TEST_ASSERT_STR_EQ (moo_prefs_key_get_string (key), "text");
+    TEST_ASSERT_STR_EQ (moo_prefs_key_get_string (key), moo_prefs_get_string (TEST_PREFS_STRING));
+    moo_prefs_delete_key (TEST_PREFS_STRING);
+
+    moo_prefs_new_key_int (TEST_PREFS_INT, 0);
+    key = moo_prefs_intern_key (TEST_PREFS_INT);
+
+    watch = moo_prefs_notify_connect (TEST_PREFS_PREFIX "/", (MooPrefsNotify) count_notify, &count, NULL);
+
+    moo_prefs_key_set_int (key, 1);
+    TEST_ASSERT_INT_EQ (count, 1);
+    TEST_ASSERT_INT_EQ (moo_prefs_get_int (TEST_PREFS_INT), 1);
+    moo_prefs_key_set_int (key, 1);
+    TEST_ASSERT_INT_EQ (count, 1);
+
+    moo_prefs_begin_changes ();
+    moo_prefs_key_set_int (key, 2);
+    moo_prefs_key_set_int (key, 3);
+    TEST_ASSERT_INT_EQ (count, 1);
+    moo_prefs_end_changes ();
+    TEST_ASSERT_INT_EQ (count, 2);
+    TEST_ASSERT_INT_EQ (moo_prefs_key_get_int (key), 3);
+
+    moo_prefs_delete_key (TEST_PREFS_INT);
+    TEST_ASSERT_INT_EQ (count, 3);
+    TEST_ASSERT (!moo_prefs_key_registered (TEST_PREFS_INT));
+    TEST_ASSERT (moo_prefs_intern_key (TEST_PREFS_INT) == key);
+
+    moo_prefs_notify_disconnect (watch);
+}
+
+static void
+bench_prefs_setup (void)
+{
+    moo_prefs_new_key_string (TEST_PREFS_STRING, "UTF-8,ISO-8859-1");
+}
+
+static void
+bench_prefs_cleanup (void)
+{
+    moo_prefs_delete_key (TEST_PREFS_STRING);
+}
+
+static void
+bench_prefs_by_name (void)
+{
+    int i;
+    for (i = 0; i < BENCH_PREFS_LOOKUPS; ++i)
+        moo_prefs_get_string (TEST_PREFS_STRING);
+}
+
+static void
+bench_prefs_by_key (void)
+{
+    MooPrefsKey key = moo_prefs_intern_key (TEST_PREFS_STRING);
+    int i;
+    for (i = 0; i < BENCH_PREFS_LOOKUPS; ++i)
+        moo_prefs_key_get_string (key);
+}
+
+void
+moo_test_mooprefs (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("mooprefs", "mooutils/mooprefs.c", NULL, NULL, NULL);
+
+    moo_test_suite_add_test (suite, "prefs", "preferences lookup and change notifications",
+                             (MooTestFunc) test_prefs, NULL);
+
+    moo_test_suite_add_bench (suite, "prefs-by-name", "looking up a pref by name",
+                              (MooTestFunc) bench_prefs_by_name, (MooTestFunc) bench_prefs_setup,
+                              (MooTestFunc) bench_prefs_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "prefs-by-key", "looking up a pref by interned key",
+                              (MooTestFunc) bench_prefs_by_key, (MooTestFunc) bench_prefs_setup,
+                              (MooTestFunc) bench_prefs_cleanup, NULL);
+}
@@ -19,11 +19,14 @@
 #include "mooutils/mooutils-fs.h"
 #include "mooutils/mooutils-misc.h"
 #include "mooutils/mooutils-gobject.h"
+#include "mooutils/mooutils-debug.h"
 #include "mooutils/mootype-macros.h"
 #include <string.h>
 #include <gobject/gvaluecollector.h>
 #include <mooglib/moo-glib.h>
 
+MOO_DEBUG_INIT(prefs, FALSE)
+
 #define MOO_PREFS_ELEMENT "moo-prefs"
 #define PROP_VERSION "version"
 #define MOO_PREFS_VERSION "1.0"
@@ -33,25 +36,54 @@
 
 #define MOO_PREFS_SYS -1
 
+typedef struct _PrefsItem PrefsItem;
+
+typedef struct {
+    char        *name;
+    MooPrefsKey  id;
+    PrefsItem   *item; /* NULL if the key is not registered */
+} PrefsKey;
+
+typedef struct {
+    guint           id;
+    char           *prefix;
+    MooPrefsNotify  func;
+    gpointer        data;
+    GDestroyNotify  notify;
+} PrefsWatch;
+
 typedef struct
 {
-    GHashTable      *data; /* char* -> Item* */
+    GHashTable      *keys; /* char* -> PrefsKey* */
+    GPtrArray       *key_array; /* MooPrefsKey -> PrefsKey*, 0 is not used */
     MooMarkupDoc    *xml_rc;
     MooMarkupDoc    *xml_state;
-    gboolean         rc_modified;
+    /* char* -> MooMarkupNode*, item elements of xml_rc and xml_state,
+     * NULL until the doc is loaded or written */
+    GHashTable      *elements[2];
+    /* keys changed since the last save, written by sync_xml() */
+    GHashTable      *dirty[2];
+    GSList          *watches;
+    guint            last_watch_id;
+    int              changes_depth;
+    GHashTable      *changed; /* keys changed since moo_prefs_begin_changes() */
 } PrefsStore;
 
-typedef struct {
-    GType  type;
-    GValue value;
-    GValue default_value;
-    guint  prefs_kind : 1;
-    guint  overridden : 1;
-} PrefsItem;
+struct _PrefsItem {
+    const char          *key; /* interned */
+    GType                type;
+    GValue               value;
+    GValue               default_value;
+    guint                prefs_kind : 1;
+    guint                overridden : 1;
+};
 
 static PrefsItem    *prefs_get_item     (const char     *key);
+static PrefsItem    *prefs_get_item_by_id (MooPrefsKey  key);
+static PrefsKey     *prefs_intern       (const char     *key);
 
-static PrefsItem    *item_new           (GType           type,
+static PrefsItem    *item_new           (const char     *key,
+                                         GType           type,
                                          const GValue   *value,
                                          const GValue   *default_value,
                                          MooPrefsKind    prefs_kind);
@@ -63,7 +95,9 @@ static gboolean      item_set           (PrefsItem      *item,
 static gboolean      item_set_default   (PrefsItem      *item,
                                          const GValue   *value);
 
-static void          moo_prefs_set_modified (gboolean    modified);
+static void          prefs_key_changed  (const char     *key);
+static void          prefs_mark_dirty   (const char     *key,
+                                         MooPrefsKind    prefs_kind);
 
 
 static PrefsStore *
@@ -71,11 +105,15 @@ prefs_instance (void)
 {
     static PrefsStore prefs;
 
-    if (G_UNLIKELY (!prefs.data))
-        prefs.data =
-            g_hash_table_new_full (g_str_hash, g_str_equal,
-                                   (GDestroyNotify) g_free,
-                                   (GDestroyNotify) item_free);
+    if (G_UNLIKELY (!prefs.keys))
+    {
+        prefs.keys = g_hash_table_new (g_str_hash, g_str_equal);
+        prefs.key_array = g_ptr_array_new ();
+        g_ptr_array_add (prefs.key_array, NULL);
+        prefs.dirty[MOO_PREFS_RC] = g_hash_table_new (g_str_hash, g_str_equal);
+        prefs.dirty[MOO_PREFS_STATE] = g_hash_table_new (g_str_hash, g_str_equal);
+        prefs.changed = g_hash_table_new (g_str_hash, g_str_equal);
+    }
 
     return &prefs;
 }
@@ -259,8 +297,10 @@ moo_prefs_set (const char     *key,
     }
 
     if (item_set (item, value))
-        if (item->prefs_kind == MOO_PREFS_RC)
-            moo_prefs_set_modified (TRUE);
+    {
+        prefs_mark_dirty (item->key, item->prefs_kind);
+        prefs_key_changed (item->key);
+    }
 }
 
 
@@ -276,47 +316,26 @@ moo_prefs_set_default (const char     *key,
     item = prefs_get_item (key);
     g_return_if_fail (item != NULL);
 
-    item_set_default (item, value);
+    if (item_set_default (item, value))
+        prefs_mark_dirty (item->key, item->prefs_kind);
 }
 
 
-static void
-moo_prefs_set_modified (gboolean modified)
-{
-    PrefsStore *prefs = prefs_instance ();
-    prefs->rc_modified = modified;
-}
-
-
-static void
-prepend_key (const char *key,
-             PrefsItem  *item,
-             gpointer    pdata)
-{
-    struct {
-        GSList *list;
-        MooPrefsKind prefs_kind;
-    } *data = pdata;
-
-    if (data->prefs_kind == item->prefs_kind)
-        data->list = g_slist_prepend (data->list, g_strdup (key));
-}
-
 GSList *
 moo_prefs_list_keys (MooPrefsKind prefs_kind)
 {
     PrefsStore *prefs = prefs_instance ();
+    GSList *list = NULL;
+    guint i;
 
-    struct {
-        GSList *list;
-        MooPrefsKind prefs_kind;
-    } data;
-
-    data.list = NULL;
-    data.prefs_kind = prefs_kind;
-    g_hash_table_foreach (prefs->data, (GHFunc) prepend_key, &data);
+    for (i = 1; i < prefs->key_array->len; ++i)
+    {
+        PrefsKey *pk = prefs->key_array->pdata[i];
+        if (pk->item && pk->item->prefs_kind == prefs_kind)
+            list = g_slist_prepend (list, g_strdup (pk->name));
+    }
 
-    return g_slist_sort (data.list, (GCompareFunc) strcmp);
+    return g_slist_sort (list, (GCompareFunc) strcmp);
 }
 
 
@@ -332,7 +351,6 @@ moo_prefs_new_key (const char   *key,
                    MooPrefsKind  prefs_kind)
 {
     PrefsItem *item;
-    PrefsStore *prefs;
 
     g_return_if_fail (key && key[0]);
     g_return_if_fail (g_utf8_validate (key, -1, NULL));
@@ -350,27 +368,34 @@ moo_prefs_new_key (const char   *key,
             return;
     }
 
-    prefs = prefs_instance ();
     item = prefs_get_item (key);
 
     if (!item)
     {
-        item = item_new (value_type, default_value, default_value, prefs_kind);
-        g_hash_table_insert (prefs->data, g_strdup (key), item);
+        PrefsKey *pk = prefs_intern (key);
+        item = item_new (pk->name, value_type, default_value, default_value, prefs_kind);
+        pk->item = item;
     }
     else
     {
-        item_set_type (item, value_type);
+        gboolean changed = FALSE;
 
-        if (!item->overridden)
-            item_set_default (item, default_value);
+        if (item_set_type (item, value_type))
+            changed = TRUE;
 
-        if (!item->overridden &&
-            item->prefs_kind == MOO_PREFS_RC &&
-            item->prefs_kind != prefs_kind)
-                moo_prefs_set_modified (TRUE);
+        if (!item->overridden && item_set_default (item, default_value))
+            changed = TRUE;
+
+        if (item->prefs_kind != (guint) prefs_kind)
+        {
+            prefs_mark_dirty (item->key, item->prefs_kind);
+            changed = TRUE;
+        }
 
         item->prefs_kind = prefs_kind;
+
+        if (changed)
+            prefs_mark_dirty (item->key, item->prefs_kind);
     }
 }
 
@@ -421,7 +446,8 @@ prefs_new_key_from_string (const char   *key,
         g_value_unset (&default_val);
     }
 
-    item_set (item, &real_val);
+    if (item_set (item, &real_val))
+        prefs_key_changed (item->key);
 
     if (prefs_kind == MOO_PREFS_SYS)
         item->overridden = TRUE;
@@ -434,31 +460,206 @@ prefs_new_key_from_string (const char   *key,
 void
 moo_prefs_delete_key (const char *key)
 {
-    PrefsItem *item;
+    PrefsKey *pk;
     PrefsStore *prefs;
 
     g_return_if_fail (key != NULL);
 
-    item = prefs_get_item (key);
+    prefs = prefs_instance ();
+    pk = g_hash_table_lookup (prefs->keys, key);
 
-    if (!item)
+    if (!pk || !pk->item)
         return;
 
-    if (item->prefs_kind == MOO_PREFS_RC)
-        moo_prefs_set_modified (TRUE);
+    prefs_mark_dirty (pk->name, pk->item->prefs_kind);
 
-    prefs = prefs_instance ();
-    g_hash_table_remove (prefs->data, key);
+    item_free (pk->item);
+    pk->item = NULL;
+
+    prefs_key_changed (pk->name);
 }
 
 
+static PrefsKey *
+prefs_intern (const char *key)
+{
+    PrefsStore *prefs = prefs_instance ();
+    PrefsKey *pk;
+
+    if (!(pk = g_hash_table_lookup (prefs->keys, key)))
+    {
+        pk = g_new0 (PrefsKey, 1);
+        pk->name = g_strdup (key);
+        pk->id = prefs->key_array->len;
+        g_ptr_array_add (prefs->key_array, pk);
+        g_hash_table_insert (prefs->keys, pk->name, pk);
+    }
+
+    return pk;
+}
 
 static PrefsItem*
 prefs_get_item (const char *key)
 {
     PrefsStore *prefs = prefs_instance ();
+    PrefsKey *pk;
     g_return_val_if_fail (key != NULL, NULL);
-    return g_hash_table_lookup (prefs->data, key);
+    pk = g_hash_table_lookup (prefs->keys, key);
+    return pk ? pk->item : NULL;
+}
+
+static PrefsItem *
+prefs_get_item_by_id (MooPrefsKey key)
+{
+    PrefsStore *prefs = prefs_instance ();
+    g_return_val_if_fail (key > 0 && key < prefs->key_array->len, NULL);
+    return ((PrefsKey*) prefs->key_array->pdata[key])->item;
+}
+
+
+/***************************************************************************/
+/* Change tracking
+ */
+
+static void
+prefs_mark_dirty (const char   *key,
+                  MooPrefsKind  prefs_kind)
+{
+    PrefsStore *prefs = prefs_instance ();
+    g_hash_table_insert (prefs->dirty[prefs_kind], (char*) key, NULL);
+}
+
+static void
+prefs_emit_changed (const char *key)
+{
+    PrefsStore *prefs = prefs_instance ();
+    GArray *ids;
+    GSList *l;
+    guint i;
+
+    /* watches may be disconnected from inside a callback, so collect
+     * the ids first and look each watch up again before calling it */
+    ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    for (l = prefs->watches; l != NULL; l = l->next)
+    {
+        PrefsWatch *watch = l->data;
+        if (!watch->prefix || g_str_has_prefix (key, watch->prefix))
+            g_array_append_val (ids, watch->id);
+    }
+
+    for (i = 0; i < ids->len; ++i)
+    {
+        for (l = prefs->watches; l != NULL; l = l->next)
+        {
+            PrefsWatch *watch = l->data;
+            if (watch->id == g_array_index (ids, guint, i))
+            {
+                watch->func (key, watch->data);
+                break;
+            }
+        }
+    }
+
+    g_array_free (ids, TRUE);
+}
+
+static void
+prefs_key_changed (const char *key)
+{
+    PrefsStore *prefs = prefs_instance ();
+
+    if (!prefs->watches)
+        return;
+
+    if (prefs->changes_depth > 0)
+        g_hash_table_insert (prefs->changed, (char*) key, NULL);
+    else
+        prefs_emit_changed (key);
+}
+
+void
+moo_prefs_begin_changes (void)
+{
+    PrefsStore *prefs = prefs_instance ();
+    prefs->changes_depth++;
+}
+
+static void
+prepend_changed_key (const char *key,
+                     G_GNUC_UNUSED gpointer value,
+                     GSList    **list)
+{
+    *list = g_slist_prepend (*list, (char*) key);
+}
+
+void
+moo_prefs_end_changes (void)
+{
+    PrefsStore *prefs = prefs_instance ();
+    GSList *keys = NULL;
+
+    g_return_if_fail (prefs->changes_depth > 0);
+
+    if (--prefs->changes_depth > 0)
+        return;
+
+    g_hash_table_foreach (prefs->changed, (GHFunc) prepend_changed_key, &keys);
+    g_hash_table_remove_all (prefs->changed);
+    keys = g_slist_sort (keys, (GCompareFunc) strcmp);
+
+    while (keys)
+    {
+        prefs_emit_changed (keys->data);
+        keys = g_slist_delete_link (keys, keys);
+    }
+}
+
+guint
+moo_prefs_notify_connect (const char     *prefix,
+                          MooPrefsNotify  func,
+                          gpointer        data,
+                          GDestroyNotify  notify)
+{
+    PrefsStore *prefs = prefs_instance ();
+    PrefsWatch *watch;
+
+    g_return_val_if_fail (func != NULL, 0);
+
+    watch = g_new0 (PrefsWatch, 1);
+    watch->id = ++prefs->last_watch_id;
+    watch->prefix = g_strdup (prefix);
+    watch->func = func;
+    watch->data = data;
+    watch->notify = notify;
+
+    prefs->watches = g_slist_append (prefs->watches, watch);
+
+    return watch->id;
+}
+
+void
+moo_prefs_notify_disconnect (guint id)
+{
+    PrefsStore *prefs = prefs_instance ();
+    GSList *l;
+
+    for (l = prefs->watches; l != NULL; l = l->next)
+    {
+        PrefsWatch *watch = l->data;
+
+        if (watch->id == id)
+        {
+            prefs->watches = g_slist_delete_link (prefs->watches, l);
+            if (watch->notify)
+                watch->notify (watch->data);
+            g_free (watch->prefix);
+            g_free (watch);
+            return;
+        }
+    }
+
+    g_warning ("watch %u not found", id);
 }
 
 
@@ -467,7 +668,8 @@ prefs_get_item (const char *key)
  */
 
 static PrefsItem*
-item_new (GType           type,
+item_new (const char     *key,
+          GType           type,
           const GValue   *value,
           const GValue   *default_value,
           MooPrefsKind    prefs_kind)
@@ -481,6 +683,7 @@ item_new (GType           type,
 
     item = g_new0 (PrefsItem, 1);
 
+    item->key = key;
     item->type = type;
     item->prefs_kind = prefs_kind;
 
@@ -566,9 +769,26 @@ item_set_default (PrefsItem      *item,
 /* Loading abd saving
  */
 
+static MooMarkupDoc **
+prefs_doc_ptr (MooPrefsKind prefs_kind)
+{
+    PrefsStore *prefs = prefs_instance ();
+
+    switch (prefs_kind)
+    {
+        case MOO_PREFS_RC:
+            return &prefs->xml_rc;
+        case MOO_PREFS_STATE:
+            return &prefs->xml_state;
+    }
+
+    g_return_val_if_reached (NULL);
+}
+
 static void
 process_item (MooMarkupElement *elm,
-              int               prefs_kind)
+              int               prefs_kind,
+              GHashTable       *elements)
 {
     const char *name;
     const char *type;
@@ -585,6 +805,9 @@ process_item (MooMarkupElement *elm,
 
     prefs_new_key_from_string (name, type, elm->content, prefs_kind);
 
+    if (elements)
+        g_hash_table_insert (elements, prefs_intern (name)->name, elm);
+
 #ifdef MOO_PREFS_DEBUG_READWRITE
     g_print ("key: '%s', type: '%s', val: '%s'\n", name, type, elm->content);
 #endif
@@ -599,6 +822,7 @@ load_file (const char  *file,
     MooMarkupNode *root;
     PrefsStore *prefs;
     MooMarkupDoc **target = NULL;
+    GHashTable *elements = NULL;
     const char *version;
 
     prefs = prefs_instance ();
@@ -606,10 +830,8 @@ load_file (const char  *file,
     switch (prefs_kind)
     {
         case MOO_PREFS_RC:
-            target = &prefs->xml_rc;
-            break;
         case MOO_PREFS_STATE:
-            target = &prefs->xml_state;
+            target = prefs_doc_ptr (prefs_kind);
             break;
         case MOO_PREFS_SYS:
             target = NULL;
@@ -652,10 +874,12 @@ load_file (const char  *file,
         }
 
         *target = moo_markup_doc_ref (xml);
-    }
 
-    if (prefs_kind != MOO_PREFS_STATE)
-    {
+        if (prefs->elements[prefs_kind])
+            g_hash_table_destroy (prefs->elements[prefs_kind]);
+        elements = prefs->elements[prefs_kind] =
+            g_hash_table_new (g_str_hash, g_str_equal);
+
         _moo_markup_set_track_modified (xml, TRUE);
         _moo_markup_set_modified (xml, FALSE);
     }
@@ -667,7 +891,7 @@ load_file (const char  *file,
         MooMarkupNode *child;
         for (child = root->children; child != NULL; child = child->next)
             if (child->type == MOO_MARKUP_ELEMENT_NODE)
-                process_item (MOO_MARKUP_ELEMENT (child), prefs_kind);
+                process_item (MOO_MARKUP_ELEMENT (child), prefs_kind, elements);
     }
 
     moo_markup_doc_unref (xml);
@@ -681,148 +905,256 @@ moo_prefs_load (char          **sys_files,
                 const char     *file_state,
                 GError        **error)
 {
-    moo_prefs_set_modified (FALSE);
+    PrefsStore *prefs = prefs_instance ();
+    GTimer *timer;
+
+    timer = g_timer_new ();
 
     for (; sys_files && *sys_files; ++sys_files)
         if (!load_file (*sys_files, MOO_PREFS_SYS, error))
-            return FALSE;
+            goto error;
 
     if (file_rc && !load_file (file_rc, MOO_PREFS_RC, error))
-        return FALSE;
+        goto error;
 
     if (file_state && !load_file (file_state, MOO_PREFS_STATE, error))
-        return FALSE;
+        goto error;
+
+    /* the docs now contain exactly what has been loaded */
+    g_hash_table_remove_all (prefs->dirty[MOO_PREFS_RC]);
+    g_hash_table_remove_all (prefs->dirty[MOO_PREFS_STATE]);
 
+    moo_dmsg ("moo_prefs_load: %u keys in %f s",
+              prefs->key_array->len - 1,
+              g_timer_elapsed (timer, NULL));
+    g_timer_destroy (timer);
     return TRUE;
+
+error:
+    g_timer_destroy (timer);
+    return FALSE;
 }
 
 
-typedef struct {
-    GPtrArray *keys;
-    MooPrefsKind prefs_kind;
-} CollectItemsData;
+static const char *
+item_type_name (PrefsItem *item)
+{
+    switch (item->type)
+    {
+        case G_TYPE_INT:
+            return "int";
+        case G_TYPE_STRING:
+            return "string";
+        case G_TYPE_BOOLEAN:
+            return "bool";
+    }
 
-static void
-collect_item (const char       *key,
-              PrefsItem        *item,
-              CollectItemsData *data)
+    g_return_val_if_reached (NULL);
+}
+
+static gboolean
+item_is_saved (PrefsItem    *item,
+               MooPrefsKind  prefs_kind)
 {
-    g_return_if_fail (key && *key && item);
-    g_return_if_fail (_moo_value_type_supported (item->type));
+    if (!item || item->prefs_kind != (guint) prefs_kind)
+        return FALSE;
 
-    if (item->prefs_kind != data->prefs_kind)
-        return;
+    g_return_val_if_fail (_moo_value_type_supported (item->type), FALSE);
 
     if (_moo_value_equal (&item->value, &item->default_value))
     {
 #ifdef MOO_PREFS_DEBUG_READWRITE
-        g_print ("skipping '%s'\n", key);
+        g_print ("skipping '%s'\n", item->key);
 #endif
-        return;
+        return FALSE;
     }
 
-    g_ptr_array_add (data->keys, (gpointer) key);
+    return TRUE;
 }
 
-static void
-write_item (const char    *key,
+static MooMarkupNode *
+write_item (PrefsItem     *item,
             MooMarkupNode *root)
 {
     const char *string = NULL;
     const char *type;
     MooMarkupNode *elm;
-    PrefsItem *item;
 
-    item = prefs_get_item (key);
-    g_return_if_fail (item != NULL);
+    if (!(type = item_type_name (item)))
+        return NULL;
 
     string = _moo_value_convert_to_string (&item->value);
 
     if (!string)
         string = "";
 
-    switch (item->type)
-    {
-        case G_TYPE_INT:
-            type = "int";
-            break;
-        case G_TYPE_STRING:
-            type = "string";
-            break;
-        case G_TYPE_BOOLEAN:
-            type = "bool";
-            break;
-        default:
-            g_return_if_reached ();
-    }
-
     elm = moo_markup_create_text_element (root, "item", string);
-    moo_markup_set_prop (elm, "name", key);
+    moo_markup_set_prop (elm, "name", item->key);
     moo_markup_set_prop (elm, "type", type);
 
 #ifdef MOO_PREFS_DEBUG_READWRITE
-    g_print ("writing key: '%s', type: '%s', val: '%s'\n", key, type, string);
+    g_print ("writing key: '%s', type: '%s', val: '%s'\n", item->key, type, string);
+#endif
+
+    return elm;
+}
+
+static void
+update_item (PrefsItem     *item,
+             MooMarkupNode *elm)
+{
+    const char *string;
+    const char *type;
+    const char *old_type;
+
+    if (!(type = item_type_name (item)))
+        return;
+
+    string = _moo_value_convert_to_string (&item->value);
+
+    if (!string)
+        string = "";
+
+    if (strcmp (MOO_NZS (MOO_MARKUP_ELEMENT (elm)->content), string) != 0)
+        moo_markup_set_content (elm, string);
+
+    old_type = moo_markup_get_prop (elm, "type");
+    if (!old_type || strcmp (old_type, type) != 0)
+        moo_markup_set_prop (elm, "type", type);
+
+#ifdef MOO_PREFS_DEBUG_READWRITE
+    g_print ("updating key: '%s', type: '%s', val: '%s'\n", item->key, type, string);
 #endif
 }
 
 static int
-compare_strings (gconstpointer a, gconstpointer b)
+compare_items (gconstpointer a, gconstpointer b)
 {
-    return strcmp (*(char**)a, *(char**)b);
+    return strcmp ((*(PrefsItem**)a)->key, (*(PrefsItem**)b)->key);
 }
 
+/* Writes out all the items, used when the doc was not loaded from a file */
 static void
-sync_xml (MooPrefsKind prefs_kind)
+sync_xml_all (MooMarkupDoc *xml,
+              MooPrefsKind  prefs_kind)
 {
     PrefsStore *prefs = prefs_instance ();
-    MooMarkupDoc *xml;
-    MooMarkupDoc **xml_ptr = NULL;
+    GHashTable *elements;
     MooMarkupNode *root;
-    CollectItemsData data;
-
-    switch (prefs_kind)
-    {
-        case MOO_PREFS_RC:
-            xml_ptr = &prefs->xml_rc;
-            break;
-        case MOO_PREFS_STATE:
-            xml_ptr = &prefs->xml_state;
-            break;
-        default:
-            g_return_if_reached ();
-            break;
-    }
-
-    if (!*xml_ptr)
-        *xml_ptr = create_markup_doc ();
+    GPtrArray *items;
+    guint i;
 
-    xml = *xml_ptr;
     root = moo_markup_get_element (MOO_MARKUP_NODE (xml), MOO_PREFS_ELEMENT "/" PREFS_ROOT);
 
     if (root)
         moo_markup_delete_node (root);
 
-    data.prefs_kind = prefs_kind;
-    data.keys = g_ptr_array_new ();
+    elements = prefs->elements[prefs_kind] = g_hash_table_new (g_str_hash, g_str_equal);
 
-    g_hash_table_foreach (prefs->data,
-                          (GHFunc) collect_item,
-                          &data);
+    items = g_ptr_array_new ();
 
-    if (data.keys->len > 0)
+    for (i = 1; i < prefs->key_array->len; ++i)
     {
-        guint i;
+        PrefsItem *item = ((PrefsKey*) prefs->key_array->pdata[i])->item;
+        if (item_is_saved (item, prefs_kind))
+            g_ptr_array_add (items, item);
+    }
 
-        g_ptr_array_sort (data.keys, compare_strings);
+    if (items->len > 0)
+    {
+        g_ptr_array_sort (items, compare_items);
 
         root = moo_markup_create_element (MOO_MARKUP_NODE (xml),
                                           MOO_PREFS_ELEMENT "/" PREFS_ROOT);
 
-        for (i = 0; i < data.keys->len; ++i)
-            write_item (data.keys->pdata[i], root);
+        for (i = 0; i < items->len; ++i)
+        {
+            PrefsItem *item = items->pdata[i];
+            MooMarkupNode *elm = write_item (item, root);
+            if (elm)
+                g_hash_table_insert (elements, (char*) item->key, elm);
+        }
     }
 
-    g_ptr_array_free (data.keys, TRUE);
+    g_ptr_array_free (items, TRUE);
+}
+
+typedef struct {
+    MooMarkupDoc *xml;
+    MooPrefsKind prefs_kind;
+} SyncKeyData;
+
+static void
+sync_key (const char   *key,
+          G_GNUC_UNUSED gpointer value,
+          SyncKeyData  *data)
+{
+    PrefsStore *prefs = prefs_instance ();
+    MooMarkupDoc *xml = data->xml;
+    GHashTable *elements;
+    MooMarkupNode *elm;
+    PrefsItem *item;
+
+    elements = prefs->elements[data->prefs_kind];
+    elm = g_hash_table_lookup (elements, key);
+    item = prefs_get_item (key);
+
+    if (!item_is_saved (item, data->prefs_kind))
+    {
+        if (elm)
+        {
+            moo_markup_delete_node (elm);
+            g_hash_table_remove (elements, key);
+        }
+    }
+    else if (elm)
+    {
+        update_item (item, elm);
+    }
+    else
+    {
+        MooMarkupNode *root;
+
+        root = moo_markup_get_element (MOO_MARKUP_NODE (xml), MOO_PREFS_ELEMENT "/" PREFS_ROOT);
+
+        if (!root)
+            root = moo_markup_create_element (MOO_MARKUP_NODE (xml),
+                                              MOO_PREFS_ELEMENT "/" PREFS_ROOT);
+
+        if ((elm = write_item (item, root)))
+            g_hash_table_insert (elements, (char*) item->key, elm);
+    }
+}
+
+/* Only the keys changed since the doc was loaded or saved are written,
+ * unchanged elements are left alone */
+static void
+sync_xml (MooPrefsKind prefs_kind)
+{
+    PrefsStore *prefs = prefs_instance ();
+    MooMarkupDoc **xml_ptr;
+
+    xml_ptr = prefs_doc_ptr (prefs_kind);
+    g_return_if_fail (xml_ptr != NULL);
+
+    if (!*xml_ptr)
+        *xml_ptr = create_markup_doc ();
+
+    if (!prefs->elements[prefs_kind])
+    {
+        sync_xml_all (*xml_ptr, prefs_kind);
+    }
+    else
+    {
+        SyncKeyData data;
+        data.xml = *xml_ptr;
+        data.prefs_kind = prefs_kind;
+        g_hash_table_foreach (prefs->dirty[prefs_kind],
+                              (GHFunc) sync_key,
+                              &data);
+    }
+
+    g_hash_table_remove_all (prefs->dirty[prefs_kind]);
 }
 
 
@@ -830,15 +1162,12 @@ static gboolean
 check_modified (MooPrefsKind prefs_kind)
 {
     PrefsStore *prefs = prefs_instance ();
-    MooMarkupDoc *xml = prefs->xml_rc;
+    MooMarkupDoc *xml = *prefs_doc_ptr (prefs_kind);
 
-    if (prefs_kind != MOO_PREFS_RC)
+    if (g_hash_table_size (prefs->dirty[prefs_kind]) != 0)
         return TRUE;
 
-    if (xml && _moo_markup_get_modified (xml))
-        return TRUE;
-    else
-        return prefs->rc_modified;
+    return xml && _moo_markup_get_modified (xml);
 }
 
 static gboolean
@@ -849,7 +1178,6 @@ save_file (const char    *file,
     MooMarkupDoc *xml = NULL;
     MooMarkupNode *node;
     gboolean empty;
-    PrefsStore *prefs = prefs_instance ();
     MooFileWriter *writer;
 
     if (!check_modified (prefs_kind))
@@ -857,16 +1185,7 @@ save_file (const char    *file,
 
     sync_xml (prefs_kind);
 
-    switch (prefs_kind)
-    {
-        case MOO_PREFS_RC:
-            xml = prefs->xml_rc;
-            break;
-        case MOO_PREFS_STATE:
-            xml = prefs->xml_state;
-            break;
-    }
-
+    xml = *prefs_doc_ptr (prefs_kind);
     g_return_val_if_fail (xml != NULL, FALSE);
 
     empty = TRUE;
@@ -888,7 +1207,12 @@ save_file (const char    *file,
     if ((writer = moo_config_writer_new (file, FALSE, error)))
     {
         moo_markup_write_pretty (xml, writer, 2);
-        return moo_file_writer_close (writer, error);
+
+        if (!moo_file_writer_close (writer, error))
+            return FALSE;
+
+        _moo_markup_set_modified (xml, FALSE);
+        return TRUE;
     }
 
     return FALSE;
@@ -900,23 +1224,21 @@ moo_prefs_save (const char  *file_rc,
                 const char  *file_state,
                 GError     **error)
 {
-    PrefsStore *prefs = prefs_instance ();
+    GTimer *timer;
+    gboolean retval;
 
     g_return_val_if_fail (file_rc != NULL, FALSE);
     g_return_val_if_fail (file_state != NULL, FALSE);
 
-    if (save_file (file_rc, MOO_PREFS_RC, error))
-    {
-        if (prefs->xml_rc)
-            _moo_markup_set_modified (prefs->xml_rc, FALSE);
-        moo_prefs_set_modified (FALSE);
-    }
-    else
-    {
-        return FALSE;
-    }
+    timer = g_timer_new ();
+
+    retval = save_file (file_rc, MOO_PREFS_RC, error) &&
+             save_file (file_state, MOO_PREFS_STATE, error);
 
-    return save_file (file_state, MOO_PREFS_STATE, error);
+    moo_dmsg ("moo_prefs_save: %f s", g_timer_elapsed (timer, NULL));
+    g_timer_destroy (timer);
+
+    return retval;
 }
 
 
@@ -1220,3 +1542,109 @@ moo_prefs_set_bool (const char *key,
     moo_prefs_set (key, &gval);
     g_value_unset (&gval);
 }
+
+
+/***************************************************************************/
+/* Interned keys
+ */
+
+MooPrefsKey
+moo_prefs_intern_key (const char *key)
+{
+    g_return_val_if_fail (key && key[0], 0);
+    return prefs_intern (key)->id;
+}
+
+const char *
+moo_prefs_key_name (MooPrefsKey key)
+{
+    PrefsStore *prefs = prefs_instance ();
+    g_return_val_if_fail (key > 0 && key < prefs->key_array->len, NULL);
+    return ((PrefsKey*) prefs->key_array->pdata[key])->name;
+}
+
+static const GValue *
+prefs_key_get (MooPrefsKey key,
+               GType       type)
+{
+    PrefsItem *item = prefs_get_item_by_id (key);
+
+    if (G_UNLIKELY (!item))
+    {
+        g_warning ("key '%s' not registered", moo_prefs_key_name (key));
+        return NULL;
+    }
+
+    g_return_val_if_fail (item->type == type, NULL);
+
+    return &item->value;
+}
+
+static void
+prefs_key_set (MooPrefsKey   key,
+               const GValue *value)
+{
+    PrefsItem *item = prefs_get_item_by_id (key);
+
+    if (!item)
+    {
+        g_warning ("key '%s' not registered", moo_prefs_key_name (key));
+        return;
+    }
+
+    moo_prefs_set (item->key, value);
+}
+
+gboolean
+moo_prefs_key_get_bool (MooPrefsKey key)
+{
+    const GValue *value = prefs_key_get (key, G_TYPE_BOOLEAN);
+    return value ? g_value_get_boolean (value) : FALSE;
+}
+
+int
+moo_prefs_key_get_int (MooPrefsKey key)
+{
+    const GValue *value = prefs_key_get (key, G_TYPE_INT);
+    return value ? g_value_get_int (value) : 0;
+}
+
+const char *
+moo_prefs_key_get_string (MooPrefsKey key)
+{
+    const GValue *value = prefs_key_get (key, G_TYPE_STRING);
+    return value ? g_value_get_string (value) : NULL;
+}
+
+void
+moo_prefs_key_set_bool (MooPrefsKey key,
+                        gboolean    val)
+{
+    GValue gval = { 0 };
+    g_value_init (&gval, G_TYPE_BOOLEAN);
+    g_value_set_boolean (&gval, val);
+    prefs_key_set (key, &gval);
+    g_value_unset (&gval);
+}
+
+void
+moo_prefs_key_set_int (MooPrefsKey key,
+                       int         val)
+{
+    GValue gval = { 0 };
+    g_value_init (&gval, G_TYPE_INT);
+    g_value_set_int (&gval, val);
+    prefs_key_set (key, &gval);
+    g_value_unset (&gval);
+}
+
+void
+moo_prefs_key_set_string (MooPrefsKey  key,
+                          const char  *val)
+{
+    GValue gval = { 0 };
+    g_value_init (&gval, G_TYPE_STRING);
+    g_value_set_static_string (&gval, val);
+    prefs_key_set (key, &gval);
+    g_value_unset (&gval);
+}
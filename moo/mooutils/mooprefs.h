@@ -89,6 +89,41 @@ void            moo_prefs_set_int       (const char     *key,
 void            moo_prefs_set_bool      (const char     *key,
                                          gboolean        val);
 
+/* Interned keys. Looking a value up by MooPrefsKey is an array access
+ * instead of hashing the key string, use it for prefs read in hot
+ * paths. A key id stays valid for the lifetime of the program, it may
+ * be obtained before the key is registered and survives deleting it. */
+typedef guint MooPrefsKey;
+
+MooPrefsKey     moo_prefs_intern_key    (const char     *key);
+const char     *moo_prefs_key_name      (MooPrefsKey     key);
+
+gboolean        moo_prefs_key_get_bool  (MooPrefsKey     key);
+int             moo_prefs_key_get_int   (MooPrefsKey     key);
+const char     *moo_prefs_key_get_string(MooPrefsKey     key);
+void            moo_prefs_key_set_bool  (MooPrefsKey     key,
+                                         gboolean        val);
+void            moo_prefs_key_set_int   (MooPrefsKey     key,
+                                         int             val);
+void            moo_prefs_key_set_string(MooPrefsKey     key,
+                                         const char     *val);
+
+/* Change notifications. func is called for every changed key starting
+ * with prefix (all keys if prefix is NULL). Between begin_changes() and
+ * end_changes() notifications are collected and emitted once per key
+ * when the outermost end_changes() is called. */
+typedef void    (*MooPrefsNotify)       (const char     *key,
+                                         gpointer        data);
+
+guint           moo_prefs_notify_connect    (const char     *prefix,
+                                             MooPrefsNotify  func,
+                                             gpointer        data,
+                                             GDestroyNotify  notify);
+void            moo_prefs_notify_disconnect (guint           id);
+
+void            moo_prefs_begin_changes     (void);
+void            moo_prefs_end_changes       (void);
+
 G_END_DECLS
 
 #endif /* MOO_PREFS_H */
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "marshals.h"
 #include "mooutils/mooprefsdialog.h"
+#include "mooutils/mooprefs.h"
 #include "mooutils/moodialogs.h"
 #include "mooutils/moohelp.h"
 #include "mooutils/mooutils-treeview.h"
@@ -380,6 +381,16 @@ moo_prefs_dialog_run (MooPrefsDialog *dialog,
 }
 
 
+/* pages set prefs one by one, listeners are notified once
+ * after all of them have been applied */
+static void
+emit_apply (GtkDialog *dialog)
+{
+    moo_prefs_begin_changes ();
+    g_signal_emit_by_name (dialog, "apply");
+    moo_prefs_end_changes ();
+}
+
 static void
 moo_prefs_dialog_response (GtkDialog *dialog,
                            int        response)
@@ -391,11 +402,11 @@ moo_prefs_dialog_response (GtkDialog *dialog,
             break;
 
         case GTK_RESPONSE_APPLY:
-            g_signal_emit_by_name (dialog, "apply");
+            emit_apply (dialog);
             break;
 
         case GTK_RESPONSE_OK:
-            g_signal_emit_by_name (dialog, "apply");
+            emit_apply (dialog);
             /* fallthrough */
 
         default:
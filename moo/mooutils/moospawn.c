@@ -27,6 +27,8 @@
 #include <windows.h>
 #endif
 
+/* bytes read from a pipe per main loop iteration */
+#define CMD_READ_LIMIT 65536
 
 typedef struct {
     MooCmd *cmd;
@@ -332,7 +334,7 @@ command_out_or_err (MooCmd         *cmd,
     count = 0;
     lines = NULL;
 
-    while (count < 4096)
+    while (count < CMD_READ_LIMIT)
     {
         char *line = NULL;
         gsize line_end;
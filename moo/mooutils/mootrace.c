@@ -0,0 +1,212 @@
+/*
+ *   mootrace.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mooutils/mootrace.h"
+#include "mooutils/mooutils-misc.h"
+
+/* a long session must not eat all memory */
+#define MAX_EVENTS 2000000
+
+typedef struct {
+    char phase;         /* 'B', 'E' or 'C' */
+    guint tid;
+    gint64 ts;          /* microseconds since the trace started */
+    const char *name;
+    char *detail;
+    gint64 value;
+} TraceEvent;
+
+gboolean _moo_trace_enabled;
+
+static struct {
+    char *filename;
+    gint64 start;
+    GArray *events;
+    GHashTable *threads;    /* GThread* -> id */
+    guint dropped;
+} trace;
+
+G_LOCK_DEFINE_STATIC (trace);
+
+
+void
+_moo_trace_start (const char *filename)
+{
+    g_return_if_fail (filename != NULL);
+    g_return_if_fail (!trace.filename);
+
+    trace.filename = g_strdup (filename);
+    trace.start = g_get_monotonic_time ();
+    trace.events = g_array_sized_new (FALSE, FALSE, sizeof (TraceEvent), 4096);
+    trace.threads = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    /* the thread which starts tracing is "main" */
+    g_hash_table_insert (trace.threads, g_thread_self (), GUINT_TO_POINTER (1));
+
+    _moo_trace_enabled = TRUE;
+}
+
+static guint
+thread_id (void)
+{
+    GThread *thread = g_thread_self ();
+    guint id = GPOINTER_TO_UINT (g_hash_table_lookup (trace.threads, thread));
+
+    if (!id)
+    {
+        id = g_hash_table_size (trace.threads) + 1;
+        g_hash_table_insert (trace.threads, thread, GUINT_TO_POINTER (id));
+    }
+
+    return id;
+}
+
+static void
+add_event (char        phase,
+           const char *name,
+           const char *detail,
+           gint64      value)
+{
+    TraceEvent event;
+    gint64 now = g_get_monotonic_time ();
+
+    G_LOCK (trace);
+
+    if (!_moo_trace_enabled)
+    {
+        G_UNLOCK (trace);
+        return;
+    }
+
+    if (trace.events->len >= MAX_EVENTS)
+    {
+        trace.dropped += 1;
+        G_UNLOCK (trace);
+        return;
+    }
+
+    event.phase = phase;
+    event.tid = thread_id ();
+    event.ts = now - trace.start;
+    event.name = name;
+    event.detail = g_strdup (detail);
+    event.value = value;
+
+    g_array_append_val (trace.events, event);
+
+    G_UNLOCK (trace);
+}
+
+void
+_moo_trace_begin (const char *name,
+                  const char *detail)
+{
+    g_return_if_fail (name != NULL);
+    add_event ('B', name, detail, 0);
+}
+
+void
+_moo_trace_end (const char *name)
+{
+    g_return_if_fail (name != NULL);
+    add_event ('E', name, NULL, 0);
+}
+
+void
+_moo_trace_counter (const char *name,
+                    gint64      value)
+{
+    g_return_if_fail (name != NULL);
+    add_event ('C', name, NULL, value);
+}
+
+
+static void
+append_event (GString          *out,
+              const TraceEvent *event)
+{
+    g_string_append (out, ",\n{\"name\": ");
+    _moo_string_append_json (out, event->name);
+    g_string_append_printf (out, ", \"ph\": \"%c\", \"ts\": %" G_GINT64_FORMAT
+                                 ", \"pid\": 1, \"tid\": %u",
+                            event->phase, event->ts, event->tid);
+
+    if (event->phase == 'C')
+    {
+        g_string_append (out, ", \"args\": {\"value\": ");
+        g_string_append_printf (out, "%" G_GINT64_FORMAT "}", event->value);
+    }
+    else if (event->detail)
+    {
+        g_string_append (out, ", \"args\": {\"detail\": ");
+        _moo_string_append_json (out, event->detail);
+        g_string_append_c (out, '}');
+    }
+
+    g_string_append_c (out, '}');
+}
+
+/**
+ * _moo_trace_stop:
+ *
+ * Stops tracing and writes the trace file.
+ */
+void
+_moo_trace_stop (void)
+{
+    GString *out;
+    GError *error = NULL;
+    guint i;
+
+    if (!trace.filename)
+        return;
+
+    G_LOCK (trace);
+    _moo_trace_enabled = FALSE;
+    G_UNLOCK (trace);
+
+    out = g_string_sized_new (trace.events->len * 80 + 256);
+
+    g_string_append (out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    g_string_append (out, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+                          "\"args\": {\"name\": \"main\"}}");
+
+    for (i = 0; i < trace.events->len; ++i)
+    {
+        TraceEvent *event = &g_array_index (trace.events, TraceEvent, i);
+        append_event (out, event);
+        g_free (event->detail);
+    }
+
+    g_string_append (out, "\n]}\n");
+
+    if (trace.dropped)
+        g_warning ("trace is incomplete, %u events were dropped", trace.dropped);
+
+    if (!g_file_set_contents (trace.filename, out->str, out->len, &error))
+    {
+        g_warning ("could not save file %s: %s", trace.filename, moo_error_message (error));
+        g_error_free (error);
+    }
+
+    g_string_free (out, TRUE);
+    g_array_free (trace.events, TRUE);
+    g_hash_table_destroy (trace.threads);
+    g_free (trace.filename);
+    trace.events = NULL;
+    trace.threads = NULL;
+    trace.filename = NULL;
+    trace.dropped = 0;
+}
@@ -0,0 +1,99 @@
+/*
+ *   mootrace.h
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOO_TRACE_H
+#define MOO_TRACE_H
+
+#include <mooglib/moo-glib.h>
+
+G_BEGIN_DECLS
+
+/* Tracing of startup and slow operations, enabled with --trace=FILE.
+ * Spans and counters are written to FILE in the trace event format
+ * which chrome://tracing and other trace viewers read. When tracing is
+ * off, the macros only check a flag. Names must be static strings,
+ * details are copied. Spans must be ended on the thread which began
+ * them, in reverse order. */
+
+extern gboolean _moo_trace_enabled;
+
+#define MOO_TRACE_ENABLED() G_UNLIKELY (_moo_trace_enabled)
+
+#define MOO_TRACE_BEGIN(name)                       \
+G_STMT_START {                                      \
+    if (MOO_TRACE_ENABLED ())                       \
+        _moo_trace_begin (name, NULL);              \
+} G_STMT_END
+
+#define MOO_TRACE_BEGIN_DETAIL(name, detail)        \
+G_STMT_START {                                      \
+    if (MOO_TRACE_ENABLED ())                       \
+        _moo_trace_begin (name, detail);            \
+} G_STMT_END
+
+#define MOO_TRACE_END(name)                         \
+G_STMT_START {                                      \
+    if (MOO_TRACE_ENABLED ())                       \
+        _moo_trace_end (name);                      \
+} G_STMT_END
+
+#define MOO_TRACE_COUNTER(name, value)              \
+G_STMT_START {                                      \
+    if (MOO_TRACE_ENABLED ())                       \
+        _moo_trace_counter (name, value);           \
+} G_STMT_END
+
+void        _moo_trace_start        (const char *filename);
+void        _moo_trace_stop         (void);
+
+void        _moo_trace_begin        (const char *name,
+                                     const char *detail);
+void        _moo_trace_end          (const char *name);
+void        _moo_trace_counter      (const char *name,
+                                     gint64      value);
+
+G_END_DECLS
+
+#ifdef __cplusplus
+
+/* span which ends with the enclosing block */
+struct MooTraceScope
+{
+    MooTraceScope (const char *name, const char *detail = nullptr)
+        : m_name (MOO_TRACE_ENABLED () ? name : nullptr)
+    {
+        if (m_name)
+            _moo_trace_begin (m_name, detail);
+    }
+
+    ~MooTraceScope ()
+    {
+        if (m_name)
+            _moo_trace_end (m_name);
+    }
+
+    MooTraceScope (const MooTraceScope&) = delete;
+    MooTraceScope& operator= (const MooTraceScope&) = delete;
+
+private:
+    const char *m_name;
+};
+
+#define MOO_TRACE_SCOPE(name) MooTraceScope moo_trace_scope__ (name)
+#define MOO_TRACE_SCOPE_DETAIL(name, detail) MooTraceScope moo_trace_scope__ (name, detail)
+
+#endif /* __cplusplus */
+
+#endif /* MOO_TRACE_H */
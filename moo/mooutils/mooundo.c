@@ -50,11 +50,13 @@ A bit of how and why:
 
 typedef struct {
     GQueue *actions;
+    gsize size;
 } ActionGroup;
 
 typedef struct {
     guint type;
     MooUndoAction *action;
+    gsize size;
 } Wrapper;
 
 
@@ -79,8 +81,8 @@ static void     moo_undo_stack_get_property (GObject        *object,
 static void     moo_undo_stack_undo_real    (MooUndoStack   *stack);
 static void     moo_undo_stack_redo_real    (MooUndoStack   *stack);
 
-static void     action_stack_free           (GSList        **stack,
-                                             gpointer        doc);
+static void     action_stack_free           (MooUndoStack   *stack,
+                                             GSList        **list);
 
 
 G_DEFINE_TYPE(MooUndoStack, moo_undo_stack, G_TYPE_OBJECT)
@@ -175,8 +177,8 @@ moo_undo_stack_finalize (GObject *object)
 {
     MooUndoStack *stack = MOO_UNDO_STACK (object);
 
-    action_stack_free (&stack->undo_stack, stack->document);
-    action_stack_free (&stack->redo_stack, stack->document);
+    action_stack_free (stack, &stack->undo_stack);
+    action_stack_free (stack, &stack->redo_stack);
 
     G_OBJECT_CLASS(moo_undo_stack_parent_class)->finalize (object);
 }
@@ -372,13 +374,25 @@ moo_undo_stack_redo_real (MooUndoStack *stack)
 }
 
 
+static gsize
+wrapper_size (Wrapper  *wrapper,
+              gpointer  doc)
+{
+    gsize size = sizeof (Wrapper);
+    if (WRAPPER_VTABLE(wrapper)->size)
+        size += WRAPPER_VTABLE(wrapper)->size (wrapper->action, doc);
+    return size;
+}
+
 static Wrapper *
 wrapper_new (guint          type,
-             MooUndoAction *action)
+             MooUndoAction *action,
+             gpointer       doc)
 {
     Wrapper *w = g_new0 (Wrapper, 1);
     w->type = type;
     w->action = action;
+    w->size = wrapper_size (w, doc);
     return w;
 }
 
@@ -418,12 +432,45 @@ action_group_new (void)
 
 
 static void
-action_stack_free (GSList **stack,
-                   gpointer doc)
+action_stack_free (MooUndoStack *stack,
+                   GSList      **list)
 {
-    g_slist_foreach (*stack, (GFunc) action_group_free, doc);
-    g_slist_free (*stack);
-    *stack = NULL;
+    GSList *l;
+
+    for (l = *list; l != NULL; l = l->next)
+    {
+        ActionGroup *group = l->data;
+        stack->size -= group->size;
+        action_group_free (group, stack->document);
+    }
+
+    g_slist_free (*list);
+    *list = NULL;
+}
+
+/* drops the oldest undo groups until the stack fits into max_size */
+static void
+action_stack_trim (MooUndoStack *stack)
+{
+    if (!stack->max_size)
+        return;
+
+    while (stack->size > stack->max_size &&
+           stack->undo_stack && stack->undo_stack->next)
+    {
+        GSList *l = stack->undo_stack;
+        ActionGroup *group;
+
+        while (l->next->next)
+            l = l->next;
+
+        group = l->next->data;
+        g_slist_free_1 (l->next);
+        l->next = NULL;
+
+        stack->size -= group->size;
+        action_group_free (group, stack->document);
+    }
 }
 
 
@@ -437,8 +484,8 @@ moo_undo_stack_clear (MooUndoStack *stack)
     notify_undo = stack->undo_stack != NULL;
     notify_redo = stack->redo_stack != NULL;
 
-    action_stack_free (&stack->undo_stack, stack->document);
-    action_stack_free (&stack->redo_stack, stack->document);
+    action_stack_free (stack, &stack->undo_stack);
+    action_stack_free (stack, &stack->redo_stack);
     stack->new_group = FALSE;
 
     g_object_freeze_notify (G_OBJECT (stack));
@@ -468,6 +515,9 @@ action_group_merge (ActionGroup    *group,
     if (WRAPPER_VTABLE(old)->merge (old->action, action, doc))
     {
         TYPE_VTABLE(type)->destroy (action, doc);
+        group->size -= old->size;
+        old->size = wrapper_size (old, doc);
+        group->size += old->size;
         return TRUE;
     }
     else
@@ -485,8 +535,9 @@ action_group_add (ActionGroup    *group,
 {
     if (!try_merge || !action_group_merge (group, type, action, doc))
     {
-        Wrapper *wrapper = wrapper_new (type, action);
+        Wrapper *wrapper = wrapper_new (type, action, doc);
         g_queue_push_head (group->actions, wrapper);
+        group->size += wrapper->size;
     }
 }
 
@@ -498,6 +549,7 @@ moo_undo_stack_add_action (MooUndoStack   *stack,
 {
     gboolean notify_redo, notify_undo;
     ActionGroup *group;
+    gsize old_size = 0;
 
     g_return_if_fail (MOO_IS_UNDO_STACK (stack));
     g_return_if_fail (action != NULL);
@@ -521,25 +573,31 @@ moo_undo_stack_add_action (MooUndoStack   *stack,
     else if (stack->do_continue)
     {
         group = stack->undo_stack->data;
+        old_size = group->size;
         action_group_add (group, type, action, TRUE, stack->document);
     }
     else
     {
         group = stack->undo_stack->data;
+        old_size = group->size;
 
         if (!action_group_merge (group, type, action, stack->document))
         {
+            old_size = 0;
             group = action_group_new ();
             stack->undo_stack = g_slist_prepend (stack->undo_stack, group);
             action_group_add (group, type, action, TRUE, stack->document);
         }
     }
 
+    stack->size += group->size - old_size;
+
     stack->new_group = FALSE;
     if (stack->continue_group)
         stack->do_continue = TRUE;
 
-    action_stack_free (&stack->redo_stack, stack->document);
+    action_stack_free (stack, &stack->redo_stack);
+    action_stack_trim (stack);
 
     g_object_freeze_notify (G_OBJECT (stack));
 
@@ -552,6 +610,16 @@ moo_undo_stack_add_action (MooUndoStack   *stack,
 }
 
 
+void
+moo_undo_stack_set_max_size (MooUndoStack *stack,
+                             gsize         max_size)
+{
+    g_return_if_fail (MOO_IS_UNDO_STACK (stack));
+    stack->max_size = max_size;
+    action_stack_trim (stack);
+}
+
+
 void
 moo_undo_stack_start_group (MooUndoStack *stack)
 {
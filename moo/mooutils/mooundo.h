@@ -44,6 +44,9 @@ typedef gboolean (*MooUndoActionMerge)  (MooUndoAction  *action,
                                          gpointer        document);
 typedef void     (*MooUndoActionDestroy)(MooUndoAction  *action,
                                          gpointer        document);
+/* memory used by the action, optional */
+typedef gsize    (*MooUndoActionSize)   (MooUndoAction  *action,
+                                         gpointer        document);
 
 struct _MooUndoActionClass
 {
@@ -51,6 +54,7 @@ struct _MooUndoActionClass
     MooUndoActionRedo redo;
     MooUndoActionMerge merge;
     MooUndoActionDestroy destroy;
+    MooUndoActionSize size;
 };
 
 struct _MooUndoStack
@@ -65,6 +69,9 @@ struct _MooUndoStack
     guint continue_group;
     gboolean do_continue;
     gboolean new_group;
+
+    gsize max_size; /* 0 means no limit */
+    gsize size;
 };
 
 struct _MooUndoStackClass
@@ -87,6 +94,10 @@ void            moo_undo_stack_add_action   (MooUndoStack       *stack,
                                              MooUndoAction      *action);
 
 void            moo_undo_stack_clear        (MooUndoStack       *stack);
+/* oldest undo groups are dropped when the actions in the stack take more
+ * than max_size bytes; the last group is always kept */
+void            moo_undo_stack_set_max_size (MooUndoStack       *stack,
+                                             gsize               max_size);
 void            moo_undo_stack_freeze       (MooUndoStack       *stack);
 void            moo_undo_stack_thaw         (MooUndoStack       *stack);
 gboolean        moo_undo_stack_frozen       (MooUndoStack       *stack);
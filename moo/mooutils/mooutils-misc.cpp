@@ -2078,6 +2078,29 @@ _moo_strv_reverse (char **str_array)
 }
 
 
+void
+_moo_string_append_json (GString    *json,
+                         const char *string)
+{
+    g_return_if_fail (json != NULL && string != NULL);
+
+    g_string_append_c (json, '"');
+
+    for ( ; *string; ++string)
+    {
+        if (*string == '"' || *string == '\\')
+            g_string_append_c (json, '\\');
+
+        if ((guchar) *string < 0x20)
+            g_string_append_printf (json, "\\u%04x", (guint) (guchar) *string);
+        else
+            g_string_append_c (json, *string);
+    }
+
+    g_string_append_c (json, '"');
+}
+
+
 #if defined(__WIN32__) && !defined(MOO_DEBUG)
 static guint saved_win32_error_mode;
 #endif
@@ -2260,6 +2283,34 @@ test_moo_splitlines (void)
 }
 
 
+static void
+test_append_json (void)
+{
+    guint i;
+
+    struct {
+        const char *s;
+        const char *json;
+    } cases[] = {
+        { "", "\"\"" },
+        { "abc", "\"abc\"" },
+        { "a\"b\\c", "\"a\\\"b\\\\c\"" },
+        { "a\nb\tc", "\"a\\u000ab\\u0009c\"" },
+        { "\303\251", "\"\303\251\"" }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (cases); ++i)
+    {
+        /* appends to what is already there */
+        GString *json = g_string_new ("[");
+        _moo_string_append_json (json, cases[i].s);
+        TEST_ASSERT_STR_EQ_MSG (json->str + 1, cases[i].json,
+                                "_moo_string_append_json(%s)", TEST_FMT_STR (cases[i].s));
+        g_string_free (json, TRUE);
+    }
+}
+
+
 static void
 test_types (void)
 {
@@ -2279,6 +2330,8 @@ moo_test_mooutils_misc (void)
 
     moo_test_suite_add_test (suite, "moo_splitlines", "test of moo_splitlines()",
                              (MooTestFunc) test_moo_splitlines, NULL);
+    moo_test_suite_add_test (suite, "_moo_string_append_json", "test of _moo_string_append_json()",
+                             (MooTestFunc) test_append_json, NULL);
     moo_test_suite_add_test (suite, "types", "sanity checks for Glib types",
                              (MooTestFunc) test_types, NULL);
 }
@@ -138,6 +138,9 @@ char      **moo_strnsplit_lines             (const char     *string,
 char      **moo_splitlines                  (const char     *string);
 
 char     **_moo_strv_reverse                (char          **str_array);
+/* appends string as a quoted and escaped JSON string */
+void        _moo_string_append_json         (GString        *json,
+                                             const char     *string);
 
 G_INLINE_FUNC gboolean
 moo_str_equal (const char *s1,
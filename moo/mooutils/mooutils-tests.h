@@ -25,6 +25,8 @@ void    moo_test_mooaccel           (void);
 void    moo_test_mooutils_fs        (void);
 void    moo_test_moo_file_writer    (void);
 void    moo_test_mooutils_misc      (void);
+void    moo_test_mooglade           (void);
+void    moo_test_mooprefs           (void);
 void    moo_test_i18n               (MooTestOptions opts);
 
 #ifdef __WIN32__
@@ -18,8 +18,12 @@
 #define MOO_DO_NOT_MANGLE_GLIB_FUNCTIONS
 #include "ctags-doc.h"
 #include "ctags-view.h"
+#include "ctags-index.h"
+#include "ctags-scan.h"
 #include "readtags.h"
+#include <mooedit/mooedit-impl.h>
 #include <mooutils/mooutils-misc.h>
+#include <mooutils/mooutils-thread.h>
 #include <mooutils/mootype-macros.h>
 #include <gtk/gtk.h>
 #include <string.h>
@@ -32,10 +36,23 @@
 MOO_DEFINE_BOXED_TYPE_R (MooCtagsEntry, _moo_ctags_entry)
 G_DEFINE_TYPE (MooCtagsDocPlugin, _moo_ctags_doc_plugin, MOO_TYPE_DOC_PLUGIN)
 
+/* don't rescan on every keystroke */
+#define CHANGED_TIMEOUT 1000
+
+typedef struct UpdateJob UpdateJob;
+
 struct _MooCtagsDocPluginPrivate
 {
     GtkTreeStore *store;
     guint update_idle;
+    guint changed_timeout;
+    UpdateJob *job;
+    MooCtagsScanCache *scan_cache;
+    /* lines changed since the last scan: first changed line and the
+     * number of untouched lines at the end of the buffer */
+    int first_changed;
+    int unchanged_tail;
+    guint update_again : 1;
 };
 
 typedef struct {
@@ -44,11 +61,36 @@ typedef struct {
     void (*process_list) (GSList *entries, GtkTreeStore *store);
 } MooCtagsLanguage;
 
+/* Symbols are extracted in a thread; the job owns everything it touches
+ * there, plugin field is only accessed in the main thread and is reset
+ * if the plugin is destroyed while the job is running. */
+struct UpdateJob {
+    MooCtagsDocPlugin *plugin;
+    char *text;
+    char *filename;
+    char *lang_id;
+    MooCtagsLanguage *lang;
+    MooCtagsScanCache *cache;
+    GSList *entries;
+    guint update : 1;       /* text is only the changed lines */
+    guint incomplete : 1;
+};
+
 static gboolean moo_ctags_doc_plugin_create         (MooCtagsDocPlugin  *plugin);
 static void     moo_ctags_doc_plugin_destroy        (MooCtagsDocPlugin  *plugin);
 
 static void     moo_ctags_doc_plugin_queue_update   (MooCtagsDocPlugin  *plugin);
 static gboolean moo_ctags_doc_plugin_update         (MooCtagsDocPlugin  *plugin);
+static void     moo_ctags_doc_plugin_buffer_changed (MooCtagsDocPlugin  *plugin);
+static void     moo_ctags_doc_plugin_insert_text    (GtkTextBuffer      *buffer,
+                                                     GtkTextIter        *where,
+                                                     const char         *text,
+                                                     int                 len,
+                                                     MooCtagsDocPlugin  *plugin);
+static void     moo_ctags_doc_plugin_delete_range   (GtkTextBuffer      *buffer,
+                                                     GtkTextIter        *start,
+                                                     GtkTextIter        *end,
+                                                     MooCtagsDocPlugin  *plugin);
 
 static GSList  *moo_ctags_parse_file                (const char         *filename,
                                                      const char         *opts);
@@ -70,6 +112,8 @@ _moo_ctags_doc_plugin_init (MooCtagsDocPlugin *plugin)
 {
     plugin->priv = G_TYPE_INSTANCE_GET_PRIVATE (plugin, MOO_TYPE_CTAGS_DOC_PLUGIN,
                                                 MooCtagsDocPluginPrivate);
+    plugin->priv->first_changed = G_MAXINT;
+    plugin->priv->unchanged_tail = G_MAXINT;
 }
 
 
@@ -90,14 +134,89 @@ ensure_model (MooCtagsDocPlugin *plugin)
         plugin->priv->store = gtk_tree_store_new (2, MOO_TYPE_CTAGS_ENTRY, G_TYPE_STRING);
 }
 
+static gboolean
+changed_timeout_func (MooCtagsDocPlugin *plugin)
+{
+    plugin->priv->changed_timeout = 0;
+    moo_ctags_doc_plugin_queue_update (plugin);
+    return FALSE;
+}
+
+static void
+moo_ctags_doc_plugin_buffer_changed (MooCtagsDocPlugin *plugin)
+{
+    if (!plugin->priv->changed_timeout)
+        plugin->priv->changed_timeout =
+            g_timeout_add_full (G_PRIORITY_LOW, CHANGED_TIMEOUT,
+                                (GSourceFunc) changed_timeout_func,
+                                plugin, NULL);
+}
+
+/* these run before the buffer is modified */
+static void
+lines_changed (MooCtagsDocPlugin *plugin,
+               GtkTextBuffer     *buffer,
+               int                first,
+               int                last)
+{
+    int tail = gtk_text_buffer_get_line_count (buffer) - 1 - last;
+    plugin->priv->first_changed = MIN (plugin->priv->first_changed, first);
+    plugin->priv->unchanged_tail = MIN (plugin->priv->unchanged_tail, tail);
+}
+
+static void
+moo_ctags_doc_plugin_insert_text (GtkTextBuffer     *buffer,
+                                  GtkTextIter       *where,
+                                  G_GNUC_UNUSED const char *text,
+                                  G_GNUC_UNUSED int  len,
+                                  MooCtagsDocPlugin *plugin)
+{
+    int line = gtk_text_iter_get_line (where);
+    lines_changed (plugin, buffer, line, line);
+}
+
+static void
+moo_ctags_doc_plugin_delete_range (GtkTextBuffer     *buffer,
+                                   GtkTextIter       *start,
+                                   GtkTextIter       *end,
+                                   MooCtagsDocPlugin *plugin)
+{
+    lines_changed (plugin, buffer,
+                   gtk_text_iter_get_line (start),
+                   gtk_text_iter_get_line (end));
+}
+
+static void
+moo_ctags_doc_plugin_saved (MooCtagsDocPlugin *plugin)
+{
+    char *filename = moo_edit_get_filename (MOO_DOC_PLUGIN (plugin)->doc);
+
+    moo_ctags_doc_plugin_queue_update (plugin);
+
+    if (filename)
+        _moo_ctags_index_file_changed (filename);
+
+    g_free (filename);
+}
+
 static gboolean
 moo_ctags_doc_plugin_create (MooCtagsDocPlugin *plugin)
 {
     ensure_model (plugin);
     moo_ctags_doc_plugin_queue_update (plugin);
 
+    g_signal_connect_swapped (moo_edit_get_buffer (MOO_DOC_PLUGIN (plugin)->doc), "changed",
+                              G_CALLBACK (moo_ctags_doc_plugin_buffer_changed),
+                              plugin);
+    g_signal_connect (moo_edit_get_buffer (MOO_DOC_PLUGIN (plugin)->doc), "insert-text",
+                      G_CALLBACK (moo_ctags_doc_plugin_insert_text),
+                      plugin);
+    g_signal_connect (moo_edit_get_buffer (MOO_DOC_PLUGIN (plugin)->doc), "delete-range",
+                      G_CALLBACK (moo_ctags_doc_plugin_delete_range),
+                      plugin);
+
     g_signal_connect_swapped (MOO_DOC_PLUGIN (plugin)->doc, "after-save",
-                              G_CALLBACK (moo_ctags_doc_plugin_queue_update),
+                              G_CALLBACK (moo_ctags_doc_plugin_saved),
                               plugin);
     g_signal_connect_swapped (MOO_DOC_PLUGIN (plugin)->doc, "filename-changed",
                               G_CALLBACK (moo_ctags_doc_plugin_queue_update),
@@ -109,15 +228,41 @@ moo_ctags_doc_plugin_create (MooCtagsDocPlugin *plugin)
 static void
 moo_ctags_doc_plugin_destroy (MooCtagsDocPlugin *plugin)
 {
+    g_signal_handlers_disconnect_by_func (MOO_DOC_PLUGIN (plugin)->doc,
+                                          (gpointer) moo_ctags_doc_plugin_saved,
+                                          plugin);
     g_signal_handlers_disconnect_by_func (MOO_DOC_PLUGIN (plugin)->doc,
                                           (gpointer) moo_ctags_doc_plugin_queue_update,
                                           plugin);
+    g_signal_handlers_disconnect_by_func (moo_edit_get_buffer (MOO_DOC_PLUGIN (plugin)->doc),
+                                          (gpointer) moo_ctags_doc_plugin_buffer_changed,
+                                          plugin);
+    g_signal_handlers_disconnect_by_func (moo_edit_get_buffer (MOO_DOC_PLUGIN (plugin)->doc),
+                                          (gpointer) moo_ctags_doc_plugin_insert_text,
+                                          plugin);
+    g_signal_handlers_disconnect_by_func (moo_edit_get_buffer (MOO_DOC_PLUGIN (plugin)->doc),
+                                          (gpointer) moo_ctags_doc_plugin_delete_range,
+                                          plugin);
 
     if (plugin->priv->update_idle)
         g_source_remove (plugin->priv->update_idle);
     plugin->priv->update_idle = 0;
 
-    g_object_unref (plugin->priv->store);
+    if (plugin->priv->changed_timeout)
+        g_source_remove (plugin->priv->changed_timeout);
+    plugin->priv->changed_timeout = 0;
+
+    /* the job finishes on its own, its results are dropped */
+    if (plugin->priv->job)
+        plugin->priv->job->plugin = NULL;
+    plugin->priv->job = NULL;
+
+    _moo_ctags_scan_cache_free (plugin->priv->scan_cache);
+    plugin->priv->scan_cache = NULL;
+
+    if (plugin->priv->store)
+        g_object_unref (plugin->priv->store);
+    plugin->priv->store = NULL;
 }
 
 
@@ -337,58 +482,379 @@ _moo_ctags_language_find_for_name (const char *lang_name)
 
 
 static void
-process_entries (MooCtagsDocPlugin *plugin,
-                 GSList            *list,
-                 MooCtagsLanguage  *lang)
+process_entries (GtkTreeStore     *store,
+                 GSList           *list,
+                 MooCtagsLanguage *lang)
 {
     g_return_if_fail (lang == NULL || lang->process_list != NULL);
 
     if (lang)
-        lang->process_list (list, plugin->priv->store);
+        lang->process_list (list, store);
     else
-        process_list_simple (list, plugin->priv->store);
+        process_list_simple (list, store);
+}
+
+
+/* Rows are matched by their label (group and class rows) or by
+ * kind/class/name (symbols); the entry in a matched row is replaced only
+ * when it actually changed, so that the view keeps its expanded rows,
+ * selection and scroll position. */
+static char *
+get_row_key (GtkTreeModel *model,
+             GtkTreeIter  *iter)
+{
+    MooCtagsEntry *entry;
+    char *label;
+    char *key;
+
+    gtk_tree_model_get (model, iter,
+                        MOO_CTAGS_VIEW_COLUMN_ENTRY, &entry,
+                        MOO_CTAGS_VIEW_COLUMN_LABEL, &label,
+                        -1);
+
+    if (label)
+        key = g_strconcat ("l:", label, NULL);
+    else if (entry)
+        key = g_strdup_printf ("e:%s:%s:%s", entry->kind,
+                               entry->klass ? entry->klass : "",
+                               entry->name);
+    else
+        key = g_strdup ("");
+
+    _moo_ctags_entry_unref (entry);
+    g_free (label);
+    return key;
+}
+
+static gboolean
+entries_equal (MooCtagsEntry *e1,
+               MooCtagsEntry *e2)
+{
+    if (!e1 || !e2)
+        return e1 == e2;
+
+    return e1->line == e2->line &&
+           e1->kind == e2->kind &&
+           e1->file_scope == e2->file_scope &&
+           moo_str_equal (e1->name, e2->name) &&
+           moo_str_equal (e1->klass, e2->klass) &&
+           moo_str_equal (e1->signature, e2->signature);
+}
+
+static void
+copy_row (GtkTreeStore *dest,
+          GtkTreeIter  *dest_iter,
+          GtkTreeModel *src,
+          GtkTreeIter  *src_iter,
+          gboolean      new_row)
+{
+    MooCtagsEntry *entry, *old_entry = NULL;
+    char *label, *old_label = NULL;
+
+    gtk_tree_model_get (src, src_iter,
+                        MOO_CTAGS_VIEW_COLUMN_ENTRY, &entry,
+                        MOO_CTAGS_VIEW_COLUMN_LABEL, &label,
+                        -1);
+
+    if (!new_row)
+        gtk_tree_model_get (GTK_TREE_MODEL (dest), dest_iter,
+                            MOO_CTAGS_VIEW_COLUMN_ENTRY, &old_entry,
+                            MOO_CTAGS_VIEW_COLUMN_LABEL, &old_label,
+                            -1);
+
+    if (new_row || !entries_equal (entry, old_entry) || !moo_str_equal (label, old_label))
+        gtk_tree_store_set (dest, dest_iter,
+                            MOO_CTAGS_VIEW_COLUMN_ENTRY, entry,
+                            MOO_CTAGS_VIEW_COLUMN_LABEL, label,
+                            -1);
+
+    _moo_ctags_entry_unref (old_entry);
+    _moo_ctags_entry_unref (entry);
+    g_free (old_label);
+    g_free (label);
+}
+
+static void
+sync_level (GtkTreeStore *dest,
+            GtkTreeIter  *dest_parent,
+            GtkTreeModel *src,
+            GtkTreeIter  *src_parent)
+{
+    GHashTable *src_keys;
+    GtkTreeIter src_iter, dest_iter;
+    gboolean dest_valid;
+
+    if (!gtk_tree_model_iter_children (src, &src_iter, src_parent))
+    {
+        if (gtk_tree_model_iter_children (GTK_TREE_MODEL (dest), &dest_iter, dest_parent))
+            while (gtk_tree_store_remove (dest, &dest_iter)) ;
+        return;
+    }
+
+    src_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    do
+        g_hash_table_insert (src_keys, get_row_key (src, &src_iter), NULL);
+    while (gtk_tree_model_iter_next (src, &src_iter));
+
+    gtk_tree_model_iter_children (src, &src_iter, src_parent);
+    dest_valid = gtk_tree_model_iter_children (GTK_TREE_MODEL (dest), &dest_iter, dest_parent);
+
+    do
+    {
+        char *key = get_row_key (src, &src_iter);
+        char *dest_key = NULL;
+
+        /* drop rows which are gone */
+        while (dest_valid)
+        {
+            dest_key = get_row_key (GTK_TREE_MODEL (dest), &dest_iter);
+
+            if (g_hash_table_lookup_extended (src_keys, dest_key, NULL, NULL))
+                break;
+
+            g_free (dest_key);
+            dest_key = NULL;
+            dest_valid = gtk_tree_store_remove (dest, &dest_iter);
+        }
+
+        if (dest_valid && !strcmp (key, dest_key))
+        {
+            copy_row (dest, &dest_iter, src, &src_iter, FALSE);
+            sync_level (dest, &dest_iter, src, &src_iter);
+            dest_valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (dest), &dest_iter);
+        }
+        else
+        {
+            GtkTreeIter new_iter;
+            gtk_tree_store_insert_before (dest, &new_iter, dest_parent,
+                                          dest_valid ? &dest_iter : NULL);
+            copy_row (dest, &new_iter, src, &src_iter, TRUE);
+            sync_level (dest, &new_iter, src, &src_iter);
+        }
+
+        g_free (dest_key);
+        g_free (key);
+    }
+    while (gtk_tree_model_iter_next (src, &src_iter));
+
+    if (dest_valid)
+        while (gtk_tree_store_remove (dest, &dest_iter)) ;
+
+    g_hash_table_destroy (src_keys);
+}
+
+static void
+set_entries (MooCtagsDocPlugin *plugin,
+             GSList            *list,
+             MooCtagsLanguage  *lang)
+{
+    GtkTreeStore *store;
+
+    store = gtk_tree_store_new (2, MOO_TYPE_CTAGS_ENTRY, G_TYPE_STRING);
+
+    if (list)
+        process_entries (store, list, lang);
+
+    sync_level (plugin->priv->store, NULL, GTK_TREE_MODEL (store), NULL);
+
+    g_object_unref (store);
+}
+
+
+static void
+update_job_free (UpdateJob *job)
+{
+    if (job)
+    {
+        g_slist_foreach (job->entries, (GFunc) _moo_ctags_entry_unref, NULL);
+        g_slist_free (job->entries);
+        _moo_ctags_scan_cache_free (job->cache);
+        g_free (job->text);
+        g_free (job->filename);
+        g_free (job->lang_id);
+        g_slice_free (UpdateJob, job);
+    }
+}
+
+/* main thread */
+static void
+update_jobs_done (GList *jobs)
+{
+    for ( ; jobs != NULL; jobs = jobs->next)
+    {
+        UpdateJob *job = jobs->data;
+        MooCtagsDocPlugin *plugin = job->plugin;
+
+        if (!plugin)
+            continue;
+
+        g_assert (plugin->priv->job == job);
+        plugin->priv->job = NULL;
+
+        plugin->priv->scan_cache = job->cache;
+        job->cache = NULL;
+
+        /* the changed lines were not enough, scan everything */
+        if (job->incomplete)
+        {
+            moo_ctags_doc_plugin_queue_update (plugin);
+            continue;
+        }
+
+        set_entries (plugin, job->entries, job->lang);
+
+        if (plugin->priv->update_again)
+        {
+            plugin->priv->update_again = FALSE;
+            moo_ctags_doc_plugin_queue_update (plugin);
+        }
+    }
+}
+
+static guint
+get_update_event_id (void)
+{
+    static guint event_id;
+
+    if (!event_id)
+        event_id = _moo_event_queue_connect ((MooEventQueueCallback) update_jobs_done,
+                                             NULL, NULL);
+
+    return event_id;
+}
+
+/* runs in a thread */
+static gboolean
+update_job_run (UpdateJob *job)
+{
+    if (!job->text && job->filename && _moo_ctags_scan_supports_lang (job->lang_id))
+    {
+        /* document is not loaded yet */
+        if (!g_file_get_contents (job->filename, &job->text, NULL, NULL))
+            job->text = NULL;
+    }
+
+    if (job->update)
+    {
+        if (!_moo_ctags_scan_text_update (job->text, job->cache, &job->entries))
+            job->incomplete = TRUE;
+    }
+    else if (job->text && _moo_ctags_scan_supports_lang (job->lang_id))
+    {
+        job->entries = _moo_ctags_scan_text (job->text, job->lang_id, job->cache);
+    }
+    else if (job->filename)
+    {
+        if (!job->lang || !(job->entries = moo_ctags_parse_file (job->filename, job->lang->opts)))
+        {
+            job->lang = NULL;
+            job->entries = moo_ctags_parse_file (job->filename, NULL);
+        }
+    }
+
+    _moo_event_queue_push (get_update_event_id (), job,
+                           (GDestroyNotify) update_job_free);
+    return FALSE;
 }
 
 static gboolean
 moo_ctags_doc_plugin_update (MooCtagsDocPlugin *plugin)
 {
     MooEdit *doc;
-    char *filename;
     GFile *file;
+    UpdateJob *job;
+    MooAsyncJob *async_job;
 
     plugin->priv->update_idle = 0;
 
-    gtk_tree_store_clear (plugin->priv->store);
+    if (plugin->priv->job)
+    {
+        plugin->priv->update_again = TRUE;
+        return FALSE;
+    }
 
     doc = MOO_DOC_PLUGIN (plugin)->doc;
 
+    job = g_slice_new0 (UpdateJob);
+    job->plugin = plugin;
+    job->lang_id = moo_edit_get_lang_id (doc);
+    job->lang = _moo_ctags_language_find_for_name (job->lang_id);
+
     file = moo_edit_get_file (doc);
-    filename = file ? g_file_get_path (file) : NULL;
+    job->filename = file ? g_file_get_path (file) : NULL;
+    moo_file_free (file);
 
-    if (filename && !g_file_test (filename, G_FILE_TEST_EXISTS))
+    if (job->filename && !g_file_test (job->filename, G_FILE_TEST_EXISTS))
     {
-        g_free (filename);
-        filename = NULL;
+        g_free (job->filename);
+        job->filename = NULL;
     }
 
-    if (filename)
+    job->cache = plugin->priv->scan_cache ? plugin->priv->scan_cache : _moo_ctags_scan_cache_new ();
+    plugin->priv->scan_cache = NULL;
+
+    /* scanner works on the buffer contents, so unsaved changes are
+     * picked up as well; ctags can only see the saved file */
+    if (_moo_ctags_scan_supports_lang (job->lang_id) && !_moo_edit_is_load_pending (doc))
+    {
+        GtkTextIter start, end;
+        GtkTextBuffer *buffer = moo_edit_get_buffer (doc);
+        int n_lines = gtk_text_buffer_get_line_count (buffer);
+        int start_line, end_line;
+
+        /* copy only the lines around the changes if the previous scan
+         * can be reused */
+        if (_moo_ctags_scan_cache_prepare (job->cache, job->lang_id,
+                                           plugin->priv->first_changed,
+                                           plugin->priv->unchanged_tail,
+                                           n_lines, &start_line, &end_line))
+        {
+            gtk_text_buffer_get_iter_at_line (buffer, &start, start_line);
+            if (end_line < n_lines)
+            {
+                gtk_text_buffer_get_iter_at_line (buffer, &end, end_line);
+                gtk_text_iter_forward_line (&end);
+            }
+            else
+            {
+                gtk_text_buffer_get_end_iter (buffer, &end);
+            }
+            job->update = TRUE;
+        }
+        else
+        {
+            gtk_text_buffer_get_bounds (buffer, &start, &end);
+        }
+
+        job->text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+    }
+    else
     {
-        GSList *list = NULL;
-        char *lang_id = moo_edit_get_lang_id (doc);
-        MooCtagsLanguage *ctags_lang = _moo_ctags_language_find_for_name (lang_id);
-
-        if (ctags_lang && (list = moo_ctags_parse_file (filename, ctags_lang->opts)))
-            process_entries (plugin, list, ctags_lang);
-        else if ((list = moo_ctags_parse_file (filename, NULL)))
-            process_entries (plugin, list, NULL);
-
-        g_slist_foreach (list, (GFunc) _moo_ctags_entry_unref, NULL);
-        g_slist_free (list);
-        g_free (lang_id);
+        /* changes are not tracked across this scan */
+        _moo_ctags_scan_cache_free (job->cache);
+        job->cache = _moo_ctags_scan_cache_new ();
     }
 
-    g_free (filename);
-    moo_file_free (file);
+    plugin->priv->first_changed = G_MAXINT;
+    plugin->priv->unchanged_tail = G_MAXINT;
+
+    if (!job->text && !job->filename)
+    {
+        plugin->priv->scan_cache = job->cache;
+        job->cache = NULL;
+        set_entries (plugin, NULL, NULL);
+        update_job_free (job);
+        return FALSE;
+    }
+
+    plugin->priv->job = job;
+
+    get_update_event_id ();
+    async_job = moo_async_job_new ((MooAsyncJobCallback) update_job_run, job, NULL);
+    moo_async_job_start (async_job);
+    g_object_unref (async_job);
+
     return FALSE;
 }
 
@@ -415,6 +881,32 @@ _moo_ctags_entry_unref (MooCtagsEntry *entry)
 }
 
 
+MooCtagsEntry *
+_moo_ctags_entry_new (const char *name,
+                      const char *kind,
+                      int         line,
+                      const char *klass,
+                      const char *signature,
+                      gboolean    file_scope)
+{
+    MooCtagsEntry *entry;
+
+    g_return_val_if_fail (name != NULL, NULL);
+    g_return_val_if_fail (kind != NULL, NULL);
+
+    entry = g_slice_new (MooCtagsEntry);
+    entry->ref_count = 1;
+
+    entry->name = g_strdup (name);
+    entry->line = line;
+    entry->kind = g_intern_string (kind);
+    entry->klass = g_strdup (klass);
+    entry->signature = g_strdup (signature);
+    entry->file_scope = file_scope != 0;
+
+    return entry;
+}
+
 static MooCtagsEntry *
 moo_ctags_entry_new (const tagEntry *te)
 {
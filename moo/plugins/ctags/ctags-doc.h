@@ -60,6 +60,12 @@ GType               _moo_ctags_doc_plugin_get_type      (void) G_GNUC_CONST;
 GtkTreeModel       *_moo_ctags_doc_plugin_get_store     (MooCtagsDocPlugin  *plugin);
 
 GType               _moo_ctags_entry_get_type           (void) G_GNUC_CONST;
+MooCtagsEntry      *_moo_ctags_entry_new                (const char         *name,
+                                                         const char         *kind,
+                                                         int                 line,
+                                                         const char         *klass,
+                                                         const char         *signature,
+                                                         gboolean            file_scope);
 MooCtagsEntry      *_moo_ctags_entry_ref                (MooCtagsEntry      *entry);
 void                _moo_ctags_entry_unref              (MooCtagsEntry      *entry);
 
@@ -0,0 +1,1411 @@
+/*
+ *   ctags-index.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Project-wide symbol index.
+ *
+ * Symbols of all files of a project are stored in a tags file in the
+ * user cache directory, in the extended ctags format sorted by name, so
+ * that names can be looked up with binary search by readtags. Besides
+ * the tags the file contains a !_MOO_FILE pseudo-tag with modification
+ * time for every indexed file, so that after a restart only files which
+ * changed are parsed again. Tags are not kept in memory: when the file
+ * is rewritten, lines of unchanged files are copied from the previous
+ * tags file and merged with the tags of the files parsed by the job.
+ *
+ * The index is built and updated by a job running in a thread: it walks
+ * the tree (or just the directories and files which changed), parses new
+ * and modified files with a pool of worker threads, and writes a new tags
+ * file. While the job is running it owns the file table, main thread keeps
+ * using the previous tags file. Saved documents are reported by the document
+ * plugin; directories are not watched, instead every CHECK_INTERVAL seconds
+ * a job stats the known directories and reads again the ones which changed.
+ */
+
+#include "config.h"
+#define MOO_DO_NOT_MANGLE_GLIB_FUNCTIONS
+#include "ctags-index.h"
+#include "ctags-scan.h"
+#include "readtags.h"
+#include "plugins/moofilecrawler.h"
+#include <mooglib/moo-stat.h>
+#include <mooutils/moofilewriter.h>
+#include <mooutils/moohistorylist.h>
+#include <mooutils/mooutils-misc.h>
+#include <mooutils/mooutils-thread.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define GREP_GLOB_LIST_ID   "FindPlugin/grep/glob"
+
+#define UPDATE_DELAY        1000
+#define MAX_FILE_SIZE       (2 * 1024 * 1024)
+#define CHECK_INTERVAL      30
+#define MAX_WORKERS         8
+
+#define FILE_PSEUDO_TAG     "!_MOO_FILE\t"
+
+typedef struct {
+    char *path;     /* relative to project root, key in files table */
+    gint64 mtime;
+    char *tags;     /* tag lines, each terminated by newline; only
+                       between parsing and writing the tags file */
+} IndexFile;
+
+/* Distinct names in the tags file, for fuzzy matching. Every name has
+ * a mask of the characters it contains, and for every character there
+ * is a list of the names containing it, so that a search only looks at
+ * the names containing the rarest character of the pattern. */
+#define N_NAME_CHARS 37
+
+typedef struct {
+    GArray *offsets;                    /* guint32: first line of the name */
+    GArray *masks;                      /* guint64 */
+    GArray *postings[N_NAME_CHARS];     /* guint32: indices in offsets */
+} NameIndex;
+
+typedef struct IndexJob IndexJob;
+
+struct _MooCtagsIndex {
+    char *root;
+    char *db_file;
+
+    IndexJob *job;
+    GHashTable *files;          /* char* -> IndexFile*, NULL while job is running */
+    GHashTable *dirs;           /* char* -> stamp, NULL while job is running */
+    GHashTable *pending_files;  /* char* -> NULL */
+    guint update_timeout;
+    guint check_timeout;
+    guint update_again : 1;
+
+    tagFile *tags;
+    GMappedFile *map;
+    NameIndex *names;
+};
+
+struct IndexJob {
+    MooCtagsIndex *index;       /* accessed in the main thread only */
+
+    char *root;
+    char *db_file;
+    GPatternSpec **globs;
+    MooFileCrawler *crawler;
+
+    gboolean load_db;
+    gboolean crawl;
+    GSList *pending_files;
+    GSList *pending_dirs;       /* changed directories */
+
+    GHashTable *files;
+    GHashTable *dirs;
+    GHashTable *to_scan;        /* paths of files to parse */
+    GHashTable *seen;           /* files found by the crawler */
+    gboolean changed;
+
+    GMappedFile *map;
+    NameIndex *names;
+};
+
+static GHashTable *indexes;     /* root -> MooCtagsIndex */
+
+static void     index_queue_update      (MooCtagsIndex  *index);
+static void     index_start_job         (MooCtagsIndex  *index);
+
+
+static const char *
+get_lang_id (const char *basename)
+{
+    static const struct {
+        const char *ext;
+        const char *lang_id;
+    } exts[] = {
+        { ".c", "c" }, { ".h", "chdr" }, { ".cpp", "cpp" }, { ".cc", "cpp" },
+        { ".cxx", "cpp" }, { ".hpp", "cpp" }, { ".hh", "cpp" }, { ".hxx", "cpp" },
+        { ".py", "python" },
+    };
+
+    const char *ext = strrchr (basename, '.');
+    guint i;
+
+    if (!ext)
+        return NULL;
+
+    for (i = 0; i < G_N_ELEMENTS (exts); ++i)
+        if (!strcmp (ext, exts[i].ext))
+            return exts[i].lang_id;
+
+    return NULL;
+}
+
+static int
+name_char_index (char c)
+{
+    c = g_ascii_tolower (c);
+
+    if (c >= 'a' && c <= 'z')
+        return c - 'a';
+    if (c >= '0' && c <= '9')
+        return 26 + c - '0';
+    if (c == '_')
+        return 36;
+
+    return -1;
+}
+
+static guint64
+name_mask (const char *name,
+           gsize       len)
+{
+    guint64 mask = 0;
+    gsize i;
+
+    for (i = 0; i < len; ++i)
+    {
+        int c = name_char_index (name[i]);
+        if (c >= 0)
+            mask |= G_GUINT64_CONSTANT (1) << c;
+    }
+
+    return mask;
+}
+
+static NameIndex *
+name_index_new (void)
+{
+    NameIndex *names = g_slice_new (NameIndex);
+    int c;
+
+    names->offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+    names->masks = g_array_new (FALSE, FALSE, sizeof (guint64));
+    for (c = 0; c < N_NAME_CHARS; ++c)
+        names->postings[c] = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+    return names;
+}
+
+static void
+name_index_add (NameIndex  *names,
+                guint32     offset,
+                const char *name,
+                gsize       len)
+{
+    guint32 i = names->offsets->len;
+    guint64 mask = name_mask (name, len);
+    int c;
+
+    g_array_append_val (names->offsets, offset);
+    g_array_append_val (names->masks, mask);
+
+    for (c = 0; c < N_NAME_CHARS; ++c)
+        if (mask & (G_GUINT64_CONSTANT (1) << c))
+            g_array_append_val (names->postings[c], i);
+}
+
+static void
+name_index_free (NameIndex *names)
+{
+    if (names)
+    {
+        int c;
+
+        g_array_free (names->offsets, TRUE);
+        g_array_free (names->masks, TRUE);
+        for (c = 0; c < N_NAME_CHARS; ++c)
+            g_array_free (names->postings[c], TRUE);
+
+        g_slice_free (NameIndex, names);
+    }
+}
+
+static const char *
+path_basename (const char *path)
+{
+    const char *slash = strrchr (path, G_DIR_SEPARATOR);
+    return slash ? slash + 1 : path;
+}
+
+static gboolean
+path_is_under (const char *path,
+               const char *dir)
+{
+    gsize len = strlen (dir);
+    return !dir[0] || (!strncmp (path, dir, len) &&
+                       (path[len] == 0 || path[len] == G_DIR_SEPARATOR));
+}
+
+
+/*************************************************************************/
+/* Files
+ */
+
+static IndexFile *
+index_file_new (const char *path,
+                gint64      mtime)
+{
+    IndexFile *file = g_slice_new0 (IndexFile);
+    file->path = g_strdup (path);
+    file->mtime = mtime;
+    return file;
+}
+
+static void
+index_file_free (IndexFile *file)
+{
+    if (file)
+    {
+        g_free (file->path);
+        g_free (file->tags);
+        g_slice_free (IndexFile, file);
+    }
+}
+
+static GHashTable *
+file_table_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                  (GDestroyNotify) index_file_free);
+}
+
+static GHashTable *
+path_set_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static void
+append_field (GString    *out,
+              const char *value)
+{
+    for ( ; *value; ++value)
+        g_string_append_c (out, *value == '\t' || *value == '\n' || *value == '\r' ? ' ' : *value);
+}
+
+/* worker thread */
+static void
+scan_file (IndexFile *file,
+           IndexJob  *job)
+{
+    char *filename;
+    char *text = NULL;
+    gsize len;
+    GSList *entries, *l;
+    GString *tags;
+
+    filename = g_build_filename (job->root, file->path, NULL);
+
+    if (!g_file_get_contents (filename, &text, &len, NULL) || memchr (text, 0, len))
+    {
+        g_free (text);
+        g_free (filename);
+        return;
+    }
+
+    entries = _moo_ctags_scan_text (text, get_lang_id (path_basename (file->path)), NULL);
+    tags = g_string_new (NULL);
+
+    for (l = entries; l != NULL; l = l->next)
+    {
+        MooCtagsEntry *e = l->data;
+
+        append_field (tags, e->name);
+        g_string_append_c (tags, '\t');
+        g_string_append (tags, file->path);
+        g_string_append_printf (tags, "\t%d;\"\t%s", e->line + 1, e->kind);
+
+        if (e->klass)
+        {
+            g_string_append (tags, "\tclass:");
+            append_field (tags, e->klass);
+        }
+
+        if (e->signature)
+        {
+            g_string_append (tags, "\tsignature:");
+            append_field (tags, e->signature);
+        }
+
+        if (e->file_scope)
+            g_string_append (tags, "\tfile:");
+
+        g_string_append_c (tags, '\n');
+
+        _moo_ctags_entry_unref (e);
+    }
+
+    g_slist_free (entries);
+    file->tags = g_string_free (tags, FALSE);
+    g_free (text);
+    g_free (filename);
+}
+
+
+/*************************************************************************/
+/* Job
+ */
+
+static void
+index_job_free (IndexJob *job)
+{
+    if (!job)
+        return;
+
+    _moo_file_crawler_free_patterns (job->globs);
+    _moo_file_crawler_free (job->crawler);
+
+    g_slist_foreach (job->pending_files, (GFunc) g_free, NULL);
+    g_slist_free (job->pending_files);
+    g_slist_foreach (job->pending_dirs, (GFunc) g_free, NULL);
+    g_slist_free (job->pending_dirs);
+
+    if (job->files)
+        g_hash_table_destroy (job->files);
+    if (job->dirs)
+        g_hash_table_destroy (job->dirs);
+    if (job->to_scan)
+        g_hash_table_destroy (job->to_scan);
+    if (job->map)
+        g_mapped_file_unref (job->map);
+    name_index_free (job->names);
+
+    g_free (job->root);
+    g_free (job->db_file);
+    g_slice_free (IndexJob, job);
+}
+
+/* only the file list is read, tags are copied from the file when
+ * it's written again */
+static void
+load_db (IndexJob *job)
+{
+    GMappedFile *map;
+    const char *p, *end;
+
+    if (!(map = g_mapped_file_new (job->db_file, FALSE, NULL)))
+        return;
+
+    p = g_mapped_file_get_contents (map);
+    end = p + g_mapped_file_get_length (map);
+
+    /* pseudo-tags go first in a sorted file */
+    while (p < end && *p == '!')
+    {
+        const char *eol = memchr (p, '\n', end - p);
+        gsize tag_len = strlen (FILE_PSEUDO_TAG);
+
+        if (!eol)
+            break;
+
+        if ((gsize) (eol - p) > tag_len && !strncmp (p, FILE_PSEUDO_TAG, tag_len))
+        {
+            const char *path = p + tag_len;
+            const char *tab = memchr (path, '\t', eol - path);
+
+            if (tab)
+            {
+                char *path_copy = g_strndup (path, tab - path);
+                IndexFile *file = index_file_new (path_copy, g_ascii_strtoll (tab + 1, NULL, 10));
+                g_hash_table_replace (job->files, file->path, file);
+                g_free (path_copy);
+            }
+        }
+
+        p = eol + 1;
+    }
+
+    g_mapped_file_unref (map);
+}
+
+static gboolean
+file_wanted (IndexJob   *job,
+             const char *name)
+{
+    return get_lang_id (name) != NULL &&
+           !_moo_file_crawler_skip_file (job->crawler, name) &&
+           (!job->globs || _moo_file_crawler_match_any (job->globs, name));
+}
+
+/* schedules file for parsing if it's new or modified; seen is the set
+ * of files found while walking a directory */
+static void
+check_file (IndexJob         *job,
+            const char       *path,
+            const MgwStatBuf *buf,
+            GHashTable       *seen)
+{
+    IndexFile *file;
+
+    if (buf->size > MAX_FILE_SIZE || strchr (path, '\t') || strchr (path, '\n'))
+        return;
+
+    file = g_hash_table_lookup (job->files, path);
+
+    if (!file)
+    {
+        file = index_file_new (path, buf->mtime.value);
+        g_hash_table_replace (job->files, file->path, file);
+        g_hash_table_insert (job->to_scan, g_strdup (path), NULL);
+        job->changed = TRUE;
+    }
+    else if (file->mtime != buf->mtime.value)
+    {
+        file->mtime = buf->mtime.value;
+        g_hash_table_insert (job->to_scan, g_strdup (path), NULL);
+        job->changed = TRUE;
+    }
+
+    if (seen)
+        g_hash_table_insert (seen, file->path, NULL);
+}
+
+/* crawler callbacks, called with the crawler lock held */
+static gboolean
+job_add_dir (const char       *path,
+             const MgwStatBuf *buf,
+             IndexJob         *job)
+{
+    if (g_hash_table_lookup_extended (job->dirs, path, NULL, NULL))
+        return FALSE;
+
+    g_hash_table_insert (job->dirs, g_strdup (path), _moo_file_crawler_dir_stamp (buf));
+    return TRUE;
+}
+
+static void
+job_add_file (const char       *path,
+              const MgwStatBuf *buf,
+              IndexJob         *job)
+{
+    if (file_wanted (job, path_basename (path)))
+        check_file (job, path, buf, job->seen);
+}
+
+typedef struct {
+    IndexJob *job;
+    GHashTable *seen;
+    const char *dir;
+} RemoveData;
+
+static gboolean
+remove_unseen_file (const char *path,
+                    G_GNUC_UNUSED IndexFile *file,
+                    RemoveData *data)
+{
+    if (data->dir)
+    {
+        /* only files directly in data->dir */
+        const char *slash = strrchr (path, G_DIR_SEPARATOR);
+        gsize len = slash ? (gsize) (slash - path) : 0;
+        if (len != strlen (data->dir) || strncmp (path, data->dir, len) != 0)
+            return FALSE;
+    }
+
+    if (g_hash_table_lookup_extended (data->seen, path, NULL, NULL))
+        return FALSE;
+
+    data->job->changed = TRUE;
+    return TRUE;
+}
+
+static gboolean
+remove_file_under (const char *path,
+                   G_GNUC_UNUSED gpointer value,
+                   RemoveData *data)
+{
+    if (!path_is_under (path, data->dir))
+        return FALSE;
+    data->job->changed = TRUE;
+    return TRUE;
+}
+
+static void
+rescan_dir (IndexJob   *job,
+            const char *path)
+{
+    RemoveData data;
+    char *dirname;
+    MgwStatBuf buf;
+    mgw_errno_t err;
+
+    data.job = job;
+    data.dir = path;
+
+    dirname = g_build_filename (job->root, path, NULL);
+
+    if (mgw_stat (dirname, &buf, &err) != 0 || !buf.isdir)
+    {
+        g_hash_table_foreach_remove (job->files, (GHRFunc) remove_file_under, &data);
+        g_hash_table_foreach_remove (job->dirs, (GHRFunc) remove_file_under, &data);
+    }
+    else
+    {
+        /* stamp is taken before reading, so that changes made meanwhile
+         * are seen by the next check */
+        g_hash_table_insert (job->dirs, g_strdup (path), _moo_file_crawler_dir_stamp (&buf));
+
+        data.seen = job->seen = g_hash_table_new (g_str_hash, g_str_equal);
+        _moo_file_crawler_run (job->crawler, path);
+        job->seen = NULL;
+        g_hash_table_foreach_remove (job->files, (GHRFunc) remove_unseen_file, &data);
+        g_hash_table_destroy (data.seen);
+    }
+
+    g_free (dirname);
+}
+
+static void
+rescan_file (IndexJob   *job,
+             const char *path)
+{
+    char *filename;
+    MgwStatBuf buf;
+    mgw_errno_t err;
+    IndexFile *file;
+
+    filename = g_build_filename (job->root, path, NULL);
+
+    if ((file = g_hash_table_lookup (job->files, path)))
+        /* modification time may be the same if file was saved twice
+         * in a second */
+        file->mtime = G_MININT64;
+
+    if (mgw_lstat (filename, &buf, &err) == 0 && buf.isreg &&
+        file_wanted (job, path_basename (path)))
+    {
+        check_file (job, path, &buf, NULL);
+    }
+    else if (file)
+    {
+        g_hash_table_remove (job->files, path);
+        job->changed = TRUE;
+    }
+
+    g_free (filename);
+}
+
+static void
+collect_lines (G_GNUC_UNUSED const char *path,
+               IndexFile  *file,
+               GPtrArray  *lines)
+{
+    char *p;
+
+    for (p = file->tags; p && *p; )
+    {
+        g_ptr_array_add (lines, p);
+        if (!(p = strchr (p, '\n')))
+            break;
+        p++;
+    }
+}
+
+static void
+append_file_pseudo_tag (G_GNUC_UNUSED const char *path,
+                        IndexFile *file,
+                        GString   *out)
+{
+    g_string_append_printf (out, FILE_PSEUDO_TAG "%s\t%" G_GINT64_FORMAT "\t//\n",
+                            file->path, file->mtime);
+}
+
+static void
+free_tags (G_GNUC_UNUSED const char *path,
+           IndexFile *file)
+{
+    g_free (file->tags);
+    file->tags = NULL;
+}
+
+/* lines are terminated by newline, shorter line goes first */
+static int
+compare_lines (const guchar **p1,
+               const guchar **p2)
+{
+    const guchar *s1 = *p1;
+    const guchar *s2 = *p2;
+
+    while (*s1 == *s2 && *s1 != '\n')
+        s1++, s2++;
+
+    if (*s1 == *s2)
+        return 0;
+    if (*s1 == '\n')
+        return -1;
+    if (*s2 == '\n')
+        return 1;
+    return *s1 < *s2 ? -1 : 1;
+}
+
+/* next line of the previous tags file which is still valid: its file
+ * is in the index and was not parsed again */
+static const char *
+next_old_line (IndexJob   *job,
+               const char *p,
+               const char *end)
+{
+    while (p < end)
+    {
+        const char *eol = memchr (p, '\n', end - p);
+        const char *file, *file_end;
+
+        if (!eol)
+            return NULL;
+
+        if (*p != '!' &&
+            (file = memchr (p, '\t', eol - p)) &&
+            (file_end = memchr (file + 1, '\t', eol - file - 1)))
+        {
+            char *path = g_strndup (file + 1, file_end - file - 1);
+            gboolean valid = g_hash_table_lookup (job->files, path) &&
+                             !g_hash_table_lookup_extended (job->to_scan, path, NULL, NULL);
+            g_free (path);
+            if (valid)
+                return p;
+        }
+
+        p = eol + 1;
+    }
+
+    return NULL;
+}
+
+#define WRITE_BUFFER_SIZE (64 * 1024)
+
+static gboolean
+write_line (MooFileWriter *writer,
+            GString       *buffer,
+            const char    *line)
+{
+    g_string_append_len (buffer, line, strchr (line, '\n') - line + 1);
+
+    if (buffer->len < WRITE_BUFFER_SIZE)
+        return TRUE;
+
+    if (!moo_file_writer_write (writer, buffer->str, buffer->len))
+        return FALSE;
+
+    g_string_truncate (buffer, 0);
+    return TRUE;
+}
+
+/* merges sorted pseudo-tags, lines of unchanged files from the previous
+ * tags file, and sorted tags of parsed files */
+static gboolean
+write_db (IndexJob *job)
+{
+    GString *pseudo_tags, *buffer;
+    GPtrArray *lines;
+    GMappedFile *old_map;
+    const char *old = NULL, *old_end = NULL;
+    MooFileWriter *writer;
+    GError *error = NULL;
+    gboolean retval = TRUE;
+    guint i;
+
+    /* the old file stays readable after it's replaced */
+    if ((old_map = g_mapped_file_new (job->db_file, FALSE, NULL)))
+    {
+        old = g_mapped_file_get_contents (old_map);
+        old_end = old + g_mapped_file_get_length (old_map);
+        old = next_old_line (job, old, old_end);
+    }
+
+    if (!(writer = moo_file_writer_new (job->db_file, 0, &error)))
+    {
+        g_warning ("could not write tags file: %s", error->message);
+        g_error_free (error);
+        if (old_map)
+            g_mapped_file_unref (old_map);
+        return FALSE;
+    }
+
+    pseudo_tags = g_string_new ("!_TAG_FILE_FORMAT\t2\t/extended format/\n"
+                                "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n"
+                                "!_TAG_PROGRAM_NAME\tmedit\t//\n");
+    g_hash_table_foreach (job->files, (GHFunc) append_file_pseudo_tag, pseudo_tags);
+
+    lines = g_ptr_array_new ();
+    g_hash_table_foreach (job->files, (GHFunc) collect_lines, lines);
+
+    for (i = 0; i < pseudo_tags->len; )
+    {
+        g_ptr_array_add (lines, pseudo_tags->str + i);
+        i = strchr (pseudo_tags->str + i, '\n') - pseudo_tags->str + 1;
+    }
+
+    g_ptr_array_sort (lines, (GCompareFunc) compare_lines);
+
+    buffer = g_string_sized_new (WRITE_BUFFER_SIZE + 1024);
+
+    for (i = 0; retval && (i < lines->len || old); )
+    {
+        if (old && (i == lines->len ||
+                    compare_lines ((const guchar**) &old, (const guchar**) &lines->pdata[i]) < 0))
+        {
+            retval = write_line (writer, buffer, old);
+            old = next_old_line (job, strchr (old, '\n') + 1, old_end);
+        }
+        else
+        {
+            retval = write_line (writer, buffer, lines->pdata[i++]);
+        }
+    }
+
+    if (retval && buffer->len)
+        retval = moo_file_writer_write (writer, buffer->str, buffer->len);
+
+    if (!moo_file_writer_close (writer, &error))
+    {
+        g_warning ("could not write tags file: %s", error->message);
+        g_error_free (error);
+        retval = FALSE;
+    }
+
+    if (old_map)
+        g_mapped_file_unref (old_map);
+    g_string_free (buffer, TRUE);
+    g_ptr_array_free (lines, TRUE);
+    g_string_free (pseudo_tags, TRUE);
+    g_hash_table_foreach (job->files, (GHFunc) free_tags, NULL);
+    return retval;
+}
+
+static void
+map_db (IndexJob *job)
+{
+    const char *start, *end, *p;
+    const char *prev = NULL;
+    gsize prev_len = 0;
+
+    if (!(job->map = g_mapped_file_new (job->db_file, FALSE, NULL)))
+        return;
+
+    start = g_mapped_file_get_contents (job->map);
+    end = start + g_mapped_file_get_length (job->map);
+    job->names = name_index_new ();
+
+    for (p = start; p < end; )
+    {
+        const char *eol = memchr (p, '\n', end - p);
+        const char *tab = memchr (p, '\t', (eol ? eol : end) - p);
+
+        if (!eol)
+            break;
+
+        if (tab && p[0] != '!' && ((gsize) (tab - p) != prev_len || memcmp (p, prev, prev_len) != 0))
+        {
+            name_index_add (job->names, p - start, p, tab - p);
+            prev = p;
+            prev_len = tab - p;
+        }
+
+        p = eol + 1;
+    }
+}
+
+static guint
+get_update_event_id (void);
+
+/* runs in a thread */
+static gboolean
+index_job_run (IndexJob *job)
+{
+    GSList *l;
+    GThreadPool *pool;
+    GHashTableIter iter;
+    gpointer path;
+
+    job->to_scan = path_set_new ();
+
+    if (job->load_db)
+        load_db (job);
+
+    /* tags of unchanged files are taken from the tags file */
+    if (!job->load_db && !g_file_test (job->db_file, G_FILE_TEST_EXISTS))
+    {
+        GHashTableIter files_iter;
+        gpointer file_path;
+
+        g_hash_table_iter_init (&files_iter, job->files);
+        while (g_hash_table_iter_next (&files_iter, &file_path, NULL))
+            g_hash_table_insert (job->to_scan, g_strdup (file_path), NULL);
+
+        job->changed = TRUE;
+    }
+
+    if (job->crawl)
+    {
+        RemoveData data;
+
+        data.job = job;
+        data.dir = NULL;
+        data.seen = job->seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+        _moo_file_crawler_run (job->crawler, "");
+        job->seen = NULL;
+        g_hash_table_foreach_remove (job->files, (GHRFunc) remove_unseen_file, &data);
+
+        g_hash_table_destroy (data.seen);
+    }
+    else
+    {
+        job->pending_dirs = _moo_file_crawler_find_changed (job->crawler, job->dirs);
+    }
+
+    for (l = job->pending_dirs; l != NULL; l = l->next)
+        rescan_dir (job, l->data);
+    for (l = job->pending_files; l != NULL; l = l->next)
+        rescan_file (job, l->data);
+
+    if (g_hash_table_size (job->to_scan) > 0)
+    {
+        guint n_workers = MAX_WORKERS;
+#if GLIB_CHECK_VERSION(2,36,0)
+        n_workers = CLAMP (g_get_num_processors (), 1, MAX_WORKERS);
+#endif
+        pool = g_thread_pool_new ((GFunc) scan_file, job, n_workers, TRUE, NULL);
+
+        /* files may have been removed after they were scheduled */
+        g_hash_table_iter_init (&iter, job->to_scan);
+        while (g_hash_table_iter_next (&iter, &path, NULL))
+        {
+            IndexFile *file = g_hash_table_lookup (job->files, path);
+            if (file)
+                g_thread_pool_push (pool, file, NULL);
+        }
+
+        /* waits for all files to be parsed */
+        g_thread_pool_free (pool, FALSE, TRUE);
+    }
+
+    if (job->changed || !g_file_test (job->db_file, G_FILE_TEST_EXISTS))
+    {
+        if (write_db (job))
+            map_db (job);
+    }
+    else if (job->load_db)
+    {
+        map_db (job);
+    }
+
+    _moo_event_queue_push (get_update_event_id (), job,
+                           (GDestroyNotify) index_job_free);
+    return FALSE;
+}
+
+
+/*************************************************************************/
+/* Index
+ */
+
+static void
+set_tags_file (MooCtagsIndex *index,
+               GMappedFile   *map,
+               NameIndex     *names)
+{
+    tagFileInfo info;
+
+    if (index->tags)
+        tagsClose (index->tags);
+    if (index->map)
+        g_mapped_file_unref (index->map);
+    name_index_free (index->names);
+
+    index->map = map;
+    index->names = names;
+
+    /* the tags file may already be replaced by another job, but then
+     * there is another update on the way */
+    index->tags = map ? tagsOpen (index->db_file, &info) : NULL;
+}
+
+/* main thread */
+static void
+index_jobs_done (GList *jobs)
+{
+    for ( ; jobs != NULL; jobs = jobs->next)
+    {
+        IndexJob *job = jobs->data;
+        MooCtagsIndex *index = job->index;
+
+        if (!index)
+            continue;
+
+        g_assert (index->job == job);
+        index->job = NULL;
+
+        index->files = job->files;
+        index->dirs = job->dirs;
+        job->files = NULL;
+        job->dirs = NULL;
+
+        if (job->map)
+        {
+            set_tags_file (index, job->map, job->names);
+            job->map = NULL;
+            job->names = NULL;
+        }
+
+        if (index->update_again || g_hash_table_size (index->pending_files))
+        {
+            index->update_again = FALSE;
+            index_queue_update (index);
+        }
+    }
+}
+
+static guint
+get_update_event_id (void)
+{
+    static guint event_id;
+
+    if (!event_id)
+        event_id = _moo_event_queue_connect ((MooEventQueueCallback) index_jobs_done,
+                                             NULL, NULL);
+
+    return event_id;
+}
+
+static GSList *
+steal_paths (GHashTable *set)
+{
+    GSList *list = NULL;
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init (&iter, set);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        list = g_slist_prepend (list, key);
+        g_hash_table_iter_steal (&iter);
+    }
+
+    return list;
+}
+
+static void
+index_start_job (MooCtagsIndex *index)
+{
+    IndexJob *job;
+    MooAsyncJob *async_job;
+    char *glob;
+
+    g_return_if_fail (index->job == NULL);
+
+    glob = moo_history_list_get_last_item (moo_history_list_get (GREP_GLOB_LIST_ID));
+
+    job = g_slice_new0 (IndexJob);
+    job->index = index;
+    job->root = g_strdup (index->root);
+    job->db_file = g_strdup (index->db_file);
+
+    job->globs = glob && strcmp (glob, "*") != 0 ? _moo_file_crawler_make_patterns (glob, FALSE) : NULL;
+    job->crawler = _moo_file_crawler_new (job->root,
+                                          (MooFileCrawlerDirFunc) job_add_dir,
+                                          (MooFileCrawlerFileFunc) job_add_file,
+                                          job);
+
+    /* first run: read the tags file and check the whole tree; later
+     * only changed directories and files are read */
+    job->load_db = !index->files;
+    job->crawl = !index->files;
+    job->files = index->files ? index->files : file_table_new ();
+    job->dirs = index->dirs ? index->dirs : path_set_new ();
+    index->files = NULL;
+    index->dirs = NULL;
+
+    job->pending_files = steal_paths (index->pending_files);
+
+    index->job = job;
+
+    get_update_event_id ();
+    async_job = moo_async_job_new ((MooAsyncJobCallback) index_job_run, job, NULL);
+    moo_async_job_start (async_job);
+    g_object_unref (async_job);
+
+    g_free (glob);
+}
+
+static gboolean
+index_update_timeout (MooCtagsIndex *index)
+{
+    index->update_timeout = 0;
+
+    if (index->job)
+        index->update_again = TRUE;
+    else
+        index_start_job (index);
+
+    return FALSE;
+}
+
+static void
+index_queue_update (MooCtagsIndex *index)
+{
+    if (!index->update_timeout)
+        index->update_timeout =
+            g_timeout_add_full (G_PRIORITY_LOW, UPDATE_DELAY,
+                                (GSourceFunc) index_update_timeout,
+                                index, NULL);
+}
+
+static gboolean
+index_check_timeout (MooCtagsIndex *index)
+{
+    index_queue_update (index);
+    return TRUE;
+}
+
+static MooCtagsIndex *
+index_new (const char *root)
+{
+    MooCtagsIndex *index;
+    char *cache_dir, *db_dir, *basename, *checksum;
+    mgw_errno_t err;
+
+    index = g_slice_new0 (MooCtagsIndex);
+    index->root = g_strdup (root);
+    index->pending_files = path_set_new ();
+
+    cache_dir = moo_get_user_cache_dir ();
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, root, -1);
+    basename = g_strdup_printf ("tags-%s", checksum);
+    db_dir = g_build_filename (cache_dir, "ctags", NULL);
+    index->db_file = g_build_filename (db_dir, basename, NULL);
+    mgw_mkdir_with_parents (db_dir, 0755, &err);
+    g_free (db_dir);
+    g_free (basename);
+    g_free (checksum);
+    g_free (cache_dir);
+
+    /* previous tags file may be used right away */
+    {
+        GMappedFile *map = g_mapped_file_new (index->db_file, FALSE, NULL);
+        if (map)
+            set_tags_file (index, map, NULL);
+    }
+
+    index_start_job (index);
+
+    index->check_timeout =
+        g_timeout_add_seconds_full (G_PRIORITY_LOW, CHECK_INTERVAL,
+                                    (GSourceFunc) index_check_timeout,
+                                    index, NULL);
+    return index;
+}
+
+static void
+index_free (MooCtagsIndex *index)
+{
+    if (index->job)
+        index->job->index = NULL;
+
+    if (index->update_timeout)
+        g_source_remove (index->update_timeout);
+    if (index->check_timeout)
+        g_source_remove (index->check_timeout);
+
+    set_tags_file (index, NULL, NULL);
+
+    if (index->files)
+        g_hash_table_destroy (index->files);
+    if (index->dirs)
+        g_hash_table_destroy (index->dirs);
+    g_hash_table_destroy (index->pending_files);
+
+    g_free (index->db_file);
+    g_free (index->root);
+    g_slice_free (MooCtagsIndex, index);
+}
+
+
+/*************************************************************************/
+/* Public API
+ */
+
+MooCtagsIndex *
+_moo_ctags_index_get (const char *filename,
+                      gboolean    create)
+{
+    MooCtagsIndex *index;
+    char *root;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    if (!(root = _moo_file_crawler_find_root (filename)))
+        return NULL;
+
+    if (!indexes)
+        indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify) index_free);
+
+    if (!(index = g_hash_table_lookup (indexes, root)) && create)
+    {
+        index = index_new (root);
+        g_hash_table_insert (indexes, g_strdup (root), index);
+    }
+
+    g_free (root);
+    return index;
+}
+
+gboolean
+_moo_ctags_index_is_updating (MooCtagsIndex *index)
+{
+    g_return_val_if_fail (index != NULL, FALSE);
+    return index->job != NULL || index->update_timeout != 0;
+}
+
+void
+_moo_ctags_index_shutdown (void)
+{
+    if (indexes)
+        g_hash_table_destroy (indexes);
+    indexes = NULL;
+}
+
+void
+_moo_ctags_index_file_changed (const char *filename)
+{
+    MooCtagsIndex *index;
+    gsize root_len;
+
+    g_return_if_fail (filename != NULL);
+
+    if (!(index = _moo_ctags_index_get (filename, FALSE)))
+        return;
+
+    root_len = strlen (index->root);
+    if (strncmp (filename, index->root, root_len) != 0 || filename[root_len] != G_DIR_SEPARATOR)
+        return;
+
+    g_hash_table_insert (index->pending_files, g_strdup (filename + root_len + 1), NULL);
+    index_queue_update (index);
+}
+
+static MooCtagsTag *
+tag_new (MooCtagsIndex  *index,
+         const tagEntry *te)
+{
+    MooCtagsTag *tag = g_slice_new (MooCtagsTag);
+    const char *klass = tagsField (te, "class");
+
+    if (!klass)
+        klass = tagsField (te, "struct");
+
+    tag->filename = g_build_filename (index->root, te->file, NULL);
+    tag->entry = _moo_ctags_entry_new (te->name, te->kind ? te->kind : "",
+                                       (int) te->address.lineNumber - 1,
+                                       klass, tagsField (te, "signature"),
+                                       te->fileScope);
+    return tag;
+}
+
+GSList *
+_moo_ctags_index_find (MooCtagsIndex *index,
+                       const char    *name)
+{
+    GSList *list = NULL;
+    tagEntry te;
+
+    g_return_val_if_fail (index != NULL, NULL);
+    g_return_val_if_fail (name != NULL, NULL);
+
+    if (!index->tags)
+        return NULL;
+
+    if (tagsFind (index->tags, &te, name, TAG_FULLMATCH | TAG_OBSERVECASE) == TagSuccess)
+    {
+        do
+            list = g_slist_prepend (list, tag_new (index, &te));
+        while (tagsFindNext (index->tags, &te) == TagSuccess);
+    }
+
+    return g_slist_reverse (list);
+}
+
+/* -1 if pattern is not a subsequence of name, otherwise smaller is
+ * better: prefix matches go first, then matches with fewer gaps */
+static int
+fuzzy_score (const char *name,
+             gsize       len,
+             const char *pattern)
+{
+    int first = -1, gaps = 0;
+    gboolean prev_matched = FALSE;
+    gsize i;
+
+    for (i = 0; i < len && *pattern; ++i)
+    {
+        if (g_ascii_tolower (name[i]) == *pattern)
+        {
+            if (first < 0)
+                first = i;
+            else if (!prev_matched)
+                gaps++;
+            pattern++;
+            prev_matched = TRUE;
+        }
+        else
+        {
+            prev_matched = FALSE;
+        }
+    }
+
+    if (*pattern)
+        return -1;
+
+    return first * 4 + gaps * 8 + (int) len;
+}
+
+static MooCtagsTag *
+tag_from_line (MooCtagsIndex *index,
+               const char    *line,
+               const char    *end)
+{
+    char *copy, **fields;
+    MooCtagsTag *tag = NULL;
+    const char *eol = memchr (line, '\n', end - line);
+
+    copy = g_strndup (line, (eol ? eol : end) - line);
+    fields = g_strsplit (copy, "\t", 0);
+
+    if (g_strv_length (fields) >= 4)
+    {
+        tag = g_slice_new (MooCtagsTag);
+        tag->filename = g_build_filename (index->root, fields[1], NULL);
+        tag->entry = _moo_ctags_entry_new (fields[0], fields[3],
+                                           atoi (fields[2]) - 1,
+                                           NULL, NULL, FALSE);
+    }
+
+    g_strfreev (fields);
+    g_free (copy);
+    return tag;
+}
+
+typedef struct {
+    int score;
+    guint32 offset;
+} Match;
+
+static void
+add_match (Match   *matches,
+           guint   *n_matches,
+           guint    max_results,
+           int      score,
+           guint32  offset)
+{
+    guint pos;
+
+    if (*n_matches == max_results && score >= matches[*n_matches - 1].score)
+        return;
+
+    /* keep matches sorted by score */
+    pos = *n_matches < max_results ? (*n_matches)++ : *n_matches - 1;
+    while (pos > 0 && matches[pos - 1].score > score)
+    {
+        matches[pos] = matches[pos - 1];
+        pos--;
+    }
+
+    matches[pos].score = score;
+    matches[pos].offset = offset;
+}
+
+GSList *
+_moo_ctags_index_match (MooCtagsIndex *index,
+                        const char    *pattern,
+                        guint          max_results)
+{
+    const char *start, *end, *p;
+    NameIndex *names;
+    GArray *candidates = NULL;
+    Match *matches;
+    guint n_matches = 0;
+    guint n_candidates;
+    guint64 mask;
+    char *lower;
+    GSList *list = NULL;
+    guint i;
+
+    g_return_val_if_fail (index != NULL, NULL);
+    g_return_val_if_fail (pattern != NULL, NULL);
+
+    if (!(names = index->names) || !pattern[0] || !max_results)
+        return NULL;
+
+    start = g_mapped_file_get_contents (index->map);
+    end = start + g_mapped_file_get_length (index->map);
+    lower = g_ascii_strdown (pattern, -1);
+    mask = name_mask (lower, strlen (lower));
+    matches = g_new (Match, max_results);
+
+    /* only names which contain the rarest character of the pattern */
+    for (p = lower; *p; ++p)
+    {
+        int c = name_char_index (*p);
+        if (c >= 0 && (!candidates || names->postings[c]->len < candidates->len))
+            candidates = names->postings[c];
+    }
+
+    n_candidates = candidates ? candidates->len : names->offsets->len;
+
+    for (i = 0; i < n_candidates; ++i)
+    {
+        guint idx = candidates ? g_array_index (candidates, guint32, i) : i;
+        guint32 offset;
+        const char *name, *tab;
+        int score;
+
+        if ((g_array_index (names->masks, guint64, idx) & mask) != mask)
+            continue;
+
+        offset = g_array_index (names->offsets, guint32, idx);
+        name = start + offset;
+        tab = memchr (name, '\t', end - name);
+
+        if (tab && (score = fuzzy_score (name, tab - name, lower)) >= 0)
+            add_match (matches, &n_matches, max_results, score, offset);
+    }
+
+    for (i = 0; i < n_matches; ++i)
+    {
+        MooCtagsTag *tag = tag_from_line (index, start + matches[i].offset, end);
+        if (tag)
+            list = g_slist_prepend (list, tag);
+    }
+
+    g_free (matches);
+    g_free (lower);
+    return g_slist_reverse (list);
+}
+
+void
+_moo_ctags_tag_free (MooCtagsTag *tag)
+{
+    if (tag)
+    {
+        g_free (tag->filename);
+        _moo_ctags_entry_unref (tag->entry);
+        g_slice_free (MooCtagsTag, tag);
+    }
+}
+
+void
+_moo_ctags_tag_list_free (GSList *tags)
+{
+    g_slist_foreach (tags, (GFunc) _moo_ctags_tag_free, NULL);
+    g_slist_free (tags);
+}
@@ -0,0 +1,56 @@
+/*
+ *   ctags-index.h
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CTAGS_INDEX_H
+#define CTAGS_INDEX_H
+
+#include "ctags-doc.h"
+
+G_BEGIN_DECLS
+
+typedef struct _MooCtagsIndex MooCtagsIndex;
+
+typedef struct {
+    char *filename;
+    MooCtagsEntry *entry;
+} MooCtagsTag;
+
+
+/* index of the project containing filename; with create == TRUE a new
+ * index is created and built in background */
+MooCtagsIndex  *_moo_ctags_index_get            (const char     *filename,
+                                                 gboolean        create);
+void            _moo_ctags_index_shutdown       (void);
+
+/* whether the index is being built or updated */
+gboolean        _moo_ctags_index_is_updating    (MooCtagsIndex  *index);
+
+/* makes the index containing filename rescan it */
+void            _moo_ctags_index_file_changed   (const char     *filename);
+
+/* tags named exactly name, list of MooCtagsTag */
+GSList         *_moo_ctags_index_find           (MooCtagsIndex  *index,
+                                                 const char     *name);
+/* best fuzzy matches for pattern, one tag per name, list of MooCtagsTag */
+GSList         *_moo_ctags_index_match          (MooCtagsIndex  *index,
+                                                 const char     *pattern,
+                                                 guint           max_results);
+
+void            _moo_ctags_tag_free             (MooCtagsTag    *tag);
+void            _moo_ctags_tag_list_free        (GSList         *tags);
+
+G_END_DECLS
+
+#endif /* CTAGS_INDEX_H */
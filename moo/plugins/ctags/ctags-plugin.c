@@ -18,16 +18,22 @@
 #include "mooedit/mooplugin-macro.h"
 #include "plugins/mooplugin-builtin.h"
 #include "mooedit/mooeditwindow.h"
+#include "mooedit/mooeditor.h"
+#include "mooedit/mooedit-accels.h"
 #include "mooutils/mooi18n.h"
 #include "mooutils/mooutils-gobject.h"
+#include "mooutils/mooutils-misc.h"
 #include "ctags-view.h"
 #include "ctags-doc.h"
+#include "ctags-index.h"
 #include <gtk/gtk.h>
 
 #define CTAGS_PLUGIN_ID "Ctags"
+#define MAX_SYMBOL_MATCHES 200
 
 typedef struct {
     MooPlugin parent;
+    guint ui_merge_id;
 } CtagsPlugin;
 
 typedef struct {
@@ -146,15 +152,368 @@ ctags_window_plugin_destroy (CtagsWindowPlugin *plugin)
 }
 
 
+/*************************************************************************/
+/* Go to definition
+ */
+
+static void
+open_location (MooEditWindow *window,
+               const char    *filename,
+               int            line)
+{
+    moo_editor_open_path (moo_edit_window_get_editor (window),
+                          filename, NULL, line, window);
+}
+
+static char *
+get_word_at_cursor (MooEdit *doc)
+{
+    GtkTextBuffer *buffer = moo_edit_get_buffer (doc);
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_iter_at_mark (buffer, &start, gtk_text_buffer_get_insert (buffer));
+    end = start;
+
+    while (!gtk_text_iter_starts_line (&start))
+    {
+        gunichar c;
+
+        gtk_text_iter_backward_char (&start);
+        c = gtk_text_iter_get_char (&start);
+
+        if (c != '_' && !g_unichar_isalnum (c))
+        {
+            gtk_text_iter_forward_char (&start);
+            break;
+        }
+    }
+
+    while (!gtk_text_iter_ends_line (&end))
+    {
+        gunichar c = gtk_text_iter_get_char (&end);
+        if (c != '_' && !g_unichar_isalnum (c))
+            break;
+        gtk_text_iter_forward_char (&end);
+    }
+
+    if (gtk_text_iter_equal (&start, &end))
+        return NULL;
+
+    return gtk_text_iter_get_slice (&start, &end);
+}
+
 static gboolean
-ctags_plugin_init (G_GNUC_UNUSED CtagsPlugin *plugin)
+find_in_doc_func (GtkTreeModel  *model,
+                  G_GNUC_UNUSED GtkTreePath *path,
+                  GtkTreeIter   *iter,
+                  gpointer       data)
+{
+    MooCtagsEntry *entry = NULL;
+    gpointer *found = data;
+
+    gtk_tree_model_get (model, iter, MOO_CTAGS_VIEW_COLUMN_ENTRY, &entry, -1);
+
+    if (entry && entry->line >= 0 && moo_str_equal (entry->name, found[0]))
+    {
+        found[1] = entry;
+        return TRUE;
+    }
+
+    if (entry)
+        _moo_ctags_entry_unref (entry);
+
+    return FALSE;
+}
+
+/* symbols of the document itself are up to date even if it's not saved */
+static MooCtagsEntry *
+find_in_doc (MooEdit    *doc,
+             const char *name)
+{
+    MooCtagsDocPlugin *dp;
+    GtkTreeModel *model;
+    gpointer found[2];
+
+    dp = moo_doc_plugin_lookup (CTAGS_PLUGIN_ID, doc);
+    g_return_val_if_fail (MOO_IS_CTAGS_DOC_PLUGIN (dp), NULL);
+
+    model = _moo_ctags_doc_plugin_get_store (dp);
+    found[0] = (gpointer) name;
+    found[1] = NULL;
+    gtk_tree_model_foreach (model, find_in_doc_func, found);
+
+    return found[1];
+}
+
+static void
+go_to_definition_cb (MooEditWindow *window)
 {
+    MooEdit *doc;
+    MooCtagsEntry *entry;
+    MooCtagsIndex *index;
+    char *name, *filename;
+    GSList *tags, *l;
+    MooCtagsTag *tag = NULL;
+
+    if (!(doc = moo_edit_window_get_active_doc (window)) ||
+        !(name = get_word_at_cursor (doc)))
+        return;
+
+    if ((entry = find_in_doc (doc, name)))
+    {
+        moo_text_view_move_cursor (MOO_TEXT_VIEW (moo_edit_get_view (doc)),
+                                   entry->line, -1, FALSE, FALSE);
+        _moo_ctags_entry_unref (entry);
+        g_free (name);
+        return;
+    }
+
+    filename = moo_edit_get_filename (doc);
+    index = filename ? _moo_ctags_index_get (filename, TRUE) : NULL;
+    tags = index ? _moo_ctags_index_find (index, name) : NULL;
+
+    /* the symbol is not in the document, so tags for this file are stale */
+    for (l = tags; l != NULL && !tag; l = l->next)
+        if (!moo_str_equal (((MooCtagsTag*) l->data)->filename, filename))
+            tag = l->data;
+    if (!tag && tags)
+        tag = tags->data;
+
+    if (tag)
+        open_location (window, tag->filename, tag->entry->line);
+
+    _moo_ctags_tag_list_free (tags);
+    g_free (filename);
+    g_free (name);
+}
+
+
+/*************************************************************************/
+/* Go to symbol
+ */
+
+enum {
+    SYMBOL_COLUMN_NAME,
+    SYMBOL_COLUMN_LOCATION,
+    SYMBOL_COLUMN_FILENAME,
+    SYMBOL_COLUMN_LINE,
+    SYMBOL_N_COLUMNS
+};
+
+static void
+symbol_entry_changed (GtkEntry *entry,
+                      GtkWidget *treeview)
+{
+    MooCtagsIndex *index;
+    GtkListStore *store;
+    GSList *tags, *l;
+    GtkTreeIter iter;
+
+    index = g_object_get_data (G_OBJECT (treeview), "moo-ctags-index");
+    store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (treeview)));
+    gtk_list_store_clear (store);
+
+    tags = _moo_ctags_index_match (index, gtk_entry_get_text (entry), MAX_SYMBOL_MATCHES);
+
+    for (l = tags; l != NULL; l = l->next)
+    {
+        MooCtagsTag *tag = l->data;
+        char *basename = g_filename_display_basename (tag->filename);
+        char *location = g_strdup_printf ("%s:%d", basename, tag->entry->line + 1);
+
+        gtk_list_store_append (store, &iter);
+        gtk_list_store_set (store, &iter,
+                            SYMBOL_COLUMN_NAME, tag->entry->name,
+                            SYMBOL_COLUMN_LOCATION, location,
+                            SYMBOL_COLUMN_FILENAME, tag->filename,
+                            SYMBOL_COLUMN_LINE, tag->entry->line,
+                            -1);
+
+        g_free (location);
+        g_free (basename);
+    }
+
+    if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter))
+        gtk_tree_selection_select_iter (gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview)), &iter);
+
+    _moo_ctags_tag_list_free (tags);
+}
+
+static void
+symbol_row_activated (GtkDialog *dialog)
+{
+    gtk_dialog_response (dialog, GTK_RESPONSE_OK);
+}
+
+static GtkWidget *
+create_symbol_dialog (MooEditWindow *window,
+                      MooCtagsIndex *index,
+                      GtkWidget    **entry_p,
+                      GtkWidget    **treeview_p)
+{
+    GtkWidget *dialog, *vbox, *entry, *swin, *treeview;
+    GtkListStore *store;
+    GtkCellRenderer *cell;
+
+    dialog = gtk_dialog_new_with_buttons (_("Go to Symbol"), GTK_WINDOW (window),
+                                          GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                          GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                          GTK_STOCK_JUMP_TO, GTK_RESPONSE_OK,
+                                          NULL);
+    gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+    gtk_window_set_default_size (GTK_WINDOW (dialog), 500, 400);
+
+    vbox = gtk_vbox_new (FALSE, 6);
+    gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
+    gtk_box_pack_start (GTK_BOX (GTK_DIALOG (dialog)->vbox), vbox, TRUE, TRUE, 0);
+
+    entry = gtk_entry_new ();
+    gtk_entry_set_activates_default (GTK_ENTRY (entry), TRUE);
+    gtk_box_pack_start (GTK_BOX (vbox), entry, FALSE, FALSE, 0);
+
+    store = gtk_list_store_new (SYMBOL_N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_INT);
+    treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+    gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (treeview), FALSE);
+    g_object_unref (store);
+
+    cell = gtk_cell_renderer_text_new ();
+    gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (treeview), -1, NULL, cell,
+                                                 "text", SYMBOL_COLUMN_NAME, NULL);
+    cell = gtk_cell_renderer_text_new ();
+    g_object_set (cell, "foreground", "gray", NULL);
+    gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (treeview), -1, NULL, cell,
+                                                 "text", SYMBOL_COLUMN_LOCATION, NULL);
+
+    swin = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (swin),
+                                    GTK_POLICY_AUTOMATIC,
+                                    GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (swin), GTK_SHADOW_IN);
+    gtk_container_add (GTK_CONTAINER (swin), treeview);
+    gtk_box_pack_start (GTK_BOX (vbox), swin, TRUE, TRUE, 0);
+
+    g_object_set_data (G_OBJECT (treeview), "moo-ctags-index", index);
+    g_signal_connect (entry, "changed", G_CALLBACK (symbol_entry_changed), treeview);
+    g_signal_connect_swapped (treeview, "row-activated", G_CALLBACK (symbol_row_activated), dialog);
+
+    gtk_widget_show_all (vbox);
+
+    *entry_p = entry;
+    *treeview_p = treeview;
+    return dialog;
+}
+
+static void
+go_to_symbol_cb (MooEditWindow *window)
+{
+    MooEdit *doc;
+    MooCtagsIndex *index;
+    GtkWidget *dialog, *entry, *treeview;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    char *filename, *name;
+
+    if (!(doc = moo_edit_window_get_active_doc (window)) ||
+        !(filename = moo_edit_get_filename (doc)))
+        return;
+
+    index = _moo_ctags_index_get (filename, TRUE);
+    g_free (filename);
+
+    if (!index)
+        return;
+
+    dialog = create_symbol_dialog (window, index, &entry, &treeview);
+
+    if ((name = get_word_at_cursor (doc)))
+    {
+        gtk_entry_set_text (GTK_ENTRY (entry), name);
+        gtk_editable_select_region (GTK_EDITABLE (entry), 0, -1);
+        g_free (name);
+    }
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_OK &&
+        gtk_tree_selection_get_selected (gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview)),
+                                         &model, &iter))
+    {
+        char *path = NULL;
+        int line = 0;
+
+        gtk_tree_model_get (model, &iter,
+                            SYMBOL_COLUMN_FILENAME, &path,
+                            SYMBOL_COLUMN_LINE, &line,
+                            -1);
+
+        gtk_widget_destroy (dialog);
+        dialog = NULL;
+
+        open_location (window, path, line);
+        g_free (path);
+    }
+
+    if (dialog)
+        gtk_widget_destroy (dialog);
+}
+
+
+static gboolean
+ctags_plugin_init (CtagsPlugin *plugin)
+{
+    MooWindowClass *klass = g_type_class_ref (MOO_TYPE_EDIT_WINDOW);
+    MooEditor *editor = moo_editor_instance ();
+    MooUiXml *xml = moo_editor_get_ui_xml (editor);
+
+    g_return_val_if_fail (klass != NULL, FALSE);
+
+    moo_window_class_new_action (klass, "CtagsGoToDefinition", NULL,
+                                 "display-name", _("Go to Definition"),
+                                 "label", _("Go to _Definition"),
+                                 "tooltip", _("Go to definition of the symbol at cursor"),
+                                 "default-accel", MOO_EDIT_ACCEL_GOTO_DEFINITION,
+                                 "closure-callback", go_to_definition_cb,
+                                 NULL);
+
+    moo_window_class_new_action (klass, "CtagsGoToSymbol", NULL,
+                                 "display-name", _("Go to Symbol"),
+                                 "label", _("Go to _Symbol..."),
+                                 "tooltip", _("Go to a symbol defined in the project"),
+                                 "default-accel", MOO_EDIT_ACCEL_GOTO_SYMBOL,
+                                 "closure-callback", go_to_symbol_cb,
+                                 NULL);
+
+    if (xml)
+    {
+        plugin->ui_merge_id = moo_ui_xml_new_merge_id (xml);
+        moo_ui_xml_add_item (xml, plugin->ui_merge_id,
+                             "Editor/Menubar/Search",
+                             "CtagsGoToDefinition", "CtagsGoToDefinition", -1);
+        moo_ui_xml_add_item (xml, plugin->ui_merge_id,
+                             "Editor/Menubar/Search",
+                             "CtagsGoToSymbol", "CtagsGoToSymbol", -1);
+    }
+
+    g_type_class_unref (klass);
     return TRUE;
 }
 
 static void
-ctags_plugin_deinit (G_GNUC_UNUSED CtagsPlugin *plugin)
+ctags_plugin_deinit (CtagsPlugin *plugin)
 {
+    MooWindowClass *klass = g_type_class_ref (MOO_TYPE_EDIT_WINDOW);
+    MooEditor *editor = moo_editor_instance ();
+    MooUiXml *xml = moo_editor_get_ui_xml (editor);
+
+    moo_window_class_remove_action (klass, "CtagsGoToDefinition");
+    moo_window_class_remove_action (klass, "CtagsGoToSymbol");
+
+    if (plugin->ui_merge_id)
+        moo_ui_xml_remove_ui (xml, plugin->ui_merge_id);
+    plugin->ui_merge_id = 0;
+
+    _moo_ctags_index_shutdown ();
+
+    g_type_class_unref (klass);
 }
 
 
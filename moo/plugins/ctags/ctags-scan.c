@@ -0,0 +1,1674 @@
+/*
+ *   ctags-scan.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * In-process replacement for running ctags on C, C++ and Python files.
+ *
+ * Text is split into top-level chunks: in C a chunk ends after a ';' or '}'
+ * at brace level zero or after a preprocessor line, in Python every
+ * non-indented statement starts a new chunk. Every chunk is parsed on its
+ * own, entries are stored with line numbers relative to the chunk start.
+ * The cache keeps the chunks of the last scan in order, so after an edit
+ * only the lines around the change are split into chunks again, and of
+ * those only the chunks whose text changed are parsed. Entries produced
+ * are the same kinds ctags produces: c, d, e, f, g, m, s, t, u, v.
+ */
+
+#include "config.h"
+#include "ctags-scan.h"
+#include <string.h>
+
+typedef enum {
+    LANG_NONE,
+    LANG_C,
+    LANG_PYTHON
+} ScanLang;
+
+typedef struct {
+    guint64 hash;
+    gsize len;
+} ChunkKey;
+
+/* entries of one chunk with lines relative to the chunk start */
+typedef struct {
+    ChunkKey key;
+    int n_lines; /* line breaks in the chunk */
+    GSList *entries;
+} Chunk;
+
+/* Chunks of the last scanned text in order. After an edit only the
+ * chunks around the changed lines are scanned again, the caller copies
+ * just those lines out of the buffer. */
+struct _MooCtagsScanCache {
+    ScanLang lang;
+    GPtrArray *chunks; /* Chunk*; NULL if the last scan didn't complete */
+    int n_lines;
+
+    /* set by _moo_ctags_scan_cache_prepare() */
+    guint first_chunk;
+    guint last_chunk;
+    int start_line;
+    int tail_line;
+    int end_line;
+    int new_n_lines;
+};
+
+static ScanLang
+get_scan_lang (const char *lang_id)
+{
+    if (!lang_id)
+        return LANG_NONE;
+    if (!strcmp (lang_id, "c") || !strcmp (lang_id, "cpp") || !strcmp (lang_id, "chdr"))
+        return LANG_C;
+    if (!strcmp (lang_id, "python"))
+        return LANG_PYTHON;
+    return LANG_NONE;
+}
+
+gboolean
+_moo_ctags_scan_supports_lang (const char *lang_id)
+{
+    return get_scan_lang (lang_id) != LANG_NONE;
+}
+
+
+/*************************************************************************/
+/* Chunk cache
+ */
+
+static guint
+chunk_key_hash (const ChunkKey *key)
+{
+    return (guint) (key->hash ^ (key->hash >> 32) ^ key->len);
+}
+
+static gboolean
+chunk_key_equal (const ChunkKey *a,
+                 const ChunkKey *b)
+{
+    return a->hash == b->hash && a->len == b->len;
+}
+
+static void
+chunk_free (Chunk *chunk)
+{
+    if (chunk)
+    {
+        g_slist_foreach (chunk->entries, (GFunc) _moo_ctags_entry_unref, NULL);
+        g_slist_free (chunk->entries);
+        g_slice_free (Chunk, chunk);
+    }
+}
+
+/* takes ownership of chunks [first, last) of the array */
+static GHashTable *
+chunk_table_new (GPtrArray *chunks,
+                 guint      first,
+                 guint      last)
+{
+    GHashTable *table;
+    guint i;
+
+    table = g_hash_table_new_full ((GHashFunc) chunk_key_hash,
+                                   (GEqualFunc) chunk_key_equal,
+                                   NULL, (GDestroyNotify) chunk_free);
+
+    for (i = first; i < last; ++i)
+    {
+        Chunk *chunk = chunks->pdata[i];
+        chunks->pdata[i] = NULL;
+        /* replace, not insert: the key belongs to the chunk */
+        g_hash_table_replace (table, &chunk->key, chunk);
+    }
+
+    return table;
+}
+
+static void
+cache_clear (MooCtagsScanCache *cache)
+{
+    if (cache->chunks)
+    {
+        g_ptr_array_foreach (cache->chunks, (GFunc) chunk_free, NULL);
+        g_ptr_array_free (cache->chunks, TRUE);
+    }
+
+    cache->chunks = NULL;
+}
+
+MooCtagsScanCache *
+_moo_ctags_scan_cache_new (void)
+{
+    return g_slice_new0 (MooCtagsScanCache);
+}
+
+void
+_moo_ctags_scan_cache_free (MooCtagsScanCache *cache)
+{
+    if (cache)
+    {
+        cache_clear (cache);
+        g_slice_free (MooCtagsScanCache, cache);
+    }
+}
+
+static ChunkKey
+chunk_key (const char *text,
+           gsize       len)
+{
+    /* 64-bit FNV-1a */
+    ChunkKey key;
+    guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+    gsize i;
+
+    for (i = 0; i < len; ++i)
+    {
+        hash ^= (guchar) text[i];
+        hash *= G_GUINT64_CONSTANT (1099511628211);
+    }
+
+    key.hash = hash;
+    key.len = len;
+    return key;
+}
+
+
+/*************************************************************************/
+/* C and C++
+ */
+
+typedef enum {
+    TOK_IDENT,
+    TOK_PUNCT,
+    TOK_STRING
+} TokenType;
+
+#define PUNCT_SCOPE 'S' /* :: */
+
+typedef struct {
+    TokenType type;
+    char punct;
+    guint bol : 1;  /* first thing on the line, in the first column */
+    int line;
+    const char *start;
+    guint len;
+} Token;
+
+typedef struct {
+    const char *text;
+    GArray *tokens;
+    GSList *entries;
+} CParser;
+
+#define TOKEN(p,i) (&g_array_index ((p)->tokens, Token, (i)))
+#define N_TOKENS(p) ((int) (p)->tokens->len)
+
+static gboolean
+is_ident_start (char c)
+{
+    return g_ascii_isalpha (c) || c == '_' || (guchar) c >= 0x80;
+}
+
+static gboolean
+is_ident_char (char c)
+{
+    return g_ascii_isalnum (c) || c == '_' || (guchar) c >= 0x80;
+}
+
+static gboolean
+tok_is (const Token *t,
+        const char  *word)
+{
+    return t->type == TOK_IDENT && strlen (word) == t->len &&
+           !strncmp (t->start, word, t->len);
+}
+
+static gboolean
+tok_is_punct (const Token *t,
+              char         c)
+{
+    return t->type == TOK_PUNCT && t->punct == c;
+}
+
+static gboolean
+is_keyword (const Token *t)
+{
+    static const char *keywords[] = {
+        "auto", "bool", "break", "case", "char", "const", "continue", "default",
+        "delete", "do", "double", "else", "enum", "explicit", "extern", "float",
+        "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "new",
+        "private", "protected", "public", "register", "return", "short", "signed",
+        "sizeof", "static", "struct", "switch", "template", "throw", "typedef",
+        "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+        "while", "class", "namespace", "operator", "override", "final", "noexcept",
+        "constexpr", "decltype", "static_assert", "G_GNUC_CONST", "G_GNUC_UNUSED",
+    };
+    guint i;
+
+    if (t->type != TOK_IDENT)
+        return FALSE;
+
+    for (i = 0; i < G_N_ELEMENTS (keywords); ++i)
+        if (tok_is (t, keywords[i]))
+            return TRUE;
+
+    return FALSE;
+}
+
+static void
+add_entry (GSList    **entries,
+           const char *name,
+           guint       name_len,
+           const char *kind,
+           int         line,
+           const char *klass,
+           const char *signature,
+           gboolean    file_scope)
+{
+    char *name_copy = g_strndup (name, name_len);
+    *entries = g_slist_prepend (*entries,
+                                _moo_ctags_entry_new (name_copy, kind, line,
+                                                      klass, signature, file_scope));
+    g_free (name_copy);
+}
+
+static void
+add_token_entry (CParser     *p,
+                 const Token *name,
+                 const char  *kind,
+                 const char  *klass,
+                 const char  *signature,
+                 gboolean     file_scope)
+{
+    add_entry (&p->entries, name->start, name->len, kind, name->line,
+               klass, signature, file_scope);
+}
+
+static const char *
+skip_line (const char *p,
+           const char *end,
+           int        *line)
+{
+    /* skips to the end of line, honoring backslash continuation */
+    while (p < end && *p != '\n')
+    {
+        if (*p == '\\' && p + 1 < end && p[1] == '\n')
+        {
+            *line += 1;
+            p += 2;
+        }
+        else
+        {
+            p++;
+        }
+    }
+
+    return p;
+}
+
+static const char *
+c_preprocessor (CParser    *p,
+                const char *ptr,
+                const char *end,
+                int        *line)
+{
+    const char *word;
+
+    /* ptr points to '#' */
+    for (ptr++; ptr < end && (*ptr == ' ' || *ptr == '\t'); ptr++) ;
+
+    word = ptr;
+    while (ptr < end && is_ident_char (*ptr))
+        ptr++;
+
+    if (ptr - word == 6 && !strncmp (word, "define", 6))
+    {
+        const char *name;
+
+        while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+            ptr++;
+
+        name = ptr;
+        while (ptr < end && is_ident_char (*ptr))
+            ptr++;
+
+        if (ptr > name)
+            add_entry (&p->entries, name, ptr - name, "d", *line, NULL, NULL, FALSE);
+    }
+
+    return skip_line (ptr, end, line);
+}
+
+static void
+c_tokenize (CParser *p,
+            gsize    len)
+{
+    const char *ptr = p->text;
+    const char *end = p->text + len;
+    const char *line_start = p->text;
+    gboolean first_on_line = TRUE;
+    int line = 0;
+
+    while (ptr < end)
+    {
+        Token tok;
+        char c = *ptr;
+
+        if (c == '\n')
+        {
+            line++;
+            ptr++;
+            line_start = ptr;
+            first_on_line = TRUE;
+            continue;
+        }
+
+        if (g_ascii_isspace (c) || (c == '\\' && ptr + 1 < end && ptr[1] == '\n'))
+        {
+            if (c == '\\')
+            {
+                line++;
+                ptr++;
+            }
+            ptr++;
+            continue;
+        }
+
+        if (c == '/' && ptr + 1 < end && ptr[1] == '*')
+        {
+            for (ptr += 2; ptr < end && !(ptr[0] == '*' && ptr + 1 < end && ptr[1] == '/'); ptr++)
+                if (*ptr == '\n')
+                    line++;
+            ptr = MIN (ptr + 2, end);
+            continue;
+        }
+
+        if (c == '/' && ptr + 1 < end && ptr[1] == '/')
+        {
+            while (ptr < end && *ptr != '\n')
+                ptr++;
+            continue;
+        }
+
+        if (c == '#' && first_on_line)
+        {
+            ptr = c_preprocessor (p, ptr, end, &line);
+            continue;
+        }
+
+        tok.bol = first_on_line && ptr == line_start;
+        tok.line = line;
+        tok.start = ptr;
+        tok.punct = 0;
+        first_on_line = FALSE;
+
+        if (c == '"' || c == '\'')
+        {
+            for (ptr++; ptr < end && *ptr != c && *ptr != '\n'; ptr++)
+                if (*ptr == '\\' && ptr + 1 < end)
+                    ptr++;
+            ptr = MIN (ptr + 1, end);
+            tok.type = TOK_STRING;
+        }
+        else if (is_ident_start (c))
+        {
+            while (ptr < end && is_ident_char (*ptr))
+                ptr++;
+            tok.type = TOK_IDENT;
+        }
+        else if (g_ascii_isdigit (c))
+        {
+            while (ptr < end && (is_ident_char (*ptr) || *ptr == '.'))
+                ptr++;
+            continue;
+        }
+        else if (c == ':' && ptr + 1 < end && ptr[1] == ':')
+        {
+            ptr += 2;
+            tok.type = TOK_PUNCT;
+            tok.punct = PUNCT_SCOPE;
+        }
+        else if (c == '-' && ptr + 1 < end && ptr[1] == '>')
+        {
+            ptr += 2;
+            continue;
+        }
+        else
+        {
+            ptr++;
+            tok.type = TOK_PUNCT;
+            tok.punct = c;
+        }
+
+        tok.len = ptr - tok.start;
+
+        /* template <...> parameters look like declarations, drop them */
+        if (tok.type == TOK_PUNCT && tok.punct == '<' && p->tokens->len > 0 &&
+            tok_is (TOKEN (p, p->tokens->len - 1), "template"))
+        {
+            int depth = 1;
+
+            for ( ; ptr < end && depth > 0; ptr++)
+            {
+                if (*ptr == '<')
+                    depth++;
+                else if (*ptr == '>')
+                    depth--;
+                else if (*ptr == '\n')
+                    line++;
+            }
+
+            g_array_set_size (p->tokens, p->tokens->len - 1);
+            continue;
+        }
+
+        g_array_append_val (p->tokens, tok);
+    }
+}
+
+/* index of the token matching an opening bracket at i, or N_TOKENS */
+static int
+c_match (CParser *p,
+         int      i)
+{
+    char open = TOKEN (p, i)->punct;
+    char close = open == '{' ? '}' : open == '(' ? ')' : ']';
+    int depth = 0;
+
+    for ( ; i < N_TOKENS (p); ++i)
+    {
+        Token *t = TOKEN (p, i);
+
+        if (t->type != TOK_PUNCT)
+            continue;
+
+        if (t->punct == open)
+            depth++;
+        else if (t->punct == close && --depth == 0)
+            return i;
+    }
+
+    return N_TOKENS (p);
+}
+
+static char *
+c_signature (CParser *p,
+             int      open,
+             int      close)
+{
+    GString *sig;
+    const char *s, *e;
+
+    if (close >= N_TOKENS (p))
+        return NULL;
+
+    sig = g_string_new (NULL);
+    s = TOKEN (p, open)->start;
+    e = TOKEN (p, close)->start + 1;
+
+    /* collapse whitespace */
+    for ( ; s < e; ++s)
+    {
+        if (g_ascii_isspace (*s))
+        {
+            if (sig->len && sig->str[sig->len - 1] != ' ')
+                g_string_append_c (sig, ' ');
+        }
+        else
+        {
+            g_string_append_c (sig, *s);
+        }
+    }
+
+    return g_string_free (sig, FALSE);
+}
+
+static gboolean
+c_has_word (CParser    *p,
+            int         start,
+            int         end,
+            const char *word)
+{
+    int i;
+    for (i = start; i < end; ++i)
+        if (tok_is (TOKEN (p, i), word))
+            return TRUE;
+    return FALSE;
+}
+
+/* declared names in 'int a, *b[3] = {1}, c : 2' */
+static void
+c_declarators (CParser    *p,
+               int         start,
+               int         end,
+               const char *kind,
+               const char *klass,
+               gboolean    file_scope)
+{
+    int i;
+    Token *last = NULL;
+
+    for (i = start; i <= end; ++i)
+    {
+        Token *t = i < end ? TOKEN (p, i) : NULL;
+
+        if (t && t->type == TOK_IDENT)
+        {
+            last = is_keyword (t) ? NULL : t;
+        }
+        else if (t && (tok_is_punct (t, '(') || tok_is_punct (t, '{')))
+        {
+            i = c_match (p, i);
+        }
+        else if (!t || tok_is_punct (t, ',') || tok_is_punct (t, '=') ||
+                 tok_is_punct (t, '[') || tok_is_punct (t, ':') || tok_is_punct (t, ';'))
+        {
+            if (last)
+                add_token_entry (p, last, kind, klass, NULL, file_scope);
+            last = NULL;
+
+            if (!t)
+                break;
+
+            if (!tok_is_punct (t, ','))
+            {
+                /* skip initializer, array size or bit width up to the next declarator */
+                int depth = 0;
+                for (i++; i < end; ++i)
+                {
+                    Token *s = TOKEN (p, i);
+                    if (tok_is_punct (s, '(') || tok_is_punct (s, '[') || tok_is_punct (s, '{'))
+                        depth++;
+                    else if (tok_is_punct (s, ')') || tok_is_punct (s, ']') || tok_is_punct (s, '}'))
+                        depth--;
+                    else if (depth == 0 && tok_is_punct (s, ','))
+                        break;
+                }
+            }
+        }
+        else
+        {
+            last = NULL;
+        }
+    }
+}
+
+static int c_scope (CParser *p, int i, gboolean in_braces, const char *klass);
+
+/* a statement [start, end) terminated by ';' */
+static void
+c_declaration (CParser    *p,
+               int         start,
+               int         end,
+               const char *klass)
+{
+    int i;
+
+    /* access specifiers */
+    while (start + 1 < end &&
+           (tok_is (TOKEN (p, start), "public") || tok_is (TOKEN (p, start), "private") ||
+            tok_is (TOKEN (p, start), "protected")) &&
+           tok_is_punct (TOKEN (p, start + 1), ':'))
+        start += 2;
+
+    if (start >= end)
+        return;
+
+    if (tok_is (TOKEN (p, start), "typedef"))
+    {
+        Token *name = NULL;
+
+        for (i = start + 1; i < end; ++i)
+        {
+            Token *t = TOKEN (p, i);
+
+            /* typedef void (*Func) (int) */
+            if (tok_is_punct (t, '('))
+            {
+                if (!name)
+                {
+                    int j;
+                    for (j = i + 1; j < end && !tok_is_punct (TOKEN (p, j), ')'); ++j)
+                        if (TOKEN (p, j)->type == TOK_IDENT)
+                            name = TOKEN (p, j);
+                }
+                break;
+            }
+
+            if (tok_is_punct (t, '['))
+                break;
+
+            if (t->type == TOK_IDENT && !is_keyword (t))
+                name = t;
+        }
+
+        if (name)
+            add_token_entry (p, name, "t", NULL, NULL, FALSE);
+
+        return;
+    }
+
+    if (tok_is (TOKEN (p, start), "extern") || tok_is (TOKEN (p, start), "using") ||
+        tok_is (TOKEN (p, start), "friend") || tok_is (TOKEN (p, start), "return") ||
+        tok_is (TOKEN (p, start), "template"))
+        return;
+
+    /* prototypes and macro calls */
+    for (i = start; i < end; ++i)
+    {
+        Token *t = TOKEN (p, i);
+        if (tok_is_punct (t, '='))
+            break;
+        if (tok_is_punct (t, '('))
+        {
+            /* function pointer 'void (*func) (int)' */
+            if (i + 2 < end && tok_is_punct (TOKEN (p, i + 1), '*') &&
+                TOKEN (p, i + 2)->type == TOK_IDENT)
+                add_token_entry (p, TOKEN (p, i + 2), klass ? "m" : "v", klass, NULL,
+                                 !klass && c_has_word (p, start, i, "static"));
+            return;
+        }
+    }
+
+    /* forward declarations 'struct Foo;' */
+    if (end - start == 2 &&
+        (tok_is (TOKEN (p, start), "struct") || tok_is (TOKEN (p, start), "class") ||
+         tok_is (TOKEN (p, start), "union") || tok_is (TOKEN (p, start), "enum")))
+        return;
+
+    if (klass)
+        c_declarators (p, start, end, "m", klass, FALSE);
+    else
+        c_declarators (p, start, end, "v", NULL, c_has_word (p, start, end, "static"));
+}
+
+static void
+c_enum_body (CParser    *p,
+             int         open,
+             int         close,
+             const char *klass)
+{
+    int i;
+    gboolean expect_name = TRUE;
+    int depth = 0;
+
+    for (i = open + 1; i < close; ++i)
+    {
+        Token *t = TOKEN (p, i);
+
+        if (tok_is_punct (t, '(') || tok_is_punct (t, '{'))
+            depth++;
+        else if (tok_is_punct (t, ')') || tok_is_punct (t, '}'))
+            depth--;
+        else if (depth == 0 && tok_is_punct (t, ','))
+            expect_name = TRUE;
+        else if (depth == 0 && expect_name && t->type == TOK_IDENT)
+        {
+            add_token_entry (p, t, "e", klass, NULL, FALSE);
+            expect_name = FALSE;
+        }
+        else
+            expect_name = FALSE;
+    }
+}
+
+/* end of statement which follows '}' of a struct body, e.g. '} Foo;' */
+static int
+c_statement_end (CParser *p,
+                 int      i)
+{
+    for ( ; i < N_TOKENS (p); ++i)
+    {
+        Token *t = TOKEN (p, i);
+
+        if (tok_is_punct (t, ';'))
+            return i;
+        if (tok_is_punct (t, '{') || tok_is_punct (t, '('))
+            i = c_match (p, i);
+    }
+
+    return N_TOKENS (p);
+}
+
+/* statement [start, open) followed by a '{' at index open; returns index
+ * of the first token after the whole construct */
+static int
+c_block (CParser    *p,
+         int         start,
+         int         open,
+         const char *klass)
+{
+    int i, close, paren = -1, assign = -1, aggregate = -1;
+
+    for (i = start; i < open; ++i)
+    {
+        Token *t = TOKEN (p, i);
+
+        if (tok_is (t, "namespace") || (tok_is (t, "extern") && i + 1 < open &&
+                                         TOKEN (p, i + 1)->type == TOK_STRING))
+        {
+            /* transparent scopes */
+            return c_scope (p, open + 1, TRUE, klass);
+        }
+
+        if (tok_is (t, "operator"))
+        {
+            /* operator== (...) */
+            while (i + 1 < open && !tok_is_punct (TOKEN (p, i + 1), '('))
+                i++;
+            continue;
+        }
+
+        if (tok_is_punct (t, '=') && assign < 0 && paren < 0)
+            assign = i;
+        else if (tok_is_punct (t, '(') && paren < 0)
+            paren = i;
+        else if (aggregate < 0 && (tok_is (t, "struct") || tok_is (t, "class") ||
+                                   tok_is (t, "union") || tok_is (t, "enum")))
+            aggregate = i;
+
+        if (tok_is_punct (t, '('))
+            i = c_match (p, i);
+    }
+
+    close = c_match (p, open);
+
+    if (assign >= 0)
+    {
+        /* initialized variable */
+        int end = c_statement_end (p, close + 1);
+        if (!klass)
+            c_declarators (p, start, end, "v", NULL, c_has_word (p, start, end, "static"));
+        return end + 1;
+    }
+
+    if (paren >= 0)
+    {
+        /* function definition */
+        Token *name = NULL;
+        char *fklass = NULL;
+        char *signature;
+
+        for (i = paren - 1; i >= start; --i)
+        {
+            Token *t = TOKEN (p, i);
+
+            if (t->type == TOK_IDENT && !is_keyword (t))
+            {
+                name = t;
+                break;
+            }
+
+            if (tok_is (t, "operator"))
+            {
+                name = t;
+                break;
+            }
+        }
+
+        if (name)
+        {
+            const char *name_start = name->start;
+            const char *name_end = name->start + name->len;
+            Token *scope = name - 1;
+
+            if (tok_is (name, "operator"))
+            {
+                /* operator== */
+                name_end = TOKEN (p, paren)->start;
+                while (name_end > name_start && g_ascii_isspace (name_end[-1]))
+                    name_end--;
+            }
+
+            if (name > TOKEN (p, start) && tok_is_punct (scope, '~'))
+            {
+                /* destructor */
+                name_start = scope->start;
+                scope--;
+            }
+
+            /* Foo::bar */
+            if (scope > TOKEN (p, start) && tok_is_punct (scope, PUNCT_SCOPE) &&
+                (scope - 1)->type == TOK_IDENT)
+                fklass = g_strndup ((scope - 1)->start, (scope - 1)->len);
+
+            signature = c_signature (p, paren, c_match (p, paren));
+            add_entry (&p->entries, name_start, name_end - name_start, "f",
+                       name->line, fklass ? fklass : klass, signature,
+                       c_has_word (p, start, paren, "static"));
+            g_free (signature);
+        }
+
+        g_free (fklass);
+        return close + 1;
+    }
+
+    if (aggregate >= 0)
+    {
+        Token *kw = TOKEN (p, aggregate);
+        Token *name = NULL;
+        gboolean is_typedef = c_has_word (p, start, aggregate, "typedef");
+        int tail_end = c_statement_end (p, close + 1);
+        const char *kind;
+        char *name_str = NULL;
+
+        i = aggregate + 1;
+        if (i < open && tok_is (TOKEN (p, i), "class")) /* enum class */
+            i++;
+        if (i < open && TOKEN (p, i)->type == TOK_IDENT && !is_keyword (TOKEN (p, i)))
+            name = TOKEN (p, i);
+
+        if (tok_is (kw, "enum"))
+            kind = "g";
+        else if (tok_is (kw, "class"))
+            kind = "c";
+        else if (tok_is (kw, "union"))
+            kind = "u";
+        else
+            kind = "s";
+
+        if (!name && is_typedef)
+        {
+            /* typedef struct { ... } Foo; */
+            for (i = tail_end - 1; i > close; --i)
+                if (TOKEN (p, i)->type == TOK_IDENT)
+                {
+                    name = TOKEN (p, i);
+                    break;
+                }
+        }
+
+        if (name)
+        {
+            name_str = g_strndup (name->start, name->len);
+            add_token_entry (p, name, kind, klass, NULL, FALSE);
+        }
+
+        if (tok_is (kw, "enum"))
+            c_enum_body (p, open, close, name_str);
+        else if (name_str)
+            c_scope (p, open + 1, TRUE, name_str);
+
+        if (close + 1 < tail_end)
+        {
+            if (is_typedef)
+            {
+                for (i = tail_end - 1; i > close; --i)
+                    if (TOKEN (p, i)->type == TOK_IDENT)
+                    {
+                        if (TOKEN (p, i) != name)
+                            add_token_entry (p, TOKEN (p, i), "t", NULL, NULL, FALSE);
+                        break;
+                    }
+            }
+            else if (klass)
+            {
+                c_declarators (p, close + 1, tail_end, "m", klass, FALSE);
+            }
+            else
+            {
+                c_declarators (p, close + 1, tail_end, "v", NULL,
+                               c_has_word (p, start, aggregate, "static"));
+            }
+        }
+
+        g_free (name_str);
+        return tail_end + 1;
+    }
+
+    return close + 1;
+}
+
+/* parses statements starting at i until the closing brace (if in_braces)
+ * or the end of tokens; returns index after the closing brace */
+static int
+c_scope (CParser    *p,
+         int         i,
+         gboolean    in_braces,
+         const char *klass)
+{
+    int start = i;
+
+    while (i < N_TOKENS (p))
+    {
+        Token *t = TOKEN (p, i);
+
+        if (tok_is_punct (t, '}'))
+        {
+            if (in_braces)
+                return i + 1;
+            start = ++i;
+        }
+        else if (tok_is_punct (t, ';'))
+        {
+            c_declaration (p, start, i, klass);
+            start = ++i;
+        }
+        else if (tok_is_punct (t, '{'))
+        {
+            i = c_block (p, start, i, klass);
+            start = i;
+        }
+        else if (tok_is_punct (t, '(') || tok_is_punct (t, '['))
+        {
+            i = c_match (p, i) + 1;
+            /* a macro call without semicolon, like G_DEFINE_TYPE (...) */
+            if (i < N_TOKENS (p) && TOKEN (p, i)->bol && TOKEN (p, i)->type == TOK_IDENT)
+                start = i;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return i;
+}
+
+static GSList *
+parse_c_chunk (const char *text,
+               gsize       len)
+{
+    CParser p;
+
+    p.text = text;
+    p.tokens = g_array_new (FALSE, FALSE, sizeof (Token));
+    p.entries = NULL;
+
+    c_tokenize (&p, len);
+    c_scope (&p, 0, FALSE, NULL);
+
+    g_array_free (p.tokens, TRUE);
+    return p.entries;
+}
+
+/* chunk ends after a line in which a top-level statement ends */
+static gsize
+next_c_chunk (const char *text,
+              gsize       len)
+{
+    gsize i;
+    int depth = 0;
+    gboolean statement_done = FALSE;
+    gboolean in_comment = FALSE;
+    gboolean line_start = TRUE;
+    gboolean has_code = FALSE;
+
+    for (i = 0; i < len; ++i)
+    {
+        char c = text[i];
+
+        if (in_comment)
+        {
+            if (c == '*' && i + 1 < len && text[i+1] == '/')
+            {
+                in_comment = FALSE;
+                i++;
+            }
+            continue;
+        }
+
+        if (c == '\n')
+        {
+            if (statement_done && depth <= 0)
+                return i + 1;
+            line_start = TRUE;
+            continue;
+        }
+
+        if (g_ascii_isspace (c))
+            continue;
+
+        if (c == '#' && line_start)
+        {
+            int dummy = 0;
+            const char *end = skip_line (text + i, text + len, &dummy);
+            i = end - text;
+            /* a preprocessor line is a chunk of its own unless it is
+             * inside of a statement */
+            if (!has_code && depth <= 0)
+                return MIN (i + 1, len);
+            continue;
+        }
+
+        line_start = FALSE;
+        has_code = TRUE;
+
+        if (c == '/' && i + 1 < len && text[i+1] == '*')
+        {
+            in_comment = TRUE;
+            i++;
+        }
+        else if (c == '/' && i + 1 < len && text[i+1] == '/')
+        {
+            while (i + 1 < len && text[i+1] != '\n')
+                i++;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            for (i++; i < len && text[i] != c && text[i] != '\n'; i++)
+                if (text[i] == '\\' && i + 1 < len)
+                    i++;
+            if (i < len && text[i] == '\n')
+                i--;
+        }
+        else if (c == '{')
+        {
+            depth++;
+            statement_done = FALSE;
+        }
+        else if (c == '}')
+        {
+            depth--;
+            statement_done = depth <= 0;
+        }
+        else if (c == ';')
+        {
+            statement_done = depth <= 0;
+        }
+        else
+        {
+            statement_done = FALSE;
+        }
+    }
+
+    return len;
+}
+
+
+/*************************************************************************/
+/* Python
+ */
+
+typedef struct {
+    int indent;
+    char *name;
+    gboolean is_class;
+} PyScope;
+
+static const char *
+py_skip_string (const char *p,
+                const char *end,
+                int        *line)
+{
+    char quote = *p;
+
+    if (p + 2 < end && p[1] == quote && p[2] == quote)
+    {
+        for (p += 3; p + 2 < end; ++p)
+        {
+            if (*p == '\\')
+                p++;
+            else if (*p == '\n')
+                *line += 1;
+            else if (p[0] == quote && p[1] == quote && p[2] == quote)
+                return p + 3;
+        }
+
+        return end;
+    }
+
+    for (p++; p < end && *p != quote && *p != '\n'; ++p)
+        if (*p == '\\' && p + 1 < end)
+            p++;
+
+    return p < end && *p == quote ? p + 1 : p;
+}
+
+/* first line of a logical line starting at p, returns pointer after it */
+static const char *
+py_logical_line (const char *p,
+                 const char *end,
+                 int        *line,
+                 GString    *out)
+{
+    int depth = 0;
+
+    g_string_truncate (out, 0);
+
+    while (p < end)
+    {
+        char c = *p;
+
+        if (c == '\n')
+        {
+            *line += 1;
+            p++;
+            if (depth <= 0)
+                break;
+            g_string_append_c (out, ' ');
+        }
+        else if (c == '#')
+        {
+            while (p < end && *p != '\n')
+                p++;
+        }
+        else if (c == '\\' && p + 1 < end && p[1] == '\n')
+        {
+            *line += 1;
+            p += 2;
+            g_string_append_c (out, ' ');
+        }
+        else if (c == '"' || c == '\'')
+        {
+            p = py_skip_string (p, end, line);
+            g_string_append (out, "\"\"");
+        }
+        else if (depth > 0 && (c == ' ' || c == '\t') && out->len &&
+                 out->str[out->len - 1] == ' ')
+        {
+            p++;
+        }
+        else
+        {
+            if (c == '(' || c == '[' || c == '{')
+                depth++;
+            else if (c == ')' || c == ']' || c == '}')
+                depth--;
+            g_string_append_c (out, c);
+            p++;
+        }
+    }
+
+    return p;
+}
+
+static GSList *
+parse_python_chunk (const char *text,
+                    gsize       len)
+{
+    const char *p = text;
+    const char *end = text + len;
+    GSList *entries = NULL;
+    GArray *scopes;
+    GString *buf;
+    int line = 0;
+    guint i;
+
+    scopes = g_array_new (FALSE, FALSE, sizeof (PyScope));
+    buf = g_string_new (NULL);
+
+    while (p < end)
+    {
+        int start_line = line;
+        const char *s;
+        int indent = 0;
+        PyScope *parent = NULL;
+        gboolean is_class, is_def;
+
+        p = py_logical_line (p, end, &line, buf);
+
+        for (s = buf->str; *s == ' ' || *s == '\t'; ++s)
+            indent += *s == '\t' ? 8 - indent % 8 : 1;
+
+        if (!*s)
+            continue;
+
+        while (scopes->len > 0 &&
+               g_array_index (scopes, PyScope, scopes->len - 1).indent >= indent)
+        {
+            g_free (g_array_index (scopes, PyScope, scopes->len - 1).name);
+            g_array_set_size (scopes, scopes->len - 1);
+        }
+
+        if (scopes->len > 0)
+            parent = &g_array_index (scopes, PyScope, scopes->len - 1);
+
+        is_class = !strncmp (s, "class", 5) && g_ascii_isspace (s[5]);
+        is_def = !strncmp (s, "def", 3) && g_ascii_isspace (s[3]);
+
+        if (!strncmp (s, "async", 5) && g_ascii_isspace (s[5]))
+        {
+            const char *d = s + 5;
+            while (g_ascii_isspace (*d))
+                d++;
+            if (!strncmp (d, "def", 3) && g_ascii_isspace (d[3]))
+            {
+                s = d;
+                is_def = TRUE;
+            }
+        }
+
+        if (is_class || is_def)
+        {
+            const char *name = s + (is_class ? 5 : 3);
+            const char *name_end;
+            char *signature = NULL;
+            PyScope scope;
+
+            while (g_ascii_isspace (*name))
+                name++;
+            for (name_end = name; is_ident_char (*name_end); ++name_end) ;
+
+            if (name_end == name)
+                continue;
+
+            if (is_def && *name_end)
+            {
+                const char *sig = strchr (name_end, '(');
+                const char *sig_end = sig ? strrchr (sig, ')') : NULL;
+                if (sig && sig_end)
+                    signature = g_strndup (sig, sig_end - sig + 1);
+            }
+
+            /* functions nested in functions are not interesting */
+            if (!parent || parent->is_class)
+                add_entry (&entries, name, name_end - name,
+                           is_class ? "c" : (parent ? "m" : "f"),
+                           start_line, parent ? parent->name : NULL,
+                           signature, FALSE);
+
+            g_free (signature);
+
+            scope.indent = indent;
+            scope.name = g_strndup (name, name_end - name);
+            scope.is_class = is_class;
+            g_array_append_val (scopes, scope);
+        }
+        else if (!parent && indent == 0 && is_ident_start (*s))
+        {
+            /* NAME = value at module level */
+            const char *name_end;
+
+            for (name_end = s; is_ident_char (*name_end); ++name_end) ;
+            while (*name_end == ' ' || *name_end == '\t')
+                name_end++;
+
+            if (name_end[0] == '=' && name_end[1] != '=')
+            {
+                for (name_end = s; is_ident_char (*name_end); ++name_end) ;
+                add_entry (&entries, s, name_end - s, "v", start_line, NULL, NULL, FALSE);
+            }
+        }
+    }
+
+    for (i = 0; i < scopes->len; ++i)
+        g_free (g_array_index (scopes, PyScope, i).name);
+    g_array_free (scopes, TRUE);
+    g_string_free (buf, TRUE);
+
+    return entries;
+}
+
+/* chunk ends before the next non-indented line which is not a comment or
+ * a continuation of a string or expression */
+static gsize
+next_python_chunk (const char *text,
+                   gsize       len)
+{
+    const char *p = text;
+    const char *end = text + len;
+    GString *buf = g_string_new (NULL);
+    gboolean first = TRUE;
+    int line = 0;
+
+    while (p < end)
+    {
+        const char *line_start = p;
+
+        if (!first && !g_ascii_isspace (*p) && *p != '#' && *p != ')' &&
+            *p != ']' && *p != '}')
+        {
+            g_string_free (buf, TRUE);
+            return p - text;
+        }
+
+        p = py_logical_line (p, end, &line, buf);
+
+        if (first && p > line_start)
+        {
+            const char *s;
+            for (s = buf->str; g_ascii_isspace (*s); ++s) ;
+            /* decorators belong to the following definition */
+            first = !*s || *s == '@';
+        }
+    }
+
+    g_string_free (buf, TRUE);
+    return len;
+}
+
+
+/*************************************************************************/
+/* Scanning
+ */
+
+static GSList *
+chunk_entries_at (GSList *chunk_entries,
+                  int     line_offset,
+                  GSList *list)
+{
+    for ( ; chunk_entries != NULL; chunk_entries = chunk_entries->next)
+    {
+        MooCtagsEntry *e = chunk_entries->data;
+        list = g_slist_prepend (list,
+                                _moo_ctags_entry_new (e->name, e->kind, e->line + line_offset,
+                                                      e->klass, e->signature, e->file_scope));
+    }
+
+    return list;
+}
+
+static int
+count_lines (const char *text,
+             gsize       len)
+{
+    int n = 0;
+    const char *p, *end = text + len;
+
+    for (p = text; p < end && (p = memchr (p, '\n', end - p)); ++p)
+        n++;
+
+    return n;
+}
+
+static int
+compare_entries (const MooCtagsEntry *e1,
+                 const MooCtagsEntry *e2)
+{
+    return e1->line < e2->line ? -1 : (e1->line > e2->line ? 1 : 0);
+}
+
+static gsize
+next_chunk (const char *text,
+            gsize       len,
+            ScanLang    lang)
+{
+    gsize chunk_len;
+
+    if (lang == LANG_C)
+        chunk_len = next_c_chunk (text, len);
+    else
+        chunk_len = next_python_chunk (text, len);
+
+    return chunk_len ? chunk_len : len;
+}
+
+/* old chunks with the same text are reused, the rest is parsed */
+static Chunk *
+get_chunk (const char *text,
+           gsize       len,
+           ScanLang    lang,
+           GHashTable *old_chunks)
+{
+    ChunkKey key = chunk_key (text, len);
+    Chunk *chunk;
+
+    if (old_chunks && (chunk = g_hash_table_lookup (old_chunks, &key)))
+    {
+        g_hash_table_steal (old_chunks, &key);
+        return chunk;
+    }
+
+    chunk = g_slice_new (Chunk);
+    chunk->key = key;
+    chunk->n_lines = count_lines (text, len);
+
+    if (lang == LANG_C)
+        chunk->entries = parse_c_chunk (text, len);
+    else
+        chunk->entries = parse_python_chunk (text, len);
+
+    return chunk;
+}
+
+static GSList *
+get_entries (GPtrArray *chunks)
+{
+    GSList *list = NULL;
+    int line = 0;
+    guint i;
+
+    for (i = 0; i < chunks->len; ++i)
+    {
+        Chunk *chunk = chunks->pdata[i];
+        list = chunk_entries_at (chunk->entries, line, list);
+        line += chunk->n_lines;
+    }
+
+    return g_slist_sort (list, (GCompareFunc) compare_entries);
+}
+
+GSList *
+_moo_ctags_scan_text (const char        *text,
+                      const char        *lang_id,
+                      MooCtagsScanCache *cache)
+{
+    ScanLang lang = get_scan_lang (lang_id);
+    GHashTable *old_chunks = NULL;
+    GPtrArray *chunks;
+    GSList *list;
+    gsize len, pos = 0;
+
+    g_return_val_if_fail (text != NULL, NULL);
+    g_return_val_if_fail (lang != LANG_NONE, NULL);
+
+    if (cache && cache->chunks)
+    {
+        old_chunks = chunk_table_new (cache->chunks, 0, cache->chunks->len);
+        cache_clear (cache);
+    }
+
+    len = strlen (text);
+    chunks = g_ptr_array_new ();
+
+    while (pos < len)
+    {
+        gsize chunk_len = next_chunk (text + pos, len - pos, lang);
+        g_ptr_array_add (chunks, get_chunk (text + pos, chunk_len, lang, old_chunks));
+        pos += chunk_len;
+    }
+
+    list = get_entries (chunks);
+
+    if (old_chunks)
+        g_hash_table_destroy (old_chunks);
+
+    if (cache)
+    {
+        cache->lang = lang;
+        cache->chunks = chunks;
+        cache->n_lines = count_lines (text, len) + 1;
+    }
+    else
+    {
+        g_ptr_array_foreach (chunks, (GFunc) chunk_free, NULL);
+        g_ptr_array_free (chunks, TRUE);
+    }
+
+    return list;
+}
+
+gboolean
+_moo_ctags_scan_cache_prepare (MooCtagsScanCache *cache,
+                               const char        *lang_id,
+                               int                first_changed,
+                               int                unchanged_tail,
+                               int                n_lines,
+                               int               *start_line,
+                               int               *end_line)
+{
+    guint first, last;
+    int start, tail, end, min_lines;
+
+    g_return_val_if_fail (cache != NULL, FALSE);
+    g_return_val_if_fail (n_lines > 0, FALSE);
+    g_return_val_if_fail (start_line != NULL && end_line != NULL, FALSE);
+
+    if (!cache->chunks || cache->lang == LANG_NONE || cache->lang != get_scan_lang (lang_id))
+        return FALSE;
+
+    min_lines = MIN (n_lines, cache->n_lines);
+    first_changed = CLAMP (first_changed, 0, min_lines - 1);
+    unchanged_tail = CLAMP (unchanged_tail, 0, min_lines - 1 - first_changed);
+
+    /* whether a chunk ends before line L may depend on the first
+     * character of line L, so start with the chunk which contains the
+     * line before the change */
+    for (first = 0, start = 0;
+         first + 1 < cache->chunks->len &&
+            start + ((Chunk*) cache->chunks->pdata[first])->n_lines < MAX (first_changed, 1);
+         ++first)
+    {
+        start += ((Chunk*) cache->chunks->pdata[first])->n_lines;
+    }
+
+    /* first chunk after it which starts in the unchanged tail */
+    for (last = first, tail = start; last < cache->chunks->len; )
+    {
+        tail += ((Chunk*) cache->chunks->pdata[last])->n_lines;
+        last++;
+        if (tail >= cache->n_lines - unchanged_tail)
+            break;
+    }
+
+    /* the rescan may stop where that chunk starts, or where the next one
+     * starts, e.g. if a Python decorator was added before it */
+    if (last < cache->chunks->len)
+        tail = tail - cache->n_lines + n_lines;
+    else
+        tail = n_lines;
+
+    if (last + 1 < cache->chunks->len)
+        end = tail + ((Chunk*) cache->chunks->pdata[last])->n_lines;
+    else
+        end = n_lines;
+
+    cache->first_chunk = first;
+    cache->last_chunk = last;
+    cache->start_line = start;
+    cache->tail_line = tail;
+    cache->end_line = end;
+    cache->new_n_lines = n_lines;
+
+    *start_line = start;
+    *end_line = end;
+    return TRUE;
+}
+
+gboolean
+_moo_ctags_scan_text_update (const char         *text,
+                             MooCtagsScanCache  *cache,
+                             GSList            **entries)
+{
+    GHashTable *old_chunks;
+    GPtrArray *new_chunks;
+    GPtrArray *chunks;
+    gsize len, end, pos = 0;
+    gboolean complete = TRUE;
+    guint i, last;
+    int line;
+
+    g_return_val_if_fail (text != NULL, FALSE);
+    g_return_val_if_fail (cache != NULL && cache->chunks != NULL, FALSE);
+    g_return_val_if_fail (entries != NULL, FALSE);
+
+    *entries = NULL;
+    len = strlen (text);
+
+    /* text holds lines start_line..end_line, the last one is only
+     * needed to see whether the chunk before it ends there */
+    if (cache->end_line < cache->new_n_lines)
+    {
+        int n = cache->end_line - cache->start_line;
+        const char *p;
+
+        for (p = text; n > 0 && (p = strchr (p, '\n')); ++p)
+            n--;
+
+        if (n > 0 || !p)
+        {
+            cache_clear (cache);
+            return FALSE;
+        }
+
+        end = p - text;
+    }
+    else
+    {
+        end = len;
+    }
+
+    old_chunks = chunk_table_new (cache->chunks, cache->first_chunk, cache->last_chunk);
+    new_chunks = g_ptr_array_new ();
+    last = cache->last_chunk;
+    line = cache->start_line;
+
+    while (TRUE)
+    {
+        gsize chunk_len;
+        Chunk *chunk;
+
+        /* reached the start of an unchanged chunk */
+        if (line == cache->tail_line && last < cache->chunks->len)
+            break;
+        if (line == cache->end_line && last + 1 < cache->chunks->len)
+        {
+            chunk_free (cache->chunks->pdata[last]);
+            cache->chunks->pdata[last] = NULL;
+            last++;
+            break;
+        }
+        if (pos == len && cache->end_line == cache->new_n_lines)
+        {
+            for ( ; last < cache->chunks->len; ++last)
+            {
+                chunk_free (cache->chunks->pdata[last]);
+                cache->chunks->pdata[last] = NULL;
+            }
+            break;
+        }
+
+        chunk_len = next_chunk (text + pos, len - pos, cache->lang);
+
+        /* the chunk goes on past the lines which were copied */
+        if (pos >= end || pos + chunk_len > end)
+        {
+            complete = FALSE;
+            break;
+        }
+
+        chunk = get_chunk (text + pos, chunk_len, cache->lang, old_chunks);
+        g_ptr_array_add (new_chunks, chunk);
+        pos += chunk_len;
+        line += chunk->n_lines;
+    }
+
+    g_hash_table_destroy (old_chunks);
+
+    if (!complete)
+    {
+        g_ptr_array_foreach (new_chunks, (GFunc) chunk_free, NULL);
+        g_ptr_array_free (new_chunks, TRUE);
+        cache_clear (cache);
+        return FALSE;
+    }
+
+    chunks = g_ptr_array_sized_new (cache->chunks->len + new_chunks->len);
+    for (i = 0; i < cache->first_chunk; ++i)
+        g_ptr_array_add (chunks, cache->chunks->pdata[i]);
+    for (i = 0; i < new_chunks->len; ++i)
+        g_ptr_array_add (chunks, new_chunks->pdata[i]);
+    for (i = last; i < cache->chunks->len; ++i)
+        g_ptr_array_add (chunks, cache->chunks->pdata[i]);
+
+    g_ptr_array_free (new_chunks, TRUE);
+    g_ptr_array_free (cache->chunks, TRUE);
+    cache->chunks = chunks;
+    cache->n_lines = cache->new_n_lines;
+
+    *entries = get_entries (chunks);
+    return TRUE;
+}
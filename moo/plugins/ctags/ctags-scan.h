@@ -0,0 +1,55 @@
+/*
+ *   ctags-scan.h
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CTAGS_SCAN_H
+#define CTAGS_SCAN_H
+
+#include "ctags-doc.h"
+
+G_BEGIN_DECLS
+
+typedef struct _MooCtagsScanCache MooCtagsScanCache;
+
+gboolean            _moo_ctags_scan_supports_lang   (const char         *lang_id);
+
+MooCtagsScanCache  *_moo_ctags_scan_cache_new       (void);
+void                _moo_ctags_scan_cache_free      (MooCtagsScanCache  *cache);
+
+/* May be called from any thread, cache must not be shared between
+ * simultaneous calls. Returns a list of MooCtagsEntry sorted by line. */
+GSList             *_moo_ctags_scan_text            (const char         *text,
+                                                     const char         *lang_id,
+                                                     MooCtagsScanCache  *cache);
+
+/* Incremental scan after an edit. Main thread: given the first changed
+ * line and the number of unchanged lines at the end of the text, returns
+ * the range of lines to rescan, or FALSE if the whole text needs to be
+ * scanned. Then the text of lines start_line..end_line inclusive is
+ * passed to _moo_ctags_scan_text_update(), which returns FALSE if it
+ * turned out not to be enough. */
+gboolean            _moo_ctags_scan_cache_prepare   (MooCtagsScanCache  *cache,
+                                                     const char         *lang_id,
+                                                     int                 first_changed,
+                                                     int                 unchanged_tail,
+                                                     int                 n_lines,
+                                                     int                *start_line,
+                                                     int                *end_line);
+gboolean            _moo_ctags_scan_text_update     (const char         *text,
+                                                     MooCtagsScanCache  *cache,
+                                                     GSList            **entries);
+
+G_END_DECLS
+
+#endif /* CTAGS_SCAN_H */
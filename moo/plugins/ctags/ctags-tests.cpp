@@ -0,0 +1,434 @@
+/*
+ *   ctags-tests.cpp
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ctags-tests.h"
+#include "ctags-scan.h"
+#include "ctags-index.h"
+#include "mooutils/mooutils-fs.h"
+#include <string.h>
+
+static const char c_text[] =
+    "#define MAX_SIZE 100\n"
+    "\n"
+    "typedef struct _Point Point;\n"
+    "\n"
+    "struct _Point {\n"
+    "    int x;\n"
+    "    int y;\n"
+    "};\n"
+    "\n"
+    "enum Color {\n"
+    "    RED,\n"
+    "    GREEN\n"
+    "};\n"
+    "\n"
+    "static int counter;\n"
+    "\n"
+    "static int\n"
+    "add (int a, int b)\n"
+    "{\n"
+    "    return a + b;\n"
+    "}\n"
+    "\n"
+    "void print_point (const Point *p);\n";
+
+static const char python_text[] =
+    "import os\n"
+    "\n"
+    "DEBUG = False\n"
+    "\n"
+    "class Shape:\n"
+    "    def area(self):\n"
+    "        return 0\n"
+    "\n"
+    "@cached\n"
+    "def helper(x, y=1):\n"
+    "    def inner():\n"
+    "        pass\n"
+    "    return x\n"
+    "\n"
+    "async def fetch(url):\n"
+    "    pass\n";
+
+/* "name kind line class signature" lines, one per entry */
+static char *
+format_entries (GSList *entries)
+{
+    GString *str = g_string_new (NULL);
+
+    while (entries)
+    {
+        MooCtagsEntry *e = (MooCtagsEntry*) entries->data;
+        g_string_append_printf (str, "%s %s %d %s %s\n",
+                                e->name, e->kind, e->line,
+                                e->klass ? e->klass : "-",
+                                e->signature ? e->signature : "-");
+        entries = entries->next;
+    }
+
+    return g_string_free (str, FALSE);
+}
+
+static void
+free_entries (GSList *entries)
+{
+    g_slist_foreach (entries, (GFunc) _moo_ctags_entry_unref, NULL);
+    g_slist_free (entries);
+}
+
+static char *
+scan_text (const char        *text,
+           const char        *lang_id,
+           MooCtagsScanCache *cache)
+{
+    GSList *entries = _moo_ctags_scan_text (text, lang_id, cache);
+    char *result = format_entries (entries);
+    free_entries (entries);
+    return result;
+}
+
+static void
+test_scan_c (void)
+{
+    char *result = scan_text (c_text, "c", NULL);
+
+    TEST_ASSERT_STR_EQ (result,
+                        "MAX_SIZE d 0 - -\n"
+                        "Point t 2 - -\n"
+                        "_Point s 4 - -\n"
+                        "x m 5 _Point -\n"
+                        "y m 6 _Point -\n"
+                        "Color g 9 - -\n"
+                        "RED e 10 Color -\n"
+                        "GREEN e 11 Color -\n"
+                        "counter v 14 - -\n"
+                        "add f 17 - (int a, int b)\n");
+
+    g_free (result);
+}
+
+static void
+test_scan_python (void)
+{
+    char *result = scan_text (python_text, "python", NULL);
+
+    TEST_ASSERT_STR_EQ (result,
+                        "DEBUG v 2 - -\n"
+                        "Shape c 4 - -\n"
+                        "area m 5 Shape (self)\n"
+                        "helper f 9 - (x, y=1)\n"
+                        "fetch f 14 - (url)\n");
+
+    g_free (result);
+}
+
+static int
+count_lines (const char *text)
+{
+    int n = 1;
+
+    while ((text = strchr (text, '\n')))
+    {
+        text++;
+        n++;
+    }
+
+    return n;
+}
+
+static const char *
+line_start (const char *text,
+            int         line)
+{
+    for ( ; line > 0 && *text; ++text)
+        if (*text == '\n')
+            line--;
+
+    return text;
+}
+
+/* The cache holds a scan of some text, which was changed into new_text;
+ * the change starts at line first_changed, and the last unchanged_tail
+ * lines were not touched. Checks that rescanning the changed lines gives
+ * the same result as scanning the whole new text. */
+static gboolean
+check_update (MooCtagsScanCache *cache,
+              const char        *new_text,
+              const char        *lang_id,
+              int                first_changed,
+              int                unchanged_tail)
+{
+    int n_lines = count_lines (new_text);
+    int start_line, end_line;
+    const char *start, *end;
+    GSList *entries;
+    char *text;
+    char *expected;
+    char *result;
+    gboolean complete;
+
+    TEST_ASSERT (_moo_ctags_scan_cache_prepare (cache, lang_id, first_changed, unchanged_tail,
+                                                n_lines, &start_line, &end_line));
+    TEST_ASSERT (start_line <= first_changed);
+    TEST_ASSERT (end_line > MIN (first_changed, n_lines - 1) && end_line <= n_lines);
+
+    start = line_start (new_text, start_line);
+    end = end_line < n_lines ? line_start (new_text, end_line + 1) : new_text + strlen (new_text);
+    text = g_strndup (start, end - start);
+
+    complete = _moo_ctags_scan_text_update (text, cache, &entries);
+
+    if (complete)
+    {
+        expected = scan_text (new_text, lang_id, NULL);
+        result = format_entries (entries);
+        TEST_ASSERT_STR_EQ (result, expected);
+        g_free (result);
+        g_free (expected);
+        free_entries (entries);
+    }
+
+    g_free (text);
+    return complete;
+}
+
+static char *
+replace_line (const char *text,
+              int         line,
+              const char *new_line)
+{
+    const char *start = line_start (text, line);
+    const char *end = line_start (start, 1);
+    return g_strdup_printf ("%.*s%s%s", (int) (start - text), text, new_line, end);
+}
+
+static void
+test_scan_update (void)
+{
+    MooCtagsScanCache *cache;
+    char *text1, *text2, *text3;
+    char *result;
+    int start_line, end_line;
+
+    cache = _moo_ctags_scan_cache_new ();
+    result = scan_text (c_text, "c", cache);
+    g_free (result);
+
+    /* nothing changed */
+    TEST_ASSERT (check_update (cache, c_text, "c", G_MAXINT, G_MAXINT));
+
+    /* function body edited */
+    text1 = replace_line (c_text, 19, "    return a - b;\n");
+    TEST_ASSERT (check_update (cache, text1, "c", 19, count_lines (text1) - 20));
+
+    /* a new function in the middle */
+    text2 = replace_line (text1, 15, "\nint sub (int a, int b)\n{\n    return a - b;\n}\n\n");
+    TEST_ASSERT (check_update (cache, text2, "c", 15, count_lines (text2) - 21));
+
+    /* an unterminated comment swallows everything after it, the changed
+     * lines are not enough and the cache must be reset */
+    text3 = replace_line (text2, 1, "/*\n");
+    TEST_ASSERT (!check_update (cache, text3, "c", 1, count_lines (text3) - 2));
+    TEST_ASSERT (!_moo_ctags_scan_cache_prepare (cache, "c", 1, count_lines (text3) - 2,
+                                                 count_lines (text3), &start_line, &end_line));
+
+    g_free (text3);
+    g_free (text2);
+    g_free (text1);
+
+    /* python: a decorator added before a function belongs to it */
+    result = scan_text (python_text, "python", cache);
+    g_free (result);
+    text1 = replace_line (python_text, 13, "\n@decorator\n");
+    TEST_ASSERT (check_update (cache, text1, "python", 13, count_lines (text1) - 15));
+    text2 = replace_line (text1, 5, "    def perimeter(self):\n");
+    TEST_ASSERT (check_update (cache, text2, "python", 5, count_lines (text2) - 6));
+
+    /* language changed */
+    TEST_ASSERT (!_moo_ctags_scan_cache_prepare (cache, "c", 0, 0, count_lines (text2),
+                                                 &start_line, &end_line));
+
+    g_free (text2);
+    g_free (text1);
+    _moo_ctags_scan_cache_free (cache);
+}
+
+static gboolean
+index_wait (MooCtagsIndex *index)
+{
+    GTimer *timer = g_timer_new ();
+    gboolean done;
+
+    while (_moo_ctags_index_is_updating (index) && g_timer_elapsed (timer, NULL) < 60)
+        g_main_context_iteration (NULL, TRUE);
+
+    done = !_moo_ctags_index_is_updating (index);
+    g_timer_destroy (timer);
+    return done;
+}
+
+/* "name basename line" lines, one per tag */
+static char *
+format_tags (GSList *tags)
+{
+    GString *str = g_string_new (NULL);
+
+    while (tags)
+    {
+        MooCtagsTag *tag = (MooCtagsTag*) tags->data;
+        char *basename = g_path_get_basename (tag->filename);
+        g_string_append_printf (str, "%s %s %d\n", tag->entry->name, basename, tag->entry->line);
+        g_free (basename);
+        tags = tags->next;
+    }
+
+    return g_string_free (str, FALSE);
+}
+
+static char *
+index_find (MooCtagsIndex *index,
+            const char    *name)
+{
+    GSList *tags = _moo_ctags_index_find (index, name);
+    char *result = format_tags (tags);
+    _moo_ctags_tag_list_free (tags);
+    return result;
+}
+
+static char *
+index_match (MooCtagsIndex *index,
+             const char    *pattern,
+             guint          max_results)
+{
+    GSList *tags = _moo_ctags_index_match (index, pattern, max_results);
+    char *result = format_tags (tags);
+    _moo_ctags_tag_list_free (tags);
+    return result;
+}
+
+static void
+test_index (void)
+{
+    MooCtagsIndex *index;
+    char *dir, *c_file, *py_file, *vcs_dir;
+    char *text, *result;
+    mgw_errno_t err;
+    GError *error = NULL;
+
+    dir = g_build_filename (moo_test_get_working_dir (), "ctags-work", NULL);
+    vcs_dir = g_build_filename (dir, ".git", NULL);
+    c_file = g_build_filename (dir, "point.c", NULL);
+    py_file = g_build_filename (dir, "shape.py", NULL);
+
+    if (_moo_mkdir_with_parents (vcs_dir, &err) != 0)
+    {
+        TEST_FAILED_MSG ("could not create directory '%s': %s",
+                         vcs_dir, mgw_strerror (err));
+        goto out;
+    }
+
+    TEST_ASSERT (g_file_set_contents (c_file, c_text, -1, NULL));
+    TEST_ASSERT (g_file_set_contents (py_file, python_text, -1, NULL));
+
+    /* indexes are created only on request */
+    TEST_ASSERT (_moo_ctags_index_get (c_file, FALSE) == NULL);
+
+    index = _moo_ctags_index_get (c_file, TRUE);
+    TEST_ASSERT (index != NULL);
+    if (!index)
+        goto out;
+    TEST_ASSERT (_moo_ctags_index_get (py_file, FALSE) == index);
+    TEST_ASSERT (index_wait (index));
+
+    result = index_find (index, "add");
+    TEST_ASSERT_STR_EQ (result, "add point.c 17\n");
+    g_free (result);
+    result = index_find (index, "Shape");
+    TEST_ASSERT_STR_EQ (result, "Shape shape.py 4\n");
+    g_free (result);
+    result = index_find (index, "missing");
+    TEST_ASSERT_STR_EQ (result, "");
+    g_free (result);
+
+    /* the changed file is parsed again, tags of the other one are
+     * copied from the previous tags file */
+    text = g_strdup (c_text);
+    memcpy (strstr (text, "add (int a"), "sub", 3);
+    TEST_ASSERT (g_file_set_contents (c_file, text, -1, NULL));
+    g_free (text);
+
+    _moo_ctags_index_file_changed (c_file);
+    TEST_ASSERT (index_wait (index));
+
+    result = index_find (index, "add");
+    TEST_ASSERT_STR_EQ (result, "");
+    g_free (result);
+    result = index_find (index, "sub");
+    TEST_ASSERT_STR_EQ (result, "sub point.c 17\n");
+    g_free (result);
+    result = index_find (index, "Shape");
+    TEST_ASSERT_STR_EQ (result, "Shape shape.py 4\n");
+    g_free (result);
+    result = index_find (index, "MAX_SIZE");
+    TEST_ASSERT_STR_EQ (result, "MAX_SIZE point.c 0\n");
+    g_free (result);
+
+    /* prefix matches go first, then matches with fewer gaps */
+    result = index_match (index, "poi", 10);
+    TEST_ASSERT_STR_EQ (result, "Point point.c 2\n_Point point.c 4\n");
+    g_free (result);
+    result = index_match (index, "AE", 10);
+    TEST_ASSERT_STR_EQ (result, "area shape.py 5\nMAX_SIZE point.c 0\nShape shape.py 4\n");
+    g_free (result);
+    result = index_match (index, "ae", 2);
+    TEST_ASSERT_STR_EQ (result, "area shape.py 5\nMAX_SIZE point.c 0\n");
+    g_free (result);
+    result = index_match (index, "tp", 10);
+    TEST_ASSERT_STR_EQ (result, "");
+    g_free (result);
+    result = index_match (index, "qz", 10);
+    TEST_ASSERT_STR_EQ (result, "");
+    g_free (result);
+
+out:
+    _moo_ctags_index_shutdown ();
+
+    if (!_moo_remove_dir (dir, TRUE, &error))
+    {
+        g_critical ("could not remove directory '%s': %s", dir, error->message);
+        g_error_free (error);
+    }
+
+    g_free (py_file);
+    g_free (c_file);
+    g_free (vcs_dir);
+    g_free (dir);
+}
+
+void
+moo_test_ctags (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("ctags", "plugins/ctags", NULL, NULL, NULL);
+
+    moo_test_suite_add_test (suite, "scan-c", "symbols in C code",
+                             (MooTestFunc) test_scan_c, NULL);
+    moo_test_suite_add_test (suite, "scan-python", "symbols in Python code",
+                             (MooTestFunc) test_scan_python, NULL);
+    moo_test_suite_add_test (suite, "scan-update", "rescanning changed lines",
+                             (MooTestFunc) test_scan_update, NULL);
+    moo_test_suite_add_test (suite, "index", "project tags and fuzzy search",
+                             (MooTestFunc) test_index, NULL);
+}
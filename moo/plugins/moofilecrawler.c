@@ -0,0 +1,397 @@
+/*
+ *   moofilecrawler.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Directory walking shared by the Quick Open file index and the ctags
+ * index. Directories are read by a pool of worker threads without any
+ * lock; what they found is then handed to the callbacks with the
+ * crawler lock held, so callbacks may use the caller's tables freely.
+ */
+
+#include "config.h"
+#include "plugins/moofilecrawler.h"
+#include <mooutils/moohistorylist.h>
+#include <string.h>
+
+#define MAX_WORKERS 8
+
+struct MooFileCrawler {
+    char *root;
+    GPatternSpec **skip_files;
+    GPatternSpec **skip_dirs;
+
+    MooFileCrawlerDirFunc dir_func;
+    MooFileCrawlerFileFunc file_func;
+    gpointer data;
+
+    /* protected by lock */
+    GMutex lock;
+    GCond done;
+    guint n_pending;
+    GThreadPool *pool;
+};
+
+
+char *
+_moo_file_crawler_find_root (const char *filename)
+{
+    static const char *markers[] = { ".git", ".hg", ".bzr", ".svn", "_darcs" };
+    char *dir;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    dir = g_path_get_dirname (filename);
+
+    while (TRUE)
+    {
+        char *parent;
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (markers); ++i)
+        {
+            char *path = g_build_filename (dir, markers[i], NULL);
+            gboolean found = g_file_test (path, G_FILE_TEST_EXISTS);
+            g_free (path);
+            if (found)
+                return dir;
+        }
+
+        parent = g_path_get_dirname (dir);
+
+        if (!strcmp (parent, dir))
+        {
+            g_free (parent);
+            g_free (dir);
+            return NULL;
+        }
+
+        g_free (dir);
+        dir = parent;
+    }
+}
+
+
+GPatternSpec **
+_moo_file_crawler_make_patterns (const char *string,
+                                 gboolean    dirs)
+{
+    char **globs, **p;
+    GPtrArray *patterns = g_ptr_array_new ();
+
+    globs = g_strsplit (string ? string : "", ";", 0);
+
+    for (p = globs; p && *p; ++p)
+    {
+        char *glob = g_strstrip (*p);
+        gsize len = strlen (glob);
+        gboolean is_dir = len > 0 && glob[len - 1] == '/';
+
+        if (!len)
+            continue;
+
+        /* like grep --exclude-dir, plain patterns apply to directories too */
+        if (is_dir && !dirs)
+            continue;
+
+        if (is_dir)
+            glob[len - 1] = 0;
+
+        g_ptr_array_add (patterns, g_pattern_spec_new (glob));
+    }
+
+    g_strfreev (globs);
+
+    if (!patterns->len)
+    {
+        g_ptr_array_free (patterns, TRUE);
+        return NULL;
+    }
+
+    g_ptr_array_add (patterns, NULL);
+    return (GPatternSpec**) g_ptr_array_free (patterns, FALSE);
+}
+
+void
+_moo_file_crawler_free_patterns (GPatternSpec **patterns)
+{
+    GPatternSpec **p;
+
+    for (p = patterns; p && *p; ++p)
+        g_pattern_spec_free (*p);
+
+    g_free (patterns);
+}
+
+gboolean
+_moo_file_crawler_match_any (GPatternSpec **patterns,
+                             const char    *name)
+{
+    for ( ; patterns && *patterns; ++patterns)
+        if (g_pattern_match_string (*patterns, name))
+            return TRUE;
+    return FALSE;
+}
+
+
+MooFileCrawler *
+_moo_file_crawler_new (const char             *root,
+                       MooFileCrawlerDirFunc   dir_func,
+                       MooFileCrawlerFileFunc  file_func,
+                       gpointer                data)
+{
+    MooFileCrawler *crawler;
+    char *skip;
+
+    g_return_val_if_fail (root != NULL, NULL);
+    g_return_val_if_fail (dir_func != NULL && file_func != NULL, NULL);
+
+    skip = moo_history_list_get_last_item (moo_history_list_get (MOO_FILE_CRAWLER_SKIP_LIST_ID));
+
+    crawler = g_slice_new0 (MooFileCrawler);
+    crawler->root = g_strdup (root);
+    crawler->skip_files = _moo_file_crawler_make_patterns (skip ? skip : MOO_FILE_CRAWLER_DEFAULT_SKIP, FALSE);
+    crawler->skip_dirs = _moo_file_crawler_make_patterns (skip ? skip : MOO_FILE_CRAWLER_DEFAULT_SKIP, TRUE);
+    crawler->dir_func = dir_func;
+    crawler->file_func = file_func;
+    crawler->data = data;
+    g_mutex_init (&crawler->lock);
+    g_cond_init (&crawler->done);
+
+    g_free (skip);
+    return crawler;
+}
+
+void
+_moo_file_crawler_free (MooFileCrawler *crawler)
+{
+    if (crawler)
+    {
+        g_return_if_fail (crawler->pool == NULL);
+
+        _moo_file_crawler_free_patterns (crawler->skip_files);
+        _moo_file_crawler_free_patterns (crawler->skip_dirs);
+        g_mutex_clear (&crawler->lock);
+        g_cond_clear (&crawler->done);
+        g_free (crawler->root);
+        g_slice_free (MooFileCrawler, crawler);
+    }
+}
+
+gboolean
+_moo_file_crawler_skip_file (MooFileCrawler *crawler,
+                             const char     *name)
+{
+    g_return_val_if_fail (crawler != NULL && name != NULL, TRUE);
+    return _moo_file_crawler_match_any (crawler->skip_files, name);
+}
+
+
+static char *
+child_path (const char *dir,
+            const char *name)
+{
+    return dir[0] ? g_strconcat (dir, G_DIR_SEPARATOR_S, name, NULL) : g_strdup (name);
+}
+
+/* lists a directory without the lock */
+static void
+read_dir (MooFileCrawler *crawler,
+          const char     *path,
+          GPtrArray      *files,
+          GArray         *bufs,
+          GPtrArray      *subdirs,
+          GArray         *subdir_bufs)
+{
+    char *dirname;
+    const char *name;
+    GDir *dir;
+
+    dirname = g_build_filename (crawler->root, path, NULL);
+
+    if (!(dir = g_dir_open (dirname, 0, NULL)))
+    {
+        g_free (dirname);
+        return;
+    }
+
+    while ((name = g_dir_read_name (dir)))
+    {
+        char *filename;
+        MgwStatBuf buf;
+        mgw_errno_t err;
+
+        /* indexes store paths one per line */
+        if (strchr (name, '\n'))
+            continue;
+
+        filename = g_build_filename (dirname, name, NULL);
+
+        /* symlinks are skipped, they may create loops */
+        if (mgw_lstat (filename, &buf, &err) == 0)
+        {
+            if (buf.isdir && !_moo_file_crawler_match_any (crawler->skip_dirs, name))
+            {
+                g_ptr_array_add (subdirs, child_path (path, name));
+                g_array_append_val (subdir_bufs, buf);
+            }
+            else if (buf.isreg && !_moo_file_crawler_match_any (crawler->skip_files, name))
+            {
+                g_ptr_array_add (files, child_path (path, name));
+                g_array_append_val (bufs, buf);
+            }
+        }
+
+        g_free (filename);
+    }
+
+    g_dir_close (dir);
+    g_free (dirname);
+}
+
+/* worker thread: reads a directory and queues its new subdirectories */
+static void
+crawl_dir (char           *path,
+           MooFileCrawler *crawler)
+{
+    GPtrArray *files = g_ptr_array_new ();
+    GArray *bufs = g_array_new (FALSE, FALSE, sizeof (MgwStatBuf));
+    GPtrArray *subdirs = g_ptr_array_new ();
+    GArray *subdir_bufs = g_array_new (FALSE, FALSE, sizeof (MgwStatBuf));
+    guint i;
+
+    read_dir (crawler, path, files, bufs, subdirs, subdir_bufs);
+
+    g_mutex_lock (&crawler->lock);
+
+    for (i = 0; i < files->len; ++i)
+        crawler->file_func (files->pdata[i], &g_array_index (bufs, MgwStatBuf, i), crawler->data);
+
+    for (i = 0; i < subdirs->len; ++i)
+    {
+        if (crawler->dir_func (subdirs->pdata[i], &g_array_index (subdir_bufs, MgwStatBuf, i),
+                               crawler->data))
+        {
+            crawler->n_pending += 1;
+            g_thread_pool_push (crawler->pool, subdirs->pdata[i], NULL);
+        }
+        else
+        {
+            g_free (subdirs->pdata[i]);
+        }
+    }
+
+    if (--crawler->n_pending == 0)
+        g_cond_signal (&crawler->done);
+
+    g_mutex_unlock (&crawler->lock);
+
+    g_ptr_array_foreach (files, (GFunc) g_free, NULL);
+    g_ptr_array_free (files, TRUE);
+    g_array_free (bufs, TRUE);
+    g_ptr_array_free (subdirs, TRUE);
+    g_array_free (subdir_bufs, TRUE);
+    g_free (path);
+}
+
+void
+_moo_file_crawler_run (MooFileCrawler *crawler,
+                       const char     *dir)
+{
+    guint n_workers = MAX_WORKERS;
+    char *dirname;
+    MgwStatBuf buf;
+    mgw_errno_t err;
+    gboolean have_buf;
+
+    g_return_if_fail (crawler != NULL && dir != NULL);
+    g_return_if_fail (crawler->pool == NULL);
+
+#if GLIB_CHECK_VERSION(2,36,0)
+    n_workers = CLAMP (g_get_num_processors (), 1, MAX_WORKERS);
+#endif
+
+    dirname = g_build_filename (crawler->root, dir, NULL);
+    have_buf = mgw_stat (dirname, &buf, &err) == 0;
+    g_free (dirname);
+
+    g_mutex_lock (&crawler->lock);
+
+    crawler->pool = g_thread_pool_new ((GFunc) crawl_dir, crawler, n_workers, FALSE, NULL);
+    crawler->n_pending = 1;
+
+    /* dir itself is read even if it's known already */
+    crawler->dir_func (dir, have_buf ? &buf : NULL, crawler->data);
+    g_thread_pool_push (crawler->pool, g_strdup (dir), NULL);
+
+    /* workers add more directories while they go, so wait for the
+     * counter rather than for the pool queue */
+    while (crawler->n_pending > 0)
+        g_cond_wait (&crawler->done, &crawler->lock);
+
+    g_mutex_unlock (&crawler->lock);
+
+    g_thread_pool_free (crawler->pool, FALSE, TRUE);
+    crawler->pool = NULL;
+}
+
+
+gpointer
+_moo_file_crawler_dir_stamp (const MgwStatBuf *buf)
+{
+    mgw_errno_t err;
+
+    if (!buf || buf->mtime.value >= mgw_time (NULL, &err).value - 1)
+        return NULL;
+
+    /* only compared for equality, so truncation doesn't matter */
+    return GSIZE_TO_POINTER ((gsize) buf->mtime.value);
+}
+
+GSList *
+_moo_file_crawler_find_changed (MooFileCrawler *crawler,
+                                GHashTable     *dirs)
+{
+    GSList *changed = NULL;
+    GHashTableIter iter;
+    gpointer path, stamp;
+
+    g_return_val_if_fail (crawler != NULL && dirs != NULL, NULL);
+
+    g_hash_table_iter_init (&iter, dirs);
+    while (g_hash_table_iter_next (&iter, &path, &stamp))
+    {
+        char *dirname;
+        MgwStatBuf buf;
+        mgw_errno_t err;
+
+        if (stamp)
+        {
+            dirname = g_build_filename (crawler->root, path, NULL);
+
+            if (mgw_stat (dirname, &buf, &err) == 0 && buf.isdir &&
+                GSIZE_TO_POINTER ((gsize) buf.mtime.value) == stamp)
+            {
+                g_free (dirname);
+                continue;
+            }
+
+            g_free (dirname);
+        }
+
+        changed = g_slist_prepend (changed, g_strdup (path));
+    }
+
+    return changed;
+}
@@ -0,0 +1,86 @@
+/*
+ *   moofilecrawler.h
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOO_FILE_CRAWLER_H
+#define MOO_FILE_CRAWLER_H
+
+#include <mooglib/moo-glib.h>
+#include <mooglib/moo-stat.h>
+
+G_BEGIN_DECLS
+
+/* skip list of the Find in Files dialog, used by project indexes too */
+#define MOO_FILE_CRAWLER_SKIP_LIST_ID   "FindPlugin/grep/skip"
+#define MOO_FILE_CRAWLER_DEFAULT_SKIP   ".svn/;.hg/;.git/;CVS/;*~;*.bak;*.orig;*.rej"
+
+typedef struct MooFileCrawler MooFileCrawler;
+
+/* Both are called in worker threads, one at a time. path is relative
+ * to the crawler root. dir_func is called for every directory which is
+ * about to be read and for every subdirectory found; it returns TRUE
+ * if the directory is new, only new subdirectories are read. buf is
+ * NULL if the directory could not be stat'ed. */
+typedef gboolean (*MooFileCrawlerDirFunc)  (const char       *path,
+                                            const MgwStatBuf *buf,
+                                            gpointer          data);
+typedef void     (*MooFileCrawlerFileFunc) (const char       *path,
+                                            const MgwStatBuf *buf,
+                                            gpointer          data);
+
+/* project directory containing filename, i.e. the closest parent
+ * directory under version control; NULL if there is none */
+char           *_moo_file_crawler_find_root     (const char             *filename);
+
+/* patterns from a ';'-separated list of globs; globs ending with '/'
+ * apply to directories only, others to both files and directories */
+GPatternSpec  **_moo_file_crawler_make_patterns (const char             *globs,
+                                                 gboolean                dirs);
+void            _moo_file_crawler_free_patterns (GPatternSpec          **patterns);
+gboolean        _moo_file_crawler_match_any     (GPatternSpec          **patterns,
+                                                 const char             *name);
+
+/* skip patterns are taken from the Find in Files skip list, so this
+ * must be called in the main thread */
+MooFileCrawler *_moo_file_crawler_new           (const char             *root,
+                                                 MooFileCrawlerDirFunc   dir_func,
+                                                 MooFileCrawlerFileFunc  file_func,
+                                                 gpointer                data);
+void            _moo_file_crawler_free          (MooFileCrawler         *crawler);
+
+/* TRUE if files named name are skipped */
+gboolean        _moo_file_crawler_skip_file     (MooFileCrawler         *crawler,
+                                                 const char             *name);
+
+/* reads directory dir, which is relative to the root, and new
+ * directories under it with a pool of threads; returns when everything
+ * is read */
+void            _moo_file_crawler_run           (MooFileCrawler         *crawler,
+                                                 const char             *dir);
+
+/* Directories are not watched, instead indexes keep a stamp of every
+ * directory they read and check them from time to time: modification
+ * time of a directory changes when entries are added, removed or renamed.
+ * The stamp is NULL for directories modified just now, since a change
+ * within the same second wouldn't show up. */
+gpointer        _moo_file_crawler_dir_stamp     (const MgwStatBuf       *buf);
+/* paths from dirs, a table of directories relative to the root and
+ * their stamps, which are gone or modified since they were read. It
+ * stats every directory, so it's meant for the job thread. */
+GSList         *_moo_file_crawler_find_changed  (MooFileCrawler         *crawler,
+                                                 GHashTable             *dirs);
+
+G_END_DECLS
+
+#endif /* MOO_FILE_CRAWLER_H */
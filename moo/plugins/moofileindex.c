@@ -0,0 +1,1117 @@
+/*
+ *   moofileindex.c
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Project file index for Quick Open.
+ *
+ * Paths of all files of a project, relative to the project root, are
+ * stored in a flat arena together with a lower case copy and a mask of
+ * characters of every path. Matching a pattern first scans the masks,
+ * which rejects most paths without touching the strings, then checks
+ * the remaining paths with memchr(). Candidates of the last pattern are
+ * kept, so that typing one more character only checks those.
+ *
+ * The list is saved in the user cache directory and used right away
+ * after a restart, while the tree is walked again. The tree is walked by
+ * a job running in a thread, which reads directories with a pool of
+ * worker threads; while the job is running it owns the file table, main
+ * thread keeps using the previous list. Directories are not watched: every
+ * CHECK_INTERVAL seconds, and whenever the index is requested again, a
+ * job stats the known directories and reads again the ones which changed.
+ */
+
+#include "config.h"
+#include "plugins/moofileindex.h"
+#include "plugins/moofilecrawler.h"
+#include <mooutils/mooutils-misc.h>
+#include <mooutils/mooutils-thread.h>
+#include <mooutils/mootrace.h>
+#include <string.h>
+
+#define DB_HEADER           "medit file index 1\n"
+
+#define UPDATE_DELAY        1000
+#define MAX_FILES           500000
+#define CHECK_INTERVAL      30
+
+/* immutable, shared by the index and the job which built it */
+typedef struct {
+    int ref_count;
+    guint n_files;
+    char *paths;            /* nul-terminated paths, one after another */
+    char *lower;            /* same, in ASCII lower case */
+    guint32 *offsets;       /* n_files + 1 offsets into paths */
+    guint16 *basenames;     /* offset of the basename within the path */
+    guint64 *masks;         /* char_mask() of every path */
+} FileList;
+
+typedef struct IndexJob IndexJob;
+
+typedef struct {
+    guint id;
+    MooFileIndexNotify func;
+    gpointer data;
+} Listener;
+
+struct _MooFileIndex {
+    char *root;
+    char *db_file;
+    FileList *list;
+
+    IndexJob *job;
+    GHashTable *files;          /* char* -> NULL, NULL while job is running */
+    GHashTable *dirs;           /* char* -> stamp, NULL while job is running */
+    guint update_timeout;
+    guint check_timeout;
+    guint update_again : 1;
+
+    GSList *listeners;
+    guint last_listener_id;
+
+    /* paths which matched the last pattern, to narrow the search
+     * while the pattern grows */
+    char *last_pattern;
+    FileList *last_list;
+    GArray *last_matches;
+};
+
+struct IndexJob {
+    MooFileIndex *index;        /* accessed in the main thread only */
+
+    char *root;
+    char *db_file;
+    MooFileCrawler *crawler;
+
+    gboolean load_db;
+    gboolean crawl;
+    GSList *pending_dirs;       /* changed directories */
+
+    /* periodic check, the index doesn't look busy and listeners are
+     * not notified unless something changed; main thread only */
+    gboolean quiet;
+
+    GHashTable *files;
+    GHashTable *dirs;
+    gboolean changed;
+    FileList *list;
+
+    /* paths found while a directory is read again */
+    GHashTable *seen;
+};
+
+typedef struct {
+    IndexJob *job;
+    FileList *list;
+    gboolean done;
+} IndexEvent;
+
+static GHashTable *indexes;     /* root -> MooFileIndex */
+
+static void     index_queue_update      (MooFileIndex   *index);
+static void     index_start_job         (MooFileIndex   *index,
+                                         gboolean        quiet);
+
+
+static const char *
+path_basename (const char *path)
+{
+    const char *slash = strrchr (path, G_DIR_SEPARATOR);
+    return slash ? slash + 1 : path;
+}
+
+static gboolean
+path_is_under (const char *path,
+               const char *dir)
+{
+    gsize len = strlen (dir);
+    return !dir[0] || (!strncmp (path, dir, len) &&
+                       (path[len] == 0 || path[len] == G_DIR_SEPARATOR));
+}
+
+/* TRUE if path is directly in dir */
+static gboolean
+path_is_child (const char *path,
+               const char *dir)
+{
+    const char *slash = strrchr (path, G_DIR_SEPARATOR);
+    gsize len = slash ? (gsize) (slash - path) : 0;
+    return path[0] && len == strlen (dir) && !strncmp (path, dir, len);
+}
+
+static GHashTable *
+path_set_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+
+/*************************************************************************/
+/* File list
+ */
+
+/* letters and digits get a bit each, other characters share the rest */
+static inline guint64
+char_mask (guchar c)
+{
+    if (c >= 'a' && c <= 'z')
+        return G_GUINT64_CONSTANT (1) << (c - 'a');
+    else if (c >= '0' && c <= '9')
+        return G_GUINT64_CONSTANT (1) << (26 + c - '0');
+    else
+        return G_GUINT64_CONSTANT (1) << (36 + c % 28);
+}
+
+static int
+compare_paths (const char **p1,
+               const char **p2)
+{
+    return strcmp (*p1, *p2);
+}
+
+static FileList *
+file_list_new (GHashTable *files)
+{
+    FileList *list;
+    GPtrArray *paths;
+    GHashTableIter iter;
+    gpointer key;
+    gsize size = 0;
+    guint i;
+
+    paths = g_ptr_array_sized_new (g_hash_table_size (files));
+    g_hash_table_iter_init (&iter, files);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        g_ptr_array_add (paths, key);
+        size += strlen (key) + 1;
+    }
+
+    /* sorted, so that equal scores come in a stable order */
+    g_ptr_array_sort (paths, (GCompareFunc) compare_paths);
+
+    list = g_slice_new0 (FileList);
+    list->ref_count = 1;
+    list->n_files = paths->len;
+    list->paths = g_new (char, size + 1);
+    list->lower = g_new (char, size + 1);
+    list->offsets = g_new (guint32, paths->len + 1);
+    list->basenames = g_new (guint16, paths->len);
+    list->masks = g_new (guint64, paths->len);
+
+    for (i = 0, size = 0; i < paths->len; ++i)
+    {
+        const char *path = paths->pdata[i];
+        gsize len = strlen (path);
+        guint64 mask = 0;
+        gsize j;
+
+        list->offsets[i] = size;
+        list->basenames[i] = path_basename (path) - path;
+        memcpy (list->paths + size, path, len + 1);
+
+        for (j = 0; j < len; ++j)
+        {
+            char c = g_ascii_tolower (path[j]);
+            list->lower[size + j] = c;
+            mask |= char_mask (c);
+        }
+
+        list->lower[size + len] = 0;
+
+        list->masks[i] = mask;
+        size += len + 1;
+    }
+
+    list->offsets[i] = size;
+    list->paths[size] = 0;
+    list->lower[size] = 0;
+
+    g_ptr_array_free (paths, TRUE);
+    return list;
+}
+
+static FileList *
+file_list_ref (FileList *list)
+{
+    if (list)
+        g_atomic_int_inc (&list->ref_count);
+    return list;
+}
+
+static void
+file_list_unref (FileList *list)
+{
+    if (list && g_atomic_int_dec_and_test (&list->ref_count))
+    {
+        g_free (list->paths);
+        g_free (list->lower);
+        g_free (list->offsets);
+        g_free (list->basenames);
+        g_free (list->masks);
+        g_slice_free (FileList, list);
+    }
+}
+
+
+/*************************************************************************/
+/* Job
+ */
+
+static void
+index_job_free (IndexJob *job)
+{
+    if (!job)
+        return;
+
+    _moo_file_crawler_free (job->crawler);
+
+    g_slist_foreach (job->pending_dirs, (GFunc) g_free, NULL);
+    g_slist_free (job->pending_dirs);
+
+    if (job->files)
+        g_hash_table_destroy (job->files);
+    if (job->dirs)
+        g_hash_table_destroy (job->dirs);
+    file_list_unref (job->list);
+
+    g_free (job->root);
+    g_free (job->db_file);
+    g_slice_free (IndexJob, job);
+}
+
+static void
+index_event_free (IndexEvent *event)
+{
+    if (event->done)
+        index_job_free (event->job);
+    file_list_unref (event->list);
+    g_slice_free (IndexEvent, event);
+}
+
+static guint
+get_update_event_id (void);
+
+static void
+push_event (IndexJob *job,
+            FileList *list,
+            gboolean  done)
+{
+    IndexEvent *event = g_slice_new (IndexEvent);
+    event->job = job;
+    event->list = file_list_ref (list);
+    event->done = done;
+    _moo_event_queue_push (get_update_event_id (), event,
+                           (GDestroyNotify) index_event_free);
+}
+
+static GHashTable *
+load_db (IndexJob *job)
+{
+    char *contents;
+    char *line, *next;
+    GHashTable *files;
+
+    if (!g_file_get_contents (job->db_file, &contents, NULL, NULL))
+        return NULL;
+
+    if (!g_str_has_prefix (contents, DB_HEADER))
+    {
+        g_free (contents);
+        return NULL;
+    }
+
+    files = path_set_new ();
+
+    for (line = contents + strlen (DB_HEADER); line && *line; line = next)
+    {
+        if ((next = strchr (line, '\n')))
+            *next++ = 0;
+
+        if (*line)
+            g_hash_table_insert (files, g_strdup (line), NULL);
+    }
+
+    g_free (contents);
+    return files;
+}
+
+static gboolean
+write_db (IndexJob *job)
+{
+    GString *out;
+    GError *error = NULL;
+    gboolean retval;
+    guint i;
+
+    out = g_string_sized_new (job->list->offsets[job->list->n_files] + strlen (DB_HEADER));
+    g_string_append (out, DB_HEADER);
+
+    for (i = 0; i < job->list->n_files; ++i)
+    {
+        g_string_append (out, job->list->paths + job->list->offsets[i]);
+        g_string_append_c (out, '\n');
+    }
+
+    if (!(retval = g_file_set_contents (job->db_file, out->str, out->len, &error)))
+    {
+        g_warning ("could not write file index: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (out, TRUE);
+    return retval;
+}
+
+/* crawler callbacks, called with the crawler lock held */
+static gboolean
+job_add_dir (const char       *path,
+             const MgwStatBuf *buf,
+             IndexJob         *job)
+{
+    if (job->seen)
+        g_hash_table_insert (job->seen, g_strdup (path), NULL);
+
+    if (g_hash_table_lookup_extended (job->dirs, path, NULL, NULL))
+        return FALSE;
+
+    g_hash_table_insert (job->dirs, g_strdup (path), _moo_file_crawler_dir_stamp (buf));
+    return TRUE;
+}
+
+static void
+job_add_file (const char                     *path,
+              G_GNUC_UNUSED const MgwStatBuf *buf,
+              IndexJob                       *job)
+{
+    if (job->seen)
+        g_hash_table_insert (job->seen, g_strdup (path), NULL);
+
+    if (g_hash_table_size (job->files) < MAX_FILES &&
+        !g_hash_table_lookup_extended (job->files, path, NULL, NULL))
+    {
+        g_hash_table_insert (job->files, g_strdup (path), NULL);
+        job->changed = TRUE;
+    }
+}
+
+typedef struct {
+    IndexJob *job;
+    const char *dir;
+    GHashTable *seen;
+} RemoveData;
+
+static gboolean
+remove_path_under (const char *path,
+                   G_GNUC_UNUSED gpointer value,
+                   RemoveData *data)
+{
+    if (!path_is_under (path, data->dir))
+        return FALSE;
+    data->job->changed = TRUE;
+    return TRUE;
+}
+
+static gboolean
+remove_unseen_child (const char *path,
+                     G_GNUC_UNUSED gpointer value,
+                     RemoveData *data)
+{
+    if (!path_is_child (path, data->dir) ||
+        g_hash_table_lookup_extended (data->seen, path, NULL, NULL))
+        return FALSE;
+    data->job->changed = TRUE;
+    return TRUE;
+}
+
+/* reads a directory again, and subdirectories which appeared */
+static void
+rescan_dir (IndexJob   *job,
+            const char *path)
+{
+    RemoveData data;
+    GHashTableIter iter;
+    gpointer key;
+    GSList *gone = NULL, *l;
+    char *dirname;
+    MgwStatBuf buf;
+    mgw_errno_t err;
+
+    data.job = job;
+    data.dir = path;
+
+    dirname = g_build_filename (job->root, path, NULL);
+
+    if (mgw_stat (dirname, &buf, &err) != 0 || !buf.isdir)
+    {
+        g_hash_table_foreach_remove (job->files, (GHRFunc) remove_path_under, &data);
+        g_hash_table_foreach_remove (job->dirs, (GHRFunc) remove_path_under, &data);
+        g_free (dirname);
+        return;
+    }
+
+    /* stamp is taken before reading, so that changes made meanwhile
+     * are seen by the next check */
+    g_hash_table_insert (job->dirs, g_strdup (path), _moo_file_crawler_dir_stamp (&buf));
+
+    data.seen = job->seen = path_set_new ();
+    _moo_file_crawler_run (job->crawler, path);
+    job->seen = NULL;
+
+    g_hash_table_foreach_remove (job->files, (GHRFunc) remove_unseen_child, &data);
+
+    /* subdirectories which are gone, with everything under them */
+    g_hash_table_iter_init (&iter, job->dirs);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+        if (path_is_child (key, path) && !g_hash_table_lookup_extended (data.seen, key, NULL, NULL))
+            gone = g_slist_prepend (gone, g_strdup (key));
+
+    for (l = gone; l != NULL; l = l->next)
+    {
+        data.dir = l->data;
+        g_hash_table_foreach_remove (job->files, (GHRFunc) remove_path_under, &data);
+        g_hash_table_foreach_remove (job->dirs, (GHRFunc) remove_path_under, &data);
+    }
+
+    g_slist_foreach (gone, (GFunc) g_free, NULL);
+    g_slist_free (gone);
+    g_hash_table_destroy (data.seen);
+    g_free (dirname);
+}
+
+static gboolean
+same_paths (GHashTable *set1,
+            GHashTable *set2)
+{
+    GHashTableIter iter;
+    gpointer key;
+
+    if (g_hash_table_size (set1) != g_hash_table_size (set2))
+        return FALSE;
+
+    g_hash_table_iter_init (&iter, set1);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+        if (!g_hash_table_lookup_extended (set2, key, NULL, NULL))
+            return FALSE;
+
+    return TRUE;
+}
+
+/* runs in a thread */
+static gboolean
+index_job_run (IndexJob *job)
+{
+    GHashTable *saved = NULL;
+    GSList *l;
+
+    MOO_TRACE_BEGIN_DETAIL ("file index update", job->root);
+
+    if (job->load_db && (saved = load_db (job)))
+    {
+        /* usable until the tree is walked */
+        FileList *list = file_list_new (saved);
+        push_event (job, list, FALSE);
+        file_list_unref (list);
+    }
+
+    if (job->crawl)
+    {
+        _moo_file_crawler_run (job->crawler, "");
+    }
+    else
+    {
+        job->pending_dirs = _moo_file_crawler_find_changed (job->crawler, job->dirs);
+        for (l = job->pending_dirs; l != NULL; l = l->next)
+            rescan_dir (job, l->data);
+    }
+
+    MOO_TRACE_COUNTER ("file index files", g_hash_table_size (job->files));
+
+    if (saved)
+    {
+        job->changed = !same_paths (saved, job->files);
+        g_hash_table_destroy (saved);
+    }
+    else if (job->load_db)
+    {
+        job->changed = TRUE;
+    }
+
+    if (job->changed)
+    {
+        job->list = file_list_new (job->files);
+        write_db (job);
+    }
+
+    MOO_TRACE_END ("file index update");
+
+    push_event (job, job->list, TRUE);
+    return FALSE;
+}
+
+
+/*************************************************************************/
+/* Index
+ */
+
+static void
+index_set_list (MooFileIndex *index,
+                FileList     *list)
+{
+    FileList *old = index->list;
+    GSList *l;
+
+    index->list = file_list_ref (list);
+    file_list_unref (old);
+
+    for (l = index->listeners; l != NULL; )
+    {
+        Listener *listener = l->data;
+        l = l->next;
+        listener->func (index, listener->data);
+    }
+}
+
+/* main thread */
+static void
+index_events (GList *events)
+{
+    for ( ; events != NULL; events = events->next)
+    {
+        IndexEvent *event = events->data;
+        IndexJob *job = event->job;
+        MooFileIndex *index = job->index;
+
+        if (!index)
+            continue;
+
+        g_assert (index->job == job);
+
+        if (!event->done)
+        {
+            index_set_list (index, event->list);
+            continue;
+        }
+
+        index->job = NULL;
+        index->files = job->files;
+        index->dirs = job->dirs;
+        job->files = NULL;
+        job->dirs = NULL;
+
+        if (event->list)
+            index_set_list (index, event->list);
+        else if (!job->quiet)
+            /* nothing changed, but listeners may want to know the
+             * index is not busy anymore */
+            index_set_list (index, index->list);
+
+        if (index->update_again)
+        {
+            index->update_again = FALSE;
+            index_queue_update (index);
+        }
+    }
+}
+
+static guint
+get_update_event_id (void)
+{
+    static guint event_id;
+
+    if (!event_id)
+        event_id = _moo_event_queue_connect ((MooEventQueueCallback) index_events,
+                                             NULL, NULL);
+
+    return event_id;
+}
+
+static void
+index_start_job (MooFileIndex *index,
+                 gboolean      quiet)
+{
+    IndexJob *job;
+    MooAsyncJob *async_job;
+
+    g_return_if_fail (index->job == NULL);
+
+    job = g_slice_new0 (IndexJob);
+    job->index = index;
+    job->root = g_strdup (index->root);
+    job->db_file = g_strdup (index->db_file);
+    job->crawler = _moo_file_crawler_new (job->root,
+                                          (MooFileCrawlerDirFunc) job_add_dir,
+                                          (MooFileCrawlerFileFunc) job_add_file,
+                                          job);
+
+    /* first run: read the saved list and walk the whole tree; later
+     * only changed directories are read */
+    job->load_db = !index->files;
+    job->crawl = !index->files;
+    job->files = index->files ? index->files : path_set_new ();
+    job->dirs = index->dirs ? index->dirs : path_set_new ();
+    index->files = NULL;
+    index->dirs = NULL;
+
+    job->quiet = quiet;
+    index->job = job;
+
+    get_update_event_id ();
+    async_job = moo_async_job_new ((MooAsyncJobCallback) index_job_run, job, NULL);
+    moo_async_job_start (async_job);
+    g_object_unref (async_job);
+}
+
+static gboolean
+index_update_timeout (MooFileIndex *index)
+{
+    index->update_timeout = 0;
+
+    if (index->job)
+        index->update_again = TRUE;
+    else
+        index_start_job (index, TRUE);
+
+    return FALSE;
+}
+
+static void
+index_queue_update (MooFileIndex *index)
+{
+    if (!index->update_timeout)
+        index->update_timeout =
+            g_timeout_add_full (G_PRIORITY_LOW, UPDATE_DELAY,
+                                (GSourceFunc) index_update_timeout,
+                                index, NULL);
+}
+
+/* the list is about to be used: directories are checked right away,
+ * and listeners are notified when it's done */
+static void
+index_update_now (MooFileIndex *index)
+{
+    if (index->update_timeout)
+    {
+        g_source_remove (index->update_timeout);
+        index->update_timeout = 0;
+    }
+
+    if (index->job)
+    {
+        index->job->quiet = FALSE;
+        index->update_again = TRUE;
+    }
+    else
+    {
+        index_start_job (index, FALSE);
+    }
+}
+
+static gboolean
+index_check_timeout (MooFileIndex *index)
+{
+    index_queue_update (index);
+    return TRUE;
+}
+
+static MooFileIndex *
+index_new (const char *root)
+{
+    MooFileIndex *index;
+    char *cache_dir, *db_dir, *basename, *checksum;
+    mgw_errno_t err;
+
+    index = g_slice_new0 (MooFileIndex);
+    index->root = g_strdup (root);
+
+    cache_dir = moo_get_user_cache_dir ();
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, root, -1);
+    basename = g_strdup_printf ("files-%s", checksum);
+    db_dir = g_build_filename (cache_dir, "quickopen", NULL);
+    index->db_file = g_build_filename (db_dir, basename, NULL);
+    mgw_mkdir_with_parents (db_dir, 0755, &err);
+    g_free (db_dir);
+    g_free (basename);
+    g_free (checksum);
+    g_free (cache_dir);
+
+    index_start_job (index, FALSE);
+
+    index->check_timeout =
+        g_timeout_add_seconds_full (G_PRIORITY_LOW, CHECK_INTERVAL,
+                                    (GSourceFunc) index_check_timeout,
+                                    index, NULL);
+    return index;
+}
+
+static void
+index_free (MooFileIndex *index)
+{
+    if (index->job)
+        index->job->index = NULL;
+
+    if (index->update_timeout)
+        g_source_remove (index->update_timeout);
+    if (index->check_timeout)
+        g_source_remove (index->check_timeout);
+
+    if (index->files)
+        g_hash_table_destroy (index->files);
+    if (index->dirs)
+        g_hash_table_destroy (index->dirs);
+
+    g_slist_foreach (index->listeners, (GFunc) g_free, NULL);
+    g_slist_free (index->listeners);
+
+    g_free (index->last_pattern);
+    file_list_unref (index->last_list);
+    if (index->last_matches)
+        g_array_free (index->last_matches, TRUE);
+
+    file_list_unref (index->list);
+    g_free (index->db_file);
+    g_free (index->root);
+    g_slice_free (MooFileIndex, index);
+}
+
+
+/*************************************************************************/
+/* Matching
+ */
+
+/* the mask scan has no branches, so that compilers can vectorize it */
+static guint
+filter_masks (const guint64 *masks,
+              guint          n_masks,
+              guint64        mask,
+              guint32       *out)
+{
+    guint n_out = 0;
+    guint i;
+
+    for (i = 0; i < n_masks; ++i)
+    {
+        out[n_out] = i;
+        n_out += (masks[i] & mask) == mask;
+    }
+
+    return n_out;
+}
+
+static gboolean
+is_subsequence (const char *string,
+                const char *end,
+                const char *pattern)
+{
+    for ( ; *pattern; ++pattern)
+    {
+        const char *p = (const char*) memchr (string, *pattern, end - string);
+        if (!p)
+            return FALSE;
+        string = p + 1;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+is_word_start (const char *path,
+               guint       i)
+{
+    char prev;
+
+    if (i == 0)
+        return TRUE;
+
+    prev = path[i - 1];
+    return prev == G_DIR_SEPARATOR || prev == '_' || prev == '-' ||
+           prev == '.' || prev == ' ' ||
+           (g_ascii_isupper (path[i]) && g_ascii_islower (prev));
+}
+
+/* higher is better: matches within the file name beat matches in the
+ * directory part, characters at word starts and right after the
+ * previous matched character count more, long paths lose a little */
+static int
+score_path (const FileList *list,
+            guint           n,
+            const char     *pattern,
+            gsize           pattern_len)
+{
+    const char *path = list->paths + list->offsets[n];
+    const char *lower = list->lower + list->offsets[n];
+    guint len = list->offsets[n + 1] - list->offsets[n] - 1;
+    guint base = list->basenames[n];
+    int score = 0, prev = -2;
+    guint i = 0;
+    const char *p;
+
+    if (is_subsequence (lower + base, lower + len, pattern))
+    {
+        i = base;
+        score += 100;
+
+        if (!strncmp (lower + base, pattern, pattern_len))
+            score += len - base == pattern_len ? 100 : 50;
+    }
+
+    for (p = pattern; *p; ++p)
+    {
+        while (lower[i] != *p)
+            i++;
+
+        if ((int) i == prev + 1)
+            score += 8;
+        else if (prev >= 0)
+            score -= MIN ((int) i - prev - 1, 8);
+
+        if (is_word_start (path, i))
+            score += 10;
+
+        prev = i++;
+    }
+
+    return score - (int) len / 8;
+}
+
+typedef struct {
+    int score;
+    guint32 n;
+} Match;
+
+static char *
+normalize_pattern (const char *pattern)
+{
+    char *lower = g_ascii_strdown (pattern, -1);
+    char *p, *q;
+
+    /* spaces only separate parts of the pattern */
+    for (p = q = lower; *p; ++p)
+        if (*p != ' ' && *p != '\t')
+            *q++ = *p;
+    *q = 0;
+
+#ifdef __WIN32__
+    for (p = lower; *p; ++p)
+        if (*p == '/')
+            *p = G_DIR_SEPARATOR;
+#endif
+
+    return lower;
+}
+
+char **
+_moo_file_index_match (MooFileIndex *index,
+                       const char   *pattern,
+                       guint         max_results)
+{
+    FileList *list;
+    char *lower;
+    gsize pattern_len;
+    guint64 mask = 0;
+    guint32 *candidates;
+    guint n_candidates;
+    GArray *matched;
+    Match *best;
+    guint n_best = 0;
+    char **result;
+    guint i;
+
+    g_return_val_if_fail (index != NULL, NULL);
+    g_return_val_if_fail (pattern != NULL, NULL);
+
+    lower = normalize_pattern (pattern);
+    pattern_len = strlen (lower);
+    list = index->list;
+
+    if (!list || !pattern_len || !max_results)
+    {
+        g_free (lower);
+        return g_new0 (char*, 1);
+    }
+
+    MOO_TRACE_BEGIN ("file index match");
+
+    for (i = 0; i < pattern_len; ++i)
+        mask |= char_mask (lower[i]);
+
+    /* a path which matches the pattern matches every prefix of it */
+    if (index->last_list == list && g_str_has_prefix (lower, index->last_pattern))
+    {
+        GArray *last = index->last_matches;
+        candidates = g_new (guint32, last->len);
+        for (i = 0, n_candidates = 0; i < last->len; ++i)
+        {
+            guint32 n = g_array_index (last, guint32, i);
+            candidates[n_candidates] = n;
+            n_candidates += (list->masks[n] & mask) == mask;
+        }
+    }
+    else
+    {
+        candidates = g_new (guint32, list->n_files);
+        n_candidates = filter_masks (list->masks, list->n_files, mask, candidates);
+    }
+
+    matched = g_array_new (FALSE, FALSE, sizeof (guint32));
+    best = g_new (Match, max_results);
+
+    for (i = 0; i < n_candidates; ++i)
+    {
+        guint32 n = candidates[i];
+        const char *start = list->lower + list->offsets[n];
+        const char *end = list->lower + list->offsets[n + 1] - 1;
+        int score;
+        guint pos;
+
+        if (!is_subsequence (start, end, lower))
+            continue;
+
+        g_array_append_val (matched, n);
+        score = score_path (list, n, lower, pattern_len);
+
+        if (n_best == max_results && score <= best[n_best - 1].score)
+            continue;
+
+        /* keep matches sorted by score */
+        pos = n_best < max_results ? n_best++ : n_best - 1;
+        while (pos > 0 && best[pos - 1].score < score)
+        {
+            best[pos] = best[pos - 1];
+            pos--;
+        }
+
+        best[pos].score = score;
+        best[pos].n = n;
+    }
+
+    result = g_new (char*, n_best + 1);
+    for (i = 0; i < n_best; ++i)
+        result[i] = g_strdup (list->paths + list->offsets[best[i].n]);
+    result[n_best] = NULL;
+
+    g_free (index->last_pattern);
+    file_list_unref (index->last_list);
+    if (index->last_matches)
+        g_array_free (index->last_matches, TRUE);
+    index->last_pattern = lower;
+    index->last_list = file_list_ref (list);
+    index->last_matches = matched;
+
+    MOO_TRACE_COUNTER ("file index candidates", n_candidates);
+    MOO_TRACE_END ("file index match");
+
+    g_free (best);
+    g_free (candidates);
+    return result;
+}
+
+
+/*************************************************************************/
+/* Public API
+ */
+
+MooFileIndex *
+_moo_file_index_get (const char *root)
+{
+    MooFileIndex *index;
+
+    g_return_val_if_fail (root != NULL, NULL);
+
+    if (!indexes)
+        indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify) index_free);
+
+    if (!(index = g_hash_table_lookup (indexes, root)))
+    {
+        index = index_new (root);
+        g_hash_table_insert (indexes, g_strdup (root), index);
+    }
+    else
+    {
+        /* don't wait for the timer, the list is about to be used */
+        index_update_now (index);
+    }
+
+    return index;
+}
+
+void
+_moo_file_index_shutdown (void)
+{
+    if (indexes)
+        g_hash_table_destroy (indexes);
+    indexes = NULL;
+}
+
+const char *
+_moo_file_index_get_root (MooFileIndex *index)
+{
+    g_return_val_if_fail (index != NULL, NULL);
+    return index->root;
+}
+
+guint
+_moo_file_index_get_n_files (MooFileIndex *index)
+{
+    g_return_val_if_fail (index != NULL, 0);
+    return index->list ? index->list->n_files : 0;
+}
+
+gboolean
+_moo_file_index_is_busy (MooFileIndex *index)
+{
+    g_return_val_if_fail (index != NULL, FALSE);
+    return index->job != NULL && !index->job->quiet;
+}
+
+guint
+_moo_file_index_connect (MooFileIndex       *index,
+                         MooFileIndexNotify  func,
+                         gpointer            data)
+{
+    Listener *listener;
+
+    g_return_val_if_fail (index != NULL, 0);
+    g_return_val_if_fail (func != NULL, 0);
+
+    listener = g_new (Listener, 1);
+    listener->id = ++index->last_listener_id;
+    listener->func = func;
+    listener->data = data;
+    index->listeners = g_slist_append (index->listeners, listener);
+
+    return listener->id;
+}
+
+void
+_moo_file_index_disconnect (MooFileIndex *index,
+                            guint         id)
+{
+    GSList *l;
+
+    g_return_if_fail (index != NULL);
+
+    for (l = index->listeners; l != NULL; l = l->next)
+    {
+        Listener *listener = l->data;
+
+        if (listener->id == id)
+        {
+            index->listeners = g_slist_delete_link (index->listeners, l);
+            g_free (listener);
+            return;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ *   moofileindex.h
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOO_FILE_INDEX_H
+#define MOO_FILE_INDEX_H
+
+#include <mooglib/moo-glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MooFileIndex MooFileIndex;
+
+typedef void (*MooFileIndexNotify) (MooFileIndex *index,
+                                    gpointer      data);
+
+/* index of files under root; it's created and built in background
+ * if needed, an existing one checks its directories for changes */
+MooFileIndex   *_moo_file_index_get             (const char         *root);
+void            _moo_file_index_shutdown        (void);
+
+const char     *_moo_file_index_get_root        (MooFileIndex       *index);
+guint           _moo_file_index_get_n_files     (MooFileIndex       *index);
+/* TRUE while the tree is being walked, or checked for changes after
+ * the index was requested again */
+gboolean        _moo_file_index_is_busy         (MooFileIndex       *index);
+
+/* func is called in the main thread whenever the list of files changes */
+guint           _moo_file_index_connect         (MooFileIndex       *index,
+                                                 MooFileIndexNotify  func,
+                                                 gpointer            data);
+void            _moo_file_index_disconnect      (MooFileIndex       *index,
+                                                 guint               id);
+
+/* paths relative to the root which fuzzy match pattern, best first */
+char          **_moo_file_index_match           (MooFileIndex       *index,
+                                                 const char         *pattern,
+                                                 guint               max_results);
+
+G_END_DECLS
+
+#endif /* MOO_FILE_INDEX_H */
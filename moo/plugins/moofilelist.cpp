@@ -57,7 +57,7 @@ typedef struct FileListWindowPlugin FileListWindowPlugin;
 
 enum {
     COLUMN_ITEM,
-    COLUMN_TOOLTIP
+    N_COLUMNS
 };
 
 typedef enum {
@@ -73,6 +73,7 @@ struct Item {
 struct File {
     Item base;
     char *uri;
+    /* computed from uri when first needed */
     char *display_basename;
     char *display_name;
     MooEdit *doc;
@@ -87,6 +88,9 @@ typedef struct {
     GtkTreeStore base;
     int n_user_items;
     GSList *docs;
+    /* uri -> GtkTreeIter of the row with that file; tree store
+     * iters stay valid until the row is removed */
+    GHashTable *uri_rows;
     FileListWindowPlugin *plugin;
 } FileList;
 
@@ -187,21 +191,23 @@ file_list_drag_dest_iface_init (GtkTreeDragDestIface *iface)
 static void
 file_list_init (FileList *list)
 {
-    GType types[2];
+    GType types[N_COLUMNS];
 
     types[COLUMN_ITEM] = item_get_type ();
-    types[COLUMN_TOOLTIP] = G_TYPE_STRING;
 
-    gtk_tree_store_set_column_types (GTK_TREE_STORE (list), 2, types);
+    gtk_tree_store_set_column_types (GTK_TREE_STORE (list), N_COLUMNS, types);
 
     list->n_user_items = 0;
     list->docs = nullptr;
+    list->uri_rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify) gtk_tree_iter_free);
 }
 
 static void
 file_list_finalize (GObject *object)
 {
     DEBUG_ASSERT (!FILE_LIST (object)->docs);
+    g_hash_table_destroy (FILE_LIST (object)->uri_rows);
     G_OBJECT_CLASS (file_list_parent_class)->finalize (object);
 }
 
@@ -282,18 +288,6 @@ file_get_uri (File *file)
         return gstr::take(moo_edit_get_uri (file->doc));
 }
 
-static void
-file_update (File *file)
-{
-    if (!file->uri && file->doc)
-    {
-        g_free (file->display_name);
-        g_free (file->display_basename);
-        file->display_name = g_strdup (moo_edit_get_display_name (file->doc));
-        file->display_basename = g_strdup (moo_edit_get_display_basename (file->doc));
-    }
-}
-
 static void
 file_set_doc (File    *file,
               MooEdit *doc)
@@ -304,7 +298,6 @@ file_set_doc (File    *file,
         g_object_unref (file->doc);
 
     file->doc = doc;
-    file_update (file);
 }
 
 static File *
@@ -341,7 +334,6 @@ file_set_uri (File       *file,
               const char *uri)
 {
     char *tmp;
-    char *filename;
 
     g_return_if_fail (file != nullptr);
     g_return_if_fail (uri != nullptr);
@@ -352,8 +344,21 @@ file_set_uri (File       *file,
 
     g_free (file->display_name);
     g_free (file->display_basename);
+    file->display_name = nullptr;
+    file->display_basename = nullptr;
+}
 
-    filename = g_filename_from_uri (uri, nullptr, nullptr);
+/* names are only needed for the rows which are shown, so they
+ * are not computed when a list with many files is loaded */
+static void
+file_ensure_display_names (File *file)
+{
+    char *filename;
+
+    if (file->display_name)
+        return;
+
+    filename = g_filename_from_uri (file->uri, nullptr, nullptr);
 
     if (filename)
     {
@@ -362,13 +367,49 @@ file_set_uri (File       *file,
     }
     else
     {
-        file->display_name = g_strdup (uri);
-        file->display_basename = uri_get_basename (uri);
+        file->display_name = g_strdup (file->uri);
+        file->display_basename = uri_get_basename (file->uri);
     }
 
     g_free (filename);
 }
 
+static const char *
+file_get_display_name (File *file)
+{
+    if (file->uri)
+    {
+        file_ensure_display_names (file);
+        return file->display_name;
+    }
+    else if (file->doc)
+    {
+        return moo_edit_get_display_name (file->doc);
+    }
+    else
+    {
+        return nullptr;
+    }
+}
+
+static const char *
+file_get_display_basename (File *file)
+{
+    if (file->uri)
+    {
+        file_ensure_display_names (file);
+        return file->display_basename;
+    }
+    else if (file->doc)
+    {
+        return moo_edit_get_display_basename (file->doc);
+    }
+    else
+    {
+        return nullptr;
+    }
+}
+
 static Item *
 file_new_uri (const char *uri)
 {
@@ -396,15 +437,6 @@ file_free (File *file)
     }
 }
 
-static const char *
-item_get_tooltip (Item *item)
-{
-    if (ITEM_IS_FILE (item))
-        return FILE_ITEM (item)->display_name;
-    else
-        return nullptr;
-}
-
 static Item *
 item_ref (Item *item)
 {
@@ -482,36 +514,42 @@ check_list (G_GNUC_UNUSED FileList *list)
 }
 
 
-static gboolean
-iter_find_uri (FileList     *list,
-               const char   *uri,
-               GtkTreeIter  *parent,
-               GtkTreeIter  *dest)
+static void
+file_list_index_row (FileList    *list,
+                     GtkTreeIter *iter,
+                     Item        *item)
 {
-    GtkTreeIter iter;
+    if (ITEM_IS_FILE (item) && FILE_ITEM (item)->uri)
+        g_hash_table_insert (list->uri_rows,
+                             g_strdup (FILE_ITEM (item)->uri),
+                             gtk_tree_iter_copy (iter));
+}
 
-    if (parent)
+/* called before the row and its children are removed */
+static void
+file_list_unindex_rows (FileList    *list,
+                        GtkTreeIter *iter)
+{
+    Item *item;
+    GtkTreeIter child;
+
+    item = get_item_at_iter (list, iter);
+
+    if (ITEM_IS_FILE (item) && FILE_ITEM (item)->uri)
     {
-        Item *item = get_item_at_iter (list, parent);
+        GtkTreeIter *row = (GtkTreeIter*) g_hash_table_lookup (list->uri_rows, FILE_ITEM (item)->uri);
 
-        if (ITEM_IS_FILE (item) &&
-            FILE_ITEM (item)->uri &&
-            strcmp (FILE_ITEM (item)->uri, uri) == 0)
-        {
-            *dest = *parent;
-            return TRUE;
-        }
+        /* the same item may be in a copied row too, see move_row() */
+        if (row && row->user_data == iter->user_data)
+            g_hash_table_remove (list->uri_rows, FILE_ITEM (item)->uri);
     }
 
-    if (gtk_tree_model_iter_children (GTK_TREE_MODEL (list), &iter, parent))
+    if (gtk_tree_model_iter_children (GTK_TREE_MODEL (list), &child, iter))
         do
         {
-            if (iter_find_uri (list, uri, &iter, dest))
-                return TRUE;
+            file_list_unindex_rows (list, &child);
         }
-        while (gtk_tree_model_iter_next (GTK_TREE_MODEL (list), &iter));
-
-    return FALSE;
+        while (gtk_tree_model_iter_next (GTK_TREE_MODEL (list), &child));
 }
 
 static gboolean
@@ -519,7 +557,13 @@ file_list_find_uri (FileList    *list,
                     const char  *uri,
                     GtkTreeIter *iter)
 {
-    return iter_find_uri (list, uri, nullptr, iter);
+    GtkTreeIter *row = (GtkTreeIter*) g_hash_table_lookup (list->uri_rows, uri);
+
+    if (!row)
+        return FALSE;
+
+    *iter = *row;
+    return TRUE;
 }
 
 
@@ -538,6 +582,7 @@ file_list_remove_row (FileList    *list,
         last_user_item = list->n_user_items == 0;
     }
 
+    file_list_unindex_rows (list, iter);
     gtk_tree_store_remove (GTK_TREE_STORE (list), iter);
 
     if (last_user_item)
@@ -555,11 +600,9 @@ file_list_append_row (FileList    *list,
                       Item        *item,
                       GtkTreeIter *iter)
 {
-    gtk_tree_store_append (GTK_TREE_STORE (list), iter, nullptr);
-    gtk_tree_store_set (GTK_TREE_STORE (list), iter,
-                        COLUMN_ITEM, item,
-                        COLUMN_TOOLTIP, item_get_tooltip (item),
-                        -1);
+    gtk_tree_store_insert_with_values (GTK_TREE_STORE (list), iter, nullptr, -1,
+                                       COLUMN_ITEM, item, -1);
+    file_list_index_row (list, iter, item);
 }
 
 static void
@@ -587,11 +630,9 @@ file_list_insert_row (FileList    *list,
         first_user_item = list->n_user_items == 1;
     }
 
-    gtk_tree_store_insert (GTK_TREE_STORE (list), iter, parent_iter, index);
-    gtk_tree_store_set (GTK_TREE_STORE (list), iter,
-                        COLUMN_ITEM, item,
-                        COLUMN_TOOLTIP, item_get_tooltip (item),
-                        -1);
+    gtk_tree_store_insert_with_values (GTK_TREE_STORE (list), iter, parent_iter, index,
+                                       COLUMN_ITEM, item, -1);
+    file_list_index_row (list, iter, item);
 
     if (first_user_item)
     {
@@ -1187,56 +1228,35 @@ file_list_add_group (FileList    *list,
     return gtk_tree_model_get_path (GTK_TREE_MODEL (list), &new_iter);
 }
 
-static void
-file_list_try_remove_item (FileList    *list,
-                           GtkTreePath *path)
+static int
+compare_paths (GtkTreePath *path1,
+               GtkTreePath *path2)
 {
-    GtkTreeIter iter;
-
-    if (gtk_tree_model_get_iter (GTK_TREE_MODEL (list), &iter, path) &&
-        !file_list_iter_is_auto (list, &iter))
-    {
-        file_list_remove_row (list, &iter);
-        window_plugin_queue_update (list->plugin);
-    }
+    return gtk_tree_path_compare (path1, path2);
 }
 
 static void
 file_list_remove_items (FileList *list,
                         GList    *paths)
 {
-    GSList *rows = nullptr;
-
-    while (paths)
-    {
-        GtkTreeRowReference *row;
-
-        row = gtk_tree_row_reference_new (GTK_TREE_MODEL (list), (GtkTreePath*) paths->data);
-
-        if (row)
-            rows = g_slist_prepend (rows, row);
-
-        paths = paths->next;
-    }
+    GList *l;
 
-    rows = g_slist_reverse (rows);
+    /* Going from the last row up means the rows which are not removed
+     * yet keep their paths, so there is no need for row references,
+     * which would all be updated on every removal. Children go before
+     * their group. */
+    paths = g_list_sort (g_list_copy (paths), (GCompareFunc) compare_paths);
 
-    while (rows)
+    for (l = g_list_last (paths); l != nullptr; l = l->prev)
     {
-        GtkTreePath *path = nullptr;
-
-        if (gtk_tree_row_reference_valid ((GtkTreeRowReference*) rows->data))
-            path = gtk_tree_row_reference_get_path ((GtkTreeRowReference*) rows->data);
-
-        if (path)
-        {
-            file_list_try_remove_item (list, path);
-            gtk_tree_path_free (path);
-        }
+        GtkTreeIter iter;
 
-        gtk_tree_row_reference_free ((GtkTreeRowReference*) rows->data);
-        rows = g_slist_delete_link (rows, rows);
+        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (list), &iter, (GtkTreePath*) l->data) &&
+            !file_list_iter_is_auto (list, &iter))
+            file_list_remove_row (list, &iter);
     }
+
+    g_list_free (paths);
 }
 
 static gboolean
@@ -1298,11 +1318,9 @@ copy_row_children (FileList    *list,
     {
         GtkTreeIter iter;
         Item *item = get_item_at_iter (list, &child);
-        gtk_tree_store_append (GTK_TREE_STORE (list), &iter, dest);
-        gtk_tree_store_set (GTK_TREE_STORE (list), &iter,
-                            COLUMN_ITEM, item,
-                            COLUMN_TOOLTIP, item_get_tooltip (item),
-                            -1);
+        gtk_tree_store_insert_with_values (GTK_TREE_STORE (list), &iter, dest, -1,
+                                           COLUMN_ITEM, item, -1);
+        file_list_index_row (list, &iter, item);
         copy_row_children (list, &child, &iter);
     }
     while (gtk_tree_model_iter_next (GTK_TREE_MODEL (list), &child));
@@ -1363,7 +1381,10 @@ move_row (FileList    *list,
             return FALSE;
 
         if (!FILE_ITEM (item)->uri)
+        {
             file_set_uri (FILE_ITEM (item), uri.get());
+            file_list_index_row (list, &iter, item);
+        }
 
         file_list_row_data.set(FILE_ITEM (item)->doc, nullptr);
         file_set_doc (FILE_ITEM (item), nullptr);
@@ -1489,29 +1510,40 @@ add_row_from_file_uri (FileList    *list,
     item_unref (item);
 }
 
-static gboolean
-add_row_from_uri (FileList    *list,
-                  const char  *uri,
-                  GtkTreePath *parent,
-                  int          index)
+/* adds rows for uris which are not in the list yet, in one go;
+ * returns number of added uris */
+static int
+file_list_add_uris (FileList     *list,
+                    char        **uris,
+                    GtkTreePath  *parent,
+                    int           index)
 {
-    GtkTreeIter iter, dummy;
+    GtkTreeIter parent_iter, dummy;
     GtkTreeIter *piter = nullptr;
-
-    g_return_val_if_fail (uri != nullptr, FALSE);
+    int n_added = 0;
 
     if (parent)
     {
-        gtk_tree_model_get_iter (GTK_TREE_MODEL (list), &iter, parent);
-        piter = &iter;
+        if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (list), &parent_iter, parent))
+            g_return_val_if_reached (0);
+        piter = &parent_iter;
     }
 
-    if (uri_is_directory (uri))
-        add_row_from_dir_uri (list, uri, &dummy, piter, index);
-    else
-        add_row_from_file_uri (list, uri, &dummy, piter, index);
+    for ( ; uris && *uris; ++uris)
+    {
+        if (file_list_find_uri (list, *uris, &dummy))
+            continue;
 
-    return TRUE;
+        if (uri_is_directory (*uris))
+            add_row_from_dir_uri (list, *uris, &dummy, piter, index);
+        else
+            add_row_from_file_uri (list, *uris, &dummy, piter, index);
+
+        index += 1;
+        n_added += 1;
+    }
+
+    return n_added;
 }
 
 static gboolean
@@ -1616,16 +1648,7 @@ drop_uris (FileList     *list,
     if (!find_drop_destination (list, dest, &parent_path, &index))
         return FALSE;
 
-    for ( ; uris && *uris; ++uris)
-    {
-        GtkTreeIter iter;
-
-        if (!file_list_find_uri (list, *uris, &iter) &&
-            add_row_from_uri (list, *uris, parent_path, index))
-        {
-            index += 1;
-        }
-    }
+    file_list_add_uris (list, uris, parent_path, index);
 
     if (parent_path)
         gtk_tree_path_free (parent_path);
@@ -1762,7 +1785,7 @@ tree_view_search_equal_func (GtkTreeModel *model,
     item = get_item_at_iter (FILE_LIST (model), iter);
 
     if (ITEM_IS_FILE (item))
-        compare_with = FILE_ITEM (item)->display_basename;
+        compare_with = file_get_display_basename (FILE_ITEM (item));
     else if (ITEM_IS_GROUP (item))
         compare_with = GROUP_ITEM (item)->name;
 
@@ -1796,7 +1819,7 @@ text_data_func (G_GNUC_UNUSED GtkTreeViewColumn *column,
     if (ITEM_IS_GROUP (item))
         g_object_set (cell, "text", GROUP_ITEM (item)->name, nullptr);
     else if (ITEM_IS_FILE (item))
-        g_object_set (cell, "text", FILE_ITEM (item)->display_basename, nullptr);
+        g_object_set (cell, "text", file_get_display_basename (FILE_ITEM (item)), nullptr);
 }
 
 static void
@@ -2112,6 +2135,36 @@ treeview_row_activated (WindowPlugin *plugin,
         open_file (plugin, path);
 }
 
+static gboolean
+treeview_query_tooltip (GtkTreeView *treeview,
+                        int          x,
+                        int          y,
+                        gboolean     keyboard_tip,
+                        GtkTooltip  *tooltip)
+{
+    GtkTreeModel *model;
+    GtkTreePath *path;
+    GtkTreeIter iter;
+    Item *item;
+    gboolean retval = FALSE;
+
+    if (!gtk_tree_view_get_tooltip_context (treeview, &x, &y, keyboard_tip,
+                                            &model, &path, &iter))
+        return FALSE;
+
+    item = get_item_at_iter (FILE_LIST (model), &iter);
+
+    if (ITEM_IS_FILE (item) && file_get_display_name (FILE_ITEM (item)))
+    {
+        gtk_tooltip_set_text (tooltip, file_get_display_name (FILE_ITEM (item)));
+        gtk_tree_view_set_tooltip_row (treeview, tooltip, path);
+        retval = TRUE;
+    }
+
+    gtk_tree_path_free (path);
+    return retval;
+}
+
 static void
 create_treeview (WindowPlugin *plugin)
 {
@@ -2130,13 +2183,15 @@ create_treeview (WindowPlugin *plugin)
     gtk_tree_view_set_search_equal_func (plugin->treeview,
                                          (GtkTreeViewSearchEqualFunc) tree_view_search_equal_func,
                                          nullptr, nullptr);
-    gtk_tree_view_set_tooltip_column (plugin->treeview, COLUMN_TOOLTIP);
+    gtk_widget_set_has_tooltip (GTK_WIDGET (plugin->treeview), TRUE);
 
     selection = gtk_tree_view_get_selection (plugin->treeview);
     gtk_tree_selection_set_mode (selection, GTK_SELECTION_MULTIPLE);
 
     g_signal_connect (plugin->treeview, "button-press-event",
                       G_CALLBACK (treeview_button_press), plugin);
+    g_signal_connect (plugin->treeview, "query-tooltip",
+                      G_CALLBACK (treeview_query_tooltip), nullptr);
     g_signal_connect_swapped (plugin->treeview, "row-activated",
                               G_CALLBACK (treeview_row_activated), plugin);
     g_signal_connect_swapped (plugin->treeview, "row-expanded",
@@ -1238,7 +1238,11 @@ static void
 file_selector_plugin_deinit (Plugin *plugin)
 {
     if (plugin->bookmark_mgr)
+    {
+        /* prefs are saved right after plugins are shut down */
+        _moo_bookmark_mgr_flush (plugin->bookmark_mgr);
         g_object_unref (plugin->bookmark_mgr);
+    }
     plugin->bookmark_mgr = nullptr;
 }
 
@@ -20,6 +20,8 @@
 #include "mooedit/mooplugin-macro.h"
 #include "mooedit/mooedit-script.h"
 #include "plugins/mooplugin-builtin.h"
+#include "plugins/moofileindex.h"
+#include "plugins/moofilecrawler.h"
 #include "moofileview/moofileentry.h"
 #include "support/moocmdview.h"
 #include "mooedit/mooedit-accels.h"
@@ -37,6 +39,7 @@
 #include "moo-help-sections.h"
 #endif
 #include <gtk/gtk.h>
+#include <gdk/gdkkeysyms.h>
 #include <string.h>
 #ifndef __WIN32__
 #include <sys/wait.h>
@@ -45,9 +48,11 @@
 
 #define FIND_PLUGIN_ID "Find"
 
-#define GREP_SKIP_LIST_ID "FindPlugin/grep/skip"
+#define GREP_SKIP_LIST_ID MOO_FILE_CRAWLER_SKIP_LIST_ID
 #define FIND_SKIP_LIST_ID "FindPlugin/find/skip"
 
+#define MAX_QUICK_OPEN_MATCHES 100
+
 enum {
     CMD_GREP = 1,
     CMD_FIND
@@ -102,6 +107,8 @@ static void         execute_grep            (const char     *pattern,
                                              gboolean        case_sensitive,
                                              WindowStuff    *stuff);
 
+static void         init_skip_list          (void);
+
 static void         do_find                 (MooEditWindow  *window,
                                              WindowStuff    *stuff);
 static void         create_find_dialog      (MooEditWindow  *window,
@@ -231,6 +238,275 @@ ensure_output (WindowStuff *stuff)
 }
 
 
+/*************************************************************************/
+/* Quick Open
+ */
+
+enum {
+    QUICK_OPEN_COLUMN_NAME,
+    QUICK_OPEN_COLUMN_DIR,
+    QUICK_OPEN_COLUMN_PATH,
+    QUICK_OPEN_N_COLUMNS
+};
+
+typedef struct {
+    MooFileIndex *index;
+    GtkWidget *entry;
+    GtkWidget *treeview;
+    GtkWidget *label;
+} QuickOpen;
+
+static void
+quick_open_update_label (QuickOpen *qo)
+{
+    guint n_files = _moo_file_index_get_n_files (qo->index);
+    char *text;
+
+    if (_moo_file_index_is_busy (qo->index))
+        text = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                           "Indexing, %u file so far",
+                                           "Indexing, %u files so far",
+                                           n_files),
+                                n_files);
+    else
+        text = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                           "%u file",
+                                           "%u files",
+                                           n_files),
+                                n_files);
+
+    gtk_label_set_text (GTK_LABEL (qo->label), text);
+    g_free (text);
+}
+
+static void
+quick_open_update (QuickOpen *qo)
+{
+    GtkListStore *store;
+    GtkTreeIter iter;
+    char **paths, **p;
+
+    store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (qo->treeview)));
+    gtk_list_store_clear (store);
+
+    paths = _moo_file_index_match (qo->index, gtk_entry_get_text (GTK_ENTRY (qo->entry)),
+                                   MAX_QUICK_OPEN_MATCHES);
+
+    for (p = paths; p && *p; ++p)
+    {
+        char *name = g_filename_display_basename (*p);
+        char *dir = g_path_get_dirname (*p);
+        char *dir_display = g_filename_display_name (strcmp (dir, ".") != 0 ? dir : "");
+
+        gtk_list_store_append (store, &iter);
+        gtk_list_store_set (store, &iter,
+                            QUICK_OPEN_COLUMN_NAME, name,
+                            QUICK_OPEN_COLUMN_DIR, dir_display,
+                            QUICK_OPEN_COLUMN_PATH, *p,
+                            -1);
+
+        g_free (dir_display);
+        g_free (dir);
+        g_free (name);
+    }
+
+    if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter))
+        gtk_tree_selection_select_iter (gtk_tree_view_get_selection (GTK_TREE_VIEW (qo->treeview)), &iter);
+
+    g_strfreev (paths);
+}
+
+static void
+quick_open_index_changed (G_GNUC_UNUSED MooFileIndex *index,
+                          QuickOpen *qo)
+{
+    quick_open_update_label (qo);
+    quick_open_update (qo);
+}
+
+/* arrow keys move selection in the list while focus stays in the entry */
+static gboolean
+quick_open_key_press (QuickOpen   *qo,
+                      GdkEventKey *event)
+{
+    GtkTreeSelection *selection;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    GtkTreePath *path;
+    int n_rows, row;
+
+    switch (event->keyval)
+    {
+        case GDK_Up:
+        case GDK_KP_Up:
+            row = -1;
+            break;
+        case GDK_Down:
+        case GDK_KP_Down:
+            row = 1;
+            break;
+        default:
+            return FALSE;
+    }
+
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (qo->treeview));
+
+    if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+        return FALSE;
+
+    n_rows = gtk_tree_model_iter_n_children (model, NULL);
+    path = gtk_tree_model_get_path (model, &iter);
+    row = CLAMP (gtk_tree_path_get_indices (path)[0] + row, 0, n_rows - 1);
+    gtk_tree_path_free (path);
+
+    path = gtk_tree_path_new_from_indices (row, -1);
+    gtk_tree_view_set_cursor (GTK_TREE_VIEW (qo->treeview), path, NULL, FALSE);
+    gtk_tree_path_free (path);
+
+    gtk_widget_grab_focus (qo->entry);
+    gtk_editable_set_position (GTK_EDITABLE (qo->entry), -1);
+    return TRUE;
+}
+
+static void
+quick_open_row_activated (GtkDialog *dialog)
+{
+    gtk_dialog_response (dialog, GTK_RESPONSE_OK);
+}
+
+static GtkWidget *
+create_quick_open_dialog (MooEditWindow *window,
+                          QuickOpen     *qo)
+{
+    GtkWidget *dialog, *vbox, *swin;
+    GtkListStore *store;
+    GtkCellRenderer *cell;
+    char *title, *root;
+
+    root = g_filename_display_name (_moo_file_index_get_root (qo->index));
+    title = g_strdup_printf (_("Quick Open - %s"), root);
+    dialog = gtk_dialog_new_with_buttons (title, GTK_WINDOW (window),
+                                          (GtkDialogFlags) (GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT),
+                                          GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                          GTK_STOCK_OPEN, GTK_RESPONSE_OK,
+                                          nullptr);
+    gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+    gtk_dialog_set_alternative_button_order (GTK_DIALOG (dialog),
+                                             GTK_RESPONSE_OK,
+                                             GTK_RESPONSE_CANCEL,
+                                             -1);
+    gtk_window_set_default_size (GTK_WINDOW (dialog), 500, 400);
+    g_free (title);
+    g_free (root);
+
+    vbox = gtk_vbox_new (FALSE, 6);
+    gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
+    gtk_box_pack_start (GTK_BOX (GTK_DIALOG (dialog)->vbox), vbox, TRUE, TRUE, 0);
+
+    qo->entry = gtk_entry_new ();
+    gtk_entry_set_activates_default (GTK_ENTRY (qo->entry), TRUE);
+    gtk_box_pack_start (GTK_BOX (vbox), qo->entry, FALSE, FALSE, 0);
+
+    store = gtk_list_store_new (QUICK_OPEN_N_COLUMNS, G_TYPE_STRING,
+                                G_TYPE_STRING, G_TYPE_STRING);
+    qo->treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+    gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (qo->treeview), FALSE);
+    g_object_unref (store);
+
+    cell = gtk_cell_renderer_text_new ();
+    gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qo->treeview), -1, NULL, cell,
+                                                 "text", QUICK_OPEN_COLUMN_NAME, nullptr);
+    cell = gtk_cell_renderer_text_new ();
+    g_object_set (cell, "foreground", "gray", nullptr);
+    gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qo->treeview), -1, NULL, cell,
+                                                 "text", QUICK_OPEN_COLUMN_DIR, nullptr);
+
+    swin = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (swin),
+                                    GTK_POLICY_AUTOMATIC,
+                                    GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (swin), GTK_SHADOW_IN);
+    gtk_container_add (GTK_CONTAINER (swin), qo->treeview);
+    gtk_box_pack_start (GTK_BOX (vbox), swin, TRUE, TRUE, 0);
+
+    qo->label = gtk_label_new (NULL);
+    gtk_misc_set_alignment (GTK_MISC (qo->label), 0, 0.5);
+    gtk_box_pack_start (GTK_BOX (vbox), qo->label, FALSE, FALSE, 0);
+
+    g_signal_connect_swapped (qo->entry, "changed", G_CALLBACK (quick_open_update), qo);
+    g_signal_connect_swapped (qo->entry, "key-press-event", G_CALLBACK (quick_open_key_press), qo);
+    g_signal_connect_swapped (qo->treeview, "row-activated", G_CALLBACK (quick_open_row_activated), dialog);
+
+    gtk_widget_show_all (vbox);
+    return dialog;
+}
+
+/* project of the active document; NULL if it's not in a project,
+ * indexing some arbitrary directory like $HOME would be too costly */
+static char *
+get_quick_open_root (MooEditWindow *window)
+{
+    MooEdit *doc = moo_edit_window_get_active_doc (window);
+    char *filename = doc ? moo_edit_get_filename (doc) : NULL;
+    char *root = NULL;
+
+    if (filename)
+        root = _moo_file_crawler_find_root (filename);
+
+    g_free (filename);
+    return root;
+}
+
+static void
+quick_open_cb (MooEditWindow *window)
+{
+    QuickOpen qo;
+    GtkWidget *dialog;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    guint notify_id;
+    char *root;
+    char *path = NULL;
+
+    if (!(root = get_quick_open_root (window)))
+    {
+        moo_error_dialog (_("Quick Open works with project files"),
+                          _("Active document is not in a directory under version control"),
+                          GTK_WIDGET (window));
+        return;
+    }
+
+    init_skip_list ();
+
+    qo.index = _moo_file_index_get (root);
+    g_free (root);
+    g_return_if_fail (qo.index != NULL);
+
+    dialog = create_quick_open_dialog (window, &qo);
+    notify_id = _moo_file_index_connect (qo.index,
+                                         (MooFileIndexNotify) quick_open_index_changed,
+                                         &qo);
+    quick_open_update_label (&qo);
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_OK &&
+        gtk_tree_selection_get_selected (gtk_tree_view_get_selection (GTK_TREE_VIEW (qo.treeview)),
+                                         &model, &iter))
+        gtk_tree_model_get (model, &iter, QUICK_OPEN_COLUMN_PATH, &path, -1);
+
+    _moo_file_index_disconnect (qo.index, notify_id);
+    gtk_widget_destroy (dialog);
+
+    if (path)
+    {
+        char *filename = g_build_filename (_moo_file_index_get_root (qo.index), path, nullptr);
+        moo_editor_open_path (moo_edit_window_get_editor (window), filename, NULL, -1, window);
+        g_free (filename);
+    }
+
+    g_free (path);
+}
+
+
 static gboolean
 find_window_plugin_create (WindowStuff *stuff)
 {
@@ -257,6 +533,15 @@ find_plugin_init (FindPlugin *plugin)
                                  "closure-callback", find_in_files_cb,
                                  nullptr);
 
+    moo_window_class_new_action (klass, "QuickOpen", NULL,
+                                 "display-name", _("Quick Open"),
+                                 "label", _("_Quick Open..."),
+                                 "tooltip", _("Open a file of the project by typing a part of its name"),
+                                 "default-accel", MOO_EDIT_ACCEL_QUICK_OPEN,
+                                 "stock-id", GTK_STOCK_OPEN,
+                                 "closure-callback", quick_open_cb,
+                                 nullptr);
+
 #ifndef __WIN32__
     moo_window_class_new_action (klass, "FindFile", NULL,
                                  "display-name", _("Find File"),
@@ -273,6 +558,9 @@ find_plugin_init (FindPlugin *plugin)
         moo_ui_xml_add_item (xml, plugin->ui_merge_id,
                              "Editor/Menubar/Search",
                              "FindInFiles", "FindInFiles", -1);
+        moo_ui_xml_add_item (xml, plugin->ui_merge_id,
+                             "Editor/Menubar/Search",
+                             "QuickOpen", "QuickOpen", -1);
 #ifndef __WIN32__
         moo_ui_xml_add_item (xml, plugin->ui_merge_id,
                              "Editor/Menubar/Search",
@@ -293,6 +581,7 @@ find_plugin_deinit (FindPlugin *plugin)
     MooUiXml *xml = moo_editor_get_ui_xml (editor);
 
     moo_window_class_remove_action (klass, "FindInFiles");
+    moo_window_class_remove_action (klass, "QuickOpen");
 #ifndef __WIN32__
     moo_window_class_remove_action (klass, "FindFile");
 #endif
@@ -301,6 +590,8 @@ find_plugin_deinit (FindPlugin *plugin)
         moo_ui_xml_remove_ui (xml, plugin->ui_merge_id);
     plugin->ui_merge_id = 0;
 
+    _moo_file_index_shutdown ();
+
     g_type_class_unref (klass);
 }
 
@@ -342,7 +633,7 @@ init_skip_list (void)
     MooHistoryList *list = moo_history_list_get (GREP_SKIP_LIST_ID);
     g_return_if_fail (list != NULL);
     if (moo_history_list_is_empty (list))
-        moo_history_list_add (list, ".svn/;.hg/;.git/;CVS/;*~;*.bak;*.orig;*.rej");
+        moo_history_list_add (list, MOO_FILE_CRAWLER_DEFAULT_SKIP);
 }
 
 static void
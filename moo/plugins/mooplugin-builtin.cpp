@@ -27,7 +27,7 @@ moo_plugin_init (void)
 {
 #ifdef MOO_ENABLE_PYTHON
     if (!moo_getenv_bool ("MOO_DISABLE_PYTHON"))
-        _moo_python_builtin_init ();
+        _moo_python_builtin_init_lazy ();
 #endif
 
     if (!moo_getenv_bool ("MOO_DISABLE_LUA"))
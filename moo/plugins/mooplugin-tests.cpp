@@ -0,0 +1,620 @@
+/*
+ *   mooplugin-tests.cpp
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "plugins/mooplugin-tests.h"
+#include "mooedit/mooeditor-impl.h"
+#include "mooedit/mooedit-impl.h"
+#include "mooedit/mooeditprefs.h"
+#include "mooedit/mooplugin.h"
+#include "mooedit/mooplugin-loader.h"
+#include "mooutils/mooutils-fs.h"
+#include "mooutils/moomarkup.h"
+#include "mooutils/mooprefs.h"
+#include "plugins/moofilecrawler.h"
+#include "plugins/moofileindex.h"
+#include "plugins/support/moolineview.h"
+#include "moocpp/fileutils.h"
+#include <string.h>
+
+static struct {
+    gstr working_dir;
+} test_data;
+
+#define TEXT1 "blah blah blah\nblah blah blah\n"
+#define TEXT2 "lala\nlala\n"
+
+/* restores a window with two documents, the second one is active
+ * and the first one waits for its text */
+static gboolean
+load_lazy_session (const char *uri1,
+                   const char *uri2)
+{
+    MooMarkupDoc *xml;
+    GError *error = NULL;
+    gboolean lazy;
+
+    gstr session = gstr::take (g_markup_printf_escaped (
+        "<session><editor version=\"2.0\"><window>"
+        "<document>%s</document>"
+        "<document active=\"true\">%s</document>"
+        "</window></editor></session>", uri1, uri2));
+
+    xml = moo_markup_parse_memory (session.get(), -1, &error);
+    if (!xml)
+    {
+        TEST_FAILED_MSG ("could not parse session: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    lazy = moo_prefs_get_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION));
+    moo_prefs_set_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION), TRUE);
+
+    _moo_editor_load_session (moo_editor_instance (), moo_markup_get_root_element (xml, "session"));
+    moo_markup_doc_unref (xml);
+
+    moo_prefs_set_bool (moo_edit_setting (MOO_EDIT_PREFS_LAZY_SESSION), lazy);
+    return TRUE;
+}
+
+/* a plugin which remembers the documents it was attached to */
+typedef MooPlugin TestPlugin;
+typedef MooPluginClass TestPluginClass;
+
+G_DEFINE_TYPE (TestPlugin, test_plugin, MOO_TYPE_PLUGIN)
+
+static MooEditArray *test_plugin_docs;
+
+static void
+test_plugin_attach_doc (G_GNUC_UNUSED MooPlugin *plugin,
+                        MooEdit                 *doc,
+                        G_GNUC_UNUSED MooEditWindow *window)
+{
+    if (test_plugin_docs)
+        moo_edit_array_append (test_plugin_docs, doc);
+}
+
+static void
+test_plugin_detach_doc (G_GNUC_UNUSED MooPlugin *plugin,
+                        MooEdit                 *doc,
+                        G_GNUC_UNUSED MooEditWindow *window)
+{
+    if (test_plugin_docs)
+        moo_edit_array_remove (test_plugin_docs, doc);
+}
+
+static void
+test_plugin_init (G_GNUC_UNUSED TestPlugin *plugin)
+{
+}
+
+static void
+test_plugin_class_init (TestPluginClass *klass)
+{
+    klass->attach_doc = test_plugin_attach_doc;
+    klass->detach_doc = test_plugin_detach_doc;
+}
+
+/* documents restored lazily get plugins when they are loaded or
+ * when their document plugin is asked for */
+static void
+test_lazy_doc_plugins (void)
+{
+    MooEditor *editor;
+    MooEdit *doc1, *doc2;
+    MooPluginInfo *info;
+    MooPluginParams *params;
+    char *text;
+
+    test_plugin_docs = moo_edit_array_new ();
+    info = moo_plugin_info_new ("Test", NULL, NULL, NULL);
+    params = moo_plugin_params_new (TRUE, FALSE);
+    TEST_ASSERT (moo_plugin_register ("MooTestLazyDoc", test_plugin_get_type (), info, params));
+    moo_plugin_info_free (info);
+    moo_plugin_params_free (params);
+
+    gstr filename1 = g::build_filename (test_data.working_dir, "plugins1.txt");
+    gstr filename2 = g::build_filename (test_data.working_dir, "plugins2.txt");
+    gstr filename3 = g::build_filename (test_data.working_dir, "plugins3.txt");
+    g_file_set_contents (filename1.get(), TEXT1, -1, NULL);
+    g_file_set_contents (filename2.get(), TEXT2, -1, NULL);
+    g_file_set_contents (filename3.get(), TEXT2, -1, NULL);
+
+    gstr uri1 = gstr::take (g_filename_to_uri (filename1.get(), NULL, NULL));
+    gstr uri2 = gstr::take (g_filename_to_uri (filename2.get(), NULL, NULL));
+
+    editor = moo_editor_instance ();
+
+    if (load_lazy_session (uri1.get(), uri2.get()))
+    {
+        doc1 = moo_editor_get_doc (editor, filename1.get());
+        doc2 = moo_editor_get_doc (editor, filename2.get());
+        TEST_ASSERT (doc1 != NULL && doc2 != NULL);
+    }
+    else
+    {
+        doc1 = doc2 = NULL;
+    }
+
+    if (doc1 && doc2)
+    {
+        MooEditWindow *window = moo_edit_get_window (doc2);
+        MooEdit *doc3;
+
+        TEST_ASSERT (_moo_edit_is_load_pending (doc1));
+        TEST_ASSERT (moo_edit_array_find (test_plugin_docs, doc2) >= 0);
+        TEST_ASSERT (moo_edit_array_find (test_plugin_docs, doc1) < 0);
+
+        /* looking up a document plugin attaches plugins to the
+         * document, it does not load the text */
+        TEST_ASSERT (moo_doc_plugin_lookup ("MooTestLazyDoc", doc1) == NULL);
+        TEST_ASSERT (moo_edit_array_find (test_plugin_docs, doc1) >= 0);
+        TEST_ASSERT (_moo_edit_is_load_pending (doc1));
+
+        /* loading the text does not attach them again */
+        text = moo_edit_get_text (doc1, NULL, NULL);
+        TEST_ASSERT_STR_EQ (text, TEXT1);
+        g_free (text);
+        TEST_ASSERT_INT_EQ (test_plugin_docs->n_elms, 2);
+
+        /* documents opened normally get plugins right away */
+        doc3 = moo_editor_open_path (editor, filename3.get(), NULL, -1, window);
+        TEST_ASSERT (doc3 != NULL);
+        TEST_ASSERT (moo_edit_array_find (test_plugin_docs, doc3) >= 0);
+
+        TEST_ASSERT (moo_editor_close_window (editor, window));
+        TEST_ASSERT_INT_EQ (test_plugin_docs->n_elms, 0);
+    }
+
+    /* there is no unregistering, it stays registered but disabled */
+    if (moo_plugin_lookup ("MooTestLazyDoc"))
+        moo_plugin_set_enabled ((MooPlugin*) moo_plugin_lookup ("MooTestLazyDoc"), FALSE);
+    moo_edit_array_free (test_plugin_docs);
+    test_plugin_docs = NULL;
+}
+
+/* a module type which only records which ini files it was asked to load */
+static GPtrArray *test_loaded_modules;
+
+static void
+test_load_module (G_GNUC_UNUSED const char *module_file,
+                  const char               *ini_file,
+                  G_GNUC_UNUSED gpointer    data)
+{
+    g_ptr_array_add (test_loaded_modules, g_path_get_basename (ini_file));
+}
+
+static void
+test_load_plugin (G_GNUC_UNUSED const char      *plugin_file,
+                  G_GNUC_UNUSED const char      *plugin_id,
+                  G_GNUC_UNUSED MooPluginInfo   *info,
+                  G_GNUC_UNUSED MooPluginParams *params,
+                  const char                    *ini_file,
+                  G_GNUC_UNUSED gpointer         data)
+{
+    g_ptr_array_add (test_loaded_modules, g_path_get_basename (ini_file));
+}
+
+static gboolean
+test_module_loaded (const char *ini_file)
+{
+    guint i;
+
+    for (i = 0; i < test_loaded_modules->len; ++i)
+        if (strcmp ((const char*) test_loaded_modules->pdata[i], ini_file) == 0)
+            return TRUE;
+
+    return FALSE;
+}
+
+static void
+write_test_module (const char *name,
+                   const char *extra)
+{
+    guint major, minor;
+
+    _moo_module_version (&major, &minor);
+    gstr ini_file = gstr::take (g_strdup_printf ("%s.ini", name));
+    gstr filename = g::build_filename (test_data.working_dir, ini_file);
+    gstr contents = gstr::take (g_strdup_printf ("[module]\n"
+                                                 "type=MooTest\n"
+                                                 "file=%s.test\n"
+                                                 "version=%u.%u\n"
+                                                 "%s",
+                                                 name, major, minor, extra));
+    TEST_ASSERT (g_file_set_contents (filename.get(), contents.get(), -1, NULL));
+    _moo_plugin_load (test_data.working_dir.get(), ini_file.get());
+}
+
+/* modules with load-on wait for their triggers, plugins disabled
+ * in preferences wait for the preferences page */
+static void
+test_deferred_modules (void)
+{
+    MooPluginLoader loader = { test_load_module, test_load_plugin, NULL };
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooWindowClass *klass;
+    GtkAction *action;
+    GTimer *timer;
+    char *disabled_key;
+
+    test_loaded_modules = g_ptr_array_new_with_free_func (g_free);
+    moo_plugin_loader_register (&loader, "MooTest");
+
+    disabled_key = moo_prefs_make_key (MOO_PLUGIN_PREFS_ROOT, "MooTestDisabled", "enabled", NULL);
+    moo_prefs_new_key_bool (disabled_key, TRUE);
+    moo_prefs_set_bool (disabled_key, FALSE);
+
+    write_test_module ("test-now", "");
+    write_test_module ("test-action",
+                       "load-on=action:MooTestAction\n"
+                       "[action:MooTestAction]\n"
+                       "_label=Test Action\n");
+    write_test_module ("test-lang",
+                       "load-on=action:MooTestMissing;lang:mootestlang\n"
+                       "[action:MooTestMissing]\n"
+                       "_label=Missing\n"
+                       "requires=python/moo-no-such-file.py\n");
+    write_test_module ("test-disabled",
+                       "load-on=action:MooTestDisabled;lang:mootestlang\n"
+                       "[action:MooTestDisabled]\n"
+                       "_label=Disabled\n"
+                       "[plugin]\n"
+                       "id=MooTestDisabled\n");
+
+    TEST_ASSERT (test_module_loaded ("test-now.ini"));
+    TEST_ASSERT_INT_EQ (test_loaded_modules->len, 1);
+
+    klass = MOO_WINDOW_CLASS (g_type_class_ref (MOO_TYPE_EDIT_WINDOW));
+    TEST_ASSERT (moo_window_class_find_action (klass, "MooTestAction"));
+    TEST_ASSERT (!moo_window_class_find_action (klass, "MooTestMissing"));
+    TEST_ASSERT (!moo_window_class_find_action (klass, "MooTestDisabled"));
+
+    /* the placeholder action loads the module and goes away */
+    editor = moo_editor_instance ();
+    window = moo_editor_new_window (editor);
+    action = moo_window_get_action (MOO_WINDOW (window), "MooTestAction");
+    TEST_ASSERT (action != NULL);
+    if (action)
+        gtk_action_activate (action);
+
+    timer = g_timer_new ();
+    while (!test_module_loaded ("test-action.ini") && g_timer_elapsed (timer, NULL) < 10)
+        g_main_context_iteration (NULL, TRUE);
+    g_timer_destroy (timer);
+
+    TEST_ASSERT (test_module_loaded ("test-action.ini"));
+    TEST_ASSERT (!moo_window_class_find_action (klass, "MooTestAction"));
+
+    _moo_plugin_loader_lang_used ("mootestlang");
+    TEST_ASSERT (test_module_loaded ("test-lang.ini"));
+    TEST_ASSERT (!test_module_loaded ("test-disabled.ini"));
+
+    _moo_plugin_loader_load_disabled ();
+    TEST_ASSERT (test_module_loaded ("test-disabled.ini"));
+    TEST_ASSERT_INT_EQ (test_loaded_modules->len, 4);
+
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+    g_type_class_unref (klass);
+    moo_prefs_set_bool (disabled_key, TRUE);
+    g_free (disabled_key);
+    g_ptr_array_free (test_loaded_modules, TRUE);
+    test_loaded_modules = NULL;
+}
+
+static void
+write_project_file (const char *root,
+                    const char *path)
+{
+    gstr filename = g::build_filename (root, path);
+    gstr dir = gstr::take (g_path_get_dirname (filename.get()));
+    mgw_errno_t err;
+
+    TEST_ASSERT (_moo_mkdir_with_parents (dir.get(), &err) == 0);
+    TEST_ASSERT (g_file_set_contents (filename.get(), "text\n", -1, NULL));
+}
+
+static gboolean
+file_index_wait (MooFileIndex *index)
+{
+    GTimer *timer = g_timer_new ();
+    gboolean done;
+
+    while (_moo_file_index_is_busy (index) && g_timer_elapsed (timer, NULL) < 60)
+        g_main_context_iteration (NULL, TRUE);
+
+    done = !_moo_file_index_is_busy (index);
+    g_timer_destroy (timer);
+    return done;
+}
+
+static void
+test_file_index (void)
+{
+    MooFileIndex *index;
+    GPatternSpec **patterns;
+    char **paths;
+    char *found;
+    gstr root = g::build_filename (test_data.working_dir, "file-index");
+    gstr helper = g::build_filename (root, "src/util/helper.c");
+    gstr doc_dir = g::build_filename (root, "doc");
+
+    write_project_file (root.get(), ".git/HEAD");
+    write_project_file (root.get(), "CVS/Entries");
+    write_project_file (root.get(), "README");
+    write_project_file (root.get(), "src/main.c");
+    write_project_file (root.get(), "src/main.c~");
+    write_project_file (root.get(), "src/util/helper.c");
+
+    found = _moo_file_crawler_find_root (helper.get());
+    TEST_ASSERT_STR_EQ (found, root.get());
+    g_free (found);
+
+    /* globs ending with a slash are for directories only */
+    patterns = _moo_file_crawler_make_patterns ("*.o; build/ ;;", FALSE);
+    TEST_ASSERT (_moo_file_crawler_match_any (patterns, "main.o"));
+    TEST_ASSERT (!_moo_file_crawler_match_any (patterns, "build"));
+    _moo_file_crawler_free_patterns (patterns);
+    patterns = _moo_file_crawler_make_patterns ("*.o; build/ ;;", TRUE);
+    TEST_ASSERT (_moo_file_crawler_match_any (patterns, "main.o"));
+    TEST_ASSERT (_moo_file_crawler_match_any (patterns, "build"));
+    _moo_file_crawler_free_patterns (patterns);
+    TEST_ASSERT (_moo_file_crawler_make_patterns (" ; ", TRUE) == NULL);
+
+    /* version control directories and backup files are skipped */
+    index = _moo_file_index_get (root.get());
+    TEST_ASSERT (file_index_wait (index));
+    TEST_ASSERT_INT_EQ (_moo_file_index_get_n_files (index), 3);
+
+    paths = _moo_file_index_match (index, "helper", 10);
+    TEST_ASSERT (paths != NULL && g_strv_length (paths) == 1);
+    if (paths && paths[0])
+        TEST_ASSERT_STR_EQ (paths[0], "src" G_DIR_SEPARATOR_S "util" G_DIR_SEPARATOR_S "helper.c");
+    g_strfreev (paths);
+
+    /* changed directories are read again when the index is requested */
+    write_project_file (root.get(), "src/util/other.c");
+    write_project_file (root.get(), "doc/index.txt");
+    index = _moo_file_index_get (root.get());
+    TEST_ASSERT (file_index_wait (index));
+    TEST_ASSERT_INT_EQ (_moo_file_index_get_n_files (index), 5);
+
+    TEST_ASSERT (_moo_remove_dir (doc_dir.get(), TRUE, NULL));
+    index = _moo_file_index_get (root.get());
+    TEST_ASSERT (file_index_wait (index));
+    TEST_ASSERT_INT_EQ (_moo_file_index_get_n_files (index), 4);
+
+    /* after a restart the saved list is loaded and the tree is
+     * walked again */
+    _moo_file_index_shutdown ();
+    write_project_file (root.get(), "src/util/added.c");
+    index = _moo_file_index_get (root.get());
+    TEST_ASSERT (file_index_wait (index));
+    TEST_ASSERT_INT_EQ (_moo_file_index_get_n_files (index), 5);
+
+    _moo_file_index_shutdown ();
+}
+
+static char *
+get_buffer_text (GtkTextBuffer *buffer)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+}
+
+static char *
+get_line_text (GtkTextBuffer *buffer,
+               int            line)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line (buffer, &start, line);
+    end = start;
+    if (!gtk_text_iter_ends_line (&end))
+        gtk_text_iter_forward_to_line_end (&end);
+    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+}
+
+static void
+write_numbered_lines (MooLineView *view,
+                      guint        first,
+                      guint        n_lines)
+{
+    guint i;
+
+    for (i = first; i < first + n_lines; ++i)
+    {
+        char *text = g_strdup_printf ("line %u", i);
+        int line = moo_line_view_write_line (view, text, -1, NULL);
+        moo_line_view_set_data (view, line, GUINT_TO_POINTER (i + 1), NULL);
+        g_free (text);
+    }
+}
+
+static void
+test_line_view (void)
+{
+    GtkWidget *view;
+    GtkTextBuffer *buffer;
+    char *text;
+
+    view = moo_line_view_new ();
+    g_object_ref_sink (view);
+    buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+
+    /* no limit by default */
+    TEST_ASSERT_INT_EQ (moo_line_view_get_max_lines (MOO_LINE_VIEW (view)), 0);
+    write_numbered_lines (MOO_LINE_VIEW (view), 0, 300);
+    moo_line_view_flush (MOO_LINE_VIEW (view));
+    TEST_ASSERT_INT_EQ (gtk_text_buffer_get_line_count (buffer), 300);
+    text = get_line_text (buffer, 0);
+    TEST_ASSERT_STR_EQ (text, "line 0");
+    g_free (text);
+
+    /* lines over the limit are replaced with a marker, data of the
+     * remaining lines moves with them */
+    moo_line_view_clear (MOO_LINE_VIEW (view));
+    moo_line_view_set_max_lines (MOO_LINE_VIEW (view), 100);
+    write_numbered_lines (MOO_LINE_VIEW (view), 0, 150);
+    moo_line_view_flush (MOO_LINE_VIEW (view));
+    TEST_ASSERT_INT_EQ (gtk_text_buffer_get_line_count (buffer), 101);
+    text = get_line_text (buffer, 0);
+    TEST_ASSERT_STR_EQ (text, "[50 lines dropped]");
+    g_free (text);
+    text = get_line_text (buffer, 1);
+    TEST_ASSERT_STR_EQ (text, "line 50");
+    g_free (text);
+    TEST_ASSERT (moo_line_view_get_data (MOO_LINE_VIEW (view), 0) == NULL);
+    TEST_ASSERT_INT_EQ (GPOINTER_TO_UINT (moo_line_view_get_data (MOO_LINE_VIEW (view), 1)), 51);
+    TEST_ASSERT_INT_EQ (GPOINTER_TO_UINT (moo_line_view_get_data (MOO_LINE_VIEW (view), 100)), 150);
+
+    /* the marker is updated, not repeated */
+    write_numbered_lines (MOO_LINE_VIEW (view), 150, 20);
+    moo_line_view_flush (MOO_LINE_VIEW (view));
+    TEST_ASSERT_INT_EQ (gtk_text_buffer_get_line_count (buffer), 101);
+    text = get_line_text (buffer, 0);
+    TEST_ASSERT_STR_EQ (text, "[70 lines dropped]");
+    g_free (text);
+    text = get_line_text (buffer, 1);
+    TEST_ASSERT_STR_EQ (text, "line 70");
+    g_free (text);
+    TEST_ASSERT_INT_EQ (GPOINTER_TO_UINT (moo_line_view_get_data (MOO_LINE_VIEW (view), 1)), 71);
+    TEST_ASSERT_INT_EQ (GPOINTER_TO_UINT (moo_line_view_get_data (MOO_LINE_VIEW (view), 100)), 170);
+
+    /* clearing removes the marker */
+    moo_line_view_clear (MOO_LINE_VIEW (view));
+    write_numbered_lines (MOO_LINE_VIEW (view), 0, 1);
+    moo_line_view_flush (MOO_LINE_VIEW (view));
+    text = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (text, "line 0");
+    g_free (text);
+    TEST_ASSERT_INT_EQ (GPOINTER_TO_UINT (moo_line_view_get_data (MOO_LINE_VIEW (view), 0)), 1);
+
+    gtk_widget_destroy (view);
+    g_object_unref (view);
+}
+
+#define BENCH_PROJECT_DIRS 100
+#define BENCH_PROJECT_FILES 100
+#define BENCH_PROJECT_QUERIES 100
+
+static struct {
+    gstr folder;
+} bench_data;
+
+static void
+bench_file_index_setup (void)
+{
+    guint d, f;
+
+    bench_data.folder = g::build_filename (test_data.working_dir, "bench-project");
+    write_project_file (bench_data.folder.get(), ".git/HEAD");
+
+    for (d = 0; d < BENCH_PROJECT_DIRS; ++d)
+    {
+        for (f = 0; f < BENCH_PROJECT_FILES; ++f)
+        {
+            gstr path = gstr::take (g_strdup_printf ("module%u/file%u.c", d, f));
+            write_project_file (bench_data.folder.get(), path.get());
+        }
+    }
+}
+
+static void
+bench_file_index_cleanup (void)
+{
+    _moo_file_index_shutdown ();
+    bench_data.folder.clear();
+}
+
+/* walking the whole tree, then a few Quick Open queries */
+static void
+bench_file_index (void)
+{
+    MooFileIndex *index;
+    guint i;
+
+    _moo_file_index_shutdown ();
+    index = _moo_file_index_get (bench_data.folder.get());
+    TEST_ASSERT (file_index_wait (index));
+    TEST_ASSERT_INT_EQ (_moo_file_index_get_n_files (index), BENCH_PROJECT_DIRS * BENCH_PROJECT_FILES);
+
+    for (i = 0; i < BENCH_PROJECT_QUERIES; ++i)
+    {
+        gstr pattern = gstr::take (g_strdup_printf ("mod%ufile%u", i % BENCH_PROJECT_DIRS, i % BENCH_PROJECT_FILES));
+        char **paths = _moo_file_index_match (index, pattern.get(), 100);
+        TEST_ASSERT (paths != NULL && paths[0] != NULL);
+        g_strfreev (paths);
+    }
+}
+
+static gboolean
+test_suite_init (G_GNUC_UNUSED gpointer data)
+{
+    mgw_errno_t err;
+
+    test_data.working_dir = g::build_filename (moo_test_get_working_dir (), "plugins-work");
+
+    if (_moo_mkdir_with_parents (test_data.working_dir.get(), &err) != 0)
+    {
+        g_critical ("could not create directory '%s': %s",
+                    test_data.working_dir.get(),
+                    mgw_strerror (err));
+        test_data.working_dir.clear();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+test_suite_cleanup (G_GNUC_UNUSED gpointer data)
+{
+    GError *error = NULL;
+
+    if (!_moo_remove_dir (test_data.working_dir.get(), TRUE, &error))
+    {
+        g_critical ("could not remove directory '%s': %s",
+                    test_data.working_dir.get(), error->message);
+        g_error_free (error);
+    }
+
+    test_data.working_dir.clear();
+}
+
+void
+moo_test_plugins (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("Plugins",
+                                              "plugins",
+                                              test_suite_init,
+                                              test_suite_cleanup,
+                                              NULL);
+
+    moo_test_suite_add_test (suite, "lazy-doc-plugins", "attaching plugins to documents restored from session",
+                             (MooTestFunc) test_lazy_doc_plugins, NULL);
+    moo_test_suite_add_test (suite, "deferred-modules", "loading plugin modules on first use",
+                             (MooTestFunc) test_deferred_modules, NULL);
+    moo_test_suite_add_test (suite, "file-index", "Quick Open file index of a project",
+                             (MooTestFunc) test_file_index, NULL);
+    moo_test_suite_add_test (suite, "line-view", "output pane line limit",
+                             (MooTestFunc) test_line_view, NULL);
+
+    moo_test_suite_add_bench (suite, "file-index", "indexing a project of ten thousand files",
+                              (MooTestFunc) bench_file_index, (MooTestFunc) bench_file_index_setup,
+                              (MooTestFunc) bench_file_index_cleanup, NULL);
+}
@@ -6,6 +6,9 @@
 #define MOO_EDIT_WINDOW_OUTPUT "moo-edit-window-output"
 #define MOO_OUTPUT "moo-output"
 
+/* older lines of long build logs are dropped */
+#define OUTPUT_MAX_LINES 100000
+
 /**
  * moo_edit_window_get_output:
  *
@@ -38,6 +41,7 @@ moo_edit_window_get_output (MooEditWindow *window)
 
         cmd_view = moo_cmd_view_new ();
         moo_text_view_set_font_from_string (MOO_TEXT_VIEW (cmd_view), "Monospace");
+        moo_line_view_set_max_lines (MOO_LINE_VIEW (cmd_view), OUTPUT_MAX_LINES);
         gtk_container_add (GTK_CONTAINER (scrolled_window), cmd_view);
         gtk_widget_show_all (scrolled_window);
         g_object_set_data (G_OBJECT (scrolled_window), MOO_OUTPUT, cmd_view);
@@ -22,13 +22,47 @@
 #include "mooutils/mooutils-gobject.h"
 #include "mooutils/mooutils-messages.h"
 #include "mooutils/moocompat.h"
+#include "mooutils/mooi18n.h"
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
+#include <string.h>
+
+/* Output is accumulated in a pending buffer and inserted into the text
+ * buffer at most every FLUSH_INTERVAL milliseconds, or right away once
+ * it grows past MAX_PENDING_SIZE bytes. */
+#define FLUSH_INTERVAL      30
+#define MAX_PENDING_SIZE    (1024 * 1024)
+
+typedef struct {
+    gpointer data;
+    GDestroyNotify destroy;
+    GValue value;
+    MooTextCursor cursor;
+} LineData;
 
+typedef struct {
+    guint start;        /* char offsets in pending text */
+    guint end;
+    GtkTextTag *tag;
+} PendingTag;
 
 struct _MooLineViewPrivate {
-    MooData *line_data;
-    GHashTable *cursors;
+    /* LineData for line n is lines[first + n - header], NULL if there
+     * is none; header is 1 if lines were dropped, 0 otherwise */
+    GPtrArray *lines;
+    guint first;
+
+    GString *pending;
+    guint pending_chars;
+    GArray *pending_tags;
+    guint flush_id;
+
+    int n_lines;            /* including pending text */
+    gboolean at_line_start;
+    int max_lines;
+    guint dropped;          /* lines removed from the top, the first
+                               line says how many */
+
     gboolean busy;
     gboolean scrolled;
     GtkTextMark *end_mark;
@@ -128,10 +162,16 @@ moo_line_view_init (MooLineView *view)
     view->priv = G_TYPE_INSTANCE_GET_PRIVATE (view, MOO_TYPE_LINE_VIEW, MooLineViewPrivate);
 
     view->priv->hscrollbar = NULL;
-    view->priv->line_data = _moo_data_new (g_direct_hash,
-                                           g_direct_equal,
-                                           NULL);
-    view->priv->cursors = g_hash_table_new (g_direct_hash, g_direct_equal);
+    view->priv->lines = g_ptr_array_new ();
+    view->priv->first = 0;
+    view->priv->pending = g_string_new (NULL);
+    view->priv->pending_chars = 0;
+    view->priv->pending_tags = g_array_new (FALSE, FALSE, sizeof (PendingTag));
+    view->priv->flush_id = 0;
+    view->priv->n_lines = 1;
+    view->priv->at_line_start = TRUE;
+    view->priv->max_lines = 0;
+    view->priv->dropped = 0;
 
     g_object_set (view,
                   "editable", FALSE,
@@ -142,13 +182,134 @@ moo_line_view_init (MooLineView *view)
 }
 
 
+static void
+line_data_free (LineData *ld)
+{
+    if (ld)
+    {
+        if (ld->data && ld->destroy)
+            ld->destroy (ld->data);
+        if (G_IS_VALUE (&ld->value))
+            g_value_unset (&ld->value);
+        g_slice_free (LineData, ld);
+    }
+}
+
+static void
+clear_line_data (MooLineView *view)
+{
+    guint i;
+
+    for (i = view->priv->first; i < view->priv->lines->len; ++i)
+        line_data_free ((LineData*) g_ptr_array_index (view->priv->lines, i));
+
+    g_ptr_array_set_size (view->priv->lines, 0);
+    view->priv->first = 0;
+}
+
+/* forgets data for lines [0, n_lines), moving the rest up */
+static void
+drop_line_data (MooLineView *view,
+                guint        n_lines)
+{
+    GPtrArray *lines = view->priv->lines;
+    guint i, last;
+
+    last = MIN (view->priv->first + n_lines, lines->len);
+
+    for (i = view->priv->first; i < last; ++i)
+        line_data_free ((LineData*) g_ptr_array_index (lines, i));
+
+    view->priv->first = last;
+
+    if (view->priv->first == lines->len)
+    {
+        g_ptr_array_set_size (lines, 0);
+        view->priv->first = 0;
+    }
+    else if (view->priv->first > lines->len / 2)
+    {
+        g_ptr_array_remove_range (lines, 0, view->priv->first);
+        view->priv->first = 0;
+    }
+}
+
+static int
+header_lines (MooLineView *view)
+{
+    return view->priv->dropped ? 1 : 0;
+}
+
+static LineData *
+get_line_data (MooLineView *view,
+               int          line,
+               gboolean     create)
+{
+    GPtrArray *lines = view->priv->lines;
+    guint index;
+    LineData *ld;
+
+    /* the line saying how many lines were dropped has no data */
+    if (line < header_lines (view))
+        return NULL;
+
+    index = view->priv->first + line - header_lines (view);
+
+    if (index >= lines->len)
+    {
+        if (!create)
+            return NULL;
+        g_ptr_array_set_size (lines, index + 1);
+    }
+
+    ld = (LineData*) g_ptr_array_index (lines, index);
+
+    if (!ld && create)
+    {
+        ld = g_slice_new0 (LineData);
+        g_ptr_array_index (lines, index) = ld;
+    }
+
+    return ld;
+}
+
+static void
+line_data_check_empty (MooLineView *view,
+                       int          line,
+                       LineData    *ld)
+{
+    if (!ld->data && !G_IS_VALUE (&ld->value) && !ld->cursor)
+    {
+        line_data_free (ld);
+        g_ptr_array_index (view->priv->lines, view->priv->first + line - header_lines (view)) = NULL;
+    }
+}
+
+static void
+line_data_unset (LineData *ld)
+{
+    if (ld->data && ld->destroy)
+        ld->destroy (ld->data);
+    ld->data = NULL;
+    ld->destroy = NULL;
+
+    if (G_IS_VALUE (&ld->value))
+        g_value_unset (&ld->value);
+}
+
+
 static void
 moo_line_view_finalize (GObject *object)
 {
     MooLineView *view = MOO_LINE_VIEW (object);
 
-    _moo_data_destroy (view->priv->line_data);
-    g_hash_table_destroy (view->priv->cursors);
+    if (view->priv->flush_id)
+        g_source_remove (view->priv->flush_id);
+
+    clear_line_data (view);
+    g_ptr_array_free (view->priv->lines, TRUE);
+    g_string_free (view->priv->pending, TRUE);
+    g_array_free (view->priv->pending_tags, TRUE);
 
     G_OBJECT_CLASS (moo_line_view_parent_class)->finalize (object);
 }
@@ -188,12 +349,22 @@ moo_line_view_clear (MooLineView *view)
 
     g_return_if_fail (MOO_IS_LINE_VIEW (view));
 
+    if (view->priv->flush_id)
+        g_source_remove (view->priv->flush_id);
+    view->priv->flush_id = 0;
+
+    g_string_truncate (view->priv->pending, 0);
+    g_array_set_size (view->priv->pending_tags, 0);
+    view->priv->pending_chars = 0;
+
     buffer = get_buffer (view);
     gtk_text_buffer_get_bounds (buffer, &start, &end);
     gtk_text_buffer_delete (buffer, &start, &end);
 
-    _moo_data_clear (view->priv->line_data);
-    g_hash_table_remove_all (view->priv->cursors);
+    clear_line_data (view);
+    view->priv->n_lines = 1;
+    view->priv->at_line_start = TRUE;
+    view->priv->dropped = 0;
 }
 
 
@@ -364,6 +535,7 @@ moo_line_view_get_text_cursor (MooTextView    *view,
     int line_y, line_height;
     int line;
     MooTextCursor cursor;
+    LineData *ld;
 
     if (x < 0 || y < 0)
         return MOO_TEXT_CURSOR_ARROW;
@@ -377,7 +549,8 @@ moo_line_view_get_text_cursor (MooTextView    *view,
         return MOO_TEXT_CURSOR_ARROW;
 
     line = gtk_text_iter_get_line (&iter);
-    cursor = (MooTextCursor) GPOINTER_TO_INT (g_hash_table_lookup (MOO_LINE_VIEW (view)->priv->cursors, GINT_TO_POINTER (line)));
+    ld = get_line_data (MOO_LINE_VIEW (view), line, FALSE);
+    cursor = ld ? ld->cursor : (MooTextCursor) 0;
 
     return cursor ? cursor : MOO_TEXT_CURSOR_ARROW;
 }
@@ -387,13 +560,16 @@ moo_line_view_set_cursor (MooLineView    *view,
                           int             line,
                           MooTextCursor   cursor)
 {
+    LineData *ld;
+
     g_return_if_fail (MOO_IS_LINE_VIEW (view));
-    g_return_if_fail (line >= 0 && line < gtk_text_buffer_get_line_count (get_buffer (view)));
+    g_return_if_fail (line >= 0 && line < view->priv->n_lines);
 
-    if (cursor)
-        g_hash_table_insert (view->priv->cursors, GINT_TO_POINTER (line), GINT_TO_POINTER (cursor));
-    else
-        g_hash_table_remove (view->priv->cursors, GINT_TO_POINTER (line));
+    if ((ld = get_line_data (view, line, cursor != 0)))
+    {
+        ld->cursor = cursor;
+        line_data_check_empty (view, line, ld);
+    }
 }
 
 
@@ -403,15 +579,18 @@ moo_line_view_set_data (MooLineView    *view,
                         gpointer        data,
                         GDestroyNotify  free_func)
 {
+    LineData *ld;
+
     g_return_if_fail (MOO_IS_LINE_VIEW (view));
-    g_return_if_fail (line >= 0 && line < gtk_text_buffer_get_line_count (get_buffer (view)));
+    g_return_if_fail (line >= 0 && line < view->priv->n_lines);
 
-    if (data)
-        _moo_data_insert_ptr (view->priv->line_data,
-                              GINT_TO_POINTER (line),
-                              data, free_func);
-    else
-        _moo_data_remove (view->priv->line_data, GINT_TO_POINTER (line));
+    if ((ld = get_line_data (view, line, data != NULL)))
+    {
+        line_data_unset (ld);
+        ld->data = data;
+        ld->destroy = free_func;
+        line_data_check_empty (view, line, ld);
+    }
 }
 
 
@@ -419,10 +598,13 @@ gpointer
 moo_line_view_get_data (MooLineView    *view,
                         int             line)
 {
+    LineData *ld;
+
     g_return_val_if_fail (MOO_IS_LINE_VIEW (view), NULL);
     g_return_val_if_fail (line >= 0, NULL);
-    return _moo_data_get_ptr (view->priv->line_data,
-                              GINT_TO_POINTER (line));
+
+    ld = get_line_data (view, line, FALSE);
+    return ld ? ld->data : NULL;
 }
 
 
@@ -540,23 +722,63 @@ check_if_scrolled (MooLineView *view)
 int
 moo_line_view_start_line (MooLineView *view)
 {
-    GtkTextBuffer *buffer;
-    GtkTextIter iter;
-
     g_return_val_if_fail (MOO_IS_LINE_VIEW (view), -1);
     g_return_val_if_fail (!view->priv->busy, -1);
 
     view->priv->busy = TRUE;
 
-    buffer = get_buffer (view);
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    if (!view->priv->at_line_start)
+    {
+        g_string_append_c (view->priv->pending, '\n');
+        view->priv->pending_chars += 1;
+        view->priv->n_lines += 1;
+        view->priv->at_line_start = TRUE;
+    }
 
-    check_if_scrolled (view);
+    return view->priv->n_lines - 1;
+}
 
-    if (!gtk_text_iter_starts_line (&iter))
-        gtk_text_buffer_insert (buffer, &iter, "\n", 1);
 
-    return gtk_text_iter_get_line (&iter);
+static void
+append_pending (MooLineView    *view,
+                const char     *text,
+                gsize           len,
+                GtkTextTag     *tag)
+{
+    guint n_chars;
+    const char *p, *end;
+
+    if (!len)
+        return;
+
+    n_chars = g_utf8_strlen (text, len);
+
+    if (tag)
+    {
+        GArray *tags = view->priv->pending_tags;
+        PendingTag *last = tags->len ? &g_array_index (tags, PendingTag, tags->len - 1) : NULL;
+
+        if (last && last->tag == tag && last->end == view->priv->pending_chars)
+        {
+            last->end += n_chars;
+        }
+        else
+        {
+            PendingTag pt;
+            pt.start = view->priv->pending_chars;
+            pt.end = pt.start + n_chars;
+            pt.tag = tag;
+            g_array_append_val (tags, pt);
+        }
+    }
+
+    g_string_append_len (view->priv->pending, text, len);
+    view->priv->pending_chars += n_chars;
+
+    for (p = text, end = text + len; (p = (const char*) memchr (p, '\n', end - p)); ++p)
+        view->priv->n_lines += 1;
+
+    view->priv->at_line_start = text[len - 1] == '\n';
 }
 
 
@@ -566,26 +788,23 @@ moo_line_view_write (MooLineView    *view,
                      int             len,
                      GtkTextTag     *tag)
 {
-    GtkTextBuffer *buffer;
-    GtkTextIter iter;
-
     g_return_if_fail (MOO_IS_LINE_VIEW (view));
     g_return_if_fail (text != NULL);
     g_return_if_fail (view->priv->busy);
 
-    buffer = get_buffer (view);
-    gtk_text_buffer_get_end_iter (buffer, &iter);
+    if (len < 0)
+        len = strlen (text);
 
     if (g_utf8_validate (text, len, NULL))
     {
-        gtk_text_buffer_insert_with_tags (buffer, &iter, text, len, tag, nullptr);
+        append_pending (view, text, len, tag);
     }
     else
     {
         char *text_utf8 = g_locale_to_utf8 (text, len, NULL, NULL, NULL);
 
         if (text_utf8)
-            gtk_text_buffer_insert_with_tags (buffer, &iter, text_utf8, -1, tag, nullptr);
+            append_pending (view, text_utf8, strlen (text_utf8), tag);
         else
             g_warning ("could not convert '%s' to utf8", text);
 
@@ -613,6 +832,92 @@ get_end_mark (MooLineView *view)
 }
 
 
+/* Removes lines from the top so that at most max_lines remain, and
+ * puts a line saying how many lines were removed in their place. Line
+ * numbers change after this, so it is only done when flushing, never
+ * while a caller may hold a line number returned by start_line(). */
+static void
+trim_scrollback (MooLineView *view)
+{
+    GtkTextBuffer *buffer;
+    GtkTextIter start, end;
+    int header = header_lines (view);
+    int drop;
+    char *text;
+
+    if (view->priv->max_lines <= 0 ||
+        view->priv->n_lines - header <= view->priv->max_lines + view->priv->max_lines / 8)
+            return;
+
+    drop = view->priv->n_lines - header - view->priv->max_lines;
+
+    buffer = get_buffer (view);
+    gtk_text_buffer_get_start_iter (buffer, &start);
+    gtk_text_buffer_get_iter_at_line (buffer, &end, header + drop);
+    gtk_text_buffer_delete (buffer, &start, &end);
+
+    drop_line_data (view, drop);
+    view->priv->n_lines += 1 - header - drop;
+    view->priv->dropped += drop;
+
+    text = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                       "[%u line dropped]\n",
+                                       "[%u lines dropped]\n",
+                                       view->priv->dropped),
+                            view->priv->dropped);
+    gtk_text_buffer_get_start_iter (buffer, &start);
+    gtk_text_buffer_insert (buffer, &start, text, -1);
+    g_free (text);
+}
+
+static void
+flush_pending (MooLineView *view)
+{
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    int offset;
+    guint i;
+
+    if (!view->priv->pending->len)
+        return;
+
+    buffer = get_buffer (view);
+
+    check_if_scrolled (view);
+
+    gtk_text_buffer_get_end_iter (buffer, &iter);
+    offset = gtk_text_iter_get_offset (&iter);
+    gtk_text_buffer_insert (buffer, &iter,
+                            view->priv->pending->str,
+                            view->priv->pending->len);
+
+    for (i = 0; i < view->priv->pending_tags->len; ++i)
+    {
+        PendingTag *pt = &g_array_index (view->priv->pending_tags, PendingTag, i);
+        GtkTextIter start, end;
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, offset + pt->start);
+        gtk_text_buffer_get_iter_at_offset (buffer, &end, offset + pt->end);
+        gtk_text_buffer_apply_tag (buffer, pt->tag, &start, &end);
+    }
+
+    g_string_truncate (view->priv->pending, 0);
+    g_array_set_size (view->priv->pending_tags, 0);
+    view->priv->pending_chars = 0;
+
+    if (!view->priv->scrolled)
+        gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (view),
+                                            get_end_mark (view));
+}
+
+static gboolean
+flush_timeout (MooLineView *view)
+{
+    view->priv->flush_id = 0;
+    flush_pending (view);
+    trim_scrollback (view);
+    return FALSE;
+}
+
 void
 moo_line_view_end_line (MooLineView    *view)
 {
@@ -621,9 +926,64 @@ moo_line_view_end_line (MooLineView    *view)
 
     view->priv->busy = FALSE;
 
-    if (!view->priv->scrolled)
-        gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (view),
-                                            get_end_mark (view));
+    if (view->priv->pending->len >= MAX_PENDING_SIZE)
+        flush_pending (view);
+
+    if (view->priv->pending->len ||
+        (view->priv->max_lines > 0 &&
+         view->priv->n_lines - header_lines (view) > view->priv->max_lines))
+    {
+        if (!view->priv->flush_id)
+            view->priv->flush_id = g_timeout_add (FLUSH_INTERVAL,
+                                                  (GSourceFunc) flush_timeout,
+                                                  view);
+    }
+}
+
+/**
+ * moo_line_view_flush:
+ *
+ * Inserts text written so far into the text buffer, and drops lines
+ * over the limit set with moo_line_view_set_max_lines(). Output is
+ * normally inserted in batches from a timeout; call this when the buffer
+ * contents are needed right away.
+ */
+void
+moo_line_view_flush (MooLineView *view)
+{
+    g_return_if_fail (MOO_IS_LINE_VIEW (view));
+    g_return_if_fail (!view->priv->busy);
+    flush_pending (view);
+    trim_scrollback (view);
+}
+
+/**
+ * moo_line_view_set_max_lines:
+ *
+ * @view:
+ * @max_lines: maximum number of lines kept, zero for no limit.
+ *
+ * There is no limit by default. Lines removed from the top to keep the
+ * view within the limit lose their data, and line numbers of the
+ * remaining lines shift accordingly. The first line then says how many
+ * lines were dropped.
+ */
+void
+moo_line_view_set_max_lines (MooLineView *view,
+                             int          max_lines)
+{
+    g_return_if_fail (MOO_IS_LINE_VIEW (view));
+    view->priv->max_lines = MAX (max_lines, 0);
+}
+
+/**
+ * moo_line_view_get_max_lines:
+ **/
+int
+moo_line_view_get_max_lines (MooLineView *view)
+{
+    g_return_val_if_fail (MOO_IS_LINE_VIEW (view), 0);
+    return view->priv->max_lines;
 }
 
 
@@ -669,17 +1029,24 @@ moo_line_view_set_line_data (MooLineView    *view,
                              int             line,
                              const GValue   *data)
 {
+    LineData *ld;
+
     g_return_if_fail (MOO_IS_LINE_VIEW (view));
-    g_return_if_fail (line >= 0);
+    g_return_if_fail (line >= 0 && line < view->priv->n_lines);
     g_return_if_fail (!data || G_IS_VALUE (data));
 
-    if (data)
-        _moo_data_insert_value (view->priv->line_data,
-                                GINT_TO_POINTER (line),
-                                data);
-    else
-        _moo_data_remove (view->priv->line_data,
-                          GINT_TO_POINTER (line));
+    if ((ld = get_line_data (view, line, data != NULL)))
+    {
+        line_data_unset (ld);
+
+        if (data)
+        {
+            g_value_init (&ld->value, G_VALUE_TYPE (data));
+            g_value_copy (data, &ld->value);
+        }
+
+        line_data_check_empty (view, line, ld);
+    }
 }
 
 
@@ -716,12 +1083,20 @@ moo_line_view_get_line_data (MooLineView    *view,
                              int             line,
                              GValue         *dest)
 {
+    LineData *ld;
+
     g_return_val_if_fail (MOO_IS_LINE_VIEW (view), FALSE);
     g_return_val_if_fail (line >= 0, FALSE);
     g_return_val_if_fail (!G_IS_VALUE (dest), FALSE);
-    return _moo_data_get_value (view->priv->line_data,
-                                GINT_TO_POINTER (line),
-                                dest);
+
+    ld = get_line_data (view, line, FALSE);
+
+    if (!ld || !G_IS_VALUE (&ld->value))
+        return FALSE;
+
+    g_value_init (dest, G_VALUE_TYPE (&ld->value));
+    g_value_copy (&ld->value, dest);
+    return TRUE;
 }
 
 
@@ -88,6 +88,7 @@ void        moo_line_view_write         (MooLineView    *view,
                                          int             len,
                                          GtkTextTag     *tag);
 void        moo_line_view_end_line      (MooLineView    *view);
+void        moo_line_view_flush         (MooLineView    *view);
 
 int         moo_line_view_write_line    (MooLineView    *view,
                                          const char     *text,
@@ -98,6 +99,10 @@ void        moo_line_view_set_cursor    (MooLineView    *view,
                                          int             line,
                                          MooTextCursor   cursor);
 
+void        moo_line_view_set_max_lines (MooLineView    *view,
+                                         int             max_lines);
+int         moo_line_view_get_max_lines (MooLineView    *view);
+
 
 G_END_DECLS
 
@@ -1,3 +1,30 @@
+-- Returns two functions. The first one prepares a compiled tool chunk
+-- for running. Each run gets its own globals table, so that interpreter
+-- states can be reused between tool invocations without leaking globals.
+-- doc and window are real globals, so that code loaded by the tool sees
+-- them. The second one is called after the run and drops everything the
+-- run referenced, so that it can be collected.
 local _g = getfenv(0)
-_g.doc = _g.editor.get_active_doc()
-_g.window = _g.editor.get_active_window()
+local setfenv, setmetatable = setfenv, setmetatable
+local env_meta = { __index = _g }
+local current
+
+local function setup(chunk)
+  _g.doc = _g.editor.get_active_doc()
+  _g.window = _g.editor.get_active_window()
+  setfenv(chunk, setmetatable({}, env_meta))
+  current = chunk
+  return chunk
+end
+
+local function finish()
+  -- compiled chunks are cached, they must not keep the globals table
+  if current then
+    setfenv(current, _g)
+    current = nil
+  end
+  _g.doc = nil
+  _g.window = nil
+end
+
+return setup, finish
@@ -18,6 +18,7 @@
 #endif
 #include "moocommand-exe.h"
 #include "mooedit/mooeditor.h"
+#include "mooedit/mooedit-impl.h"
 #include "mooedit/mooedit-script.h"
 #include "../support/moocmdview.h"
 #include "../support/mooeditwindowoutput.h"
@@ -31,12 +32,18 @@
 #include "plugins/usertools/mooedittools-exe-gxml.h"
 #include <gtk/gtk.h>
 #include <string.h>
+#include <stdlib.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 #ifdef __WIN32__
 #include <io.h>
+#else
+#include <sys/wait.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
 #endif
 
 #ifndef __WIN32__
@@ -52,6 +59,11 @@
 #define MOO_COMMAND_EXE_INPUT_DEFAULT   MOO_COMMAND_EXE_INPUT_NONE
 #define MOO_COMMAND_EXE_OUTPUT_DEFAULT  MOO_COMMAND_EXE_OUTPUT_NONE
 
+/* characters of input taken from the document at once */
+#define EXE_JOB_INPUT_CHUNK             (64 * 1024)
+#define EXE_JOB_READ_CHUNK              (64 * 1024)
+#define EXE_JOB_PROGRESS_INTERVAL       500
+
 typedef enum
 {
     MOO_COMMAND_EXE_INPUT_NONE,
@@ -110,11 +122,12 @@ enum {
     KEY_INPUT,
     KEY_OUTPUT,
     KEY_FILTER,
+    KEY_TIMEOUT,
     N_KEYS
 };
 
 static const char *data_keys[N_KEYS+1] = {
-    "input", "output", "filter", NULL
+    "input", "output", "filter", "timeout", NULL
 };
 
 struct _MooCommandExePrivate {
@@ -122,6 +135,9 @@ struct _MooCommandExePrivate {
     MooCommandExeInput input;
     MooCommandExeOutput output;
     char *filter;
+    /* seconds, from the 'timeout' option of the tool; 0, the default,
+     * lets the command run until it exits or is cancelled */
+    guint timeout;
 };
 
 G_DEFINE_TYPE (MooCommandExe, _moo_command_exe, MOO_TYPE_COMMAND)
@@ -152,25 +168,33 @@ moo_command_exe_finalize (GObject *object)
 }
 
 
-static char *
-get_lines (MooEdit  *doc,
-           gboolean  select_them)
+static void
+get_lines_bounds (MooEdit     *doc,
+                  GtkTextIter *start,
+                  GtkTextIter *end,
+                  gboolean     select_them)
 {
     GtkTextBuffer *buffer;
-    GtkTextIter start, end;
 
     buffer = moo_edit_get_buffer (doc);
-    gtk_text_buffer_get_selection_bounds (buffer, &start, &end);
+    gtk_text_buffer_get_selection_bounds (buffer, start, end);
 
-    gtk_text_iter_set_line_offset (&start, 0);
+    gtk_text_iter_set_line_offset (start, 0);
 
-    if (!gtk_text_iter_starts_line (&end) || gtk_text_iter_equal (&start, &end))
-        gtk_text_iter_forward_line (&end);
+    if (!gtk_text_iter_starts_line (end) || gtk_text_iter_equal (start, end))
+        gtk_text_iter_forward_line (end);
 
     if (select_them)
-        gtk_text_buffer_select_range (buffer, &end, &start);
+        gtk_text_buffer_select_range (buffer, end, start);
+}
 
-    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+static char *
+get_lines (MooEdit  *doc,
+           gboolean  select_them)
+{
+    GtkTextIter start, end;
+    get_lines_bounds (doc, &start, &end, select_them);
+    return gtk_text_buffer_get_slice (moo_edit_get_buffer (doc), &start, &end, TRUE);
 }
 
 static char *
@@ -709,14 +733,588 @@ run_command_async (MooCommandExe     *cmd,
 }
 
 
+/*************************************************************************/
+/* Filters
+ *
+ * Commands whose output goes into a document run asynchronously: input
+ * is fed to the child from the document in chunks as the pipe accepts
+ * it, output is collected as it arrives, and the result replaces the
+ * input in a single user action when the command exits successfully.
+ * The document is busy while the command runs, the progress widget in
+ * its tab shows status and may be used to cancel it.
+ */
+
+typedef struct {
+    MooCommandExeOutput output_type;
+    MooEditWindow *window;
+    MooEdit *doc;               /* document the input is taken from or output goes to */
+    gboolean busy;              /* we put doc into the busy state */
+
+    GtkTextMark *start;         /* text which is replaced by output */
+    GtkTextMark *end;
+    GtkTextMark *input_pos;     /* input which is not sent yet */
+    GtkTextMark *input_end;
+
+    char *cmd_line;
+    GPid pid;
+    int exit_status;
+    gboolean exited;
+    gboolean cancelled;
+    gboolean timed_out;
+
+    GIOChannel *in_io;
+    GIOChannel *out_io;
+    GIOChannel *err_io;
+    guint in_watch;
+    guint out_watch;
+    guint err_watch;
+    guint child_watch;
+    guint timeout;
+    guint progress_timeout;
+
+    char *input;                /* chunk being written */
+    gsize input_len;
+    gsize input_written;
+    guint64 bytes_in;
+
+    GString *output;
+    GString *errors;
+} ExeJob;
+
+static void     exe_job_check_done      (ExeJob     *job);
+
+static void
+exe_job_free (ExeJob *job)
+{
+    if (job->window)
+        g_object_remove_weak_pointer (G_OBJECT (job->window), (gpointer*) &job->window);
+
+    if (job->doc)
+    {
+        GtkTextBuffer *buffer = moo_edit_get_buffer (job->doc);
+
+        if (job->start)
+            gtk_text_buffer_delete_mark (buffer, job->start);
+        if (job->end)
+            gtk_text_buffer_delete_mark (buffer, job->end);
+        if (job->input_pos)
+            gtk_text_buffer_delete_mark (buffer, job->input_pos);
+        if (job->input_end)
+            gtk_text_buffer_delete_mark (buffer, job->input_end);
+
+        g_object_unref (job->doc);
+    }
+
+    g_free (job->input);
+    g_free (job->cmd_line);
+    g_string_free (job->output, TRUE);
+    g_string_free (job->errors, TRUE);
+    g_slice_free (ExeJob, job);
+}
+
+static void
+exe_job_message (ExeJob     *job,
+                 const char *text)
+{
+    if (job->window)
+        moo_window_message (MOO_WINDOW (job->window), text);
+}
+
+static gboolean
+exe_job_update_progress (ExeJob *job)
+{
+    char *text;
+
+    text = g_strdup_printf (_("Running '%s': %lu KB in, %lu KB out"),
+                            job->cmd_line,
+                            (gulong) (job->bytes_in / 1024),
+                            (gulong) (job->output->len / 1024));
+
+    if (job->busy)
+        _moo_edit_set_progress_text (job->doc, text);
+    else
+        exe_job_message (job, text);
+
+    g_free (text);
+    return TRUE;
+}
+
+static void
+exe_job_kill (ExeJob *job)
+{
+    if (job->exited)
+        return;
+
+#ifndef __WIN32__
+    kill (-job->pid, SIGHUP);
+#else
+    TerminateProcess (job->pid, 1);
+#endif
+}
+
+static void
+exe_job_cancel (ExeJob *job)
+{
+    job->cancelled = TRUE;
+    exe_job_kill (job);
+}
+
+static gboolean
+exe_job_timed_out (ExeJob *job)
+{
+    job->timeout = 0;
+    job->timed_out = TRUE;
+    exe_job_kill (job);
+    return FALSE;
+}
+
+static void
+exe_job_close_input (ExeJob *job)
+{
+    if (job->in_watch)
+        g_source_remove (job->in_watch);
+    job->in_watch = 0;
+
+    if (job->in_io)
+    {
+        g_io_channel_shutdown (job->in_io, FALSE, NULL);
+        g_io_channel_unref (job->in_io);
+        job->in_io = NULL;
+    }
+}
+
+/* takes next piece of input from the document */
+static gboolean
+exe_job_fetch_input (ExeJob *job)
+{
+    GtkTextBuffer *buffer;
+    GtkTextIter start, end, limit;
+
+    if (!job->input_pos)
+        return FALSE;
+
+    buffer = moo_edit_get_buffer (job->doc);
+    gtk_text_buffer_get_iter_at_mark (buffer, &start, job->input_pos);
+    gtk_text_buffer_get_iter_at_mark (buffer, &limit, job->input_end);
+
+    if (gtk_text_iter_compare (&start, &limit) >= 0)
+        return FALSE;
+
+    end = start;
+    gtk_text_iter_forward_chars (&end, EXE_JOB_INPUT_CHUNK);
+    if (gtk_text_iter_compare (&end, &limit) > 0)
+        end = limit;
+
+    g_free (job->input);
+    job->input = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+    job->input_len = strlen (job->input);
+    job->input_written = 0;
+
+    gtk_text_buffer_move_mark (buffer, job->input_pos, &end);
+    return TRUE;
+}
+
+#ifndef __WIN32__
+/* the child may exit or close its stdin before reading everything,
+ * writing to the pipe must not kill us with SIGPIPE */
+static gssize
+write_no_sigpipe (int         fd,
+                  const char *buf,
+                  gsize       len)
+{
+    sigset_t pipe_set, old_set;
+    gssize n;
+    int saved_errno;
+
+    sigemptyset (&pipe_set);
+    sigaddset (&pipe_set, SIGPIPE);
+    pthread_sigmask (SIG_BLOCK, &pipe_set, &old_set);
+
+    n = write (fd, buf, len);
+    saved_errno = errno;
+
+    if (n < 0 && saved_errno == EPIPE && !sigismember (&old_set, SIGPIPE))
+    {
+        sigset_t pending;
+        int sig;
+
+        sigemptyset (&pending);
+        if (sigpending (&pending) == 0 && sigismember (&pending, SIGPIPE))
+            sigwait (&pipe_set, &sig);
+    }
+
+    pthread_sigmask (SIG_SETMASK, &old_set, NULL);
+    errno = saved_errno;
+    return n;
+}
+#endif
+
+static gboolean
+exe_job_write_input (G_GNUC_UNUSED GIOChannel *channel,
+                     GIOCondition  condition,
+                     ExeJob       *job)
+{
+    if (condition & (G_IO_ERR | G_IO_HUP))
+        goto done;
+
+    while (TRUE)
+    {
+        gsize written = 0;
+
+        if (job->input_written == job->input_len && !exe_job_fetch_input (job))
+            goto done;
+
+#ifndef __WIN32__
+        {
+            gssize n = write_no_sigpipe (g_io_channel_unix_get_fd (job->in_io),
+                                         job->input + job->input_written,
+                                         job->input_len - job->input_written);
+
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+                return TRUE;
+            if (n < 0)
+                goto done;
+
+            written = n;
+        }
+#else
+        {
+            GIOStatus status = g_io_channel_write_chars (job->in_io,
+                                                         job->input + job->input_written,
+                                                         job->input_len - job->input_written,
+                                                         &written, NULL);
+            if (status == G_IO_STATUS_ERROR || status == G_IO_STATUS_EOF)
+                goto done;
+        }
+#endif
+
+        job->input_written += written;
+        job->bytes_in += written;
+
+        /* let the child do its work */
+        if (job->input_written < job->input_len)
+            return TRUE;
+    }
+
+done:
+    job->in_watch = 0;
+    exe_job_close_input (job);
+    return FALSE;
+}
+
+static gboolean
+exe_job_read (GIOChannel   *channel,
+              GIOCondition  condition,
+              ExeJob       *job)
+{
+    GString *dest = channel == job->out_io ? job->output : job->errors;
+    char buf[EXE_JOB_READ_CHUNK];
+    GIOStatus status;
+    gsize n = 0;
+
+    do
+    {
+        status = g_io_channel_read_chars (channel, buf, sizeof buf, &n, NULL);
+        g_string_append_len (dest, buf, n);
+    }
+    while (status == G_IO_STATUS_NORMAL && n == sizeof buf);
+
+    if (status == G_IO_STATUS_ERROR || status == G_IO_STATUS_EOF ||
+        (status != G_IO_STATUS_NORMAL && (condition & (G_IO_ERR | G_IO_HUP))))
+    {
+        if (channel == job->out_io)
+            job->out_watch = 0;
+        else
+            job->err_watch = 0;
+        exe_job_check_done (job);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+exe_job_child_exited (GPid    pid,
+                      int     status,
+                      ExeJob *job)
+{
+    g_spawn_close_pid (pid);
+    job->child_watch = 0;
+    job->exited = TRUE;
+    job->exit_status = status;
+    exe_job_check_done (job);
+}
+
+static gboolean
+exe_job_succeeded (ExeJob *job)
+{
+#ifndef __WIN32__
+    return WIFEXITED (job->exit_status) && WEXITSTATUS (job->exit_status) == 0;
+#else
+    return job->exit_status == 0;
+#endif
+}
+
+static char *
+get_output_utf8 (GString *output)
+{
+    const char *charset;
+
+    if (g_utf8_validate (output->str, output->len, NULL))
+        return g_strndup (output->str, output->len);
+
+    if (g_get_charset (&charset))
+        return NULL;
+
+    return g_convert_with_fallback (output->str, output->len, "UTF-8", charset,
+                                    NULL, NULL, NULL, NULL);
+}
+
+static void
+exe_job_apply_output (ExeJob *job)
+{
+    char *text;
+    MooEdit *doc;
+
+    if (!(text = get_output_utf8 (job->output)))
+    {
+        exe_job_message (job, _("Command output is not valid text"));
+        return;
+    }
+
+    if (job->output_type == MOO_COMMAND_EXE_OUTPUT_INSERT)
+    {
+        GtkTextBuffer *buffer = moo_edit_get_buffer (job->doc);
+        GtkTextIter start, end;
+
+        gtk_text_buffer_begin_user_action (buffer);
+        gtk_text_buffer_get_iter_at_mark (buffer, &start, job->start);
+        gtk_text_buffer_get_iter_at_mark (buffer, &end, job->end);
+        gtk_text_buffer_delete (buffer, &start, &end);
+        gtk_text_buffer_insert (buffer, &start, text, -1);
+        gtk_text_buffer_end_user_action (buffer);
+    }
+    else if ((doc = moo_editor_new_doc (moo_editor_instance (), job->window)))
+    {
+        insert_text (doc, text, FALSE);
+    }
+
+    exe_job_message (job, NULL);
+    g_free (text);
+}
+
+static void
+exe_job_check_done (ExeJob *job)
+{
+    if (!job->exited || job->out_watch || job->err_watch)
+        return;
+
+    exe_job_close_input (job);
+
+    if (job->timeout)
+        g_source_remove (job->timeout);
+    if (job->progress_timeout)
+        g_source_remove (job->progress_timeout);
+    job->timeout = 0;
+    job->progress_timeout = 0;
+
+    if (job->out_io)
+        g_io_channel_unref (job->out_io);
+    if (job->err_io)
+        g_io_channel_unref (job->err_io);
+    job->out_io = NULL;
+    job->err_io = NULL;
+
+    if (job->busy)
+        _moo_edit_set_state (job->doc, MOO_EDIT_STATE_NORMAL, NULL, NULL, NULL);
+    job->busy = FALSE;
+
+    if (job->cancelled)
+    {
+        exe_job_message (job, _("Command cancelled"));
+    }
+    else if (job->timed_out)
+    {
+        exe_job_message (job, _("Command timed out"));
+    }
+    else if (!exe_job_succeeded (job))
+    {
+        char *first_line = g_strndup (job->errors->str, strcspn (job->errors->str, "\r\n"));
+        char *text = first_line[0] ?
+            g_strdup_printf (_("Command failed: %s"), first_line) :
+            g_strdup (_("Command failed"));
+        exe_job_message (job, text);
+        g_free (text);
+        g_free (first_line);
+    }
+    else
+    {
+        exe_job_apply_output (job);
+    }
+
+    exe_job_free (job);
+}
+
+#ifndef __WIN32__
+static void
+exe_job_child_setup (G_GNUC_UNUSED gpointer data)
+{
+    /* so that the command can be killed with all its children */
+    setpgid (0, 0);
+}
+#endif
+
+static GIOChannel *
+exe_job_channel_new (MgwFd  fd,
+                     guint *watch,
+                     GIOCondition condition,
+                     GIOFunc func,
+                     ExeJob *job)
+{
+    GIOChannel *channel = mgw_io_channel_unix_new (fd);
+
+    g_io_channel_set_encoding (channel, NULL, NULL);
+    g_io_channel_set_buffered (channel, FALSE);
+    g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+    g_io_channel_set_close_on_unref (channel, TRUE);
+    *watch = g_io_add_watch_full (channel, G_PRIORITY_DEFAULT_IDLE,
+                                  (GIOCondition) (condition | G_IO_ERR | G_IO_HUP),
+                                  func, job, NULL);
+
+    return channel;
+}
+
+static void
+run_command_filter (MooCommandExe     *cmd,
+                    MooCommandContext *ctx,
+                    const char        *working_dir,
+                    char             **envp)
+{
+    ExeJob *job;
+    MooEdit *doc;
+    MooEditWindow *window;
+    GtkTextBuffer *buffer = NULL;
+    GtkTextIter start, end;
+    GSpawnFlags flags = (GSpawnFlags) (RUN_CMD_FLAGS | MOO_SPAWN_WIN32_HIDDEN_CONSOLE |
+                                       G_SPAWN_DO_NOT_REAP_CHILD);
+    GError *error = NULL;
+    char **argv, **real_env;
+    MgwFd in_fd, out_fd, err_fd;
+    GPid pid;
+    gboolean result = FALSE;
+
+    doc = moo_command_context_get_doc (ctx);
+    window = moo_command_context_get_window (ctx);
+
+    /* no document is involved with output to a new document and no input */
+    if (cmd->priv->output != MOO_COMMAND_EXE_OUTPUT_INSERT &&
+        cmd->priv->input == MOO_COMMAND_EXE_INPUT_NONE)
+            doc = NULL;
+
+    g_return_if_fail (!doc || MOO_IS_EDIT (doc));
+    g_return_if_fail (doc || cmd->priv->output != MOO_COMMAND_EXE_OUTPUT_INSERT);
+
+    if (doc && MOO_EDIT_IS_BUSY (doc))
+    {
+        if (window)
+            moo_window_message (MOO_WINDOW (window), _("Document is busy"));
+        return;
+    }
+
+    if (!(argv = make_argv (cmd->priv->cmd_line, &error)))
+        goto out;
+
+    real_env = _moo_env_add (envp);
+    result = mgw_spawn_async_with_pipes (working_dir, argv, real_env, flags,
+#ifndef __WIN32__
+                                         exe_job_child_setup, NULL,
+#else
+                                         NULL, NULL,
+#endif
+                                         &pid, &in_fd, &out_fd, &err_fd,
+                                         &error);
+    g_strfreev (real_env);
+    g_strfreev (argv);
+
+    if (!result)
+        goto out;
+
+    job = g_slice_new0 (ExeJob);
+    job->output_type = cmd->priv->output;
+    job->cmd_line = g_strdup (cmd->priv->cmd_line);
+    job->output = g_string_new (NULL);
+    job->errors = g_string_new (NULL);
+
+    if ((job->window = window))
+        g_object_add_weak_pointer (G_OBJECT (window), (gpointer*) &job->window);
+
+    if (doc)
+    {
+        job->doc = (MooEdit*) g_object_ref (doc);
+        buffer = moo_edit_get_buffer (doc);
+
+        if (cmd->priv->input == MOO_COMMAND_EXE_INPUT_DOC)
+            gtk_text_buffer_get_bounds (buffer, &start, &end);
+        else if (cmd->priv->input == MOO_COMMAND_EXE_INPUT_LINES)
+            get_lines_bounds (doc, &start, &end, TRUE);
+        else
+            gtk_text_buffer_get_selection_bounds (buffer, &start, &end);
+
+        job->start = gtk_text_buffer_create_mark (buffer, NULL, &start, TRUE);
+        job->end = gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE);
+
+        switch (cmd->priv->input)
+        {
+            case MOO_COMMAND_EXE_INPUT_LINES:
+            case MOO_COMMAND_EXE_INPUT_SELECTION:
+            case MOO_COMMAND_EXE_INPUT_DOC:
+                job->input_pos = gtk_text_buffer_create_mark (buffer, NULL, &start, TRUE);
+                job->input_end = gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE);
+                break;
+            case MOO_COMMAND_EXE_INPUT_NONE:
+            case MOO_COMMAND_EXE_INPUT_DOC_COPY:
+                break;
+        }
+
+        job->busy = TRUE;
+        _moo_edit_set_state (doc, MOO_EDIT_STATE_RUNNING, _("Running command"),
+                             (GDestroyNotify) exe_job_cancel, job);
+    }
+
+    job->in_io = exe_job_channel_new (in_fd, &job->in_watch, G_IO_OUT,
+                                      (GIOFunc) exe_job_write_input, job);
+    job->out_io = exe_job_channel_new (out_fd, &job->out_watch, G_IO_IN,
+                                       (GIOFunc) exe_job_read, job);
+    job->err_io = exe_job_channel_new (err_fd, &job->err_watch, G_IO_IN,
+                                       (GIOFunc) exe_job_read, job);
+
+    if (!job->input_pos)
+        exe_job_close_input (job);
+
+    job->pid = pid;
+    job->child_watch = g_child_watch_add (job->pid, (GChildWatchFunc) exe_job_child_exited, job);
+    if (cmd->priv->timeout)
+        job->timeout = g_timeout_add_seconds (cmd->priv->timeout,
+                                              (GSourceFunc) exe_job_timed_out, job);
+    job->progress_timeout = g_timeout_add (EXE_JOB_PROGRESS_INTERVAL,
+                                           (GSourceFunc) exe_job_update_progress, job);
+
+out:
+    if (error)
+    {
+        g_message ("%s: could not run command: %s (command line was '%s')",
+                   G_STRFUNC, error->message, cmd->priv->cmd_line);
+        g_error_free (error);
+    }
+}
+
+
 static void
 moo_command_exe_run (MooCommand        *cmd_base,
                      MooCommandContext *ctx)
 {
-    MooEdit *doc;
     MooCommandExe *cmd = MOO_COMMAND_EXE (cmd_base);
     char **envp;
-    char *output = NULL;
     char *working_dir;
 
     create_environment (cmd, ctx, &working_dir, &envp);
@@ -737,32 +1335,15 @@ moo_command_exe_run (MooCommand        *cmd_base,
             run_command_async (cmd, ctx, working_dir, envp);
             goto out;
 #endif
-        default:
-            break;
-    }
-
-    if (!run_command (cmd, ctx, working_dir, envp, &output,
-                      cmd->priv->output == MOO_COMMAND_EXE_OUTPUT_INSERT))
-        goto out;
-
-    if (cmd->priv->output == MOO_COMMAND_EXE_OUTPUT_INSERT)
-    {
-        doc = moo_command_context_get_doc (ctx);
-        g_return_if_fail (MOO_IS_EDIT (doc));
-    }
-    else
-    {
-        MooEditWindow *window = moo_command_context_get_window (ctx);
-        doc = moo_editor_new_doc (moo_editor_instance (), window);
-        g_return_if_fail (MOO_IS_EDIT (doc));
+        case MOO_COMMAND_EXE_OUTPUT_INSERT:
+        case MOO_COMMAND_EXE_OUTPUT_NEW_DOC:
+            run_command_filter (cmd, ctx, working_dir, envp);
+            goto out;
     }
 
-    insert_text (doc, output, cmd->priv->input == MOO_COMMAND_EXE_INPUT_DOC);
-
 out:
     g_free (working_dir);
     g_strfreev (envp);
-    g_free (output);
 }
 
 
@@ -838,7 +1419,8 @@ _moo_command_exe_new (const char         *cmd_line,
                       MooCommandOptions   options,
                       MooCommandExeInput  input,
                       MooCommandExeOutput output,
-                      const char         *filter)
+                      const char         *filter,
+                      guint               timeout)
 {
     MooCommandExe *cmd;
 
@@ -852,6 +1434,7 @@ _moo_command_exe_new (const char         *cmd_line,
     cmd->priv->input = input;
     cmd->priv->output = output;
     cmd->priv->filter = g_strdup (filter);
+    cmd->priv->timeout = timeout;
 
     return MOO_COMMAND (cmd);
 }
@@ -926,6 +1509,7 @@ unx_factory_create_command (G_GNUC_UNUSED MooCommandFactory *factory,
 {
     MooCommand *cmd;
     const char *cmd_line;
+    const char *timeout;
     int input, output;
 
     cmd_line = moo_command_data_get_code (data);
@@ -936,10 +1520,13 @@ unx_factory_create_command (G_GNUC_UNUSED MooCommandFactory *factory,
     if (!parse_output (moo_command_data_get (data, KEY_OUTPUT), &output))
         return NULL;
 
+    timeout = moo_command_data_get (data, KEY_TIMEOUT);
+
     cmd = _moo_command_exe_new (cmd_line,
                                 moo_parse_command_options (options),
                                 (MooCommandExeInput) input, (MooCommandExeOutput) output,
-                                moo_command_data_get (data, KEY_FILTER));
+                                moo_command_data_get (data, KEY_FILTER),
+                                timeout ? strtoul (timeout, NULL, 10) : 0);
     g_return_val_if_fail (cmd != NULL, NULL);
 
     return cmd;
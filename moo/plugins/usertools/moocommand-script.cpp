@@ -18,6 +18,7 @@
 #include "plugins/usertools/lua-tool-setup.h"
 #ifdef MOO_ENABLE_PYTHON
 #include "plugins/usertools/python-tool-setup.h"
+#include "moopython/moopython-builtin.h"
 #endif
 #include "mooedit/mooeditor.h"
 #include "mooutils/mooi18n.h"
@@ -28,6 +29,14 @@
 #include "moopython/medit-python.h"
 #include <string.h>
 
+/* Idle interpreter states kept for reuse */
+#define LUA_POOL_SIZE           2
+/* A state is closed after this many tool runs, so that whatever tools
+ * leave behind in shared tables does not accumulate forever */
+#define LUA_STATE_MAX_USES      256
+/* Compiled chunks cached per state */
+#define LUA_STATE_MAX_CHUNKS    64
+
 struct MooCommandFactoryScript
 {
     MooCommandFactory base;
@@ -49,29 +58,201 @@ static MooCommand  *moo_command_script_new (MooScriptType     type,
                                             const char       *code,
                                             MooCommandOptions options);
 
+typedef struct {
+    lua_State *L;
+    int setup_ref;          /* functions returned by LUA_TOOL_SETUP_LUA */
+    int finish_ref;
+    int chunks_ref;         /* code hash -> compiled chunk */
+    GQueue chunk_keys;      /* code hashes, least recently used first */
+    guint n_uses;
+} LuaToolState;
+
+static GSList *lua_pool;
+static guint lua_prewarm_id;
+
+static void
+lua_tool_state_free (LuaToolState *ls)
+{
+    if (ls)
+    {
+        medit_lua_free (ls->L);
+        g_queue_foreach (&ls->chunk_keys, (GFunc) g_free, NULL);
+        g_queue_clear (&ls->chunk_keys);
+        g_slice_free (LuaToolState, ls);
+    }
+}
+
+static LuaToolState *
+lua_tool_state_new (void)
+{
+    LuaToolState *ls;
+    lua_State *L;
+
+    L = medit_lua_new ();
+    g_return_val_if_fail (L != NULL, NULL);
+
+    if (luaL_loadstring (L, LUA_TOOL_SETUP_LUA) != 0 || lua_pcall (L, 0, 2, 0) != 0)
+    {
+        const char *msg = lua_tostring (L, -1);
+        g_critical ("%s", msg ? msg : "ERROR");
+        medit_lua_free (L);
+        return NULL;
+    }
+
+    ls = g_slice_new0 (LuaToolState);
+    ls->L = L;
+    ls->finish_ref = luaL_ref (L, LUA_REGISTRYINDEX);
+    ls->setup_ref = luaL_ref (L, LUA_REGISTRYINDEX);
+    lua_newtable (L);
+    ls->chunks_ref = luaL_ref (L, LUA_REGISTRYINDEX);
+
+    return ls;
+}
+
+static LuaToolState *
+lua_pool_get (void)
+{
+    LuaToolState *ls;
+
+    if (!lua_pool)
+        return lua_tool_state_new ();
+
+    ls = (LuaToolState*) lua_pool->data;
+    lua_pool = g_slist_delete_link (lua_pool, lua_pool);
+    return ls;
+}
+
+static void
+lua_pool_put (LuaToolState *ls)
+{
+    lua_settop (ls->L, 0);
+
+    if (ls->n_uses >= LUA_STATE_MAX_USES || g_slist_length (lua_pool) >= LUA_POOL_SIZE)
+    {
+        lua_tool_state_free (ls);
+        return;
+    }
+
+    /* forget doc, window and globals of the last run; doc and window
+     * hold references to GObjects, and an idle state may stay in the
+     * pool for as long as medit runs */
+    lua_rawgeti (ls->L, LUA_REGISTRYINDEX, ls->finish_ref);
+    if (lua_pcall (ls->L, 0, 0, 0) != 0)
+    {
+        const char *msg = lua_tostring (ls->L, -1);
+        g_critical ("%s", msg ? msg : "ERROR");
+        lua_tool_state_free (ls);
+        return;
+    }
+
+    lua_gc (ls->L, LUA_GCCOLLECT, 0);
+    lua_pool = g_slist_prepend (lua_pool, ls);
+}
+
+static gboolean
+lua_pool_prewarm (void)
+{
+    LuaToolState *ls;
+
+    lua_prewarm_id = 0;
+
+    if (!lua_pool && (ls = lua_tool_state_new ()))
+        lua_pool_put (ls);
+
+    return FALSE;
+}
+
+void
+_moo_command_script_shutdown (void)
+{
+    if (lua_prewarm_id)
+        g_source_remove (lua_prewarm_id);
+    lua_prewarm_id = 0;
+
+    g_slist_foreach (lua_pool, (GFunc) lua_tool_state_free, NULL);
+    g_slist_free (lua_pool);
+    lua_pool = NULL;
+}
+
+/* pushes compiled cmd->code onto the stack */
+static gboolean
+lua_tool_state_load (LuaToolState     *ls,
+                     MooCommandScript *cmd)
+{
+    lua_State *L = ls->L;
+    GList *link;
+
+    if (!cmd->code_hash)
+        cmd->code_hash = g_compute_checksum_for_string (G_CHECKSUM_MD5, cmd->code, -1);
+
+    lua_rawgeti (L, LUA_REGISTRYINDEX, ls->chunks_ref);
+    lua_getfield (L, -1, cmd->code_hash);
+
+    if (!lua_isnil (L, -1))
+    {
+        link = g_queue_find_custom (&ls->chunk_keys, cmd->code_hash, (GCompareFunc) strcmp);
+        g_queue_unlink (&ls->chunk_keys, link);
+        g_queue_push_tail_link (&ls->chunk_keys, link);
+        lua_remove (L, -2);
+        return TRUE;
+    }
+
+    lua_pop (L, 1);
+
+    if (luaL_loadstring (L, cmd->code) != 0)
+    {
+        const char *msg = lua_tostring (L, -1);
+        g_critical ("%s", msg ? msg : "ERROR");
+        lua_pop (L, 2);
+        return FALSE;
+    }
+
+    /* forget the least recently used chunk to make room */
+    if (ls->chunk_keys.length >= LUA_STATE_MAX_CHUNKS)
+    {
+        char *old_hash = (char*) g_queue_pop_head (&ls->chunk_keys);
+        lua_pushnil (L);
+        lua_setfield (L, -3, old_hash);
+        g_free (old_hash);
+    }
+
+    lua_pushvalue (L, -1);
+    lua_setfield (L, -3, cmd->code_hash);
+    g_queue_push_tail (&ls->chunk_keys, g_strdup (cmd->code_hash));
+
+    lua_remove (L, -2);
+    return TRUE;
+}
+
 static void
 moo_command_script_run_lua (MooCommandScript  *cmd,
                             MooCommandContext *ctx)
 {
     GtkTextBuffer *buffer = NULL;
+    LuaToolState *ls;
     lua_State *L;
 
     g_return_if_fail (cmd->code != NULL);
 
-    L = medit_lua_new ();
-    g_return_if_fail (L != NULL);
+    ls = lua_pool_get ();
+    g_return_if_fail (ls != NULL);
+    L = ls->L;
+    ls->n_uses += 1;
 
-    if (!medit_lua_do_string (L, LUA_TOOL_SETUP_LUA))
+    if (!lua_tool_state_load (ls, cmd))
     {
-        medit_lua_free (L);
+        lua_pool_put (ls);
         return;
     }
 
-    if (luaL_loadstring (L, cmd->code) != 0)
+    /* set doc and window, and give the chunk fresh globals */
+    lua_rawgeti (L, LUA_REGISTRYINDEX, ls->setup_ref);
+    lua_insert (L, -2);
+    if (lua_pcall (L, 1, 1, 0) != 0)
     {
         const char *msg = lua_tostring (L, -1);
         g_critical ("%s", msg ? msg : "ERROR");
-        medit_lua_free (L);
+        lua_pool_put (ls);
         return;
     }
 
@@ -91,7 +272,7 @@ moo_command_script_run_lua (MooCommandScript  *cmd,
     if (buffer)
         gtk_text_buffer_end_user_action (buffer);
 
-    medit_lua_free (L);
+    lua_pool_put (ls);
 }
 
 static void
@@ -104,6 +285,14 @@ moo_command_script_run_python (MooCommandScript  *cmd,
 
     g_return_if_fail (cmd->code != NULL);
 
+    /* the interpreter is started when it's needed, and a Python tool
+     * may well be the first thing which needs it */
+    if (!_moo_python_ensure_init ())
+    {
+        g_warning ("Python is not available, could not run the tool");
+        return;
+    }
+
     state = moo_python_state_new (TRUE);
     g_return_if_fail (state != NULL);
 
@@ -159,6 +348,8 @@ moo_command_script_dispose (GObject *object)
 
     g_free (cmd->code);
     cmd->code = NULL;
+    g_free (cmd->code_hash);
+    cmd->code_hash = NULL;
 
     G_OBJECT_CLASS(_moo_command_script_parent_class)->dispose (object);
 }
@@ -306,5 +497,11 @@ moo_command_script_new (MooScriptType      type,
     cmd->code = g_strdup (code);
     cmd->type = type;
 
+    /* have an interpreter ready by the time the tool is first used */
+    if (type == MOO_SCRIPT_LUA && !lua_pool && !lua_prewarm_id)
+        lua_prewarm_id = g_idle_add_full (G_PRIORITY_LOW,
+                                          (GSourceFunc) lua_pool_prewarm,
+                                          NULL, NULL);
+
     return MOO_COMMAND (cmd);
 }
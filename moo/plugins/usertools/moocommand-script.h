@@ -38,6 +38,7 @@ typedef enum {
 struct MooCommandScript : public MooCommand {
     MooScriptType type;
     char *code;
+    char *code_hash;
 };
 
 struct MooCommandScriptClass : public MooCommandClass {
@@ -46,6 +47,8 @@ struct MooCommandScriptClass : public MooCommandClass {
 
 GType _moo_command_script_get_type (void) G_GNUC_CONST;
 
+void  _moo_command_script_shutdown  (void);
+
 
 G_END_DECLS
 
@@ -73,6 +73,10 @@ struct FilterState {
     guint n_patterns;
     GRegex *re_out;
     GRegex *re_err;
+    /* strings which must occur in a line for some pattern to match it,
+     * see build_prefilter(); NULL if the lines can't be prefiltered */
+    GPtrArray *prefilter_out;
+    GPtrArray *prefilter_err;
 };
 
 struct PatternInfo {
@@ -106,8 +110,15 @@ struct _MooOutputFilterRegexPrivate {
     guint span;
     char *style;
     MooFileLineData *line;
+
+    /* full path -> PATH_EXISTS or PATH_MISSING, reset on cmd-start */
+    GHashTable *path_cache;
 };
 
+#define PATH_MISSING        1
+#define PATH_EXISTS         2
+#define MAX_CACHED_PATHS    4096
+
 
 static FilterInfo  *filter_info_new     (const char     *id,
                                          const char     *name,
@@ -155,6 +166,12 @@ moo_output_filter_regex_dispose (GObject *object)
     g_slist_free (filter->priv->dir_stack);
     filter->priv->dir_stack = NULL;
 
+    if (filter->priv->path_cache)
+    {
+        g_hash_table_destroy (filter->priv->path_cache);
+        filter->priv->path_cache = NULL;
+    }
+
     G_OBJECT_CLASS (_moo_output_filter_regex_parent_class)->dispose (object);
 }
 
@@ -175,9 +192,50 @@ moo_output_filter_regex_detach (MooOutputFilter *base)
 }
 
 
+static void
+moo_output_filter_regex_cmd_start (MooOutputFilter *base)
+{
+    MooOutputFilterRegex *filter = MOO_OUTPUT_FILTER_REGEX (base);
+
+    /* files may be created or removed between runs */
+    if (filter->priv->path_cache)
+        g_hash_table_remove_all (filter->priv->path_cache);
+}
+
+
+/* Compilers print the same few file names over and over, so
+ * remember which paths exist instead of hitting the disk for
+ * every message. */
+static gboolean
+file_exists (MooOutputFilterRegex *filter,
+             const char           *path)
+{
+    gboolean exists;
+    int cached;
+
+    if (!filter->priv->path_cache)
+        filter->priv->path_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    cached = GPOINTER_TO_INT (g_hash_table_lookup (filter->priv->path_cache, path));
+
+    if (cached)
+        return cached == PATH_EXISTS;
+
+    exists = g_file_test (path, G_FILE_TEST_EXISTS);
+
+    if (g_hash_table_size (filter->priv->path_cache) >= MAX_CACHED_PATHS)
+        g_hash_table_remove_all (filter->priv->path_cache);
+
+    g_hash_table_insert (filter->priv->path_cache, g_strdup (path),
+                         GINT_TO_POINTER (exists ? PATH_EXISTS : PATH_MISSING));
+
+    return exists;
+}
+
 static char *
-find_file_in_dir (const char *file,
-                  const char *dir)
+find_file_in_dir (MooOutputFilterRegex *filter,
+                  const char           *file,
+                  const char           *dir)
 {
     char *path;
 
@@ -186,7 +244,7 @@ find_file_in_dir (const char *file,
 
     path = g_build_filename (dir, file, nullptr);
 
-    if (g_file_test (path, G_FILE_TEST_EXISTS))
+    if (file_exists (filter, path))
         return path;
 
     g_free (path);
@@ -194,12 +252,13 @@ find_file_in_dir (const char *file,
 }
 
 static char *
-find_file_in_dirs (const char         *file,
-                   const char * const *dirs)
+find_file_in_dirs (MooOutputFilterRegex *filter,
+                   const char           *file,
+                   const char * const   *dirs)
 {
     for ( ; file && dirs && *dirs; ++dirs)
     {
-        char *path = find_file_in_dir (file, *dirs);
+        char *path = find_file_in_dir (filter, file, *dirs);
         if (path)
             return path;
     }
@@ -217,10 +276,10 @@ find_file (const char           *file,
         real_file = g_strdup (file);
 
     if (!real_file && filter->priv->dir_stack)
-        real_file = find_file_in_dir (file, (const char*) filter->priv->dir_stack->data);
+        real_file = find_file_in_dir (filter, file, (const char*) filter->priv->dir_stack->data);
 
     if (!real_file)
-        real_file = find_file_in_dirs (file, moo_output_filter_get_active_dirs (MOO_OUTPUT_FILTER (filter)));
+        real_file = find_file_in_dirs (filter, file, moo_output_filter_get_active_dirs (MOO_OUTPUT_FILTER (filter)));
 
     if (!real_file)
         real_file = g_strdup (file);
@@ -367,6 +426,466 @@ find_match (const char   *text,
 }
 
 
+/****************************************************************************/
+/* Literal prefilter
+ *
+ * Most lines of a build log match no pattern, and running the combined
+ * regex over every one of them is what makes filtering slow. So each
+ * pattern is reduced to literal strings which any match must contain,
+ * e.g. ":D" and "D:" for "(?P<file>[^:]+):(?P<line>\d+):.*" where D stands
+ * for a digit, and a line is given to the regex only if it contains all
+ * strings of some pattern. A pattern which uses something the parser
+ * doesn't understand disables prefiltering for its output type.
+ */
+
+#define LITERAL_DIGIT '\001'
+
+static gboolean prefilter_enabled = TRUE;
+
+enum {
+    QUANT_ONE,
+    QUANT_OPTIONAL,
+    QUANT_SOME
+};
+
+typedef struct {
+    GString *cur;       /* literal text right before the current position */
+    GString *prefix;    /* literal text at the start, once broken is set */
+    gboolean broken;
+    GPtrArray *runs;    /* literal strings in between */
+} LiteralSeq;
+
+static void
+literal_seq_init (LiteralSeq *seq)
+{
+    seq->cur = g_string_new (NULL);
+    seq->prefix = g_string_new (NULL);
+    seq->broken = FALSE;
+    seq->runs = g_ptr_array_new_with_free_func (g_free);
+}
+
+static void
+literal_seq_destroy (LiteralSeq *seq)
+{
+    g_string_free (seq->cur, TRUE);
+    g_string_free (seq->prefix, TRUE);
+    if (seq->runs)
+        g_ptr_array_unref (seq->runs);
+}
+
+/* something which is not a fixed string follows */
+static void
+literal_seq_break (LiteralSeq *seq)
+{
+    if (!seq->broken)
+    {
+        g_string_assign (seq->prefix, seq->cur->str);
+        seq->broken = TRUE;
+    }
+    else if (seq->cur->len)
+    {
+        g_ptr_array_add (seq->runs, g_strdup (seq->cur->str));
+    }
+
+    g_string_truncate (seq->cur, 0);
+}
+
+static void
+literal_seq_append (LiteralSeq *seq,
+                    LiteralSeq *group)
+{
+    guint i;
+
+    if (!group->broken)
+    {
+        g_string_append (seq->cur, group->cur->str);
+        return;
+    }
+
+    g_string_append (seq->cur, group->prefix->str);
+    literal_seq_break (seq);
+
+    for (i = 0; i < group->runs->len; ++i)
+        g_ptr_array_add (seq->runs, g_strdup ((const char*) g_ptr_array_index (group->runs, i)));
+
+    g_string_assign (seq->cur, group->cur->str);
+}
+
+static gboolean
+skip_char_class (const char **pp)
+{
+    const char *p = *pp + 1;
+
+    if (*p == '^')
+        p++;
+    if (*p == ']')
+        p++;
+
+    while (*p && *p != ']')
+    {
+        if (p[0] == '\\' && p[1])
+        {
+            p += 2;
+        }
+        else if (p[0] == '[' && p[1] == ':')
+        {
+            const char *end = strstr (p, ":]");
+            if (!end)
+                return FALSE;
+            p = end + 2;
+        }
+        else
+        {
+            p++;
+        }
+    }
+
+    if (!*p)
+        return FALSE;
+
+    *pp = p + 1;
+    return TRUE;
+}
+
+static gboolean
+parse_quantifier (const char **pp,
+                  int         *quant)
+{
+    const char *p = *pp;
+
+    switch (*p)
+    {
+        case '?':
+        case '*':
+            *quant = QUANT_OPTIONAL;
+            p++;
+            break;
+
+        case '+':
+            *quant = QUANT_SOME;
+            p++;
+            break;
+
+        case '{':
+            {
+                guint64 min;
+                char *end;
+
+                if (!g_ascii_isdigit (p[1]))
+                    return FALSE;
+
+                min = g_ascii_strtoull (p + 1, &end, 10);
+                p = end;
+
+                if (*p == ',')
+                    for (p++; g_ascii_isdigit (*p); p++) ;
+
+                if (*p != '}')
+                    return FALSE;
+
+                *quant = min ? QUANT_SOME : QUANT_OPTIONAL;
+                p++;
+            }
+            break;
+
+        default:
+            *quant = QUANT_ONE;
+            return TRUE;
+    }
+
+    /* lazy or possessive */
+    if (*p == '?' || *p == '+')
+        p++;
+
+    *pp = p;
+    return TRUE;
+}
+
+/* parses a sequence up to the end of pattern, '|' or ')' */
+static gboolean
+parse_literals (const char **pp,
+                LiteralSeq  *seq)
+{
+    const char *p = *pp;
+
+    while (*p && *p != '|' && *p != ')')
+    {
+        char c = 0;
+        gboolean opaque = FALSE;
+        gboolean is_group = FALSE;
+        LiteralSeq group;
+        int quant;
+
+        if (*p == '^' || *p == '$')
+        {
+            p++;
+            continue;
+        }
+        else if (*p == '\\')
+        {
+            char e = p[1];
+
+            if (e == 'b' || e == 'B')
+            {
+                p += 2;
+                continue;
+            }
+
+            if (e == 'd')
+                c = LITERAL_DIGIT;
+            else if (e && strchr ("DsSwW", e))
+                opaque = TRUE;
+            else if (!e || g_ascii_isalnum (e))
+                return FALSE;
+            else
+                c = e;
+
+            p += 2;
+        }
+        else if (*p == '.')
+        {
+            opaque = TRUE;
+            p++;
+        }
+        else if (*p == '[')
+        {
+            if (!skip_char_class (&p))
+                return FALSE;
+            opaque = TRUE;
+        }
+        else if (*p == '(')
+        {
+            gboolean ok;
+
+            p++;
+
+            if (p[0] == '?' && p[1] == ':')
+            {
+                p += 2;
+            }
+            else if (p[0] == '?' && p[1] == 'P' && p[2] == '<')
+            {
+                if (!(p = strchr (p, '>')))
+                    return FALSE;
+                p++;
+            }
+            else if (p[0] == '?')
+            {
+                return FALSE;
+            }
+
+            literal_seq_init (&group);
+            ok = parse_literals (&p, &group);
+
+            while (ok && *p == '|')
+            {
+                LiteralSeq alt;
+                p++;
+                literal_seq_init (&alt);
+                ok = parse_literals (&p, &alt);
+                literal_seq_destroy (&alt);
+                opaque = TRUE;
+            }
+
+            if (!ok || *p != ')')
+            {
+                literal_seq_destroy (&group);
+                return FALSE;
+            }
+
+            p++;
+            is_group = TRUE;
+        }
+        else if ((guchar) *p >= 0x80)
+        {
+            for (p++; (*p & 0xC0) == 0x80; p++) ;
+            opaque = TRUE;
+        }
+        else if (strchr ("?*+{", *p))
+        {
+            return FALSE;
+        }
+        else
+        {
+            c = *p++;
+        }
+
+        if (!parse_quantifier (&p, &quant))
+        {
+            if (is_group)
+                literal_seq_destroy (&group);
+            return FALSE;
+        }
+
+        if (opaque || quant == QUANT_OPTIONAL)
+        {
+            literal_seq_break (seq);
+        }
+        else if (is_group)
+        {
+            literal_seq_append (seq, &group);
+
+            /* first and last repetition */
+            if (quant == QUANT_SOME && !group.broken)
+            {
+                literal_seq_break (seq);
+                g_string_assign (seq->cur, group.cur->str);
+            }
+        }
+        else
+        {
+            g_string_append_c (seq->cur, c);
+
+            if (quant == QUANT_SOME)
+            {
+                literal_seq_break (seq);
+                g_string_append_c (seq->cur, c);
+            }
+        }
+
+        if (is_group)
+            literal_seq_destroy (&group);
+    }
+
+    *pp = p;
+    return TRUE;
+}
+
+char **
+_moo_output_filter_regex_get_literals (const char *pattern)
+{
+    LiteralSeq seq;
+    const char *p = pattern;
+    char **literals = NULL;
+
+    g_return_val_if_fail (pattern != NULL, NULL);
+
+    literal_seq_init (&seq);
+
+    if (parse_literals (&p, &seq) && !*p)
+    {
+        literal_seq_break (&seq);
+
+        if (seq.prefix->len)
+            g_ptr_array_add (seq.runs, g_strdup (seq.prefix->str));
+
+        if (seq.runs->len)
+        {
+            g_ptr_array_add (seq.runs, NULL);
+            literals = (char**) g_ptr_array_free (seq.runs, FALSE);
+            seq.runs = NULL;
+        }
+    }
+
+    literal_seq_destroy (&seq);
+    return literals;
+}
+
+static GPtrArray *
+build_prefilter (GSList    *patterns,
+                 OutputType type)
+{
+    GPtrArray *prefilter;
+
+    prefilter = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+
+    for ( ; patterns != NULL; patterns = patterns->next)
+    {
+        PatternInfo *pat = (PatternInfo*) patterns->data;
+        char **literals;
+
+        if (pat->type != type && pat->type != OUTPUT_ALL)
+            continue;
+
+        literals = _moo_output_filter_regex_get_literals (g_regex_get_pattern (pat->re));
+
+        if (!literals)
+        {
+            g_ptr_array_unref (prefilter);
+            return NULL;
+        }
+
+        g_ptr_array_add (prefilter, literals);
+    }
+
+    return prefilter;
+}
+
+void
+_moo_output_filter_regex_set_prefilter (gboolean enabled)
+{
+    prefilter_enabled = enabled != 0;
+}
+
+static gboolean
+literal_matches_at (const char *text,
+                    const char *literal)
+{
+    for ( ; *literal; ++literal, ++text)
+    {
+        if (*literal == LITERAL_DIGIT ? !g_ascii_isdigit (*text) : *literal != *text)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+contains_literal (const char *text,
+                  const char *literal)
+{
+    const char *p;
+
+    if (!strchr (literal, LITERAL_DIGIT))
+        return strstr (text, literal) != NULL;
+
+    if (literal[0] != LITERAL_DIGIT)
+    {
+        for (p = strchr (text, literal[0]); p != NULL; p = strchr (p + 1, literal[0]))
+            if (literal_matches_at (p, literal))
+                return TRUE;
+
+        return FALSE;
+    }
+
+    for (p = text; *p; ++p)
+        if (literal_matches_at (p, literal))
+            return TRUE;
+
+    return FALSE;
+}
+
+static gboolean
+prefilter_accepts (FilterState *state,
+                   OutputType   type,
+                   const char  *text)
+{
+    GPtrArray *prefilter;
+    guint i;
+
+    if (type == OUTPUT_STDOUT)
+        prefilter = state->prefilter_out;
+    else
+        prefilter = state->prefilter_err;
+
+    if (!prefilter || !prefilter_enabled)
+        return TRUE;
+
+    for (i = 0; i < prefilter->len; ++i)
+    {
+        char **literals = (char**) g_ptr_array_index (prefilter, i);
+
+        while (*literals && contains_literal (text, *literals))
+            ++literals;
+
+        if (!*literals)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+
 static GtkTextTag *
 get_tag (MooLineView *view,
          OutputType   type,
@@ -493,6 +1012,9 @@ process_line (MooOutputFilterRegex  *filter,
         return TRUE;
     }
 
+    if (!prefilter_accepts (state, type, text))
+        return FALSE;
+
     start_pos = 0;
     found = FALSE;
     line_no = 0;
@@ -589,6 +1111,7 @@ _moo_output_filter_regex_class_init (MooOutputFilterRegexClass *klass)
     filter_class->detach = moo_output_filter_regex_detach;
     filter_class->stdout_line = moo_output_filter_regex_stdout_line;
     filter_class->stderr_line = moo_output_filter_regex_stderr_line;
+    filter_class->cmd_start = moo_output_filter_regex_cmd_start;
 
     g_type_class_add_private (klass, sizeof (MooOutputFilterRegexPrivate));
 }
@@ -742,6 +1265,8 @@ filter_state_new (GSList *patterns)
     state->ref_count = 1;
     state->re_out = get_re_all (patterns, OUTPUT_STDOUT);
     state->re_err = get_re_all (patterns, OUTPUT_STDERR);
+    state->prefilter_out = build_prefilter (patterns, OUTPUT_STDOUT);
+    state->prefilter_err = build_prefilter (patterns, OUTPUT_STDERR);
     state->n_patterns = g_slist_length (patterns);
     state->patterns = g_new0 (PatternInfo*, state->n_patterns);
 
@@ -765,6 +1290,10 @@ filter_state_unref (FilterState *state)
             g_regex_unref (state->re_out);
         if (state->re_err)
             g_regex_unref (state->re_err);
+        if (state->prefilter_out)
+            g_ptr_array_unref (state->prefilter_out);
+        if (state->prefilter_err)
+            g_ptr_array_unref (state->prefilter_err);
 
         g_free (state->patterns);
         g_free (state);
@@ -46,6 +46,13 @@ GType                _moo_output_filter_regex_get_type (void) G_GNUC_CONST;
 
 void                 _moo_command_filter_regex_load    (void);
 
+/* strings which any match of the regular expression pattern contains,
+ * with '\001' standing for a digit; NULL if the pattern can't be
+ * prefiltered. For tests */
+char               **_moo_output_filter_regex_get_literals  (const char *pattern);
+/* turns the literal prefilter off, for tests */
+void                 _moo_output_filter_regex_set_prefilter (gboolean    enabled);
+
 
 G_END_DECLS
 
@@ -0,0 +1,621 @@
+/*
+ *   moousertools-tests.cpp
+ *
+ *   Copyright (C) 2004-2010 by Yevgen Muntyan <emuntyan@users.sourceforge.net>
+ *
+ *   This file is part of medit.  medit is free software; you can
+ *   redistribute it and/or modify it under the terms of the
+ *   GNU Lesser General Public License as published by the
+ *   Free Software Foundation; either version 2.1 of the License,
+ *   or (at your option) any later version.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with medit.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "plugins/usertools/moousertools-tests.h"
+#include "plugins/usertools/moocommand.h"
+#include "plugins/usertools/moooutputfilterregex.h"
+#include "plugins/support/moolineview.h"
+#include "mooedit/mooeditor.h"
+#include "mooedit/mooeditwindow.h"
+#include "mooedit/mooedit-impl.h"
+#include <string.h>
+
+#ifdef __WIN32__
+#define LE "\r\n"
+#else
+#define LE "\n"
+#endif
+
+#define BENCH_LUA_TOOL_RUNS 1000
+#define BENCH_FILTER_LINES 1000000
+
+static struct {
+    MooEditWindow *window;
+    MooEdit *doc;
+    MooCommand *tool;
+    MooOutputFilter *filter;
+    GtkWidget *view;
+    GPtrArray *log;
+} bench_data;
+
+static char *
+get_buffer_text (GtkTextBuffer *buffer)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    return gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+}
+
+/* runs the main loop until the object *ptr points to is finalized
+ * and the weak pointer is cleared */
+static void
+test_wait_destroyed (gpointer *ptr)
+{
+    GTimer *timer = g_timer_new ();
+
+    while (*ptr && g_timer_elapsed (timer, NULL) < 10)
+        g_main_context_iteration (NULL, FALSE);
+
+    g_timer_destroy (timer);
+}
+
+static MooCommand *
+create_lua_tool (const char *code)
+{
+    MooCommandFactory *factory;
+    MooCommandData *data;
+    MooCommand *cmd;
+
+    factory = moo_command_factory_lookup ("lua");
+    g_return_val_if_fail (factory != NULL, NULL);
+
+    data = moo_command_data_new (factory->n_keys);
+    moo_command_data_set_code (data, code);
+    cmd = moo_command_create ("lua", NULL, data);
+
+    moo_command_data_unref (data);
+    return cmd;
+}
+
+static void
+run_lua_tool (MooCommand *cmd)
+{
+    MooEditor *editor = moo_editor_instance ();
+    MooCommandContext *ctx;
+
+    ctx = moo_command_context_new (moo_editor_get_active_doc (editor),
+                                   moo_editor_get_active_window (editor));
+    moo_command_run (cmd, ctx);
+    g_object_unref (ctx);
+}
+
+/* runs code as a tool, returns text of the document it sees as doc */
+static char *
+run_lua_tool_code (const char *code)
+{
+    MooCommand *cmd = create_lua_tool (code);
+
+    TEST_ASSERT (cmd != NULL);
+    if (!cmd)
+        return NULL;
+
+    run_lua_tool (cmd);
+    g_object_unref (cmd);
+
+    return get_buffer_text (moo_edit_get_buffer (moo_editor_get_active_doc (moo_editor_instance ())));
+}
+
+#define LUA_TOOLS 100
+
+static void
+test_lua_tool (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooEdit *doc;
+    MooCommand *tools[LUA_TOOLS];
+    char *text;
+    guint i;
+
+    TEST_ASSERT (moo_command_factory_lookup ("lua") != NULL);
+    if (!moo_command_factory_lookup ("lua"))
+        return;
+
+    editor = moo_editor_instance ();
+    window = moo_editor_new_window (editor);
+
+    text = run_lua_tool_code ("leaked = 1; doc.set_text('first')");
+    TEST_ASSERT_STR_EQ (text, "first");
+    g_free (text);
+
+    /* globals of one run are not seen by the next one */
+    text = run_lua_tool_code ("doc.set_text(tostring(leaked))");
+    TEST_ASSERT_STR_EQ (text, "nil");
+    g_free (text);
+
+    /* doc is a real global, code loaded by the tool sees it */
+    text = run_lua_tool_code ("loadstring('doc.set_text(\"loaded\")')()");
+    TEST_ASSERT_STR_EQ (text, "loaded");
+    g_free (text);
+
+    /* more tools than compiled chunks kept by an interpreter */
+    for (i = 0; i < LUA_TOOLS; ++i)
+    {
+        char *code = g_strdup_printf ("doc.set_text('tool %u')", i);
+        tools[i] = create_lua_tool (code);
+        g_free (code);
+    }
+
+    for (i = 0; i < 2 * LUA_TOOLS; ++i)
+    {
+        guint n = i % 3 == 0 ? 0 : i % LUA_TOOLS;
+        char *expected;
+
+        if (!tools[n])
+            continue;
+
+        expected = g_strdup_printf ("tool %u", n);
+        run_lua_tool (tools[n]);
+        text = get_buffer_text (moo_edit_get_buffer (moo_editor_get_active_doc (editor)));
+        TEST_ASSERT_STR_EQ (text, expected);
+        g_free (text);
+        g_free (expected);
+    }
+
+    for (i = 0; i < LUA_TOOLS; ++i)
+        if (tools[i])
+            g_object_unref (tools[i]);
+
+    moo_edit_set_modified (moo_editor_get_active_doc (editor), FALSE);
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+
+    /* an idle interpreter in the pool does not keep the document
+     * and the window the last tool saw */
+    window = moo_editor_new_window (editor);
+    doc = moo_editor_get_active_doc (editor);
+    g_object_add_weak_pointer (G_OBJECT (doc), (gpointer*) &doc);
+    g_object_add_weak_pointer (G_OBJECT (window), (gpointer*) &window);
+
+    text = run_lua_tool_code ("doc.set_text('closed')");
+    TEST_ASSERT_STR_EQ (text, "closed");
+    g_free (text);
+
+    moo_edit_set_modified (doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+    test_wait_destroyed ((gpointer*) &doc);
+    test_wait_destroyed ((gpointer*) &window);
+    TEST_ASSERT (doc == NULL);
+    TEST_ASSERT (window == NULL);
+
+    if (doc)
+        g_object_remove_weak_pointer (G_OBJECT (doc), (gpointer*) &doc);
+    if (window)
+        g_object_remove_weak_pointer (G_OBJECT (window), (gpointer*) &window);
+}
+
+#ifndef __WIN32__
+
+#define FILTER_LINES 20000
+
+static MooCommand *
+create_filter (const char *cmd_line,
+               const char *input,
+               const char *timeout)
+{
+    MooCommandFactory *factory;
+    MooCommandData *data;
+    MooCommand *cmd;
+    guint i;
+
+    factory = moo_command_factory_lookup ("exe");
+    g_return_val_if_fail (factory != NULL, NULL);
+
+    data = moo_command_data_new (factory->n_keys);
+
+    for (i = 0; i < factory->n_keys; ++i)
+    {
+        if (!strcmp (factory->keys[i], "input"))
+            moo_command_data_set (data, i, input);
+        else if (!strcmp (factory->keys[i], "output"))
+            moo_command_data_set (data, i, "insert");
+        else if (!strcmp (factory->keys[i], "timeout"))
+            moo_command_data_set (data, i, timeout);
+    }
+
+    moo_command_data_set_code (data, cmd_line);
+    cmd = moo_command_create ("exe", NULL, data);
+
+    moo_command_data_unref (data);
+    return cmd;
+}
+
+/* runs the command on doc and waits until it's done; returns the
+ * document text */
+static char *
+run_filter (MooEditWindow *window,
+            MooEdit       *doc,
+            const char    *cmd_line,
+            const char    *input,
+            const char    *timeout)
+{
+    MooCommand *cmd;
+    MooCommandContext *ctx;
+    GTimer *timer;
+
+    cmd = create_filter (cmd_line, input, timeout);
+    TEST_ASSERT (cmd != NULL);
+    if (!cmd)
+        return NULL;
+
+    ctx = moo_command_context_new (doc, window);
+    moo_command_run (cmd, ctx);
+
+    timer = g_timer_new ();
+    while (MOO_EDIT_IS_BUSY (doc) && g_timer_elapsed (timer, NULL) < 60)
+        g_main_context_iteration (NULL, TRUE);
+    TEST_ASSERT (!MOO_EDIT_IS_BUSY (doc));
+
+    g_timer_destroy (timer);
+    g_object_unref (ctx);
+    g_object_unref (cmd);
+
+    return get_buffer_text (moo_edit_get_buffer (doc));
+}
+
+static void
+test_filter (void)
+{
+    MooEditor *editor;
+    MooEditWindow *window;
+    MooEdit *doc;
+    MooEditView *view;
+    GtkTextBuffer *buffer;
+    GtkTextIter start, end;
+    GString *text;
+    GTimer *timer;
+    char *result;
+    guint i;
+
+    TEST_ASSERT (moo_command_factory_lookup ("exe") != NULL);
+    if (!moo_command_factory_lookup ("exe"))
+        return;
+
+    editor = moo_editor_instance ();
+    window = moo_editor_new_window (editor);
+    doc = moo_edit_window_get_active_doc (window);
+    view = moo_edit_get_view (doc);
+    buffer = moo_edit_get_buffer (doc);
+
+    /* output replaces the input as one undo step */
+    gtk_text_buffer_set_text (buffer, "c\nb\na\n", -1);
+    result = run_filter (window, doc, "sort", "doc", NULL);
+    TEST_ASSERT_STR_EQ (result, "a\nb\nc\n");
+    g_free (result);
+
+    TEST_ASSERT (moo_text_view_undo (MOO_TEXT_VIEW (view)));
+    result = get_buffer_text (buffer);
+    TEST_ASSERT_STR_EQ (result, "c\nb\na\n");
+    g_free (result);
+
+    /* only the selected text is replaced */
+    gtk_text_buffer_get_iter_at_line (buffer, &start, 1);
+    gtk_text_buffer_get_iter_at_line (buffer, &end, 2);
+    gtk_text_buffer_select_range (buffer, &start, &end);
+    result = run_filter (window, doc, "tr a-z A-Z", "selection", NULL);
+    TEST_ASSERT_STR_EQ (result, "c\nB\na\n");
+    g_free (result);
+
+    /* a failed command leaves the text alone */
+    result = run_filter (window, doc, "cat > /dev/null; echo oops >&2; exit 1", "doc", NULL);
+    TEST_ASSERT_STR_EQ (result, "c\nB\na\n");
+    g_free (result);
+
+    /* with the timeout option set, the command is killed when it runs
+     * out of time and the text is left alone */
+    timer = g_timer_new ();
+    result = run_filter (window, doc, "sleep 30", "doc", "1");
+    TEST_ASSERT_STR_EQ (result, "c\nB\na\n");
+    TEST_ASSERT (g_timer_elapsed (timer, NULL) < 20);
+    g_timer_destroy (timer);
+    g_free (result);
+
+    /* input larger than a pipe buffer is fed in chunks */
+    text = g_string_new (NULL);
+    for (i = 0; i < FILTER_LINES; ++i)
+        g_string_append_printf (text, "line %05u\n", i);
+    gtk_text_buffer_set_text (buffer, text->str, -1);
+
+    result = run_filter (window, doc, "cat", "doc", NULL);
+    TEST_ASSERT_STR_EQ (result, text->str);
+    g_free (result);
+
+    /* a command which exits without reading all of its input */
+    result = run_filter (window, doc, "head -c 5", "doc", NULL);
+    TEST_ASSERT_STR_EQ (result, "line ");
+    g_free (result);
+
+    moo_edit_set_modified (doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (editor, window));
+
+    g_string_free (text, TRUE);
+}
+
+#endif /* !__WIN32__ */
+
+static void
+check_literals (const char  *pattern,
+                const char **expected)
+{
+    char **literals = _moo_output_filter_regex_get_literals (pattern);
+    TEST_ASSERT_STRV_EQ_MSG (literals, (char**) expected, "pattern '%s'", pattern);
+    g_strfreev (literals);
+}
+
+/* '\001' stands for a digit */
+static void
+test_filter_literals (void)
+{
+    const char *plain[] = { "abc", NULL };
+    const char *location[] = { ":\001", "\001:", NULL };
+    const char *entering[] = { "make[\001", "\001]: Entering directory `", "'", NULL };
+    const char *repeated[] = { "abc", "ab", NULL };
+    const char *python[] = { "File", "\"", "\",", "line", "\001", "\001", NULL };
+
+    check_literals ("abc", plain);
+    check_literals ("^abc$", plain);
+    check_literals ("(?P<file>[^:]+):(?P<line>\\d+):.*", location);
+    check_literals ("^g?make\\[\\d+\\]: Entering directory `(?P<dir>.*)'", entering);
+    check_literals ("(ab)+c", repeated);
+    check_literals ("\\s*File\\s*\\\"(?P<file>[^\"]+)\\\",\\s*line\\s*(?P<line>\\d+).*", python);
+
+    /* nothing which must be there, or syntax the parser doesn't know */
+    check_literals ("x*", NULL);
+    check_literals ("\\s+", NULL);
+    check_literals ("a|b", NULL);
+    check_literals ("(?=a)b", NULL);
+    check_literals ("a\\1", NULL);
+    check_literals ("a**", NULL);
+}
+
+/* output of every filter, a line per input line, with the prefilter
+ * on or off */
+static char *
+run_output_filter (const char *id,
+                   gboolean    prefilter)
+{
+    static const char *lines[] = {
+        "make[1]: Entering directory `/tmp/project/src'",
+        "gcc -DHAVE_CONFIG_H -I. -I.. -g -O2 -c -o file1.o file1.c",
+        "In file included from file1.c:3,",
+        "                 from main.c:12:",
+        "file1.c: In function 'func':",
+        "file1.c:42:9: warning: unused variable 'x' [-Wunused-variable]",
+        "file1.c:50: error: expected ';' before '}' token",
+        "   42 |     int x;",
+        "      |         ^",
+        "parse.y:12.5-17: syntax error",
+        "parse.y:7.3: warning: useless rule",
+        "win.c(17): error C2065: 'x': undeclared identifier",
+        "Traceback (most recent call last):",
+        "  File \"script.py\", line 3, in <module>",
+        "(./paper.tex (./intro.tex",
+        "LaTeX Warning: Reference `fig1' on input line 23.",
+        "Overfull \\hbox (12.0pt too wide) in paragraph at lines 30--31",
+        "l.45 \\foo",
+        "! LaTeX Error: Missing $ inserted.",
+        ")",
+        "make[1]: Leaving directory `/tmp/project/src'",
+        "nothing to see here",
+        "",
+    };
+
+    MooOutputFilter *filter;
+    GtkWidget *view;
+    GString *result;
+    char *text;
+    guint i;
+
+    filter = moo_command_filter_create (id);
+    TEST_ASSERT_MSG (filter != NULL, "filter '%s'", id);
+    if (!filter)
+        return g_strdup ("");
+
+    _moo_output_filter_regex_set_prefilter (prefilter);
+
+    view = moo_line_view_new ();
+    g_object_ref_sink (view);
+    moo_output_filter_set_view (filter, MOO_LINE_VIEW (view));
+    moo_output_filter_cmd_start (filter, moo_test_get_working_dir ());
+
+    result = g_string_new (NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (lines); ++i)
+    {
+        gboolean out = moo_output_filter_stdout_line (filter, lines[i]);
+        gboolean err = moo_output_filter_stderr_line (filter, lines[i]);
+        g_string_append_printf (result, "%d%d", out, err);
+    }
+
+    text = get_buffer_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+    g_string_append_printf (result, "\n%s", text);
+    g_free (text);
+
+    g_object_unref (filter);
+    gtk_widget_destroy (view);
+    g_object_unref (view);
+
+    _moo_output_filter_regex_set_prefilter (TRUE);
+
+    return g_string_free (result, FALSE);
+}
+
+static void
+test_filter_prefilter (void)
+{
+    GSList *ids, *l;
+
+    ids = moo_command_filter_list ();
+    TEST_ASSERT (g_slist_find_custom (ids, "make", (GCompareFunc) strcmp) != NULL);
+
+    for (l = ids; l != NULL; l = l->next)
+    {
+        const char *id = (const char*) l->data;
+        char *with = run_output_filter (id, TRUE);
+        char *without = run_output_filter (id, FALSE);
+        TEST_ASSERT_STR_EQ_MSG (with, without, "filter '%s'", id);
+        g_free (without);
+        g_free (with);
+    }
+
+    g_slist_foreach (ids, (GFunc) g_free, NULL);
+    g_slist_free (ids);
+}
+
+static void
+bench_doc_setup (void)
+{
+    MooEditor *editor = moo_editor_instance ();
+    bench_data.window = moo_editor_new_window (editor);
+    bench_data.doc = moo_editor_new_doc (editor, bench_data.window);
+}
+
+static void
+bench_doc_cleanup (void)
+{
+    moo_edit_set_modified (bench_data.doc, FALSE);
+    TEST_ASSERT (moo_editor_close_window (moo_editor_instance (), bench_data.window));
+    bench_data.window = NULL;
+    bench_data.doc = NULL;
+}
+
+/* a tool run repeatedly, the interpreter and the compiled code are reused */
+static void
+bench_lua_tool_setup (void)
+{
+    bench_doc_setup ();
+    gtk_text_buffer_set_text (moo_edit_get_buffer (bench_data.doc), "line 1" LE "line 2" LE, -1);
+    bench_data.tool = create_lua_tool ("local lines = {}\n"
+                                       "for i = 1, doc.get_line_count() do\n"
+                                       "  lines[i] = i\n"
+                                       "end\n");
+    TEST_ASSERT (bench_data.tool != NULL);
+}
+
+static void
+bench_lua_tool_cleanup (void)
+{
+    if (bench_data.tool)
+        g_object_unref (bench_data.tool);
+    bench_data.tool = NULL;
+    bench_doc_cleanup ();
+}
+
+static void
+bench_lua_tool (void)
+{
+    guint i;
+
+    if (!bench_data.tool)
+        return;
+
+    for (i = 0; i < BENCH_LUA_TOOL_RUNS; ++i)
+        run_lua_tool (bench_data.tool);
+}
+
+/* gcc output, a warning with its context every ten lines */
+static void
+bench_filter_setup (void)
+{
+    guint i;
+
+    TEST_ASSERT (moo_command_filter_lookup ("make") != NULL);
+    bench_data.filter = moo_command_filter_create ("make");
+    if (!bench_data.filter)
+        return;
+
+    bench_data.view = moo_line_view_new ();
+    g_object_ref_sink (bench_data.view);
+    moo_output_filter_set_view (bench_data.filter, MOO_LINE_VIEW (bench_data.view));
+
+    bench_data.log = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; i < BENCH_FILTER_LINES / 10; ++i)
+    {
+        guint file = i % 50;
+        guint line = i % 1000 + 1;
+
+        g_ptr_array_add (bench_data.log, g_strdup_printf ("gcc -DHAVE_CONFIG_H -I. -I.. -g -O2 -c -o src/file%u.o src/file%u.c", file, file));
+        g_ptr_array_add (bench_data.log, g_strdup_printf ("src/file%u.c: In function 'func%u':", file, i));
+        g_ptr_array_add (bench_data.log, g_strdup_printf ("src/file%u.c:%u:9: warning: unused variable 'x' [-Wunused-variable]", file, line));
+        g_ptr_array_add (bench_data.log, g_strdup_printf ("  %u |     int x;", line));
+        g_ptr_array_add (bench_data.log, g_strdup ("      |         ^"));
+        g_ptr_array_add (bench_data.log, g_strdup_printf ("  %u |     int y = compute (a, b);", line + 1));
+        g_ptr_array_add (bench_data.log, g_strdup ("      |             ^~~~~~~~~~~~~~~~"));
+        g_ptr_array_add (bench_data.log, g_strdup ("      |             |"));
+        g_ptr_array_add (bench_data.log, g_strdup ("      |             int"));
+        g_ptr_array_add (bench_data.log, g_strdup_printf ("libtool: compile:  gcc -c src/file%u.c -fPIC -DPIC -o src/.libs/file%u.o", file, file));
+    }
+}
+
+static void
+bench_filter_cleanup (void)
+{
+    if (bench_data.filter)
+        g_object_unref (bench_data.filter);
+    if (bench_data.view)
+    {
+        gtk_widget_destroy (bench_data.view);
+        g_object_unref (bench_data.view);
+    }
+    if (bench_data.log)
+        g_ptr_array_unref (bench_data.log);
+    bench_data.filter = NULL;
+    bench_data.view = NULL;
+    bench_data.log = NULL;
+}
+
+static void
+bench_filter (void)
+{
+    guint count = 0;
+    guint i;
+
+    if (!bench_data.filter)
+        return;
+
+    moo_line_view_clear (MOO_LINE_VIEW (bench_data.view));
+    moo_output_filter_cmd_start (bench_data.filter, moo_test_get_working_dir ());
+
+    for (i = 0; i < bench_data.log->len; ++i)
+        if (moo_output_filter_stderr_line (bench_data.filter, (const char*) g_ptr_array_index (bench_data.log, i)))
+            count += 1;
+
+    TEST_ASSERT_INT_EQ (count, BENCH_FILTER_LINES / 10);
+}
+
+void
+moo_test_usertools (void)
+{
+    MooTestSuite& suite = moo_test_suite_new ("UserTools", "plugins/usertools", NULL, NULL, NULL);
+
+    moo_test_suite_add_test (suite, "lua-tool", "running Lua user tools",
+                             (MooTestFunc) test_lua_tool, NULL);
+#ifndef __WIN32__
+    moo_test_suite_add_test (suite, "filter", "running user tool filters",
+                             (MooTestFunc) test_filter, NULL);
+#endif
+    moo_test_suite_add_test (suite, "filter-literals", "literal strings of output filter patterns",
+                             (MooTestFunc) test_filter_literals, NULL);
+    moo_test_suite_add_test (suite, "filter-prefilter", "output filters with and without the literal prefilter",
+                             (MooTestFunc) test_filter_prefilter, NULL);
+
+    moo_test_suite_add_bench (suite, "lua-tool", "running a Lua tool a thousand times",
+                              (MooTestFunc) bench_lua_tool, (MooTestFunc) bench_lua_tool_setup,
+                              (MooTestFunc) bench_lua_tool_cleanup, NULL);
+    moo_test_suite_add_bench (suite, "output-filter", "filtering a long build log",
+                              (MooTestFunc) bench_filter, (MooTestFunc) bench_filter_setup,
+                              (MooTestFunc) bench_filter_cleanup, NULL);
+}
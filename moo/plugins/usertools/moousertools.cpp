@@ -16,6 +16,7 @@
 #include "moousertools.h"
 #include "moousertools-prefs.h"
 #include "moocommand-private.h"
+#include "moocommand-script.h"
 #include "plugins/mooplugin-builtin.h"
 #include "mooedit/mooeditor.h"
 #include "mooedit/mooeditaction.h"
@@ -1370,6 +1371,7 @@ user_tools_plugin_init (G_GNUC_UNUSED UserToolsPlugin *plugin)
 static void
 user_tools_plugin_deinit (G_GNUC_UNUSED UserToolsPlugin *plugin)
 {
+    _moo_command_script_shutdown ();
 }
 
 MOO_PLUGIN_DEFINE_INFO (user_tools,
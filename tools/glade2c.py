@@ -51,7 +51,7 @@ class GladeXml(object):
 
     def format_buffer(self):
         out = StringIO.StringIO()
-        for l in self.buffer.splitlines():
+        for l in compact_buffer(self.buffer):
             out.write('"')
             out.write(l.replace('\\', '\\\\').replace('"', '\\"'))
             out.write('"\n')
@@ -59,6 +59,42 @@ class GladeXml(object):
         out.close()
         return ret
 
+# Returns the glade file as a list of lines to be concatenated without
+# separators, which is how it always has been embedded. Comments and
+# indentation between elements are dropped, they only make the parser
+# do more work at runtime.
+def compact_buffer(buffer):
+    dom = minidom.parseString(''.join(buffer.splitlines()))
+
+    def strip(node):
+        has_elements = False
+        for child in node.childNodes:
+            if child.nodeType == xml.dom.Node.ELEMENT_NODE:
+                has_elements = True
+        for child in list(node.childNodes):
+            if child.nodeType == xml.dom.Node.COMMENT_NODE or \
+               (has_elements and child.nodeType == xml.dom.Node.TEXT_NODE and not child.data.strip()):
+                node.removeChild(child)
+            elif child.nodeType == xml.dom.Node.ELEMENT_NODE:
+                strip(child)
+
+    strip(dom.documentElement)
+    text = dom.documentElement.toxml().encode('utf-8')
+    dom.unlink()
+
+    # break lines between elements to keep the generated code readable
+    lines = []
+    start = 0
+    while start < len(text):
+        end = text.find('><', start + 76)
+        if end < 0:
+            end = len(text)
+        else:
+            end += 1
+        lines.append(text[start:end])
+        start = end
+    return lines
+
 class ConvertParams(object):
     def __init__(self):
         object.__init__(self)
@@ -152,7 +188,7 @@ static gboolean
 %(xml_struct)s_build (%(XmlStruct)s *xml)
 {
     GError *error = NULL;
-    if (!moo_glade_xml_parse_memory (xml->xml, %(glade_xml)s, -1, "%(root)s", &error))
+    if (!moo_glade_xml_parse_static (xml->xml, %(glade_xml)s, "%(root)s", &error))
     {
         g_critical ("Could not parse glade xml: %%s", error->message);
         g_error_free (error);
@@ -165,7 +201,7 @@ static gboolean
 %(xml_struct)s_fill (%(XmlStruct)s *xml, GtkWidget *root)
 {
     GError *error = NULL;
-    if (!moo_glade_xml_fill_widget (xml->xml, root, %(glade_xml)s, -1, "%(root)s", &error))
+    if (!moo_glade_xml_fill_widget_static (xml->xml, root, %(glade_xml)s, "%(root)s", &error))
     {
         g_critical ("Could not parse glade xml: %%s", error->message);
         g_error_free (error);